@@ -0,0 +1,970 @@
+// query_bench - latency and throughput benchmarks over synthetic worlds
+//
+// Builds a world of --entities entities over --types component types, then
+// times lexing, parsing, each query kind through a QueryEngine and result
+// copying, and writes one JSON document with percentiles per benchmark (to
+// --output, or stdout). Progress goes to stderr. Runs are seeded, so two
+// builds given the same arguments measure the same world and queries.
+//
+// World shape:
+//   --density D       fraction of entities holding C0 (default 0.5)
+//   --skew S          Ck is held with probability D / (k + 1)^S (default 0)
+//   --correlation R   with probability R an entity holds Ck exactly when it
+//                     holds Ck-1, instead of drawing independently (default 0)
+//
+// With --counters, query benchmarks also read hardware counters (cycles,
+// instructions, LLC misses, branch misses) through perf_event_open around
+// each sample and report them per query and per result row. Counters the
+// kernel refuses (perf_event_paranoid, no PMU in a VM, not Linux) are left
+// out and the reason is recorded in the JSON; timing is unaffected.
+
+#include "gramarye_query/engine.h"
+#include "gramarye_query/parser.h"
+#include "gramarye_query/query.h"
+#include "gramarye_query/profile.h"
+#include "gramarye_query/catalog.h"
+#include "gramarye_query/frame.h"
+#include "gramarye_ecs/ecs.h"
+#include "arena.h"
+#include "mem.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include <stddef.h>
+#include <time.h>
+#include <pthread.h>
+
+#ifdef __linux__
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#define BENCH_MAX_ENTITIES 10000000ULL
+#define BENCH_MAX_TYPES 64
+#define BENCH_SHOW_QUERIES 64
+#define BENCH_COUNTER_COUNT 4
+
+// Every component type has this layout
+typedef struct {
+    int32_t value;
+    int32_t group;
+    float x;
+    float y;
+} BenchComponent;
+
+typedef struct {
+    uint64_t entities;
+    size_t types;
+    double density;
+    double skew;
+    double correlation;
+    size_t iterations;
+    uint64_t seed;
+    const char* output;
+    bool counters;
+} BenchConfig;
+
+typedef struct {
+    ECS* ecs;
+    EntityId* ids;
+    ComponentTypeId typeIds[BENCH_MAX_TYPES];
+    uint64_t populations[BENCH_MAX_TYPES];
+    double buildMs;
+} BenchWorld;
+
+// One benchmark's samples, in nanoseconds
+typedef struct {
+    uint64_t* samples;
+    size_t count;
+} Samples;
+
+static const char* const counterNames[BENCH_COUNTER_COUNT] = {
+    "cycles", "instructions", "llc_misses", "branch_misses"
+};
+
+// Hardware counters, one perf event each so that any subset can be opened
+typedef struct {
+    int fds[BENCH_COUNTER_COUNT];   // -1 where the counter is unavailable
+    size_t openCount;
+    char error[128];                // Why counters are missing, empty if none are
+} BenchCounters;
+
+// Counter totals of one benchmark
+typedef struct {
+    double values[BENCH_COUNTER_COUNT];
+    bool valid[BENCH_COUNTER_COUNT];
+    size_t samples;
+} CounterTotals;
+
+static uint64_t now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+// xorshift64*: fast, and identical on every platform
+static uint64_t next_random(uint64_t* state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1DULL;
+}
+
+static double next_unit(uint64_t* state) {
+    return (double)(next_random(state) >> 11) / 9007199254740992.0;
+}
+
+static void usage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --entities N       Entities in the world, up to 10000000 (default 100000)\n"
+            "  --types N          Component types C0..C(N-1), 2 to 64 (default 8)\n"
+            "  --density D        Fraction of entities holding C0 (default 0.5)\n"
+            "  --skew S           Ck is held with probability D / (k + 1)^S (default 0)\n"
+            "  --correlation R    Chance Ck copies Ck-1's presence (default 0)\n"
+            "  --iterations N     Samples per benchmark (default 200)\n"
+            "  --seed N           World and query seed (default 1)\n"
+            "  --output FILE      Write JSON to FILE instead of stdout\n"
+            "  --counters         Read hardware counters around each query (Linux)\n",
+            program);
+}
+
+static bool parse_args(int argc, char** argv, BenchConfig* config) {
+    config->entities = 100000;
+    config->types = 8;
+    config->density = 0.5;
+    config->skew = 0.0;
+    config->correlation = 0.0;
+    config->iterations = 200;
+    config->seed = 1;
+    config->output = NULL;
+    config->counters = false;
+    
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+            return false;
+        }
+        if (strcmp(arg, "--counters") == 0) {
+            config->counters = true;
+            continue;
+        }
+        if (!value) {
+            fprintf(stderr, "Missing value for %s\n", arg);
+            return false;
+        }
+        i++;
+        if (strcmp(arg, "--entities") == 0) {
+            config->entities = strtoull(value, NULL, 10);
+        } else if (strcmp(arg, "--types") == 0) {
+            config->types = (size_t)strtoull(value, NULL, 10);
+        } else if (strcmp(arg, "--density") == 0) {
+            config->density = strtod(value, NULL);
+        } else if (strcmp(arg, "--skew") == 0) {
+            config->skew = strtod(value, NULL);
+        } else if (strcmp(arg, "--correlation") == 0) {
+            config->correlation = strtod(value, NULL);
+        } else if (strcmp(arg, "--iterations") == 0) {
+            config->iterations = (size_t)strtoull(value, NULL, 10);
+        } else if (strcmp(arg, "--seed") == 0) {
+            config->seed = strtoull(value, NULL, 10);
+        } else if (strcmp(arg, "--output") == 0) {
+            config->output = value;
+        } else {
+            fprintf(stderr, "Unknown option %s\n", arg);
+            return false;
+        }
+    }
+    
+    if (config->entities == 0 || config->entities > BENCH_MAX_ENTITIES) {
+        fprintf(stderr, "--entities must be 1 to %llu\n", (unsigned long long)BENCH_MAX_ENTITIES);
+        return false;
+    }
+    if (config->types < 2 || config->types > BENCH_MAX_TYPES) {
+        fprintf(stderr, "--types must be 2 to %d\n", BENCH_MAX_TYPES);
+        return false;
+    }
+    if (config->density < 0.0 || config->density > 1.0 || config->correlation < 0.0 || config->correlation > 1.0 ||
+        config->skew < 0.0 || config->iterations == 0) {
+        fprintf(stderr, "--density and --correlation must be in [0, 1], --skew >= 0, --iterations > 0\n");
+        return false;
+    }
+    if (config->seed == 0) {
+        config->seed = 1; // xorshift never leaves 0
+    }
+    return true;
+}
+
+static bool build_world(const BenchConfig* config, BenchWorld* world) {
+    uint64_t start = now_ns();
+    memset(world, 0, sizeof(BenchWorld));
+    world->ecs = ECS_new(Arena_new());
+    world->ids = (EntityId*)malloc(sizeof(EntityId) * config->entities);
+    if (!world->ecs || !world->ids) return false;
+    
+    double densities[BENCH_MAX_TYPES];
+    for (size_t k = 0; k < config->types; k++) {
+        char name[16];
+        snprintf(name, sizeof(name), "C%zu", k);
+        world->typeIds[k] = ECS_register_component_type(world->ecs, name, sizeof(BenchComponent));
+        densities[k] = config->density / pow((double)(k + 1), config->skew);
+    }
+    
+    uint64_t rng = config->seed;
+    EntityRegistry* registry = ECS_get_entity_registry(world->ecs);
+    for (uint64_t i = 0; i < config->entities; i++) {
+        EntityId entity = Entity_create(registry);
+        world->ids[i] = entity;
+        
+        bool held = false;
+        for (size_t k = 0; k < config->types; k++) {
+            if (k == 0 || next_unit(&rng) >= config->correlation) {
+                held = next_unit(&rng) < densities[k];
+            }
+            if (!held) continue;
+            
+            BenchComponent component;
+            component.value = (int32_t)(next_random(&rng) % 1000);
+            component.group = (int32_t)(i % 16);
+            component.x = (float)(next_unit(&rng) * 1000.0);
+            component.y = (float)(next_unit(&rng) * 1000.0);
+            ECS_add_component(world->ecs, entity, world->typeIds[k], &component);
+            world->populations[k]++;
+        }
+        if ((i + 1) % 1000000 == 0) {
+            fprintf(stderr, "  %llu entities\n", (unsigned long long)(i + 1));
+        }
+    }
+    world->buildMs = (double)(now_ns() - start) / 1e6;
+    return true;
+}
+
+// Open the counters if requested; otherwise leave all of them unavailable
+static void counters_open(BenchCounters* counters, bool requested) {
+    memset(counters, 0, sizeof(BenchCounters));
+    for (size_t i = 0; i < BENCH_COUNTER_COUNT; i++) {
+        counters->fds[i] = -1;
+    }
+    if (!requested) return;
+#ifdef __linux__
+    static const uint64_t configs[BENCH_COUNTER_COUNT] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+    };
+    for (size_t i = 0; i < BENCH_COUNTER_COUNT; i++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[i];
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;    // Allowed at perf_event_paranoid 2, and the engine runs in user space
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        
+        int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (fd < 0) {
+            if (counters->error[0] == '\0') {
+                snprintf(counters->error, sizeof(counters->error), "%s: %s", counterNames[i], strerror(errno));
+            }
+            continue;
+        }
+        counters->fds[i] = fd;
+        counters->openCount++;
+    }
+#else
+    snprintf(counters->error, sizeof(counters->error), "perf_event_open is only available on Linux");
+#endif
+}
+
+static void counters_close(BenchCounters* counters) {
+#ifdef __linux__
+    for (size_t i = 0; i < BENCH_COUNTER_COUNT; i++) {
+        if (counters->fds[i] >= 0) close(counters->fds[i]);
+        counters->fds[i] = -1;
+    }
+#endif
+    counters->openCount = 0;
+}
+
+static void counters_start(BenchCounters* counters) {
+#ifdef __linux__
+    if (!counters) return;
+    for (size_t i = 0; i < BENCH_COUNTER_COUNT; i++) {
+        if (counters->fds[i] < 0) continue;
+        ioctl(counters->fds[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(counters->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+#else
+    (void)counters;
+#endif
+}
+
+// Stop the counters and add their values to totals. Counters the kernel
+// multiplexed are scaled up by the fraction of the sample they ran for.
+static void counters_stop(BenchCounters* counters, CounterTotals* totals) {
+#ifdef __linux__
+    if (!counters) return;
+    for (size_t i = 0; i < BENCH_COUNTER_COUNT; i++) {
+        if (counters->fds[i] >= 0) ioctl(counters->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+    }
+    for (size_t i = 0; i < BENCH_COUNTER_COUNT; i++) {
+        uint64_t data[3];   // value, time enabled, time running
+        if (counters->fds[i] < 0 || read(counters->fds[i], data, sizeof(data)) != (ssize_t)sizeof(data)) continue;
+        if (data[2] == 0) continue;
+        totals->values[i] += (double)data[0] * ((double)data[1] / (double)data[2]);
+        totals->valid[i] = true;
+    }
+    totals->samples++;
+#else
+    (void)counters;
+    (void)totals;
+#endif
+}
+
+// JSON member with each counter per query and per result row, written to
+// buffer; empty when no counter was read
+static void format_counters(const CounterTotals* totals, uint64_t rows, char* buffer, size_t size) {
+    buffer[0] = '\0';
+    if (totals->samples == 0) return;
+    
+    size_t length = 0;
+    for (size_t i = 0; i < BENCH_COUNTER_COUNT && length < size; i++) {
+        if (!totals->valid[i]) continue;
+        length += (size_t)snprintf(buffer + length, size - length, "%s\"%s_per_query\": %.1f",
+                                   length ? ", " : "\"counters\": {", counterNames[i],
+                                   totals->values[i] / (double)totals->samples);
+        if (rows > 0 && length < size) {
+            length += (size_t)snprintf(buffer + length, size - length, ", \"%s_per_row\": %.3f", counterNames[i],
+                                       totals->values[i] / (double)rows);
+        }
+    }
+    if (length == 0 || length >= size) {
+        buffer[0] = '\0';
+        return;
+    }
+    if (totals->valid[0] && totals->valid[1] && totals->values[0] > 0.0) {
+        length += (size_t)snprintf(buffer + length, size - length, ", \"ipc\": %.3f",
+                                   totals->values[1] / totals->values[0]);
+    }
+    if (length + 1 < size) {
+        buffer[length] = '}';
+        buffer[length + 1] = '\0';
+    } else {
+        buffer[0] = '\0';
+    }
+}
+
+static bool samples_init(Samples* samples, size_t capacity) {
+    samples->samples = (uint64_t*)malloc(sizeof(uint64_t) * capacity);
+    samples->count = 0;
+    return samples->samples != NULL;
+}
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+// Nearest-rank percentile of sorted samples
+static uint64_t percentile(const Samples* samples, double p) {
+    size_t rank = (size_t)ceil(p * (double)samples->count);
+    return samples->samples[rank > 0 ? rank - 1 : 0];
+}
+
+// Write one benchmark object; extra is a JSON fragment of more members, or NULL
+static void write_benchmark(FILE* out, bool* first, const char* name, Samples* samples, const char* extra) {
+    qsort(samples->samples, samples->count, sizeof(uint64_t), compare_u64);
+    double total = 0.0;
+    for (size_t i = 0; i < samples->count; i++) {
+        total += (double)samples->samples[i];
+    }
+    fprintf(out, "%s\n    {\"name\": \"%s\", \"unit\": \"ns\", \"samples\": %zu, \"mean\": %.1f, "
+            "\"p50\": %llu, \"p90\": %llu, \"p99\": %llu, \"min\": %llu, \"max\": %llu%s%s}",
+            *first ? "" : ",", name, samples->count, total / (double)samples->count,
+            (unsigned long long)percentile(samples, 0.50), (unsigned long long)percentile(samples, 0.90),
+            (unsigned long long)percentile(samples, 0.99), (unsigned long long)samples->samples[0],
+            (unsigned long long)samples->samples[samples->count - 1], extra ? ", " : "", extra ? extra : "");
+    *first = false;
+}
+
+// Tokenize each query string to EOF, one sample per string
+static void bench_lex(FILE* out, bool* first, const char* const* queries, size_t queryCount, size_t iterations) {
+    Samples samples;
+    if (!samples_init(&samples, iterations * queryCount)) return;
+    
+    uint64_t bytes = 0;
+    uint64_t tokens = 0;
+    uint64_t elapsed = 0;
+    for (size_t i = 0; i < iterations; i++) {
+        for (size_t q = 0; q < queryCount; q++) {
+            uint64_t start = now_ns();
+            QueryParser* parser = QueryParser_new(queries[q]);
+            Token token = QueryParser_next_token(parser);
+            while (token.type != TOKEN_EOF && token.type != TOKEN_ERROR) {
+                tokens++;
+                token = QueryParser_next_token(parser);
+            }
+            QueryParser_destroy(parser);
+            uint64_t sample = now_ns() - start;
+            samples.samples[samples.count++] = sample;
+            elapsed += sample;
+            bytes += strlen(queries[q]);
+        }
+    }
+    
+    char extra[160];
+    snprintf(extra, sizeof(extra), "\"mb_per_s\": %.2f, \"tokens_per_s\": %.0f",
+             elapsed ? (double)bytes * 1e3 / (double)elapsed : 0.0,
+             elapsed ? (double)tokens * 1e9 / (double)elapsed : 0.0);
+    write_benchmark(out, first, "lex", &samples, extra);
+    free(samples.samples);
+}
+
+// Parse each query string into an AST, one sample per string
+static void bench_parse(FILE* out, bool* first, const char* const* queries, size_t queryCount, size_t iterations) {
+    Samples samples;
+    if (!samples_init(&samples, iterations * queryCount)) return;
+    
+    uint64_t elapsed = 0;
+    for (size_t i = 0; i < iterations; i++) {
+        for (size_t q = 0; q < queryCount; q++) {
+            uint64_t start = now_ns();
+            QueryParser* parser = QueryParser_new(queries[q]);
+            QueryAST* ast = QueryParser_parse(parser);
+            if (ast) QueryAST_destroy(ast);
+            QueryParser_destroy(parser);
+            uint64_t sample = now_ns() - start;
+            samples.samples[samples.count++] = sample;
+            elapsed += sample;
+        }
+    }
+    
+    char extra[64];
+    snprintf(extra, sizeof(extra), "\"queries_per_s\": %.0f",
+             elapsed ? (double)samples.count * 1e9 / (double)elapsed : 0.0);
+    write_benchmark(out, first, "parse", &samples, extra);
+    free(samples.samples);
+}
+
+// Execute through the engine after a warm-up run of every string, so each
+// plan is cached and each sample is execution alone. queries holds one
+// string, or several cycled through (SHOW of different entities). counters,
+// if not NULL, are read around each sample.
+static void bench_query(FILE* out, bool* first, QueryEngine* engine, BenchCounters* counters, const char* name,
+                        const char* const* queries, size_t queryCount, size_t iterations) {
+    Samples samples;
+    if (!samples_init(&samples, iterations)) return;
+    
+    QueryEngineResult result;
+    size_t rows = 0;
+    for (size_t i = 0; i < queryCount; i++) {
+        if (QueryEngine_execute(engine, queries[i], &result) != QUERY_SUCCESS) {
+            fprintf(stderr, "  %s failed: %s\n", name, queries[i]);
+            free(samples.samples);
+            return;
+        }
+        if (i == 0) {
+            rows = result.count;
+        }
+        QueryEngineResult_free(&result);
+    }
+    
+    size_t failures = 0;
+    uint64_t totalRows = 0;
+    CounterTotals totals;
+    memset(&totals, 0, sizeof(totals));
+    for (size_t i = 0; i < iterations; i++) {
+        counters_start(counters);
+        uint64_t start = now_ns();
+        QueryStatus status = QueryEngine_execute(engine, queries[i % queryCount], &result);
+        uint64_t sample = now_ns() - start;
+        counters_stop(counters, &totals);
+        samples.samples[samples.count++] = sample;
+        failures += status != QUERY_SUCCESS;
+        totalRows += result.count;
+        QueryEngineResult_free(&result);
+    }
+    
+    char counterText[640];
+    format_counters(&totals, totalRows, counterText, sizeof(counterText));
+    char extra[768];
+    snprintf(extra, sizeof(extra), "\"rows\": %zu, \"failures\": %zu%s%s", rows, failures,
+             counterText[0] ? ", " : "", counterText);
+    write_benchmark(out, first, name, &samples, extra);
+    free(samples.samples);
+}
+
+// Time spent copying entity ids into SELECT results, from the materialize
+// phase of each query's profile
+static void bench_copy(FILE* out, bool* first, QueryEngine* engine, const char* query, size_t iterations) {
+    Samples samples;
+    if (!samples_init(&samples, iterations)) return;
+    
+    uint64_t bytes = 0;
+    uint64_t elapsed = 0;
+    bool cycles = false;
+    for (size_t i = 0; i < iterations; i++) {
+        QueryEngineResult result;
+        if (QueryEngine_execute(engine, query, &result) == QUERY_SUCCESS) {
+            uint64_t ticks = result.stats.phaseTicks[QUERY_PHASE_MATERIALIZE];
+            samples.samples[samples.count++] = ticks;
+            elapsed += ticks;
+            bytes += (uint64_t)result.count * sizeof(EntityId);
+            cycles = result.stats.cycles;
+        }
+        QueryEngineResult_free(&result);
+    }
+    if (samples.count == 0 || cycles) {
+        // Cycle counts are not nanoseconds; leave them out rather than mislabel them
+        free(samples.samples);
+        return;
+    }
+    
+    char extra[64];
+    snprintf(extra, sizeof(extra), "\"gb_per_s\": %.3f", elapsed ? (double)bytes / (double)elapsed : 0.0);
+    write_benchmark(out, first, "result_copy", &samples, extra);
+    free(samples.samples);
+}
+
+// Scenarios below (whole batches, index builds, set algebra, thread fan-out)
+// are heavier than a single query, so they take at most this many samples
+#define BENCH_SCENARIO_ITERATIONS 20
+#define BENCH_BATCH_QUERIES 32
+#define BENCH_THREADS 8
+
+static size_t scenario_iterations(size_t iterations) {
+    return iterations < BENCH_SCENARIO_ITERATIONS ? iterations : BENCH_SCENARIO_ITERATIONS;
+}
+
+// Time query through catalog, parsing included as QueryCatalog_execute callers
+// see it, and write it as one benchmark; extra is more JSON members, or NULL
+static void bench_catalog(FILE* out, bool* first, QueryCatalog* catalog, const char* name, const char* query,
+                          size_t iterations, const char* extra) {
+    Samples samples;
+    if (!samples_init(&samples, iterations)) return;
+    
+    size_t rows = 0;
+    for (size_t i = 0; i < iterations; i++) {
+        QueryEngineResult result;
+        uint64_t start = now_ns();
+        QueryStatus status = QueryCatalog_execute(catalog, query, &result);
+        uint64_t sample = now_ns() - start;
+        if (status != QUERY_SUCCESS) {
+            fprintf(stderr, "  %s failed: %s\n", name, query);
+            free(samples.samples);
+            return;
+        }
+        rows = result.count;
+        QueryEngineResult_free(&result);
+        samples.samples[samples.count++] = sample;
+    }
+    
+    char members[256];
+    snprintf(members, sizeof(members), "\"rows\": %zu%s%s", rows, extra ? ", " : "", extra ? extra : "");
+    write_benchmark(out, first, name, &samples, members);
+    free(samples.samples);
+}
+
+// 32 queries, most driven by C0, run one by one and as one fused batch
+// (Query_execute_batch); a sample is the whole set
+static void bench_batch(FILE* out, bool* first, ECS* ecs, size_t types, size_t iterations) {
+    char text[BENCH_BATCH_QUERIES][96];
+    const char* queries[BENCH_BATCH_QUERIES];
+    size_t others = types - 1 < 7 ? types - 1 : 7;
+    for (size_t q = 0; q < BENCH_BATCH_QUERIES; q++) {
+        size_t a = 1 + q % others;
+        size_t b = 1 + (q / others) % others;
+        if (q % 4 == 3) {
+            snprintf(text[q], sizeof(text[q]), "COUNT entities WHERE has(C0, C%zu)", a);
+        } else if (q % 8 == 5) {
+            snprintf(text[q], sizeof(text[q]), "SELECT entities WHERE not_has(C%zu)", a);
+        } else {
+            snprintf(text[q], sizeof(text[q]), "SELECT entities WHERE has(C0, C%zu, C%zu)", a, b);
+        }
+        queries[q] = text[q];
+    }
+    
+    Samples sequential;
+    Samples fused;
+    if (!samples_init(&sequential, iterations)) return;
+    if (!samples_init(&fused, iterations)) {
+        free(sequential.samples);
+        return;
+    }
+    QueryEngineResult results[BENCH_BATCH_QUERIES];
+    size_t failures = 0;
+    for (size_t i = 0; i < iterations; i++) {
+        uint64_t start = now_ns();
+        for (size_t q = 0; q < BENCH_BATCH_QUERIES; q++) {
+            failures += Query_execute(ecs, queries[q], &results[q]) != QUERY_SUCCESS;
+        }
+        sequential.samples[sequential.count++] = now_ns() - start;
+        for (size_t q = 0; q < BENCH_BATCH_QUERIES; q++) {
+            QueryEngineResult_free(&results[q]);
+        }
+        
+        start = now_ns();
+        failures += Query_execute_batch(ecs, queries, BENCH_BATCH_QUERIES, results) != QUERY_SUCCESS;
+        fused.samples[fused.count++] = now_ns() - start;
+        for (size_t q = 0; q < BENCH_BATCH_QUERIES; q++) {
+            QueryEngineResult_free(&results[q]);
+        }
+    }
+    
+    char extra[64];
+    snprintf(extra, sizeof(extra), "\"queries\": %d, \"failures\": %zu", BENCH_BATCH_QUERIES, failures);
+    write_benchmark(out, first, "batch_sequential", &sequential, extra);
+    write_benchmark(out, first, "batch_fused", &fused, extra);
+    free(sequential.samples);
+    free(fused.samples);
+}
+
+// JSON members describing an index just built
+static void index_members(const QueryIndexStats* stats, uint64_t entities, char* buffer, size_t size) {
+    snprintf(buffer, size, "\"build_ms\": %.2f, \"index_bytes\": %zu, \"bytes_per_entity\": %.1f",
+             stats->buildMs, stats->memoryBytes, entities ? (double)stats->memoryBytes / (double)entities : 0.0);
+}
+
+typedef struct {
+    QueryCatalog* catalog;
+    const char* const* queries;
+    size_t queryCount;
+    size_t failures;            // Written by the worker only
+} BenchWorker;
+
+static void* bench_worker(void* arg) {
+    BenchWorker* worker = (BenchWorker*)arg;
+    for (size_t q = 0; q < worker->queryCount; q++) {
+        QueryEngineResult result;
+        worker->failures += QueryCatalog_execute(worker->catalog, worker->queries[q], &result) != QUERY_SUCCESS;
+        QueryEngineResult_free(&result);
+    }
+    return NULL;
+}
+
+// BENCH_THREADS threads each run queries once against one shared catalog;
+// a sample is the wall time until the last one finishes
+static void bench_concurrent(FILE* out, bool* first, QueryCatalog* catalog, const char* const* queries,
+                             size_t queryCount, size_t iterations) {
+    Samples samples;
+    if (!samples_init(&samples, iterations)) return;
+    
+    size_t failures = 0;
+    uint64_t elapsed = 0;
+    for (size_t i = 0; i < iterations; i++) {
+        BenchWorker workers[BENCH_THREADS];
+        pthread_t threads[BENCH_THREADS];
+        size_t started = 0;
+        uint64_t start = now_ns();
+        for (size_t t = 0; t < BENCH_THREADS; t++) {
+            workers[t].catalog = catalog;
+            workers[t].queries = queries;
+            workers[t].queryCount = queryCount;
+            workers[t].failures = 0;
+            if (pthread_create(&threads[t], NULL, bench_worker, &workers[t]) != 0) break;
+            started++;
+        }
+        for (size_t t = 0; t < started; t++) {
+            pthread_join(threads[t], NULL);
+            failures += workers[t].failures;
+        }
+        uint64_t sample = now_ns() - start;
+        failures += (BENCH_THREADS - started) * queryCount;
+        samples.samples[samples.count++] = sample;
+        elapsed += sample;
+    }
+    
+    char extra[128];
+    snprintf(extra, sizeof(extra), "\"threads\": %d, \"failures\": %zu, \"queries_per_s\": %.0f", BENCH_THREADS,
+             failures, elapsed ? (double)(samples.count * BENCH_THREADS * queryCount) * 1e9 / (double)elapsed : 0.0);
+    write_benchmark(out, first, "concurrent", &samples, extra);
+    free(samples.samples);
+}
+
+// Filters on C0's fields through a catalog: condition scans, range and IN
+// predicates scanned and then served by a sorted and a hash index, a WITHIN
+// over a spatial grid, then a mix of them from several threads at once
+static void bench_filters(FILE* out, bool* first, ECS* ecs, uint64_t entities, size_t iterations) {
+    QueryCatalog* catalog = QueryCatalog_new(ecs);
+    if (!catalog) return;
+    QueryCatalog_register_field(catalog, "C0", "value", offsetof(BenchComponent, value), QUERY_FIELD_I32);
+    QueryCatalog_register_field(catalog, "C0", "group", offsetof(BenchComponent, group), QUERY_FIELD_I32);
+    QueryCatalog_register_field(catalog, "C0", "x", offsetof(BenchComponent, x), QUERY_FIELD_F32);
+    QueryCatalog_register_field(catalog, "C0", "y", offsetof(BenchComponent, y), QUERY_FIELD_F32);
+    
+    const char* range = "COUNT entities WHERE C0.value BETWEEN 100 AND 109";
+    const char* in = "COUNT entities WHERE C0.value IN (7, 500)";
+    const char* within = "COUNT entities WHERE WITHIN(C0, 500, 500, 10)";
+    bench_catalog(out, first, catalog, "condition_and", "COUNT entities WHERE has(C0) AND C0.value >= 0", iterations,
+                  NULL);
+    bench_catalog(out, first, catalog, "condition_select", "SELECT entities WHERE has(C1) AND C0.value < 100",
+                  iterations, NULL);
+    bench_catalog(out, first, catalog, "condition_or", "COUNT entities WHERE has(C1) OR C0.value < 500", iterations,
+                  NULL);
+    bench_catalog(out, first, catalog, "range_scan", range, iterations, NULL);
+    bench_catalog(out, first, catalog, "in_scan", in, iterations, NULL);
+    
+    char extra[160];
+    QueryIndexStats stats;
+    if (QueryCatalog_create_index(catalog, "C0", "value") == QUERY_SUCCESS &&
+        QueryCatalog_get_index_stats(catalog, "C0", "value", &stats) == QUERY_SUCCESS) {
+        index_members(&stats, entities, extra, sizeof(extra));
+        bench_catalog(out, first, catalog, "range_indexed", range, iterations, extra);
+        QueryCatalog_drop_index(catalog, "C0", "value");
+    }
+    if (QueryCatalog_create_hash_index(catalog, "C0", "value") == QUERY_SUCCESS &&
+        QueryCatalog_get_hash_index_stats(catalog, "C0", "value", &stats) == QUERY_SUCCESS) {
+        index_members(&stats, entities, extra, sizeof(extra));
+        bench_catalog(out, first, catalog, "in_hashed", in, iterations, extra);
+    }
+    if (QueryCatalog_create_spatial_index(catalog, "C0", "x", "y", 16.0) == QUERY_SUCCESS &&
+        QueryCatalog_get_spatial_stats(catalog, "C0", &stats) == QUERY_SUCCESS) {
+        index_members(&stats, entities, extra, sizeof(extra));
+        bench_catalog(out, first, catalog, "within_indexed", within, iterations, extra);
+    }
+    QueryCatalog_create_index(catalog, "C0", "value");
+    
+    const char* const mixed[] = {
+        "COUNT entities WHERE has(C0, C1)",
+        "SELECT entities WHERE has(C1) AND not_has(C0)",
+        "SELECT entities WHERE C0.value < 50",
+        "COUNT entities WHERE C0.value BETWEEN 10 AND 12",
+        "SELECT entities WHERE C0.value IN (3, 7) AND C0.x >= 50",
+        "COUNT entities WHERE WITHIN(C0, 100, 100, 20)",
+        "SELECT entities WHERE C0.value = 0 OR C0.group = 5 LIMIT 300",
+        "SELECT APPROX_PERCENTILE(C0.value, 0.5) WHERE has(C1)"
+    };
+    bench_concurrent(out, first, catalog, mixed, sizeof(mixed) / sizeof(mixed[0]), scenario_iterations(iterations));
+    QueryCatalog_destroy(catalog);
+}
+
+// Three queries in one QueryFrame, sharing its memoized entity sets; the
+// sets' size is compared with flat bitsets over every entity
+static void bench_frame(FILE* out, bool* first, ECS* ecs, uint64_t entities, size_t iterations) {
+    const char* const queries[] = {
+        "COUNT entities WHERE not_has(C1)",
+        "COUNT entities WHERE has(C0)",
+        "COUNT entities WHERE has(C0, C1)"
+    };
+    size_t queryCount = sizeof(queries) / sizeof(queries[0]);
+    Samples samples;
+    if (!samples_init(&samples, iterations)) return;
+    
+    size_t failures = 0;
+    QueryFrameStats stats;
+    memset(&stats, 0, sizeof(stats));
+    for (size_t i = 0; i < iterations; i++) {
+        uint64_t start = now_ns();
+        QueryFrame* frame = QueryFrame_begin(ecs);
+        for (size_t q = 0; q < queryCount; q++) {
+            QueryEngineResult result;
+            failures += QueryFrame_execute(frame, queries[q], &result) != QUERY_SUCCESS;
+            QueryEngineResult_free(&result);
+        }
+        samples.samples[samples.count++] = now_ns() - start;
+        stats = QueryFrame_get_stats(frame);
+        QueryFrame_end(frame);
+    }
+    
+    char extra[160];
+    snprintf(extra, sizeof(extra), "\"queries\": %zu, \"failures\": %zu, \"sets\": %zu, \"set_bytes\": %zu, "
+             "\"flat_bytes\": %llu", queryCount, failures, stats.setCount, stats.setBytes,
+             (unsigned long long)(stats.setCount * entities / 8));
+    write_benchmark(out, first, "frame_sets", &samples, extra);
+    free(samples.samples);
+}
+
+// Sorting two entity results, merging them three ways, and galloping 100
+// ids through the larger one
+static void bench_set_operations(FILE* out, bool* first, QueryEngine* engine, size_t iterations) {
+    QueryEngineResult a;
+    QueryEngineResult b;
+    if (QueryEngine_execute(engine, "SELECT entities WHERE has(C0)", &a) != QUERY_SUCCESS) return;
+    if (QueryEngine_execute(engine, "SELECT entities WHERE has(C1)", &b) != QUERY_SUCCESS || a.count == 0) {
+        QueryEngineResult_free(&a);
+        return;
+    }
+    
+    // 100 ids spread over a, built by hand so the result owns a libcore block
+    QueryEngineResult small;
+    memset(&small, 0, sizeof(small));
+    EntityId* smallIds = (EntityId*)ALLOC(sizeof(EntityId) * 100);
+    const EntityId* aIds = (const EntityId*)a.entities;
+    for (size_t i = 0; i < 100; i++) {
+        smallIds[i] = aIds[(i * a.count) / 100];
+    }
+    small.entities = smallIds;
+    small.count = small.capacity = 100;
+    
+    Samples sort;
+    Samples merge;
+    Samples gallop;
+    bool ok = samples_init(&sort, iterations);
+    ok = samples_init(&merge, iterations) && ok;
+    ok = samples_init(&gallop, iterations) && ok;
+    size_t failures = 0;
+    for (size_t i = 0; ok && i < iterations; i++) {
+        QueryEngineResult sortedA;
+        QueryEngineResult sortedB;
+        QueryEngineResult sortedSmall;
+        uint64_t start = now_ns();
+        failures += QueryEngineResult_union(&a, &a, true, &sortedA) != QUERY_SUCCESS;
+        failures += QueryEngineResult_union(&b, &b, true, &sortedB) != QUERY_SUCCESS;
+        sort.samples[sort.count++] = now_ns() - start;
+        failures += QueryEngineResult_union(&small, &small, true, &sortedSmall) != QUERY_SUCCESS;
+        
+        QueryEngineResult both;
+        QueryEngineResult either;
+        QueryEngineResult onlyA;
+        start = now_ns();
+        failures += QueryEngineResult_intersect(&sortedA, &sortedB, false, &both) != QUERY_SUCCESS;
+        failures += QueryEngineResult_union(&sortedA, &sortedB, false, &either) != QUERY_SUCCESS;
+        failures += QueryEngineResult_difference(&sortedA, &sortedB, false, &onlyA) != QUERY_SUCCESS;
+        merge.samples[merge.count++] = now_ns() - start;
+        
+        QueryEngineResult hits;
+        start = now_ns();
+        failures += QueryEngineResult_intersect(&sortedSmall, &sortedA, false, &hits) != QUERY_SUCCESS;
+        gallop.samples[gallop.count++] = now_ns() - start;
+        
+        QueryEngineResult_free(&sortedA);
+        QueryEngineResult_free(&sortedB);
+        QueryEngineResult_free(&sortedSmall);
+        QueryEngineResult_free(&both);
+        QueryEngineResult_free(&either);
+        QueryEngineResult_free(&onlyA);
+        QueryEngineResult_free(&hits);
+    }
+    
+    if (ok) {
+        char extra[128];
+        snprintf(extra, sizeof(extra), "\"a\": %zu, \"b\": %zu, \"failures\": %zu", a.count, b.count, failures);
+        write_benchmark(out, first, "set_sort", &sort, extra);
+        write_benchmark(out, first, "set_merge", &merge, extra);
+        write_benchmark(out, first, "set_gallop", &gallop, extra);
+    }
+    free(sort.samples);
+    free(merge.samples);
+    free(gallop.samples);
+    QueryEngineResult_free(&small);
+    QueryEngineResult_free(&a);
+    QueryEngineResult_free(&b);
+}
+
+int main(int argc, char** argv) {
+    BenchConfig config;
+    if (!parse_args(argc, argv, &config)) {
+        usage(argv[0]);
+        return 1;
+    }
+    
+    FILE* out = config.output ? fopen(config.output, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "Cannot open %s\n", config.output);
+        return 1;
+    }
+    
+    fprintf(stderr, "Building %llu entities over %zu types...\n", (unsigned long long)config.entities, config.types);
+    BenchWorld world;
+    if (!build_world(&config, &world)) {
+        fprintf(stderr, "Out of memory building the world\n");
+        return 1;
+    }
+    // Room for every SHOW string next to the other queries, so none is
+    // evicted and recompiled while being timed
+    QueryEngineConfig engineConfig = QueryEngineConfig_default();
+    if (engineConfig.planCacheEntries < BENCH_SHOW_QUERIES * 2) {
+        engineConfig.planCacheEntries = BENCH_SHOW_QUERIES * 2;
+    }
+    QueryEngine* engine = QueryEngine_new(world.ecs, &engineConfig);
+    if (!engine) {
+        fprintf(stderr, "Cannot create engine\n");
+        return 1;
+    }
+    
+    BenchCounters counters;
+    counters_open(&counters, config.counters);
+    if (config.counters && counters.openCount < BENCH_COUNTER_COUNT) {
+        fprintf(stderr, "Hardware counters: %zu of %d available (%s)\n", counters.openCount, BENCH_COUNTER_COUNT,
+                counters.error);
+    }
+    BenchCounters* queryCounters = counters.openCount > 0 ? &counters : NULL;
+    
+    const char* const frontQueries[] = {
+        "SELECT entities WHERE has(C0, C1)",
+        "SELECT entities WHERE has_any(C0, C1) LIMIT 100",
+        "COUNT entities WHERE not_has(C0)",
+        "SELECT entities WHERE has(C0) AND C1.value < 100 OR has_any(C1, C0)",
+        "SHOW ALL OF entity 12345678901234:98765432109876",
+    };
+    size_t frontCount = sizeof(frontQueries) / sizeof(frontQueries[0]);
+    
+    // SHOW a spread of entities rather than one hot id
+    char showText[BENCH_SHOW_QUERIES][96];
+    const char* showQueries[BENCH_SHOW_QUERIES];
+    uint64_t rng = config.seed;
+    for (size_t i = 0; i < BENCH_SHOW_QUERIES; i++) {
+        EntityId entity = world.ids[next_random(&rng) % config.entities];
+        snprintf(showText[i], sizeof(showText[i]), "SHOW ALL OF entity %llu:%llu",
+                 (unsigned long long)entity.high, (unsigned long long)entity.low);
+        showQueries[i] = showText[i];
+    }
+    
+    fprintf(out, "{\n  \"config\": {\"entities\": %llu, \"types\": %zu, \"density\": %g, \"skew\": %g, "
+            "\"correlation\": %g, \"iterations\": %zu, \"seed\": %llu},\n",
+            (unsigned long long)config.entities, config.types, config.density, config.skew, config.correlation,
+            config.iterations, (unsigned long long)config.seed);
+    fprintf(out, "  \"world\": {\"build_ms\": %.1f, \"populations\": [", world.buildMs);
+    for (size_t k = 0; k < config.types; k++) {
+        fprintf(out, "%s%llu", k > 0 ? ", " : "", (unsigned long long)world.populations[k]);
+    }
+    fprintf(out, "]},\n  \"counters\": {\"requested\": %s, \"available\": [", config.counters ? "true" : "false");
+    for (size_t i = 0, n = 0; i < BENCH_COUNTER_COUNT; i++) {
+        if (!queryCounters || counters.fds[i] < 0) continue;
+        fprintf(out, "%s\"%s\"", n++ > 0 ? ", " : "", counterNames[i]);
+    }
+    fprintf(out, "], \"error\": \"%s\"},\n  \"benchmarks\": [", counters.error);
+    
+    bool first = true;
+    fprintf(stderr, "Lexing and parsing...\n");
+    bench_lex(out, &first, frontQueries, frontCount, config.iterations);
+    bench_parse(out, &first, frontQueries, frontCount, config.iterations);
+    
+    fprintf(stderr, "Queries...\n");
+    const char* hasQuery = "SELECT entities WHERE has(C0, C1)";
+    const char* hasAnyQuery = "SELECT entities WHERE has_any(C0, C1)";
+    const char* notHasQuery = "SELECT entities WHERE not_has(C0)";
+    const char* countQuery = "COUNT entities WHERE has(C0, C1)";
+    bench_query(out, &first, engine, queryCounters, "has", &hasQuery, 1, config.iterations);
+    bench_query(out, &first, engine, queryCounters, "has_any", &hasAnyQuery, 1, config.iterations);
+    bench_query(out, &first, engine, queryCounters, "not_has", &notHasQuery, 1, config.iterations);
+    bench_query(out, &first, engine, queryCounters, "count", &countQuery, 1, config.iterations);
+    bench_query(out, &first, engine, queryCounters, "show", showQueries, BENCH_SHOW_QUERIES, config.iterations);
+    bench_copy(out, &first, engine, "SELECT entities WHERE has(C0)", config.iterations);
+    
+    fprintf(stderr, "Scenarios...\n");
+    size_t scenarioIterations = scenario_iterations(config.iterations);
+    bench_batch(out, &first, world.ecs, config.types, scenarioIterations);
+    bench_filters(out, &first, world.ecs, config.entities, scenarioIterations);
+    bench_frame(out, &first, world.ecs, config.entities, scenarioIterations);
+    bench_set_operations(out, &first, engine, scenarioIterations);
+    fprintf(out, "\n  ]\n}\n");
+    
+    counters_close(&counters);
+    QueryEngine_destroy(engine);
+    ECS_destroy(world.ecs);
+    free(world.ids);
+    if (config.output) {
+        fclose(out);
+    }
+    fprintf(stderr, "Done\n");
+    return 0;
+}
@@ -0,0 +1,72 @@
+#ifndef GRAMARYE_QUERY_ALLOCATOR_H
+#define GRAMARYE_QUERY_ALLOCATOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Pluggable allocator and per-query memory accounting.
+//
+// Every buffer the query library allocates (parser tokens, ASTs, type id
+// arrays, plans, indexes, result buffers) goes through QUERY_ALLOC,
+// QUERY_REALLOC and QUERY_FREE. They use the allocator of the innermost
+// QueryMemoryScope open on the calling thread, or libcore's ALLOC/FREE
+// outside any scope. A QueryEngine opens a scope with the allocator from its
+// QueryEngineConfig around each of its calls, and reports what the scope saw
+// in QueryEngineResult.memory.
+//
+// A scope may also carry a budget: an allocation or resize that would take
+// the bytes live in the scope above it fails as if the allocator were out of
+// memory, and is counted in stats.refused.
+//
+// Each block carries a small header recording its size and the allocator it
+// came from, so it is always handed back to that allocator wherever it is
+// freed. An allocator (and its user data) must outlive every block taken
+// from it.
+
+typedef struct {
+    void* (*alloc)(void* user, size_t size);
+    // May be NULL: blocks then move with alloc, memcpy and free
+    void* (*realloc)(void* user, void* ptr, size_t oldSize, size_t newSize);
+    void (*free)(void* user, void* ptr, size_t size);
+    void* user;
+} QueryAllocator;
+
+// Memory used by one query
+typedef struct {
+    uint64_t bytesAllocated;    // Bytes requested, including block headers and growth
+    uint64_t allocations;       // Blocks allocated or resized
+    uint64_t peakBytes;         // Most bytes live at once above the level the query started at
+    uint64_t refused;           // Allocations and resizes refused by the budget
+} QueryMemoryStats;
+
+// libcore's ALLOC/RESIZE/FREE
+const QueryAllocator* QueryAllocator_default(void);
+
+// Accounting scope (exposed for the engine). Scopes nest per thread; only
+// the innermost one is charged.
+typedef struct QueryMemoryScope {
+    const QueryAllocator* allocator;
+    QueryMemoryStats stats;
+    int64_t liveBytes;          // Allocated minus freed since the scope opened
+    uint64_t budget;            // Most liveBytes may reach; 0 (as entered) for no limit
+    struct QueryMemoryScope* outer;
+} QueryMemoryScope;
+
+// Route this thread's allocations to allocator (NULL for the default) until
+// the matching QueryMemory_leave
+void QueryMemory_enter(QueryMemoryScope* scope, const QueryAllocator* allocator);
+void QueryMemory_leave(QueryMemoryScope* scope);
+
+// Allocator new blocks come from on this thread
+const QueryAllocator* QueryMemory_current(void);
+
+void* QueryMemory_alloc(size_t size);
+// Resize with the block's own allocator; on failure returns NULL and ptr stays valid
+void* QueryMemory_realloc(void* ptr, size_t size);
+void QueryMemory_free(void* ptr);
+
+#define QUERY_ALLOC(nbytes) QueryMemory_alloc((size_t)(nbytes))
+#define QUERY_REALLOC(ptr, nbytes) QueryMemory_realloc((ptr), (size_t)(nbytes))
+#define QUERY_FREE(ptr) ((void)(QueryMemory_free(ptr), (ptr) = 0))
+
+#endif // GRAMARYE_QUERY_ALLOCATOR_H
@@ -0,0 +1,75 @@
+#ifndef GRAMARYE_QUERY_CACHE_H
+#define GRAMARYE_QUERY_CACHE_H
+
+#include "gramarye_ecs/ecs.h"
+#include "gramarye_ecs/component.h"
+#include "query.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Result cache for SELECT/COUNT queries.
+//
+// Entries are keyed by the resolved plan (query kind, predicate kind and the
+// sorted set of ComponentTypeIds) rather than by the raw query string, so
+// "has(Position, Health)" and "has(Health, Position)" share one entry and a
+// COUNT is served from a cached SELECT of the same predicate.
+//
+// Each entry records the structural version of every component type it
+// depends on. The ECS does not publish change notifications, so the caller
+// bumps versions when the structure changes:
+//   - QueryCache_bump_component() when a component of that type is added to or
+//     removed from any entity (including removals caused by destroying an
+//     entity)
+//   - QueryCache_bump_entities() when an entity is created or destroyed; only
+//     not_has() results depend on this, since an entity without components
+//     still matches them
+// Writes to component data do not invalidate anything. SHOW queries read
+// component data and are never cached.
+
+typedef struct QueryCache QueryCache;
+
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t insertions;
+    uint64_t evictions;      // Entries dropped to stay under the memory bound
+    uint64_t invalidations;  // Entries dropped because a dependency version moved
+    size_t entryCount;
+    size_t bytesUsed;
+    size_t maxBytes;
+} QueryCacheStats;
+
+// Default memory bound used when QueryCache_new is given 0
+#define QUERY_CACHE_DEFAULT_MAX_BYTES (4u * 1024u * 1024u)
+
+// Create a cache bounded to maxBytes of entry storage (0 = default)
+QueryCache* QueryCache_new(size_t maxBytes);
+
+// Destroy cache and all entries
+void QueryCache_destroy(QueryCache* cache);
+
+// Execute a query string, serving it from the cache when no dependency has
+// changed. The result is owned by the caller as with Query_execute.
+QueryStatus QueryCache_execute(QueryCache* cache, ECS* ecs, const char* queryString, QueryEngineResult* outResult);
+
+// Record a structural change to a component type
+void QueryCache_bump_component(QueryCache* cache, ComponentTypeId typeId);
+
+// Record entity creation/destruction
+void QueryCache_bump_entities(QueryCache* cache);
+
+// Current structural version of a component type (0 if never bumped)
+uint64_t QueryCache_get_component_version(const QueryCache* cache, ComponentTypeId typeId);
+
+// Change the memory bound, evicting least recently used entries as needed
+void QueryCache_set_max_bytes(QueryCache* cache, size_t maxBytes);
+
+// Drop every entry (statistics are kept)
+void QueryCache_clear(QueryCache* cache);
+
+// Statistics
+QueryCacheStats QueryCache_get_stats(const QueryCache* cache);
+double QueryCache_hit_rate(const QueryCache* cache);
+void QueryCache_reset_stats(QueryCache* cache);
+
+#endif // GRAMARYE_QUERY_CACHE_H
@@ -0,0 +1,211 @@
+#ifndef GRAMARYE_QUERY_CATALOG_H
+#define GRAMARYE_QUERY_CATALOG_H
+
+#include "gramarye_ecs/ecs.h"
+#include "gramarye_ecs/entity.h"
+#include "gramarye_ecs/component.h"
+#include "query.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Field schema and secondary indexes for component data.
+//
+// The ECS stores components as opaque bytes, so field filters such as
+// "Position.x > 100" need to know where x lives. Fields are described once
+// with QueryCatalog_register_field; queries executed through the catalog can
+// then filter on them, combine filters and has() predicates with AND / OR,
+// and use sorted indexes created with "CREATE INDEX ON Position.x".
+//
+// Indexes are maintained by the caller, like the result cache:
+//   - QueryCatalog_notify_write() after a component is added or its data is
+//     written
+//   - QueryCatalog_notify_remove() after a component is removed
+//   - QueryCatalog_notify_destroy() after an entity is destroyed
+// The planner uses an index for <, <=, >, >=, = and BETWEEN when the range
+// is estimated to hold at most QUERY_INDEX_MAX_SELECTIVITY of the indexed
+// entities; wider ranges scan the component storage instead.
+//
+// Writes can be tracked per component type for CHANGED(Component), which
+// selects the entities whose component was written (notify_write) since the
+// last QueryCatalog_clear_changes. Call that at each frame boundary; both
+// the query and the clear cost time proportional to the number of changes.
+//
+// Integer fields can also get a hash index ("CREATE HASH INDEX ON Team.id"),
+// which answers = and IN (...) with one probe per value and is preferred
+// over a sorted index on the same field for those operators.
+//
+// A component can also designate two registered fields as its 2D position
+// with QueryCatalog_create_spatial_index. That enables
+//   WITHIN(Position, x, y, radius)
+//   INSIDE(Position, x0, y0, x1, y1)
+// which are answered from a uniform grid and only touch cells near the
+// query. The same notify calls keep the grid up to date.
+
+typedef enum {
+    QUERY_FIELD_I32,
+    QUERY_FIELD_U32,
+    QUERY_FIELD_I64,
+    QUERY_FIELD_U64,
+    QUERY_FIELD_F32,
+    QUERY_FIELD_F64
+} QueryFieldType;
+
+// A resolved field (exposed for executor)
+typedef struct {
+    ComponentTypeId typeId;
+    size_t offset;
+    QueryFieldType type;
+} QueryField;
+
+typedef struct {
+    size_t entryCount;      // Live entries
+    size_t pendingCount;    // Updates not yet merged into the sorted array
+    size_t memoryBytes;
+    double buildMs;         // Time spent building the index
+    uint64_t scans;         // Range scans served by the index
+} QueryIndexStats;
+
+typedef struct QueryCatalog QueryCatalog;
+typedef struct FieldIndex FieldIndex;
+typedef struct SpatialIndex SpatialIndex;
+typedef struct HashIndex HashIndex;
+
+// Fraction of indexed entities above which a range scan is not worth it
+#define QUERY_INDEX_MAX_SELECTIVITY 0.25
+
+// Create a catalog for ecs
+QueryCatalog* QueryCatalog_new(ECS* ecs);
+
+// Destroy catalog and all of its indexes
+void QueryCatalog_destroy(QueryCatalog* catalog);
+
+ECS* QueryCatalog_get_ecs(const QueryCatalog* catalog);
+
+// Counter bumped whenever a field is registered, an index of any kind is
+// created or dropped, or a type starts being tracked. Compiled conditions
+// (prepared plans) hold field offsets and index pointers; they compile again
+// when it moves.
+uint64_t QueryCatalog_schema_version(const QueryCatalog* catalog);
+
+// Describe a numeric field of a registered component type
+QueryStatus QueryCatalog_register_field(QueryCatalog* catalog,
+                                        const char* componentName,
+                                        const char* fieldName,
+                                        size_t offset,
+                                        QueryFieldType type);
+
+// New catalog over ecs with the fields of catalog (may be NULL) whose component
+// ecs also registers, matched by name. Indexes and change tracking are not copied.
+QueryCatalog* QueryCatalog_clone_schema(const QueryCatalog* catalog, ECS* ecs);
+
+// Register in catalog the fields of source (may be NULL) it does not have yet,
+// as QueryCatalog_clone_schema does; allocates only for new fields
+QueryStatus QueryCatalog_copy_schema(QueryCatalog* catalog, const QueryCatalog* source);
+
+// Look up a registered field
+bool QueryCatalog_find_field(const QueryCatalog* catalog,
+                             const char* componentName,
+                             const char* fieldName,
+                             QueryField* outField);
+
+// Read a field from component data as a double
+double QueryField_read(const QueryField* field, const void* componentData);
+
+// Read an integer field from component data as its raw 64-bit value
+uint64_t QueryField_read_key(const QueryField* field, const void* componentData);
+
+// Hash key for value on field; false if value is not an integer the field can hold
+bool QueryField_key_for_value(const QueryField* field, double value, uint64_t* outKey);
+
+// Build a sorted index over a registered field from the current ECS contents
+QueryStatus QueryCatalog_create_index(QueryCatalog* catalog, const char* componentName, const char* fieldName);
+
+// Drop an index (QUERY_ERROR_EXECUTION if there is none)
+QueryStatus QueryCatalog_drop_index(QueryCatalog* catalog, const char* componentName, const char* fieldName);
+
+// Index over field, or NULL (for executor)
+FieldIndex* QueryCatalog_find_index(const QueryCatalog* catalog, const QueryField* field);
+
+// Count a range scan served by an index (for executor)
+void QueryCatalog_record_scan(QueryCatalog* catalog, const QueryField* field);
+
+QueryStatus QueryCatalog_get_index_stats(const QueryCatalog* catalog,
+                                         const char* componentName,
+                                         const char* fieldName,
+                                         QueryIndexStats* outStats);
+
+// Build a hash index over a registered integer field
+// (QUERY_ERROR_EXECUTION for floating-point fields)
+QueryStatus QueryCatalog_create_hash_index(QueryCatalog* catalog, const char* componentName, const char* fieldName);
+
+// Drop a hash index (QUERY_ERROR_EXECUTION if there is none)
+QueryStatus QueryCatalog_drop_hash_index(QueryCatalog* catalog, const char* componentName, const char* fieldName);
+
+// Hash index over field, or NULL (for executor)
+HashIndex* QueryCatalog_find_hash_index(const QueryCatalog* catalog, const QueryField* field);
+
+// Count a lookup served by a hash index (for executor)
+void QueryCatalog_record_hash_lookup(QueryCatalog* catalog, const QueryField* field);
+
+// entryCount, memoryBytes, buildMs and scans (lookups) of a hash index
+QueryStatus QueryCatalog_get_hash_index_stats(const QueryCatalog* catalog,
+                                              const char* componentName,
+                                              const char* fieldName,
+                                              QueryIndexStats* outStats);
+
+// Designate (xField, yField) of a component as its position and build a grid
+// with cells of cellSize over it; replaces any previous spatial index on the
+// component. Both fields must be registered.
+QueryStatus QueryCatalog_create_spatial_index(QueryCatalog* catalog,
+                                              const char* componentName,
+                                              const char* xField,
+                                              const char* yField,
+                                              double cellSize);
+
+// Drop a component's spatial index (QUERY_ERROR_EXECUTION if there is none)
+QueryStatus QueryCatalog_drop_spatial_index(QueryCatalog* catalog, const char* componentName);
+
+// Spatial index of a component type and its position fields, or NULL (for executor)
+SpatialIndex* QueryCatalog_find_spatial_index(const QueryCatalog* catalog,
+                                              ComponentTypeId typeId,
+                                              QueryField* outX,
+                                              QueryField* outY);
+
+// Count a proximity query served by a spatial index (for executor)
+void QueryCatalog_record_spatial_scan(QueryCatalog* catalog, ComponentTypeId typeId);
+
+QueryStatus QueryCatalog_get_spatial_stats(const QueryCatalog* catalog,
+                                           const char* componentName,
+                                           QueryIndexStats* outStats);
+
+// Track writes to a component type for CHANGED(); starts with no changes
+QueryStatus QueryCatalog_track_changes(QueryCatalog* catalog, const char* componentName);
+
+// Start a new change window: forget every recorded change
+void QueryCatalog_clear_changes(QueryCatalog* catalog);
+
+// Entities written in the current window, possibly including ones that have
+// since lost the component; false if the type is not tracked or a write in
+// the window could not be recorded (for executor)
+bool QueryCatalog_get_changes(const QueryCatalog* catalog,
+                              ComponentTypeId typeId,
+                              const EntityId** outEntities,
+                              size_t* outCount);
+
+// Whether entity's component of typeId was written in the current window (for executor)
+bool QueryCatalog_is_changed(const QueryCatalog* catalog, EntityId entity, ComponentTypeId typeId);
+
+// Keep indexes and change tracking up to date with structural and data
+// changes. notify_write returns false if an index or tracker could not record
+// the write (out of memory); CHANGED on that type then fails until the next
+// clear. notify_destroy also drops the entity's recorded changes.
+bool QueryCatalog_notify_write(QueryCatalog* catalog, EntityId entity, ComponentTypeId typeId);
+void QueryCatalog_notify_remove(QueryCatalog* catalog, EntityId entity, ComponentTypeId typeId);
+void QueryCatalog_notify_destroy(QueryCatalog* catalog, EntityId entity);
+
+// Execute a query string with field filters and indexes available.
+// Also accepts CREATE [HASH] INDEX ON Component.field.
+QueryStatus QueryCatalog_execute(QueryCatalog* catalog, const char* queryString, QueryEngineResult* outResult);
+
+#endif // GRAMARYE_QUERY_CATALOG_H
@@ -0,0 +1,111 @@
+#ifndef GRAMARYE_QUERY_ENGINE_H
+#define GRAMARYE_QUERY_ENGINE_H
+
+#include "gramarye_ecs/ecs.h"
+#include "query.h"
+#include "explain.h"
+#include "allocator.h"
+#include "trace.h"
+#include "shapes.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Long-lived query context for one ECS.
+//
+// Query_execute and friends are stateless: every call parses and resolves
+// names again and nothing is kept between calls. A QueryEngine owns what is
+// worth keeping instead:
+//   - a QueryCatalog, so field filters, indexes and CREATE INDEX work on
+//     every query executed through the engine
+//   - a plan cache: each distinct query string is parsed and its component
+//     names resolved once, later executions reuse the compiled QueryPlan
+//   - a QuerySymbolTable the parser resolves component names through
+//   - execution statistics, overall and per query shape (see shapes.h)
+//   - optionally a QueryTracer recording execution spans (see trace.h)
+//
+// Everything the engine allocates on behalf of its queries comes from the
+// QueryAllocator in its config, and each result reports the bytes, blocks
+// and peak live bytes its query used in QueryEngineResult.memory. Results
+// hold blocks of that allocator, so free them before destroying the engine.
+// With a queryMemoryBudget, a query whose live bytes would pass the budget
+// fails with QUERY_ERROR_EXECUTION and returns no result; memory.refused
+// says why. A plan the query compiles counts against it while it is cached.
+//
+// Executing through an engine gives the same results as QueryCatalog_execute
+// on its catalog. Plans resolve component names when first prepared; a query
+// that finds component types registered since drops the cached plans first,
+// and QueryEngine_schema_changed does the same eagerly.
+//
+// An engine belongs to one thread. Engines are independent, so worker threads
+// can each hold their own engine over the same read-only ECS.
+
+typedef struct QueryEngine QueryEngine;
+typedef struct QueryCatalog QueryCatalog;
+
+// Default plan cache size
+#define QUERY_ENGINE_DEFAULT_PLAN_ENTRIES 64
+
+// Default number of query shapes with their own statistics
+#define QUERY_ENGINE_DEFAULT_SHAPE_ENTRIES 256
+
+typedef struct {
+    size_t planCacheEntries;    // Query strings kept as compiled plans; 0 disables the cache
+    const QueryAllocator* allocator;    // NULL for libcore ALLOC/FREE; must outlive the engine
+    QueryTracer* tracer;        // NULL to trace nothing; must outlive the engine
+    size_t shapeEntries;        // Query shapes tracked with a latency histogram each; 0 disables
+    uint64_t queryMemoryBudget; // Bytes one query may hold live at once; 0 for no limit
+} QueryEngineConfig;
+
+typedef struct {
+    uint64_t queries;
+    uint64_t failures;
+    uint64_t planHits;
+    uint64_t planMisses;        // Plannable queries compiled on this call
+    uint64_t planEvictions;     // Least recently used plans dropped to stay under the bound
+    size_t planCount;
+    double totalMs;             // Wall-clock (monotonic) time spent in QueryEngine_execute
+    double maxMs;
+    uint64_t bytesAllocated;    // Summed over queries
+    uint64_t peakBytes;         // Highest peak of a single query
+} QueryEngineStats;
+
+// Default configuration
+QueryEngineConfig QueryEngineConfig_default(void);
+
+// Create an engine for ecs; config may be NULL for the defaults
+QueryEngine* QueryEngine_new(ECS* ecs, const QueryEngineConfig* config);
+
+// Destroy the engine, its catalog and its plans
+void QueryEngine_destroy(QueryEngine* engine);
+
+// Execute a query string (result owned by the caller as with Query_execute)
+QueryStatus QueryEngine_execute(QueryEngine* engine, const char* queryString, QueryEngineResult* outResult);
+
+// Execute as EXPLAIN ANALYZE: as QueryEngine_execute, and outResult->stats
+// also holds the operator tree that ran, with rows and time per operator
+QueryStatus QueryEngine_analyze(QueryEngine* engine, const char* queryString, QueryEngineResult* outResult);
+
+// Plan a query against the engine's catalog without executing it (see
+// Query_explain). Free outExplain with QueryExplain_free.
+QueryStatus QueryEngine_explain(QueryEngine* engine, const char* queryString, QueryExplain* outExplain);
+
+// Start or stop tracing this engine's queries (NULL stops)
+void QueryEngine_set_tracer(QueryEngine* engine, QueryTracer* tracer);
+
+// The engine's catalog, for registering fields and maintaining indexes
+QueryCatalog* QueryEngine_get_catalog(QueryEngine* engine);
+
+ECS* QueryEngine_get_ecs(const QueryEngine* engine);
+
+// Pick up newly registered component types and drop every cached plan
+void QueryEngine_schema_changed(QueryEngine* engine);
+
+// Statistics; resetting also forgets the query shapes
+QueryEngineStats QueryEngine_get_stats(const QueryEngine* engine);
+void QueryEngine_reset_stats(QueryEngine* engine);
+
+// Calls, failures, rows and latency per query shape, NULL when shapeEntries
+// is 0. Latency is wall-clock time in QueryEngine_execute / QueryEngine_analyze.
+const QueryShapeTable* QueryEngine_get_shapes(const QueryEngine* engine);
+
+#endif // GRAMARYE_QUERY_ENGINE_H
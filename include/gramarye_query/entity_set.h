@@ -0,0 +1,71 @@
+#ifndef GRAMARYE_QUERY_ENTITY_SET_H
+#define GRAMARYE_QUERY_ENTITY_SET_H
+
+#include "gramarye_ecs/entity.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Entity sets used internally by the query engine (exposed for executor).
+//
+// EntityIds are 128-bit UUIDs, so set operations work on dense 32-bit indices
+// handed out by an EntityIndexMap. A set is a bitset over those indices.
+
+#define ENTITY_INDEX_INVALID UINT32_MAX
+
+// EntityId <-> dense index mapping (open addressing, grow-only)
+typedef struct EntityIndexMap EntityIndexMap;
+
+EntityIndexMap* EntityIndexMap_new(size_t initialCapacity);
+void EntityIndexMap_destroy(EntityIndexMap* map);
+
+// Index for entity, assigning the next free index on first sight
+uint32_t EntityIndexMap_get_or_add(EntityIndexMap* map, EntityId entity);
+
+// Index for entity, or ENTITY_INDEX_INVALID if it has never been added
+uint32_t EntityIndexMap_find(const EntityIndexMap* map, EntityId entity);
+
+// Forget every entity, keeping the allocation; indices start again from 0
+void EntityIndexMap_clear(EntityIndexMap* map);
+
+// Entity for a dense index (index must be < EntityIndexMap_count)
+EntityId EntityIndexMap_entity_at(const EntityIndexMap* map, uint32_t index);
+
+size_t EntityIndexMap_count(const EntityIndexMap* map);
+
+// Bytes held by the map
+size_t EntityIndexMap_memory_bytes(const EntityIndexMap* map);
+
+// Bitset over dense indices. Bits past wordCount are zero.
+typedef struct {
+    uint64_t* words;
+    size_t wordCount;
+} EntityBitset;
+
+bool EntityBitset_init(EntityBitset* set, size_t bitCapacity);
+void EntityBitset_free(EntityBitset* set);
+bool EntityBitset_copy(EntityBitset* dst, const EntityBitset* src);
+
+// Set a bit, growing the set if needed
+bool EntityBitset_set(EntityBitset* set, uint32_t index);
+bool EntityBitset_test(const EntityBitset* set, uint32_t index);
+
+// Clear a bit (no-op past the end of the set)
+void EntityBitset_unset(EntityBitset* set, uint32_t index);
+
+// In-place operations: dst = dst op src
+void EntityBitset_and(EntityBitset* dst, const EntityBitset* src);
+bool EntityBitset_or(EntityBitset* dst, const EntityBitset* src);
+void EntityBitset_andnot(EntityBitset* dst, const EntityBitset* src);
+
+size_t EntityBitset_count(const EntityBitset* set);
+
+// Write the EntityIds of up to maxCount set bits to outEntities, in index order
+size_t EntityBitset_materialize(const EntityBitset* set, const EntityIndexMap* map, EntityId* outEntities, size_t maxCount);
+
+// Sort entities ascending by (high, low). Large arrays use an LSD radix sort
+// over the 16 key bytes, skipping bytes that every id shares; returns false
+// only if its scratch buffer could not be allocated (entities is untouched).
+bool EntityId_sort(EntityId* entities, size_t count);
+
+#endif // GRAMARYE_QUERY_ENTITY_SET_H
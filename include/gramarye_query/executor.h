@@ -7,13 +7,167 @@
 // Include query.h to get QueryStatus and QueryEngineResult
 // This is safe because we include it AFTER ECS headers, so ECS QueryResult is already defined
 #include "query.h"
+#include "explain.h"
+#include "catalog.h"
+#include <stdbool.h>
 
 // Forward declarations
 typedef struct QueryAST QueryAST;
+typedef struct QueryCatalog QueryCatalog;
+
+// A WHERE clause compiled once for many executions: component names resolved
+// to type ids, filter fields to their QueryField offsets, and the sorted, hash
+// and spatial indexes looked up. Literals and placeholders are substituted
+// per execution, so executing one resolves no names. The condition AST must
+// outlive it, and it holds index pointers: compile again when
+// QueryCatalog_schema_version moves.
+typedef struct QueryCondition QueryCondition;
+
+// LIMIT value meaning "no limit"
+#define QUERY_LIMIT_NONE UINT64_MAX
+
+// Read the LIMIT of a SELECT AST (QUERY_LIMIT_NONE if absent).
+// Returns QUERY_ERROR_INVALID_SYNTAX if the limit is an unbound placeholder.
+QueryStatus QueryExecutor_get_limit(QueryAST* ast, uint64_t* outLimit);
+
+// Evaluation budget of COUNT ... APPROX without an explicit sample size
+#define QUERY_APPROX_DEFAULT_SAMPLES 4096
+
+// Read the SAMPLE / APPROX clause of a SELECT/COUNT AST (SAMPLE_NONE if absent).
+// outSize receives the clause's size, with the APPROX default filled in.
+SampleMode QueryExecutor_get_sampling(QueryAST* ast, uint64_t* outSize);
+
+// Execute a SELECT ... SAMPLE or COUNT ... APPROX over any WHERE clause.
+// Candidates come from the same sources a full execution would use (component
+// storage, indexes) and are split into strata of consecutive storage; only
+// sampled candidates are tested against the condition, so the cost follows
+// sampleSize rather than the world size. SAMPLE returns up to sampleSize
+// distinct matching entities drawn uniformly at random. APPROX returns the
+// estimate in count and a QueryCountEstimate in data. Sampling is seeded
+// deterministically, so an unchanged world gives the same answer.
+QueryStatus QueryExecutor_execute_sampled(ECS* ecs,
+                                          QueryCatalog* catalog,
+                                          ASTNodeType queryType,
+                                          QueryAST* condition,
+                                          const double* paramValues,
+                                          size_t paramCount,
+                                          SampleMode mode,
+                                          uint64_t sampleSize,
+                                          QueryEngineResult* outResult);
+
+// As QueryExecutor_execute_sampled over a compiled WHERE clause
+QueryStatus QueryExecutor_execute_compiled_sampled(QueryCondition* condition,
+                                                   ASTNodeType queryType,
+                                                   const double* paramValues,
+                                                   size_t paramCount,
+                                                   SampleMode mode,
+                                                   uint64_t sampleSize,
+                                                   QueryEngineResult* outResult);
+
+// Execute SELECT APPROX_COUNT_DISTINCT(...) / APPROX_PERCENTILE(...) [WHERE ...].
+// Needs a catalog for the field. The matching entities' values stream once
+// through a HyperLogLog or KLL sketch; the answer is a QueryAggregateResult in data.
+QueryStatus QueryExecutor_execute_aggregate(ECS* ecs,
+                                            QueryCatalog* catalog,
+                                            QueryAST* ast,
+                                            const double* paramValues,
+                                            size_t paramCount,
+                                            QueryEngineResult* outResult);
+
+// As QueryExecutor_execute_aggregate with the aggregated field already
+// resolved and the WHERE clause compiled (NULL when ast has none)
+QueryStatus QueryExecutor_execute_compiled_aggregate(ECS* ecs,
+                                                     QueryAST* ast,
+                                                     const QueryField* field,
+                                                     QueryCondition* condition,
+                                                     const double* paramValues,
+                                                     size_t paramCount,
+                                                     QueryEngineResult* outResult);
+
+// Execute a SELECT/COUNT over already resolved component types
+QueryStatus QueryExecutor_execute_entities(ECS* ecs,
+                                           ASTNodeType queryType,
+                                           ASTNodeType predicateType,
+                                           const ComponentTypeId* typeIds,
+                                           size_t typeCount,
+                                           uint64_t limit,
+                                           QueryEngineResult* outResult);
+
+// Execute SHOW for an entity: all components, or the resolved typeId
+QueryStatus QueryExecutor_show(ECS* ecs,
+                               EntityId entity,
+                               bool showAll,
+                               ComponentTypeId typeId,
+                               QueryEngineResult* outResult);
 
 // Execute a parsed query AST (uses QueryEngineResult to avoid conflict with ECS QueryResult)
 QueryStatus QueryExecutor_execute(ECS* ecs, QueryAST* ast, QueryEngineResult* outResult);
 
+// Execute a parsed query AST with field filters resolved through catalog (may be
+// NULL, in which case filters fail). paramValues[i] is the value bound to
+// placeholder i + 1 in filters.
+QueryStatus QueryExecutor_execute_catalog(ECS* ecs,
+                                          QueryCatalog* catalog,
+                                          QueryAST* ast,
+                                          const double* paramValues,
+                                          size_t paramCount,
+                                          QueryEngineResult* outResult);
+
+// Execute a SELECT/COUNT whose WHERE clause is a filter or an AND/OR condition
+QueryStatus QueryExecutor_execute_condition(ECS* ecs,
+                                            QueryCatalog* catalog,
+                                            ASTNodeType queryType,
+                                            QueryAST* condition,
+                                            const double* paramValues,
+                                            size_t paramCount,
+                                            uint64_t limit,
+                                            QueryEngineResult* outResult);
+
+// Compile a WHERE clause against ecs and catalog (may be NULL, in which case
+// filters fail). Returns NULL with the error in outStatus, as executing it
+// would have failed.
+QueryCondition* QueryCondition_compile(ECS* ecs, QueryCatalog* catalog, QueryAST* condition, QueryStatus* outStatus);
+
+void QueryCondition_destroy(QueryCondition* condition);
+
+// As QueryExecutor_execute_condition over a compiled WHERE clause
+QueryStatus QueryExecutor_execute_compiled(QueryCondition* condition,
+                                           ASTNodeType queryType,
+                                           const double* paramValues,
+                                           size_t paramCount,
+                                           uint64_t limit,
+                                           QueryEngineResult* outResult);
+
+// EXPLAIN a WHERE clause: compile it as QueryExecutor_execute_condition
+// would, and append the operators it would run below depth, with estimated
+// rows and cost, without generating any entities
+QueryStatus QueryExecutor_explain_condition(ECS* ecs,
+                                            QueryCatalog* catalog,
+                                            QueryAST* condition,
+                                            const double* paramValues,
+                                            size_t paramCount,
+                                            uint32_t depth,
+                                            QueryExplain* explain,
+                                            uint64_t* outRows,
+                                            uint64_t* outCost);
+
+// True for a bare has/has_any/not_has predicate (the forms every fast path handles)
+bool QueryExecutor_is_component_predicate(QueryAST* predicate);
+
+// Resolve component names to ComponentTypeIds, skipping unknown names.
+// outTypeIds must hold componentList->count entries. Returns the number resolved.
+size_t QueryExecutor_resolve_components(ECS* ecs, const ComponentList* componentList, ComponentTypeId* outTypeIds);
+
+// Canonical form of a component list: resolved, sorted and deduplicated.
+// has/has_any/not_has are order-insensitive, so equal canonical forms mean
+// equal predicates. Returns the number of ids written.
+size_t QueryExecutor_canonical_components(ECS* ecs, const ComponentList* componentList, ComponentTypeId* outTypeIds);
+
+// Write a predicate such as "has(Position, Health)" for plan output (has,
+// has_any, not_has or changed). Truncates to size; returns the length written.
+size_t QueryExecutor_describe_components(ECS* ecs, ASTNodeType predicateType, const ComponentTypeId* typeIds,
+                                         size_t typeCount, char* buffer, size_t size);
+
 // Execute a simple entity query by component types
 QueryStatus QueryExecutor_query_entities(ECS* ecs, 
                                         const char* componentNames[], 
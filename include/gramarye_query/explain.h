@@ -0,0 +1,98 @@
+#ifndef GRAMARYE_QUERY_EXPLAIN_H
+#define GRAMARYE_QUERY_EXPLAIN_H
+
+#include "gramarye_ecs/ecs.h"
+#include "gramarye_ecs/component.h"
+#include "parser.h"
+#include "query.h"
+#include "profile.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// EXPLAIN: the plan a query would run, without running it.
+//
+// The operator tree is the one EXPLAIN ANALYZE reports for the same query
+// (same labels, same driving child for every AND), with estimated rows and
+// cost instead of measured ones. Cost counts entities touched: read from
+// storage or an index, or tested per entity. Estimates come from component
+// populations, index statistics and recorded changes; no condition is
+// evaluated and no result is built. Filters that have to scan use fixed
+// selectivities, as no value distribution is kept for unindexed fields.
+
+typedef struct QueryCatalog QueryCatalog;
+
+// Estimate that cannot be made, e.g. rows of not_has() without an entity count
+#define QUERY_ESTIMATE_UNKNOWN UINT64_MAX
+
+// How the plan reads its first entities
+typedef enum {
+    QUERY_ACCESS_NONE,          // Nothing to read (SHOW, or no valid components)
+    QUERY_ACCESS_SCAN,          // Component storage
+    QUERY_ACCESS_INDEX,         // Sorted field index range
+    QUERY_ACCESS_HASH,          // Hash index probes
+    QUERY_ACCESS_SPATIAL,       // Spatial grid cells
+    QUERY_ACCESS_CHANGES        // Recorded component changes
+} QueryAccessPath;
+
+typedef struct {
+    char label[QUERY_OPERATOR_LABEL];   // As in QueryOperatorStats
+    uint32_t depth;             // 0 for the root; nodes are in pre-order
+    uint64_t rows;              // Estimated entities passed on
+    uint64_t cost;              // Estimated entities touched, including children
+} QueryExplainNode;
+
+// Component population seen while explaining (exposed for the executor)
+typedef struct {
+    ComponentTypeId typeId;
+    uint64_t count;
+} QueryPopulation;
+
+typedef struct {
+    ECS* ecs;                       // World explained, for component names
+    QueryExplainNode* nodes;
+    size_t nodeCount;
+    size_t nodeCapacity;
+    ComponentTypeId drivingType;    // Component read first, COMPONENT_TYPE_INVALID if none
+    QueryAccessPath access;         // How it is read
+    uint64_t rows;                  // Root's estimates
+    uint64_t cost;
+    QueryPopulation* populations;   // Each component counted once per explain
+    size_t populationCount;
+    bool failed;                    // A node or population could not be stored
+} QueryExplain;
+
+// Plan queryString without executing it. catalog may be NULL, in which case
+// field filters, spatial and CHANGED conditions fail as they do in
+// Query_execute. Free outExplain with QueryExplain_free, also on failure.
+QueryStatus Query_explain(ECS* ecs, QueryCatalog* catalog, const char* queryString, QueryExplain* outExplain);
+
+// Write the tree and the driving access as text, snprintf style: returns the
+// length of the full text, of which at most size - 1 bytes are written
+size_t QueryExplain_format(const QueryExplain* explain, char* buffer, size_t size);
+
+void QueryExplain_free(QueryExplain* explain);
+
+// Name of an access path ("scan", "index", ...)
+const char* QueryAccessPath_name(QueryAccessPath access);
+
+// Append a node (for the executor). Returns its slot, or SIZE_MAX when out of memory.
+size_t QueryExplain_add(QueryExplain* explain, uint32_t depth, const char* label, uint64_t rows, uint64_t cost);
+
+// Record the plan's first read unless one is recorded already (for the executor)
+void QueryExplain_set_driving(QueryExplain* explain, ComponentTypeId typeId, QueryAccessPath access);
+
+// Entities holding a component (for the executor). The ECS keeps no
+// counters, so this is a single-component query, made once per component.
+uint64_t QueryExplain_population(QueryExplain* explain, ECS* ecs, ComponentTypeId typeId);
+
+// Estimate a component predicate (has, has_any, not_has) and, with append,
+// add it as a "Scan" node at depth (for the executor)
+void QueryExplain_components(QueryExplain* explain, ECS* ecs, bool append, uint32_t depth, ASTNodeType predicateType,
+                             const ComponentTypeId* typeIds, size_t typeCount, uint64_t* outRows, uint64_t* outCost);
+
+// Saturating arithmetic on estimates; QUERY_ESTIMATE_UNKNOWN absorbs
+uint64_t QueryEstimate_add(uint64_t a, uint64_t b);
+uint64_t QueryEstimate_scale(uint64_t rows, double factor);
+
+#endif // GRAMARYE_QUERY_EXPLAIN_H
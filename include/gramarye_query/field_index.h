@@ -0,0 +1,58 @@
+#ifndef GRAMARYE_QUERY_FIELD_INDEX_H
+#define GRAMARYE_QUERY_FIELD_INDEX_H
+
+#include "gramarye_ecs/entity.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Sorted secondary index from a numeric field value to entities (exposed for
+// executor).
+//
+// Entries live in a sorted array ordered by (value, entity). Updates do not
+// shift that array: inserts go to a small unsorted delta and removals mark
+// the sorted entry dead. The delta and the dead entries are merged back in
+// once they exceed a fraction of the index, so updates stay amortized
+// O(log n) and range scans stay a binary search plus a contiguous walk.
+//
+// Values are stored as doubles; 64-bit integers above 2^53 lose precision.
+// NaN values are not indexed (no range predicate can match them).
+
+typedef struct FieldIndex FieldIndex;
+
+// An inclusive or exclusive bound on each side; use -INFINITY/INFINITY for open ends
+typedef struct {
+    double low;
+    double high;
+    bool lowInclusive;
+    bool highInclusive;
+} FieldRange;
+
+FieldIndex* FieldIndex_new(void);
+void FieldIndex_destroy(FieldIndex* index);
+
+// Replace the contents with entities[i] -> values[i] in one sort
+bool FieldIndex_build(FieldIndex* index, const EntityId* entities, const double* values, size_t count);
+
+// Insert an entity or move it to a new value
+bool FieldIndex_set(FieldIndex* index, EntityId entity, double value);
+
+// Remove an entity (no-op if absent)
+void FieldIndex_remove(FieldIndex* index, EntityId entity);
+
+// Live entries
+size_t FieldIndex_count(const FieldIndex* index);
+
+// Upper bound on the entries in range: exact unless removals are pending
+size_t FieldIndex_estimate_range(const FieldIndex* index, FieldRange range);
+
+// Write up to maxCount live entities in range to outEntities; returns the number written
+size_t FieldIndex_collect_range(const FieldIndex* index, FieldRange range, EntityId* outEntities, size_t maxCount);
+
+// Entries waiting in the delta (not yet merged into the sorted array)
+size_t FieldIndex_pending(const FieldIndex* index);
+
+// Bytes held by the index, including its entity map
+size_t FieldIndex_memory_bytes(const FieldIndex* index);
+
+#endif // GRAMARYE_QUERY_FIELD_INDEX_H
@@ -0,0 +1,55 @@
+#ifndef GRAMARYE_QUERY_FRAME_H
+#define GRAMARYE_QUERY_FRAME_H
+
+#include "gramarye_ecs/ecs.h"
+#include "query.h"
+#include "roaring.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Frame-scoped evaluation context.
+//
+// Queries executed through a frame share their sub-predicates: every
+// has(X) / not_has(X) term and every canonical ComponentList (resolved,
+// sorted, deduplicated) is computed once into a compressed entity set
+// (RoaringBitmap over the frame's dense entity indices) and reused by later
+// queries in the same frame. has(Position, Velocity, Health) and
+// has(Velocity, Position, Sprite) both reuse the Position and Velocity sets.
+//
+// The ECS structure is assumed not to change between QueryFrame_begin and
+// QueryFrame_end; component data may change freely.
+
+typedef struct QueryFrame QueryFrame;
+
+typedef struct {
+    uint64_t queries;       // Queries executed in the frame
+    uint64_t memoHits;      // Sub-predicates served from the frame
+    uint64_t memoMisses;    // Sub-predicates computed from the ECS
+    size_t setCount;        // Entity sets held by the frame
+    size_t entityCount;     // Distinct entities seen by the frame
+    size_t setBytes;        // Memory held by the cached sets
+} QueryFrameStats;
+
+// Begin a frame over ecs
+QueryFrame* QueryFrame_begin(ECS* ecs);
+
+// End a frame, releasing every cached set
+void QueryFrame_end(QueryFrame* frame);
+
+// Execute a query string within the frame (result owned by the caller)
+QueryStatus QueryFrame_execute(QueryFrame* frame, const char* queryString, QueryEngineResult* outResult);
+
+// Execute a query within the frame and return its entities as a bitmap of
+// frame indices instead of an EntityId array (owned by the caller; decode with
+// QueryFrame_entity_at or RoaringBitmap_materialize). LIMIT is ignored and
+// SHOW queries fail. Indices stay valid until QueryFrame_end.
+QueryStatus QueryFrame_execute_bitmap(QueryFrame* frame, const char* queryString, RoaringBitmap** outSet);
+
+// EntityId behind a frame index; false if the frame has not handed it out
+bool QueryFrame_entity_at(const QueryFrame* frame, uint32_t index, EntityId* outEntity);
+
+// Statistics for the frame so far
+QueryFrameStats QueryFrame_get_stats(const QueryFrame* frame);
+
+#endif // GRAMARYE_QUERY_FRAME_H
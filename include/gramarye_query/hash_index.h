@@ -0,0 +1,44 @@
+#ifndef GRAMARYE_QUERY_HASH_INDEX_H
+#define GRAMARYE_QUERY_HASH_INDEX_H
+
+#include "gramarye_ecs/entity.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Hash index from a discrete field value to entities (exposed for executor).
+//
+// Keys are the raw 64-bit integer values of the field. Each distinct key
+// owns a compact array of the entities holding it, found through an open
+// addressing table, so an equality lookup costs one probe plus the size of
+// the answer. Updates move an entity between two arrays with O(1)
+// swap-removes. Keys whose last entity leaves keep their (empty) array so
+// that enum-like fields flipping back and forth do not reallocate.
+
+typedef struct HashIndex HashIndex;
+
+HashIndex* HashIndex_new(void);
+void HashIndex_destroy(HashIndex* index);
+
+// Insert an entity or move it to a new key
+bool HashIndex_set(HashIndex* index, EntityId entity, uint64_t key);
+
+// Remove an entity (no-op if absent)
+void HashIndex_remove(HashIndex* index, EntityId entity);
+
+// Live entries
+size_t HashIndex_count(const HashIndex* index);
+
+// Entities holding key
+size_t HashIndex_count_key(const HashIndex* index, uint64_t key);
+
+// Write up to maxCount entities holding key to outEntities; returns the number written
+size_t HashIndex_collect(const HashIndex* index, uint64_t key, EntityId* outEntities, size_t maxCount);
+
+// Distinct keys currently held by at least one entity
+size_t HashIndex_key_count(const HashIndex* index);
+
+// Bytes held by the index, including its entity map
+size_t HashIndex_memory_bytes(const HashIndex* index);
+
+#endif // GRAMARYE_QUERY_HASH_INDEX_H
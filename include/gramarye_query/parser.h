@@ -1,12 +1,15 @@
 #ifndef GRAMARYE_QUERY_PARSER_H
 #define GRAMARYE_QUERY_PARSER_H
 
+#include "gramarye_ecs/component.h"
 #include <stddef.h>
 #include <stdint.h>
+#include <stdbool.h>
 
 // Forward declarations
 typedef struct QueryAST QueryAST;
 typedef struct QueryParser QueryParser;
+typedef struct QuerySymbolTable QuerySymbolTable;
 
 // Query AST node types (exposed for executor)
 typedef enum {
@@ -19,12 +22,18 @@ typedef enum {
     AST_NOT_HAS,
     AST_FILTER,
     AST_AND,
-    AST_OR
+    AST_OR,
+    AST_CREATE_INDEX,
+    AST_WITHIN,
+    AST_INSIDE,
+    AST_CHANGED,
+    AST_AGGREGATE
 } ASTNodeType;
 
 // Data structures for AST nodes (exposed for executor)
 typedef struct {
     char** componentNames;
+    ComponentTypeId* typeIds;   // Resolved while lexing when the parser has a symbol table, else NULL
     size_t count;
 } ComponentList;
 
@@ -35,9 +44,91 @@ typedef struct {
 
 typedef struct {
     char* componentName;  // NULL for "ALL"
-    EntityIdData* entityId;
+    EntityIdData* entityId;  // NULL when the id is a placeholder
+    size_t entityParam;      // 1-based placeholder index, 0 for a literal id
+    bool typeResolved;       // typeId came from the parser's symbol table
+    ComponentTypeId typeId;
 } ShowQueryData;
 
+// Comparison in a field filter
+typedef enum {
+    FILTER_OP_EQ,
+    FILTER_OP_NE,
+    FILTER_OP_LT,
+    FILTER_OP_LE,
+    FILTER_OP_GT,
+    FILTER_OP_GE,
+    FILTER_OP_BETWEEN,  // value <= field <= upper
+    FILTER_OP_IN        // field equals one of values
+} FilterOp;
+
+// Data for AST_FILTER nodes: Component.field <op> value
+typedef struct {
+    char* componentName;
+    char* fieldName;
+    FilterOp op;
+    double value;            // Right-hand side (lower bound for BETWEEN)
+    double upper;            // Upper bound for BETWEEN
+    size_t valueParam;       // 1-based placeholder index, 0 for a literal
+    size_t upperParam;
+    double* values;          // IN list
+    size_t* valueParams;     // Placeholder index per IN value, 0 for a literal
+    size_t valueCount;
+} FilterData;
+
+// Data for AST_CREATE_INDEX nodes: CREATE [HASH] INDEX ON Component.field
+typedef struct {
+    char* componentName;
+    char* fieldName;
+    bool hash;               // Hash index instead of a sorted one
+} IndexQueryData;
+
+// Data for AST_WITHIN / AST_INSIDE nodes:
+//   WITHIN(Component, x, y, radius)     args = {x, y, radius}
+//   INSIDE(Component, x0, y0, x1, y1)   args = {x0, y0, x1, y1}
+typedef struct {
+    char* componentName;
+    bool typeResolved;       // typeId came from the parser's symbol table
+    ComponentTypeId typeId;
+    double args[4];
+    size_t argParams[4];     // 1-based placeholder index per argument, 0 for a literal
+    size_t argCount;
+} SpatialQueryData;
+
+// Sampling requested by a SELECT/COUNT
+typedef enum {
+    SAMPLE_NONE,
+    SAMPLE_ROWS,             // SELECT ... SAMPLE n: n matching entities drawn at random
+    SAMPLE_APPROX            // COUNT ... APPROX [n]: estimate from about n evaluations
+} SampleMode;
+
+// Data for SELECT/COUNT nodes with a LIMIT, SAMPLE or APPROX clause (NULL data
+// means none of them)
+typedef struct {
+    uint64_t limit;          // UINT64_MAX without a LIMIT clause
+    size_t limitParam;       // 1-based placeholder index, 0 for a literal limit
+    SampleMode sampleMode;
+    uint64_t sampleSize;     // Rows for SAMPLE, evaluation budget for APPROX (0 = default)
+} SelectQueryData;
+
+// Aggregate computed by SELECT <aggregate>(Component.field, ...) [WHERE ...]
+typedef enum {
+    AGGREGATE_COUNT_DISTINCT,    // APPROX_COUNT_DISTINCT(field)
+    AGGREGATE_PERCENTILE         // APPROX_PERCENTILE(field, p1, p2, ...)
+} AggregateKind;
+
+// Most percentiles one APPROX_PERCENTILE can ask for
+#define AGGREGATE_MAX_PERCENTILES 8
+
+// Data for AST_AGGREGATE nodes; left is the WHERE condition, if any
+typedef struct {
+    AggregateKind kind;
+    char* componentName;
+    char* fieldName;
+    double percentiles[AGGREGATE_MAX_PERCENTILES];   // Fractions in [0, 1]
+    size_t percentileCount;
+} AggregateQueryData;
+
 // Query token types
 typedef enum {
     TOKEN_SELECT,
@@ -53,9 +144,24 @@ typedef enum {
     TOKEN_ENTITY,
     TOKEN_ENTITIES,
     TOKEN_ALL,
+    TOKEN_LIMIT,
+    TOKEN_BETWEEN,
+    TOKEN_CREATE,
+    TOKEN_INDEX,
+    TOKEN_ON,
+    TOKEN_WITHIN,
+    TOKEN_INSIDE,
+    TOKEN_IN,
+    TOKEN_HASH,
+    TOKEN_CHANGED,
+    TOKEN_SAMPLE,
+    TOKEN_APPROX,
+    TOKEN_APPROX_COUNT_DISTINCT,
+    TOKEN_APPROX_PERCENTILE,
     TOKEN_IDENTIFIER,
     TOKEN_NUMBER,
     TOKEN_STRING,
+    TOKEN_PLACEHOLDER,  // ? or $1, $2, ...
     TOKEN_OPERATOR,  // >, <, =, >=, <=, !=
     TOKEN_LPAREN,
     TOKEN_RPAREN,
@@ -72,11 +178,16 @@ typedef struct Token {
     size_t length;
     size_t line;
     size_t column;
+    ComponentTypeId symbol;  // TOKEN_IDENTIFIER: component type from the symbol table, or COMPONENT_TYPE_INVALID
 } Token;
 
 // Create a new parser
 QueryParser* QueryParser_new(const char* queryString);
 
+// Create a parser that resolves component names through symbols while lexing
+// (symbols must outlive the parser; NULL behaves like QueryParser_new)
+QueryParser* QueryParser_new_with_symbols(const char* queryString, QuerySymbolTable* symbols);
+
 // Destroy parser
 void QueryParser_destroy(QueryParser* parser);
 
@@ -89,6 +200,9 @@ Token QueryParser_peek_token(QueryParser* parser);
 // Parse query into AST
 QueryAST* QueryParser_parse(QueryParser* parser);
 
+// Number of placeholder parameters seen by the last parse (highest index)
+size_t QueryParser_get_param_count(QueryParser* parser);
+
 // Destroy AST
 void QueryAST_destroy(QueryAST* ast);
 
@@ -0,0 +1,69 @@
+#ifndef GRAMARYE_QUERY_PLAN_H
+#define GRAMARYE_QUERY_PLAN_H
+
+#include "gramarye_ecs/ecs.h"
+#include "gramarye_ecs/entity.h"
+#include "query.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Prepared queries with bound parameters.
+//
+// A query string may contain placeholders where a literal would go: "?"
+// takes the next parameter index, "$N" names index N (1-based) and may be
+// repeated. Placeholders are accepted for the entity id of SHOW, the value of
+// a SELECT LIMIT clause, the right-hand side of a field filter and the
+// arguments of WITHIN / INSIDE:
+//   SHOW Health OF entity ?
+//   SELECT entities WHERE has(Position) LIMIT $1
+//   SELECT entities WHERE Position.x BETWEEN ? AND ?
+//   SELECT entities WHERE WITHIN(Position, ?, ?, 25)
+//
+// QueryPlan_prepare parses the string and resolves component names once, and
+// compiles a WHERE clause with its field offsets and indexes; QueryPlan_execute
+// then runs the compiled plan with the current bindings without touching the
+// parser or looking up a name. A plan compiles its condition again after the
+// catalog's schema changes (fields registered, indexes created or dropped). Bindings persist across executions, so an
+// inspector panel only rebinds the entity id when the selection changes.
+//
+// Component names are resolved at prepare time. A component type registered
+// after the plan was prepared is not seen by it; prepare again.
+
+typedef struct QueryPlan QueryPlan;
+typedef struct QueryCatalog QueryCatalog;
+typedef struct QuerySymbolTable QuerySymbolTable;
+
+// Parse and compile queryString against ecs (NULL on parse error)
+QueryPlan* QueryPlan_prepare(ECS* ecs, const char* queryString);
+
+// As QueryPlan_prepare, with field filters resolved through catalog
+QueryPlan* QueryPlan_prepare_with_catalog(ECS* ecs, QueryCatalog* catalog, const char* queryString);
+
+// As QueryPlan_prepare_with_catalog, with component names resolved through
+// symbols while parsing instead of by ECS lookups (symbols may be NULL)
+QueryPlan* QueryPlan_prepare_with_symbols(ECS* ecs, QueryCatalog* catalog, QuerySymbolTable* symbols,
+                                          const char* queryString);
+
+// Destroy plan
+void QueryPlan_destroy(QueryPlan* plan);
+
+// Number of parameters (highest placeholder index)
+size_t QueryPlan_param_count(const QueryPlan* plan);
+
+// Bind parameter index (1-based). Returns QUERY_ERROR_INVALID_SYNTAX if the
+// index is out of range or the value does not fit the parameter: a LIMIT
+// takes an unsigned integer (a double must be integral and non-negative),
+// a filter or spatial value takes either number, an entity id takes an EntityId.
+QueryStatus QueryPlan_bind_u64(QueryPlan* plan, size_t index, uint64_t value);
+QueryStatus QueryPlan_bind_f64(QueryPlan* plan, size_t index, double value);
+QueryStatus QueryPlan_bind_entity(QueryPlan* plan, size_t index, EntityId entity);
+
+// Forget all bindings
+void QueryPlan_clear_bindings(QueryPlan* plan);
+
+// Execute with the current bindings (result owned by the caller as with
+// Query_execute). Returns QUERY_ERROR_INVALID_SYNTAX if a parameter used by
+// the query is unbound.
+QueryStatus QueryPlan_execute(QueryPlan* plan, QueryEngineResult* outResult);
+
+#endif // GRAMARYE_QUERY_PLAN_H
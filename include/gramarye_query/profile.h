@@ -0,0 +1,120 @@
+#ifndef GRAMARYE_QUERY_PROFILE_H
+#define GRAMARYE_QUERY_PROFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Per-query phase timing and EXPLAIN ANALYZE operator statistics.
+//
+// Entry points that return a result (Query_execute, QueryCatalog_execute,
+// QueryPlan_execute, QueryEngine_execute) open a QueryProfile on the calling
+// thread unless one is already open, and copy what it gathered into
+// QueryEngineResult.stats. Time is charged to one phase at a time: entering
+// a phase pauses the enclosing one, so phase times never overlap and the rest
+// of totalTicks is bookkeeping outside any phase.
+//
+// Timers read the monotonic clock, or the time stamp counter when built with
+// GRAMARYE_QUERY_PROFILE_RDTSC=1 on x86 (stats.cycles is then set). Build
+// with GRAMARYE_QUERY_PROFILE=0 to compile every timer out; stats then stay
+// zeroed.
+
+#ifndef GRAMARYE_QUERY_PROFILE
+#define GRAMARYE_QUERY_PROFILE 1
+#endif
+
+#ifndef GRAMARYE_QUERY_PROFILE_RDTSC
+#define GRAMARYE_QUERY_PROFILE_RDTSC 0
+#endif
+
+typedef enum {
+    QUERY_PHASE_LEX,            // Tokenizing, including symbol table probes
+    QUERY_PHASE_PARSE,          // Building the AST
+    QUERY_PHASE_RESOLVE,        // Component names to type ids, compiling conditions
+    QUERY_PHASE_SCAN,           // ECS storage, index lookups and per-entity tests
+    QUERY_PHASE_MATERIALIZE,    // Copying ids and component data into the result
+    QUERY_PHASE_COUNT,
+    QUERY_PHASE_NONE = QUERY_PHASE_COUNT
+} QueryPhase;
+
+// Longest operator label kept, including the terminator
+#define QUERY_OPERATOR_LABEL 96
+
+// One node of the executed plan tree
+typedef struct {
+    char label[QUERY_OPERATOR_LABEL];   // e.g. "Filter Health.hp < 20 [index]"
+    uint32_t depth;             // 0 for the root; nodes are in pre-order
+    uint64_t rowsIn;            // Entities the node examined
+    uint64_t rowsOut;           // Entities it passed on
+    uint64_t ticks;             // Including children; 0 for per-row checks
+} QueryOperatorStats;
+
+typedef struct {
+    uint64_t phaseTicks[QUERY_PHASE_COUNT];
+    uint64_t totalTicks;
+    bool cycles;                // Ticks are TSC cycles rather than nanoseconds
+    uint64_t lookups;           // Component and field names resolved by name
+    QueryOperatorStats* operators;  // Plan tree, EXPLAIN ANALYZE only (freed with the result)
+    size_t operatorCount;
+} QueryStats;
+
+// Profile being gathered (exposed for instrumentation)
+typedef struct QueryProfile {
+    QueryStats stats;
+    bool analyze;               // Record operators
+    size_t operatorCapacity;
+    uint32_t depth;
+    QueryPhase phase;           // Phase being charged
+    uint64_t phaseStart;
+    uint64_t start;
+} QueryProfile;
+
+// Open profile on this thread unless one is open already. Returns whether it
+// was opened; only then must it be closed with QueryProfile_leave.
+bool QueryProfile_enter(QueryProfile* profile, bool analyze);
+
+// Close profile and move what it gathered to outStats (which then owns the operators)
+void QueryProfile_leave(QueryProfile* profile, QueryStats* outStats);
+
+// Charge the running phase and switch to phase; returns the phase to switch back to
+QueryPhase QueryProfile_switch(QueryPhase phase);
+
+// Count a component or field name resolved by name (for the library's resolvers)
+void QueryProfile_count_lookup(void);
+
+// Whether operators are being recorded on this thread, for EXPLAIN ANALYZE
+// or a trace (see trace.h)
+bool QueryProfile_analyzing(void);
+
+// Record an operator below the innermost open one and start its clock.
+// Returns its slot for QueryProfile_end_operator (SIZE_MAX when neither
+// analyzing nor tracing, which end ignores).
+size_t QueryProfile_begin_operator(const char* label);
+void QueryProfile_end_operator(size_t slot, uint64_t rowsIn, uint64_t rowsOut);
+
+// Record a per-row check below the innermost open operator; its time is part of the parent's
+void QueryProfile_add_check(const char* label, uint64_t rowsIn, uint64_t rowsOut);
+
+// Milliseconds for a tick count of stats (0 when ticks are cycles)
+double QueryStats_ms(const QueryStats* stats, uint64_t ticks);
+
+// Write the phases and operator tree as text, snprintf style: returns the
+// length of the full text, of which at most size - 1 bytes are written
+size_t QueryStats_format(const QueryStats* stats, char* buffer, size_t size);
+
+// Release the operators
+void QueryStats_free(QueryStats* stats);
+
+#if GRAMARYE_QUERY_PROFILE
+#define QUERY_PHASE_BEGIN(saved, phase) QueryPhase saved = QueryProfile_switch(phase)
+#define QUERY_PHASE_END(saved) ((void)QueryProfile_switch(saved))
+#define QUERY_PROFILE_ANALYZING() QueryProfile_analyzing()
+#define QUERY_COUNT_LOOKUP() QueryProfile_count_lookup()
+#else
+#define QUERY_PHASE_BEGIN(saved, phase) ((void)0)
+#define QUERY_PHASE_END(saved) ((void)0)
+#define QUERY_PROFILE_ANALYZING() false
+#define QUERY_COUNT_LOOKUP() ((void)0)
+#endif
+
+#endif // GRAMARYE_QUERY_PROFILE_H
@@ -3,6 +3,9 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include "allocator.h"
+#include "profile.h"
 
 // Forward declarations
 // Note: EntityId and ECS QueryResult are defined in gramarye_ecs headers
@@ -20,6 +23,9 @@ struct QueryEngineResult {
     size_t count;
     size_t capacity;
     void* data;  // Additional result data (for component values, etc.)
+    const QueryAllocator* allocator;  // Source of entities and data; NULL when built with libcore ALLOC
+    QueryMemoryStats memory;  // What the query allocated (filled in by QueryEngine_execute)
+    QueryStats stats;  // Phase times, and the operator tree under EXPLAIN ANALYZE
 };
 
 // Typedef - always use QueryEngineResult to avoid conflict with ECS QueryResult
@@ -35,17 +41,95 @@ typedef enum {
     QUERY_ERROR_INVALID_SYNTAX
 } QueryStatus;
 
+// Result data of COUNT ... APPROX (QueryEngineResult.data, freed with the result)
+typedef struct {
+    double estimate;        // Estimated matches; count holds it rounded
+    double stdError;        // Standard error of the estimate (0 when exact)
+    double low;             // 95% confidence interval, clamped to [0, population]
+    double high;
+    size_t sampled;         // Candidates tested against the condition
+    size_t population;      // Candidates the estimate was drawn from
+} QueryCountEstimate;
+
+// Most values one APPROX_PERCENTILE returns
+#define QUERY_MAX_PERCENTILES 8
+
+// Result data of SELECT APPROX_COUNT_DISTINCT(...) / APPROX_PERCENTILE(...)
+// (QueryEngineResult.data, freed with the result). count holds the rounded
+// distinct estimate, or the number of percentile values.
+typedef struct {
+    uint64_t rows;          // Field values aggregated
+    double distinct;        // APPROX_COUNT_DISTINCT estimate
+    double error;           // Relative standard error of distinct, or rank error of values
+    size_t valueCount;
+    double values[QUERY_MAX_PERCENTILES];   // APPROX_PERCENTILE, in the order asked for
+} QueryAggregateResult;
+
 // Forward declarations for EntityId (actual type from ECS)
 typedef void EntityId_forward;
 
+// Thread safety: the engine keeps no global state. Each call parses into its
+// own AST and works in buffers it allocates and frees itself, so any number
+// of threads may execute read queries (SELECT, COUNT, SHOW, aggregates)
+// against the same ECS and QueryCatalog at once, as long as nothing writes to
+// either meanwhile (no component writes, notify calls, CREATE INDEX or
+// QueryCatalog_clear_changes). Stateful objects (QueryPlan, QueryCache,
+// QueryFrame, QuerySnapshotStore reader slots) belong to one thread each.
+// Results are owned by the calling thread.
+
 // Execute a query string
 QueryStatus Query_execute(ECS* ecs, const char* queryString, QueryEngineResult* outResult);
 
+// Execute n independent query strings, writing each result to outResults[i].
+// has() entity queries that share a driving component are evaluated in one
+// fused pass over that component's storage; everything else runs on its own.
+// Returns QUERY_SUCCESS if every query succeeded, otherwise the first error;
+// failed entries are left empty so all n results can be freed unconditionally.
+QueryStatus Query_execute_batch(ECS* ecs, const char** queries, size_t n, QueryEngineResult* outResults);
+
+// Fingerprint of a query's shape: a hash of its token stream with literals,
+// placeholders and entity ids replaced by one marker and literal lists (IN)
+// collapsed, so strings differing only in values share it. Keywords are
+// case-insensitive; component and field names are part of the shape.
+uint64_t Query_fingerprint(const char* queryString);
+
+// Fingerprint and the normalized text it was taken from, e.g.
+// "SELECT entities WHERE Health.hp IN (?, ...)", written snprintf style to
+// buffer (which may be NULL). Keywords are upper-cased.
+uint64_t Query_normalize(const char* queryString, char* buffer, size_t size);
+
+// Empty result whose buffers come from the calling thread's query allocator
+void QueryEngineResult_init(QueryEngineResult* result);
+
 // Free query result (query engine's QueryEngineResult, not ECS QueryResult)
 void QueryEngineResult_free(QueryEngineResult* result);
 
 // Get query result entities (returns EntityId* from ECS)
 EntityId_forward* QueryEngineResult_get_entities(QueryEngineResult* result, size_t* outCount);
 
+// Compare two entity results as sets. outAdded receives the entities in curr
+// but not prev, outRemoved those in prev but not curr, both sorted by EntityId
+// and free of duplicates. Inputs are left untouched. Both outputs are always
+// initialised, so they can be freed unconditionally. Fails with
+// QUERY_ERROR_EXECUTION for results that carry no entity list (COUNT, SHOW).
+QueryStatus QueryEngineResult_diff(const QueryEngineResult* prev, const QueryEngineResult* curr,
+                                   QueryEngineResult* outAdded, QueryEngineResult* outRemoved);
+
+// Set operations over entity results, returning a new result in one
+// allocation. Inputs must be sorted by EntityId (as the outputs of these
+// functions and QueryEngineResult_diff are) unless sortInputs is set, in which
+// case sorted copies are taken and the inputs are left untouched. Outputs are
+// sorted and free of duplicates, and are always initialised. Unsorted inputs
+// without sortInputs give an unspecified (but memory-safe) result. Results
+// with no entity list fail with QUERY_ERROR_EXECUTION.
+QueryStatus QueryEngineResult_intersect(const QueryEngineResult* a, const QueryEngineResult* b,
+                                        bool sortInputs, QueryEngineResult* outResult);
+QueryStatus QueryEngineResult_union(const QueryEngineResult* a, const QueryEngineResult* b,
+                                    bool sortInputs, QueryEngineResult* outResult);
+
+// Entities in a but not in b
+QueryStatus QueryEngineResult_difference(const QueryEngineResult* a, const QueryEngineResult* b,
+                                         bool sortInputs, QueryEngineResult* outResult);
+
 #endif // GRAMARYE_QUERY_QUERY_H
 
@@ -0,0 +1,62 @@
+#ifndef GRAMARYE_QUERY_ROARING_H
+#define GRAMARYE_QUERY_ROARING_H
+
+#include "gramarye_query/entity_set.h"
+#include "gramarye_ecs/entity.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Compressed set of 32-bit dense entity indices (exposed for executor).
+//
+// The index space is cut into 64K chunks by the high 16 bits; each non-empty
+// chunk holds one container picked by density:
+//   array  - sorted 16-bit values, up to 4096 of them (2 bytes per member)
+//   bitset - 1024 words covering the whole chunk (8 KB)
+//   run    - sorted [start, start + length] intervals (4 bytes per run)
+// Sparse sets cost little more than their members, dense ones at most 8 KB
+// per chunk, and long runs (everything but a few dead entities) a few bytes.
+// Set operations work chunk by chunk with a specialised path per pair of
+// container types; results are converted back to the smaller of array and
+// bitset, and RoaringBitmap_optimize turns eligible containers into runs.
+
+typedef struct RoaringBitmap RoaringBitmap;
+
+RoaringBitmap* RoaringBitmap_new(void);
+void RoaringBitmap_destroy(RoaringBitmap* bitmap);
+RoaringBitmap* RoaringBitmap_copy(const RoaringBitmap* bitmap);
+
+// Add a value; appending in increasing order is the fast path
+bool RoaringBitmap_add(RoaringBitmap* bitmap, uint32_t value);
+bool RoaringBitmap_contains(const RoaringBitmap* bitmap, uint32_t value);
+
+size_t RoaringBitmap_cardinality(const RoaringBitmap* bitmap);
+
+// In-place operations: dst = dst op src
+bool RoaringBitmap_and(RoaringBitmap* dst, const RoaringBitmap* src);
+bool RoaringBitmap_or(RoaringBitmap* dst, const RoaringBitmap* src);
+bool RoaringBitmap_andnot(RoaringBitmap* dst, const RoaringBitmap* src);
+
+// Convert containers to runs wherever that is smaller
+void RoaringBitmap_optimize(RoaringBitmap* bitmap);
+
+// Write up to maxCount members to outValues in increasing order; returns the number written
+size_t RoaringBitmap_to_array(const RoaringBitmap* bitmap, uint32_t* outValues, size_t maxCount);
+
+// Write the EntityIds of up to maxCount members to outEntities, in index order
+size_t RoaringBitmap_materialize(const RoaringBitmap* bitmap, const EntityIndexMap* map,
+                                 EntityId* outEntities, size_t maxCount);
+
+// Containers of each kind
+typedef struct {
+    size_t arrayContainers;
+    size_t bitsetContainers;
+    size_t runContainers;
+} RoaringStats;
+
+RoaringStats RoaringBitmap_get_stats(const RoaringBitmap* bitmap);
+
+// Bytes held by the bitmap
+size_t RoaringBitmap_memory_bytes(const RoaringBitmap* bitmap);
+
+#endif // GRAMARYE_QUERY_ROARING_H
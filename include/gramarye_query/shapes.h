@@ -0,0 +1,79 @@
+#ifndef GRAMARYE_QUERY_SHAPES_H
+#define GRAMARYE_QUERY_SHAPES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Per-shape query statistics.
+//
+// Queries that differ only in literals and entity ids share a fingerprint
+// (Query_fingerprint). A QueryShapeTable keeps, for each fingerprint seen,
+// the call count, failures, rows returned and a latency histogram, so the
+// handful of shapes behind thousands of distinct query strings can be
+// compared by total time and by tail latency. A QueryEngine keeps one (see
+// QueryEngineConfig.shapeEntries); the shell prints it with STATS.
+
+// Latency histogram in nanoseconds with HDR-style log-linear buckets: exact
+// below 64 ns, then 32 buckets per power of two, so a reported percentile is
+// within about 3% of the true value. Values from 2^42 ns (about 73 minutes)
+// up share the last bucket.
+#define QUERY_HISTOGRAM_BUCKETS 1216
+
+typedef struct {
+    uint64_t counts[QUERY_HISTOGRAM_BUCKETS];
+    uint64_t count;
+    uint64_t min;
+    uint64_t max;
+    uint64_t sum;
+} QueryLatencyHistogram;
+
+void QueryLatencyHistogram_record(QueryLatencyHistogram* histogram, uint64_t ns);
+
+// Value at or below which a fraction q of the samples fall: the upper edge
+// of the bucket holding that rank, capped at the maximum (0 when empty)
+uint64_t QueryLatencyHistogram_percentile(const QueryLatencyHistogram* histogram, double q);
+
+// Longest normalized query text kept, including the terminator
+#define QUERY_SHAPE_TEXT 160
+
+typedef struct {
+    uint64_t fingerprint;
+    char text[QUERY_SHAPE_TEXT];    // Normalized first query of the shape (Query_normalize)
+    uint64_t calls;
+    uint64_t failures;
+    uint64_t rows;                  // Summed result counts of successful calls
+    QueryLatencyHistogram latency;  // Every call, failed ones included
+} QueryShapeStats;
+
+typedef struct QueryShapeTable QueryShapeTable;
+
+// Table tracking at most capacity shapes; calls of further shapes are only
+// counted (QueryShapeTable_untracked)
+QueryShapeTable* QueryShapeTable_new(size_t capacity);
+void QueryShapeTable_destroy(QueryShapeTable* table);
+
+// Record one call of queryString, whose fingerprint is given. The string is
+// normalized only when its shape is first seen. Returns false if the shape
+// is new and the table full.
+bool QueryShapeTable_record(QueryShapeTable* table, uint64_t fingerprint, const char* queryString, uint64_t ns,
+                            bool succeeded, uint64_t rows);
+
+// Shapes in the order they were first seen
+size_t QueryShapeTable_count(const QueryShapeTable* table);
+const QueryShapeStats* QueryShapeTable_get(const QueryShapeTable* table, size_t index);
+
+// Shape of a fingerprint, or NULL if it is not tracked
+const QueryShapeStats* QueryShapeTable_find(const QueryShapeTable* table, uint64_t fingerprint);
+
+// Calls whose shape found the table full
+uint64_t QueryShapeTable_untracked(const QueryShapeTable* table);
+
+// Forget every shape
+void QueryShapeTable_clear(QueryShapeTable* table);
+
+// Write one entry per shape, most total time first, snprintf style: returns
+// the length of the full text, of which at most size - 1 bytes are written
+size_t QueryShapeTable_format(const QueryShapeTable* table, char* buffer, size_t size);
+
+#endif // GRAMARYE_QUERY_SHAPES_H
@@ -5,6 +5,7 @@
 
 // Forward declaration
 typedef struct QueryShell QueryShell;
+typedef struct QueryEngine QueryEngine;
 
 // Create a new query shell
 QueryShell* QueryShell_new(ECS* ecs);
@@ -24,5 +25,8 @@ void QueryShell_set_prompt(QueryShell* shell, const char* prompt);
 // Enable/disable command history
 void QueryShell_set_history_enabled(QueryShell* shell, bool enabled);
 
+// The session's engine; register fields on its catalog to enable field filters
+QueryEngine* QueryShell_get_engine(QueryShell* shell);
+
 #endif // GRAMARYE_QUERY_SHELL_H
 
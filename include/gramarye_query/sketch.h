@@ -0,0 +1,81 @@
+#ifndef GRAMARYE_QUERY_SKETCH_H
+#define GRAMARYE_QUERY_SKETCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Fixed-size summaries of a stream of field values (exposed for executor).
+//
+// Both sketches are built in one pass and are mergeable: sketches filled by
+// separate workers from disjoint parts of the input and then merged answer
+// like one sketch filled with all of it.
+//
+// HyperLogLog estimates the number of distinct values with 2^precision one-byte
+// registers and a relative standard error of 1.04 / sqrt(2^precision)
+// (precision 14: 16 KB, 0.8%).
+//
+// QuantileSketch is a KLL sketch: a stack of compactors, level h holding values
+// of weight 2^h. A full level is sorted and every other value (odd or even
+// positions, picked at random) moves up a level. Memory stays near 3k values
+// whatever the input size, and a quantile's rank is off by about
+// QuantileSketch_rank_error() of the count (k 200: 1.7%).
+
+// HyperLogLog precision bounds and default
+#define HLL_MIN_PRECISION 4
+#define HLL_MAX_PRECISION 18
+#define HLL_DEFAULT_PRECISION 14
+
+// KLL accuracy parameter bounds and default
+#define KLL_MIN_K 8
+#define KLL_DEFAULT_K 200
+
+typedef struct HyperLogLog HyperLogLog;
+typedef struct QuantileSketch QuantileSketch;
+
+// NULL if precision is outside HLL_MIN_PRECISION..HLL_MAX_PRECISION
+HyperLogLog* HyperLogLog_new(unsigned precision);
+void HyperLogLog_destroy(HyperLogLog* hll);
+
+// Add a value by its 64-bit key (an integer field's raw value); equal keys count once
+void HyperLogLog_add_key(HyperLogLog* hll, uint64_t key);
+
+// Add a floating-point value; -0.0 and 0.0 are the same value
+void HyperLogLog_add_double(HyperLogLog* hll, double value);
+
+// into = into ∪ from; false if the precisions differ
+bool HyperLogLog_merge(HyperLogLog* into, const HyperLogLog* from);
+
+double HyperLogLog_estimate(const HyperLogLog* hll);
+
+// Relative standard error of the estimate
+double HyperLogLog_relative_error(const HyperLogLog* hll);
+
+// NULL if k < KLL_MIN_K
+QuantileSketch* QuantileSketch_new(size_t k);
+void QuantileSketch_destroy(QuantileSketch* sketch);
+
+// NaN values are ignored
+bool QuantileSketch_add(QuantileSketch* sketch, double value);
+
+// into = into + from; false on allocation failure or differing k
+bool QuantileSketch_merge(QuantileSketch* into, const QuantileSketch* from);
+
+// Values added (directly or through merges)
+uint64_t QuantileSketch_count(const QuantileSketch* sketch);
+
+// Value at rank p * count, p in [0, 1]; 0 is the minimum and 1 the maximum.
+// Returns NaN for an empty sketch.
+double QuantileSketch_quantile(const QuantileSketch* sketch, double p);
+
+// Fill outValues[i] with the quantile of ps[i]; one sort for all of them.
+// False on allocation failure.
+bool QuantileSketch_quantiles(const QuantileSketch* sketch, const double* ps, size_t count, double* outValues);
+
+// Typical rank error of a quantile, as a fraction of the count
+double QuantileSketch_rank_error(const QuantileSketch* sketch);
+
+// Values retained
+size_t QuantileSketch_retained(const QuantileSketch* sketch);
+
+#endif // GRAMARYE_QUERY_SKETCH_H
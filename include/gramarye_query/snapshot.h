@@ -0,0 +1,79 @@
+#ifndef GRAMARYE_QUERY_SNAPSHOT_H
+#define GRAMARYE_QUERY_SNAPSHOT_H
+
+#include "gramarye_ecs/ecs.h"
+#include "gramarye_query/catalog.h"
+#include "query.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Epoch snapshots: queries from other threads without stopping the simulation.
+//
+// At a safe point each frame the simulation thread calls
+// QuerySnapshotStore_publish, which copies the tracked component types into
+// an immutable snapshot (a private ECS plus the catalog's field schema) and
+// makes it the latest epoch. Reader threads pin the latest snapshot, query it
+// and unpin; neither side takes a lock, and the live ECS is only ever read by
+// the simulation thread.
+//
+// Snapshots a reader may still hold are reclaimed epoch-based: each reader
+// slot announces the epoch it pinned at, and a replaced snapshot is released
+// by a later publish once no pinned reader is that old. The store keeps one
+// released snapshot and the next publish copies into it in place, so with
+// readers keeping up, publishing alternates between two buffers and allocates
+// nothing of its own. It starts over in a new snapshot when an entity has
+// lost a tracked component since that buffer was filled.
+//
+// Results use live EntityIds and can be kept after unpinning. Only tracked
+// component types exist in a snapshot (other names match nothing), filters
+// see the live catalog's fields but no indexes, and CHANGED and CREATE INDEX
+// are not available. Each reader slot belongs to one thread; any number of
+// readers may query the same snapshot at once.
+
+// Reader slots per store
+#define QUERY_SNAPSHOT_MAX_READERS 16
+
+typedef struct QuerySnapshotStore QuerySnapshotStore;
+typedef struct QuerySnapshot QuerySnapshot;
+
+typedef struct {
+    uint64_t epoch;             // Epoch of the latest snapshot, 0 before the first publish
+    uint64_t published;
+    uint64_t reclaimed;         // Replaced snapshots released by every reader
+    uint64_t reused;            // Publishes that refreshed a released snapshot in place
+    size_t retired;             // Replaced snapshots still waiting for readers
+    size_t entityCount;         // Entities in the latest snapshot
+    double lastPublishMs;       // Capture time of the latest snapshot
+} QuerySnapshotStats;
+
+// Store for ecs; catalog (may be NULL) supplies the field schema for filters
+QuerySnapshotStore* QuerySnapshotStore_new(ECS* ecs, QueryCatalog* catalog);
+
+// Destroy the store and every snapshot; all readers must have detached
+void QuerySnapshotStore_destroy(QuerySnapshotStore* store);
+
+// Include a component type in future snapshots
+QueryStatus QuerySnapshotStore_track(QuerySnapshotStore* store, const char* componentName);
+
+// Simulation thread, at a safe point: capture and publish a new epoch, then
+// release replaced snapshots no reader can still hold
+QueryStatus QuerySnapshotStore_publish(QuerySnapshotStore* store);
+
+// Claim a reader slot; returns its id, or -1 if all are taken
+int QuerySnapshotStore_attach_reader(QuerySnapshotStore* store);
+void QuerySnapshotStore_detach_reader(QuerySnapshotStore* store, int reader);
+
+// Pin the latest snapshot for reader until QuerySnapshotStore_unpin (NULL
+// before the first publish, in which case unpin is still required)
+QuerySnapshot* QuerySnapshotStore_pin(QuerySnapshotStore* store, int reader);
+void QuerySnapshotStore_unpin(QuerySnapshotStore* store, int reader);
+
+QuerySnapshotStats QuerySnapshotStore_get_stats(const QuerySnapshotStore* store);
+
+// Execute a query against a pinned snapshot
+QueryStatus QuerySnapshot_execute(QuerySnapshot* snapshot, const char* queryString, QueryEngineResult* outResult);
+
+uint64_t QuerySnapshot_epoch(const QuerySnapshot* snapshot);
+
+#endif // GRAMARYE_QUERY_SNAPSHOT_H
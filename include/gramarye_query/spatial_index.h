@@ -0,0 +1,62 @@
+#ifndef GRAMARYE_QUERY_SPATIAL_INDEX_H
+#define GRAMARYE_QUERY_SPATIAL_INDEX_H
+
+#include "gramarye_ecs/entity.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Uniform grid over 2D points for proximity queries (exposed for executor).
+//
+// The plane is cut into square cells of a fixed size; only occupied cells
+// are stored, in a hash table keyed by cell coordinates, so the world does
+// not need bounds. Each entity lives in exactly one cell. Moving inside a
+// cell rewrites its stored point; moving across cells is a swap-remove from
+// the old cell and an append to the new one, both O(1).
+//
+// A query visits the cells overlapping its bounding box (or every occupied
+// cell, when that is fewer) and tests the stored points exactly. Cells
+// should be about the size of a typical query radius.
+//
+// Points with a NaN or infinite coordinate are not indexed.
+
+typedef struct SpatialIndex SpatialIndex;
+
+// Axis-aligned rectangle, bounds inclusive
+typedef struct {
+    double minX;
+    double minY;
+    double maxX;
+    double maxY;
+} SpatialRect;
+
+// cellSize must be positive and finite
+SpatialIndex* SpatialIndex_new(double cellSize);
+void SpatialIndex_destroy(SpatialIndex* index);
+
+// Insert an entity or move it to a new point
+bool SpatialIndex_set(SpatialIndex* index, EntityId entity, double x, double y);
+
+// Remove an entity (no-op if absent)
+void SpatialIndex_remove(SpatialIndex* index, EntityId entity);
+
+// Live entries
+size_t SpatialIndex_count(const SpatialIndex* index);
+
+// Entries in the cells overlapping rect: an upper bound on the matches
+size_t SpatialIndex_estimate_rect(const SpatialIndex* index, SpatialRect rect);
+
+// Write up to maxCount entities inside rect to outEntities; returns the number written
+size_t SpatialIndex_collect_rect(const SpatialIndex* index, SpatialRect rect, EntityId* outEntities, size_t maxCount);
+
+// Write up to maxCount entities within radius of (x, y) to outEntities; returns the number written
+size_t SpatialIndex_collect_circle(const SpatialIndex* index, double x, double y, double radius,
+                                   EntityId* outEntities, size_t maxCount);
+
+// Occupied cells
+size_t SpatialIndex_cell_count(const SpatialIndex* index);
+
+// Bytes held by the index, including its entity map
+size_t SpatialIndex_memory_bytes(const SpatialIndex* index);
+
+#endif // GRAMARYE_QUERY_SPATIAL_INDEX_H
@@ -0,0 +1,39 @@
+#ifndef GRAMARYE_QUERY_SYMBOLS_H
+#define GRAMARYE_QUERY_SYMBOLS_H
+
+#include "gramarye_ecs/ecs.h"
+#include "gramarye_ecs/component.h"
+#include <stddef.h>
+
+// Interned component names (exposed for parser and engine).
+//
+// A parser given a symbol table resolves each identifier to its
+// ComponentTypeId with one hash probe while lexing, and stores the ids
+// alongside the names in the AST (ComponentList.typeIds, ShowQueryData and
+// SpatialQueryData.typeId). The executor and QueryPlan then use those ids
+// instead of asking the ECS by name, so a compiled plan does no name
+// resolution at all.
+//
+// The table copies the names of the types registered when it is created or
+// last refreshed. A lookup that misses first interns any types registered
+// since, so new component types resolve without an explicit refresh; names
+// still unknown resolve to COMPONENT_TYPE_INVALID. Type ids are expected to be
+// assigned densely from 0, as ECS_register_component_type does.
+
+typedef struct QuerySymbolTable QuerySymbolTable;
+
+// Table holding every component type registered in ecs so far
+QuerySymbolTable* QuerySymbolTable_new(ECS* ecs);
+void QuerySymbolTable_destroy(QuerySymbolTable* table);
+
+// Intern types registered since the last refresh; returns how many were added
+size_t QuerySymbolTable_refresh(QuerySymbolTable* table);
+
+// Type named by the first length bytes of name (COMPONENT_TYPE_INVALID if none);
+// refreshes the table on a miss
+ComponentTypeId QuerySymbolTable_lookup(QuerySymbolTable* table, const char* name, size_t length);
+
+// Names interned
+size_t QuerySymbolTable_count(const QuerySymbolTable* table);
+
+#endif // GRAMARYE_QUERY_SYMBOLS_H
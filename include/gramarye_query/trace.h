@@ -0,0 +1,71 @@
+#ifndef GRAMARYE_QUERY_TRACE_H
+#define GRAMARYE_QUERY_TRACE_H
+
+#include "query.h"
+#include "profile.h"
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Query execution spans in Chrome trace-event JSON (loads in Perfetto and
+// chrome://tracing).
+//
+// A QueryEngine given a QueryTracer records, for every query it executes, a
+// "query" span carrying the query's fingerprint (Query_fingerprint), with
+// "parse", "plan" and "materialize" spans and one span per plan operator
+// (labelled as in EXPLAIN ANALYZE) nested inside it. Phase and operator
+// spans come from the profiling hooks, so builds with
+// GRAMARYE_QUERY_PROFILE=0 record query spans only.
+//
+// Each thread writes to its own ring buffer of the tracer, without locks;
+// when a ring is full its oldest spans are overwritten. QueryTracer_flush
+// writes what the rings hold and may run on any thread while queries are
+// being traced, though only one flush at a time. Timestamps are
+// CLOCK_MONOTONIC microseconds; spans line up with a game trace whose
+// timestamps come from the same clock.
+
+typedef struct QueryTracer QueryTracer;
+
+// Default spans kept per thread between flushes
+#define QUERY_TRACE_DEFAULT_EVENTS 4096
+
+// Operators nested deeper than this are not traced
+#define QUERY_TRACE_MAX_DEPTH 16
+
+typedef struct {
+    size_t threads;             // Threads that have recorded spans
+    uint64_t recorded;          // Spans recorded since the tracer was created
+    uint64_t dropped;           // Overwritten before a flush reached them
+} QueryTracerStats;
+
+// Create a tracer keeping eventsPerThread spans per thread (0 for the
+// default). Ring buffers come from libcore's ALLOC, never an engine's allocator.
+QueryTracer* QueryTracer_new(size_t eventsPerThread);
+
+// Destroy the tracer; no thread may be executing a query traced by it
+void QueryTracer_destroy(QueryTracer* tracer);
+
+// Write the spans recorded since the last flush to out as one Chrome trace
+// JSON document ({"traceEvents": [...]}). Returns the number of spans written.
+size_t QueryTracer_flush(QueryTracer* tracer, FILE* out);
+
+QueryTracerStats QueryTracer_get_stats(const QueryTracer* tracer);
+
+// Span hooks (exposed for the engine and profiler). QueryTrace_begin starts
+// tracing the calling thread's query unless one is traced already, and
+// returns whether it did; only then must QueryTrace_end follow.
+bool QueryTrace_begin(QueryTracer* tracer, uint64_t fingerprint);
+void QueryTrace_end(QueryStatus status, uint64_t rows);
+
+// Whether this thread's query is being traced
+bool QueryTrace_active(void);
+
+// Phase change, from QueryProfile_switch
+void QueryTrace_phase(QueryPhase phase);
+
+// Operator spans, from QueryProfile_begin_operator / QueryProfile_end_operator
+void QueryTrace_begin_operator(const char* label);
+void QueryTrace_end_operator(uint64_t rowsIn, uint64_t rowsOut);
+
+#endif // GRAMARYE_QUERY_TRACE_H
@@ -0,0 +1,154 @@
+#include "gramarye_query/executor.h"
+#include "gramarye_query/catalog.h"
+#include "gramarye_query/sketch.h"
+#include "gramarye_query/parser.h"
+#include "gramarye_query/query.h"
+#include "gramarye_ecs/ecs.h"
+#include "gramarye_ecs/query.h"
+#include "gramarye_ecs/entity.h"
+#include "gramarye_ecs/component.h"
+#include "gramarye_query/allocator.h"
+#include "gramarye_query/profile.h"
+#include "internal.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+
+#if AGGREGATE_MAX_PERCENTILES > QUERY_MAX_PERCENTILES
+#error "QueryAggregateResult cannot hold every requested percentile"
+#endif
+
+QueryStatus QueryExecutor_execute_aggregate(ECS* ecs,
+                                            QueryCatalog* catalog,
+                                            QueryAST* ast,
+                                            const double* paramValues,
+                                            size_t paramCount,
+                                            QueryEngineResult* outResult) {
+    if (!ecs || !outResult || QueryAST_get_type(ast) != AST_AGGREGATE) {
+        return QUERY_ERROR_EXECUTION;
+    }
+    QueryEngineResult_init(outResult);
+    
+    AggregateQueryData* aggregate = (AggregateQueryData*)QueryAST_get_data(ast);
+    QueryField field;
+    if (!catalog || !QueryCatalog_find_field(catalog, aggregate->componentName, aggregate->fieldName, &field)) {
+        return QUERY_ERROR_EXECUTION;
+    }
+    
+    QueryStatus status = QUERY_SUCCESS;
+    QueryCondition* condition = NULL;
+    if (QueryAST_get_left(ast)) {
+        condition = QueryCondition_compile(ecs, catalog, QueryAST_get_left(ast), &status);
+        if (!condition) return status;
+    }
+    status = QueryExecutor_execute_compiled_aggregate(ecs, ast, &field, condition, paramValues, paramCount,
+                                                      outResult);
+    QueryCondition_destroy(condition);
+    return status;
+}
+
+QueryStatus QueryExecutor_execute_compiled_aggregate(ECS* ecs,
+                                                     QueryAST* ast,
+                                                     const QueryField* field,
+                                                     QueryCondition* condition,
+                                                     const double* paramValues,
+                                                     size_t paramCount,
+                                                     QueryEngineResult* outResult) {
+    if (!ecs || !field || !outResult || QueryAST_get_type(ast) != AST_AGGREGATE) {
+        return QUERY_ERROR_EXECUTION;
+    }
+    QueryEngineResult_init(outResult);
+    AggregateQueryData* aggregate = (AggregateQueryData*)QueryAST_get_data(ast);
+    
+    size_t op = SIZE_MAX;
+    if (QUERY_PROFILE_ANALYZING()) {
+        char label[QUERY_OPERATOR_LABEL];
+        snprintf(label, sizeof(label), "Aggregate %s(%s.%s)",
+                 aggregate->kind == AGGREGATE_COUNT_DISTINCT ? "APPROX_COUNT_DISTINCT" : "APPROX_PERCENTILE",
+                 aggregate->componentName, aggregate->fieldName);
+        op = QueryProfile_begin_operator(label);
+    }
+    
+    // Without WHERE, every entity holding the field's component
+    const EntityId* entities = NULL;
+    size_t entityCount = 0;
+    struct QueryResult ecsResult = {NULL, 0, 0};
+    QueryEngineResult rows;
+    QueryEngineResult_init(&rows);
+    if (condition) {
+        QueryStatus status = QueryExecutor_execute_compiled(condition, AST_SELECT, paramValues, paramCount,
+                                                            QUERY_LIMIT_NONE, &rows);
+        if (status != QUERY_SUCCESS) {
+            QueryProfile_end_operator(op, 0, 0);
+            return status;
+        }
+        entities = (const EntityId*)rows.entities;
+        entityCount = rows.count;
+    } else {
+        QUERY_PHASE_BEGIN(outer, QUERY_PHASE_SCAN);
+        ecsResult = ECS_query_entities(ecs, (ComponentTypeId*)&field->typeId, 1);
+        QUERY_PHASE_END(outer);
+        entities = ecsResult.entities;
+        entityCount = ecsResult.count;
+    }
+    
+    QueryAggregateResult* result = (QueryAggregateResult*)QUERY_ALLOC(sizeof(QueryAggregateResult));
+    HyperLogLog* hll = NULL;
+    QuantileSketch* sketch = NULL;
+    if (aggregate->kind == AGGREGATE_COUNT_DISTINCT) {
+        hll = HyperLogLog_new(HLL_DEFAULT_PRECISION);
+    } else {
+        sketch = QuantileSketch_new(KLL_DEFAULT_K);
+    }
+    bool ok = result && (hll || sketch);
+    
+    // One pass: each matching entity's field is read once into the sketch.
+    // Entities without the component contribute nothing.
+    QUERY_PHASE_BEGIN(outer, QUERY_PHASE_SCAN);
+    if (ok) {
+        memset(result, 0, sizeof(QueryAggregateResult));
+        bool integer = query_field_is_integer(field->type);
+        for (size_t i = 0; ok && i < entityCount; i++) {
+            const void* data = ECS_get_component(ecs, entities[i], field->typeId);
+            if (!data) continue;
+            
+            result->rows++;
+            if (!hll) {
+                ok = QuantileSketch_add(sketch, QueryField_read(field, data));
+            } else if (integer) {
+                HyperLogLog_add_key(hll, QueryField_read_key(field, data));
+            } else {
+                HyperLogLog_add_double(hll, QueryField_read(field, data));
+            }
+        }
+    }
+    
+    if (ok && hll) {
+        result->distinct = result->rows > 0 ? HyperLogLog_estimate(hll) : 0.0;
+        result->error = HyperLogLog_relative_error(hll);
+        outResult->count = (size_t)(result->distinct + 0.5);
+    } else if (ok) {
+        result->valueCount = aggregate->percentileCount;
+        result->error = QuantileSketch_rank_error(sketch);
+        ok = QuantileSketch_quantiles(sketch, aggregate->percentiles, aggregate->percentileCount, result->values);
+        outResult->count = result->valueCount;
+    }
+    
+    QUERY_PHASE_END(outer);
+    QueryProfile_end_operator(op, entityCount, ok ? result->rows : 0);
+    
+    HyperLogLog_destroy(hll);
+    QuantileSketch_destroy(sketch);
+    if (ecsResult.entities) QueryResult_free(&ecsResult);
+    QueryEngineResult_free(&rows);
+    
+    if (!ok) {
+        if (result) QUERY_FREE(result);
+        outResult->count = 0;
+        return QUERY_ERROR_EXECUTION;
+    }
+    outResult->data = result;
+    return QUERY_SUCCESS;
+}
@@ -0,0 +1,134 @@
+#include "gramarye_query/allocator.h"
+#include "internal.h"
+#include "mem.h"
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Prefix of every block; the union keeps the payload aligned for any type
+typedef union {
+    struct {
+        const QueryAllocator* allocator;
+        size_t size;            // Payload bytes
+    } block;
+    long double align;
+} BlockHeader;
+
+// Each thread has its own scope stack, so engines on different threads
+// account independently
+static THREAD_LOCAL QueryMemoryScope* currentScope = NULL;
+
+static void* default_alloc(void* user, size_t size) {
+    (void)user;
+    return ALLOC((long)size);
+}
+
+static void* default_realloc(void* user, void* ptr, size_t oldSize, size_t newSize) {
+    (void)user;
+    (void)oldSize;
+    return RESIZE(ptr, (long)newSize);
+}
+
+static void default_free(void* user, void* ptr, size_t size) {
+    (void)user;
+    (void)size;
+    FREE(ptr);
+}
+
+static const QueryAllocator defaultAllocator = {default_alloc, default_realloc, default_free, NULL};
+
+const QueryAllocator* QueryAllocator_default(void) {
+    return &defaultAllocator;
+}
+
+void QueryMemory_enter(QueryMemoryScope* scope, const QueryAllocator* allocator) {
+    memset(scope, 0, sizeof(QueryMemoryScope));
+    scope->allocator = allocator ? allocator : &defaultAllocator;
+    scope->outer = currentScope;
+    currentScope = scope;
+}
+
+void QueryMemory_leave(QueryMemoryScope* scope) {
+    currentScope = scope->outer;
+}
+
+const QueryAllocator* QueryMemory_current(void) {
+    return currentScope ? currentScope->allocator : &defaultAllocator;
+}
+
+static void charge(int64_t delta, bool allocation) {
+    QueryMemoryScope* scope = currentScope;
+    if (!scope) return;
+    
+    if (allocation) {
+        scope->stats.allocations++;
+        scope->stats.bytesAllocated += (uint64_t)delta;
+    }
+    scope->liveBytes += delta;
+    if (scope->liveBytes > 0 && (uint64_t)scope->liveBytes > scope->stats.peakBytes) {
+        scope->stats.peakBytes = (uint64_t)scope->liveBytes;
+    }
+}
+
+// Whether the innermost scope's budget has room for growth more live bytes
+static bool within_budget(size_t growth) {
+    QueryMemoryScope* scope = currentScope;
+    if (!scope || scope->budget == 0 || growth == 0) return true;
+    
+    int64_t live = scope->liveBytes > 0 ? scope->liveBytes : 0;
+    if (growth <= scope->budget && (uint64_t)live <= scope->budget - growth) return true;
+    scope->stats.refused++;
+    return false;
+}
+
+void* QueryMemory_alloc(size_t size) {
+    if (size > SIZE_MAX - sizeof(BlockHeader)) return NULL;
+    
+    const QueryAllocator* allocator = QueryMemory_current();
+    size_t total = sizeof(BlockHeader) + size;
+    if (!within_budget(total)) return NULL;
+    BlockHeader* header = (BlockHeader*)allocator->alloc(allocator->user, total);
+    if (!header) return NULL;
+    
+    header->block.allocator = allocator;
+    header->block.size = size;
+    charge((int64_t)total, true);
+    return header + 1;
+}
+
+void* QueryMemory_realloc(void* ptr, size_t size) {
+    if (!ptr) return QueryMemory_alloc(size);
+    if (size > SIZE_MAX - sizeof(BlockHeader)) return NULL;
+    
+    BlockHeader* header = (BlockHeader*)ptr - 1;
+    const QueryAllocator* allocator = header->block.allocator;
+    size_t oldSize = header->block.size;
+    if (!allocator->realloc) {
+        void* moved = QueryMemory_alloc(size);
+        if (!moved) return NULL;
+        memcpy(moved, ptr, oldSize < size ? oldSize : size);
+        QueryMemory_free(ptr);
+        return moved;
+    }
+    
+    size_t oldTotal = sizeof(BlockHeader) + oldSize;
+    size_t total = sizeof(BlockHeader) + size;
+    if (!within_budget(total > oldTotal ? total - oldTotal : 0)) return NULL;
+    BlockHeader* resized = (BlockHeader*)allocator->realloc(allocator->user, header, oldTotal, total);
+    if (!resized) return NULL;
+    
+    resized->block.size = size;
+    charge(-(int64_t)oldTotal, false);
+    charge((int64_t)total, true);
+    return resized + 1;
+}
+
+void QueryMemory_free(void* ptr) {
+    if (!ptr) return;
+    
+    BlockHeader* header = (BlockHeader*)ptr - 1;
+    const QueryAllocator* allocator = header->block.allocator;
+    size_t total = sizeof(BlockHeader) + header->block.size;
+    charge(-(int64_t)total, false);
+    allocator->free(allocator->user, header, total);
+}
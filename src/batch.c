@@ -0,0 +1,272 @@
+#include "gramarye_query/query.h"
+#include "gramarye_query/parser.h"
+#include "gramarye_query/executor.h"
+#include "gramarye_ecs/ecs.h"
+#include "gramarye_ecs/query.h"
+#include "gramarye_ecs/entity.h"
+#include "gramarye_ecs/component.h"
+#include "gramarye_query/allocator.h"
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Residual component checks per fused group are tracked in a 64-bit mask
+#define BATCH_MAX_RESIDUAL_TYPES 64
+
+// A has() query that takes part in a fused scan
+typedef struct {
+    size_t queryIndex;
+    ASTNodeType queryType;
+    uint64_t limit;              // SELECT LIMIT, QUERY_LIMIT_NONE if absent
+    ComponentTypeId* typeIds;    // Canonical component set
+    size_t typeCount;
+    ComponentTypeId driving;     // Component whose storage is scanned
+    uint64_t needMask;           // Residual types required, as bits into the group table
+    size_t group;                // Scan pass that claimed the query, 0 if none
+    bool fused;
+    EntityId* entities;
+    size_t count;
+    size_t capacity;
+} BatchQuery;
+
+static bool append_entity(BatchQuery* query, EntityId entity) {
+    if (query->count >= query->capacity) {
+        size_t newCapacity = query->capacity ? query->capacity * 2 : 64;
+        EntityId* newEntities = (EntityId*)QUERY_REALLOC(query->entities, sizeof(EntityId) * newCapacity);
+        if (!newEntities) return false;
+        query->entities = newEntities;
+        query->capacity = newCapacity;
+    }
+    query->entities[query->count++] = entity;
+    return true;
+}
+
+// How many fusible queries mention typeId
+static size_t type_frequency(const BatchQuery* queries, size_t queryCount, ComponentTypeId typeId) {
+    size_t frequency = 0;
+    for (size_t i = 0; i < queryCount; i++) {
+        for (size_t j = 0; j < queries[i].typeCount; j++) {
+            if (queries[i].typeIds[j] == typeId) {
+                frequency++;
+                break;
+            }
+        }
+    }
+    return frequency;
+}
+
+// Scan one driving component and evaluate every query of the group per entity
+static QueryStatus run_group(ECS* ecs, BatchQuery* queries, size_t queryCount, ComponentTypeId driving, size_t group,
+                             bool* done) {
+    ComponentTypeId residual[BATCH_MAX_RESIDUAL_TYPES];
+    size_t residualCount = 0;
+    
+    // Build the group's residual type table; queries that don't fit run alone later
+    for (size_t i = 0; i < queryCount; i++) {
+        BatchQuery* query = &queries[i];
+        if (done[i] || query->driving != driving) continue;
+        
+        uint64_t mask = 0;
+        bool fits = true;
+        for (size_t j = 0; j < query->typeCount && fits; j++) {
+            ComponentTypeId typeId = query->typeIds[j];
+            if (typeId == driving) continue;
+            
+            size_t slot = 0;
+            while (slot < residualCount && residual[slot] != typeId) {
+                slot++;
+            }
+            if (slot == residualCount) {
+                if (residualCount == BATCH_MAX_RESIDUAL_TYPES) {
+                    fits = false;
+                    break;
+                }
+                residual[residualCount++] = typeId;
+            }
+            mask |= 1ULL << slot;
+        }
+        
+        if (fits) {
+            query->needMask = mask;
+            query->group = group;
+            query->fused = true;
+            done[i] = true;
+        }
+    }
+    
+    struct QueryResult ecsResult = ECS_query_entities(ecs, &driving, 1);
+    
+    QueryStatus status = QUERY_SUCCESS;
+    for (size_t e = 0; e < ecsResult.count && status == QUERY_SUCCESS; e++) {
+        EntityId entity = ecsResult.entities[e];
+        
+        // Each (entity, component) lookup is done once for the whole group
+        uint64_t present = 0;
+        for (size_t slot = 0; slot < residualCount; slot++) {
+            if (ECS_get_component(ecs, entity, residual[slot]) != NULL) {
+                present |= 1ULL << slot;
+            }
+        }
+        
+        for (size_t i = 0; i < queryCount; i++) {
+            BatchQuery* query = &queries[i];
+            if (query->group != group) continue;
+            if ((present & query->needMask) != query->needMask) continue;
+            
+            if (query->queryType == AST_COUNT) {
+                query->count++;
+            } else if ((uint64_t)query->count < query->limit && !append_entity(query, entity)) {
+                status = QUERY_ERROR_EXECUTION;
+                break;
+            }
+        }
+    }
+    
+    QueryResult_free(&ecsResult);
+    return status;
+}
+
+QueryStatus Query_execute_batch(ECS* ecs, const char** queries, size_t n, QueryEngineResult* outResults) {
+    if (!ecs || !queries || !outResults) {
+        return QUERY_ERROR_INVALID_SYNTAX;
+    }
+    
+    for (size_t i = 0; i < n; i++) {
+        QueryEngineResult_init(&outResults[i]);
+    }
+    if (n == 0) {
+        return QUERY_SUCCESS;
+    }
+    
+    BatchQuery* batch = (BatchQuery*)QUERY_ALLOC(sizeof(BatchQuery) * n);
+    bool* done = (bool*)QUERY_ALLOC(sizeof(bool) * n);
+    if (!batch || !done) {
+        if (batch) QUERY_FREE(batch);
+        if (done) QUERY_FREE(done);
+        return QUERY_ERROR_EXECUTION;
+    }
+    memset(batch, 0, sizeof(BatchQuery) * n);
+    
+    QueryStatus firstError = QUERY_SUCCESS;
+    size_t fusibleCount = 0;
+    
+    // Parse and plan every query; anything that isn't a has() entity query runs on its own
+    for (size_t i = 0; i < n; i++) {
+        QueryStatus status = QUERY_SUCCESS;
+        QueryParser* parser = queries[i] ? QueryParser_new(queries[i]) : NULL;
+        QueryAST* ast = parser ? QueryParser_parse(parser) : NULL;
+        
+        if (!ast) {
+            status = QUERY_ERROR_PARSE;
+        } else {
+            ASTNodeType queryType = QueryAST_get_type(ast);
+            QueryAST* predicate = QueryAST_get_left(ast);
+            ComponentList* componentList = QueryExecutor_is_component_predicate(predicate) ?
+                                           (ComponentList*)QueryAST_get_data(predicate) : NULL;
+            
+            uint64_t limit = QUERY_LIMIT_NONE;
+            if (queryType == AST_SELECT && QueryExecutor_get_limit(ast, &limit) != QUERY_SUCCESS) {
+                // Unbound placeholder; let the executor report it
+                predicate = NULL;
+            }
+            
+            if ((queryType == AST_SELECT || queryType == AST_COUNT) &&
+                QueryExecutor_get_sampling(ast, NULL) == SAMPLE_NONE &&
+                predicate && QueryAST_get_type(predicate) == AST_HAS &&
+                componentList && componentList->count > 0) {
+                BatchQuery* query = &batch[fusibleCount];
+                query->limit = limit;
+                query->typeIds = (ComponentTypeId*)QUERY_ALLOC(sizeof(ComponentTypeId) * componentList->count);
+                if (!query->typeIds) {
+                    status = QUERY_ERROR_EXECUTION;
+                } else {
+                    query->queryIndex = i;
+                    query->queryType = queryType;
+                    query->typeCount = QueryExecutor_canonical_components(ecs, componentList, query->typeIds);
+                    if (query->typeCount == 0) {
+                        // No valid components, empty result
+                        QUERY_FREE(query->typeIds);
+                    } else {
+                        fusibleCount++;
+                    }
+                }
+            } else {
+                status = QueryExecutor_execute(ecs, ast, &outResults[i]);
+            }
+        }
+        
+        if (ast) QueryAST_destroy(ast);
+        if (parser) QueryParser_destroy(parser);
+        
+        if (status != QUERY_SUCCESS && firstError == QUERY_SUCCESS) {
+            firstError = status;
+        }
+    }
+    
+    for (size_t i = 0; i < fusibleCount; i++) {
+        done[i] = false;
+    }
+    
+    // Drive each query by its most widely shared component so groups are as large as possible
+    for (size_t i = 0; i < fusibleCount; i++) {
+        BatchQuery* query = &batch[i];
+        size_t best = 0;
+        query->driving = query->typeIds[0];
+        for (size_t j = 0; j < query->typeCount; j++) {
+            size_t frequency = type_frequency(batch, fusibleCount, query->typeIds[j]);
+            if (frequency > best) {
+                best = frequency;
+                query->driving = query->typeIds[j];
+            }
+        }
+    }
+    
+    // One pass over storage per driving component; overflowing queries may need a second pass on the same one
+    size_t passes = 0;
+    for (size_t i = 0; i < fusibleCount; i++) {
+        if (done[i]) continue;
+        
+        QueryStatus status = run_group(ecs, batch, fusibleCount, batch[i].driving, ++passes, done);
+        if (status != QUERY_SUCCESS && firstError == QUERY_SUCCESS) {
+            firstError = status;
+        }
+        
+        // A query with more residual types than the group table holds runs on its own
+        if (!done[i]) {
+            batch[i].needMask = 0;
+            done[i] = true;
+            struct QueryResult ecsResult = ECS_query_entities(ecs, batch[i].typeIds, batch[i].typeCount);
+            for (size_t e = 0; e < ecsResult.count; e++) {
+                if (batch[i].queryType == AST_COUNT) {
+                    batch[i].count++;
+                } else if ((uint64_t)batch[i].count < batch[i].limit && !append_entity(&batch[i], ecsResult.entities[e])) {
+                    if (firstError == QUERY_SUCCESS) firstError = QUERY_ERROR_EXECUTION;
+                    break;
+                }
+            }
+            QueryResult_free(&ecsResult);
+            batch[i].fused = true;
+        }
+    }
+    
+    // Hand each fused query its own output
+    for (size_t i = 0; i < fusibleCount; i++) {
+        BatchQuery* query = &batch[i];
+        if (query->fused) {
+            QueryEngineResult* out = &outResults[query->queryIndex];
+            out->count = query->count;
+            if (query->queryType == AST_SELECT && query->count > 0) {
+                out->entities = (QueryEntityId*)query->entities;
+                out->capacity = query->capacity;
+                query->entities = NULL;
+            }
+        }
+        if (query->entities) QUERY_FREE(query->entities);
+        QUERY_FREE(query->typeIds);
+    }
+    
+    QUERY_FREE(batch);
+    QUERY_FREE(done);
+    
+    return firstError;
+}
@@ -0,0 +1,453 @@
+#include "gramarye_query/cache.h"
+#include "gramarye_query/parser.h"
+#include "gramarye_query/executor.h"
+#include "gramarye_query/query.h"
+#include "gramarye_ecs/ecs.h"
+#include "gramarye_ecs/entity.h"
+#include "gramarye_ecs/component.h"
+#include "gramarye_query/allocator.h"
+#include "internal.h"
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define QUERY_CACHE_INITIAL_BUCKETS 64
+
+// Structural version of one component type
+typedef struct {
+    ComponentTypeId typeId;
+    uint64_t version;
+} ComponentVersion;
+
+// Cached result for one plan
+typedef struct CacheEntry {
+    uint64_t hash;
+    ASTNodeType predicateType;
+    uint64_t limit;               // SELECT LIMIT, QUERY_LIMIT_NONE if absent
+    ComponentTypeId* typeIds;     // Sorted, also the dependency list
+    uint64_t* typeVersions;       // Version of typeIds[i] when the entry was filled
+    size_t typeCount;
+    bool dependsOnEntities;       // not_has() also depends on entity creation
+    uint64_t entityVersion;
+    bool countOnly;               // Filled by COUNT, entities not stored
+    EntityId* entities;
+    size_t count;
+    size_t bytes;
+    struct CacheEntry* bucketNext;
+    struct CacheEntry* lruPrev;   // Towards most recently used
+    struct CacheEntry* lruNext;   // Towards least recently used
+} CacheEntry;
+
+struct QueryCache {
+    CacheEntry** buckets;
+    size_t bucketCount;
+    CacheEntry* lruHead;          // Most recently used
+    CacheEntry* lruTail;          // Least recently used
+    ComponentVersion* versions;
+    size_t versionCount;
+    size_t versionCapacity;
+    uint64_t entityVersion;
+    QueryCacheStats stats;
+};
+
+QueryCache* QueryCache_new(size_t maxBytes) {
+    QueryCache* cache = (QueryCache*)QUERY_ALLOC(sizeof(QueryCache));
+    if (!cache) return NULL;
+    
+    memset(cache, 0, sizeof(QueryCache));
+    cache->bucketCount = QUERY_CACHE_INITIAL_BUCKETS;
+    cache->buckets = (CacheEntry**)QUERY_ALLOC(sizeof(CacheEntry*) * cache->bucketCount);
+    if (!cache->buckets) {
+        QUERY_FREE(cache);
+        return NULL;
+    }
+    memset(cache->buckets, 0, sizeof(CacheEntry*) * cache->bucketCount);
+    cache->stats.maxBytes = maxBytes ? maxBytes : QUERY_CACHE_DEFAULT_MAX_BYTES;
+    
+    return cache;
+}
+
+static void entry_free(CacheEntry* entry) {
+    if (entry->typeIds) QUERY_FREE(entry->typeIds);
+    if (entry->typeVersions) QUERY_FREE(entry->typeVersions);
+    if (entry->entities) QUERY_FREE(entry->entities);
+    QUERY_FREE(entry);
+}
+
+// Unlink entry from its bucket and the LRU list, then free it
+static void remove_entry(QueryCache* cache, CacheEntry* entry) {
+    CacheEntry** link = &cache->buckets[entry->hash & (cache->bucketCount - 1)];
+    while (*link && *link != entry) {
+        link = &(*link)->bucketNext;
+    }
+    if (*link) {
+        *link = entry->bucketNext;
+    }
+    
+    if (entry->lruPrev) entry->lruPrev->lruNext = entry->lruNext;
+    else cache->lruHead = entry->lruNext;
+    if (entry->lruNext) entry->lruNext->lruPrev = entry->lruPrev;
+    else cache->lruTail = entry->lruPrev;
+    
+    cache->stats.entryCount--;
+    cache->stats.bytesUsed -= entry->bytes;
+    entry_free(entry);
+}
+
+static void touch_entry(QueryCache* cache, CacheEntry* entry) {
+    if (cache->lruHead == entry) return;
+    
+    // Unlink
+    if (entry->lruPrev) entry->lruPrev->lruNext = entry->lruNext;
+    if (entry->lruNext) entry->lruNext->lruPrev = entry->lruPrev;
+    else cache->lruTail = entry->lruPrev;
+    
+    // Push front
+    entry->lruPrev = NULL;
+    entry->lruNext = cache->lruHead;
+    if (cache->lruHead) cache->lruHead->lruPrev = entry;
+    cache->lruHead = entry;
+    if (!cache->lruTail) cache->lruTail = entry;
+}
+
+static void evict_to(QueryCache* cache, size_t maxBytes) {
+    while (cache->lruTail && cache->stats.bytesUsed > maxBytes) {
+        remove_entry(cache, cache->lruTail);
+        cache->stats.evictions++;
+    }
+}
+
+void QueryCache_clear(QueryCache* cache) {
+    if (!cache) return;
+    
+    while (cache->lruHead) {
+        remove_entry(cache, cache->lruHead);
+    }
+}
+
+void QueryCache_destroy(QueryCache* cache) {
+    if (!cache) return;
+    
+    QueryCache_clear(cache);
+    QUERY_FREE(cache->buckets);
+    if (cache->versions) {
+        QUERY_FREE(cache->versions);
+    }
+    QUERY_FREE(cache);
+}
+
+static ComponentVersion* find_version(const QueryCache* cache, ComponentTypeId typeId) {
+    for (size_t i = 0; i < cache->versionCount; i++) {
+        if (cache->versions[i].typeId == typeId) {
+            return &cache->versions[i];
+        }
+    }
+    return NULL;
+}
+
+uint64_t QueryCache_get_component_version(const QueryCache* cache, ComponentTypeId typeId) {
+    if (!cache) return 0;
+    
+    ComponentVersion* version = find_version(cache, typeId);
+    return version ? version->version : 0;
+}
+
+void QueryCache_bump_component(QueryCache* cache, ComponentTypeId typeId) {
+    if (!cache || typeId == COMPONENT_TYPE_INVALID) return;
+    
+    ComponentVersion* version = find_version(cache, typeId);
+    if (version) {
+        version->version++;
+        return;
+    }
+    
+    // First change for this type - grow the version table
+    if (cache->versionCount >= cache->versionCapacity) {
+        size_t newCapacity = cache->versionCapacity ? cache->versionCapacity * 2 : 16;
+        ComponentVersion* newVersions = (ComponentVersion*)QUERY_ALLOC(sizeof(ComponentVersion) * newCapacity);
+        if (!newVersions) {
+            // Can't track this type; drop everything so nothing stale is served
+            QueryCache_clear(cache);
+            return;
+        }
+        if (cache->versions) {
+            memcpy(newVersions, cache->versions, sizeof(ComponentVersion) * cache->versionCount);
+            QUERY_FREE(cache->versions);
+        }
+        cache->versions = newVersions;
+        cache->versionCapacity = newCapacity;
+    }
+    
+    cache->versions[cache->versionCount].typeId = typeId;
+    cache->versions[cache->versionCount].version = 1;
+    cache->versionCount++;
+}
+
+void QueryCache_bump_entities(QueryCache* cache) {
+    if (cache) {
+        cache->entityVersion++;
+    }
+}
+
+void QueryCache_set_max_bytes(QueryCache* cache, size_t maxBytes) {
+    if (!cache) return;
+    
+    cache->stats.maxBytes = maxBytes ? maxBytes : QUERY_CACHE_DEFAULT_MAX_BYTES;
+    evict_to(cache, cache->stats.maxBytes);
+}
+
+QueryCacheStats QueryCache_get_stats(const QueryCache* cache) {
+    QueryCacheStats stats;
+    memset(&stats, 0, sizeof(stats));
+    if (cache) {
+        stats = cache->stats;
+    }
+    return stats;
+}
+
+double QueryCache_hit_rate(const QueryCache* cache) {
+    if (!cache) return 0.0;
+    
+    uint64_t lookups = cache->stats.hits + cache->stats.misses;
+    return lookups ? (double)cache->stats.hits / (double)lookups : 0.0;
+}
+
+void QueryCache_reset_stats(QueryCache* cache) {
+    if (!cache) return;
+    
+    cache->stats.hits = 0;
+    cache->stats.misses = 0;
+    cache->stats.insertions = 0;
+    cache->stats.evictions = 0;
+    cache->stats.invalidations = 0;
+}
+
+// FNV-1a over the plan key
+static uint64_t hash_plan(ASTNodeType predicateType, uint64_t limit, const ComponentTypeId* typeIds, size_t count) {
+    uint64_t hash = QUERY_FNV_OFFSET;
+    hash = (hash ^ (uint64_t)predicateType) * QUERY_FNV_PRIME;
+    hash = (hash ^ limit) * QUERY_FNV_PRIME;
+    for (size_t i = 0; i < count; i++) {
+        hash = (hash ^ (uint64_t)typeIds[i]) * QUERY_FNV_PRIME;
+    }
+    return hash;
+}
+
+static CacheEntry* find_entry(QueryCache* cache, uint64_t hash, ASTNodeType predicateType, uint64_t limit,
+                              const ComponentTypeId* typeIds, size_t count) {
+    CacheEntry* entry = cache->buckets[hash & (cache->bucketCount - 1)];
+    while (entry) {
+        if (entry->hash == hash &&
+            entry->predicateType == predicateType &&
+            entry->limit == limit &&
+            entry->typeCount == count &&
+            memcmp(entry->typeIds, typeIds, sizeof(ComponentTypeId) * count) == 0) {
+            return entry;
+        }
+        entry = entry->bucketNext;
+    }
+    return NULL;
+}
+
+static bool entry_is_current(const QueryCache* cache, const CacheEntry* entry) {
+    if (entry->dependsOnEntities && entry->entityVersion != cache->entityVersion) {
+        return false;
+    }
+    for (size_t i = 0; i < entry->typeCount; i++) {
+        if (QueryCache_get_component_version(cache, entry->typeIds[i]) != entry->typeVersions[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void grow_buckets(QueryCache* cache) {
+    size_t newCount = cache->bucketCount * 2;
+    CacheEntry** newBuckets = (CacheEntry**)QUERY_ALLOC(sizeof(CacheEntry*) * newCount);
+    if (!newBuckets) return;  // Keep the old table, chains just get longer
+    memset(newBuckets, 0, sizeof(CacheEntry*) * newCount);
+    
+    for (size_t i = 0; i < cache->bucketCount; i++) {
+        CacheEntry* entry = cache->buckets[i];
+        while (entry) {
+            CacheEntry* next = entry->bucketNext;
+            size_t slot = entry->hash & (newCount - 1);
+            entry->bucketNext = newBuckets[slot];
+            newBuckets[slot] = entry;
+            entry = next;
+        }
+    }
+    
+    QUERY_FREE(cache->buckets);
+    cache->buckets = newBuckets;
+    cache->bucketCount = newCount;
+}
+
+// Store a freshly executed result. Entities are copied when present.
+static void insert_entry(QueryCache* cache, uint64_t hash, ASTNodeType predicateType, uint64_t limit,
+                         const ComponentTypeId* typeIds, size_t count,
+                         const QueryEngineResult* result, bool countOnly) {
+    size_t entityBytes = countOnly ? 0 : sizeof(EntityId) * result->count;
+    size_t bytes = sizeof(CacheEntry) + (sizeof(ComponentTypeId) + sizeof(uint64_t)) * count + entityBytes;
+    if (bytes > cache->stats.maxBytes) {
+        return;  // Would evict everything and still not fit
+    }
+    
+    CacheEntry* entry = (CacheEntry*)QUERY_ALLOC(sizeof(CacheEntry));
+    if (!entry) return;
+    memset(entry, 0, sizeof(CacheEntry));
+    
+    entry->typeIds = (ComponentTypeId*)QUERY_ALLOC(sizeof(ComponentTypeId) * count);
+    entry->typeVersions = (uint64_t*)QUERY_ALLOC(sizeof(uint64_t) * count);
+    if (!entry->typeIds || !entry->typeVersions) {
+        entry_free(entry);
+        return;
+    }
+    if (entityBytes > 0) {
+        entry->entities = (EntityId*)QUERY_ALLOC(entityBytes);
+        if (!entry->entities) {
+            entry_free(entry);
+            return;
+        }
+        memcpy(entry->entities, result->entities, entityBytes);
+    }
+    
+    entry->hash = hash;
+    entry->predicateType = predicateType;
+    entry->limit = limit;
+    memcpy(entry->typeIds, typeIds, sizeof(ComponentTypeId) * count);
+    for (size_t i = 0; i < count; i++) {
+        entry->typeVersions[i] = QueryCache_get_component_version(cache, typeIds[i]);
+    }
+    entry->typeCount = count;
+    entry->dependsOnEntities = (predicateType == AST_NOT_HAS);
+    entry->entityVersion = cache->entityVersion;
+    entry->countOnly = countOnly;
+    entry->count = result->count;
+    entry->bytes = bytes;
+    
+    evict_to(cache, cache->stats.maxBytes - bytes);
+    
+    if (cache->stats.entryCount >= cache->bucketCount) {
+        grow_buckets(cache);
+    }
+    
+    size_t slot = hash & (cache->bucketCount - 1);
+    entry->bucketNext = cache->buckets[slot];
+    cache->buckets[slot] = entry;
+    
+    entry->lruPrev = NULL;
+    entry->lruNext = cache->lruHead;
+    if (cache->lruHead) cache->lruHead->lruPrev = entry;
+    cache->lruHead = entry;
+    if (!cache->lruTail) cache->lruTail = entry;
+    
+    cache->stats.entryCount++;
+    cache->stats.bytesUsed += bytes;
+    cache->stats.insertions++;
+}
+
+// Fill outResult from a cache entry (caller owns the copy)
+static QueryStatus serve_entry(const CacheEntry* entry, ASTNodeType queryType, QueryEngineResult* outResult) {
+    outResult->count = entry->count;
+    
+    if (queryType == AST_SELECT && entry->count > 0) {
+        outResult->entities = (QueryEntityId*)QUERY_ALLOC(sizeof(EntityId) * entry->count);
+        if (!outResult->entities) {
+            outResult->count = 0;
+            return QUERY_ERROR_EXECUTION;
+        }
+        memcpy(outResult->entities, entry->entities, sizeof(EntityId) * entry->count);
+        outResult->capacity = entry->count;
+    }
+    
+    return QUERY_SUCCESS;
+}
+
+QueryStatus QueryCache_execute(QueryCache* cache, ECS* ecs, const char* queryString, QueryEngineResult* outResult) {
+    if (!cache) {
+        return Query_execute(ecs, queryString, outResult);
+    }
+    if (!ecs || !queryString || !outResult) {
+        return QUERY_ERROR_INVALID_SYNTAX;
+    }
+    
+    // Initialize result
+    QueryEngineResult_init(outResult);
+    
+    QueryParser* parser = QueryParser_new(queryString);
+    if (!parser) {
+        return QUERY_ERROR_PARSE;
+    }
+    
+    QueryAST* ast = QueryParser_parse(parser);
+    if (!ast) {
+        QueryParser_destroy(parser);
+        return QUERY_ERROR_PARSE;
+    }
+    
+    ASTNodeType queryType = QueryAST_get_type(ast);
+    QueryAST* predicate = QueryAST_get_left(ast);
+    ComponentList* componentList = QueryExecutor_is_component_predicate(predicate) ?
+                                   (ComponentList*)QueryAST_get_data(predicate) : NULL;
+    
+    // Only entity queries with a component predicate are cacheable; filters read component data
+    // and samples are not the full answer
+    if ((queryType != AST_SELECT && queryType != AST_COUNT) || !componentList || componentList->count == 0 ||
+        QueryExecutor_get_sampling(ast, NULL) != SAMPLE_NONE) {
+        QueryStatus status = QueryExecutor_execute(ecs, ast, outResult);
+        QueryAST_destroy(ast);
+        QueryParser_destroy(parser);
+        return status;
+    }
+    
+    uint64_t limit;
+    QueryStatus limitStatus = QueryExecutor_get_limit(ast, &limit);
+    if (limitStatus != QUERY_SUCCESS) {
+        QueryAST_destroy(ast);
+        QueryParser_destroy(parser);
+        return limitStatus;
+    }
+    
+    ComponentTypeId* typeIds = (ComponentTypeId*)QUERY_ALLOC(sizeof(ComponentTypeId) * componentList->count);
+    if (!typeIds) {
+        QueryAST_destroy(ast);
+        QueryParser_destroy(parser);
+        return QUERY_ERROR_EXECUTION;
+    }
+    
+    // Build the plan key: predicate kind + LIMIT + canonical component set
+    ASTNodeType predicateType = QueryAST_get_type(predicate);
+    size_t count = QueryExecutor_canonical_components(ecs, componentList, typeIds);
+    uint64_t hash = hash_plan(predicateType, limit, typeIds, count);
+    
+    QueryStatus status;
+    CacheEntry* entry = find_entry(cache, hash, predicateType, limit, typeIds, count);
+    if (entry && !entry_is_current(cache, entry)) {
+        remove_entry(cache, entry);
+        cache->stats.invalidations++;
+        entry = NULL;
+    }
+    
+    if (entry && (queryType == AST_COUNT || !entry->countOnly)) {
+        cache->stats.hits++;
+        touch_entry(cache, entry);
+        status = serve_entry(entry, queryType, outResult);
+    } else {
+        cache->stats.misses++;
+        if (entry) {
+            // COUNT-only entry can't serve a SELECT; replace it below
+            remove_entry(cache, entry);
+        }
+        status = QueryExecutor_execute(ecs, ast, outResult);
+        if (status == QUERY_SUCCESS) {
+            insert_entry(cache, hash, predicateType, limit, typeIds, count, outResult, queryType == AST_COUNT);
+        }
+    }
+    
+    QUERY_FREE(typeIds);
+    QueryAST_destroy(ast);
+    QueryParser_destroy(parser);
+    
+    return status;
+}
@@ -0,0 +1,937 @@
+#include "gramarye_query/catalog.h"
+#include "gramarye_query/field_index.h"
+#include "gramarye_query/spatial_index.h"
+#include "gramarye_query/hash_index.h"
+#include "gramarye_query/entity_set.h"
+#include "gramarye_query/parser.h"
+#include "gramarye_query/executor.h"
+#include "gramarye_query/query.h"
+#include "gramarye_ecs/ecs.h"
+#include "gramarye_ecs/query.h"
+#include "gramarye_ecs/entity.h"
+#include "gramarye_ecs/component.h"
+#include "gramarye_query/allocator.h"
+#include "gramarye_query/profile.h"
+#include "internal.h"
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+
+// Queries only read the catalog apart from the usage counters below, which
+// are bumped atomically so concurrent queries through one catalog are safe
+#if defined(__GNUC__) || defined(__clang__)
+#define COUNTER_BUMP(counter) __atomic_fetch_add(&(counter), 1, __ATOMIC_RELAXED)
+#define COUNTER_LOAD(counter) __atomic_load_n(&(counter), __ATOMIC_RELAXED)
+#else
+#define COUNTER_BUMP(counter) ((counter)++)
+#define COUNTER_LOAD(counter) (counter)
+#endif
+
+typedef struct {
+    QueryField field;
+    char* componentName;
+    char* fieldName;
+    FieldIndex* index;      // NULL until CREATE INDEX
+    double buildMs;
+    uint64_t scans;
+    HashIndex* hash;        // NULL until CREATE HASH INDEX
+    double hashBuildMs;
+    uint64_t hashLookups;
+} CatalogField;
+
+// A component's designated position and the grid over it
+typedef struct {
+    ComponentTypeId typeId;
+    QueryField x;
+    QueryField y;
+    SpatialIndex* index;
+    double buildMs;
+    uint64_t scans;
+} CatalogSpatial;
+
+// Writes to one component type since the last clear
+typedef struct {
+    ComponentTypeId typeId;
+    EntityIndexMap* map;    // Entities written in the window, emptied by clear
+    EntityBitset dirty;     // By dense index from map
+    uint32_t* positionOf;   // By dense index from map: position in changed while dirty
+    size_t positionCapacity;
+    EntityId* changed;      // Each dirty entity once
+    size_t changedCount;
+    size_t changedCapacity;
+    bool lost;              // A write could not be recorded; CHANGED fails until the next clear
+} CatalogTracker;
+
+struct QueryCatalog {
+    ECS* ecs;
+    CatalogField* fields;
+    size_t fieldCount;
+    size_t fieldCapacity;
+    CatalogSpatial* spatial;
+    size_t spatialCount;
+    size_t spatialCapacity;
+    CatalogTracker* trackers;
+    size_t trackerCount;
+    uint64_t schemaVersion;     // Bumped by every field, index and tracking change
+};
+
+static size_t field_type_size(QueryFieldType type) {
+    switch (type) {
+        case QUERY_FIELD_I32:
+        case QUERY_FIELD_U32:
+        case QUERY_FIELD_F32:
+            return 4;
+        case QUERY_FIELD_I64:
+        case QUERY_FIELD_U64:
+        case QUERY_FIELD_F64:
+            return 8;
+    }
+    return 0;
+}
+
+static char* copy_string(const char* text) {
+    size_t length = strlen(text);
+    char* copy = (char*)QUERY_ALLOC(length + 1);
+    if (copy) {
+        memcpy(copy, text, length + 1);
+    }
+    return copy;
+}
+
+QueryCatalog* QueryCatalog_new(ECS* ecs) {
+    if (!ecs) return NULL;
+    
+    QueryCatalog* catalog = (QueryCatalog*)QUERY_ALLOC(sizeof(QueryCatalog));
+    if (!catalog) return NULL;
+    
+    memset(catalog, 0, sizeof(QueryCatalog));
+    catalog->ecs = ecs;
+    return catalog;
+}
+
+void QueryCatalog_destroy(QueryCatalog* catalog) {
+    if (!catalog) return;
+    
+    for (size_t i = 0; i < catalog->fieldCount; i++) {
+        CatalogField* entry = &catalog->fields[i];
+        QUERY_FREE(entry->componentName);
+        QUERY_FREE(entry->fieldName);
+        if (entry->index) {
+            FieldIndex_destroy(entry->index);
+        }
+        if (entry->hash) {
+            HashIndex_destroy(entry->hash);
+        }
+    }
+    if (catalog->fields) {
+        QUERY_FREE(catalog->fields);
+    }
+    for (size_t i = 0; i < catalog->spatialCount; i++) {
+        SpatialIndex_destroy(catalog->spatial[i].index);
+    }
+    if (catalog->spatial) {
+        QUERY_FREE(catalog->spatial);
+    }
+    for (size_t i = 0; i < catalog->trackerCount; i++) {
+        EntityIndexMap_destroy(catalog->trackers[i].map);
+        EntityBitset_free(&catalog->trackers[i].dirty);
+        if (catalog->trackers[i].positionOf) {
+            QUERY_FREE(catalog->trackers[i].positionOf);
+        }
+        if (catalog->trackers[i].changed) {
+            QUERY_FREE(catalog->trackers[i].changed);
+        }
+    }
+    if (catalog->trackers) {
+        QUERY_FREE(catalog->trackers);
+    }
+    QUERY_FREE(catalog);
+}
+
+ECS* QueryCatalog_get_ecs(const QueryCatalog* catalog) {
+    return catalog ? catalog->ecs : NULL;
+}
+
+uint64_t QueryCatalog_schema_version(const QueryCatalog* catalog) {
+    return catalog ? catalog->schemaVersion : 0;
+}
+
+static CatalogField* find_entry(const QueryCatalog* catalog, const char* componentName, const char* fieldName) {
+    if (!catalog || !componentName || !fieldName) return NULL;
+    
+    QUERY_COUNT_LOOKUP();
+    for (size_t i = 0; i < catalog->fieldCount; i++) {
+        CatalogField* entry = &catalog->fields[i];
+        if (strcmp(entry->componentName, componentName) == 0 && strcmp(entry->fieldName, fieldName) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static CatalogField* find_entry_by_field(const QueryCatalog* catalog, const QueryField* field) {
+    if (!catalog || !field) return NULL;
+    
+    for (size_t i = 0; i < catalog->fieldCount; i++) {
+        CatalogField* entry = &catalog->fields[i];
+        if (entry->field.typeId == field->typeId && entry->field.offset == field->offset &&
+            entry->field.type == field->type) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+QueryStatus QueryCatalog_register_field(QueryCatalog* catalog,
+                                        const char* componentName,
+                                        const char* fieldName,
+                                        size_t offset,
+                                        QueryFieldType type) {
+    if (!catalog || !componentName || !fieldName) {
+        return QUERY_ERROR_INVALID_SYNTAX;
+    }
+    
+    ComponentTypeId typeId = query_type_by_name(catalog->ecs, componentName);
+    if (typeId == COMPONENT_TYPE_INVALID) {
+        return QUERY_ERROR_EXECUTION;
+    }
+    
+    // The field must lie inside the component
+    ComponentType* componentType = ECS_get_component_type(catalog->ecs, typeId);
+    size_t fieldSize = field_type_size(type);
+    if (!componentType || fieldSize == 0 || offset + fieldSize > componentType->size) {
+        return QUERY_ERROR_EXECUTION;
+    }
+    
+    CatalogField* existing = find_entry(catalog, componentName, fieldName);
+    if (existing) {
+        // Re-registering the same layout is harmless; a different one is a mistake
+        return existing->field.offset == offset && existing->field.type == type ? QUERY_SUCCESS
+                                                                                : QUERY_ERROR_EXECUTION;
+    }
+    
+    if (catalog->fieldCount >= catalog->fieldCapacity) {
+        size_t newCapacity = catalog->fieldCapacity ? catalog->fieldCapacity * 2 : 8;
+        CatalogField* newFields = (CatalogField*)QUERY_ALLOC(sizeof(CatalogField) * newCapacity);
+        if (!newFields) return QUERY_ERROR_EXECUTION;
+        if (catalog->fields) {
+            memcpy(newFields, catalog->fields, sizeof(CatalogField) * catalog->fieldCount);
+            QUERY_FREE(catalog->fields);
+        }
+        catalog->fields = newFields;
+        catalog->fieldCapacity = newCapacity;
+    }
+    
+    CatalogField* entry = &catalog->fields[catalog->fieldCount];
+    memset(entry, 0, sizeof(CatalogField));
+    entry->field.typeId = typeId;
+    entry->field.offset = offset;
+    entry->field.type = type;
+    entry->componentName = copy_string(componentName);
+    entry->fieldName = copy_string(fieldName);
+    if (!entry->componentName || !entry->fieldName) {
+        if (entry->componentName) QUERY_FREE(entry->componentName);
+        if (entry->fieldName) QUERY_FREE(entry->fieldName);
+        return QUERY_ERROR_EXECUTION;
+    }
+    
+    catalog->fieldCount++;
+    catalog->schemaVersion++;
+    return QUERY_SUCCESS;
+}
+
+QueryCatalog* QueryCatalog_clone_schema(const QueryCatalog* catalog, ECS* ecs) {
+    QueryCatalog* clone = QueryCatalog_new(ecs);
+    if (clone && QueryCatalog_copy_schema(clone, catalog) != QUERY_SUCCESS) {
+        QueryCatalog_destroy(clone);
+        return NULL;
+    }
+    return clone;
+}
+
+QueryStatus QueryCatalog_copy_schema(QueryCatalog* catalog, const QueryCatalog* source) {
+    if (!catalog) return QUERY_ERROR_EXECUTION;
+    if (!source) return QUERY_SUCCESS;
+    
+    for (size_t i = 0; i < source->fieldCount; i++) {
+        const CatalogField* entry = &source->fields[i];
+        if (find_entry(catalog, entry->componentName, entry->fieldName)) {
+            continue; // Fields never change layout once registered
+        }
+        if (query_type_by_name(catalog->ecs, entry->componentName) == COMPONENT_TYPE_INVALID) {
+            continue; // Component not present in catalog's ECS
+        }
+        QueryStatus status = QueryCatalog_register_field(catalog, entry->componentName, entry->fieldName,
+                                                         entry->field.offset, entry->field.type);
+        if (status != QUERY_SUCCESS) return status;
+    }
+    return QUERY_SUCCESS;
+}
+
+bool QueryCatalog_find_field(const QueryCatalog* catalog,
+                             const char* componentName,
+                             const char* fieldName,
+                             QueryField* outField) {
+    CatalogField* entry = find_entry(catalog, componentName, fieldName);
+    if (!entry) return false;
+    
+    if (outField) {
+        *outField = entry->field;
+    }
+    return true;
+}
+
+double QueryField_read(const QueryField* field, const void* componentData) {
+    const unsigned char* bytes = (const unsigned char*)componentData + field->offset;
+    
+    // memcpy keeps unaligned fields (packed components) safe
+    switch (field->type) {
+        case QUERY_FIELD_I32: {
+            int32_t value;
+            memcpy(&value, bytes, sizeof(value));
+            return (double)value;
+        }
+        case QUERY_FIELD_U32: {
+            uint32_t value;
+            memcpy(&value, bytes, sizeof(value));
+            return (double)value;
+        }
+        case QUERY_FIELD_I64: {
+            int64_t value;
+            memcpy(&value, bytes, sizeof(value));
+            return (double)value;
+        }
+        case QUERY_FIELD_U64: {
+            uint64_t value;
+            memcpy(&value, bytes, sizeof(value));
+            return (double)value;
+        }
+        case QUERY_FIELD_F32: {
+            float value;
+            memcpy(&value, bytes, sizeof(value));
+            return (double)value;
+        }
+        case QUERY_FIELD_F64: {
+            double value;
+            memcpy(&value, bytes, sizeof(value));
+            return value;
+        }
+    }
+    return 0.0;
+}
+
+uint64_t QueryField_read_key(const QueryField* field, const void* componentData) {
+    const unsigned char* bytes = (const unsigned char*)componentData + field->offset;
+    
+    // Signed values are sign-extended so the key matches QueryField_key_for_value
+    switch (field->type) {
+        case QUERY_FIELD_I32: {
+            int32_t value;
+            memcpy(&value, bytes, sizeof(value));
+            return (uint64_t)(int64_t)value;
+        }
+        case QUERY_FIELD_U32: {
+            uint32_t value;
+            memcpy(&value, bytes, sizeof(value));
+            return value;
+        }
+        case QUERY_FIELD_I64:
+        case QUERY_FIELD_U64: {
+            uint64_t value;
+            memcpy(&value, bytes, sizeof(value));
+            return value;
+        }
+        case QUERY_FIELD_F32:
+        case QUERY_FIELD_F64:
+            break;
+    }
+    return 0;
+}
+
+bool QueryField_key_for_value(const QueryField* field, double value, uint64_t* outKey) {
+    if (!field || !query_field_is_integer(field->type) || value != floor(value)) {
+        return false; // Also rejects NaN and infinities
+    }
+    
+    switch (field->type) {
+        case QUERY_FIELD_I32:
+            if (value < (double)INT32_MIN || value > (double)INT32_MAX) return false;
+            break;
+        case QUERY_FIELD_U32:
+            if (value < 0.0 || value > (double)UINT32_MAX) return false;
+            break;
+        case QUERY_FIELD_I64:
+            if (value < -9223372036854775808.0 || value >= 9223372036854775808.0) return false;
+            break;
+        default:
+            if (value < 0.0 || value >= 18446744073709551616.0) return false;
+            break;
+    }
+    
+    *outKey = value < 0.0 ? (uint64_t)(int64_t)value : (uint64_t)value;
+    return true;
+}
+
+QueryStatus QueryCatalog_create_index(QueryCatalog* catalog, const char* componentName, const char* fieldName) {
+    CatalogField* entry = find_entry(catalog, componentName, fieldName);
+    if (!entry) {
+        return QUERY_ERROR_EXECUTION;
+    }
+    
+    uint64_t start = query_now_ns();
+    
+    struct QueryResult ecsResult = ECS_query_entities(catalog->ecs, &entry->field.typeId, 1);
+    double* values = (double*)QUERY_ALLOC(sizeof(double) * (ecsResult.count ? ecsResult.count : 1));
+    FieldIndex* index = entry->index ? entry->index : FieldIndex_new();
+    if (!values || !index) {
+        if (values) QUERY_FREE(values);
+        if (index && index != entry->index) FieldIndex_destroy(index);
+        QueryResult_free(&ecsResult);
+        return QUERY_ERROR_EXECUTION;
+    }
+    
+    for (size_t i = 0; i < ecsResult.count; i++) {
+        void* data = ECS_get_component(catalog->ecs, ecsResult.entities[i], entry->field.typeId);
+        values[i] = QueryField_read(&entry->field, data);
+    }
+    
+    bool built = FieldIndex_build(index, ecsResult.entities, values, ecsResult.count);
+    QUERY_FREE(values);
+    QueryResult_free(&ecsResult);
+    
+    if (!built) {
+        FieldIndex_destroy(index);
+        entry->index = NULL;
+        return QUERY_ERROR_EXECUTION;
+    }
+    
+    entry->index = index;
+    entry->buildMs = (double)(query_now_ns() - start) / 1e6;
+    entry->scans = 0;
+    catalog->schemaVersion++;
+    return QUERY_SUCCESS;
+}
+
+QueryStatus QueryCatalog_drop_index(QueryCatalog* catalog, const char* componentName, const char* fieldName) {
+    CatalogField* entry = find_entry(catalog, componentName, fieldName);
+    if (!entry || !entry->index) {
+        return QUERY_ERROR_EXECUTION;
+    }
+    
+    FieldIndex_destroy(entry->index);
+    entry->index = NULL;
+    catalog->schemaVersion++;
+    return QUERY_SUCCESS;
+}
+
+FieldIndex* QueryCatalog_find_index(const QueryCatalog* catalog, const QueryField* field) {
+    CatalogField* entry = find_entry_by_field(catalog, field);
+    return entry ? entry->index : NULL;
+}
+
+void QueryCatalog_record_scan(QueryCatalog* catalog, const QueryField* field) {
+    CatalogField* entry = find_entry_by_field(catalog, field);
+    if (entry) {
+        COUNTER_BUMP(entry->scans);
+    }
+}
+
+QueryStatus QueryCatalog_get_index_stats(const QueryCatalog* catalog,
+                                         const char* componentName,
+                                         const char* fieldName,
+                                         QueryIndexStats* outStats) {
+    CatalogField* entry = find_entry(catalog, componentName, fieldName);
+    if (!entry || !entry->index || !outStats) {
+        return QUERY_ERROR_EXECUTION;
+    }
+    
+    outStats->entryCount = FieldIndex_count(entry->index);
+    outStats->pendingCount = FieldIndex_pending(entry->index);
+    outStats->memoryBytes = FieldIndex_memory_bytes(entry->index);
+    outStats->buildMs = entry->buildMs;
+    outStats->scans = COUNTER_LOAD(entry->scans);
+    return QUERY_SUCCESS;
+}
+
+QueryStatus QueryCatalog_create_hash_index(QueryCatalog* catalog, const char* componentName, const char* fieldName) {
+    CatalogField* entry = find_entry(catalog, componentName, fieldName);
+    if (!entry || !query_field_is_integer(entry->field.type)) {
+        return QUERY_ERROR_EXECUTION;
+    }
+    
+    HashIndex* hash = HashIndex_new();
+    if (!hash) {
+        return QUERY_ERROR_EXECUTION;
+    }
+    
+    uint64_t start = query_now_ns();
+    
+    struct QueryResult ecsResult = ECS_query_entities(catalog->ecs, &entry->field.typeId, 1);
+    bool built = true;
+    for (size_t i = 0; i < ecsResult.count && built; i++) {
+        void* data = ECS_get_component(catalog->ecs, ecsResult.entities[i], entry->field.typeId);
+        built = HashIndex_set(hash, ecsResult.entities[i], QueryField_read_key(&entry->field, data));
+    }
+    QueryResult_free(&ecsResult);
+    
+    if (!built) {
+        HashIndex_destroy(hash);
+        return QUERY_ERROR_EXECUTION;
+    }
+    
+    if (entry->hash) {
+        HashIndex_destroy(entry->hash);
+    }
+    entry->hash = hash;
+    entry->hashBuildMs = (double)(query_now_ns() - start) / 1e6;
+    entry->hashLookups = 0;
+    catalog->schemaVersion++;
+    return QUERY_SUCCESS;
+}
+
+QueryStatus QueryCatalog_drop_hash_index(QueryCatalog* catalog, const char* componentName, const char* fieldName) {
+    CatalogField* entry = find_entry(catalog, componentName, fieldName);
+    if (!entry || !entry->hash) {
+        return QUERY_ERROR_EXECUTION;
+    }
+    
+    HashIndex_destroy(entry->hash);
+    entry->hash = NULL;
+    catalog->schemaVersion++;
+    return QUERY_SUCCESS;
+}
+
+HashIndex* QueryCatalog_find_hash_index(const QueryCatalog* catalog, const QueryField* field) {
+    CatalogField* entry = find_entry_by_field(catalog, field);
+    return entry ? entry->hash : NULL;
+}
+
+void QueryCatalog_record_hash_lookup(QueryCatalog* catalog, const QueryField* field) {
+    CatalogField* entry = find_entry_by_field(catalog, field);
+    if (entry) {
+        COUNTER_BUMP(entry->hashLookups);
+    }
+}
+
+QueryStatus QueryCatalog_get_hash_index_stats(const QueryCatalog* catalog,
+                                              const char* componentName,
+                                              const char* fieldName,
+                                              QueryIndexStats* outStats) {
+    CatalogField* entry = find_entry(catalog, componentName, fieldName);
+    if (!entry || !entry->hash || !outStats) {
+        return QUERY_ERROR_EXECUTION;
+    }
+    
+    outStats->entryCount = HashIndex_count(entry->hash);
+    outStats->pendingCount = 0; // Hash updates apply immediately
+    outStats->memoryBytes = HashIndex_memory_bytes(entry->hash);
+    outStats->buildMs = entry->hashBuildMs;
+    outStats->scans = COUNTER_LOAD(entry->hashLookups);
+    return QUERY_SUCCESS;
+}
+
+static CatalogSpatial* find_spatial(const QueryCatalog* catalog, ComponentTypeId typeId) {
+    if (!catalog) return NULL;
+    
+    for (size_t i = 0; i < catalog->spatialCount; i++) {
+        if (catalog->spatial[i].typeId == typeId) {
+            return &catalog->spatial[i];
+        }
+    }
+    return NULL;
+}
+
+static CatalogSpatial* find_spatial_by_name(const QueryCatalog* catalog, const char* componentName) {
+    if (!catalog || !componentName) return NULL;
+    
+    ComponentTypeId typeId = query_type_by_name(catalog->ecs, componentName);
+    return typeId == COMPONENT_TYPE_INVALID ? NULL : find_spatial(catalog, typeId);
+}
+
+static CatalogSpatial* add_spatial(QueryCatalog* catalog) {
+    if (catalog->spatialCount >= catalog->spatialCapacity) {
+        size_t newCapacity = catalog->spatialCapacity ? catalog->spatialCapacity * 2 : 4;
+        CatalogSpatial* newSpatial = (CatalogSpatial*)QUERY_ALLOC(sizeof(CatalogSpatial) * newCapacity);
+        if (!newSpatial) return NULL;
+        if (catalog->spatial) {
+            memcpy(newSpatial, catalog->spatial, sizeof(CatalogSpatial) * catalog->spatialCount);
+            QUERY_FREE(catalog->spatial);
+        }
+        catalog->spatial = newSpatial;
+        catalog->spatialCapacity = newCapacity;
+    }
+    
+    CatalogSpatial* entry = &catalog->spatial[catalog->spatialCount++];
+    memset(entry, 0, sizeof(CatalogSpatial));
+    return entry;
+}
+
+QueryStatus QueryCatalog_create_spatial_index(QueryCatalog* catalog,
+                                              const char* componentName,
+                                              const char* xField,
+                                              const char* yField,
+                                              double cellSize) {
+    CatalogField* xEntry = find_entry(catalog, componentName, xField);
+    CatalogField* yEntry = find_entry(catalog, componentName, yField);
+    if (!xEntry || !yEntry || xEntry == yEntry) {
+        return QUERY_ERROR_EXECUTION;
+    }
+    
+    SpatialIndex* index = SpatialIndex_new(cellSize);
+    if (!index) {
+        return QUERY_ERROR_EXECUTION;
+    }
+    
+    uint64_t start = query_now_ns();
+    
+    ComponentTypeId typeId = xEntry->field.typeId;
+    struct QueryResult ecsResult = ECS_query_entities(catalog->ecs, &typeId, 1);
+    bool built = true;
+    for (size_t i = 0; i < ecsResult.count && built; i++) {
+        void* data = ECS_get_component(catalog->ecs, ecsResult.entities[i], typeId);
+        built = SpatialIndex_set(index, ecsResult.entities[i],
+                                 QueryField_read(&xEntry->field, data),
+                                 QueryField_read(&yEntry->field, data));
+    }
+    QueryResult_free(&ecsResult);
+    
+    CatalogSpatial* entry = find_spatial(catalog, typeId);
+    if (built && !entry) {
+        entry = add_spatial(catalog);
+    }
+    if (!built || !entry) {
+        SpatialIndex_destroy(index);
+        return QUERY_ERROR_EXECUTION;
+    }
+    
+    if (entry->index) {
+        SpatialIndex_destroy(entry->index);
+    }
+    entry->typeId = typeId;
+    entry->x = xEntry->field;
+    entry->y = yEntry->field;
+    entry->index = index;
+    entry->buildMs = (double)(query_now_ns() - start) / 1e6;
+    entry->scans = 0;
+    catalog->schemaVersion++;
+    return QUERY_SUCCESS;
+}
+
+QueryStatus QueryCatalog_drop_spatial_index(QueryCatalog* catalog, const char* componentName) {
+    CatalogSpatial* entry = find_spatial_by_name(catalog, componentName);
+    if (!entry) {
+        return QUERY_ERROR_EXECUTION;
+    }
+    
+    SpatialIndex_destroy(entry->index);
+    *entry = catalog->spatial[--catalog->spatialCount];
+    catalog->schemaVersion++;
+    return QUERY_SUCCESS;
+}
+
+SpatialIndex* QueryCatalog_find_spatial_index(const QueryCatalog* catalog,
+                                              ComponentTypeId typeId,
+                                              QueryField* outX,
+                                              QueryField* outY) {
+    CatalogSpatial* entry = find_spatial(catalog, typeId);
+    if (!entry) return NULL;
+    
+    if (outX) *outX = entry->x;
+    if (outY) *outY = entry->y;
+    return entry->index;
+}
+
+void QueryCatalog_record_spatial_scan(QueryCatalog* catalog, ComponentTypeId typeId) {
+    CatalogSpatial* entry = find_spatial(catalog, typeId);
+    if (entry) {
+        COUNTER_BUMP(entry->scans);
+    }
+}
+
+QueryStatus QueryCatalog_get_spatial_stats(const QueryCatalog* catalog,
+                                           const char* componentName,
+                                           QueryIndexStats* outStats) {
+    CatalogSpatial* entry = find_spatial_by_name(catalog, componentName);
+    if (!entry || !outStats) {
+        return QUERY_ERROR_EXECUTION;
+    }
+    
+    outStats->entryCount = SpatialIndex_count(entry->index);
+    outStats->pendingCount = 0; // Grid updates apply immediately
+    outStats->memoryBytes = SpatialIndex_memory_bytes(entry->index);
+    outStats->buildMs = entry->buildMs;
+    outStats->scans = COUNTER_LOAD(entry->scans);
+    return QUERY_SUCCESS;
+}
+
+static CatalogTracker* find_tracker(const QueryCatalog* catalog, ComponentTypeId typeId) {
+    if (!catalog) return NULL;
+    
+    for (size_t i = 0; i < catalog->trackerCount; i++) {
+        if (catalog->trackers[i].typeId == typeId) {
+            return &catalog->trackers[i];
+        }
+    }
+    return NULL;
+}
+
+QueryStatus QueryCatalog_track_changes(QueryCatalog* catalog, const char* componentName) {
+    if (!catalog || !componentName) {
+        return QUERY_ERROR_INVALID_SYNTAX;
+    }
+    
+    ComponentTypeId typeId = query_type_by_name(catalog->ecs, componentName);
+    if (typeId == COMPONENT_TYPE_INVALID) {
+        return QUERY_ERROR_EXECUTION;
+    }
+    if (find_tracker(catalog, typeId)) {
+        return QUERY_SUCCESS;
+    }
+    
+    CatalogTracker* trackers = (CatalogTracker*)QUERY_ALLOC(sizeof(CatalogTracker) * (catalog->trackerCount + 1));
+    if (!trackers) {
+        return QUERY_ERROR_EXECUTION;
+    }
+    
+    CatalogTracker* tracker = &trackers[catalog->trackerCount];
+    memset(tracker, 0, sizeof(CatalogTracker));
+    tracker->typeId = typeId;
+    tracker->map = EntityIndexMap_new(256);
+    if (!tracker->map || !EntityBitset_init(&tracker->dirty, 256)) {
+        if (tracker->map) EntityIndexMap_destroy(tracker->map);
+        QUERY_FREE(trackers);
+        return QUERY_ERROR_EXECUTION;
+    }
+    
+    if (catalog->trackers) {
+        memcpy(trackers, catalog->trackers, sizeof(CatalogTracker) * catalog->trackerCount);
+        QUERY_FREE(catalog->trackers);
+    }
+    catalog->trackers = trackers;
+    catalog->trackerCount++;
+    catalog->schemaVersion++;
+    return QUERY_SUCCESS;
+}
+
+void QueryCatalog_clear_changes(QueryCatalog* catalog) {
+    if (!catalog) return;
+    
+    // Clear only the bits that were set, so the cost follows the changes; the
+    // map only holds this window's entities, so destroyed ones leave with it
+    for (size_t i = 0; i < catalog->trackerCount; i++) {
+        CatalogTracker* tracker = &catalog->trackers[i];
+        for (size_t j = 0; j < tracker->changedCount; j++) {
+            uint32_t index = EntityIndexMap_find(tracker->map, tracker->changed[j]);
+            EntityBitset_unset(&tracker->dirty, index);
+        }
+        EntityIndexMap_clear(tracker->map);
+        tracker->changedCount = 0;
+        tracker->lost = false;
+    }
+}
+
+bool QueryCatalog_get_changes(const QueryCatalog* catalog,
+                              ComponentTypeId typeId,
+                              const EntityId** outEntities,
+                              size_t* outCount) {
+    CatalogTracker* tracker = find_tracker(catalog, typeId);
+    if (!tracker || tracker->lost) return false;
+    
+    *outEntities = tracker->changed;
+    *outCount = tracker->changedCount;
+    return true;
+}
+
+bool QueryCatalog_is_changed(const QueryCatalog* catalog, EntityId entity, ComponentTypeId typeId) {
+    CatalogTracker* tracker = find_tracker(catalog, typeId);
+    if (!tracker) return false;
+    
+    uint32_t index = EntityIndexMap_find(tracker->map, entity);
+    return index != ENTITY_INDEX_INVALID && EntityBitset_test(&tracker->dirty, index);
+}
+
+// Grow a uint32_t or EntityId array to hold at least needed elements
+static bool grow_array(void** array, size_t* capacity, size_t needed, size_t elementSize) {
+    if (needed <= *capacity) return true;
+    
+    size_t newCapacity = *capacity ? *capacity * 2 : 64;
+    while (newCapacity < needed) {
+        newCapacity *= 2;
+    }
+    void* grown = QUERY_ALLOC(elementSize * newCapacity);
+    if (!grown) return false;
+    if (*array) {
+        memcpy(grown, *array, elementSize * *capacity);
+        QUERY_FREE(*array);
+    }
+    *array = grown;
+    *capacity = newCapacity;
+    return true;
+}
+
+// False if the write could not be recorded
+static bool mark_changed(CatalogTracker* tracker, EntityId entity) {
+    uint32_t index = EntityIndexMap_get_or_add(tracker->map, entity);
+    if (index == ENTITY_INDEX_INVALID) return false;
+    if (EntityBitset_test(&tracker->dirty, index)) return true;
+    
+    if (!grow_array((void**)&tracker->changed, &tracker->changedCapacity, tracker->changedCount + 1,
+                    sizeof(EntityId)) ||
+        !grow_array((void**)&tracker->positionOf, &tracker->positionCapacity, (size_t)index + 1,
+                    sizeof(uint32_t)) ||
+        !EntityBitset_set(&tracker->dirty, index)) {
+        return false;
+    }
+    tracker->positionOf[index] = (uint32_t)tracker->changedCount;
+    tracker->changed[tracker->changedCount++] = entity;
+    return true;
+}
+
+// Drop a destroyed entity's change, moving the last change into its place
+static void forget_change(CatalogTracker* tracker, EntityId entity) {
+    uint32_t index = EntityIndexMap_find(tracker->map, entity);
+    if (index == ENTITY_INDEX_INVALID || !EntityBitset_test(&tracker->dirty, index)) return;
+    
+    EntityBitset_unset(&tracker->dirty, index);
+    uint32_t position = tracker->positionOf[index];
+    tracker->changedCount--;
+    if (position != tracker->changedCount) {
+        EntityId moved = tracker->changed[tracker->changedCount];
+        tracker->changed[position] = moved;
+        tracker->positionOf[EntityIndexMap_find(tracker->map, moved)] = position;
+    }
+}
+
+bool QueryCatalog_notify_write(QueryCatalog* catalog, EntityId entity, ComponentTypeId typeId) {
+    if (!catalog) return false;
+    
+    void* data = NULL;
+    bool fetched = false;
+    bool recorded = true;
+    for (size_t i = 0; i < catalog->fieldCount; i++) {
+        CatalogField* entry = &catalog->fields[i];
+        if ((!entry->index && !entry->hash) || entry->field.typeId != typeId) continue;
+        
+        // One component lookup serves every indexed field of the type
+        if (!fetched) {
+            data = ECS_get_component(catalog->ecs, entity, typeId);
+            fetched = true;
+        }
+        if (data) {
+            if (entry->index && !FieldIndex_set(entry->index, entity, QueryField_read(&entry->field, data))) {
+                recorded = false;
+            }
+            if (entry->hash && !HashIndex_set(entry->hash, entity, QueryField_read_key(&entry->field, data))) {
+                recorded = false;
+            }
+        } else {
+            if (entry->index) FieldIndex_remove(entry->index, entity);
+            if (entry->hash) HashIndex_remove(entry->hash, entity);
+        }
+    }
+    
+    // A change list missing a write would make CHANGED silently incomplete
+    CatalogTracker* tracker = find_tracker(catalog, typeId);
+    if (tracker && !tracker->lost && !mark_changed(tracker, entity)) {
+        tracker->lost = true;
+    }
+    if (tracker && tracker->lost) {
+        recorded = false;
+    }
+    
+    CatalogSpatial* spatial = find_spatial(catalog, typeId);
+    if (spatial) {
+        if (!fetched) {
+            data = ECS_get_component(catalog->ecs, entity, typeId);
+        }
+        if (data) {
+            if (!SpatialIndex_set(spatial->index, entity,
+                                  QueryField_read(&spatial->x, data),
+                                  QueryField_read(&spatial->y, data))) {
+                recorded = false;
+            }
+        } else {
+            SpatialIndex_remove(spatial->index, entity);
+        }
+    }
+    return recorded;
+}
+
+void QueryCatalog_notify_remove(QueryCatalog* catalog, EntityId entity, ComponentTypeId typeId) {
+    if (!catalog) return;
+    
+    for (size_t i = 0; i < catalog->fieldCount; i++) {
+        CatalogField* entry = &catalog->fields[i];
+        if (entry->field.typeId != typeId) continue;
+        if (entry->index) FieldIndex_remove(entry->index, entity);
+        if (entry->hash) HashIndex_remove(entry->hash, entity);
+    }
+    
+    CatalogSpatial* spatial = find_spatial(catalog, typeId);
+    if (spatial) {
+        SpatialIndex_remove(spatial->index, entity);
+    }
+}
+
+void QueryCatalog_notify_destroy(QueryCatalog* catalog, EntityId entity) {
+    if (!catalog) return;
+    
+    for (size_t i = 0; i < catalog->fieldCount; i++) {
+        if (catalog->fields[i].index) FieldIndex_remove(catalog->fields[i].index, entity);
+        if (catalog->fields[i].hash) HashIndex_remove(catalog->fields[i].hash, entity);
+    }
+    for (size_t i = 0; i < catalog->spatialCount; i++) {
+        SpatialIndex_remove(catalog->spatial[i].index, entity);
+    }
+    for (size_t i = 0; i < catalog->trackerCount; i++) {
+        forget_change(&catalog->trackers[i], entity);
+    }
+}
+
+static QueryStatus execute_query(QueryCatalog* catalog, const char* queryString, QueryEngineResult* outResult) {
+    QueryParser* parser = QueryParser_new(queryString);
+    if (!parser) {
+        return QUERY_ERROR_PARSE;
+    }
+    
+    QueryAST* ast = QueryParser_parse(parser);
+    if (!ast) {
+        QueryParser_destroy(parser);
+        return QUERY_ERROR_PARSE;
+    }
+    
+    QueryStatus status;
+    if (QueryAST_get_type(ast) == AST_CREATE_INDEX) {
+        IndexQueryData* indexData = (IndexQueryData*)QueryAST_get_data(ast);
+        if (indexData->hash) {
+            status = QueryCatalog_create_hash_index(catalog, indexData->componentName, indexData->fieldName);
+        } else {
+            status = QueryCatalog_create_index(catalog, indexData->componentName, indexData->fieldName);
+        }
+    } else {
+        status = QueryExecutor_execute_catalog(catalog->ecs, catalog, ast, NULL, 0, outResult);
+    }
+    
+    QueryAST_destroy(ast);
+    QueryParser_destroy(parser);
+    
+    return status;
+}
+
+QueryStatus QueryCatalog_execute(QueryCatalog* catalog, const char* queryString, QueryEngineResult* outResult) {
+    if (!catalog || !queryString || !outResult) {
+        return QUERY_ERROR_INVALID_SYNTAX;
+    }
+    
+    // Initialize result
+    QueryEngineResult_init(outResult);
+    
+    QueryProfile profile;
+    bool profiling = QueryProfile_enter(&profile, false);
+    QueryStatus status = execute_query(catalog, queryString, outResult);
+    if (profiling) {
+        QueryProfile_leave(&profile, &outResult->stats);
+    }
+    return status;
+}
@@ -0,0 +1,352 @@
+#include "gramarye_query/engine.h"
+#include "gramarye_query/catalog.h"
+#include "gramarye_query/plan.h"
+#include "gramarye_query/symbols.h"
+#include "gramarye_query/query.h"
+#include "gramarye_ecs/ecs.h"
+#include "gramarye_query/allocator.h"
+#include "gramarye_query/profile.h"
+#include "internal.h"
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// A compiled query string
+typedef struct {
+    uint64_t hash;
+    char* queryString;
+    uint64_t fingerprint;       // Query_fingerprint of queryString
+    QueryPlan* plan;
+    uint64_t lastUsed;          // Engine tick of the last execution
+} PlanEntry;
+
+struct QueryEngine {
+    ECS* ecs;
+    QueryCatalog* catalog;
+    QuerySymbolTable* symbols;  // Component names, resolved while lexing plans
+    QueryEngineConfig config;
+    PlanEntry* plans;
+    size_t planCount;
+    uint64_t tick;
+    QueryEngineStats stats;
+    QueryShapeTable* shapes;    // NULL when shape statistics are off
+};
+
+QueryEngineConfig QueryEngineConfig_default(void) {
+    QueryEngineConfig config;
+    config.planCacheEntries = QUERY_ENGINE_DEFAULT_PLAN_ENTRIES;
+    config.allocator = NULL;
+    config.tracer = NULL;
+    config.shapeEntries = QUERY_ENGINE_DEFAULT_SHAPE_ENTRIES;
+    config.queryMemoryBudget = 0;
+    return config;
+}
+
+static QueryEngine* create_engine(ECS* ecs, const QueryEngineConfig* config) {
+    QueryEngine* engine = (QueryEngine*)QUERY_ALLOC(sizeof(QueryEngine));
+    if (!engine) return NULL;
+    
+    memset(engine, 0, sizeof(QueryEngine));
+    engine->ecs = ecs;
+    engine->config = *config;
+    engine->catalog = QueryCatalog_new(ecs);
+    engine->symbols = QuerySymbolTable_new(ecs);
+    if (!engine->catalog || !engine->symbols) {
+        QueryCatalog_destroy(engine->catalog);
+        QuerySymbolTable_destroy(engine->symbols);
+        QUERY_FREE(engine);
+        return NULL;
+    }
+    
+    if (engine->config.planCacheEntries > 0) {
+        engine->plans = (PlanEntry*)QUERY_ALLOC(sizeof(PlanEntry) * engine->config.planCacheEntries);
+    }
+    if (engine->config.shapeEntries > 0) {
+        engine->shapes = QueryShapeTable_new(engine->config.shapeEntries);
+    }
+    if ((engine->config.planCacheEntries > 0 && !engine->plans) || (engine->config.shapeEntries > 0 && !engine->shapes)) {
+        if (engine->plans) {
+            QUERY_FREE(engine->plans);
+        }
+        QueryShapeTable_destroy(engine->shapes);
+        QueryCatalog_destroy(engine->catalog);
+        QuerySymbolTable_destroy(engine->symbols);
+        QUERY_FREE(engine);
+        return NULL;
+    }
+    return engine;
+}
+
+QueryEngine* QueryEngine_new(ECS* ecs, const QueryEngineConfig* config) {
+    if (!ecs) return NULL;
+    
+    QueryEngineConfig settings = config ? *config : QueryEngineConfig_default();
+    QueryMemoryScope scope;
+    QueryMemory_enter(&scope, settings.allocator);
+    QueryEngine* engine = create_engine(ecs, &settings);
+    QueryMemory_leave(&scope);
+    return engine;
+}
+
+static void drop_plan(PlanEntry* entry) {
+    QueryPlan_destroy(entry->plan);
+    QUERY_FREE(entry->queryString);
+}
+
+static void drop_plans(QueryEngine* engine) {
+    for (size_t i = 0; i < engine->planCount; i++) {
+        drop_plan(&engine->plans[i]);
+    }
+    engine->planCount = 0;
+}
+
+void QueryEngine_schema_changed(QueryEngine* engine) {
+    if (!engine) return;
+    
+    QueryMemoryScope scope;
+    QueryMemory_enter(&scope, engine->config.allocator);
+    QuerySymbolTable_refresh(engine->symbols);
+    drop_plans(engine);
+    QueryMemory_leave(&scope);
+}
+
+void QueryEngine_destroy(QueryEngine* engine) {
+    if (!engine) return;
+    
+    QueryMemoryScope scope;
+    QueryMemory_enter(&scope, engine->config.allocator);
+    drop_plans(engine);
+    if (engine->plans) {
+        QUERY_FREE(engine->plans);
+    }
+    QueryShapeTable_destroy(engine->shapes);
+    QuerySymbolTable_destroy(engine->symbols);
+    QueryCatalog_destroy(engine->catalog);
+    QUERY_FREE(engine);
+    QueryMemory_leave(&scope);
+}
+
+static uint64_t hash_string(const char* text) {
+    return query_fnv1a(QUERY_FNV_OFFSET, text, strlen(text));
+}
+
+static PlanEntry* find_plan(QueryEngine* engine, uint64_t hash, const char* queryString) {
+    for (size_t i = 0; i < engine->planCount; i++) {
+        PlanEntry* entry = &engine->plans[i];
+        if (entry->hash == hash && strcmp(entry->queryString, queryString) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// Take ownership of plan; evicts the least recently used plan when full.
+// Returns NULL (plan not kept) on allocation failure.
+static PlanEntry* insert_plan(QueryEngine* engine, uint64_t hash, const char* queryString, uint64_t fingerprint,
+                              QueryPlan* plan) {
+    size_t length = strlen(queryString);
+    char* copy = (char*)QUERY_ALLOC(length + 1);
+    if (!copy) return NULL;
+    memcpy(copy, queryString, length + 1);
+    
+    PlanEntry* entry;
+    if (engine->planCount < engine->config.planCacheEntries) {
+        entry = &engine->plans[engine->planCount++];
+    } else {
+        entry = &engine->plans[0];
+        for (size_t i = 1; i < engine->planCount; i++) {
+            if (engine->plans[i].lastUsed < entry->lastUsed) {
+                entry = &engine->plans[i];
+            }
+        }
+        drop_plan(entry);
+        engine->stats.planEvictions++;
+    }
+    
+    entry->hash = hash;
+    entry->queryString = copy;
+    entry->fingerprint = fingerprint;
+    entry->plan = plan;
+    return entry;
+}
+
+// Serve from the plan cache (entry, if the lookup found one), compiling on a
+// miss. Returns false if the query is not plannable (parse error, CREATE
+// INDEX, placeholders) or the cache is off.
+static bool execute_planned(QueryEngine* engine, const char* queryString, uint64_t hash, PlanEntry* entry,
+                            uint64_t fingerprint, QueryEngineResult* outResult, QueryStatus* outStatus) {
+    if (engine->config.planCacheEntries == 0) return false;
+    
+    if (entry) {
+        engine->stats.planHits++;
+    } else {
+        QueryPlan* plan = QueryPlan_prepare_with_symbols(engine->ecs, engine->catalog, engine->symbols, queryString);
+        if (!plan) return false;
+        if (QueryPlan_param_count(plan) > 0) {
+            // Nothing can bind the placeholders; let the executor report it
+            QueryPlan_destroy(plan);
+            return false;
+        }
+        
+        engine->stats.planMisses++;
+        entry = insert_plan(engine, hash, queryString, fingerprint, plan);
+        if (!entry) {
+            *outStatus = QueryPlan_execute(plan, outResult);
+            QueryPlan_destroy(plan);
+            return true;
+        }
+    }
+    
+    entry->lastUsed = ++engine->tick;
+    *outStatus = QueryPlan_execute(entry->plan, outResult);
+    return true;
+}
+
+static QueryStatus run_query(QueryEngine* engine, const char* queryString, QueryEngineResult* outResult,
+                             bool analyze) {
+    if (!engine || !queryString || !outResult) {
+        return QUERY_ERROR_INVALID_SYNTAX;
+    }
+    
+    uint64_t start = query_now_ns();
+    QueryMemoryScope scope;
+    QueryMemory_enter(&scope, engine->config.allocator);
+    scope.budget = engine->config.queryMemoryBudget;
+    
+    // Plans compiled before a type was registered hold its name as unknown
+    if (QuerySymbolTable_refresh(engine->symbols) > 0) {
+        drop_plans(engine);
+    }
+    
+    // Cached plans keep their fingerprint, so repeated strings are not lexed for it
+    uint64_t hash = 0;
+    PlanEntry* entry = NULL;
+    if (engine->config.planCacheEntries > 0) {
+        hash = hash_string(queryString);
+        entry = find_plan(engine, hash, queryString);
+    }
+    uint64_t fingerprint = 0;
+    if (entry) {
+        fingerprint = entry->fingerprint;
+    } else if (engine->shapes || engine->config.tracer || engine->config.planCacheEntries > 0) {
+        fingerprint = Query_fingerprint(queryString);
+    }
+    
+    bool tracing = engine->config.tracer && QueryTrace_begin(engine->config.tracer, fingerprint);
+    QueryProfile profile;
+    bool profiling = QueryProfile_enter(&profile, analyze);
+    QueryStatus status;
+    if (!execute_planned(engine, queryString, hash, entry, fingerprint, outResult, &status)) {
+        status = QueryCatalog_execute(engine->catalog, queryString, outResult);
+    }
+    if (scope.stats.refused > 0) {
+        // Over budget: a parse or prepare that ran out reports the budget, and
+        // whatever came back may be missing what was refused
+        if (status == QUERY_SUCCESS) {
+            QueryEngineResult_free(outResult);
+        }
+        status = QUERY_ERROR_EXECUTION;
+    }
+    if (profiling) {
+        // A failed query leaves no result to carry the operators
+        QueryProfile_leave(&profile, &outResult->stats);
+        if (status != QUERY_SUCCESS) {
+            QueryStats_free(&outResult->stats);
+        }
+    }
+    if (tracing) {
+        QueryTrace_end(status, status == QUERY_SUCCESS ? outResult->count : 0);
+    }
+    QueryMemory_leave(&scope);
+    uint64_t elapsedNs = query_now_ns() - start;
+    double elapsedMs = (double)elapsedNs / 1e6;
+    outResult->memory = scope.stats;
+    
+    if (engine->shapes) {
+        // New shapes allocate outside the query's scope, so they are not charged to it
+        QueryMemoryScope shapeScope;
+        QueryMemory_enter(&shapeScope, engine->config.allocator);
+        QueryShapeTable_record(engine->shapes, fingerprint, queryString, elapsedNs, status == QUERY_SUCCESS,
+                               status == QUERY_SUCCESS ? outResult->count : 0);
+        QueryMemory_leave(&shapeScope);
+    }
+    
+    engine->stats.queries++;
+    if (status != QUERY_SUCCESS) {
+        engine->stats.failures++;
+    }
+    engine->stats.totalMs += elapsedMs;
+    if (elapsedMs > engine->stats.maxMs) {
+        engine->stats.maxMs = elapsedMs;
+    }
+    engine->stats.bytesAllocated += scope.stats.bytesAllocated;
+    if (scope.stats.peakBytes > engine->stats.peakBytes) {
+        engine->stats.peakBytes = scope.stats.peakBytes;
+    }
+    return status;
+}
+
+QueryStatus QueryEngine_execute(QueryEngine* engine, const char* queryString, QueryEngineResult* outResult) {
+    return run_query(engine, queryString, outResult, false);
+}
+
+QueryStatus QueryEngine_analyze(QueryEngine* engine, const char* queryString, QueryEngineResult* outResult) {
+    return run_query(engine, queryString, outResult, true);
+}
+
+QueryStatus QueryEngine_explain(QueryEngine* engine, const char* queryString, QueryExplain* outExplain) {
+    if (!engine) {
+        return Query_explain(NULL, NULL, queryString, outExplain);
+    }
+    
+    QueryMemoryScope scope;
+    QueryMemory_enter(&scope, engine->config.allocator);
+    scope.budget = engine->config.queryMemoryBudget;
+    QueryStatus status = Query_explain(engine->ecs, engine->catalog, queryString, outExplain);
+    if (scope.stats.refused > 0) {
+        if (status == QUERY_SUCCESS) {
+            QueryExplain_free(outExplain);
+        }
+        status = QUERY_ERROR_EXECUTION;
+    }
+    QueryMemory_leave(&scope);
+    return status;
+}
+
+void QueryEngine_set_tracer(QueryEngine* engine, QueryTracer* tracer) {
+    if (engine) {
+        engine->config.tracer = tracer;
+    }
+}
+
+QueryCatalog* QueryEngine_get_catalog(QueryEngine* engine) {
+    return engine ? engine->catalog : NULL;
+}
+
+ECS* QueryEngine_get_ecs(const QueryEngine* engine) {
+    return engine ? engine->ecs : NULL;
+}
+
+QueryEngineStats QueryEngine_get_stats(const QueryEngine* engine) {
+    QueryEngineStats stats;
+    memset(&stats, 0, sizeof(stats));
+    if (engine) {
+        stats = engine->stats;
+        stats.planCount = engine->planCount;
+    }
+    return stats;
+}
+
+void QueryEngine_reset_stats(QueryEngine* engine) {
+    if (!engine) return;
+    
+    memset(&engine->stats, 0, sizeof(engine->stats));
+    QueryMemoryScope scope;
+    QueryMemory_enter(&scope, engine->config.allocator);
+    QueryShapeTable_clear(engine->shapes);
+    QueryMemory_leave(&scope);
+}
+
+const QueryShapeTable* QueryEngine_get_shapes(const QueryEngine* engine) {
+    return engine ? engine->shapes : NULL;
+}
@@ -0,0 +1,374 @@
+#include "gramarye_query/entity_set.h"
+#include "gramarye_ecs/entity.h"
+#include "gramarye_query/allocator.h"
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+struct EntityIndexMap {
+    uint32_t* slots;        // Dense index + 1, 0 = empty
+    size_t slotCount;       // Power of two
+    EntityId* entities;     // Dense index -> EntityId
+    size_t count;
+    size_t capacity;
+};
+
+static uint64_t hash_entity(EntityId entity) {
+    // splitmix64 finalizer over both halves
+    uint64_t z = entity.high ^ (entity.low * 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static size_t round_up_pow2(size_t value) {
+    size_t result = 16;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+EntityIndexMap* EntityIndexMap_new(size_t initialCapacity) {
+    EntityIndexMap* map = (EntityIndexMap*)QUERY_ALLOC(sizeof(EntityIndexMap));
+    if (!map) return NULL;
+    
+    map->capacity = initialCapacity > 16 ? initialCapacity : 16;
+    map->slotCount = round_up_pow2(map->capacity * 2);
+    map->count = 0;
+    
+    map->slots = (uint32_t*)QUERY_ALLOC(sizeof(uint32_t) * map->slotCount);
+    map->entities = (EntityId*)QUERY_ALLOC(sizeof(EntityId) * map->capacity);
+    if (!map->slots || !map->entities) {
+        if (map->slots) QUERY_FREE(map->slots);
+        if (map->entities) QUERY_FREE(map->entities);
+        QUERY_FREE(map);
+        return NULL;
+    }
+    memset(map->slots, 0, sizeof(uint32_t) * map->slotCount);
+    
+    return map;
+}
+
+void EntityIndexMap_destroy(EntityIndexMap* map) {
+    if (!map) return;
+    
+    QUERY_FREE(map->slots);
+    QUERY_FREE(map->entities);
+    QUERY_FREE(map);
+}
+
+static bool rehash(EntityIndexMap* map, size_t newSlotCount) {
+    uint32_t* newSlots = (uint32_t*)QUERY_ALLOC(sizeof(uint32_t) * newSlotCount);
+    if (!newSlots) return false;
+    memset(newSlots, 0, sizeof(uint32_t) * newSlotCount);
+    
+    size_t mask = newSlotCount - 1;
+    for (size_t i = 0; i < map->count; i++) {
+        size_t slot = hash_entity(map->entities[i]) & mask;
+        while (newSlots[slot]) {
+            slot = (slot + 1) & mask;
+        }
+        newSlots[slot] = (uint32_t)(i + 1);
+    }
+    
+    QUERY_FREE(map->slots);
+    map->slots = newSlots;
+    map->slotCount = newSlotCount;
+    return true;
+}
+
+uint32_t EntityIndexMap_find(const EntityIndexMap* map, EntityId entity) {
+    if (!map) return ENTITY_INDEX_INVALID;
+    
+    size_t mask = map->slotCount - 1;
+    size_t slot = hash_entity(entity) & mask;
+    while (map->slots[slot]) {
+        uint32_t index = map->slots[slot] - 1;
+        if (map->entities[index].high == entity.high && map->entities[index].low == entity.low) {
+            return index;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return ENTITY_INDEX_INVALID;
+}
+
+uint32_t EntityIndexMap_get_or_add(EntityIndexMap* map, EntityId entity) {
+    if (!map) return ENTITY_INDEX_INVALID;
+    
+    size_t mask = map->slotCount - 1;
+    size_t slot = hash_entity(entity) & mask;
+    while (map->slots[slot]) {
+        uint32_t index = map->slots[slot] - 1;
+        if (map->entities[index].high == entity.high && map->entities[index].low == entity.low) {
+            return index;
+        }
+        slot = (slot + 1) & mask;
+    }
+    
+    if (map->count >= ENTITY_INDEX_INVALID - 1) {
+        return ENTITY_INDEX_INVALID;
+    }
+    
+    // Grow dense array
+    if (map->count >= map->capacity) {
+        size_t newCapacity = map->capacity * 2;
+        EntityId* newEntities = (EntityId*)QUERY_ALLOC(sizeof(EntityId) * newCapacity);
+        if (!newEntities) return ENTITY_INDEX_INVALID;
+        memcpy(newEntities, map->entities, sizeof(EntityId) * map->count);
+        QUERY_FREE(map->entities);
+        map->entities = newEntities;
+        map->capacity = newCapacity;
+    }
+    
+    // Keep load factor under 1/2
+    if ((map->count + 1) * 2 > map->slotCount) {
+        if (!rehash(map, map->slotCount * 2)) return ENTITY_INDEX_INVALID;
+        mask = map->slotCount - 1;
+        slot = hash_entity(entity) & mask;
+        while (map->slots[slot]) {
+            slot = (slot + 1) & mask;
+        }
+    }
+    
+    uint32_t index = (uint32_t)map->count;
+    map->entities[index] = entity;
+    map->slots[slot] = index + 1;
+    map->count++;
+    
+    return index;
+}
+
+void EntityIndexMap_clear(EntityIndexMap* map) {
+    if (!map || map->count == 0) return;
+    
+    memset(map->slots, 0, sizeof(uint32_t) * map->slotCount);
+    map->count = 0;
+}
+
+EntityId EntityIndexMap_entity_at(const EntityIndexMap* map, uint32_t index) {
+    return map->entities[index];
+}
+
+size_t EntityIndexMap_count(const EntityIndexMap* map) {
+    return map ? map->count : 0;
+}
+
+size_t EntityIndexMap_memory_bytes(const EntityIndexMap* map) {
+    if (!map) return 0;
+    return sizeof(EntityIndexMap) + sizeof(uint32_t) * map->slotCount + sizeof(EntityId) * map->capacity;
+}
+
+static size_t popcount64(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return (size_t)__builtin_popcountll(value);
+#else
+    value = value - ((value >> 1) & 0x5555555555555555ULL);
+    value = (value & 0x3333333333333333ULL) + ((value >> 2) & 0x3333333333333333ULL);
+    value = (value + (value >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (size_t)((value * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+static unsigned lowest_bit(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return (unsigned)__builtin_ctzll(value);
+#else
+    unsigned bit = 0;
+    while (!(value & 1)) {
+        value >>= 1;
+        bit++;
+    }
+    return bit;
+#endif
+}
+
+bool EntityBitset_init(EntityBitset* set, size_t bitCapacity) {
+    if (!set) return false;
+    
+    set->wordCount = (bitCapacity + 63) / 64;
+    set->words = NULL;
+    if (set->wordCount == 0) return true;
+    
+    set->words = (uint64_t*)QUERY_ALLOC(sizeof(uint64_t) * set->wordCount);
+    if (!set->words) {
+        set->wordCount = 0;
+        return false;
+    }
+    memset(set->words, 0, sizeof(uint64_t) * set->wordCount);
+    return true;
+}
+
+void EntityBitset_free(EntityBitset* set) {
+    if (!set) return;
+    
+    if (set->words) {
+        QUERY_FREE(set->words);
+    }
+    set->wordCount = 0;
+}
+
+bool EntityBitset_copy(EntityBitset* dst, const EntityBitset* src) {
+    if (!EntityBitset_init(dst, src->wordCount * 64)) return false;
+    if (src->wordCount > 0) {
+        memcpy(dst->words, src->words, sizeof(uint64_t) * src->wordCount);
+    }
+    return true;
+}
+
+static bool grow_words(EntityBitset* set, size_t wordCount) {
+    if (wordCount <= set->wordCount) return true;
+    
+    // Grow geometrically so repeated sets stay amortized O(1)
+    size_t newCount = set->wordCount ? set->wordCount * 2 : 4;
+    while (newCount < wordCount) {
+        newCount *= 2;
+    }
+    
+    uint64_t* newWords = (uint64_t*)QUERY_ALLOC(sizeof(uint64_t) * newCount);
+    if (!newWords) return false;
+    if (set->wordCount > 0) {
+        memcpy(newWords, set->words, sizeof(uint64_t) * set->wordCount);
+        QUERY_FREE(set->words);
+    }
+    memset(newWords + set->wordCount, 0, sizeof(uint64_t) * (newCount - set->wordCount));
+    set->words = newWords;
+    set->wordCount = newCount;
+    return true;
+}
+
+bool EntityBitset_set(EntityBitset* set, uint32_t index) {
+    size_t word = index / 64;
+    if (!grow_words(set, word + 1)) return false;
+    set->words[word] |= 1ULL << (index % 64);
+    return true;
+}
+
+bool EntityBitset_test(const EntityBitset* set, uint32_t index) {
+    size_t word = index / 64;
+    if (word >= set->wordCount) return false;
+    return (set->words[word] >> (index % 64)) & 1;
+}
+
+void EntityBitset_unset(EntityBitset* set, uint32_t index) {
+    size_t word = index / 64;
+    if (word < set->wordCount) {
+        set->words[word] &= ~(1ULL << (index % 64));
+    }
+}
+
+void EntityBitset_and(EntityBitset* dst, const EntityBitset* src) {
+    size_t common = dst->wordCount < src->wordCount ? dst->wordCount : src->wordCount;
+    for (size_t i = 0; i < common; i++) {
+        dst->words[i] &= src->words[i];
+    }
+    for (size_t i = common; i < dst->wordCount; i++) {
+        dst->words[i] = 0;
+    }
+}
+
+bool EntityBitset_or(EntityBitset* dst, const EntityBitset* src) {
+    if (!grow_words(dst, src->wordCount)) return false;
+    for (size_t i = 0; i < src->wordCount; i++) {
+        dst->words[i] |= src->words[i];
+    }
+    return true;
+}
+
+void EntityBitset_andnot(EntityBitset* dst, const EntityBitset* src) {
+    size_t common = dst->wordCount < src->wordCount ? dst->wordCount : src->wordCount;
+    for (size_t i = 0; i < common; i++) {
+        dst->words[i] &= ~src->words[i];
+    }
+}
+
+size_t EntityBitset_count(const EntityBitset* set) {
+    size_t count = 0;
+    for (size_t i = 0; i < set->wordCount; i++) {
+        count += popcount64(set->words[i]);
+    }
+    return count;
+}
+
+size_t EntityBitset_materialize(const EntityBitset* set, const EntityIndexMap* map, EntityId* outEntities, size_t maxCount) {
+    size_t count = 0;
+    for (size_t i = 0; i < set->wordCount && count < maxCount; i++) {
+        uint64_t word = set->words[i];
+        while (word && count < maxCount) {
+            uint32_t index = (uint32_t)(i * 64 + lowest_bit(word));
+            outEntities[count++] = EntityIndexMap_entity_at(map, index);
+            word &= word - 1;
+        }
+    }
+    return count;
+}
+
+#define RADIX_MIN_COUNT 64
+
+static bool entity_less(EntityId a, EntityId b) {
+    return a.high < b.high || (a.high == b.high && a.low < b.low);
+}
+
+static uint8_t key_byte(EntityId entity, unsigned pass) {
+    // Pass 0 is the least significant byte of low, pass 15 the most significant of high
+    uint64_t half = pass < 8 ? entity.low : entity.high;
+    return (uint8_t)(half >> ((pass & 7) * 8));
+}
+
+bool EntityId_sort(EntityId* entities, size_t count) {
+    if (!entities || count < 2) return true;
+    
+    if (count < RADIX_MIN_COUNT) {
+        for (size_t i = 1; i < count; i++) {
+            EntityId value = entities[i];
+            size_t j = i;
+            while (j > 0 && entity_less(value, entities[j - 1])) {
+                entities[j] = entities[j - 1];
+                j--;
+            }
+            entities[j] = value;
+        }
+        return true;
+    }
+    
+    EntityId* scratch = (EntityId*)QUERY_ALLOC(sizeof(EntityId) * count);
+    if (!scratch) return false;
+    
+    // Every histogram in one read of the input
+    size_t counts[16][256];
+    memset(counts, 0, sizeof(counts));
+    for (size_t i = 0; i < count; i++) {
+        for (unsigned pass = 0; pass < 16; pass++) {
+            counts[pass][key_byte(entities[i], pass)]++;
+        }
+    }
+    
+    EntityId* src = entities;
+    EntityId* dst = scratch;
+    for (unsigned pass = 0; pass < 16; pass++) {
+        size_t* bucket = counts[pass];
+        
+        // A byte shared by every id leaves the order unchanged
+        if (bucket[key_byte(src[0], pass)] == count) continue;
+        
+        size_t offset = 0;
+        for (unsigned digit = 0; digit < 256; digit++) {
+            size_t n = bucket[digit];
+            bucket[digit] = offset;
+            offset += n;
+        }
+        for (size_t i = 0; i < count; i++) {
+            dst[bucket[key_byte(src[i], pass)]++] = src[i];
+        }
+        
+        EntityId* swap = src;
+        src = dst;
+        dst = swap;
+    }
+    
+    if (src != entities) {
+        memcpy(entities, src, sizeof(EntityId) * count);
+    }
+    QUERY_FREE(scratch);
+    return true;
+}
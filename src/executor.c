@@ -5,7 +5,10 @@
 #include "gramarye_ecs/query.h"  // Include ECS query.h for ECS QueryResult
 #include "gramarye_ecs/entity.h"
 #include "gramarye_ecs/component.h"
-#include "mem.h"
+#include "gramarye_query/allocator.h"
+#include "gramarye_query/profile.h"
+#include "internal.h"
+#include <stdio.h>
 #include <string.h>
 #include <stdint.h>
 
@@ -13,16 +16,293 @@
 // - ECS QueryResult (from gramarye_ecs/query.h) - used for ECS query functions
 // - QueryResult (from gramarye_query/query.h) - query engine's extended version with data field
 
+size_t QueryExecutor_resolve_components(ECS* ecs, const ComponentList* componentList, ComponentTypeId* outTypeIds) {
+    if (!ecs || !componentList || !outTypeIds) {
+        return 0;
+    }
+    
+    // Unknown names are dropped, matching the executor's "empty result" semantics.
+    // Names the parser resolved through a symbol table are not looked up again.
+    QUERY_PHASE_BEGIN(outer, QUERY_PHASE_RESOLVE);
+    size_t validCount = 0;
+    for (size_t i = 0; i < componentList->count; i++) {
+        ComponentTypeId typeId = componentList->typeIds ? componentList->typeIds[i] :
+                                 query_type_by_name(ecs, componentList->componentNames[i]);
+        if (typeId != COMPONENT_TYPE_INVALID) {
+            outTypeIds[validCount++] = typeId;
+        }
+    }
+    QUERY_PHASE_END(outer);
+    
+    return validCount;
+}
+
+size_t QueryExecutor_canonical_components(ECS* ecs, const ComponentList* componentList, ComponentTypeId* outTypeIds) {
+    size_t count = QueryExecutor_resolve_components(ecs, componentList, outTypeIds);
+    
+    // Insertion sort - component lists are short
+    for (size_t i = 1; i < count; i++) {
+        ComponentTypeId key = outTypeIds[i];
+        size_t j = i;
+        while (j > 0 && outTypeIds[j - 1] > key) {
+            outTypeIds[j] = outTypeIds[j - 1];
+            j--;
+        }
+        outTypeIds[j] = key;
+    }
+    
+    // Drop duplicates
+    size_t unique = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (unique == 0 || outTypeIds[i] != outTypeIds[unique - 1]) {
+            outTypeIds[unique++] = outTypeIds[i];
+        }
+    }
+    
+    return unique;
+}
+
+size_t QueryExecutor_describe_components(ECS* ecs, ASTNodeType predicateType, const ComponentTypeId* typeIds,
+                                         size_t typeCount, char* buffer, size_t size) {
+    if (!buffer || size == 0) return 0;
+    
+    const char* name = predicateType == AST_HAS_ANY ? "has_any" :
+                       predicateType == AST_NOT_HAS ? "not_has" :
+                       predicateType == AST_CHANGED ? "changed" : "has";
+    size_t length = (size_t)snprintf(buffer, size, "%s(", name);
+    for (size_t i = 0; i < typeCount && length < size; i++) {
+        ComponentType* type = ECS_get_component_type(ecs, typeIds[i]);
+        length += (size_t)snprintf(buffer + length, size - length, "%s%s", i > 0 ? ", " : "",
+                                   type && type->name ? type->name : "?");
+    }
+    if (length < size) {
+        length += (size_t)snprintf(buffer + length, size - length, ")");
+    }
+    return length < size ? length : size - 1;
+}
+
+QueryStatus QueryExecutor_get_limit(QueryAST* ast, uint64_t* outLimit) {
+    if (!ast || !outLimit) {
+        return QUERY_ERROR_EXECUTION;
+    }
+    
+    *outLimit = QUERY_LIMIT_NONE;
+    if (QueryAST_get_type(ast) != AST_SELECT) {
+        return QUERY_SUCCESS;
+    }
+    
+    SelectQueryData* selectData = (SelectQueryData*)QueryAST_get_data(ast);
+    if (!selectData) {
+        return QUERY_SUCCESS;
+    }
+    if (selectData->limitParam != 0) {
+        return QUERY_ERROR_INVALID_SYNTAX; // Unbound placeholder - use a prepared plan
+    }
+    
+    *outLimit = selectData->limit;
+    return QUERY_SUCCESS;
+}
+
+SampleMode QueryExecutor_get_sampling(QueryAST* ast, uint64_t* outSize) {
+    if (outSize) *outSize = 0;
+    ASTNodeType queryType = QueryAST_get_type(ast);
+    if (!ast || (queryType != AST_SELECT && queryType != AST_COUNT)) {
+        return SAMPLE_NONE;
+    }
+    
+    SelectQueryData* selectData = (SelectQueryData*)QueryAST_get_data(ast);
+    if (!selectData || selectData->sampleMode == SAMPLE_NONE) {
+        return SAMPLE_NONE;
+    }
+    
+    if (outSize) {
+        *outSize = selectData->sampleSize;
+        if (selectData->sampleMode == SAMPLE_APPROX && *outSize == 0) {
+            *outSize = QUERY_APPROX_DEFAULT_SAMPLES;
+        }
+    }
+    return selectData->sampleMode;
+}
+
+QueryStatus QueryExecutor_execute_entities(ECS* ecs,
+                                           ASTNodeType queryType,
+                                           ASTNodeType predicateType,
+                                           const ComponentTypeId* typeIds,
+                                           size_t typeCount,
+                                           uint64_t limit,
+                                           QueryEngineResult* outResult) {
+    if (!ecs || !outResult) {
+        return QUERY_ERROR_EXECUTION;
+    }
+    
+    if (typeCount == 0) {
+        return QUERY_SUCCESS; // No valid components, return empty result
+    }
+    if (predicateType != AST_HAS && predicateType != AST_HAS_ANY && predicateType != AST_NOT_HAS) {
+        return QUERY_ERROR_EXECUTION;
+    }
+    
+    // EXPLAIN ANALYZE: the query over one component scan
+    size_t rootOp = SIZE_MAX;
+    size_t scanOp = SIZE_MAX;
+    if (QUERY_PROFILE_ANALYZING()) {
+        char label[QUERY_OPERATOR_LABEL];
+        if (queryType == AST_SELECT && limit != QUERY_LIMIT_NONE) {
+            snprintf(label, sizeof(label), "Select LIMIT %llu", (unsigned long long)limit);
+        } else {
+            snprintf(label, sizeof(label), queryType == AST_COUNT ? "Count" : "Select");
+        }
+        rootOp = QueryProfile_begin_operator(label);
+        size_t length = (size_t)snprintf(label, sizeof(label), "Scan ");
+        QueryExecutor_describe_components(ecs, predicateType, typeIds, typeCount, label + length, sizeof(label) - length);
+        scanOp = QueryProfile_begin_operator(label);
+    }
+    
+    // Query entities based on predicate type (ECS takes a mutable array)
+    QUERY_PHASE_BEGIN(outer, QUERY_PHASE_SCAN);
+    struct QueryResult ecsResult;
+    if (predicateType == AST_HAS) {
+        ecsResult = ECS_query_entities(ecs, (ComponentTypeId*)typeIds, typeCount);
+    } else if (predicateType == AST_HAS_ANY) {
+        ecsResult = ECS_query_entities_any(ecs, (ComponentTypeId*)typeIds, typeCount);
+    } else {
+        ecsResult = ECS_query_entities_excluding(ecs, (ComponentTypeId*)typeIds, typeCount);
+    }
+    QUERY_PHASE_END(outer);
+    size_t scanned = ecsResult.count;
+    QueryProfile_end_operator(scanOp, scanned, scanned);
+    
+    if (queryType == AST_COUNT) {
+        // For COUNT, just store the count
+        outResult->count = ecsResult.count;
+        outResult->entities = NULL;
+        outResult->capacity = 0;
+        outResult->data = NULL;
+        // Use ECS QueryResult_free for ECS QueryResult
+        QueryResult_free(&ecsResult);  // This is ECS QueryResult_free from gramarye_ecs/query.h
+    } else {
+        // For SELECT, copy entities (up to LIMIT)
+        size_t count = ecsResult.count;
+        if (limit < (uint64_t)count) {
+            count = (size_t)limit;
+        }
+        if (count > 0) {
+            QUERY_PHASE_BEGIN(outer, QUERY_PHASE_MATERIALIZE);
+            outResult->entities = (QueryEntityId*)QUERY_ALLOC(sizeof(EntityId) * count);
+            if (outResult->entities) {
+                memcpy(outResult->entities, ecsResult.entities, sizeof(EntityId) * count);
+                outResult->count = count;
+                outResult->capacity = count;
+                outResult->data = NULL;
+            }
+            QUERY_PHASE_END(outer);
+        }
+        // Use ECS QueryResult_free for ECS QueryResult (from gramarye_ecs/query.h)
+        QueryResult_free(&ecsResult);
+    }
+    
+    QueryProfile_end_operator(rootOp, scanned, outResult->count);
+    return QUERY_SUCCESS;
+}
+
+static QueryStatus show_entity(ECS* ecs, EntityId entity, bool showAll, ComponentTypeId typeId,
+                               QueryEngineResult* outResult) {
+    // Check if entity exists
+    if (!Entity_exists(ECS_get_entity_registry(ecs), entity)) {
+        return QUERY_ERROR_EXECUTION;
+    }
+    
+    if (showAll) {
+        // SHOW ALL - get all components for entity
+        const size_t MAX_COMPONENTS = 64;
+        ComponentTypeId componentTypes[MAX_COMPONENTS];
+        size_t componentCount = 0;
+        
+        ECS_get_entity_components(ecs, entity, componentTypes, &componentCount, MAX_COMPONENTS);
+        
+        // Store component info in result data
+        // For now, just store the count in result->count
+        // In a full implementation, we'd store component data
+        outResult->count = componentCount;
+        outResult->entities = NULL;
+        outResult->capacity = 0;
+        // TODO: Store component data in outResult->data
+    } else {
+        // SHOW single component
+        if (typeId == COMPONENT_TYPE_INVALID) {
+            return QUERY_ERROR_EXECUTION;
+        }
+        
+        void* componentData = ECS_get_component(ecs, entity, typeId);
+        if (!componentData) {
+            return QUERY_ERROR_EXECUTION;
+        }
+        
+        ComponentType* type = ECS_get_component_type(ecs, typeId);
+        if (!type) {
+            return QUERY_ERROR_EXECUTION;
+        }
+        
+        // Copy component data (ECS data is internal and shouldn't be freed by query engine)
+        QUERY_PHASE_BEGIN(outer, QUERY_PHASE_MATERIALIZE);
+        outResult->data = QUERY_ALLOC(type->size);
+        if (outResult->data) {
+            memcpy(outResult->data, componentData, type->size);
+        }
+        QUERY_PHASE_END(outer);
+        if (!outResult->data) {
+            return QUERY_ERROR_EXECUTION;
+        }
+        
+        // Store component data
+        outResult->count = 1; // One component
+        outResult->entities = NULL;
+        outResult->capacity = 0;
+    }
+    
+    return QUERY_SUCCESS;
+}
+
+QueryStatus QueryExecutor_show(ECS* ecs,
+                               EntityId entity,
+                               bool showAll,
+                               ComponentTypeId typeId,
+                               QueryEngineResult* outResult) {
+    if (!ecs || !outResult) {
+        return QUERY_ERROR_EXECUTION;
+    }
+    
+    size_t op = QueryProfile_begin_operator(showAll ? "Show all components" : "Show component");
+    QUERY_PHASE_BEGIN(outer, QUERY_PHASE_SCAN);
+    QueryStatus status = show_entity(ecs, entity, showAll, typeId, outResult);
+    QUERY_PHASE_END(outer);
+    QueryProfile_end_operator(op, 1, outResult->count);
+    return status;
+}
+
+bool QueryExecutor_is_component_predicate(QueryAST* predicate) {
+    if (!predicate) return false;
+    
+    ASTNodeType type = QueryAST_get_type(predicate);
+    return type == AST_HAS || type == AST_HAS_ANY || type == AST_NOT_HAS;
+}
+
 QueryStatus QueryExecutor_execute(ECS* ecs, QueryAST* ast, QueryEngineResult* outResult) {
+    return QueryExecutor_execute_catalog(ecs, NULL, ast, NULL, 0, outResult);
+}
+
+QueryStatus QueryExecutor_execute_catalog(ECS* ecs,
+                                          QueryCatalog* catalog,
+                                          QueryAST* ast,
+                                          const double* paramValues,
+                                          size_t paramCount,
+                                          QueryEngineResult* outResult) {
     if (!ecs || !ast || !outResult) {
         return QUERY_ERROR_EXECUTION;
     }
     
     // Initialize result
-    outResult->entities = NULL;
-    outResult->count = 0;
-    outResult->capacity = 0;
-    outResult->data = NULL;
+    QueryEngineResult_init(outResult);
     
     ASTNodeType queryType = QueryAST_get_type(ast);
     
@@ -30,12 +310,31 @@ QueryStatus QueryExecutor_execute(ECS* ecs, QueryAST* ast, QueryEngineResult* ou
         // SELECT or COUNT entities WHERE ...
         QueryAST* predicate = QueryAST_get_left(ast);
         
+        uint64_t limit;
+        QueryStatus status = QueryExecutor_get_limit(ast, &limit);
+        if (status != QUERY_SUCCESS) {
+            return status;
+        }
+        
+        uint64_t sampleSize;
+        SampleMode sampleMode = QueryExecutor_get_sampling(ast, &sampleSize);
+        if (sampleMode != SAMPLE_NONE) {
+            return QueryExecutor_execute_sampled(ecs, catalog, queryType, predicate, paramValues, paramCount,
+                                                 sampleMode, sampleSize, outResult);
+        }
+        
         if (!predicate) {
             // No WHERE clause - return all entities (not typical, but handle it)
             // For now, return empty result
             return QUERY_SUCCESS;
         }
         
+        if (!QueryExecutor_is_component_predicate(predicate)) {
+            // Filters and AND/OR conditions
+            return QueryExecutor_execute_condition(ecs, catalog, queryType, predicate,
+                                                   paramValues, paramCount, limit, outResult);
+        }
+        
         ASTNodeType predicateType = QueryAST_get_type(predicate);
         ComponentList* componentList = (ComponentList*)QueryAST_get_data(predicate);
         
@@ -44,130 +343,50 @@ QueryStatus QueryExecutor_execute(ECS* ecs, QueryAST* ast, QueryEngineResult* ou
         }
         
         // Convert component names to ComponentTypeIds
-        ComponentTypeId* typeIds = (ComponentTypeId*)ALLOC(sizeof(ComponentTypeId) * componentList->count);
+        ComponentTypeId* typeIds = (ComponentTypeId*)QUERY_ALLOC(sizeof(ComponentTypeId) * componentList->count);
         if (!typeIds) {
             return QUERY_ERROR_EXECUTION;
         }
         
-        size_t validCount = 0;
-        for (size_t i = 0; i < componentList->count; i++) {
-            ComponentTypeId typeId = ECS_get_component_type_by_name(ecs, componentList->componentNames[i]);
-            if (typeId != COMPONENT_TYPE_INVALID) {
-                typeIds[validCount++] = typeId;
-            }
-        }
+        size_t validCount = QueryExecutor_resolve_components(ecs, componentList, typeIds);
         
-        if (validCount == 0) {
-            FREE(typeIds);
-            return QUERY_SUCCESS; // No valid components, return empty result
-        }
+        status = QueryExecutor_execute_entities(ecs, queryType, predicateType, typeIds, validCount, limit, outResult);
         
-        // Query entities based on predicate type
-        struct QueryResult ecsResult;
-        if (predicateType == AST_HAS) {
-            ecsResult = ECS_query_entities(ecs, typeIds, validCount);
-        } else if (predicateType == AST_HAS_ANY) {
-            ecsResult = ECS_query_entities_any(ecs, typeIds, validCount);
-        } else if (predicateType == AST_NOT_HAS) {
-            ecsResult = ECS_query_entities_excluding(ecs, typeIds, validCount);
-        } else {
-            FREE(typeIds);
-            return QUERY_ERROR_EXECUTION;
-        }
-        
-        if (queryType == AST_COUNT) {
-            // For COUNT, just store the count
-            outResult->count = ecsResult.count;
-            outResult->entities = NULL;
-            outResult->capacity = 0;
-            outResult->data = NULL;
-            // Use ECS QueryResult_free for ECS QueryResult
-            QueryResult_free(&ecsResult);  // This is ECS QueryResult_free from gramarye_ecs/query.h
-        } else {
-            // For SELECT, copy entities
-            if (ecsResult.count > 0) {
-                outResult->entities = (QueryEntityId*)ALLOC(sizeof(EntityId) * ecsResult.count);
-                if (outResult->entities) {
-                    memcpy(outResult->entities, ecsResult.entities, sizeof(EntityId) * ecsResult.count);
-                    outResult->count = ecsResult.count;
-                    outResult->capacity = ecsResult.count;
-                    outResult->data = NULL;
-                }
-            }
-            // Use ECS QueryResult_free for ECS QueryResult (from gramarye_ecs/query.h)
-            QueryResult_free(&ecsResult);
-        }
-        
-        FREE(typeIds);
+        QUERY_FREE(typeIds);
+        return status;
         
     } else if (queryType == AST_SHOW) {
         // SHOW ComponentName OF entity <id> or SHOW ALL OF entity <id>
         ShowQueryData* showData = (ShowQueryData*)QueryAST_get_data(ast);
         
-        if (!showData || !showData->entityId) {
+        if (!showData) {
             return QUERY_ERROR_EXECUTION;
         }
+        if (!showData->entityId) {
+            // Unbound placeholder - use a prepared plan
+            return showData->entityParam ? QUERY_ERROR_INVALID_SYNTAX : QUERY_ERROR_EXECUTION;
+        }
         
         // Convert EntityIdData to EntityId (uuid_key_t from ECS)
         EntityId entity;
         entity.high = showData->entityId->high;
         entity.low = showData->entityId->low;
         
-        // Check if entity exists
-        if (!Entity_exists(ECS_get_entity_registry(ecs), entity)) {
-            return QUERY_ERROR_EXECUTION;
+        ComponentTypeId typeId = COMPONENT_TYPE_INVALID;
+        if (showData->componentName != NULL) {
+            QUERY_PHASE_BEGIN(outer, QUERY_PHASE_RESOLVE);
+            typeId = showData->typeResolved ? showData->typeId :
+                     query_type_by_name(ecs, showData->componentName);
+            QUERY_PHASE_END(outer);
         }
         
-        if (showData->componentName == NULL) {
-            // SHOW ALL - get all components for entity
-            const size_t MAX_COMPONENTS = 64;
-            ComponentTypeId componentTypes[MAX_COMPONENTS];
-            size_t componentCount = 0;
-            
-            ECS_get_entity_components(ecs, entity, componentTypes, &componentCount, MAX_COMPONENTS);
-            
-            // Store component info in result data
-            // For now, just store the count in result->count
-            // In a full implementation, we'd store component data
-            outResult->count = componentCount;
-            outResult->entities = NULL;
-            outResult->capacity = 0;
-            // TODO: Store component data in outResult->data
-        } else {
-            // SHOW single component
-            ComponentTypeId typeId = ECS_get_component_type_by_name(ecs, showData->componentName);
-            if (typeId == COMPONENT_TYPE_INVALID) {
-                return QUERY_ERROR_EXECUTION;
-            }
-            
-            void* componentData = ECS_get_component(ecs, entity, typeId);
-            if (!componentData) {
-                return QUERY_ERROR_EXECUTION;
-            }
-            
-            ComponentType* type = ECS_get_component_type(ecs, typeId);
-            if (!type) {
-                return QUERY_ERROR_EXECUTION;
-            }
-            
-            // Copy component data (ECS data is internal and shouldn't be freed by query engine)
-            outResult->data = ALLOC(type->size);
-            if (!outResult->data) {
-                return QUERY_ERROR_EXECUTION;
-            }
-            memcpy(outResult->data, componentData, type->size);
-            
-            // Store component data
-            outResult->count = 1; // One component
-            outResult->entities = NULL;
-            outResult->capacity = 0;
-        }
+        return QueryExecutor_show(ecs, entity, showData->componentName == NULL, typeId, outResult);
         
-    } else {
-        return QUERY_ERROR_EXECUTION;
+    } else if (queryType == AST_AGGREGATE) {
+        return QueryExecutor_execute_aggregate(ecs, catalog, ast, paramValues, paramCount, outResult);
     }
     
-    return QUERY_SUCCESS;
+    return QUERY_ERROR_EXECUTION;
 }
 
 QueryStatus QueryExecutor_query_entities(ECS* ecs, 
@@ -179,27 +398,24 @@ QueryStatus QueryExecutor_query_entities(ECS* ecs,
     }
     
     // Initialize result
-    outResult->entities = NULL;
-    outResult->count = 0;
-    outResult->capacity = 0;
-    outResult->data = NULL;
+    QueryEngineResult_init(outResult);
     
     // Convert component names to IDs
-    ComponentTypeId* typeIds = (ComponentTypeId*)ALLOC(sizeof(ComponentTypeId) * componentCount);
+    ComponentTypeId* typeIds = (ComponentTypeId*)QUERY_ALLOC(sizeof(ComponentTypeId) * componentCount);
     if (!typeIds) {
         return QUERY_ERROR_EXECUTION;
     }
     
     size_t validCount = 0;
     for (size_t i = 0; i < componentCount; i++) {
-        ComponentTypeId typeId = ECS_get_component_type_by_name(ecs, componentNames[i]);
+        ComponentTypeId typeId = query_type_by_name(ecs, componentNames[i]);
         if (typeId != COMPONENT_TYPE_INVALID) {
             typeIds[validCount++] = typeId;
         }
     }
     
     if (validCount == 0) {
-        FREE(typeIds);
+        QUERY_FREE(typeIds);
         return QUERY_SUCCESS;  // No valid components, return empty result
     }
     
@@ -207,7 +423,7 @@ QueryStatus QueryExecutor_query_entities(ECS* ecs,
     struct QueryResult ecsResult = ECS_query_entities(ecs, typeIds, validCount);
     
     // Copy results
-    outResult->entities = (QueryEntityId*)ALLOC(sizeof(EntityId) * ecsResult.count);
+    outResult->entities = (QueryEntityId*)QUERY_ALLOC(sizeof(EntityId) * ecsResult.count);
     if (outResult->entities) {
         memcpy(outResult->entities, ecsResult.entities, sizeof(EntityId) * ecsResult.count);
         outResult->count = ecsResult.count;
@@ -216,7 +432,7 @@ QueryStatus QueryExecutor_query_entities(ECS* ecs,
     }
     
     QueryResult_free(&ecsResult);
-    FREE(typeIds);
+    QUERY_FREE(typeIds);
     
     return QUERY_SUCCESS;
 }
@@ -230,7 +446,7 @@ QueryStatus QueryExecutor_inspect_component(ECS* ecs,
         return QUERY_ERROR_EXECUTION;
     }
     
-    ComponentTypeId typeId = ECS_get_component_type_by_name(ecs, componentName);
+    ComponentTypeId typeId = query_type_by_name(ecs, componentName);
     if (typeId == COMPONENT_TYPE_INVALID) {
         return QUERY_ERROR_EXECUTION;
     }
@@ -0,0 +1,328 @@
+#include "gramarye_query/explain.h"
+#include "gramarye_query/executor.h"
+#include "gramarye_query/catalog.h"
+#include "gramarye_query/parser.h"
+#include "gramarye_ecs/ecs.h"
+#include "gramarye_ecs/query.h"
+#include "gramarye_query/allocator.h"
+#include "internal.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+uint64_t QueryEstimate_add(uint64_t a, uint64_t b) {
+    return a > QUERY_ESTIMATE_UNKNOWN - b ? QUERY_ESTIMATE_UNKNOWN : a + b;
+}
+
+uint64_t QueryEstimate_scale(uint64_t rows, double factor) {
+    if (rows == QUERY_ESTIMATE_UNKNOWN) return QUERY_ESTIMATE_UNKNOWN;
+    
+    double scaled = (double)rows * factor + 0.5;
+    return scaled >= (double)QUERY_ESTIMATE_UNKNOWN ? QUERY_ESTIMATE_UNKNOWN : (uint64_t)scaled;
+}
+
+const char* QueryAccessPath_name(QueryAccessPath access) {
+    switch (access) {
+        case QUERY_ACCESS_NONE: return "none";
+        case QUERY_ACCESS_SCAN: return "scan";
+        case QUERY_ACCESS_INDEX: return "index";
+        case QUERY_ACCESS_HASH: return "hash index";
+        case QUERY_ACCESS_SPATIAL: return "spatial index";
+        case QUERY_ACCESS_CHANGES: return "change log";
+    }
+    return "?";
+}
+
+size_t QueryExplain_add(QueryExplain* explain, uint32_t depth, const char* label, uint64_t rows, uint64_t cost) {
+    if (explain->nodeCount == explain->nodeCapacity) {
+        size_t capacity = explain->nodeCapacity ? explain->nodeCapacity * 2 : 8;
+        QueryExplainNode* nodes = (QueryExplainNode*)QUERY_REALLOC(explain->nodes, sizeof(QueryExplainNode) * capacity);
+        if (!nodes) {
+            explain->failed = true;
+            return SIZE_MAX;
+        }
+        explain->nodes = nodes;
+        explain->nodeCapacity = capacity;
+    }
+    
+    QueryExplainNode* node = &explain->nodes[explain->nodeCount];
+    memset(node, 0, sizeof(QueryExplainNode));
+    snprintf(node->label, sizeof(node->label), "%s", label ? label : "");
+    node->depth = depth;
+    node->rows = rows;
+    node->cost = cost;
+    return explain->nodeCount++;
+}
+
+void QueryExplain_set_driving(QueryExplain* explain, ComponentTypeId typeId, QueryAccessPath access) {
+    if (explain->access == QUERY_ACCESS_NONE) {
+        explain->drivingType = typeId;
+        explain->access = access;
+    }
+}
+
+uint64_t QueryExplain_population(QueryExplain* explain, ECS* ecs, ComponentTypeId typeId) {
+    for (size_t i = 0; i < explain->populationCount; i++) {
+        if (explain->populations[i].typeId == typeId) {
+            return explain->populations[i].count;
+        }
+    }
+    
+    struct QueryResult ecsResult = ECS_query_entities(ecs, &typeId, 1);
+    uint64_t count = ecsResult.count;
+    if (ecsResult.entities) QueryResult_free(&ecsResult);
+    
+    QueryPopulation* populations = (QueryPopulation*)QUERY_REALLOC(explain->populations,
+                                                                   sizeof(QueryPopulation) * (explain->populationCount + 1));
+    if (!populations) {
+        explain->failed = true;
+        return count;
+    }
+    explain->populations = populations;
+    populations[explain->populationCount].typeId = typeId;
+    populations[explain->populationCount].count = count;
+    explain->populationCount++;
+    return count;
+}
+
+void QueryExplain_components(QueryExplain* explain, ECS* ecs, bool append, uint32_t depth, ASTNodeType predicateType,
+                             const ComponentTypeId* typeIds, size_t typeCount, uint64_t* outRows, uint64_t* outCost) {
+    uint64_t rows = 0;
+    uint64_t cost = 0;
+    ComponentTypeId driving = COMPONENT_TYPE_INVALID;
+    if (typeCount > 0 && predicateType == AST_HAS) {
+        // The smallest storage bounds the matches; each one is looked up in the others
+        rows = QUERY_ESTIMATE_UNKNOWN;
+        for (size_t i = 0; i < typeCount; i++) {
+            uint64_t population = QueryExplain_population(explain, ecs, typeIds[i]);
+            if (population < rows || driving == COMPONENT_TYPE_INVALID) {
+                rows = population;
+                driving = typeIds[i];
+            }
+        }
+        cost = QueryEstimate_scale(rows, (double)typeCount);
+    } else if (typeCount > 0 && predicateType == AST_HAS_ANY) {
+        for (size_t i = 0; i < typeCount; i++) {
+            rows = QueryEstimate_add(rows, QueryExplain_population(explain, ecs, typeIds[i]));
+        }
+        cost = rows;
+        driving = typeIds[0];
+    } else if (typeCount > 0) {
+        // not_has() reads every entity, and the ECS does not say how many there are
+        rows = QUERY_ESTIMATE_UNKNOWN;
+        cost = QUERY_ESTIMATE_UNKNOWN;
+    }
+    
+    if (append) {
+        char label[QUERY_OPERATOR_LABEL];
+        size_t length = (size_t)snprintf(label, sizeof(label), "Scan ");
+        QueryExecutor_describe_components(ecs, predicateType, typeIds, typeCount, label + length,
+                                          sizeof(label) - length);
+        QueryExplain_add(explain, depth, label, rows, cost);
+        if (typeCount > 0) {
+            QueryExplain_set_driving(explain, driving, QUERY_ACCESS_SCAN);
+        }
+    }
+    *outRows = rows;
+    *outCost = cost;
+}
+
+// The condition of a SELECT/COUNT/aggregate below depth
+static QueryStatus explain_predicate(ECS* ecs, QueryCatalog* catalog, QueryAST* predicate, uint32_t depth,
+                                     QueryExplain* explain, uint64_t* outRows, uint64_t* outCost) {
+    *outRows = 0;
+    *outCost = 0;
+    if (!predicate) {
+        return QUERY_SUCCESS; // No WHERE clause matches nothing
+    }
+    if (!QueryExecutor_is_component_predicate(predicate)) {
+        return QueryExecutor_explain_condition(ecs, catalog, predicate, NULL, 0, depth, explain, outRows, outCost);
+    }
+    
+    ComponentList* componentList = (ComponentList*)QueryAST_get_data(predicate);
+    size_t count = componentList ? componentList->count : 0;
+    ComponentTypeId* typeIds = (ComponentTypeId*)QUERY_ALLOC(sizeof(ComponentTypeId) * (count ? count : 1));
+    if (!typeIds) {
+        return QUERY_ERROR_EXECUTION;
+    }
+    size_t validCount = count > 0 ? QueryExecutor_resolve_components(ecs, componentList, typeIds) : 0;
+    QueryExplain_components(explain, ecs, true, depth, QueryAST_get_type(predicate), typeIds, validCount,
+                            outRows, outCost);
+    QUERY_FREE(typeIds);
+    return QUERY_SUCCESS;
+}
+
+static QueryStatus explain_select(ECS* ecs, QueryCatalog* catalog, QueryAST* ast, QueryExplain* explain) {
+    ASTNodeType queryType = QueryAST_get_type(ast);
+    uint64_t limit;
+    QueryStatus status = QueryExecutor_get_limit(ast, &limit);
+    if (status != QUERY_SUCCESS) {
+        return status;
+    }
+    
+    // Root labels match what EXPLAIN ANALYZE records for the same query
+    uint64_t sampleSize;
+    SampleMode mode = QueryExecutor_get_sampling(ast, &sampleSize);
+    char label[QUERY_OPERATOR_LABEL];
+    if (mode != SAMPLE_NONE) {
+        snprintf(label, sizeof(label), "%s %llu", mode == SAMPLE_APPROX ? "Approx" : "Sample",
+                 (unsigned long long)sampleSize);
+    } else if (queryType == AST_SELECT && limit != QUERY_LIMIT_NONE) {
+        snprintf(label, sizeof(label), "Select LIMIT %llu", (unsigned long long)limit);
+    } else {
+        snprintf(label, sizeof(label), queryType == AST_COUNT ? "Count" : "Select");
+    }
+    size_t root = QueryExplain_add(explain, 0, label, 0, 0);
+    
+    uint64_t rows;
+    uint64_t cost;
+    status = explain_predicate(ecs, catalog, QueryAST_get_left(ast), 1, explain, &rows, &cost);
+    if (status != QUERY_SUCCESS || root == SIZE_MAX) {
+        return status;
+    }
+    
+    uint64_t cap = mode == SAMPLE_ROWS ? sampleSize : mode == SAMPLE_NONE && queryType == AST_SELECT ? limit :
+                   QUERY_ESTIMATE_UNKNOWN;
+    explain->nodes[root].rows = rows < cap ? rows : cap;
+    explain->nodes[root].cost = cost;
+    return QUERY_SUCCESS;
+}
+
+static QueryStatus explain_aggregate(ECS* ecs, QueryCatalog* catalog, QueryAST* ast, QueryExplain* explain) {
+    AggregateQueryData* aggregate = (AggregateQueryData*)QueryAST_get_data(ast);
+    QueryField field;
+    if (!catalog || !QueryCatalog_find_field(catalog, aggregate->componentName, aggregate->fieldName, &field)) {
+        return QUERY_ERROR_EXECUTION;
+    }
+    
+    char label[QUERY_OPERATOR_LABEL];
+    snprintf(label, sizeof(label), "Aggregate %s(%s.%s)",
+             aggregate->kind == AGGREGATE_COUNT_DISTINCT ? "APPROX_COUNT_DISTINCT" : "APPROX_PERCENTILE",
+             aggregate->componentName, aggregate->fieldName);
+    size_t root = QueryExplain_add(explain, 0, label, 0, 0);
+    
+    // Without WHERE, every entity holding the field's component
+    uint64_t rows;
+    uint64_t cost;
+    QueryAST* condition = QueryAST_get_left(ast);
+    if (condition) {
+        QueryStatus status = explain_predicate(ecs, catalog, condition, 1, explain, &rows, &cost);
+        if (status != QUERY_SUCCESS) {
+            return status;
+        }
+    } else {
+        QueryExplain_components(explain, ecs, true, 1, AST_HAS, &field.typeId, 1, &rows, &cost);
+    }
+    
+    // One field read per matching entity
+    if (root != SIZE_MAX) {
+        explain->nodes[root].rows = rows;
+        explain->nodes[root].cost = QueryEstimate_add(cost, rows);
+    }
+    return QUERY_SUCCESS;
+}
+
+static QueryStatus explain_query(ECS* ecs, QueryCatalog* catalog, QueryAST* ast, QueryExplain* explain) {
+    ASTNodeType queryType = QueryAST_get_type(ast);
+    if (queryType == AST_SELECT || queryType == AST_COUNT) {
+        return explain_select(ecs, catalog, ast, explain);
+    }
+    if (queryType == AST_AGGREGATE) {
+        return explain_aggregate(ecs, catalog, ast, explain);
+    }
+    if (queryType == AST_SHOW) {
+        // One entity, found by id
+        ShowQueryData* showData = (ShowQueryData*)QueryAST_get_data(ast);
+        if (!showData) {
+            return QUERY_ERROR_EXECUTION;
+        }
+        QueryExplain_add(explain, 0, showData->componentName ? "Show component" : "Show all components", 1, 1);
+        return QUERY_SUCCESS;
+    }
+    
+    // CREATE INDEX changes the catalog rather than reading entities
+    return QUERY_ERROR_EXECUTION;
+}
+
+QueryStatus Query_explain(ECS* ecs, QueryCatalog* catalog, const char* queryString, QueryExplain* outExplain) {
+    if (!outExplain) {
+        return QUERY_ERROR_INVALID_SYNTAX;
+    }
+    memset(outExplain, 0, sizeof(QueryExplain));
+    outExplain->drivingType = COMPONENT_TYPE_INVALID;
+    if (!ecs || !queryString) {
+        return QUERY_ERROR_INVALID_SYNTAX;
+    }
+    outExplain->ecs = ecs;
+    
+    QueryParser* parser = QueryParser_new(queryString);
+    if (!parser) {
+        return QUERY_ERROR_PARSE;
+    }
+    QueryAST* ast = QueryParser_parse(parser);
+    if (!ast) {
+        QueryParser_destroy(parser);
+        return QUERY_ERROR_PARSE;
+    }
+    
+    QueryStatus status = explain_query(ecs, catalog, ast, outExplain);
+    if (status == QUERY_SUCCESS && outExplain->failed) {
+        status = QUERY_ERROR_EXECUTION;
+    }
+    if (status == QUERY_SUCCESS && outExplain->nodeCount > 0) {
+        outExplain->rows = outExplain->nodes[0].rows;
+        outExplain->cost = outExplain->nodes[0].cost;
+    }
+    
+    QueryAST_destroy(ast);
+    QueryParser_destroy(parser);
+    return status;
+}
+
+static void append_estimate(char* buffer, size_t size, size_t* length, const char* prefix, uint64_t value) {
+    if (value == QUERY_ESTIMATE_UNKNOWN) {
+        query_append(buffer, size, length, "%s?", prefix);
+    } else {
+        query_append(buffer, size, length, "%s%llu", prefix, (unsigned long long)value);
+    }
+}
+
+size_t QueryExplain_format(const QueryExplain* explain, char* buffer, size_t size) {
+    if (buffer && size > 0) buffer[0] = '\0';
+    if (!explain) return 0;
+    if (!buffer) size = 0;
+    
+    size_t length = 0;
+    for (size_t i = 0; i < explain->nodeCount; i++) {
+        const QueryExplainNode* node = &explain->nodes[i];
+        query_append(buffer, size, &length, "%*s%s  (", (int)(node->depth * 2), "", node->label);
+        append_estimate(buffer, size, &length, "rows ~", node->rows);
+        append_estimate(buffer, size, &length, ", cost ", node->cost);
+        query_append(buffer, size, &length, ")\n");
+    }
+    
+    if (explain->access != QUERY_ACCESS_NONE) {
+        const char* name = "all entities";
+        if (explain->drivingType != COMPONENT_TYPE_INVALID) {
+            ComponentType* type = ECS_get_component_type(explain->ecs, explain->drivingType);
+            name = type && type->name ? type->name : "?";
+        }
+        query_append(buffer, size, &length, "Driving %s via %s\n", name, QueryAccessPath_name(explain->access));
+    }
+    return length;
+}
+
+void QueryExplain_free(QueryExplain* explain) {
+    if (!explain) return;
+    
+    if (explain->nodes) {
+        QUERY_FREE(explain->nodes);
+    }
+    if (explain->populations) {
+        QUERY_FREE(explain->populations);
+    }
+    explain->nodeCount = 0;
+    explain->nodeCapacity = 0;
+    explain->populationCount = 0;
+}
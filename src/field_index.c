@@ -0,0 +1,390 @@
+#include "gramarye_query/field_index.h"
+#include "gramarye_query/entity_set.h"
+#include "gramarye_ecs/entity.h"
+#include "gramarye_query/allocator.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Merge the delta back once it holds more than 1/16 of the sorted entries
+// (but never for fewer than this many), or once 1/4 of them are dead
+#define FIELD_INDEX_MIN_DELTA 256
+
+// Where an entity's live entry is
+enum {
+    ENTRY_ABSENT = 0,
+    ENTRY_SORTED,
+    ENTRY_DELTA
+};
+
+typedef struct {
+    double value;
+    EntityId entity;
+} IndexEntry;
+
+struct FieldIndex {
+    IndexEntry* sorted;         // Ordered by (value, entity)
+    uint8_t* dead;              // dead[i] set when sorted[i] was removed
+    size_t sortedCount;
+    size_t deadCount;
+    
+    IndexEntry* delta;          // Unsorted recent inserts
+    size_t deltaCount;
+    size_t deltaCapacity;
+    
+    // Per entity, by dense index from map
+    EntityIndexMap* map;
+    double* values;             // Current value
+    uint32_t* deltaSlot;        // Position in delta when state is ENTRY_DELTA
+    uint8_t* state;
+    size_t stateCapacity;
+    
+    size_t liveCount;
+};
+
+static int compare_entries(const void* a, const void* b) {
+    const IndexEntry* left = (const IndexEntry*)a;
+    const IndexEntry* right = (const IndexEntry*)b;
+    if (left->value < right->value) return -1;
+    if (left->value > right->value) return 1;
+    if (left->entity.high != right->entity.high) return left->entity.high < right->entity.high ? -1 : 1;
+    if (left->entity.low != right->entity.low) return left->entity.low < right->entity.low ? -1 : 1;
+    return 0;
+}
+
+FieldIndex* FieldIndex_new(void) {
+    FieldIndex* index = (FieldIndex*)QUERY_ALLOC(sizeof(FieldIndex));
+    if (!index) return NULL;
+    
+    memset(index, 0, sizeof(FieldIndex));
+    index->map = EntityIndexMap_new(256);
+    if (!index->map) {
+        QUERY_FREE(index);
+        return NULL;
+    }
+    return index;
+}
+
+static void free_entries(FieldIndex* index) {
+    if (index->sorted) QUERY_FREE(index->sorted);
+    if (index->dead) QUERY_FREE(index->dead);
+    if (index->delta) QUERY_FREE(index->delta);
+    if (index->values) QUERY_FREE(index->values);
+    if (index->deltaSlot) QUERY_FREE(index->deltaSlot);
+    if (index->state) QUERY_FREE(index->state);
+}
+
+void FieldIndex_destroy(FieldIndex* index) {
+    if (!index) return;
+    
+    free_entries(index);
+    EntityIndexMap_destroy(index->map);
+    QUERY_FREE(index);
+}
+
+// Make the per-entity arrays cover every index the map has handed out
+static bool ensure_state(FieldIndex* index) {
+    size_t needed = EntityIndexMap_count(index->map);
+    if (needed <= index->stateCapacity) return true;
+    
+    size_t newCapacity = index->stateCapacity ? index->stateCapacity * 2 : 256;
+    while (newCapacity < needed) {
+        newCapacity *= 2;
+    }
+    
+    double* values = (double*)QUERY_ALLOC(sizeof(double) * newCapacity);
+    uint32_t* deltaSlot = (uint32_t*)QUERY_ALLOC(sizeof(uint32_t) * newCapacity);
+    uint8_t* state = (uint8_t*)QUERY_ALLOC(newCapacity);
+    if (!values || !deltaSlot || !state) {
+        if (values) QUERY_FREE(values);
+        if (deltaSlot) QUERY_FREE(deltaSlot);
+        if (state) QUERY_FREE(state);
+        return false;
+    }
+    
+    memset(state, ENTRY_ABSENT, newCapacity);
+    if (index->stateCapacity > 0) {
+        memcpy(values, index->values, sizeof(double) * index->stateCapacity);
+        memcpy(deltaSlot, index->deltaSlot, sizeof(uint32_t) * index->stateCapacity);
+        memcpy(state, index->state, index->stateCapacity);
+        QUERY_FREE(index->values);
+        QUERY_FREE(index->deltaSlot);
+        QUERY_FREE(index->state);
+    }
+    index->values = values;
+    index->deltaSlot = deltaSlot;
+    index->state = state;
+    index->stateCapacity = newCapacity;
+    return true;
+}
+
+bool FieldIndex_build(FieldIndex* index, const EntityId* entities, const double* values, size_t count) {
+    if (!index) return false;
+    
+    // Start over with a map sized for the input
+    free_entries(index);
+    EntityIndexMap_destroy(index->map);
+    memset(index, 0, sizeof(FieldIndex));
+    index->map = EntityIndexMap_new(count);
+    if (!index->map) return false;
+    
+    if (count == 0) return true;
+    
+    index->sorted = (IndexEntry*)QUERY_ALLOC(sizeof(IndexEntry) * count);
+    index->dead = (uint8_t*)QUERY_ALLOC(count);
+    if (!index->sorted || !index->dead) return false;
+    
+    for (size_t i = 0; i < count; i++) {
+        if (values[i] != values[i]) continue; // NaN
+        
+        uint32_t slot = EntityIndexMap_get_or_add(index->map, entities[i]);
+        if (slot == ENTITY_INDEX_INVALID || !ensure_state(index)) return false;
+        
+        index->values[slot] = values[i];
+        index->state[slot] = ENTRY_SORTED;
+        index->sorted[index->sortedCount].value = values[i];
+        index->sorted[index->sortedCount].entity = entities[i];
+        index->sortedCount++;
+    }
+    
+    qsort(index->sorted, index->sortedCount, sizeof(IndexEntry), compare_entries);
+    memset(index->dead, 0, count);
+    index->liveCount = index->sortedCount;
+    return true;
+}
+
+// Fold the delta into the sorted array and drop dead entries
+static bool merge(FieldIndex* index) {
+    size_t liveSorted = index->sortedCount - index->deadCount;
+    size_t total = liveSorted + index->deltaCount;
+    
+    IndexEntry* merged = (IndexEntry*)QUERY_ALLOC(sizeof(IndexEntry) * (total ? total : 1));
+    uint8_t* dead = (uint8_t*)QUERY_ALLOC(total ? total : 1);
+    if (!merged || !dead) {
+        if (merged) QUERY_FREE(merged);
+        if (dead) QUERY_FREE(dead);
+        return false;
+    }
+    
+    qsort(index->delta, index->deltaCount, sizeof(IndexEntry), compare_entries);
+    
+    size_t i = 0;
+    size_t j = 0;
+    size_t out = 0;
+    while (i < index->sortedCount || j < index->deltaCount) {
+        if (i < index->sortedCount && index->dead[i]) {
+            i++;
+            continue;
+        }
+        if (j >= index->deltaCount ||
+            (i < index->sortedCount && compare_entries(&index->sorted[i], &index->delta[j]) <= 0)) {
+            merged[out++] = index->sorted[i++];
+        } else {
+            uint32_t slot = EntityIndexMap_find(index->map, index->delta[j].entity);
+            index->state[slot] = ENTRY_SORTED;
+            merged[out++] = index->delta[j++];
+        }
+    }
+    memset(dead, 0, total ? total : 1);
+    
+    if (index->sorted) QUERY_FREE(index->sorted);
+    if (index->dead) QUERY_FREE(index->dead);
+    index->sorted = merged;
+    index->dead = dead;
+    index->sortedCount = out;
+    index->deadCount = 0;
+    index->deltaCount = 0;
+    return true;
+}
+
+static void maybe_merge(FieldIndex* index) {
+    size_t deltaLimit = index->sortedCount / 16;
+    if (deltaLimit < FIELD_INDEX_MIN_DELTA) {
+        deltaLimit = FIELD_INDEX_MIN_DELTA;
+    }
+    if (index->deltaCount > deltaLimit || index->deadCount > index->sortedCount / 4 + FIELD_INDEX_MIN_DELTA) {
+        merge(index); // On failure the index stays valid, just unmerged
+    }
+}
+
+// Position of the exact (value, entity) entry in the sorted array
+static size_t find_sorted(const FieldIndex* index, double value, EntityId entity) {
+    IndexEntry key;
+    key.value = value;
+    key.entity = entity;
+    
+    size_t low = 0;
+    size_t high = index->sortedCount;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (compare_entries(&index->sorted[mid], &key) < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+// Drop the live entry for dense slot, wherever it is
+static void unlink_slot(FieldIndex* index, uint32_t slot) {
+    if (index->state[slot] == ENTRY_SORTED) {
+        size_t position = find_sorted(index, index->values[slot], EntityIndexMap_entity_at(index->map, slot));
+        if (position < index->sortedCount && !index->dead[position]) {
+            index->dead[position] = 1;
+            index->deadCount++;
+        }
+    } else if (index->state[slot] == ENTRY_DELTA) {
+        // Swap-remove, fixing up the moved entry's slot
+        uint32_t position = index->deltaSlot[slot];
+        index->deltaCount--;
+        if (position != index->deltaCount) {
+            index->delta[position] = index->delta[index->deltaCount];
+            uint32_t moved = EntityIndexMap_find(index->map, index->delta[position].entity);
+            index->deltaSlot[moved] = position;
+        }
+    } else {
+        return;
+    }
+    
+    index->state[slot] = ENTRY_ABSENT;
+    index->liveCount--;
+}
+
+bool FieldIndex_set(FieldIndex* index, EntityId entity, double value) {
+    if (!index) return false;
+    
+    if (value != value) {
+        FieldIndex_remove(index, entity);
+        return true;
+    }
+    
+    uint32_t slot = EntityIndexMap_get_or_add(index->map, entity);
+    if (slot == ENTITY_INDEX_INVALID || !ensure_state(index)) {
+        return false;
+    }
+    
+    // Writes that leave the indexed value alone cost nothing
+    if (index->state[slot] != ENTRY_ABSENT && index->values[slot] == value) {
+        return true;
+    }
+    
+    if (index->deltaCount >= index->deltaCapacity) {
+        size_t newCapacity = index->deltaCapacity ? index->deltaCapacity * 2 : 64;
+        IndexEntry* newDelta = (IndexEntry*)QUERY_ALLOC(sizeof(IndexEntry) * newCapacity);
+        if (!newDelta) return false;
+        if (index->delta) {
+            memcpy(newDelta, index->delta, sizeof(IndexEntry) * index->deltaCount);
+            QUERY_FREE(index->delta);
+        }
+        index->delta = newDelta;
+        index->deltaCapacity = newCapacity;
+    }
+    
+    unlink_slot(index, slot);
+    
+    index->delta[index->deltaCount].value = value;
+    index->delta[index->deltaCount].entity = entity;
+    index->deltaSlot[slot] = (uint32_t)index->deltaCount;
+    index->deltaCount++;
+    index->values[slot] = value;
+    index->state[slot] = ENTRY_DELTA;
+    index->liveCount++;
+    
+    maybe_merge(index);
+    return true;
+}
+
+void FieldIndex_remove(FieldIndex* index, EntityId entity) {
+    if (!index) return;
+    
+    uint32_t slot = EntityIndexMap_find(index->map, entity);
+    if (slot == ENTITY_INDEX_INVALID || slot >= index->stateCapacity) return;
+    
+    unlink_slot(index, slot);
+    maybe_merge(index);
+}
+
+size_t FieldIndex_count(const FieldIndex* index) {
+    return index ? index->liveCount : 0;
+}
+
+size_t FieldIndex_pending(const FieldIndex* index) {
+    return index ? index->deltaCount : 0;
+}
+
+static bool above_low(double value, FieldRange range) {
+    return range.lowInclusive ? value >= range.low : value > range.low;
+}
+
+static bool below_high(double value, FieldRange range) {
+    return range.highInclusive ? value <= range.high : value < range.high;
+}
+
+// [first, last) of the sorted entries inside range, dead ones included
+static void sorted_bounds(const FieldIndex* index, FieldRange range, size_t* outFirst, size_t* outLast) {
+    size_t low = 0;
+    size_t high = index->sortedCount;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (above_low(index->sorted[mid].value, range)) {
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+    *outFirst = low;
+    
+    high = index->sortedCount;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (below_high(index->sorted[mid].value, range)) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    *outLast = low;
+}
+
+size_t FieldIndex_estimate_range(const FieldIndex* index, FieldRange range) {
+    if (!index) return 0;
+    
+    size_t first;
+    size_t last;
+    sorted_bounds(index, range, &first, &last);
+    return (last - first) + index->deltaCount;
+}
+
+size_t FieldIndex_collect_range(const FieldIndex* index, FieldRange range, EntityId* outEntities, size_t maxCount) {
+    if (!index || !outEntities) return 0;
+    
+    size_t first;
+    size_t last;
+    sorted_bounds(index, range, &first, &last);
+    
+    size_t count = 0;
+    for (size_t i = first; i < last && count < maxCount; i++) {
+        if (!index->dead[i]) {
+            outEntities[count++] = index->sorted[i].entity;
+        }
+    }
+    for (size_t i = 0; i < index->deltaCount && count < maxCount; i++) {
+        double value = index->delta[i].value;
+        if (above_low(value, range) && below_high(value, range)) {
+            outEntities[count++] = index->delta[i].entity;
+        }
+    }
+    return count;
+}
+
+size_t FieldIndex_memory_bytes(const FieldIndex* index) {
+    if (!index) return 0;
+    
+    return sizeof(FieldIndex) +
+           (sizeof(IndexEntry) + 1) * index->sortedCount +
+           sizeof(IndexEntry) * index->deltaCapacity +
+           (sizeof(double) + sizeof(uint32_t) + 1) * index->stateCapacity +
+           EntityIndexMap_memory_bytes(index->map);
+}
@@ -0,0 +1,1582 @@
+#include "gramarye_query/executor.h"
+#include "gramarye_query/catalog.h"
+#include "gramarye_query/field_index.h"
+#include "gramarye_query/spatial_index.h"
+#include "gramarye_query/hash_index.h"
+#include "gramarye_query/entity_set.h"
+#include "gramarye_query/parser.h"
+#include "gramarye_query/query.h"
+#include "gramarye_ecs/ecs.h"
+#include "gramarye_ecs/query.h"
+#include "gramarye_ecs/entity.h"
+#include "gramarye_ecs/component.h"
+#include "gramarye_query/allocator.h"
+#include "gramarye_query/profile.h"
+#include "gramarye_query/explain.h"
+#include "internal.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <math.h>
+
+// Relative cost of producing a node's entities without an index
+#define COST_SCAN (SIZE_MAX / 4)
+#define COST_SCAN_ALL (SIZE_MAX / 2)
+
+// Condition tree with names resolved and parameters substituted
+typedef struct ConditionNode {
+    ASTNodeType type;                   // AST_HAS/HAS_ANY/NOT_HAS/CHANGED/FILTER/WITHIN/INSIDE/AND/OR
+    struct ConditionNode** children;    // AND/OR, flattened
+    size_t childCount;
+    ComponentTypeId* typeIds;           // has family and CHANGED
+    size_t typeCount;
+    QueryField field;                   // Filter
+    FilterOp op;
+    double value;
+    FieldRange range;                   // Every op except NE and IN
+    FieldIndex* index;                  // Index usable for range, or NULL
+    double* values;                     // IN: sorted, distinct
+    size_t valueCount;
+    HashIndex* hash;                    // Index usable for = and IN, or NULL
+    QueryField fieldY;                  // WITHIN/INSIDE: position is (field, fieldY)
+    SpatialIndex* spatial;
+    SpatialRect rect;                   // Bounds of the region
+    double centerX;                     // WITHIN only
+    double centerY;
+    double radius;
+    size_t changeCount;                 // CHANGED: recorded changes over all types
+    QueryAST* source;                   // Names for EXPLAIN ANALYZE labels
+} ConditionNode;
+
+// Every EntityId an execution has produced, each written once as it leaves
+// the ECS or an index. Intermediate results are 32-bit handles (positions in
+// this table), so AND/OR/LIMIT move a quarter of the bytes and COUNT never
+// materializes ids at all.
+typedef struct {
+    EntityId* ids;
+    size_t count;
+    size_t capacity;
+} EntityTable;
+
+typedef struct {
+    ECS* ecs;
+    QueryCatalog* catalog;
+    const double* paramValues;
+    size_t paramCount;
+    QueryStatus status;                 // First compile error
+    EntityTable table;
+    size_t rowsIn;                      // Entities the last generated node examined
+} ConditionContext;
+
+// A compiled WHERE clause (see QueryCondition_compile)
+struct QueryCondition {
+    ECS* ecs;
+    QueryCatalog* catalog;
+    ConditionNode* root;
+};
+
+typedef struct {
+    uint32_t* items;                    // Handles into the context's table
+    size_t count;
+    size_t capacity;
+} HandleList;
+
+static void init_context(ConditionContext* ctx, ECS* ecs, QueryCatalog* catalog, const double* paramValues,
+                         size_t paramCount) {
+    ctx->ecs = ecs;
+    ctx->catalog = catalog;
+    ctx->paramValues = paramValues;
+    ctx->paramCount = paramCount;
+    ctx->status = QUERY_SUCCESS;
+    ctx->rowsIn = 0;
+    memset(&ctx->table, 0, sizeof(EntityTable));
+}
+
+// Make room for extra more entries; handles must stay below UINT32_MAX
+static bool grow_array(void** items, size_t* capacity, size_t count, size_t extra, size_t itemSize) {
+    if (extra > (size_t)UINT32_MAX - count) return false;
+    if (count + extra <= *capacity) return true;
+    
+    size_t newCapacity = *capacity ? *capacity * 2 : 64;
+    while (newCapacity < count + extra) {
+        newCapacity *= 2;
+    }
+    void* newItems = QUERY_REALLOC(*items, itemSize * newCapacity);
+    if (!newItems) return false;
+    *items = newItems;
+    *capacity = newCapacity;
+    return true;
+}
+
+static bool list_reserve(HandleList* list, size_t extra) {
+    return grow_array((void**)&list->items, &list->capacity, list->count, extra, sizeof(uint32_t));
+}
+
+static bool list_push(HandleList* list, uint32_t handle) {
+    if (list->count >= list->capacity && !list_reserve(list, 1)) return false;
+    list->items[list->count++] = handle;
+    return true;
+}
+
+static void list_free(HandleList* list) {
+    if (list->items) {
+        QUERY_FREE(list->items);
+    }
+    list->items = NULL;
+    list->count = 0;
+    list->capacity = 0;
+}
+
+// Space for extra ids at the end of the table, or NULL
+static EntityId* table_reserve(EntityTable* table, size_t extra) {
+    if (!grow_array((void**)&table->ids, &table->capacity, table->count, extra, sizeof(EntityId))) return NULL;
+    return table->ids + table->count;
+}
+
+// Record an id and hand out its handle
+static bool emit(ConditionContext* ctx, HandleList* out, EntityId entity) {
+    if (!table_reserve(&ctx->table, 1) || !list_push(out, (uint32_t)ctx->table.count)) return false;
+    ctx->table.ids[ctx->table.count++] = entity;
+    return true;
+}
+
+// Adopt count ids already written at the end of the table
+static bool emit_tail(ConditionContext* ctx, HandleList* out, size_t count) {
+    if (!list_reserve(out, count)) return false;
+    for (size_t i = 0; i < count; i++) {
+        out->items[out->count++] = (uint32_t)(ctx->table.count + i);
+    }
+    ctx->table.count += count;
+    return true;
+}
+
+static void free_node(ConditionNode* node) {
+    if (!node) return;
+    
+    for (size_t i = 0; i < node->childCount; i++) {
+        free_node(node->children[i]);
+    }
+    if (node->children) QUERY_FREE(node->children);
+    if (node->typeIds) QUERY_FREE(node->typeIds);
+    if (node->values) QUERY_FREE(node->values);
+    QUERY_FREE(node);
+}
+
+static bool add_child(ConditionNode* node, ConditionNode* child) {
+    ConditionNode** children = (ConditionNode**)QUERY_ALLOC(sizeof(ConditionNode*) * (node->childCount + 1));
+    if (!children) return false;
+    if (node->children) {
+        memcpy(children, node->children, sizeof(ConditionNode*) * node->childCount);
+        QUERY_FREE(node->children);
+    }
+    children[node->childCount++] = child;
+    node->children = children;
+    return true;
+}
+
+// Literal or bound placeholder value
+static bool resolve_value(ConditionContext* ctx, double literal, size_t param, double* outValue) {
+    if (param == 0) {
+        *outValue = literal;
+        return true;
+    }
+    if (!ctx->paramValues || param > ctx->paramCount) {
+        ctx->status = QUERY_ERROR_INVALID_SYNTAX; // Unbound placeholder - use a prepared plan
+        return false;
+    }
+    *outValue = ctx->paramValues[param - 1];
+    return true;
+}
+
+static int compare_values(const void* a, const void* b) {
+    double left = *(const double*)a;
+    double right = *(const double*)b;
+    return left < right ? -1 : (left > right ? 1 : 0);
+}
+
+// Fields, indexes and type ids of a filter; its values are bound per execution
+static bool compile_filter(ConditionContext* ctx, ConditionNode* node, FilterData* filter) {
+    if (!ctx->catalog || !QueryCatalog_find_field(ctx->catalog, filter->componentName, filter->fieldName, &node->field)) {
+        ctx->status = QUERY_ERROR_EXECUTION; // Unknown field
+        return false;
+    }
+    
+    node->op = filter->op;
+    if (filter->op == FILTER_OP_IN) {
+        node->hash = QueryCatalog_find_hash_index(ctx->catalog, &node->field);
+        node->values = (double*)QUERY_ALLOC(sizeof(double) * (filter->valueCount ? filter->valueCount : 1));
+        return node->values != NULL;
+    }
+    if (filter->op == FILTER_OP_NE) {
+        return true; // Not a range, never served by an index
+    }
+    
+    node->index = QueryCatalog_find_index(ctx->catalog, &node->field);
+    if (filter->op == FILTER_OP_EQ) {
+        node->hash = QueryCatalog_find_hash_index(ctx->catalog, &node->field);
+    }
+    return true;
+}
+
+static bool compile_spatial(ConditionContext* ctx, ConditionNode* node, SpatialQueryData* spatial) {
+    ComponentTypeId typeId = spatial->typeResolved ? spatial->typeId :
+                             query_type_by_name(ctx->ecs, spatial->componentName);
+    node->spatial = typeId == COMPONENT_TYPE_INVALID ? NULL :
+                    QueryCatalog_find_spatial_index(ctx->catalog, typeId, &node->field, &node->fieldY);
+    if (!node->spatial) {
+        ctx->status = QUERY_ERROR_EXECUTION; // No designated position for the component
+        return false;
+    }
+    return true;
+}
+
+// CHANGED(A, B): every listed type must be tracked; unknown names are skipped like has()
+static bool compile_changed(ConditionContext* ctx, ConditionNode* node, ComponentList* componentList) {
+    size_t count = componentList ? componentList->count : 0;
+    node->typeIds = (ComponentTypeId*)QUERY_ALLOC(sizeof(ComponentTypeId) * (count ? count : 1));
+    if (!node->typeIds) return false;
+    if (count > 0) {
+        node->typeCount = QueryExecutor_resolve_components(ctx->ecs, componentList, node->typeIds);
+    }
+    
+    for (size_t i = 0; i < node->typeCount; i++) {
+        const EntityId* changes;
+        size_t changeCount;
+        if (!QueryCatalog_get_changes(ctx->catalog, node->typeIds[i], &changes, &changeCount)) {
+            ctx->status = QUERY_ERROR_EXECUTION; // Changes are not tracked for the type, or some were lost
+            return false;
+        }
+    }
+    return true;
+}
+
+// Resolve every name in the condition. Literals and placeholders are left to
+// bind, so a compiled tree serves any number of executions.
+static ConditionNode* compile(ConditionContext* ctx, QueryAST* ast) {
+    ConditionNode* node = (ConditionNode*)QUERY_ALLOC(sizeof(ConditionNode));
+    if (!node) {
+        ctx->status = QUERY_ERROR_EXECUTION;
+        return NULL;
+    }
+    memset(node, 0, sizeof(ConditionNode));
+    node->type = QueryAST_get_type(ast);
+    node->source = ast;
+    
+    bool ok = true;
+    if (QueryExecutor_is_component_predicate(ast)) {
+        ComponentList* componentList = (ComponentList*)QueryAST_get_data(ast);
+        size_t count = componentList ? componentList->count : 0;
+        node->typeIds = (ComponentTypeId*)QUERY_ALLOC(sizeof(ComponentTypeId) * (count ? count : 1));
+        ok = node->typeIds != NULL;
+        if (ok && count > 0) {
+            node->typeCount = QueryExecutor_resolve_components(ctx->ecs, componentList, node->typeIds);
+        }
+    } else if (node->type == AST_FILTER) {
+        ok = compile_filter(ctx, node, (FilterData*)QueryAST_get_data(ast));
+    } else if (node->type == AST_CHANGED) {
+        ok = ctx->catalog && compile_changed(ctx, node, (ComponentList*)QueryAST_get_data(ast));
+    } else if (node->type == AST_WITHIN || node->type == AST_INSIDE) {
+        ok = ctx->catalog && compile_spatial(ctx, node, (SpatialQueryData*)QueryAST_get_data(ast));
+    } else if (node->type == AST_AND || node->type == AST_OR) {
+        QueryAST* sides[2] = {QueryAST_get_left(ast), QueryAST_get_right(ast)};
+        for (int i = 0; i < 2 && ok; i++) {
+            ConditionNode* child = compile(ctx, sides[i]);
+            if (!child) {
+                ok = false;
+            } else if (child->type == node->type) {
+                // Flatten (a AND b) AND c so the planner sees every conjunct at once
+                for (size_t j = 0; j < child->childCount && ok; j++) {
+                    ok = add_child(node, child->children[j]);
+                    if (ok) child->children[j] = NULL;
+                }
+                child->childCount = ok ? 0 : child->childCount;
+                free_node(child);
+            } else if (!add_child(node, child)) {
+                free_node(child);
+                ok = false;
+            }
+        }
+    } else {
+        ok = false;
+    }
+    
+    if (!ok) {
+        if (ctx->status == QUERY_SUCCESS) {
+            ctx->status = QUERY_ERROR_EXECUTION;
+        }
+        free_node(node);
+        return NULL;
+    }
+    return node;
+}
+
+// Resolve an IN list into sorted, distinct values (NaN can never match)
+static bool bind_value_list(ConditionContext* ctx, ConditionNode* node, const FilterData* filter) {
+    node->valueCount = 0;
+    for (size_t i = 0; i < filter->valueCount; i++) {
+        double value;
+        if (!resolve_value(ctx, filter->values[i], filter->valueParams[i], &value)) return false;
+        if (value == value) {
+            node->values[node->valueCount++] = value;
+        }
+    }
+    
+    qsort(node->values, node->valueCount, sizeof(double), compare_values);
+    size_t distinct = 0;
+    for (size_t i = 0; i < node->valueCount; i++) {
+        if (distinct == 0 || node->values[i] != node->values[distinct - 1]) {
+            node->values[distinct++] = node->values[i];
+        }
+    }
+    node->valueCount = distinct;
+    return true;
+}
+
+static bool bind_filter(ConditionContext* ctx, ConditionNode* node, const FilterData* filter) {
+    if (filter->op == FILTER_OP_IN) {
+        return bind_value_list(ctx, node, filter);
+    }
+    
+    double upper = 0.0;
+    if (!resolve_value(ctx, filter->value, filter->valueParam, &node->value)) return false;
+    if (filter->op == FILTER_OP_BETWEEN && !resolve_value(ctx, filter->upper, filter->upperParam, &upper)) return false;
+    
+    node->range.low = -INFINITY;
+    node->range.high = INFINITY;
+    node->range.lowInclusive = true;
+    node->range.highInclusive = true;
+    switch (filter->op) {
+        case FILTER_OP_EQ:
+            node->range.low = node->value;
+            node->range.high = node->value;
+            break;
+        case FILTER_OP_LT:
+            node->range.high = node->value;
+            node->range.highInclusive = false;
+            break;
+        case FILTER_OP_LE:
+            node->range.high = node->value;
+            break;
+        case FILTER_OP_GT:
+            node->range.low = node->value;
+            node->range.lowInclusive = false;
+            break;
+        case FILTER_OP_GE:
+            node->range.low = node->value;
+            break;
+        case FILTER_OP_BETWEEN:
+            node->range.low = node->value;
+            node->range.high = upper;
+            break;
+        case FILTER_OP_NE:
+        case FILTER_OP_IN:
+            break;
+    }
+    return true;
+}
+
+static bool bind_spatial(ConditionContext* ctx, ConditionNode* node, const SpatialQueryData* spatial) {
+    double args[4];
+    for (size_t i = 0; i < spatial->argCount; i++) {
+        if (!resolve_value(ctx, spatial->args[i], spatial->argParams[i], &args[i])) return false;
+    }
+    
+    if (node->type == AST_WITHIN) {
+        node->centerX = args[0];
+        node->centerY = args[1];
+        node->radius = args[2];
+        node->rect.minX = args[0] - args[2];
+        node->rect.minY = args[1] - args[2];
+        node->rect.maxX = args[0] + args[2];
+        node->rect.maxY = args[1] + args[2];
+    } else {
+        // Corners may come in either order
+        node->rect.minX = fmin(args[0], args[2]);
+        node->rect.minY = fmin(args[1], args[3]);
+        node->rect.maxX = fmax(args[0], args[2]);
+        node->rect.maxY = fmax(args[1], args[3]);
+    }
+    return true;
+}
+
+// Substitute this execution's literals and bound placeholders into a
+// compiled tree, and take the current change counts for the planner
+static bool bind(ConditionContext* ctx, ConditionNode* node) {
+    switch (node->type) {
+        case AST_FILTER:
+            return bind_filter(ctx, node, (const FilterData*)QueryAST_get_data(node->source));
+        case AST_WITHIN:
+        case AST_INSIDE:
+            return bind_spatial(ctx, node, (const SpatialQueryData*)QueryAST_get_data(node->source));
+        case AST_CHANGED:
+            node->changeCount = 0;
+            for (size_t i = 0; i < node->typeCount; i++) {
+                const EntityId* changes;
+                size_t changeCount = 0;
+                if (!QueryCatalog_get_changes(ctx->catalog, node->typeIds[i], &changes, &changeCount)) {
+                    ctx->status = QUERY_ERROR_EXECUTION; // Writes were lost since the plan was compiled
+                    return false;
+                }
+                node->changeCount += changeCount;
+            }
+            return true;
+        case AST_AND:
+        case AST_OR:
+            for (size_t i = 0; i < node->childCount; i++) {
+                if (!bind(ctx, node->children[i])) return false;
+            }
+            return true;
+        default:
+            return true;
+    }
+}
+
+static bool in_range(double value, FieldRange range) {
+    bool aboveLow = range.lowInclusive ? value >= range.low : value > range.low;
+    bool belowHigh = range.highInclusive ? value <= range.high : value < range.high;
+    return aboveLow && belowHigh;
+}
+
+static bool in_region(const ConditionNode* node, double x, double y) {
+    if (x < node->rect.minX || x > node->rect.maxX || y < node->rect.minY || y > node->rect.maxY) {
+        return false;
+    }
+    if (node->type == AST_INSIDE) return true;
+    
+    double dx = x - node->centerX;
+    double dy = y - node->centerY;
+    return dx * dx + dy * dy <= node->radius * node->radius;
+}
+
+static bool matches(ConditionContext* ctx, const ConditionNode* node, EntityId entity) {
+    switch (node->type) {
+        case AST_HAS:
+            for (size_t i = 0; i < node->typeCount; i++) {
+                if (!ECS_get_component(ctx->ecs, entity, node->typeIds[i])) return false;
+            }
+            return node->typeCount > 0;
+        case AST_HAS_ANY:
+            for (size_t i = 0; i < node->typeCount; i++) {
+                if (ECS_get_component(ctx->ecs, entity, node->typeIds[i])) return true;
+            }
+            return false;
+        case AST_NOT_HAS:
+            for (size_t i = 0; i < node->typeCount; i++) {
+                if (ECS_get_component(ctx->ecs, entity, node->typeIds[i])) return false;
+            }
+            return node->typeCount > 0;
+        case AST_FILTER: {
+            void* data = ECS_get_component(ctx->ecs, entity, node->field.typeId);
+            if (!data) return false;
+            double value = QueryField_read(&node->field, data);
+            if (node->op == FILTER_OP_NE) return value != node->value;
+            if (node->op == FILTER_OP_IN) {
+                return bsearch(&value, node->values, node->valueCount, sizeof(double), compare_values) != NULL;
+            }
+            return in_range(value, node->range);
+        }
+        case AST_CHANGED:
+            for (size_t i = 0; i < node->typeCount; i++) {
+                if (QueryCatalog_is_changed(ctx->catalog, entity, node->typeIds[i]) &&
+                    ECS_get_component(ctx->ecs, entity, node->typeIds[i])) {
+                    return true;
+                }
+            }
+            return false;
+        case AST_WITHIN:
+        case AST_INSIDE: {
+            void* data = ECS_get_component(ctx->ecs, entity, node->field.typeId);
+            if (!data) return false;
+            return in_region(node, QueryField_read(&node->field, data), QueryField_read(&node->fieldY, data));
+        }
+        case AST_AND:
+            for (size_t i = 0; i < node->childCount; i++) {
+                if (!matches(ctx, node->children[i], entity)) return false;
+            }
+            return true;
+        case AST_OR:
+            for (size_t i = 0; i < node->childCount; i++) {
+                if (matches(ctx, node->children[i], entity)) return true;
+            }
+            return false;
+        default:
+            return false;
+    }
+}
+
+// Whether a filter's range is narrow enough for its index to beat a scan
+static bool use_index(const ConditionNode* node) {
+    if (!node->index) return false;
+    
+    size_t indexed = FieldIndex_count(node->index);
+    size_t estimate = FieldIndex_estimate_range(node->index, node->range);
+    return (double)estimate <= QUERY_INDEX_MAX_SELECTIVITY * (double)indexed;
+}
+
+// Entities a hash lookup returns: exact, one probe per value
+static size_t hash_cost(const ConditionNode* node) {
+    const double* values = node->op == FILTER_OP_IN ? node->values : &node->value;
+    size_t count = node->op == FILTER_OP_IN ? node->valueCount : 1;
+    
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint64_t key;
+        if (QueryField_key_for_value(&node->field, values[i], &key)) {
+            total += HashIndex_count_key(node->hash, key);
+        }
+    }
+    return total;
+}
+
+// Rough number of entities touched to produce a node's matches
+static size_t estimate_cost(const ConditionNode* node) {
+    switch (node->type) {
+        case AST_FILTER:
+            if (node->hash) return hash_cost(node);
+            return use_index(node) ? FieldIndex_estimate_range(node->index, node->range) : COST_SCAN;
+        case AST_WITHIN:
+        case AST_INSIDE:
+            return SpatialIndex_estimate_rect(node->spatial, node->rect);
+        case AST_CHANGED:
+            return node->changeCount;
+        case AST_NOT_HAS:
+            return COST_SCAN_ALL;
+        case AST_AND: {
+            size_t best = COST_SCAN_ALL;
+            for (size_t i = 0; i < node->childCount; i++) {
+                size_t cost = estimate_cost(node->children[i]);
+                if (cost < best) best = cost;
+            }
+            return best;
+        }
+        case AST_OR: {
+            size_t total = 0;
+            for (size_t i = 0; i < node->childCount; i++) {
+                size_t cost = estimate_cost(node->children[i]);
+                total = cost > COST_SCAN_ALL - total ? COST_SCAN_ALL : total + cost;
+            }
+            return total;
+        }
+        default:
+            return COST_SCAN;
+    }
+}
+
+static const char* op_text(FilterOp op) {
+    switch (op) {
+        case FILTER_OP_EQ: return "=";
+        case FILTER_OP_NE: return "!=";
+        case FILTER_OP_LT: return "<";
+        case FILTER_OP_LE: return "<=";
+        case FILTER_OP_GT: return ">";
+        case FILTER_OP_GE: return ">=";
+        case FILTER_OP_BETWEEN: return "BETWEEN";
+        case FILTER_OP_IN: return "IN";
+    }
+    return "?";
+}
+
+// Label of a node for plan output: how it is generated, or as a per-entity check
+static void describe_node(ConditionContext* ctx, const ConditionNode* node, bool check, char* buffer, size_t size) {
+    switch (node->type) {
+        case AST_HAS:
+        case AST_HAS_ANY:
+        case AST_NOT_HAS:
+        case AST_CHANGED: {
+            const char* verb = check ? "Check" : node->type == AST_CHANGED ? "Changes" : "Scan";
+            size_t length = (size_t)snprintf(buffer, size, "%s ", verb);
+            QueryExecutor_describe_components(ctx->ecs, node->type, node->typeIds, node->typeCount,
+                                              buffer + length, size - length);
+            break;
+        }
+        case AST_FILTER: {
+            const FilterData* filter = (const FilterData*)QueryAST_get_data(node->source);
+            const char* path = check ? "" : node->hash ? " [hash]" : use_index(node) ? " [index]" : " [scan]";
+            if (node->op == FILTER_OP_IN) {
+                snprintf(buffer, size, "%s %s.%s IN (%zu values)%s", check ? "Check" : "Filter",
+                         filter->componentName, filter->fieldName, node->valueCount, path);
+            } else if (node->op == FILTER_OP_BETWEEN) {
+                snprintf(buffer, size, "%s %s.%s BETWEEN %g AND %g%s", check ? "Check" : "Filter",
+                         filter->componentName, filter->fieldName, node->range.low, node->range.high, path);
+            } else {
+                snprintf(buffer, size, "%s %s.%s %s %g%s", check ? "Check" : "Filter",
+                         filter->componentName, filter->fieldName, op_text(node->op), node->value, path);
+            }
+            break;
+        }
+        case AST_WITHIN:
+        case AST_INSIDE: {
+            const SpatialQueryData* spatial = (const SpatialQueryData*)QueryAST_get_data(node->source);
+            snprintf(buffer, size, "%s %s %s%s", check ? "Check" : "Region",
+                     node->type == AST_WITHIN ? "WITHIN" : "INSIDE", spatial->componentName,
+                     check ? "" : " [spatial]");
+            break;
+        }
+        case AST_AND:
+            snprintf(buffer, size, check ? "Check AND" : "And");
+            break;
+        case AST_OR:
+            snprintf(buffer, size, check ? "Check OR" : "Or");
+            break;
+        default:
+            snprintf(buffer, size, "?");
+            break;
+    }
+}
+
+static bool generate(ConditionContext* ctx, const ConditionNode* node, HandleList* out, size_t maxCount);
+
+static bool generate_from_ecs(struct QueryResult ecsResult, ConditionContext* ctx, const ConditionNode* check,
+                              HandleList* out, size_t maxCount) {
+    size_t wanted = ecsResult.count < maxCount - out->count ? ecsResult.count : maxCount - out->count;
+    EntityId* tail = table_reserve(&ctx->table, wanted);
+    bool ok = wanted == 0 || tail != NULL;
+    
+    // Survivors are copied straight into the table
+    size_t kept = 0;
+    for (size_t i = 0; i < ecsResult.count && kept < wanted && ok; i++) {
+        if (!check || matches(ctx, check, ecsResult.entities[i])) {
+            tail[kept++] = ecsResult.entities[i];
+        }
+    }
+    ok = ok && emit_tail(ctx, out, kept);
+    ctx->rowsIn = ecsResult.count;
+    QueryResult_free(&ecsResult);
+    return ok;
+}
+
+// One probe per value; the values are distinct, so the buckets are disjoint
+static bool generate_hash(ConditionContext* ctx, const ConditionNode* node, HandleList* out, size_t maxCount) {
+    const double* values = node->op == FILTER_OP_IN ? node->values : &node->value;
+    size_t count = node->op == FILTER_OP_IN ? node->valueCount : 1;
+    QueryCatalog_record_hash_lookup(ctx->catalog, &node->field);
+    ctx->rowsIn = 0;
+    
+    bool ok = true;
+    for (size_t i = 0; i < count && out->count < maxCount && ok; i++) {
+        uint64_t key;
+        if (!QueryField_key_for_value(&node->field, values[i], &key)) continue;
+        
+        size_t wanted = HashIndex_count_key(node->hash, key);
+        if (wanted > maxCount - out->count) {
+            wanted = maxCount - out->count;
+        }
+        if (wanted == 0) continue;
+        
+        EntityId* tail = table_reserve(&ctx->table, wanted);
+        if (!tail) return false;
+        size_t collected = HashIndex_collect(node->hash, key, tail, wanted);
+        ctx->rowsIn += collected;
+        ok = emit_tail(ctx, out, collected);
+    }
+    return ok;
+}
+
+static bool generate_filter(ConditionContext* ctx, const ConditionNode* node, HandleList* out, size_t maxCount) {
+    if (node->hash) {
+        return generate_hash(ctx, node, out, maxCount);
+    }
+    if (!use_index(node)) {
+        // Scan the component's storage and test each value
+        struct QueryResult ecsResult = ECS_query_entities(ctx->ecs, (ComponentTypeId*)&node->field.typeId, 1);
+        return generate_from_ecs(ecsResult, ctx, node, out, maxCount);
+    }
+    
+    ctx->rowsIn = 0;
+    size_t estimate = FieldIndex_estimate_range(node->index, node->range);
+    if (estimate > maxCount - out->count) {
+        estimate = maxCount - out->count;
+    }
+    if (estimate == 0) return true;
+    
+    EntityId* tail = table_reserve(&ctx->table, estimate);
+    if (!tail) return false;
+    
+    size_t count = FieldIndex_collect_range(node->index, node->range, tail, estimate);
+    ctx->rowsIn = count;
+    QueryCatalog_record_scan(ctx->catalog, &node->field);
+    return emit_tail(ctx, out, count);
+}
+
+// Only the grid cells around the region are visited
+static bool generate_spatial(ConditionContext* ctx, const ConditionNode* node, HandleList* out, size_t maxCount) {
+    ctx->rowsIn = 0;
+    size_t estimate = SpatialIndex_estimate_rect(node->spatial, node->rect);
+    if (estimate > maxCount - out->count) {
+        estimate = maxCount - out->count;
+    }
+    if (estimate == 0) return true;
+    
+    EntityId* tail = table_reserve(&ctx->table, estimate);
+    if (!tail) return false;
+    
+    size_t count;
+    if (node->type == AST_WITHIN) {
+        count = SpatialIndex_collect_circle(node->spatial, node->centerX, node->centerY, node->radius, tail, estimate);
+    } else {
+        count = SpatialIndex_collect_rect(node->spatial, node->rect, tail, estimate);
+    }
+    ctx->rowsIn = count;
+    QueryCatalog_record_spatial_scan(ctx->catalog, node->field.typeId);
+    return emit_tail(ctx, out, count);
+}
+
+// Walk the recorded changes; entities that lost the component since are skipped
+static bool generate_changed(ConditionContext* ctx, const ConditionNode* node, HandleList* out, size_t maxCount) {
+    EntityIndexMap* seen = node->typeCount > 1 ? EntityIndexMap_new(256) : NULL;
+    if (node->typeCount > 1 && !seen) return false;
+    
+    size_t walked = 0;
+    bool ok = true;
+    for (size_t i = 0; i < node->typeCount && out->count < maxCount && ok; i++) {
+        const EntityId* changes;
+        size_t changeCount = 0;
+        QueryCatalog_get_changes(ctx->catalog, node->typeIds[i], &changes, &changeCount);
+        
+        for (size_t e = 0; e < changeCount && out->count < maxCount && ok; e++) {
+            walked++;
+            if (!ECS_get_component(ctx->ecs, changes[e], node->typeIds[i])) continue;
+            if (seen) {
+                size_t before = EntityIndexMap_count(seen);
+                if (EntityIndexMap_get_or_add(seen, changes[e]) == ENTITY_INDEX_INVALID) {
+                    ok = false;
+                    break;
+                }
+                if (EntityIndexMap_count(seen) == before) continue;
+            }
+            ok = emit(ctx, out, changes[e]);
+        }
+    }
+    
+    EntityIndexMap_destroy(seen);
+    ctx->rowsIn = walked;
+    return ok;
+}
+
+// Child of an AND that produces its candidates most cheaply
+static size_t cheapest_child(const ConditionNode* node) {
+    size_t driver = 0;
+    size_t best = SIZE_MAX;
+    for (size_t i = 0; i < node->childCount; i++) {
+        size_t cost = estimate_cost(node->children[i]);
+        if (cost < best) {
+            best = cost;
+            driver = i;
+        }
+    }
+    return driver;
+}
+
+// Drive the conjunction from its cheapest child and test the rest per entity
+static bool generate_and(ConditionContext* ctx, const ConditionNode* node, HandleList* out, size_t maxCount) {
+    size_t driver = cheapest_child(node);
+    
+    HandleList candidates = {NULL, 0, 0};
+    if (!generate(ctx, node->children[driver], &candidates, SIZE_MAX)) {
+        list_free(&candidates);
+        return false;
+    }
+    
+    // EXPLAIN ANALYZE: entities each per-entity test saw and passed
+    uint64_t* tests = NULL;
+    if (QUERY_PROFILE_ANALYZING()) {
+        tests = (uint64_t*)QUERY_ALLOC(sizeof(uint64_t) * 2 * node->childCount);
+        if (tests) memset(tests, 0, sizeof(uint64_t) * 2 * node->childCount);
+    }
+    
+    // Survivors keep the driver's handles; their ids are already in the table
+    bool ok = true;
+    for (size_t e = 0; e < candidates.count && out->count < maxCount && ok; e++) {
+        EntityId entity = ctx->table.ids[candidates.items[e]];
+        bool keep = true;
+        for (size_t i = 0; i < node->childCount && keep; i++) {
+            if (i != driver) {
+                keep = matches(ctx, node->children[i], entity);
+                if (tests) {
+                    tests[2 * i]++;
+                    tests[2 * i + 1] += keep;
+                }
+            }
+        }
+        if (keep) {
+            ok = list_push(out, candidates.items[e]);
+        }
+    }
+    
+    if (tests) {
+        for (size_t i = 0; i < node->childCount; i++) {
+            if (i == driver) continue;
+            char label[QUERY_OPERATOR_LABEL];
+            describe_node(ctx, node->children[i], true, label, sizeof(label));
+            QueryProfile_add_check(label, tests[2 * i], tests[2 * i + 1]);
+        }
+        QUERY_FREE(tests);
+    }
+    ctx->rowsIn = candidates.count;
+    list_free(&candidates);
+    return ok;
+}
+
+// Union of the children, each entity once, in first-seen order
+static bool generate_or(ConditionContext* ctx, const ConditionNode* node, HandleList* out, size_t maxCount) {
+    EntityIndexMap* seen = EntityIndexMap_new(256);
+    if (!seen) return false;
+    
+    size_t parts = 0;
+    bool ok = true;
+    for (size_t i = 0; i < node->childCount && out->count < maxCount && ok; i++) {
+        HandleList part = {NULL, 0, 0};
+        ok = generate(ctx, node->children[i], &part, SIZE_MAX);
+        parts += part.count;
+        for (size_t e = 0; e < part.count && out->count < maxCount && ok; e++) {
+            size_t before = EntityIndexMap_count(seen);
+            uint32_t index = EntityIndexMap_get_or_add(seen, ctx->table.ids[part.items[e]]);
+            if (index == ENTITY_INDEX_INVALID) {
+                ok = false;
+            } else if (EntityIndexMap_count(seen) > before) {
+                ok = list_push(out, part.items[e]);
+            }
+        }
+        list_free(&part);
+    }
+    
+    EntityIndexMap_destroy(seen);
+    ctx->rowsIn = parts;
+    return ok;
+}
+
+static bool generate_node(ConditionContext* ctx, const ConditionNode* node, HandleList* out, size_t maxCount) {
+    switch (node->type) {
+        case AST_HAS:
+        case AST_HAS_ANY:
+        case AST_NOT_HAS: {
+            if (node->typeCount == 0) return true; // No valid components, empty
+            struct QueryResult ecsResult;
+            if (node->type == AST_HAS) {
+                ecsResult = ECS_query_entities(ctx->ecs, node->typeIds, node->typeCount);
+            } else if (node->type == AST_HAS_ANY) {
+                ecsResult = ECS_query_entities_any(ctx->ecs, node->typeIds, node->typeCount);
+            } else {
+                ecsResult = ECS_query_entities_excluding(ctx->ecs, node->typeIds, node->typeCount);
+            }
+            return generate_from_ecs(ecsResult, ctx, NULL, out, maxCount);
+        }
+        case AST_FILTER:
+            return generate_filter(ctx, node, out, maxCount);
+        case AST_WITHIN:
+        case AST_INSIDE:
+            return generate_spatial(ctx, node, out, maxCount);
+        case AST_CHANGED:
+            return generate_changed(ctx, node, out, maxCount);
+        case AST_AND:
+            return generate_and(ctx, node, out, maxCount);
+        case AST_OR:
+            return generate_or(ctx, node, out, maxCount);
+        default:
+            return false;
+    }
+}
+
+// Under EXPLAIN ANALYZE each generated node is an operator
+static bool generate(ConditionContext* ctx, const ConditionNode* node, HandleList* out, size_t maxCount) {
+    if (!QUERY_PROFILE_ANALYZING()) {
+        return generate_node(ctx, node, out, maxCount);
+    }
+    
+    char label[QUERY_OPERATOR_LABEL];
+    describe_node(ctx, node, false, label, sizeof(label));
+    size_t op = QueryProfile_begin_operator(label);
+    size_t before = out->count;
+    ctx->rowsIn = 0;
+    bool ok = generate_node(ctx, node, out, maxCount);
+    QueryProfile_end_operator(op, ctx->rowsIn, out->count - before);
+    return ok;
+}
+
+// Late materialization: turn the final handles into the result's EntityIds
+static bool materialize(EntityTable* table, const HandleList* list, QueryEngineResult* outResult) {
+    // Every table entry, in order (a lone source): hand the table over as is
+    bool identity = list->count == table->count;
+    for (size_t i = 0; i < list->count && identity; i++) {
+        identity = list->items[i] == i;
+    }
+    if (identity) {
+        outResult->entities = (QueryEntityId*)table->ids;
+        outResult->count = table->count;
+        outResult->capacity = table->capacity;
+        table->ids = NULL;
+        return true;
+    }
+    
+    EntityId* entities = (EntityId*)QUERY_ALLOC(sizeof(EntityId) * list->count);
+    if (!entities) return false;
+    for (size_t i = 0; i < list->count; i++) {
+        entities[i] = table->ids[list->items[i]];
+    }
+    outResult->entities = (QueryEntityId*)entities;
+    outResult->count = list->count;
+    outResult->capacity = list->count;
+    return true;
+}
+
+QueryCondition* QueryCondition_compile(ECS* ecs, QueryCatalog* catalog, QueryAST* condition, QueryStatus* outStatus) {
+    QueryStatus ignored;
+    if (!outStatus) outStatus = &ignored;
+    *outStatus = QUERY_ERROR_EXECUTION;
+    if (!ecs || !condition) return NULL;
+    
+    QueryCondition* compiled = (QueryCondition*)QUERY_ALLOC(sizeof(QueryCondition));
+    if (!compiled) return NULL;
+    
+    ConditionContext ctx;
+    init_context(&ctx, ecs, catalog, NULL, 0);
+    QUERY_PHASE_BEGIN(outer, QUERY_PHASE_RESOLVE);
+    compiled->ecs = ecs;
+    compiled->catalog = catalog;
+    compiled->root = compile(&ctx, condition);
+    QUERY_PHASE_END(outer);
+    if (!compiled->root) {
+        QUERY_FREE(compiled);
+        *outStatus = ctx.status;
+        return NULL;
+    }
+    *outStatus = QUERY_SUCCESS;
+    return compiled;
+}
+
+void QueryCondition_destroy(QueryCondition* condition) {
+    if (!condition) return;
+    
+    free_node(condition->root);
+    QUERY_FREE(condition);
+}
+
+QueryStatus QueryExecutor_execute_compiled(QueryCondition* condition,
+                                           ASTNodeType queryType,
+                                           const double* paramValues,
+                                           size_t paramCount,
+                                           uint64_t limit,
+                                           QueryEngineResult* outResult) {
+    if (!condition || !outResult) {
+        return QUERY_ERROR_EXECUTION;
+    }
+    
+    ConditionContext ctx;
+    init_context(&ctx, condition->ecs, condition->catalog, paramValues, paramCount);
+    ConditionNode* root = condition->root;
+    
+    QUERY_PHASE_BEGIN(outer, QUERY_PHASE_RESOLVE);
+    bool bound = bind(&ctx, root);
+    QUERY_PHASE_END(outer);
+    if (!bound) {
+        return ctx.status;
+    }
+    
+    size_t maxCount = SIZE_MAX;
+    if (queryType == AST_SELECT && limit < (uint64_t)SIZE_MAX) {
+        maxCount = (size_t)limit;
+    }
+    
+    size_t rootOp = SIZE_MAX;
+    if (QUERY_PROFILE_ANALYZING()) {
+        char label[QUERY_OPERATOR_LABEL];
+        if (maxCount < SIZE_MAX) {
+            snprintf(label, sizeof(label), "Select LIMIT %llu", (unsigned long long)maxCount);
+        } else {
+            snprintf(label, sizeof(label), queryType == AST_COUNT ? "Count" : "Select");
+        }
+        rootOp = QueryProfile_begin_operator(label);
+    }
+    
+    QUERY_PHASE_BEGIN(scanOuter, QUERY_PHASE_SCAN);
+    HandleList list = {NULL, 0, 0};
+    bool ok = maxCount == 0 || generate(&ctx, root, &list, maxCount);
+    QUERY_PHASE_END(scanOuter);
+    
+    if (ok && queryType == AST_SELECT && list.count > 0) {
+        QUERY_PHASE_BEGIN(materializeOuter, QUERY_PHASE_MATERIALIZE);
+        ok = materialize(&ctx.table, &list, outResult);
+        QUERY_PHASE_END(materializeOuter);
+    } else if (ok) {
+        outResult->count = list.count;
+    }
+    
+    QueryProfile_end_operator(rootOp, list.count, ok ? outResult->count : 0);
+    list_free(&list);
+    if (ctx.table.ids) QUERY_FREE(ctx.table.ids);
+    return ok ? QUERY_SUCCESS : QUERY_ERROR_EXECUTION;
+}
+
+QueryStatus QueryExecutor_execute_condition(ECS* ecs,
+                                            QueryCatalog* catalog,
+                                            ASTNodeType queryType,
+                                            QueryAST* condition,
+                                            const double* paramValues,
+                                            size_t paramCount,
+                                            uint64_t limit,
+                                            QueryEngineResult* outResult) {
+    if (!ecs || !condition || !outResult) {
+        return QUERY_ERROR_EXECUTION;
+    }
+    
+    QueryStatus status;
+    QueryCondition* compiled = QueryCondition_compile(ecs, catalog, condition, &status);
+    if (!compiled) {
+        return status;
+    }
+    status = QueryExecutor_execute_compiled(compiled, queryType, paramValues, paramCount, limit, outResult);
+    QueryCondition_destroy(compiled);
+    return status;
+}
+
+// Fraction of its component a filter passes when it has to scan. No value
+// distribution is kept for unindexed fields, so these are the customary
+// fixed guesses.
+static double scan_selectivity(const ConditionNode* node) {
+    switch (node->op) {
+        case FILTER_OP_EQ: return 0.1;
+        case FILTER_OP_NE: return 0.9;
+        case FILTER_OP_BETWEEN: return 0.25;
+        case FILTER_OP_IN: return fmin(1.0, 0.1 * (double)node->valueCount);
+        default: return 1.0 / 3.0;
+    }
+}
+
+static void explain_node(ConditionContext* ctx, const ConditionNode* node, QueryExplain* explain, bool append,
+                         uint32_t depth, uint64_t* outRows, uint64_t* outCost);
+
+// Driven by the child generate_and would pick; each other child tests the
+// survivors, which are at most the smallest conjunct's matches
+static void explain_and(ConditionContext* ctx, const ConditionNode* node, QueryExplain* explain, bool append,
+                        uint32_t depth, uint64_t* outRows, uint64_t* outCost) {
+    size_t slot = append ? QueryExplain_add(explain, depth, "And", 0, 0) : SIZE_MAX;
+    size_t driver = cheapest_child(node);
+    uint64_t rows;
+    uint64_t cost;
+    explain_node(ctx, node->children[driver], explain, append, depth + 1, &rows, &cost);
+    
+    for (size_t i = 0; i < node->childCount; i++) {
+        if (i == driver) continue;
+        uint64_t childRows;
+        uint64_t childCost;
+        explain_node(ctx, node->children[i], explain, false, depth + 1, &childRows, &childCost);
+        uint64_t tested = rows;
+        cost = QueryEstimate_add(cost, tested);
+        if (childRows < rows) rows = childRows;
+        if (append) {
+            char label[QUERY_OPERATOR_LABEL];
+            describe_node(ctx, node->children[i], true, label, sizeof(label));
+            QueryExplain_add(explain, depth + 1, label, rows, tested);
+        }
+    }
+    
+    if (slot != SIZE_MAX) {
+        explain->nodes[slot].rows = rows;
+        explain->nodes[slot].cost = cost;
+    }
+    *outRows = rows;
+    *outCost = cost;
+}
+
+// Every child is generated; overlaps are not known, so rows is an upper bound
+static void explain_or(ConditionContext* ctx, const ConditionNode* node, QueryExplain* explain, bool append,
+                       uint32_t depth, uint64_t* outRows, uint64_t* outCost) {
+    size_t slot = append ? QueryExplain_add(explain, depth, "Or", 0, 0) : SIZE_MAX;
+    uint64_t rows = 0;
+    uint64_t cost = 0;
+    for (size_t i = 0; i < node->childCount; i++) {
+        uint64_t childRows;
+        uint64_t childCost;
+        explain_node(ctx, node->children[i], explain, append, depth + 1, &childRows, &childCost);
+        rows = QueryEstimate_add(rows, childRows);
+        cost = QueryEstimate_add(cost, childCost);
+    }
+    
+    if (slot != SIZE_MAX) {
+        explain->nodes[slot].rows = rows;
+        explain->nodes[slot].cost = cost;
+    }
+    *outRows = rows;
+    *outCost = cost;
+}
+
+// Estimate node as generate would run it; with append, also add its operators
+static void explain_node(ConditionContext* ctx, const ConditionNode* node, QueryExplain* explain, bool append,
+                         uint32_t depth, uint64_t* outRows, uint64_t* outCost) {
+    uint64_t rows = 0;
+    uint64_t cost = 0;
+    ComponentTypeId typeId = COMPONENT_TYPE_INVALID;
+    QueryAccessPath access = QUERY_ACCESS_NONE;
+    switch (node->type) {
+        case AST_HAS:
+        case AST_HAS_ANY:
+        case AST_NOT_HAS:
+            QueryExplain_components(explain, ctx->ecs, append, depth, node->type, node->typeIds, node->typeCount,
+                                    outRows, outCost);
+            return;
+        case AST_FILTER:
+            typeId = node->field.typeId;
+            if (node->hash) {
+                rows = hash_cost(node);
+                cost = rows;
+                access = QUERY_ACCESS_HASH;
+            } else if (use_index(node)) {
+                rows = FieldIndex_estimate_range(node->index, node->range);
+                cost = rows;
+                access = QUERY_ACCESS_INDEX;
+            } else {
+                // Too wide for its index, if it has one: the index still knows how many match
+                cost = QueryExplain_population(explain, ctx->ecs, typeId);
+                rows = node->index ? FieldIndex_estimate_range(node->index, node->range) :
+                       QueryEstimate_scale(cost, scan_selectivity(node));
+                access = QUERY_ACCESS_SCAN;
+            }
+            break;
+        case AST_WITHIN:
+        case AST_INSIDE:
+            typeId = node->field.typeId;
+            rows = SpatialIndex_estimate_rect(node->spatial, node->rect);
+            cost = rows;
+            access = QUERY_ACCESS_SPATIAL;
+            break;
+        case AST_CHANGED:
+            typeId = node->typeCount > 0 ? node->typeIds[0] : COMPONENT_TYPE_INVALID;
+            rows = node->changeCount;
+            cost = rows;
+            access = node->typeCount > 0 ? QUERY_ACCESS_CHANGES : QUERY_ACCESS_NONE;
+            break;
+        case AST_AND:
+            explain_and(ctx, node, explain, append, depth, outRows, outCost);
+            return;
+        case AST_OR:
+            explain_or(ctx, node, explain, append, depth, outRows, outCost);
+            return;
+        default:
+            break;
+    }
+    
+    if (append) {
+        char label[QUERY_OPERATOR_LABEL];
+        describe_node(ctx, node, false, label, sizeof(label));
+        QueryExplain_add(explain, depth, label, rows, cost);
+        if (access != QUERY_ACCESS_NONE) {
+            QueryExplain_set_driving(explain, typeId, access);
+        }
+    }
+    *outRows = rows;
+    *outCost = cost;
+}
+
+QueryStatus QueryExecutor_explain_condition(ECS* ecs,
+                                            QueryCatalog* catalog,
+                                            QueryAST* condition,
+                                            const double* paramValues,
+                                            size_t paramCount,
+                                            uint32_t depth,
+                                            QueryExplain* explain,
+                                            uint64_t* outRows,
+                                            uint64_t* outCost) {
+    if (!ecs || !condition || !explain || !outRows || !outCost) {
+        return QUERY_ERROR_EXECUTION;
+    }
+    
+    ConditionContext ctx;
+    init_context(&ctx, ecs, catalog, paramValues, paramCount);
+    
+    // Compiling picks indexes exactly as execution would; nothing is generated
+    ConditionNode* root = compile(&ctx, condition);
+    if (!root) {
+        return ctx.status;
+    }
+    if (!bind(&ctx, root)) {
+        free_node(root);
+        return ctx.status;
+    }
+    explain_node(&ctx, root, explain, true, depth, outRows, outCost);
+    free_node(root);
+    return explain->failed ? QUERY_ERROR_EXECUTION : QUERY_SUCCESS;
+}
+
+// Consecutive candidates (storage order) per stratum of an APPROX estimate
+#define SAMPLE_STRATUM_SIZE 4096
+
+// Fewest evaluations in a sampled stratum, so each has a variance estimate
+#define SAMPLE_MIN_PER_STRATUM 8
+
+// Two-sided 95% normal quantile
+#define SAMPLE_Z95 1.96
+
+// Candidates one branch of the condition is sampled from: a superset of its
+// matches, in storage order
+typedef struct {
+    EntityId* entities;                 // Shuffled in place while sampling
+    size_t count;
+    size_t drawn;                       // SAMPLE: entities already drawn, at the front
+    struct QueryResult ecsResult;       // Owner of entities when taken from the ECS
+    const ConditionNode* check;         // Condition a candidate must meet, NULL if all do
+    ConditionNode* const* exclude;      // Earlier OR branches: their matches count there
+    size_t excludeCount;
+} SampleSource;
+
+// splitmix64
+static uint64_t next_random(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static void take_ecs_result(SampleSource* source, struct QueryResult ecsResult) {
+    source->ecsResult = ecsResult;
+    source->entities = ecsResult.entities;
+    source->count = ecsResult.count;
+}
+
+// The smallest single-component list of typeIds. It holds every match of
+// has(typeIds) without intersecting the other lists, which are left to the
+// sampled entities. The ECS keeps no populations, so each list is read once.
+static void take_driver_list(ConditionContext* ctx, const ComponentTypeId* typeIds, size_t typeCount,
+                             SampleSource* source) {
+    bool taken = false;
+    for (size_t i = 0; i < typeCount; i++) {
+        struct QueryResult list = ECS_query_entities(ctx->ecs, (ComponentTypeId*)&typeIds[i], 1);
+        if (!taken || list.count < source->count) {
+            if (source->ecsResult.entities) QueryResult_free(&source->ecsResult);
+            take_ecs_result(source, list);
+            taken = true;
+        } else if (list.entities) {
+            QueryResult_free(&list);
+        }
+        if (source->count == 0) return; // Nothing can match
+    }
+}
+
+// Candidates for node without testing any of them: the storage an unindexed
+// scan would read, the driver of an AND or has(), or the exact matches of
+// nodes an index serves. *exact reports whether every candidate matches.
+static bool collect_candidates(ConditionContext* ctx, const ConditionNode* node, SampleSource* source, bool* exact) {
+    *exact = false;
+    switch (node->type) {
+        case AST_HAS:
+        case AST_HAS_ANY:
+        case AST_NOT_HAS:
+            *exact = node->type != AST_HAS || node->typeCount == 1;
+            if (node->typeCount == 0) {
+                *exact = true;
+                return true; // No valid components, empty
+            }
+            if (node->type == AST_HAS) {
+                take_driver_list(ctx, node->typeIds, node->typeCount, source);
+            } else if (node->type == AST_HAS_ANY) {
+                take_ecs_result(source, ECS_query_entities_any(ctx->ecs, node->typeIds, node->typeCount));
+            } else {
+                take_ecs_result(source, ECS_query_entities_excluding(ctx->ecs, node->typeIds, node->typeCount));
+            }
+            return true;
+        case AST_FILTER:
+            if (node->hash || use_index(node)) break;
+            take_ecs_result(source, ECS_query_entities(ctx->ecs, (ComponentTypeId*)&node->field.typeId, 1));
+            return true;
+        case AST_AND: {
+            bool driverExact;
+            return collect_candidates(ctx, node->children[cheapest_child(node)], source, &driverExact);
+        }
+        default:
+            break;
+    }
+    
+    // Index lookups, CHANGED and nested ORs are already proportional to their matches
+    HandleList list = {NULL, 0, 0};
+    bool ok = generate(ctx, node, &list, SIZE_MAX);
+    if (ok && list.count > 0) {
+        source->entities = (EntityId*)QUERY_ALLOC(sizeof(EntityId) * list.count);
+        ok = source->entities != NULL;
+        for (size_t i = 0; ok && i < list.count; i++) {
+            source->entities[i] = ctx->table.ids[list.items[i]];
+        }
+        source->count = ok ? list.count : 0;
+    }
+    list_free(&list);
+    *exact = true;
+    return ok;
+}
+
+static void release_sources(SampleSource* sources, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (sources[i].ecsResult.entities) {
+            QueryResult_free(&sources[i].ecsResult);
+        } else if (sources[i].entities) {
+            QUERY_FREE(sources[i].entities);
+        }
+    }
+    QUERY_FREE(sources);
+}
+
+// One source per branch of a top-level OR (so each branch keeps its own
+// driver), otherwise one for the whole condition. A match is counted in the
+// first branch it satisfies, which keeps the branches' counts disjoint.
+static SampleSource* build_sources(ConditionContext* ctx, const ConditionNode* root, size_t* outCount) {
+    size_t count = root->type == AST_OR ? root->childCount : 1;
+    SampleSource* sources = (SampleSource*)QUERY_ALLOC(sizeof(SampleSource) * (count ? count : 1));
+    if (!sources) return NULL;
+    memset(sources, 0, sizeof(SampleSource) * (count ? count : 1));
+    
+    for (size_t i = 0; i < count; i++) {
+        const ConditionNode* branch = root->type == AST_OR ? root->children[i] : root;
+        bool exact;
+        if (!collect_candidates(ctx, branch, &sources[i], &exact)) {
+            release_sources(sources, count);
+            return NULL;
+        }
+        sources[i].check = exact ? NULL : branch;
+        if (root->type == AST_OR) {
+            sources[i].exclude = root->children;
+            sources[i].excludeCount = i;
+        }
+    }
+    
+    *outCount = count;
+    return sources;
+}
+
+static bool sample_hit(ConditionContext* ctx, const SampleSource* source, EntityId entity) {
+    if (source->check && !matches(ctx, source->check, entity)) return false;
+    for (size_t i = 0; i < source->excludeCount; i++) {
+        if (matches(ctx, source->exclude[i], entity)) return false;
+    }
+    return true;
+}
+
+// Stratified estimate of one source's hits: strata are consecutive runs of
+// storage, each sampled without replacement in proportion to its size
+static void estimate_source(ConditionContext* ctx, SampleSource* source, double budget, uint64_t* rng,
+                            double* estimate, double* variance, size_t* sampled) {
+    size_t n = source->count;
+    if (budget >= (double)n) {
+        // Cheaper to test everything
+        for (size_t i = 0; i < n; i++) {
+            if (sample_hit(ctx, source, source->entities[i])) *estimate += 1.0;
+        }
+        *sampled += n;
+        return;
+    }
+    
+    size_t strata = (n + SAMPLE_STRATUM_SIZE - 1) / SAMPLE_STRATUM_SIZE;
+    size_t maxStrata = (size_t)(budget / SAMPLE_MIN_PER_STRATUM);
+    if (strata > maxStrata) strata = maxStrata;
+    if (strata == 0) strata = 1;
+    
+    for (size_t h = 0; h < strata; h++) {
+        size_t lo = (size_t)((double)n * (double)h / (double)strata);
+        size_t hi = (size_t)((double)n * (double)(h + 1) / (double)strata);
+        size_t size = hi - lo;
+        if (size == 0) continue;
+        
+        size_t take = (size_t)(budget * (double)size / (double)n + 0.5);
+        if (take < 2) take = 2;
+        if (take > size) take = size;
+        
+        // Partial Fisher-Yates: the first take slots become a uniform sample
+        size_t hits = 0;
+        for (size_t k = 0; k < take; k++) {
+            size_t j = lo + k + (size_t)(next_random(rng) % (uint64_t)(size - k));
+            EntityId picked = source->entities[j];
+            source->entities[j] = source->entities[lo + k];
+            source->entities[lo + k] = picked;
+            if (sample_hit(ctx, source, picked)) hits++;
+        }
+        *sampled += take;
+        
+        double p = (double)hits / (double)take;
+        *estimate += (double)size * p;
+        if (take < size) {
+            // An all-or-nothing stratum still leaves room for a miss: use half a hit
+            if (hits == 0) p = 0.5 / (double)take;
+            if (hits == take) p = 1.0 - 0.5 / (double)take;
+            double fpc = 1.0 - (double)take / (double)size;
+            *variance += (double)size * (double)size * fpc * p * (1.0 - p) / (double)(take - 1);
+        }
+    }
+}
+
+static bool estimate_count(ConditionContext* ctx, SampleSource* sources, size_t count, uint64_t budget,
+                           QueryEngineResult* outResult) {
+    QueryCountEstimate* result = (QueryCountEstimate*)QUERY_ALLOC(sizeof(QueryCountEstimate));
+    if (!result) return false;
+    memset(result, 0, sizeof(QueryCountEstimate));
+    
+    // Sources whose candidates all count need no sampling
+    double exact = 0.0;
+    size_t sampledPopulation = 0;
+    for (size_t i = 0; i < count; i++) {
+        result->population += sources[i].count;
+        if (!sources[i].check && sources[i].excludeCount == 0) {
+            exact += (double)sources[i].count;
+        } else {
+            sampledPopulation += sources[i].count;
+        }
+    }
+    
+    uint64_t rng = 0x243F6A8885A308D3ULL ^ (uint64_t)result->population;
+    double estimate = 0.0;
+    double variance = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        if (!sources[i].check && sources[i].excludeCount == 0) continue;
+        if (sources[i].count == 0) continue;
+        double share = (double)budget * (double)sources[i].count / (double)sampledPopulation;
+        if (share < SAMPLE_MIN_PER_STRATUM) share = SAMPLE_MIN_PER_STRATUM;
+        estimate_source(ctx, &sources[i], share, &rng, &estimate, &variance, &result->sampled);
+    }
+    
+    result->estimate = exact + estimate;
+    result->stdError = sqrt(variance);
+    result->low = fmax(0.0, result->estimate - SAMPLE_Z95 * result->stdError);
+    result->high = fmin((double)result->population, result->estimate + SAMPLE_Z95 * result->stdError);
+    
+    outResult->count = (size_t)(result->estimate + 0.5);
+    outResult->data = result;
+    return true;
+}
+
+// Uniform sample without replacement of the matches: candidates are drawn in
+// random order across all sources (each source weighted by what it has left)
+// until n of them match, so the work follows n and the match rate
+static bool sample_rows(ConditionContext* ctx, SampleSource* sources, size_t count, uint64_t n,
+                        QueryEngineResult* outResult) {
+    size_t remaining = 0;
+    for (size_t i = 0; i < count; i++) {
+        remaining += sources[i].count;
+    }
+    size_t wanted = n < (uint64_t)remaining ? (size_t)n : remaining;
+    if (wanted == 0) return true;
+    
+    EntityId* entities = (EntityId*)QUERY_ALLOC(sizeof(EntityId) * wanted);
+    if (!entities) return false;
+    
+    uint64_t rng = 0x243F6A8885A308D3ULL ^ (uint64_t)remaining;
+    size_t found = 0;
+    while (found < wanted && remaining > 0) {
+        size_t pick = (size_t)(next_random(&rng) % (uint64_t)remaining);
+        SampleSource* source = sources;
+        while (pick >= source->count - source->drawn) {
+            pick -= source->count - source->drawn;
+            source++;
+        }
+        
+        size_t j = source->drawn + (size_t)(next_random(&rng) % (uint64_t)(source->count - source->drawn));
+        EntityId candidate = source->entities[j];
+        source->entities[j] = source->entities[source->drawn];
+        source->entities[source->drawn++] = candidate;
+        remaining--;
+        
+        if (sample_hit(ctx, source, candidate)) {
+            entities[found++] = candidate;
+        }
+    }
+    
+    if (found == 0) {
+        QUERY_FREE(entities);
+        return true;
+    }
+    outResult->entities = (QueryEntityId*)entities;
+    outResult->count = found;
+    outResult->capacity = wanted;
+    return true;
+}
+
+// Sample root, bound to ctx's parameters (NULL for no WHERE clause)
+static QueryStatus run_sampled(ConditionContext* ctx, ConditionNode* root, SampleMode mode, uint64_t sampleSize,
+                               QueryEngineResult* outResult) {
+    if (root) {
+        QUERY_PHASE_BEGIN(outer, QUERY_PHASE_RESOLVE);
+        bool bound = bind(ctx, root);
+        QUERY_PHASE_END(outer);
+        if (!bound) {
+            return ctx->status;
+        }
+    }
+    
+    size_t op = SIZE_MAX;
+    if (QUERY_PROFILE_ANALYZING()) {
+        char label[QUERY_OPERATOR_LABEL];
+        snprintf(label, sizeof(label), "%s %llu", mode == SAMPLE_APPROX ? "Approx" : "Sample",
+                 (unsigned long long)sampleSize);
+        op = QueryProfile_begin_operator(label);
+    }
+    
+    // Sampling interleaves index reads, tests and result writes; all of it is scanning
+    QUERY_PHASE_BEGIN(scanOuter, QUERY_PHASE_SCAN);
+    size_t sourceCount = 0;
+    SampleSource* sources = root ? build_sources(ctx, root, &sourceCount) : NULL;
+    bool ok = !root || sources != NULL;
+    if (ok && mode == SAMPLE_APPROX) {
+        ok = estimate_count(ctx, sources, sourceCount, sampleSize, outResult);
+    } else if (ok) {
+        ok = sample_rows(ctx, sources, sourceCount, sampleSize, outResult);
+    }
+    QUERY_PHASE_END(scanOuter);
+    
+    size_t candidates = 0;
+    for (size_t i = 0; sources && i < sourceCount; i++) {
+        candidates += sources[i].count;
+    }
+    QueryProfile_end_operator(op, candidates, ok ? outResult->count : 0);
+    
+    if (sources) release_sources(sources, sourceCount);
+    if (ctx->table.ids) QUERY_FREE(ctx->table.ids);
+    return ok ? QUERY_SUCCESS : QUERY_ERROR_EXECUTION;
+}
+
+QueryStatus QueryExecutor_execute_compiled_sampled(QueryCondition* condition,
+                                                   ASTNodeType queryType,
+                                                   const double* paramValues,
+                                                   size_t paramCount,
+                                                   SampleMode mode,
+                                                   uint64_t sampleSize,
+                                                   QueryEngineResult* outResult) {
+    if (!condition || !outResult || mode == SAMPLE_NONE) {
+        return QUERY_ERROR_EXECUTION;
+    }
+    if ((mode == SAMPLE_ROWS) != (queryType == AST_SELECT)) {
+        return QUERY_ERROR_INVALID_SYNTAX; // SAMPLE is for SELECT, APPROX for COUNT
+    }
+    
+    ConditionContext ctx;
+    init_context(&ctx, condition->ecs, condition->catalog, paramValues, paramCount);
+    return run_sampled(&ctx, condition->root, mode, sampleSize, outResult);
+}
+
+QueryStatus QueryExecutor_execute_sampled(ECS* ecs,
+                                          QueryCatalog* catalog,
+                                          ASTNodeType queryType,
+                                          QueryAST* condition,
+                                          const double* paramValues,
+                                          size_t paramCount,
+                                          SampleMode mode,
+                                          uint64_t sampleSize,
+                                          QueryEngineResult* outResult) {
+    if (!ecs || !outResult || mode == SAMPLE_NONE) {
+        return QUERY_ERROR_EXECUTION;
+    }
+    if ((mode == SAMPLE_ROWS) != (queryType == AST_SELECT)) {
+        return QUERY_ERROR_INVALID_SYNTAX; // SAMPLE is for SELECT, APPROX for COUNT
+    }
+    
+    // No WHERE clause matches nothing, as in a full execution
+    ConditionContext ctx;
+    init_context(&ctx, ecs, catalog, paramValues, paramCount);
+    if (!condition) {
+        return run_sampled(&ctx, NULL, mode, sampleSize, outResult);
+    }
+    
+    QueryStatus status;
+    QueryCondition* compiled = QueryCondition_compile(ecs, catalog, condition, &status);
+    if (!compiled) {
+        return status;
+    }
+    status = run_sampled(&ctx, compiled->root, mode, sampleSize, outResult);
+    QueryCondition_destroy(compiled);
+    return status;
+}
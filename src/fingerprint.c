@@ -0,0 +1,126 @@
+#include "gramarye_query/query.h"
+#include "gramarye_query/parser.h"
+#include "internal.h"
+#include <ctype.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Token type, then the text of tokens whose text is part of the shape
+static uint64_t hash_token(uint64_t hash, const Token* token) {
+    unsigned char type = (unsigned char)token->type;
+    hash = query_fnv1a(hash, &type, 1);
+    if (token->type == TOKEN_IDENTIFIER || token->type == TOKEN_OPERATOR || token->type == TOKEN_ERROR) {
+        hash = query_fnv1a(hash, token->value, token->length);
+    }
+    return query_fnv1a(hash, "", 1);
+}
+
+static bool is_literal(TokenType type) {
+    return type == TOKEN_NUMBER || type == TOKEN_STRING || type == TOKEN_PLACEHOLDER;
+}
+
+static bool is_colon(const Token* token) {
+    return token->type == TOKEN_ERROR && token->length == 1 && token->value[0] == ':';
+}
+
+// Keywords written without a space before their "("
+static bool is_call(TokenType type) {
+    return type == TOKEN_HAS || type == TOKEN_HAS_ANY || type == TOKEN_NOT_HAS || type == TOKEN_CHANGED ||
+           type == TOKEN_APPROX_COUNT_DISTINCT || type == TOKEN_APPROX_PERCENTILE;
+}
+
+// Normalized text under construction, snprintf style
+typedef struct {
+    char* buffer;
+    size_t size;
+    size_t length;
+} Text;
+
+static void append(Text* text, const char* value, size_t length, bool upper) {
+    for (size_t i = 0; i < length; i++) {
+        if (text->buffer && text->length + 1 < text->size) {
+            char c = value[i];
+            text->buffer[text->length] = upper ? (char)toupper((unsigned char)c) : c;
+            text->buffer[text->length + 1] = '\0';
+        }
+        text->length++;
+    }
+}
+
+static void append_token(Text* text, const Token* token, const Token* previous) {
+    bool space = previous != NULL;
+    if (previous) {
+        if (token->type == TOKEN_RPAREN || token->type == TOKEN_COMMA || token->type == TOKEN_DOT ||
+            is_colon(token) || previous->type == TOKEN_LPAREN || previous->type == TOKEN_DOT ||
+            is_colon(previous) || (token->type == TOKEN_LPAREN && is_call(previous->type))) {
+            space = false;
+        }
+    }
+    if (space) {
+        append(text, " ", 1, false);
+    }
+    if (is_literal(token->type)) {
+        append(text, "?", 1, false);
+    } else {
+        append(text, token->value, token->length, token->type < TOKEN_IDENTIFIER);
+    }
+}
+
+uint64_t Query_normalize(const char* queryString, char* buffer, size_t size) {
+    Text text = {buffer, buffer ? size : 0, 0};
+    if (buffer && size > 0) buffer[0] = '\0';
+    if (!queryString) return 0;
+    
+    QueryParser* parser = QueryParser_new(queryString);
+    if (!parser) return 0;
+    
+    // Entity ids lex as number ':' number, so they normalize with the other
+    // literals. A comma between two literals is held back until the next
+    // token shows whether the list goes on; "1, 2, 3" hashes like "1" and
+    // reads "?, ...".
+    uint64_t hash = QUERY_FNV_OFFSET;
+    Token comma = {TOKEN_COMMA, ",", 1, 0, 0, COMPONENT_TYPE_INVALID};
+    Token marker = {TOKEN_NUMBER, "?", 1, 0, 0, COMPONENT_TYPE_INVALID};
+    Token previous = marker;
+    bool hasPrevious = false;
+    bool pendingComma = false;
+    bool collapsed = false;
+    Token token = QueryParser_next_token(parser);
+    while (token.type != TOKEN_EOF) {
+        bool literal = is_literal(token.type);
+        bool afterLiteral = hasPrevious && is_literal(previous.type);
+        if (token.type == TOKEN_COMMA && afterLiteral && !pendingComma) {
+            pendingComma = true;
+        } else if (literal && pendingComma) {
+            pendingComma = false;
+            if (!collapsed) {
+                append(&text, ", ...", 5, false);
+                collapsed = true;
+            }
+        } else {
+            if (pendingComma) {
+                hash = hash_token(hash, &comma);
+                append_token(&text, &comma, &previous);
+                previous = comma;
+                pendingComma = false;
+            }
+            hash = hash_token(hash, literal ? &marker : &token);
+            append_token(&text, &token, hasPrevious ? &previous : NULL);
+            previous = token;
+            hasPrevious = true;
+            collapsed = false;
+        }
+        token = QueryParser_next_token(parser);
+    }
+    if (pendingComma) {
+        hash = hash_token(hash, &comma);
+        append_token(&text, &comma, &previous);
+    }
+    QueryParser_destroy(parser);
+    return hash;
+}
+
+uint64_t Query_fingerprint(const char* queryString) {
+    return Query_normalize(queryString, NULL, 0);
+}
@@ -0,0 +1,402 @@
+#include "gramarye_query/frame.h"
+#include "gramarye_query/entity_set.h"
+#include "gramarye_query/roaring.h"
+#include "gramarye_query/parser.h"
+#include "gramarye_query/executor.h"
+#include "gramarye_query/query.h"
+#include "gramarye_ecs/ecs.h"
+#include "gramarye_ecs/query.h"
+#include "gramarye_ecs/entity.h"
+#include "gramarye_ecs/component.h"
+#include "gramarye_query/allocator.h"
+#include "internal.h"
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// One memoized sub-predicate: predicate kind over a canonical component set
+typedef struct {
+    ASTNodeType predicateType;
+    ComponentTypeId* typeIds;
+    size_t typeCount;
+    uint64_t hash;
+    RoaringBitmap* set;
+    size_t count;           // Cardinality of set
+} MemoEntry;
+
+struct QueryFrame {
+    ECS* ecs;
+    EntityIndexMap* indexMap;
+    MemoEntry** memo;
+    size_t memoCount;
+    size_t memoCapacity;
+    QueryFrameStats stats;
+};
+
+QueryFrame* QueryFrame_begin(ECS* ecs) {
+    if (!ecs) return NULL;
+    
+    QueryFrame* frame = (QueryFrame*)QUERY_ALLOC(sizeof(QueryFrame));
+    if (!frame) return NULL;
+    
+    memset(frame, 0, sizeof(QueryFrame));
+    frame->ecs = ecs;
+    frame->indexMap = EntityIndexMap_new(256);
+    if (!frame->indexMap) {
+        QUERY_FREE(frame);
+        return NULL;
+    }
+    
+    return frame;
+}
+
+void QueryFrame_end(QueryFrame* frame) {
+    if (!frame) return;
+    
+    for (size_t i = 0; i < frame->memoCount; i++) {
+        MemoEntry* entry = frame->memo[i];
+        RoaringBitmap_destroy(entry->set);
+        QUERY_FREE(entry->typeIds);
+        QUERY_FREE(entry);
+    }
+    if (frame->memo) {
+        QUERY_FREE(frame->memo);
+    }
+    EntityIndexMap_destroy(frame->indexMap);
+    QUERY_FREE(frame);
+}
+
+QueryFrameStats QueryFrame_get_stats(const QueryFrame* frame) {
+    QueryFrameStats stats;
+    memset(&stats, 0, sizeof(stats));
+    if (frame) {
+        stats = frame->stats;
+        stats.setCount = frame->memoCount;
+        stats.entityCount = EntityIndexMap_count(frame->indexMap);
+        for (size_t i = 0; i < frame->memoCount; i++) {
+            stats.setBytes += RoaringBitmap_memory_bytes(frame->memo[i]->set);
+        }
+    }
+    return stats;
+}
+
+static uint64_t hash_key(ASTNodeType predicateType, const ComponentTypeId* typeIds, size_t count) {
+    uint64_t hash = QUERY_FNV_OFFSET;
+    hash = (hash ^ (uint64_t)predicateType) * QUERY_FNV_PRIME;
+    for (size_t i = 0; i < count; i++) {
+        hash = (hash ^ (uint64_t)typeIds[i]) * QUERY_FNV_PRIME;
+    }
+    return hash;
+}
+
+static MemoEntry* find_memo(QueryFrame* frame, ASTNodeType predicateType, const ComponentTypeId* typeIds, size_t count) {
+    uint64_t hash = hash_key(predicateType, typeIds, count);
+    for (size_t i = 0; i < frame->memoCount; i++) {
+        MemoEntry* entry = frame->memo[i];
+        if (entry->hash == hash &&
+            entry->predicateType == predicateType &&
+            entry->typeCount == count &&
+            memcmp(entry->typeIds, typeIds, sizeof(ComponentTypeId) * count) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// Take ownership of set and record it under the given key
+static MemoEntry* add_memo(QueryFrame* frame, ASTNodeType predicateType, const ComponentTypeId* typeIds, size_t count,
+                           RoaringBitmap* set) {
+    if (frame->memoCount >= frame->memoCapacity) {
+        size_t newCapacity = frame->memoCapacity ? frame->memoCapacity * 2 : 16;
+        MemoEntry** newMemo = (MemoEntry**)QUERY_ALLOC(sizeof(MemoEntry*) * newCapacity);
+        if (!newMemo) return NULL;
+        if (frame->memo) {
+            memcpy(newMemo, frame->memo, sizeof(MemoEntry*) * frame->memoCount);
+            QUERY_FREE(frame->memo);
+        }
+        frame->memo = newMemo;
+        frame->memoCapacity = newCapacity;
+    }
+    
+    MemoEntry* entry = (MemoEntry*)QUERY_ALLOC(sizeof(MemoEntry));
+    if (!entry) return NULL;
+    entry->typeIds = (ComponentTypeId*)QUERY_ALLOC(sizeof(ComponentTypeId) * (count ? count : 1));
+    if (!entry->typeIds) {
+        QUERY_FREE(entry);
+        return NULL;
+    }
+    
+    memcpy(entry->typeIds, typeIds, sizeof(ComponentTypeId) * count);
+    entry->predicateType = predicateType;
+    entry->typeCount = count;
+    entry->hash = hash_key(predicateType, typeIds, count);
+    entry->set = set;
+    entry->count = RoaringBitmap_cardinality(set);
+    
+    frame->memo[frame->memoCount++] = entry;
+    return entry;
+}
+
+// has(X) or not_has(X) for a single component type, straight from the ECS
+static MemoEntry* term_set(QueryFrame* frame, ASTNodeType termType, ComponentTypeId typeId) {
+    MemoEntry* entry = find_memo(frame, termType, &typeId, 1);
+    if (entry) {
+        frame->stats.memoHits++;
+        return entry;
+    }
+    frame->stats.memoMisses++;
+    
+    struct QueryResult ecsResult;
+    if (termType == AST_HAS) {
+        ecsResult = ECS_query_entities(frame->ecs, &typeId, 1);
+    } else {
+        ecsResult = ECS_query_entities_excluding(frame->ecs, &typeId, 1);
+    }
+    
+    // Entities new to the frame get increasing indices, so most adds are appends
+    RoaringBitmap* set = RoaringBitmap_new();
+    bool ok = set != NULL;
+    for (size_t i = 0; ok && i < ecsResult.count; i++) {
+        uint32_t index = EntityIndexMap_get_or_add(frame->indexMap, ecsResult.entities[i]);
+        ok = index != ENTITY_INDEX_INVALID && RoaringBitmap_add(set, index);
+    }
+    QueryResult_free(&ecsResult);
+    
+    if (ok) {
+        RoaringBitmap_optimize(set);
+        entry = add_memo(frame, termType, &typeId, 1, set);
+    }
+    if (!entry) {
+        RoaringBitmap_destroy(set);
+    }
+    return entry;
+}
+
+// Full predicate over a canonical component set, composed from single terms
+static MemoEntry* predicate_set(QueryFrame* frame, ASTNodeType predicateType, const ComponentTypeId* typeIds, size_t count) {
+    if (count == 1 && predicateType != AST_HAS_ANY) {
+        return term_set(frame, predicateType, typeIds[0]);
+    }
+    
+    MemoEntry* entry = find_memo(frame, predicateType, typeIds, count);
+    if (entry) {
+        frame->stats.memoHits++;
+        return entry;
+    }
+    frame->stats.memoMisses++;
+    
+    // has_any(A, B) = has(A) | has(B); not_has(A, B) = not_has(A) & not_has(B)
+    ASTNodeType termType = predicateType == AST_NOT_HAS ? AST_NOT_HAS : AST_HAS;
+    
+    MemoEntry* first = term_set(frame, termType, typeIds[0]);
+    RoaringBitmap* set = first ? RoaringBitmap_copy(first->set) : NULL;
+    if (!set) {
+        return NULL;
+    }
+    
+    for (size_t i = 1; i < count; i++) {
+        MemoEntry* term = term_set(frame, termType, typeIds[i]);
+        bool ok = term != NULL;
+        if (ok && predicateType == AST_HAS_ANY) {
+            ok = RoaringBitmap_or(set, term->set);
+        } else if (ok) {
+            ok = RoaringBitmap_and(set, term->set);
+        }
+        if (!ok) {
+            RoaringBitmap_destroy(set);
+            return NULL;
+        }
+    }
+    
+    RoaringBitmap_optimize(set);
+    entry = add_memo(frame, predicateType, typeIds, count, set);
+    if (!entry) {
+        RoaringBitmap_destroy(set);
+    }
+    return entry;
+}
+
+// Memoized set for a component predicate; *outEntry stays NULL when the
+// predicate names no known component (empty result)
+static QueryStatus resolve_predicate(QueryFrame* frame, QueryAST* predicate, MemoEntry** outEntry) {
+    *outEntry = NULL;
+    
+    ComponentList* componentList = (ComponentList*)QueryAST_get_data(predicate);
+    if (!componentList || componentList->count == 0) {
+        return QUERY_SUCCESS; // Empty result
+    }
+    
+    ASTNodeType predicateType = QueryAST_get_type(predicate);
+    if (predicateType != AST_HAS && predicateType != AST_HAS_ANY && predicateType != AST_NOT_HAS) {
+        return QUERY_ERROR_EXECUTION;
+    }
+    
+    ComponentTypeId* typeIds = (ComponentTypeId*)QUERY_ALLOC(sizeof(ComponentTypeId) * componentList->count);
+    if (!typeIds) {
+        return QUERY_ERROR_EXECUTION;
+    }
+    
+    size_t count = QueryExecutor_canonical_components(frame->ecs, componentList, typeIds);
+    if (count == 0) {
+        QUERY_FREE(typeIds);
+        return QUERY_SUCCESS; // No valid components, return empty result
+    }
+    
+    *outEntry = predicate_set(frame, predicateType, typeIds, count);
+    QUERY_FREE(typeIds);
+    return *outEntry ? QUERY_SUCCESS : QUERY_ERROR_EXECUTION;
+}
+
+static QueryStatus execute_entity_query(QueryFrame* frame, QueryAST* ast, QueryEngineResult* outResult) {
+    ASTNodeType queryType = QueryAST_get_type(ast);
+    
+    uint64_t limit;
+    QueryStatus status = QueryExecutor_get_limit(ast, &limit);
+    if (status != QUERY_SUCCESS) {
+        return status;
+    }
+    
+    MemoEntry* entry;
+    status = resolve_predicate(frame, QueryAST_get_left(ast), &entry);
+    if (status != QUERY_SUCCESS || !entry) {
+        return status;
+    }
+    
+    if (queryType == AST_COUNT) {
+        outResult->count = entry->count;
+        return QUERY_SUCCESS;
+    }
+    
+    size_t resultCount = entry->count;
+    if (limit < (uint64_t)resultCount) {
+        resultCount = (size_t)limit;
+    }
+    if (resultCount > 0) {
+        outResult->entities = (QueryEntityId*)QUERY_ALLOC(sizeof(EntityId) * resultCount);
+        if (!outResult->entities) {
+            return QUERY_ERROR_EXECUTION;
+        }
+        outResult->count = RoaringBitmap_materialize(entry->set, frame->indexMap, (EntityId*)outResult->entities, resultCount);
+        outResult->capacity = resultCount;
+    }
+    
+    return QUERY_SUCCESS;
+}
+
+QueryStatus QueryFrame_execute(QueryFrame* frame, const char* queryString, QueryEngineResult* outResult) {
+    if (!frame || !queryString || !outResult) {
+        return QUERY_ERROR_INVALID_SYNTAX;
+    }
+    
+    // Initialize result
+    QueryEngineResult_init(outResult);
+    
+    QueryParser* parser = QueryParser_new(queryString);
+    if (!parser) {
+        return QUERY_ERROR_PARSE;
+    }
+    
+    QueryAST* ast = QueryParser_parse(parser);
+    if (!ast) {
+        QueryParser_destroy(parser);
+        return QUERY_ERROR_PARSE;
+    }
+    
+    frame->stats.queries++;
+    
+    QueryStatus status;
+    ASTNodeType queryType = QueryAST_get_type(ast);
+    QueryAST* predicate = QueryAST_get_left(ast);
+    if ((queryType == AST_SELECT || queryType == AST_COUNT) && QueryExecutor_is_component_predicate(predicate) &&
+        QueryExecutor_get_sampling(ast, NULL) == SAMPLE_NONE) {
+        status = execute_entity_query(frame, ast, outResult);
+    } else {
+        // SHOW, filters, samples and predicate-less queries have nothing to share
+        status = QueryExecutor_execute(frame->ecs, ast, outResult);
+    }
+    
+    QueryAST_destroy(ast);
+    QueryParser_destroy(parser);
+    
+    return status;
+}
+
+// Indices of a non-component query's entities, mapped into the frame
+static QueryStatus execute_fallback_bitmap(QueryFrame* frame, QueryAST* ast, RoaringBitmap* set) {
+    QueryEngineResult result;
+    QueryStatus status = QueryExecutor_execute(frame->ecs, ast, &result);
+    if (status != QUERY_SUCCESS) {
+        return status;
+    }
+    
+    // SHOW and filtered COUNT results carry no entity list
+    const EntityId* entities = (const EntityId*)result.entities;
+    bool ok = !result.data && (entities || result.count == 0);
+    for (size_t i = 0; ok && i < result.count; i++) {
+        uint32_t index = EntityIndexMap_get_or_add(frame->indexMap, entities[i]);
+        ok = index != ENTITY_INDEX_INVALID && RoaringBitmap_add(set, index);
+    }
+    QueryEngineResult_free(&result);
+    return ok ? QUERY_SUCCESS : QUERY_ERROR_EXECUTION;
+}
+
+QueryStatus QueryFrame_execute_bitmap(QueryFrame* frame, const char* queryString, RoaringBitmap** outSet) {
+    if (outSet) *outSet = NULL;
+    if (!frame || !queryString || !outSet) {
+        return QUERY_ERROR_INVALID_SYNTAX;
+    }
+    
+    QueryParser* parser = QueryParser_new(queryString);
+    if (!parser) {
+        return QUERY_ERROR_PARSE;
+    }
+    
+    QueryAST* ast = QueryParser_parse(parser);
+    if (!ast) {
+        QueryParser_destroy(parser);
+        return QUERY_ERROR_PARSE;
+    }
+    
+    frame->stats.queries++;
+    
+    QueryStatus status = QUERY_SUCCESS;
+    RoaringBitmap* set = NULL;
+    ASTNodeType queryType = QueryAST_get_type(ast);
+    QueryAST* predicate = QueryAST_get_left(ast);
+    if ((queryType == AST_SELECT || queryType == AST_COUNT) && QueryExecutor_is_component_predicate(predicate) &&
+        QueryExecutor_get_sampling(ast, NULL) == SAMPLE_NONE) {
+        MemoEntry* entry;
+        status = resolve_predicate(frame, predicate, &entry);
+        if (status == QUERY_SUCCESS) {
+            set = entry ? RoaringBitmap_copy(entry->set) : RoaringBitmap_new();
+        }
+    } else {
+        set = RoaringBitmap_new();
+        if (set) {
+            status = execute_fallback_bitmap(frame, ast, set);
+            RoaringBitmap_optimize(set);
+        }
+    }
+    if (status == QUERY_SUCCESS && !set) {
+        status = QUERY_ERROR_EXECUTION;
+    }
+    
+    QueryAST_destroy(ast);
+    QueryParser_destroy(parser);
+    
+    if (status != QUERY_SUCCESS) {
+        RoaringBitmap_destroy(set);
+        return status;
+    }
+    *outSet = set;
+    return QUERY_SUCCESS;
+}
+
+bool QueryFrame_entity_at(const QueryFrame* frame, uint32_t index, EntityId* outEntity) {
+    if (!frame || !outEntity || index >= EntityIndexMap_count(frame->indexMap)) {
+        return false;
+    }
+    
+    *outEntity = EntityIndexMap_entity_at(frame->indexMap, index);
+    return true;
+}
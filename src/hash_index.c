@@ -0,0 +1,239 @@
+#include "gramarye_query/hash_index.h"
+#include "gramarye_query/entity_set.h"
+#include "gramarye_ecs/entity.h"
+#include "gramarye_query/allocator.h"
+#include "internal.h"
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define BUCKET_NONE QUERY_GROUP_NONE
+
+typedef struct {
+    EntityId entity;
+    uint32_t slot;              // Dense index from the entity map
+} HashEntry;
+
+// Entities holding one key
+typedef struct {
+    uint64_t key;
+    HashEntry* entries;
+    size_t count;
+    size_t capacity;
+} HashBucket;
+
+struct HashIndex {
+    HashBucket* buckets;        // Every key ever seen; emptied buckets are kept for reuse
+    size_t bucketCount;
+    size_t bucketCapacity;
+    size_t liveKeyCount;
+    
+    uint32_t* table;            // Open addressing: bucket index + 1, 0 for empty
+    size_t tableCapacity;       // Power of two
+    
+    QuerySlots slots;           // Per entity: bucket and position in it
+    size_t liveCount;
+};
+
+HashIndex* HashIndex_new(void) {
+    HashIndex* index = (HashIndex*)QUERY_ALLOC(sizeof(HashIndex));
+    if (!index) return NULL;
+    
+    memset(index, 0, sizeof(HashIndex));
+    if (!query_slots_init(&index->slots)) {
+        QUERY_FREE(index);
+        return NULL;
+    }
+    return index;
+}
+
+void HashIndex_destroy(HashIndex* index) {
+    if (!index) return;
+    
+    for (size_t i = 0; i < index->bucketCount; i++) {
+        if (index->buckets[i].entries) QUERY_FREE(index->buckets[i].entries);
+    }
+    if (index->buckets) QUERY_FREE(index->buckets);
+    if (index->table) QUERY_FREE(index->table);
+    query_slots_free(&index->slots);
+    QUERY_FREE(index);
+}
+
+static uint32_t find_bucket(const HashIndex* index, uint64_t key) {
+    if (index->tableCapacity == 0) return BUCKET_NONE;
+    
+    size_t mask = index->tableCapacity - 1;
+    size_t position = query_mix64(key) & mask;
+    while (index->table[position] != 0) {
+        uint32_t bucket = index->table[position] - 1;
+        if (index->buckets[bucket].key == key) {
+            return bucket;
+        }
+        position = (position + 1) & mask;
+    }
+    return BUCKET_NONE;
+}
+
+static void table_insert(uint32_t* table, size_t capacity, uint64_t key, uint32_t bucketIndex) {
+    size_t mask = capacity - 1;
+    size_t position = query_mix64(key) & mask;
+    while (table[position] != 0) {
+        position = (position + 1) & mask;
+    }
+    table[position] = bucketIndex + 1;
+}
+
+static uint32_t add_bucket(HashIndex* index, uint64_t key) {
+    if (index->bucketCount >= BUCKET_NONE - 1) return BUCKET_NONE;
+    
+    // Keep the table at most half full
+    if ((index->bucketCount + 1) * 2 > index->tableCapacity) {
+        size_t newCapacity = index->tableCapacity ? index->tableCapacity * 2 : 64;
+        uint32_t* table = (uint32_t*)QUERY_ALLOC(sizeof(uint32_t) * newCapacity);
+        if (!table) return BUCKET_NONE;
+        memset(table, 0, sizeof(uint32_t) * newCapacity);
+        for (size_t i = 0; i < index->bucketCount; i++) {
+            table_insert(table, newCapacity, index->buckets[i].key, (uint32_t)i);
+        }
+        if (index->table) QUERY_FREE(index->table);
+        index->table = table;
+        index->tableCapacity = newCapacity;
+    }
+    
+    if (index->bucketCount >= index->bucketCapacity) {
+        size_t newCapacity = index->bucketCapacity ? index->bucketCapacity * 2 : 32;
+        HashBucket* buckets = (HashBucket*)QUERY_ALLOC(sizeof(HashBucket) * newCapacity);
+        if (!buckets) return BUCKET_NONE;
+        if (index->buckets) {
+            memcpy(buckets, index->buckets, sizeof(HashBucket) * index->bucketCount);
+            QUERY_FREE(index->buckets);
+        }
+        index->buckets = buckets;
+        index->bucketCapacity = newCapacity;
+    }
+    
+    uint32_t bucketIndex = (uint32_t)index->bucketCount++;
+    HashBucket* bucket = &index->buckets[bucketIndex];
+    memset(bucket, 0, sizeof(HashBucket));
+    bucket->key = key;
+    table_insert(index->table, index->tableCapacity, key, bucketIndex);
+    return bucketIndex;
+}
+
+static bool grow_bucket(HashBucket* bucket) {
+    size_t newCapacity = bucket->capacity ? bucket->capacity * 2 : 4;
+    HashEntry* entries = (HashEntry*)QUERY_ALLOC(sizeof(HashEntry) * newCapacity);
+    if (!entries) return false;
+    
+    if (bucket->entries) {
+        memcpy(entries, bucket->entries, sizeof(HashEntry) * bucket->count);
+        QUERY_FREE(bucket->entries);
+    }
+    bucket->entries = entries;
+    bucket->capacity = newCapacity;
+    return true;
+}
+
+// Drop the entry for dense slot from its bucket
+static void unlink_slot(HashIndex* index, uint32_t slot) {
+    uint32_t bucketIndex = index->slots.groupOf[slot];
+    if (bucketIndex == BUCKET_NONE) return;
+    
+    HashBucket* bucket = &index->buckets[bucketIndex];
+    query_slots_remove(&index->slots, slot, bucket->entries, &bucket->count, sizeof(HashEntry),
+                       offsetof(HashEntry, slot));
+    if (bucket->count == 0) {
+        index->liveKeyCount--;
+    }
+    index->liveCount--;
+}
+
+bool HashIndex_set(HashIndex* index, EntityId entity, uint64_t key) {
+    if (!index) return false;
+    
+    uint32_t slot = query_slots_claim(&index->slots, entity);
+    if (slot == ENTITY_INDEX_INVALID) {
+        return false;
+    }
+    
+    // Writes that leave the key alone cost nothing
+    uint32_t current = index->slots.groupOf[slot];
+    if (current != BUCKET_NONE && index->buckets[current].key == key) {
+        return true;
+    }
+    
+    uint32_t bucketIndex = find_bucket(index, key);
+    if (bucketIndex == BUCKET_NONE) {
+        bucketIndex = add_bucket(index, key);
+        if (bucketIndex == BUCKET_NONE) return false;
+    }
+    
+    HashBucket* bucket = &index->buckets[bucketIndex];
+    if (bucket->count >= bucket->capacity && !grow_bucket(bucket)) {
+        return false;
+    }
+    
+    unlink_slot(index, slot);
+    
+    if (bucket->count == 0) {
+        index->liveKeyCount++;
+    }
+    bucket->entries[bucket->count].entity = entity;
+    bucket->entries[bucket->count].slot = slot;
+    query_slots_place(&index->slots, slot, bucketIndex, (uint32_t)bucket->count);
+    bucket->count++;
+    index->liveCount++;
+    return true;
+}
+
+void HashIndex_remove(HashIndex* index, EntityId entity) {
+    if (!index) return;
+    
+    uint32_t slot = query_slots_find(&index->slots, entity);
+    if (slot == ENTITY_INDEX_INVALID) return;
+    
+    unlink_slot(index, slot);
+}
+
+size_t HashIndex_count(const HashIndex* index) {
+    return index ? index->liveCount : 0;
+}
+
+size_t HashIndex_count_key(const HashIndex* index, uint64_t key) {
+    if (!index) return 0;
+    
+    uint32_t bucketIndex = find_bucket(index, key);
+    return bucketIndex == BUCKET_NONE ? 0 : index->buckets[bucketIndex].count;
+}
+
+size_t HashIndex_collect(const HashIndex* index, uint64_t key, EntityId* outEntities, size_t maxCount) {
+    if (!index || !outEntities) return 0;
+    
+    uint32_t bucketIndex = find_bucket(index, key);
+    if (bucketIndex == BUCKET_NONE) return 0;
+    
+    const HashBucket* bucket = &index->buckets[bucketIndex];
+    size_t count = bucket->count < maxCount ? bucket->count : maxCount;
+    for (size_t i = 0; i < count; i++) {
+        outEntities[i] = bucket->entries[i].entity;
+    }
+    return count;
+}
+
+size_t HashIndex_key_count(const HashIndex* index) {
+    return index ? index->liveKeyCount : 0;
+}
+
+size_t HashIndex_memory_bytes(const HashIndex* index) {
+    if (!index) return 0;
+    
+    size_t bytes = sizeof(HashIndex) +
+                   sizeof(HashBucket) * index->bucketCapacity +
+                   sizeof(uint32_t) * index->tableCapacity +
+                   query_slots_memory_bytes(&index->slots);
+    for (size_t i = 0; i < index->bucketCount; i++) {
+        bytes += sizeof(HashEntry) * index->buckets[i].capacity;
+    }
+    return bytes;
+}
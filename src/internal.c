@@ -0,0 +1,135 @@
+#if !defined(_POSIX_C_SOURCE) && !defined(_GNU_SOURCE)
+#define _POSIX_C_SOURCE 199309L  // clock_gettime
+#endif
+
+#include "internal.h"
+#include "gramarye_query/profile.h"
+#include "gramarye_query/allocator.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+
+uint64_t query_fnv1a(uint64_t hash, const void* data, size_t length) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ bytes[i]) * QUERY_FNV_PRIME;
+    }
+    return hash;
+}
+
+uint32_t query_mix64(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return (uint32_t)key;
+}
+
+bool query_field_is_integer(QueryFieldType type) {
+    return type == QUERY_FIELD_I32 || type == QUERY_FIELD_U32 ||
+           type == QUERY_FIELD_I64 || type == QUERY_FIELD_U64;
+}
+
+uint64_t query_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+ComponentTypeId query_type_by_name(ECS* ecs, const char* name) {
+    QUERY_COUNT_LOOKUP();
+    return ECS_get_component_type_by_name(ecs, name);
+}
+
+void query_append(char* buffer, size_t size, size_t* length, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    size_t offset = *length < size ? *length : size;
+    int written = vsnprintf(buffer ? buffer + offset : NULL, buffer ? size - offset : 0, format, args);
+    va_end(args);
+    if (written > 0) {
+        *length += (size_t)written;
+    }
+}
+
+bool query_slots_init(QuerySlots* slots) {
+    memset(slots, 0, sizeof(QuerySlots));
+    slots->map = EntityIndexMap_new(256);
+    return slots->map != NULL;
+}
+
+void query_slots_free(QuerySlots* slots) {
+    if (slots->groupOf) QUERY_FREE(slots->groupOf);
+    if (slots->entryOf) QUERY_FREE(slots->entryOf);
+    EntityIndexMap_destroy(slots->map);
+    memset(slots, 0, sizeof(QuerySlots));
+}
+
+// Make the per-entity arrays cover every index the map has handed out
+static bool ensure_slots(QuerySlots* slots) {
+    size_t needed = EntityIndexMap_count(slots->map);
+    if (needed <= slots->capacity) return true;
+    
+    size_t newCapacity = slots->capacity ? slots->capacity * 2 : 256;
+    while (newCapacity < needed) {
+        newCapacity *= 2;
+    }
+    
+    uint32_t* groupOf = (uint32_t*)QUERY_ALLOC(sizeof(uint32_t) * newCapacity);
+    uint32_t* entryOf = (uint32_t*)QUERY_ALLOC(sizeof(uint32_t) * newCapacity);
+    if (!groupOf || !entryOf) {
+        if (groupOf) QUERY_FREE(groupOf);
+        if (entryOf) QUERY_FREE(entryOf);
+        return false;
+    }
+    
+    memset(groupOf, 0xff, sizeof(uint32_t) * newCapacity); // QUERY_GROUP_NONE
+    if (slots->capacity > 0) {
+        memcpy(groupOf, slots->groupOf, sizeof(uint32_t) * slots->capacity);
+        memcpy(entryOf, slots->entryOf, sizeof(uint32_t) * slots->capacity);
+        QUERY_FREE(slots->groupOf);
+        QUERY_FREE(slots->entryOf);
+    }
+    slots->groupOf = groupOf;
+    slots->entryOf = entryOf;
+    slots->capacity = newCapacity;
+    return true;
+}
+
+uint32_t query_slots_claim(QuerySlots* slots, EntityId entity) {
+    uint32_t slot = EntityIndexMap_get_or_add(slots->map, entity);
+    if (slot == ENTITY_INDEX_INVALID || !ensure_slots(slots)) {
+        return ENTITY_INDEX_INVALID;
+    }
+    return slot;
+}
+
+uint32_t query_slots_find(const QuerySlots* slots, EntityId entity) {
+    uint32_t slot = EntityIndexMap_find(slots->map, entity);
+    return slot < slots->capacity ? slot : ENTITY_INDEX_INVALID;
+}
+
+void query_slots_place(QuerySlots* slots, uint32_t slot, uint32_t group, uint32_t position) {
+    slots->groupOf[slot] = group;
+    slots->entryOf[slot] = position;
+}
+
+void query_slots_remove(QuerySlots* slots, uint32_t slot, void* entries, size_t* count,
+                        size_t entrySize, size_t slotOffset) {
+    unsigned char* bytes = (unsigned char*)entries;
+    uint32_t position = slots->entryOf[slot];
+    size_t last = --*count;
+    if (position != last) {
+        // The last entry takes the freed position
+        unsigned char* moved = bytes + entrySize * position;
+        memcpy(moved, bytes + entrySize * last, entrySize);
+        uint32_t movedSlot;
+        memcpy(&movedSlot, moved + slotOffset, sizeof(uint32_t));
+        slots->entryOf[movedSlot] = position;
+    }
+    slots->groupOf[slot] = QUERY_GROUP_NONE;
+}
+
+size_t query_slots_memory_bytes(const QuerySlots* slots) {
+    return sizeof(uint32_t) * 2 * slots->capacity + EntityIndexMap_memory_bytes(slots->map);
+}
@@ -0,0 +1,83 @@
+#ifndef GRAMARYE_QUERY_INTERNAL_H
+#define GRAMARYE_QUERY_INTERNAL_H
+
+// Helpers shared by the library's own sources. Not installed and not part
+// of the API: include it from src/*.c only.
+
+#include "gramarye_ecs/ecs.h"
+#include "gramarye_ecs/entity.h"
+#include "gramarye_ecs/component.h"
+#include "gramarye_query/catalog.h"
+#include "gramarye_query/entity_set.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Per-thread state (allocator scopes, profiles, trace rings)
+#if defined(__GNUC__) || defined(__clang__)
+#define THREAD_LOCAL __thread
+#else
+#define THREAD_LOCAL _Thread_local
+#endif
+
+// 64-bit FNV-1a. Keys made of whole words mix each word in with
+// hash = (hash ^ word) * QUERY_FNV_PRIME.
+#define QUERY_FNV_OFFSET 14695981039346656037ULL
+#define QUERY_FNV_PRIME 1099511628211ULL
+
+// Continue hash over length bytes; start from QUERY_FNV_OFFSET
+uint64_t query_fnv1a(uint64_t hash, const void* data, size_t length);
+
+// Murmur3 finalizer steps, spreading a 64-bit key over the low bits used to
+// pick an open-addressing slot
+uint32_t query_mix64(uint64_t key);
+
+// Whether a field holds an exact integer (hash keys, distinct counts)
+bool query_field_is_integer(QueryFieldType type);
+
+// CLOCK_MONOTONIC in nanoseconds, the clock of every latency the engine
+// reports and of trace timestamps
+uint64_t query_now_ns(void);
+
+// ECS_get_component_type_by_name, counted in the open profile's lookups.
+// Every name the library resolves against the ECS goes through here.
+ComponentTypeId query_type_by_name(ECS* ecs, const char* name);
+
+// Append printf-style text to a snprintf-style buffer (NULL measures only),
+// adding the full length of the text to *length even when it is cut
+void query_append(char* buffer, size_t size, size_t* length, const char* format, ...);
+
+// Per-entity placement for indexes that file entities into groups (hash
+// buckets, grid cells). The map hands each entity a dense slot; groupOf and
+// entryOf say which group holds its entry and where. A group's entries are
+// an array of structs carrying that slot as a uint32_t, so a swap-remove can
+// fix up the entry it moves.
+#define QUERY_GROUP_NONE UINT32_MAX
+
+typedef struct {
+    EntityIndexMap* map;
+    uint32_t* groupOf;          // QUERY_GROUP_NONE when absent
+    uint32_t* entryOf;          // Position in the group's entries
+    size_t capacity;            // Slots the two arrays cover
+} QuerySlots;
+
+bool query_slots_init(QuerySlots* slots);
+void query_slots_free(QuerySlots* slots);
+
+// Slot of entity, added if new (ENTITY_INDEX_INVALID if out of memory)
+uint32_t query_slots_claim(QuerySlots* slots, EntityId entity);
+
+// Slot of entity, ENTITY_INDEX_INVALID if it was never claimed
+uint32_t query_slots_find(const QuerySlots* slots, EntityId entity);
+
+// Record that slot's entry is entries[position] of group
+void query_slots_place(QuerySlots* slots, uint32_t slot, uint32_t group, uint32_t position);
+
+// Swap-remove slot's entry from the group holding it, given that group's
+// entries (entrySize bytes each, slot field at slotOffset) and count
+void query_slots_remove(QuerySlots* slots, uint32_t slot, void* entries, size_t* count,
+                        size_t entrySize, size_t slotOffset);
+
+size_t query_slots_memory_bytes(const QuerySlots* slots);
+
+#endif // GRAMARYE_QUERY_INTERNAL_H
@@ -1,5 +1,7 @@
 #include "gramarye_query/parser.h"
-#include "mem.h"
+#include "gramarye_query/symbols.h"
+#include "gramarye_query/allocator.h"
+#include "gramarye_query/profile.h"
 #include <string.h>
 #include <strings.h>  // For strncasecmp
 #include <ctype.h>
@@ -14,8 +16,14 @@ struct QueryParser {
     size_t length;
     size_t line;
     size_t column;
+    size_t paramCount;  // Highest placeholder index seen
+    size_t depth;       // Parenthesis nesting while parsing a condition
+    QuerySymbolTable* symbols;          // Component names resolved while lexing, may be NULL
 };
 
+// Deeper nesting is rejected rather than recursing without bound
+#define QUERY_PARSER_MAX_DEPTH 64
+
 // ASTNodeType is now defined in parser.h
 
 // Data structures are now defined in parser.h
@@ -31,9 +39,13 @@ struct QueryAST {
 };
 
 QueryParser* QueryParser_new(const char* queryString) {
+    return QueryParser_new_with_symbols(queryString, NULL);
+}
+
+QueryParser* QueryParser_new_with_symbols(const char* queryString, QuerySymbolTable* symbols) {
     if (!queryString) return NULL;
     
-    QueryParser* parser = (QueryParser*)ALLOC(sizeof(QueryParser));
+    QueryParser* parser = (QueryParser*)QUERY_ALLOC(sizeof(QueryParser));
     if (!parser) return NULL;
     
     parser->input = queryString;
@@ -41,13 +53,16 @@ QueryParser* QueryParser_new(const char* queryString) {
     parser->length = strlen(queryString);
     parser->line = 1;
     parser->column = 1;
+    parser->paramCount = 0;
+    parser->depth = 0;
+    parser->symbols = symbols;
     
     return parser;
 }
 
 void QueryParser_destroy(QueryParser* parser) {
     if (parser) {
-        FREE(parser);
+        QUERY_FREE(parser);
     }
 }
 
@@ -73,6 +88,7 @@ static Token read_identifier(QueryParser* parser) {
     token.line = parser->line;
     token.column = parser->column;
     token.value = &parser->input[parser->position];
+    token.symbol = COMPONENT_TYPE_INVALID;
     
     size_t start = parser->position;
     while (parser->position < parser->length && is_identifier_char(parser->input[parser->position])) {
@@ -86,20 +102,44 @@ static Token read_identifier(QueryParser* parser) {
     // Helper macro for case-insensitive comparison
     #define MATCH_KEYWORD(str, len) (token.length == len && strncasecmp(token.value, str, len) == 0)
     
-    if (MATCH_KEYWORD("ENTITIES", 8)) {
+    if (MATCH_KEYWORD("APPROX_COUNT_DISTINCT", 21)) {
+        token.type = TOKEN_APPROX_COUNT_DISTINCT;
+    } else if (MATCH_KEYWORD("APPROX_PERCENTILE", 17)) {
+        token.type = TOKEN_APPROX_PERCENTILE;
+    } else if (MATCH_KEYWORD("ENTITIES", 8)) {
         token.type = TOKEN_ENTITIES;
     } else if (MATCH_KEYWORD("HAS_ANY", 7)) {
         token.type = TOKEN_HAS_ANY;
     } else if (MATCH_KEYWORD("NOT_HAS", 7)) {
         token.type = TOKEN_NOT_HAS;
+    } else if (MATCH_KEYWORD("BETWEEN", 7)) {
+        token.type = TOKEN_BETWEEN;
+    } else if (MATCH_KEYWORD("CHANGED", 7)) {
+        token.type = TOKEN_CHANGED;
+    } else if (MATCH_KEYWORD("SAMPLE", 6)) {
+        token.type = TOKEN_SAMPLE;
+    } else if (MATCH_KEYWORD("APPROX", 6)) {
+        token.type = TOKEN_APPROX;
     } else if (MATCH_KEYWORD("SELECT", 6)) {
         token.type = TOKEN_SELECT;
+    } else if (MATCH_KEYWORD("CREATE", 6)) {
+        token.type = TOKEN_CREATE;
+    } else if (MATCH_KEYWORD("WITHIN", 6)) {
+        token.type = TOKEN_WITHIN;
+    } else if (MATCH_KEYWORD("INSIDE", 6)) {
+        token.type = TOKEN_INSIDE;
     } else if (MATCH_KEYWORD("ENTITY", 6)) {
         token.type = TOKEN_ENTITY;
     } else if (MATCH_KEYWORD("COUNT", 5)) {
         token.type = TOKEN_COUNT;
     } else if (MATCH_KEYWORD("WHERE", 5)) {
         token.type = TOKEN_WHERE;
+    } else if (MATCH_KEYWORD("LIMIT", 5)) {
+        token.type = TOKEN_LIMIT;
+    } else if (MATCH_KEYWORD("INDEX", 5)) {
+        token.type = TOKEN_INDEX;
+    } else if (MATCH_KEYWORD("HASH", 4)) {
+        token.type = TOKEN_HASH;
     } else if (MATCH_KEYWORD("SHOW", 4)) {
         token.type = TOKEN_SHOW;
     } else if (MATCH_KEYWORD("HAS", 3)) {
@@ -112,10 +152,18 @@ static Token read_identifier(QueryParser* parser) {
         token.type = TOKEN_OF;
     } else if (MATCH_KEYWORD("OR", 2)) {
         token.type = TOKEN_OR;
+    } else if (MATCH_KEYWORD("ON", 2)) {
+        token.type = TOKEN_ON;
+    } else if (MATCH_KEYWORD("IN", 2)) {
+        token.type = TOKEN_IN;
     }
     
     #undef MATCH_KEYWORD
     
+    if (token.type == TOKEN_IDENTIFIER && parser->symbols) {
+        token.symbol = QuerySymbolTable_lookup(parser->symbols, token.value, token.length);
+    }
+    
     return token;
 }
 
@@ -125,27 +173,43 @@ static Token read_number(QueryParser* parser) {
     token.line = parser->line;
     token.column = parser->column;
     token.value = &parser->input[parser->position];
+    token.symbol = COMPONENT_TYPE_INVALID;
     
     size_t start = parser->position;
+    if (parser->input[parser->position] == '-') {
+        parser->position++;
+        parser->column++;
+    }
     while (parser->position < parser->length && isdigit(parser->input[parser->position])) {
         parser->position++;
         parser->column++;
     }
     
+    // Optional fraction; a dot not followed by a digit is left for the next token
+    if (parser->position + 1 < parser->length && parser->input[parser->position] == '.' &&
+        isdigit(parser->input[parser->position + 1])) {
+        parser->position++;
+        parser->column++;
+        while (parser->position < parser->length && isdigit(parser->input[parser->position])) {
+            parser->position++;
+            parser->column++;
+        }
+    }
+    
     token.length = parser->position - start;
     return token;
 }
 
-Token QueryParser_next_token(QueryParser* parser) {
+static Token lex_token(QueryParser* parser) {
     if (!parser) {
-        Token error = {TOKEN_ERROR, NULL, 0, 0, 0};
+        Token error = {TOKEN_ERROR, NULL, 0, 0, 0, COMPONENT_TYPE_INVALID};
         return error;
     }
     
     skip_whitespace(parser);
     
     if (parser->position >= parser->length) {
-        Token eof = {TOKEN_EOF, NULL, 0, parser->line, parser->column};
+        Token eof = {TOKEN_EOF, NULL, 0, parser->line, parser->column, COMPONENT_TYPE_INVALID};
         return eof;
     }
     
@@ -155,25 +219,44 @@ Token QueryParser_next_token(QueryParser* parser) {
     if (c == '(') {
         parser->position++;
         parser->column++;
-        Token token = {TOKEN_LPAREN, &parser->input[parser->position - 1], 1, parser->line, parser->column - 1};
+        Token token = {TOKEN_LPAREN, &parser->input[parser->position - 1], 1, parser->line, parser->column - 1, COMPONENT_TYPE_INVALID};
         return token;
     }
     if (c == ')') {
         parser->position++;
         parser->column++;
-        Token token = {TOKEN_RPAREN, &parser->input[parser->position - 1], 1, parser->line, parser->column - 1};
+        Token token = {TOKEN_RPAREN, &parser->input[parser->position - 1], 1, parser->line, parser->column - 1, COMPONENT_TYPE_INVALID};
         return token;
     }
     if (c == '.') {
         parser->position++;
         parser->column++;
-        Token token = {TOKEN_DOT, &parser->input[parser->position - 1], 1, parser->line, parser->column - 1};
+        Token token = {TOKEN_DOT, &parser->input[parser->position - 1], 1, parser->line, parser->column - 1, COMPONENT_TYPE_INVALID};
         return token;
     }
     if (c == ',') {
         parser->position++;
         parser->column++;
-        Token token = {TOKEN_COMMA, &parser->input[parser->position - 1], 1, parser->line, parser->column - 1};
+        Token token = {TOKEN_COMMA, &parser->input[parser->position - 1], 1, parser->line, parser->column - 1, COMPONENT_TYPE_INVALID};
+        return token;
+    }
+    
+    // Placeholders: ? (positional) or $N (explicit)
+    if (c == '?') {
+        parser->position++;
+        parser->column++;
+        Token token = {TOKEN_PLACEHOLDER, &parser->input[parser->position - 1], 1, parser->line, parser->column - 1, COMPONENT_TYPE_INVALID};
+        return token;
+    }
+    if (c == '$' && parser->position + 1 < parser->length && isdigit(parser->input[parser->position + 1])) {
+        size_t start = parser->position;
+        parser->position++;
+        parser->column++;
+        while (parser->position < parser->length && isdigit(parser->input[parser->position])) {
+            parser->position++;
+            parser->column++;
+        }
+        Token token = {TOKEN_PLACEHOLDER, &parser->input[start], parser->position - start, parser->line, parser->column - (parser->position - start), COMPONENT_TYPE_INVALID};
         return token;
     }
     
@@ -189,12 +272,12 @@ Token QueryParser_next_token(QueryParser* parser) {
             parser->column++;
         }
         
-        Token token = {TOKEN_OPERATOR, &parser->input[start], parser->position - start, parser->line, parser->column - (parser->position - start)};
+        Token token = {TOKEN_OPERATOR, &parser->input[start], parser->position - start, parser->line, parser->column - (parser->position - start), COMPONENT_TYPE_INVALID};
         return token;
     }
     
-    // Numbers
-    if (isdigit(c)) {
+    // Numbers (optionally negative or fractional)
+    if (isdigit(c) || (c == '-' && parser->position + 1 < parser->length && isdigit(parser->input[parser->position + 1]))) {
         return read_number(parser);
     }
     
@@ -204,15 +287,22 @@ Token QueryParser_next_token(QueryParser* parser) {
     }
     
     // Unknown character
-    Token error = {TOKEN_ERROR, &parser->input[parser->position], 1, parser->line, parser->column};
+    Token error = {TOKEN_ERROR, &parser->input[parser->position], 1, parser->line, parser->column, COMPONENT_TYPE_INVALID};
     parser->position++;
     parser->column++;
     return error;
 }
 
+Token QueryParser_next_token(QueryParser* parser) {
+    QUERY_PHASE_BEGIN(outer, QUERY_PHASE_LEX);
+    Token token = lex_token(parser);
+    QUERY_PHASE_END(outer);
+    return token;
+}
+
 Token QueryParser_peek_token(QueryParser* parser) {
     if (!parser) {
-        Token error = {TOKEN_ERROR, NULL, 0, 0, 0};
+        Token error = {TOKEN_ERROR, NULL, 0, 0, 0, COMPONENT_TYPE_INVALID};
         return error;
     }
     
@@ -229,26 +319,207 @@ Token QueryParser_peek_token(QueryParser* parser) {
     return token;
 }
 
+// Helper: Look at the token after the next one without consuming either
+static Token peek_second_token(QueryParser* parser) {
+    size_t savedPos = parser->position;
+    size_t savedLine = parser->line;
+    size_t savedCol = parser->column;
+    
+    QueryParser_next_token(parser);
+    Token token = QueryParser_next_token(parser);
+    
+    parser->position = savedPos;
+    parser->line = savedLine;
+    parser->column = savedCol;
+    
+    return token;
+}
+
+// Helper: 1-based parameter index for a placeholder token, 0 if invalid.
+// "?" takes the next index after the highest seen so far; "$N" names it directly.
+static size_t placeholder_index(QueryParser* parser, Token token) {
+    size_t index;
+    if (token.length == 1 && token.value[0] == '?') {
+        index = parser->paramCount + 1;
+    } else {
+        index = 0;
+        for (size_t i = 1; i < token.length; i++) {
+            index = index * 10 + (size_t)(token.value[i] - '0');
+            if (index > 65535) return 0;
+        }
+        if (index == 0) return 0;
+    }
+    
+    if (index > parser->paramCount) {
+        parser->paramCount = index;
+    }
+    return index;
+}
+
+size_t QueryParser_get_param_count(QueryParser* parser) {
+    if (!parser) return 0;
+    return parser->paramCount;
+}
+
+static SelectQueryData* new_select_data(void) {
+    SelectQueryData* selectData = (SelectQueryData*)QUERY_ALLOC(sizeof(SelectQueryData));
+    if (!selectData) return NULL;
+    selectData->limit = UINT64_MAX;
+    selectData->limitParam = 0;
+    selectData->sampleMode = SAMPLE_NONE;
+    selectData->sampleSize = 0;
+    return selectData;
+}
+
+// Helper: Parse a whole non-negative number token
+static bool parse_count(Token token, uint64_t* outValue) {
+    if (token.type != TOKEN_NUMBER) return false;
+    
+    *outValue = 0;
+    for (size_t i = 0; i < token.length; i++) {
+        if (!isdigit(token.value[i])) {
+            return false; // Negative or fractional
+        }
+        *outValue = *outValue * 10 + (uint64_t)(token.value[i] - '0');
+    }
+    return true;
+}
+
+// Helper: Parse optional "SAMPLE <number>" (SELECT) or "APPROX [number]" (COUNT),
+// attaching SelectQueryData to ast. Returns false on a malformed clause.
+static bool parse_sample_clause(QueryParser* parser, QueryAST* ast) {
+    Token token = QueryParser_peek_token(parser);
+    TokenType expected = ast->type == AST_SELECT ? TOKEN_SAMPLE : TOKEN_APPROX;
+    if (token.type != expected) {
+        return true;
+    }
+    QueryParser_next_token(parser); // Consume SAMPLE / APPROX
+    
+    SelectQueryData* selectData = new_select_data();
+    if (!selectData) return false;
+    
+    if (expected == TOKEN_SAMPLE) {
+        selectData->sampleMode = SAMPLE_ROWS;
+        if (!parse_count(QueryParser_next_token(parser), &selectData->sampleSize)) {
+            QUERY_FREE(selectData);
+            return false;
+        }
+    } else {
+        selectData->sampleMode = SAMPLE_APPROX;
+        token = QueryParser_peek_token(parser);
+        if (token.type == TOKEN_NUMBER) {
+            QueryParser_next_token(parser);
+            if (!parse_count(token, &selectData->sampleSize)) {
+                QUERY_FREE(selectData);
+                return false;
+            }
+        }
+    }
+    
+    ast->data = selectData;
+    return true;
+}
+
+// Helper: Parse optional "LIMIT <number|placeholder>", attaching SelectQueryData to ast.
+// Returns false on a malformed clause.
+static bool parse_limit_clause(QueryParser* parser, QueryAST* ast) {
+    Token token = QueryParser_peek_token(parser);
+    if (token.type != TOKEN_LIMIT) {
+        return true;
+    }
+    QueryParser_next_token(parser); // Consume LIMIT
+    
+    SelectQueryData* selectData = new_select_data();
+    if (!selectData) return false;
+    
+    token = QueryParser_next_token(parser);
+    if (token.type == TOKEN_NUMBER) {
+        if (!parse_count(token, &selectData->limit)) {
+            QUERY_FREE(selectData);
+            return false;
+        }
+    } else if (token.type == TOKEN_PLACEHOLDER) {
+        selectData->limitParam = placeholder_index(parser, token);
+        if (selectData->limitParam == 0) {
+            QUERY_FREE(selectData);
+            return false;
+        }
+    } else {
+        QUERY_FREE(selectData);
+        return false;
+    }
+    
+    ast->data = selectData;
+    return true;
+}
+
+// Helper: Identifier or keyword, so components such as Limit and fields such as Sprite.index stay addressable
+static bool is_name_token(Token token) {
+    return token.value && token.length > 0 && (isalpha(token.value[0]) || token.value[0] == '_');
+}
+
+// Helper: Component id of a name token; the lexer only resolves plain identifiers
+static ComponentTypeId name_symbol(QueryParser* parser, Token token) {
+    if (token.type == TOKEN_IDENTIFIER || !parser->symbols) {
+        return token.symbol;
+    }
+    return QuerySymbolTable_lookup(parser->symbols, token.value, token.length);
+}
+
+static void free_component_list(ComponentList* list) {
+    if (list->componentNames) {
+        for (size_t i = 0; i < list->count; i++) {
+            QUERY_FREE(list->componentNames[i]);
+        }
+        QUERY_FREE(list->componentNames);
+    }
+    if (list->typeIds) {
+        QUERY_FREE(list->typeIds);
+    }
+    QUERY_FREE(list);
+}
+
+// Helper: grow the name (and resolved id) arrays of list to capacity
+static bool grow_component_list(ComponentList* list, size_t capacity) {
+    char** newNames = (char**)QUERY_REALLOC(list->componentNames, sizeof(char*) * capacity);
+    if (!newNames) return false;
+    list->componentNames = newNames;
+    
+    if (list->typeIds) {
+        ComponentTypeId* newIds = (ComponentTypeId*)QUERY_REALLOC(list->typeIds, sizeof(ComponentTypeId) * capacity);
+        if (!newIds) return false;
+        list->typeIds = newIds;
+    }
+    return true;
+}
+
 // Helper: Parse a component name list (e.g., "Position, Health, Sprite")
 static ComponentList* parse_component_list(QueryParser* parser) {
-    ComponentList* list = (ComponentList*)ALLOC(sizeof(ComponentList));
+    ComponentList* list = (ComponentList*)QUERY_ALLOC(sizeof(ComponentList));
     if (!list) return NULL;
     
     list->componentNames = NULL;
+    list->typeIds = NULL;
     list->count = 0;
     
     // Expect opening parenthesis
     Token token = QueryParser_next_token(parser);
     if (token.type != TOKEN_LPAREN) {
-        FREE(list);
+        QUERY_FREE(list);
         return NULL;
     }
     
-    // Allocate initial array
+    // Allocate initial arrays; ids are kept when the lexer resolves names
     size_t capacity = 4;
-    list->componentNames = (char**)ALLOC(sizeof(char*) * capacity);
-    if (!list->componentNames) {
-        FREE(list);
+    if (parser->symbols) {
+        list->typeIds = (ComponentTypeId*)QUERY_ALLOC(sizeof(ComponentTypeId) * capacity);
+        if (!list->typeIds) {
+            QUERY_FREE(list);
+            return NULL;
+        }
+    }
+    if (!grow_component_list(list, capacity)) {
+        free_component_list(list);
         return NULL;
     }
     
@@ -264,66 +535,46 @@ static ComponentList* parse_component_list(QueryParser* parser) {
         if (!first) {
             // Expect comma between names
             if (token.type != TOKEN_COMMA) {
-                // Free allocated names
-                for (size_t i = 0; i < list->count; i++) {
-                    FREE(list->componentNames[i]);
-                }
-                FREE(list->componentNames);
-                FREE(list);
+                free_component_list(list);
                 return NULL;
             }
             // Consume comma and get next token
             token = QueryParser_next_token(parser);
         }
         
-        if (token.type == TOKEN_IDENTIFIER) {
-            // Grow array if needed
-            if (list->count >= capacity) {
-                capacity *= 2;
-                char** newNames = (char**)ALLOC(sizeof(char*) * capacity);
-                if (!newNames) {
-                    for (size_t i = 0; i < list->count; i++) {
-                        FREE(list->componentNames[i]);
-                    }
-                    FREE(list->componentNames);
-                    FREE(list);
-                    return NULL;
-                }
-                memcpy(newNames, list->componentNames, sizeof(char*) * list->count);
-                FREE(list->componentNames);
-                list->componentNames = newNames;
-            }
-            
-            // Copy component name
-            list->componentNames[list->count] = (char*)ALLOC(token.length + 1);
-            if (!list->componentNames[list->count]) {
-                for (size_t i = 0; i < list->count; i++) {
-                    FREE(list->componentNames[i]);
-                }
-                FREE(list->componentNames);
-                FREE(list);
+        if (!is_name_token(token)) {
+            free_component_list(list);
+            return NULL;
+        }
+        
+        // Grow arrays if needed
+        if (list->count >= capacity) {
+            capacity *= 2;
+            if (!grow_component_list(list, capacity)) {
+                free_component_list(list);
                 return NULL;
             }
-            strncpy(list->componentNames[list->count], token.value, token.length);
-            list->componentNames[list->count][token.length] = '\0';
-            list->count++;
-            
-            first = false;
-        } else {
-            // Free allocated names
-            for (size_t i = 0; i < list->count; i++) {
-                FREE(list->componentNames[i]);
-            }
-            FREE(list->componentNames);
-            FREE(list);
+        }
+        
+        // Copy component name
+        list->componentNames[list->count] = (char*)QUERY_ALLOC(token.length + 1);
+        if (!list->componentNames[list->count]) {
+            free_component_list(list);
             return NULL;
         }
+        strncpy(list->componentNames[list->count], token.value, token.length);
+        list->componentNames[list->count][token.length] = '\0';
+        if (list->typeIds) {
+            list->typeIds[list->count] = name_symbol(parser, token);
+        }
+        list->count++;
+        
+        first = false;
     }
     
     // Reject empty component lists
     if (list->count == 0) {
-        FREE(list->componentNames);
-        FREE(list);
+        free_component_list(list);
         return NULL;
     }
     
@@ -386,7 +637,7 @@ static EntityIdData* parse_entity_id(QueryParser* parser) {
     parser->position = pos;
     parser->column += (pos - parser->position); // Will be recalculated on next token
     
-    EntityIdData* idData = (EntityIdData*)ALLOC(sizeof(EntityIdData));
+    EntityIdData* idData = (EntityIdData*)QUERY_ALLOC(sizeof(EntityIdData));
     if (!idData) return NULL;
     
     idData->high = high;
@@ -395,11 +646,11 @@ static EntityIdData* parse_entity_id(QueryParser* parser) {
     return idData;
 }
 
-// Helper: Parse predicate (has, has_any, not_has)
+// Helper: Parse predicate (has, has_any, not_has, changed)
 static QueryAST* parse_predicate(QueryParser* parser) {
     Token token = QueryParser_next_token(parser);
     
-    QueryAST* predicate = (QueryAST*)ALLOC(sizeof(QueryAST));
+    QueryAST* predicate = (QueryAST*)QUERY_ALLOC(sizeof(QueryAST));
     if (!predicate) return NULL;
     
     predicate->left = NULL;
@@ -411,7 +662,7 @@ static QueryAST* parse_predicate(QueryParser* parser) {
         predicate->type = AST_HAS;
         ComponentList* list = parse_component_list(parser);
         if (!list) {
-            FREE(predicate);
+            QUERY_FREE(predicate);
             return NULL;
         }
         predicate->data = list;
@@ -419,7 +670,7 @@ static QueryAST* parse_predicate(QueryParser* parser) {
         predicate->type = AST_HAS_ANY;
         ComponentList* list = parse_component_list(parser);
         if (!list) {
-            FREE(predicate);
+            QUERY_FREE(predicate);
             return NULL;
         }
         predicate->data = list;
@@ -427,24 +678,335 @@ static QueryAST* parse_predicate(QueryParser* parser) {
         predicate->type = AST_NOT_HAS;
         ComponentList* list = parse_component_list(parser);
         if (!list) {
-            FREE(predicate);
+            QUERY_FREE(predicate);
+            return NULL;
+        }
+        predicate->data = list;
+    } else if (token.type == TOKEN_CHANGED) {
+        predicate->type = AST_CHANGED;
+        ComponentList* list = parse_component_list(parser);
+        if (!list) {
+            QUERY_FREE(predicate);
             return NULL;
         }
         predicate->data = list;
     } else {
-        FREE(predicate);
+        QUERY_FREE(predicate);
         return NULL;
     }
     
     return predicate;
 }
 
-QueryAST* QueryParser_parse(QueryParser* parser) {
+// Helper: Allocate an empty AST node
+static QueryAST* new_node(ASTNodeType type) {
+    QueryAST* node = (QueryAST*)QUERY_ALLOC(sizeof(QueryAST));
+    if (!node) return NULL;
+    
+    node->type = type;
+    node->left = NULL;
+    node->right = NULL;
+    node->children = NULL;
+    node->childCount = 0;
+    node->data = NULL;
+    return node;
+}
+
+// Helper: Copy a token's text into a new string
+static char* copy_token(Token token) {
+    char* text = (char*)QUERY_ALLOC(token.length + 1);
+    if (!text) return NULL;
+    strncpy(text, token.value, token.length);
+    text[token.length] = '\0';
+    return text;
+}
+
+// Helper: Parse "Component.field" into newly allocated names
+static bool parse_field_ref(QueryParser* parser, char** outComponent, char** outField) {
+    Token component = QueryParser_next_token(parser);
+    if (!is_name_token(component)) return false;
+    
+    Token token = QueryParser_next_token(parser);
+    if (token.type != TOKEN_DOT) return false;
+    
+    Token field = QueryParser_next_token(parser);
+    if (!is_name_token(field)) return false;
+    
+    *outComponent = copy_token(component);
+    *outField = copy_token(field);
+    if (!*outComponent || !*outField) {
+        if (*outComponent) QUERY_FREE(*outComponent);
+        if (*outField) QUERY_FREE(*outField);
+        return false;
+    }
+    return true;
+}
+
+// Helper: Parse a numeric literal or placeholder on the right-hand side of a filter
+static bool parse_filter_value(QueryParser* parser, double* outValue, size_t* outParam) {
+    Token token = QueryParser_next_token(parser);
+    
+    if (token.type == TOKEN_PLACEHOLDER) {
+        *outParam = placeholder_index(parser, token);
+        return *outParam != 0;
+    }
+    if (token.type != TOKEN_NUMBER || token.length >= 64) {
+        return false;
+    }
+    
+    // Token text is not terminated; convert a bounded copy
+    char buffer[64];
+    memcpy(buffer, token.value, token.length);
+    buffer[token.length] = '\0';
+    *outValue = strtod(buffer, NULL);
+    return true;
+}
+
+static void free_filter_data(FilterData* filter) {
+    if (filter->componentName) QUERY_FREE(filter->componentName);
+    if (filter->fieldName) QUERY_FREE(filter->fieldName);
+    if (filter->values) QUERY_FREE(filter->values);
+    if (filter->valueParams) QUERY_FREE(filter->valueParams);
+    QUERY_FREE(filter);
+}
+
+// Helper: Parse the "(v1, v2, ...)" list of an IN filter
+static bool parse_value_list(QueryParser* parser, FilterData* filter) {
+    if (QueryParser_next_token(parser).type != TOKEN_LPAREN) return false;
+    
+    size_t capacity = 0;
+    for (;;) {
+        if (filter->valueCount >= capacity) {
+            size_t newCapacity = capacity ? capacity * 2 : 8;
+            double* values = (double*)QUERY_ALLOC(sizeof(double) * newCapacity);
+            size_t* params = (size_t*)QUERY_ALLOC(sizeof(size_t) * newCapacity);
+            if (!values || !params) {
+                if (values) QUERY_FREE(values);
+                if (params) QUERY_FREE(params);
+                return false;
+            }
+            if (filter->values) {
+                memcpy(values, filter->values, sizeof(double) * filter->valueCount);
+                memcpy(params, filter->valueParams, sizeof(size_t) * filter->valueCount);
+                QUERY_FREE(filter->values);
+                QUERY_FREE(filter->valueParams);
+            }
+            filter->values = values;
+            filter->valueParams = params;
+            capacity = newCapacity;
+        }
+        
+        size_t i = filter->valueCount++;
+        filter->values[i] = 0.0;
+        filter->valueParams[i] = 0;
+        if (!parse_filter_value(parser, &filter->values[i], &filter->valueParams[i])) return false;
+        
+        Token token = QueryParser_next_token(parser);
+        if (token.type == TOKEN_RPAREN) return true;
+        if (token.type != TOKEN_COMMA) return false;
+    }
+}
+
+// Helper: Parse a field filter (e.g., "Position.x > 100", "Health.hp BETWEEN 10 AND 50")
+static QueryAST* parse_filter(QueryParser* parser) {
+    FilterData* filter = (FilterData*)QUERY_ALLOC(sizeof(FilterData));
+    if (!filter) return NULL;
+    memset(filter, 0, sizeof(FilterData));
+    
+    if (!parse_field_ref(parser, &filter->componentName, &filter->fieldName)) {
+        QUERY_FREE(filter);
+        return NULL;
+    }
+    
+    Token token = QueryParser_next_token(parser);
+    bool ok;
+    if (token.type == TOKEN_BETWEEN) {
+        filter->op = FILTER_OP_BETWEEN;
+        ok = parse_filter_value(parser, &filter->value, &filter->valueParam) &&
+             QueryParser_next_token(parser).type == TOKEN_AND &&
+             parse_filter_value(parser, &filter->upper, &filter->upperParam);
+    } else if (token.type == TOKEN_IN) {
+        filter->op = FILTER_OP_IN;
+        ok = parse_value_list(parser, filter);
+    } else if (token.type == TOKEN_OPERATOR) {
+        ok = true;
+        if (token.length == 1 && token.value[0] == '<') {
+            filter->op = FILTER_OP_LT;
+        } else if (token.length == 1 && token.value[0] == '>') {
+            filter->op = FILTER_OP_GT;
+        } else if (token.value[0] == '=') {
+            filter->op = FILTER_OP_EQ;  // = or ==
+        } else if (token.length == 2 && token.value[0] == '<') {
+            filter->op = FILTER_OP_LE;
+        } else if (token.length == 2 && token.value[0] == '>') {
+            filter->op = FILTER_OP_GE;
+        } else if (token.length == 2 && token.value[0] == '!') {
+            filter->op = FILTER_OP_NE;
+        } else {
+            ok = false;
+        }
+        ok = ok && parse_filter_value(parser, &filter->value, &filter->valueParam);
+    } else {
+        ok = false;
+    }
+    
+    QueryAST* node = ok ? new_node(AST_FILTER) : NULL;
+    if (!node) {
+        free_filter_data(filter);
+        return NULL;
+    }
+    node->data = filter;
+    return node;
+}
+
+// Helper: Parse WITHIN(Component, x, y, radius) or INSIDE(Component, x0, y0, x1, y1)
+static QueryAST* parse_spatial(QueryParser* parser) {
+    Token token = QueryParser_next_token(parser);
+    ASTNodeType type = token.type == TOKEN_WITHIN ? AST_WITHIN : AST_INSIDE;
+    
+    SpatialQueryData* spatial = (SpatialQueryData*)QUERY_ALLOC(sizeof(SpatialQueryData));
+    if (!spatial) return NULL;
+    memset(spatial, 0, sizeof(SpatialQueryData));
+    
+    bool ok = QueryParser_next_token(parser).type == TOKEN_LPAREN;
+    Token component = QueryParser_next_token(parser);
+    ok = ok && is_name_token(component);
+    
+    size_t expected = type == AST_WITHIN ? 3 : 4;
+    for (size_t i = 0; i < expected && ok; i++) {
+        ok = QueryParser_next_token(parser).type == TOKEN_COMMA &&
+             parse_filter_value(parser, &spatial->args[i], &spatial->argParams[i]);
+    }
+    ok = ok && QueryParser_next_token(parser).type == TOKEN_RPAREN;
+    
+    spatial->argCount = expected;
+    spatial->typeResolved = parser->symbols != NULL;
+    spatial->typeId = name_symbol(parser, component);
+    spatial->componentName = ok ? copy_token(component) : NULL;
+    QueryAST* node = spatial->componentName ? new_node(type) : NULL;
+    if (!node) {
+        if (spatial->componentName) QUERY_FREE(spatial->componentName);
+        QUERY_FREE(spatial);
+        return NULL;
+    }
+    node->data = spatial;
+    return node;
+}
+
+static QueryAST* parse_condition(QueryParser* parser);
+
+// Helper: Parse one operand of AND/OR: a predicate, a filter or a parenthesized condition
+static QueryAST* parse_primary(QueryParser* parser) {
+    Token token = QueryParser_peek_token(parser);
+    
+    if (token.type == TOKEN_LPAREN) {
+        if (parser->depth >= QUERY_PARSER_MAX_DEPTH) {
+            return NULL;
+        }
+        QueryParser_next_token(parser); // Consume (
+        parser->depth++;
+        QueryAST* inner = parse_condition(parser);
+        parser->depth--;
+        if (!inner) return NULL;
+        
+        token = QueryParser_next_token(parser);
+        if (token.type != TOKEN_RPAREN) {
+            QueryAST_destroy(inner);
+            return NULL;
+        }
+        return inner;
+    }
+    
+    // A keyword followed by "." names a component, as in Limit.value > 3
+    if (token.type == TOKEN_IDENTIFIER || (is_name_token(token) && peek_second_token(parser).type == TOKEN_DOT)) {
+        return parse_filter(parser);
+    }
+    
+    if (token.type == TOKEN_WITHIN || token.type == TOKEN_INSIDE) {
+        return parse_spatial(parser);
+    }
+    
+    return parse_predicate(parser);
+}
+
+// Helper: Parse a chain of operands joined by one connective (left-associative)
+static QueryAST* parse_chain(QueryParser* parser, TokenType connective, ASTNodeType nodeType,
+                             QueryAST* (*parse_operand)(QueryParser*)) {
+    QueryAST* left = parse_operand(parser);
+    
+    while (left && QueryParser_peek_token(parser).type == connective) {
+        QueryParser_next_token(parser); // Consume connective
+        
+        QueryAST* right = parse_operand(parser);
+        QueryAST* node = right ? new_node(nodeType) : NULL;
+        if (!node) {
+            if (right) QueryAST_destroy(right);
+            QueryAST_destroy(left);
+            return NULL;
+        }
+        node->left = left;
+        node->right = right;
+        left = node;
+    }
+    
+    return left;
+}
+
+// Helper: AND binds tighter than OR
+static QueryAST* parse_conjunction(QueryParser* parser) {
+    return parse_chain(parser, TOKEN_AND, AST_AND, parse_primary);
+}
+
+// Helper: Parse a WHERE condition
+static QueryAST* parse_condition(QueryParser* parser) {
+    return parse_chain(parser, TOKEN_OR, AST_OR, parse_conjunction);
+}
+
+// Helper: Parse the arguments of APPROX_COUNT_DISTINCT(Component.field) or
+// APPROX_PERCENTILE(Component.field, p1, ...), each p a fraction in [0, 1]
+static AggregateQueryData* parse_aggregate(QueryParser* parser, TokenType function) {
+    if (QueryParser_next_token(parser).type != TOKEN_LPAREN) return NULL;
+    
+    AggregateQueryData* aggregate = (AggregateQueryData*)QUERY_ALLOC(sizeof(AggregateQueryData));
+    if (!aggregate) return NULL;
+    memset(aggregate, 0, sizeof(AggregateQueryData));
+    aggregate->kind = function == TOKEN_APPROX_PERCENTILE ? AGGREGATE_PERCENTILE : AGGREGATE_COUNT_DISTINCT;
+    
+    if (!parse_field_ref(parser, &aggregate->componentName, &aggregate->fieldName)) {
+        QUERY_FREE(aggregate);
+        return NULL;
+    }
+    
+    bool ok = true;
+    Token token = QueryParser_next_token(parser);
+    while (ok && token.type == TOKEN_COMMA && aggregate->kind == AGGREGATE_PERCENTILE) {
+        double p = 0.0;
+        size_t param = 0;
+        ok = aggregate->percentileCount < AGGREGATE_MAX_PERCENTILES &&
+             parse_filter_value(parser, &p, &param) && param == 0 && p >= 0.0 && p <= 1.0;
+        if (ok) {
+            aggregate->percentiles[aggregate->percentileCount++] = p;
+            token = QueryParser_next_token(parser);
+        }
+    }
+    
+    // A percentile needs at least one p; a distinct count takes none
+    if (!ok || token.type != TOKEN_RPAREN ||
+        (aggregate->kind == AGGREGATE_PERCENTILE && aggregate->percentileCount == 0)) {
+        QUERY_FREE(aggregate->componentName);
+        QUERY_FREE(aggregate->fieldName);
+        QUERY_FREE(aggregate);
+        return NULL;
+    }
+    return aggregate;
+}
+
+static QueryAST* parse_query(QueryParser* parser) {
     if (!parser) return NULL;
     
     Token token = QueryParser_next_token(parser);
     
-    QueryAST* ast = (QueryAST*)ALLOC(sizeof(QueryAST));
+    QueryAST* ast = (QueryAST*)QUERY_ALLOC(sizeof(QueryAST));
     if (!ast) return NULL;
     
     ast->left = NULL;
@@ -457,10 +1019,34 @@ QueryAST* QueryParser_parse(QueryParser* parser) {
     if (token.type == TOKEN_SELECT) {
         ast->type = AST_SELECT;
         
-        // Expect "entities"
+        // Expect "entities" or an aggregate
         token = QueryParser_next_token(parser);
+        if (token.type == TOKEN_APPROX_COUNT_DISTINCT || token.type == TOKEN_APPROX_PERCENTILE) {
+            ast->type = AST_AGGREGATE;
+            ast->data = parse_aggregate(parser, token.type);
+            if (!ast->data) {
+                QUERY_FREE(ast);
+                return NULL;
+            }
+            
+            token = QueryParser_peek_token(parser);
+            if (token.type == TOKEN_WHERE) {
+                QueryParser_next_token(parser); // Consume WHERE
+                ast->left = parse_condition(parser);
+                if (!ast->left) {
+                    QueryAST_destroy(ast);
+                    return NULL;
+                }
+            }
+            
+            if (QueryParser_next_token(parser).type != TOKEN_EOF) {
+                QueryAST_destroy(ast);
+                return NULL;
+            }
+            return ast;
+        }
         if (token.type != TOKEN_ENTITIES) {
-            FREE(ast);
+            QUERY_FREE(ast);
             return NULL;
         }
         
@@ -469,15 +1055,21 @@ QueryAST* QueryParser_parse(QueryParser* parser) {
         if (token.type == TOKEN_WHERE) {
             QueryParser_next_token(parser); // Consume WHERE
             
-            QueryAST* predicate = parse_predicate(parser);
+            QueryAST* predicate = parse_condition(parser);
             if (!predicate) {
-                FREE(ast);
+                QUERY_FREE(ast);
                 return NULL;
             }
             
             ast->left = predicate;
         }
         
+        // Optional SAMPLE or LIMIT clause
+        if (!parse_sample_clause(parser, ast) || (!ast->data && !parse_limit_clause(parser, ast))) {
+            QueryAST_destroy(ast);
+            return NULL;
+        }
+        
         // Should be EOF now
         token = QueryParser_next_token(parser);
         if (token.type != TOKEN_EOF) {
@@ -491,7 +1083,7 @@ QueryAST* QueryParser_parse(QueryParser* parser) {
         // Expect "entities"
         token = QueryParser_next_token(parser);
         if (token.type != TOKEN_ENTITIES) {
-            FREE(ast);
+            QUERY_FREE(ast);
             return NULL;
         }
         
@@ -500,15 +1092,21 @@ QueryAST* QueryParser_parse(QueryParser* parser) {
         if (token.type == TOKEN_WHERE) {
             QueryParser_next_token(parser); // Consume WHERE
             
-            QueryAST* predicate = parse_predicate(parser);
+            QueryAST* predicate = parse_condition(parser);
             if (!predicate) {
-                FREE(ast);
+                QUERY_FREE(ast);
                 return NULL;
             }
             
             ast->left = predicate;
         }
         
+        // Optional APPROX clause
+        if (!parse_sample_clause(parser, ast)) {
+            QueryAST_destroy(ast);
+            return NULL;
+        }
+        
         // Should be EOF now
         token = QueryParser_next_token(parser);
         if (token.type != TOKEN_EOF) {
@@ -522,59 +1120,70 @@ QueryAST* QueryParser_parse(QueryParser* parser) {
         // Parse component name or ALL
         token = QueryParser_next_token(parser);
         
-        ShowQueryData* showData = (ShowQueryData*)ALLOC(sizeof(ShowQueryData));
+        ShowQueryData* showData = (ShowQueryData*)QUERY_ALLOC(sizeof(ShowQueryData));
         if (!showData) {
-            FREE(ast);
+            QUERY_FREE(ast);
             return NULL;
         }
         showData->componentName = NULL;
         showData->entityId = NULL;
+        showData->entityParam = 0;
+        showData->typeResolved = false;
+        showData->typeId = COMPONENT_TYPE_INVALID;
         
         if (token.type == TOKEN_ALL) {
             // SHOW ALL OF entity <id>
             showData->componentName = NULL; // NULL means ALL
             
-        } else if (token.type == TOKEN_IDENTIFIER) {
+        } else if (is_name_token(token)) {
             // SHOW ComponentName OF entity <id>
-            showData->componentName = (char*)ALLOC(token.length + 1);
+            showData->componentName = (char*)QUERY_ALLOC(token.length + 1);
             if (!showData->componentName) {
-                FREE(showData);
-                FREE(ast);
+                QUERY_FREE(showData);
+                QUERY_FREE(ast);
                 return NULL;
             }
             strncpy(showData->componentName, token.value, token.length);
             showData->componentName[token.length] = '\0';
+            showData->typeResolved = parser->symbols != NULL;
+            showData->typeId = name_symbol(parser, token);
             
         } else {
-            FREE(showData);
-            FREE(ast);
+            QUERY_FREE(showData);
+            QUERY_FREE(ast);
             return NULL;
         }
         
         // Expect "OF"
         token = QueryParser_next_token(parser);
         if (token.type != TOKEN_OF) {
-            if (showData->componentName) FREE(showData->componentName);
-            FREE(showData);
-            FREE(ast);
+            if (showData->componentName) QUERY_FREE(showData->componentName);
+            QUERY_FREE(showData);
+            QUERY_FREE(ast);
             return NULL;
         }
         
         // Expect "entity"
         token = QueryParser_next_token(parser);
         if (token.type != TOKEN_ENTITY) {
-            if (showData->componentName) FREE(showData->componentName);
-            FREE(showData);
-            FREE(ast);
+            if (showData->componentName) QUERY_FREE(showData->componentName);
+            QUERY_FREE(showData);
+            QUERY_FREE(ast);
             return NULL;
         }
         
-        // Parse entity ID
-        showData->entityId = parse_entity_id(parser);
-        if (!showData->entityId) {
-            if (showData->componentName) FREE(showData->componentName);
-            FREE(showData);
-            FREE(ast);
+        // Parse entity ID or placeholder
+        token = QueryParser_peek_token(parser);
+        if (token.type == TOKEN_PLACEHOLDER) {
+            QueryParser_next_token(parser);
+            showData->entityParam = placeholder_index(parser, token);
+        } else {
+            showData->entityId = parse_entity_id(parser);
+        }
+        if (!showData->entityId && showData->entityParam == 0) {
+            if (showData->componentName) QUERY_FREE(showData->componentName);
+            QUERY_FREE(showData);
+            QUERY_FREE(ast);
             return NULL;
         }
         
@@ -587,14 +1196,55 @@ QueryAST* QueryParser_parse(QueryParser* parser) {
             return NULL;
         }
         
+    } else if (token.type == TOKEN_CREATE) {
+        ast->type = AST_CREATE_INDEX;
+        
+        // CREATE [HASH] INDEX ON Component.field
+        token = QueryParser_next_token(parser);
+        bool hash = token.type == TOKEN_HASH;
+        if (hash) {
+            token = QueryParser_next_token(parser);
+        }
+        if (token.type != TOKEN_INDEX || QueryParser_next_token(parser).type != TOKEN_ON) {
+            QUERY_FREE(ast);
+            return NULL;
+        }
+        
+        IndexQueryData* indexData = (IndexQueryData*)QUERY_ALLOC(sizeof(IndexQueryData));
+        if (!indexData) {
+            QUERY_FREE(ast);
+            return NULL;
+        }
+        indexData->hash = hash;
+        if (!parse_field_ref(parser, &indexData->componentName, &indexData->fieldName)) {
+            QUERY_FREE(indexData);
+            QUERY_FREE(ast);
+            return NULL;
+        }
+        ast->data = indexData;
+        
+        // Should be EOF now
+        token = QueryParser_next_token(parser);
+        if (token.type != TOKEN_EOF) {
+            QueryAST_destroy(ast);
+            return NULL;
+        }
+        
     } else {
-        FREE(ast);
+        QUERY_FREE(ast);
         return NULL;
     }
     
     return ast;
 }
 
+QueryAST* QueryParser_parse(QueryParser* parser) {
+    QUERY_PHASE_BEGIN(outer, QUERY_PHASE_PARSE);
+    QueryAST* ast = parse_query(parser);
+    QUERY_PHASE_END(outer);
+    return ast;
+}
+
 void QueryAST_destroy(QueryAST* ast) {
     if (!ast) return;
     
@@ -603,7 +1253,7 @@ void QueryAST_destroy(QueryAST* ast) {
         for (size_t i = 0; i < ast->childCount; i++) {
             QueryAST_destroy(&ast->children[i]);
         }
-        FREE(ast->children);
+        QUERY_FREE(ast->children);
     }
     
     // Recursively destroy left and right subtrees
@@ -616,33 +1266,42 @@ void QueryAST_destroy(QueryAST* ast) {
     
     // Free data based on AST type
     if (ast->data) {
-        if (ast->type == AST_HAS || ast->type == AST_HAS_ANY || ast->type == AST_NOT_HAS) {
-            // ComponentList
-            ComponentList* list = (ComponentList*)ast->data;
-            if (list->componentNames) {
-                for (size_t i = 0; i < list->count; i++) {
-                    FREE(list->componentNames[i]);
-                }
-                FREE(list->componentNames);
-            }
-            FREE(list);
+        if (ast->type == AST_HAS || ast->type == AST_HAS_ANY || ast->type == AST_NOT_HAS ||
+            ast->type == AST_CHANGED) {
+            free_component_list((ComponentList*)ast->data);
         } else if (ast->type == AST_SHOW) {
             // ShowQueryData
             ShowQueryData* showData = (ShowQueryData*)ast->data;
             if (showData->componentName) {
-                FREE(showData->componentName);
+                QUERY_FREE(showData->componentName);
             }
             if (showData->entityId) {
-                FREE(showData->entityId);
+                QUERY_FREE(showData->entityId);
             }
-            FREE(showData);
+            QUERY_FREE(showData);
+        } else if (ast->type == AST_FILTER) {
+            free_filter_data((FilterData*)ast->data);
+        } else if (ast->type == AST_CREATE_INDEX) {
+            IndexQueryData* indexData = (IndexQueryData*)ast->data;
+            QUERY_FREE(indexData->componentName);
+            QUERY_FREE(indexData->fieldName);
+            QUERY_FREE(indexData);
+        } else if (ast->type == AST_WITHIN || ast->type == AST_INSIDE) {
+            SpatialQueryData* spatial = (SpatialQueryData*)ast->data;
+            QUERY_FREE(spatial->componentName);
+            QUERY_FREE(spatial);
+        } else if (ast->type == AST_AGGREGATE) {
+            AggregateQueryData* aggregate = (AggregateQueryData*)ast->data;
+            QUERY_FREE(aggregate->componentName);
+            QUERY_FREE(aggregate->fieldName);
+            QUERY_FREE(aggregate);
         } else {
             // Generic data (shouldn't happen, but be safe)
-            FREE(ast->data);
+            QUERY_FREE(ast->data);
         }
     }
     
-    FREE(ast);
+    QUERY_FREE(ast);
 }
 
 // Accessor functions for AST
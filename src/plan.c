@@ -0,0 +1,422 @@
+#include "gramarye_query/plan.h"
+#include "gramarye_query/parser.h"
+#include "gramarye_query/executor.h"
+#include "gramarye_query/catalog.h"
+#include "gramarye_query/query.h"
+#include "gramarye_ecs/ecs.h"
+#include "gramarye_ecs/entity.h"
+#include "gramarye_ecs/component.h"
+#include "gramarye_query/allocator.h"
+#include "internal.h"
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// What a parameter slot feeds, decided at prepare time
+typedef enum {
+    PLAN_PARAM_UNUSED,
+    PLAN_PARAM_U64,
+    PLAN_PARAM_F64,
+    PLAN_PARAM_ENTITY
+} PlanParamKind;
+
+typedef struct {
+    PlanParamKind kind;
+    bool bound;
+    uint64_t u64;
+    double f64;
+    EntityId entity;
+} PlanParam;
+
+struct QueryPlan {
+    ECS* ecs;
+    QueryCatalog* catalog;      // Field schema and indexes, may be NULL
+    ASTNodeType queryType;
+    
+    // SELECT / COUNT
+    bool hasPredicate;
+    ASTNodeType predicateType;
+    ComponentTypeId* typeIds;
+    size_t typeCount;
+    uint64_t limit;
+    size_t limitParam;          // 1-based, 0 for a literal limit
+    SampleMode sampleMode;      // SAMPLE / APPROX clause, SAMPLE_NONE if absent
+    uint64_t sampleSize;
+    QueryAST* ast;              // Kept for filter / AND / OR conditions, samples and aggregates
+    double* paramValues;        // Filter values handed to the executor
+    QueryCondition* condition;  // ast's WHERE clause compiled, NULL if it has none
+    QueryField field;           // Aggregated field
+    bool compiled;              // condition and field match schemaVersion
+    uint64_t schemaVersion;     // Catalog schema they were compiled against
+    
+    // SHOW
+    bool showAll;
+    ComponentTypeId showType;
+    EntityId entity;
+    size_t entityParam;         // 1-based, 0 for a literal id
+    
+    PlanParam* params;          // params[index - 1]
+    size_t paramCount;
+};
+
+// Claim a parameter slot for kind; a slot used for two kinds is a prepare error
+static bool claim_param(QueryPlan* plan, size_t index, PlanParamKind kind) {
+    if (index == 0 || index > plan->paramCount) return false;
+    
+    PlanParam* param = &plan->params[index - 1];
+    if (param->kind != PLAN_PARAM_UNUSED && param->kind != kind) {
+        return false;
+    }
+    param->kind = kind;
+    return true;
+}
+
+// Claim every placeholder used by a filter in the condition
+static bool claim_filter_params(QueryPlan* plan, QueryAST* node) {
+    if (!node) return true;
+    
+    if (QueryAST_get_type(node) == AST_FILTER) {
+        FilterData* filter = (FilterData*)QueryAST_get_data(node);
+        if (filter->valueParam && !claim_param(plan, filter->valueParam, PLAN_PARAM_F64)) return false;
+        if (filter->upperParam && !claim_param(plan, filter->upperParam, PLAN_PARAM_F64)) return false;
+        for (size_t i = 0; i < filter->valueCount; i++) {
+            if (filter->valueParams[i] && !claim_param(plan, filter->valueParams[i], PLAN_PARAM_F64)) return false;
+        }
+        return true;
+    }
+    if (QueryAST_get_type(node) == AST_WITHIN || QueryAST_get_type(node) == AST_INSIDE) {
+        SpatialQueryData* spatial = (SpatialQueryData*)QueryAST_get_data(node);
+        for (size_t i = 0; i < spatial->argCount; i++) {
+            if (spatial->argParams[i] && !claim_param(plan, spatial->argParams[i], PLAN_PARAM_F64)) return false;
+        }
+        return true;
+    }
+    return claim_filter_params(plan, QueryAST_get_left(node)) &&
+           claim_filter_params(plan, QueryAST_get_right(node));
+}
+
+// Resolve the kept AST: the aggregated field, and the WHERE clause's names,
+// fields and indexes. Done at prepare time and again only when the catalog's
+// schema has moved since, so executions resolve no names.
+static QueryStatus compile_condition(QueryPlan* plan) {
+    uint64_t version = QueryCatalog_schema_version(plan->catalog);
+    if (plan->compiled && plan->schemaVersion == version) {
+        return QUERY_SUCCESS;
+    }
+    
+    QueryCondition_destroy(plan->condition);
+    plan->condition = NULL;
+    plan->compiled = false;
+    if (plan->queryType == AST_AGGREGATE) {
+        AggregateQueryData* aggregate = (AggregateQueryData*)QueryAST_get_data(plan->ast);
+        if (!plan->catalog ||
+            !QueryCatalog_find_field(plan->catalog, aggregate->componentName, aggregate->fieldName, &plan->field)) {
+            return QUERY_ERROR_EXECUTION;
+        }
+    }
+    
+    QueryAST* where = QueryAST_get_left(plan->ast);
+    if (where) {
+        QueryStatus status;
+        plan->condition = QueryCondition_compile(plan->ecs, plan->catalog, where, &status);
+        if (!plan->condition) return status;
+    }
+    plan->compiled = true;
+    plan->schemaVersion = version;
+    return QUERY_SUCCESS;
+}
+
+// Keep ast for execution, with room for the condition's bound filter values.
+// A condition that does not compile yet (a field registered later) is
+// compiled again, and its error reported, when the plan is executed.
+static bool keep_ast(QueryPlan* plan, QueryAST* ast) {
+    if (!claim_filter_params(plan, QueryAST_get_left(ast))) return false;
+    if (plan->paramCount > 0) {
+        plan->paramValues = (double*)QUERY_ALLOC(sizeof(double) * plan->paramCount);
+        if (!plan->paramValues) return false;
+    }
+    plan->ast = ast;
+    compile_condition(plan);
+    return true;
+}
+
+static bool compile_entity_query(QueryPlan* plan, QueryAST* ast) {
+    QueryAST* predicate = QueryAST_get_left(ast);
+    
+    SelectQueryData* selectData = plan->queryType == AST_SELECT ? (SelectQueryData*)QueryAST_get_data(ast) : NULL;
+    plan->limit = QUERY_LIMIT_NONE;
+    if (selectData) {
+        plan->limit = selectData->limit;
+        plan->limitParam = selectData->limitParam;
+        if (plan->limitParam && !claim_param(plan, plan->limitParam, PLAN_PARAM_U64)) {
+            return false;
+        }
+    }
+    
+    plan->sampleMode = QueryExecutor_get_sampling(ast, &plan->sampleSize);
+    if ((predicate && !QueryExecutor_is_component_predicate(predicate)) || plan->sampleMode != SAMPLE_NONE) {
+        // Conditions and samples are evaluated from the AST with the bound filter values
+        return keep_ast(plan, ast);
+    }
+    
+    ComponentList* componentList = predicate ? (ComponentList*)QueryAST_get_data(predicate) : NULL;
+    if (!componentList || componentList->count == 0) {
+        return true; // Empty result, like the executor
+    }
+    
+    plan->hasPredicate = true;
+    plan->predicateType = QueryAST_get_type(predicate);
+    plan->typeIds = (ComponentTypeId*)QUERY_ALLOC(sizeof(ComponentTypeId) * componentList->count);
+    if (!plan->typeIds) return false;
+    
+    // Same resolution as QueryExecutor_execute so results come back in the same order
+    plan->typeCount = QueryExecutor_resolve_components(plan->ecs, componentList, plan->typeIds);
+    return true;
+}
+
+static bool compile_aggregate(QueryPlan* plan, QueryAST* ast) {
+    plan->limit = QUERY_LIMIT_NONE;
+    return keep_ast(plan, ast);
+}
+
+static bool compile_show(QueryPlan* plan, QueryAST* ast) {
+    ShowQueryData* showData = (ShowQueryData*)QueryAST_get_data(ast);
+    if (!showData) return false;
+    
+    plan->showAll = showData->componentName == NULL;
+    plan->showType = COMPONENT_TYPE_INVALID;
+    if (!plan->showAll) {
+        plan->showType = showData->typeResolved ? showData->typeId :
+                         query_type_by_name(plan->ecs, showData->componentName);
+    }
+    
+    if (showData->entityId) {
+        plan->entity.high = showData->entityId->high;
+        plan->entity.low = showData->entityId->low;
+        return true;
+    }
+    
+    plan->entityParam = showData->entityParam;
+    return claim_param(plan, plan->entityParam, PLAN_PARAM_ENTITY);
+}
+
+QueryPlan* QueryPlan_prepare(ECS* ecs, const char* queryString) {
+    return QueryPlan_prepare_with_catalog(ecs, NULL, queryString);
+}
+
+QueryPlan* QueryPlan_prepare_with_catalog(ECS* ecs, QueryCatalog* catalog, const char* queryString) {
+    return QueryPlan_prepare_with_symbols(ecs, catalog, NULL, queryString);
+}
+
+QueryPlan* QueryPlan_prepare_with_symbols(ECS* ecs, QueryCatalog* catalog, QuerySymbolTable* symbols,
+                                          const char* queryString) {
+    if (!ecs || !queryString) return NULL;
+    
+    QueryParser* parser = QueryParser_new_with_symbols(queryString, symbols);
+    if (!parser) return NULL;
+    
+    QueryAST* ast = QueryParser_parse(parser);
+    if (!ast) {
+        QueryParser_destroy(parser);
+        return NULL;
+    }
+    
+    QueryPlan* plan = (QueryPlan*)QUERY_ALLOC(sizeof(QueryPlan));
+    if (!plan) {
+        QueryAST_destroy(ast);
+        QueryParser_destroy(parser);
+        return NULL;
+    }
+    memset(plan, 0, sizeof(QueryPlan));
+    plan->ecs = ecs;
+    plan->catalog = catalog;
+    plan->queryType = QueryAST_get_type(ast);
+    plan->paramCount = QueryParser_get_param_count(parser);
+    
+    bool ok = true;
+    if (plan->paramCount > 0) {
+        plan->params = (PlanParam*)QUERY_ALLOC(sizeof(PlanParam) * plan->paramCount);
+        if (plan->params) {
+            memset(plan->params, 0, sizeof(PlanParam) * plan->paramCount);
+        } else {
+            ok = false;
+        }
+    }
+    
+    if (ok) {
+        if (plan->queryType == AST_SELECT || plan->queryType == AST_COUNT) {
+            ok = compile_entity_query(plan, ast);
+        } else if (plan->queryType == AST_SHOW) {
+            ok = compile_show(plan, ast);
+        } else if (plan->queryType == AST_AGGREGATE) {
+            ok = compile_aggregate(plan, ast);
+        } else {
+            ok = false;
+        }
+    }
+    
+    if (plan->ast != ast) {
+        QueryAST_destroy(ast);
+    }
+    QueryParser_destroy(parser);
+    
+    if (!ok) {
+        QueryPlan_destroy(plan);
+        return NULL;
+    }
+    return plan;
+}
+
+void QueryPlan_destroy(QueryPlan* plan) {
+    if (!plan) return;
+    
+    if (plan->typeIds) {
+        QUERY_FREE(plan->typeIds);
+    }
+    if (plan->params) {
+        QUERY_FREE(plan->params);
+    }
+    if (plan->paramValues) {
+        QUERY_FREE(plan->paramValues);
+    }
+    QueryCondition_destroy(plan->condition);
+    if (plan->ast) {
+        QueryAST_destroy(plan->ast);
+    }
+    QUERY_FREE(plan);
+}
+
+size_t QueryPlan_param_count(const QueryPlan* plan) {
+    return plan ? plan->paramCount : 0;
+}
+
+static PlanParam* get_param(QueryPlan* plan, size_t index) {
+    if (!plan || index == 0 || index > plan->paramCount) return NULL;
+    return &plan->params[index - 1];
+}
+
+QueryStatus QueryPlan_bind_u64(QueryPlan* plan, size_t index, uint64_t value) {
+    PlanParam* param = get_param(plan, index);
+    if (!param || param->kind == PLAN_PARAM_ENTITY) {
+        return QUERY_ERROR_INVALID_SYNTAX;
+    }
+    
+    param->u64 = value;
+    param->f64 = (double)value;
+    param->bound = true;
+    return QUERY_SUCCESS;
+}
+
+QueryStatus QueryPlan_bind_f64(QueryPlan* plan, size_t index, double value) {
+    PlanParam* param = get_param(plan, index);
+    if (!param || param->kind == PLAN_PARAM_ENTITY) {
+        return QUERY_ERROR_INVALID_SYNTAX;
+    }
+    
+    if (param->kind == PLAN_PARAM_F64) {
+        param->f64 = value;
+        param->bound = true;
+        return QUERY_SUCCESS;
+    }
+    
+    // Integer slots only take whole, non-negative values
+    if (!(value >= 0.0) || value >= 18446744073709551616.0 || value != (double)(uint64_t)value) {
+        return QUERY_ERROR_INVALID_SYNTAX;
+    }
+    
+    param->u64 = (uint64_t)value;
+    param->f64 = value;
+    param->bound = true;
+    return QUERY_SUCCESS;
+}
+
+QueryStatus QueryPlan_bind_entity(QueryPlan* plan, size_t index, EntityId entity) {
+    PlanParam* param = get_param(plan, index);
+    if (!param || param->kind == PLAN_PARAM_U64 || param->kind == PLAN_PARAM_F64) {
+        return QUERY_ERROR_INVALID_SYNTAX;
+    }
+    
+    param->entity = entity;
+    param->bound = true;
+    return QUERY_SUCCESS;
+}
+
+void QueryPlan_clear_bindings(QueryPlan* plan) {
+    if (!plan) return;
+    
+    for (size_t i = 0; i < plan->paramCount; i++) {
+        plan->params[i].bound = false;
+    }
+}
+
+static QueryStatus execute_plan(QueryPlan* plan, QueryEngineResult* outResult) {
+    // Every parameter the query reads must be bound
+    for (size_t i = 0; i < plan->paramCount; i++) {
+        if (plan->params[i].kind != PLAN_PARAM_UNUSED && !plan->params[i].bound) {
+            return QUERY_ERROR_INVALID_SYNTAX;
+        }
+    }
+    
+    if (plan->queryType == AST_SHOW) {
+        EntityId entity = plan->entity;
+        if (plan->entityParam) {
+            entity = plan->params[plan->entityParam - 1].entity;
+        }
+        return QueryExecutor_show(plan->ecs, entity, plan->showAll, plan->showType, outResult);
+    }
+    
+    uint64_t limit = plan->limit;
+    if (plan->limitParam) {
+        limit = plan->params[plan->limitParam - 1].u64;
+    }
+    
+    if (plan->ast) {
+        QueryStatus status = compile_condition(plan);
+        if (status != QUERY_SUCCESS) {
+            return status;
+        }
+        for (size_t i = 0; i < plan->paramCount; i++) {
+            plan->paramValues[i] = plan->params[i].f64;
+        }
+        if (plan->queryType == AST_AGGREGATE) {
+            return QueryExecutor_execute_compiled_aggregate(plan->ecs, plan->ast, &plan->field, plan->condition,
+                                                            plan->paramValues, plan->paramCount, outResult);
+        }
+        if (!plan->condition) {
+            // SAMPLE / APPROX without WHERE: an empty sample
+            return QueryExecutor_execute_sampled(plan->ecs, plan->catalog, plan->queryType, NULL, NULL, 0,
+                                                 plan->sampleMode, plan->sampleSize, outResult);
+        }
+        if (plan->sampleMode != SAMPLE_NONE) {
+            return QueryExecutor_execute_compiled_sampled(plan->condition, plan->queryType, plan->paramValues,
+                                                          plan->paramCount, plan->sampleMode, plan->sampleSize,
+                                                          outResult);
+        }
+        return QueryExecutor_execute_compiled(plan->condition, plan->queryType, plan->paramValues, plan->paramCount,
+                                              limit, outResult);
+    }
+    
+    if (!plan->hasPredicate) {
+        return QUERY_SUCCESS; // Empty result
+    }
+    
+    return QueryExecutor_execute_entities(plan->ecs, plan->queryType, plan->predicateType,
+                                          plan->typeIds, plan->typeCount, limit, outResult);
+}
+
+QueryStatus QueryPlan_execute(QueryPlan* plan, QueryEngineResult* outResult) {
+    if (!plan || !outResult) {
+        return QUERY_ERROR_INVALID_SYNTAX;
+    }
+    
+    // Initialize result
+    QueryEngineResult_init(outResult);
+    
+    QueryProfile profile;
+    bool profiling = QueryProfile_enter(&profile, false);
+    QueryStatus status = execute_plan(plan, outResult);
+    if (profiling) {
+        QueryProfile_leave(&profile, &outResult->stats);
+    }
+    return status;
+}
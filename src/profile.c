@@ -0,0 +1,207 @@
+#include "gramarye_query/profile.h"
+#include "gramarye_query/allocator.h"
+#include "gramarye_query/trace.h"
+#include "internal.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#if GRAMARYE_QUERY_PROFILE_RDTSC && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define PROFILE_CYCLES 1
+#else
+#define PROFILE_CYCLES 0
+#endif
+
+// Profile open on this thread, if any
+static THREAD_LOCAL QueryProfile* currentProfile = NULL;
+
+// Slot of an operator that is traced but not recorded in the stats
+#define OPERATOR_TRACED (SIZE_MAX - 1)
+
+static uint64_t read_clock(void) {
+#if PROFILE_CYCLES
+    return (uint64_t)__rdtsc();
+#else
+    return query_now_ns();
+#endif
+}
+
+bool QueryProfile_enter(QueryProfile* profile, bool analyze) {
+#if GRAMARYE_QUERY_PROFILE
+    if (!profile || currentProfile) return false;
+    
+    memset(profile, 0, sizeof(QueryProfile));
+    profile->analyze = analyze;
+    profile->stats.cycles = PROFILE_CYCLES;
+    profile->phase = QUERY_PHASE_NONE;
+    profile->start = read_clock();
+    profile->phaseStart = profile->start;
+    currentProfile = profile;
+    return true;
+#else
+    (void)profile;
+    (void)analyze;
+    return false;
+#endif
+}
+
+void QueryProfile_leave(QueryProfile* profile, QueryStats* outStats) {
+    if (!profile || currentProfile != profile) return;
+    
+    uint64_t now = read_clock();
+    if (profile->phase != QUERY_PHASE_NONE) {
+        profile->stats.phaseTicks[profile->phase] += now - profile->phaseStart;
+    }
+    profile->stats.totalTicks = now - profile->start;
+    currentProfile = NULL;
+    
+    if (outStats) {
+        *outStats = profile->stats;
+    } else {
+        QueryStats_free(&profile->stats);
+    }
+    profile->stats.operators = NULL;
+    profile->stats.operatorCount = 0;
+}
+
+QueryPhase QueryProfile_switch(QueryPhase phase) {
+    QueryProfile* profile = currentProfile;
+    if (!profile) return QUERY_PHASE_NONE;
+    
+    QueryPhase previous = profile->phase;
+    if (previous == phase) return previous;
+    
+    uint64_t now = read_clock();
+    if (previous != QUERY_PHASE_NONE) {
+        profile->stats.phaseTicks[previous] += now - profile->phaseStart;
+    }
+    profile->phase = phase;
+    profile->phaseStart = now;
+    QueryTrace_phase(phase);
+    return previous;
+}
+
+void QueryProfile_count_lookup(void) {
+    if (currentProfile) {
+        currentProfile->stats.lookups++;
+    }
+}
+
+bool QueryProfile_analyzing(void) {
+    return currentProfile && (currentProfile->analyze || QueryTrace_active());
+}
+
+static QueryOperatorStats* add_operator(QueryProfile* profile, const char* label) {
+    QueryStats* stats = &profile->stats;
+    if (stats->operatorCount == profile->operatorCapacity) {
+        size_t capacity = profile->operatorCapacity ? profile->operatorCapacity * 2 : 8;
+        QueryOperatorStats* operators = (QueryOperatorStats*)QUERY_REALLOC(stats->operators,
+                                                                           sizeof(QueryOperatorStats) * capacity);
+        if (!operators) return NULL;
+        stats->operators = operators;
+        profile->operatorCapacity = capacity;
+    }
+    
+    QueryOperatorStats* op = &stats->operators[stats->operatorCount++];
+    memset(op, 0, sizeof(QueryOperatorStats));
+    snprintf(op->label, sizeof(op->label), "%s", label ? label : "");
+    op->depth = profile->depth;
+    return op;
+}
+
+size_t QueryProfile_begin_operator(const char* label) {
+    QueryProfile* profile = currentProfile;
+    if (!profile) return SIZE_MAX;
+    
+    // A traced operator gets a slot even when the stats cannot take it, so
+    // that its span is always closed
+    bool traced = QueryTrace_active();
+    if (traced) {
+        QueryTrace_begin_operator(label);
+    }
+    QueryOperatorStats* op = profile->analyze ? add_operator(profile, label) : NULL;
+    if (!op) return traced ? OPERATOR_TRACED : SIZE_MAX;
+    profile->depth++;
+    op->ticks = read_clock(); // Start, until the operator ends
+    return (size_t)(op - profile->stats.operators);
+}
+
+void QueryProfile_end_operator(size_t slot, uint64_t rowsIn, uint64_t rowsOut) {
+    QueryProfile* profile = currentProfile;
+    if (!profile || slot == SIZE_MAX) return;
+    
+    QueryTrace_end_operator(rowsIn, rowsOut);
+    if (slot >= profile->stats.operatorCount) return;
+    
+    QueryOperatorStats* op = &profile->stats.operators[slot];
+    op->rowsIn = rowsIn;
+    op->rowsOut = rowsOut;
+    op->ticks = read_clock() - op->ticks;
+    profile->depth = op->depth;
+}
+
+void QueryProfile_add_check(const char* label, uint64_t rowsIn, uint64_t rowsOut) {
+    QueryProfile* profile = currentProfile;
+    if (!profile || !profile->analyze) return;
+    
+    QueryOperatorStats* op = add_operator(profile, label);
+    if (op) {
+        op->rowsIn = rowsIn;
+        op->rowsOut = rowsOut;
+    }
+}
+
+double QueryStats_ms(const QueryStats* stats, uint64_t ticks) {
+    if (!stats || stats->cycles) return 0.0;
+    return (double)ticks / 1000000.0;
+}
+
+static void append_ticks(const QueryStats* stats, char* buffer, size_t size, size_t* length, uint64_t ticks) {
+    if (stats->cycles) {
+        query_append(buffer, size, length, "%llu cycles", (unsigned long long)ticks);
+    } else {
+        query_append(buffer, size, length, "%.3f ms", QueryStats_ms(stats, ticks));
+    }
+}
+
+size_t QueryStats_format(const QueryStats* stats, char* buffer, size_t size) {
+    static const char* const phaseNames[QUERY_PHASE_COUNT] = {
+        "lex", "parse", "resolve", "scan", "materialize"
+    };
+    if (buffer && size > 0) buffer[0] = '\0';
+    if (!stats) return 0;
+    if (!buffer) size = 0;
+    
+    size_t length = 0;
+    for (size_t i = 0; i < stats->operatorCount; i++) {
+        const QueryOperatorStats* op = &stats->operators[i];
+        query_append(buffer, size, &length, "%*s%s  (rows in %llu, out %llu", (int)(op->depth * 2), "", op->label,
+                     (unsigned long long)op->rowsIn, (unsigned long long)op->rowsOut);
+        if (op->ticks > 0) {
+            query_append(buffer, size, &length, ", ");
+            append_ticks(stats, buffer, size, &length, op->ticks);
+        }
+        query_append(buffer, size, &length, ")\n");
+    }
+    
+    query_append(buffer, size, &length, "Total ");
+    append_ticks(stats, buffer, size, &length, stats->totalTicks);
+    for (int phase = 0; phase < QUERY_PHASE_COUNT; phase++) {
+        query_append(buffer, size, &length, "%s %s ", phase == 0 ? ":" : ",", phaseNames[phase]);
+        append_ticks(stats, buffer, size, &length, stats->phaseTicks[phase]);
+    }
+    query_append(buffer, size, &length, "\n");
+    return length;
+}
+
+void QueryStats_free(QueryStats* stats) {
+    if (!stats) return;
+    
+    if (stats->operators) {
+        QUERY_FREE(stats->operators);
+    }
+    stats->operators = NULL;
+    stats->operatorCount = 0;
+}
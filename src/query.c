@@ -3,24 +3,14 @@
 #include "gramarye_query/executor.h"
 #include "gramarye_ecs/ecs.h"
 #include "gramarye_ecs/entity.h"  // Get actual EntityId type
+#include "gramarye_query/allocator.h"
 #include "mem.h"
 #include <string.h>
 
 // Cast macro for QueryEntityId* to EntityId*
 #define QUERY_ENTITY_ID_PTR(ptr) ((EntityId*)(ptr))
 
-// Compatibility wrapper - QueryResult maps to QueryEngineResult when ECS QueryResult is defined
-QueryStatus Query_execute(ECS* ecs, const char* queryString, QueryEngineResult* outResult) {
-    if (!ecs || !queryString || !outResult) {
-        return QUERY_ERROR_INVALID_SYNTAX;
-    }
-    
-    // Initialize result
-    outResult->entities = NULL;
-    outResult->count = 0;
-    outResult->capacity = 0;
-    outResult->data = NULL;
-    
+static QueryStatus execute_query(ECS* ecs, const char* queryString, QueryEngineResult* outResult) {
     // Parse query
     QueryParser* parser = QueryParser_new(queryString);
     if (!parser) {
@@ -43,15 +33,46 @@ QueryStatus Query_execute(ECS* ecs, const char* queryString, QueryEngineResult*
     return status;
 }
 
-void QueryEngineResult_free(QueryEngineResult* result) {
-    if (!result) return;
+// Compatibility wrapper - QueryResult maps to QueryEngineResult when ECS QueryResult is defined
+QueryStatus Query_execute(ECS* ecs, const char* queryString, QueryEngineResult* outResult) {
+    if (!ecs || !queryString || !outResult) {
+        return QUERY_ERROR_INVALID_SYNTAX;
+    }
+    
+    // Initialize result
+    QueryEngineResult_init(outResult);
     
-    if (result->entities) {
-        FREE(result->entities);
+    QueryProfile profile;
+    bool profiling = QueryProfile_enter(&profile, false);
+    QueryStatus status = execute_query(ecs, queryString, outResult);
+    if (profiling) {
+        QueryProfile_leave(&profile, &outResult->stats);
     }
+    return status;
+}
+
+void QueryEngineResult_init(QueryEngineResult* result) {
+    if (!result) return;
     
-    if (result->data) {
-        FREE(result->data);
+    memset(result, 0, sizeof(QueryEngineResult));
+    result->allocator = QueryMemory_current();
+}
+
+void QueryEngineResult_free(QueryEngineResult* result) {
+    if (!result) return;
+    
+    // Results assembled by hand (allocator NULL) hold libcore blocks
+    if (result->allocator) {
+        QUERY_FREE(result->entities);
+        QUERY_FREE(result->data);
+        QueryStats_free(&result->stats);
+    } else {
+        if (result->entities) {
+            FREE(result->entities);
+        }
+        if (result->data) {
+            FREE(result->data);
+        }
     }
     
     result->count = 0;
@@ -66,4 +87,3 @@ EntityId_forward* QueryEngineResult_get_entities(QueryEngineResult* result, size
     // Caller will cast to EntityId* when ECS headers are included
     return (EntityId_forward*)QUERY_ENTITY_ID_PTR(result->entities);
 }
-
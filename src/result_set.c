@@ -0,0 +1,331 @@
+#include "gramarye_query/query.h"
+#include "gramarye_query/entity_set.h"
+#include "gramarye_ecs/entity.h"  // Get actual EntityId type
+#include "gramarye_query/allocator.h"
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define RESULT_SET_SIMD 1
+#endif
+
+// Size ratio past which each element of the smaller side is galloped into the larger
+#define GALLOP_RATIO 32
+
+// Entities of the right-hand side tested per step of the block merges
+#define BLOCK_SIZE 4
+
+typedef enum {
+    SET_INTERSECT,
+    SET_UNION,
+    SET_DIFFERENCE
+} SetOperation;
+
+// Sorted view of a result's entities
+typedef struct {
+    const EntityId* entities;
+    size_t count;
+    EntityId* owned;            // Sorted copy, when sorting on demand
+} SortedInput;
+
+static bool entity_less(EntityId a, EntityId b) {
+    return a.high < b.high || (a.high == b.high && a.low < b.low);
+}
+
+static bool entity_equal(EntityId a, EntityId b) {
+    return a.high == b.high && a.low == b.low;
+}
+
+// Fails for results without an entity list, or OOM
+static bool prepare_input(const QueryEngineResult* result, bool sortInput, SortedInput* input) {
+    input->entities = NULL;
+    input->count = 0;
+    input->owned = NULL;
+    if (result->count == 0) return true;
+    if (!result->entities || result->data) return false;
+    
+    // Trust the caller's order: checking it would cost the O(n) that galloping saves
+    const EntityId* entities = (const EntityId*)result->entities;
+    if (!sortInput) {
+        input->entities = entities;
+        input->count = result->count;
+        return true;
+    }
+    
+    EntityId* copy = (EntityId*)QUERY_ALLOC(sizeof(EntityId) * result->count);
+    if (!copy) return false;
+    memcpy(copy, entities, sizeof(EntityId) * result->count);
+    if (!EntityId_sort(copy, result->count)) {
+        QUERY_FREE(copy);
+        return false;
+    }
+    
+    input->entities = copy;
+    input->count = result->count;
+    input->owned = copy;
+    return true;
+}
+
+static void release_input(SortedInput* input) {
+    if (input->owned) QUERY_FREE(input->owned);
+    input->owned = NULL;
+}
+
+// Append entity unless it repeats the previous one (inputs may hold duplicates)
+static void append_unique(QueryEngineResult* out, EntityId entity) {
+    EntityId* entities = (EntityId*)out->entities;
+    if (out->count > 0 && entity_equal(entities[out->count - 1], entity)) return;
+    entities[out->count++] = entity;
+}
+
+static void append_run(QueryEngineResult* out, const EntityId* entities, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        append_unique(out, entities[i]);
+    }
+}
+
+// First index at or after start whose entity is not less than key
+static size_t gallop(const EntityId* entities, size_t count, size_t start, EntityId key) {
+    if (start >= count || !entity_less(entities[start], key)) return start;
+    
+    // Double the step while still below key, then binary search the last step
+    size_t low = start;
+    size_t step = 1;
+    size_t high = low + step;
+    while (high < count && entity_less(entities[high], key)) {
+        low = high;
+        step *= 2;
+        high = low + step;
+    }
+    if (high > count) high = count;
+    
+    while (low + 1 < high) {
+        size_t mid = low + (high - low) / 2;
+        if (entity_less(entities[mid], key)) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    return high;
+}
+
+// Whether key equals any of the BLOCK_SIZE entities at block
+static bool block_contains(EntityId key, const EntityId* block) {
+#ifdef RESULT_SET_SIMD
+    // One 128-bit lane per id; an id matches when all 16 bytes compare equal
+    __m128i needle = _mm_loadu_si128((const __m128i*)&key);
+    int m0 = _mm_movemask_epi8(_mm_cmpeq_epi32(needle, _mm_loadu_si128((const __m128i*)&block[0])));
+    int m1 = _mm_movemask_epi8(_mm_cmpeq_epi32(needle, _mm_loadu_si128((const __m128i*)&block[1])));
+    int m2 = _mm_movemask_epi8(_mm_cmpeq_epi32(needle, _mm_loadu_si128((const __m128i*)&block[2])));
+    int m3 = _mm_movemask_epi8(_mm_cmpeq_epi32(needle, _mm_loadu_si128((const __m128i*)&block[3])));
+    return ((m0 == 0xFFFF) | (m1 == 0xFFFF) | (m2 == 0xFFFF) | (m3 == 0xFFFF)) != 0;
+#else
+    bool found = false;
+    for (size_t k = 0; k < BLOCK_SIZE; k++) {
+        found |= entity_equal(key, block[k]);
+    }
+    return found;
+#endif
+}
+
+// Walk a one element at a time and b one block at a time. A block whose last
+// id is below a[i] holds nothing a can still match; otherwise a[i] either lies
+// in the block or is absent from b. keepMatches selects intersect/difference.
+static void block_merge(const SortedInput* a, const SortedInput* b, bool keepMatches, QueryEngineResult* out) {
+    size_t i = 0;
+    size_t j = 0;
+    while (i < a->count && j + BLOCK_SIZE <= b->count) {
+        if (entity_less(b->entities[j + BLOCK_SIZE - 1], a->entities[i])) {
+            j += BLOCK_SIZE;
+            continue;
+        }
+        if (block_contains(a->entities[i], &b->entities[j]) == keepMatches) {
+            append_unique(out, a->entities[i]);
+        }
+        i++;
+    }
+    
+    // Fewer than a block left in b
+    while (i < a->count) {
+        if (j < b->count && entity_less(b->entities[j], a->entities[i])) {
+            j++;
+            continue;
+        }
+        bool matched = j < b->count && entity_equal(b->entities[j], a->entities[i]);
+        if (matched == keepMatches) {
+            append_unique(out, a->entities[i]);
+        }
+        i++;
+    }
+}
+
+// Look up each element of small in large
+static void gallop_lookup(const SortedInput* small, const SortedInput* large, bool keepMatches, QueryEngineResult* out) {
+    size_t position = 0;
+    for (size_t i = 0; i < small->count; i++) {
+        position = gallop(large->entities, large->count, position, small->entities[i]);
+        bool matched = position < large->count && entity_equal(large->entities[position], small->entities[i]);
+        if (matched == keepMatches) {
+            append_unique(out, small->entities[i]);
+        }
+    }
+}
+
+// a minus a small b: copy the runs of a between consecutive elements of b
+static void gallop_subtract(const SortedInput* a, const SortedInput* b, QueryEngineResult* out) {
+    size_t position = 0;
+    for (size_t k = 0; k < b->count; k++) {
+        size_t next = gallop(a->entities, a->count, position, b->entities[k]);
+        append_run(out, &a->entities[position], next - position);
+        position = next;
+        while (position < a->count && entity_equal(a->entities[position], b->entities[k])) {
+            position++;
+        }
+    }
+    append_run(out, &a->entities[position], a->count - position);
+}
+
+// Merge a small input into a large one, copying the runs in between
+static void gallop_union(const SortedInput* small, const SortedInput* large, QueryEngineResult* out) {
+    size_t position = 0;
+    for (size_t i = 0; i < small->count; i++) {
+        size_t next = gallop(large->entities, large->count, position, small->entities[i]);
+        append_run(out, &large->entities[position], next - position);
+        append_unique(out, small->entities[i]);
+        position = next;
+    }
+    append_run(out, &large->entities[position], large->count - position);
+}
+
+static void merge_union(const SortedInput* a, const SortedInput* b, QueryEngineResult* out) {
+    size_t i = 0;
+    size_t j = 0;
+    while (i < a->count && j < b->count) {
+        if (entity_less(b->entities[j], a->entities[i])) {
+            append_unique(out, b->entities[j++]);
+        } else {
+            append_unique(out, a->entities[i++]);
+        }
+    }
+    append_run(out, &a->entities[i], a->count - i);
+    append_run(out, &b->entities[j], b->count - j);
+}
+
+static bool skewed(size_t smallCount, size_t largeCount) {
+    return smallCount == 0 || largeCount / smallCount >= GALLOP_RATIO;
+}
+
+// Sorted, deduplicated result of a op b in one allocation
+static bool run_operation(SetOperation op, const SortedInput* a, const SortedInput* b, QueryEngineResult* out) {
+    size_t capacity = op == SET_UNION ? a->count + b->count :
+                      op == SET_DIFFERENCE ? a->count :
+                      (a->count < b->count ? a->count : b->count);
+    if (capacity == 0) return true;
+    
+    out->entities = QUERY_ALLOC(sizeof(EntityId) * capacity);
+    if (!out->entities) return false;
+    out->capacity = capacity;
+    
+    const SortedInput* small = a->count <= b->count ? a : b;
+    const SortedInput* large = small == a ? b : a;
+    switch (op) {
+        case SET_INTERSECT:
+            if (skewed(small->count, large->count)) {
+                gallop_lookup(small, large, true, out);
+            } else {
+                block_merge(a, b, true, out);
+            }
+            break;
+        case SET_UNION:
+            if (skewed(small->count, large->count)) {
+                gallop_union(small, large, out);
+            } else {
+                merge_union(a, b, out);
+            }
+            break;
+        case SET_DIFFERENCE:
+            if (small == a && skewed(a->count, b->count)) {
+                gallop_lookup(a, b, false, out);
+            } else if (skewed(b->count, a->count)) {
+                gallop_subtract(a, b, out);
+            } else {
+                block_merge(a, b, false, out);
+            }
+            break;
+    }
+    return true;
+}
+
+static QueryStatus set_operation(SetOperation op, const QueryEngineResult* a, const QueryEngineResult* b,
+                                 bool sortInputs, QueryEngineResult* outResult) {
+    if (outResult) QueryEngineResult_init(outResult);
+    if (!a || !b || !outResult) {
+        return QUERY_ERROR_INVALID_SYNTAX;
+    }
+    
+    SortedInput left;
+    SortedInput right;
+    if (!prepare_input(a, sortInputs, &left)) {
+        return QUERY_ERROR_EXECUTION;
+    }
+    if (!prepare_input(b, sortInputs, &right)) {
+        release_input(&left);
+        return QUERY_ERROR_EXECUTION;
+    }
+    
+    bool ok = run_operation(op, &left, &right, outResult);
+    release_input(&left);
+    release_input(&right);
+    return ok ? QUERY_SUCCESS : QUERY_ERROR_EXECUTION;
+}
+
+QueryStatus QueryEngineResult_intersect(const QueryEngineResult* a, const QueryEngineResult* b,
+                                        bool sortInputs, QueryEngineResult* outResult) {
+    return set_operation(SET_INTERSECT, a, b, sortInputs, outResult);
+}
+
+QueryStatus QueryEngineResult_union(const QueryEngineResult* a, const QueryEngineResult* b,
+                                    bool sortInputs, QueryEngineResult* outResult) {
+    return set_operation(SET_UNION, a, b, sortInputs, outResult);
+}
+
+QueryStatus QueryEngineResult_difference(const QueryEngineResult* a, const QueryEngineResult* b,
+                                         bool sortInputs, QueryEngineResult* outResult) {
+    return set_operation(SET_DIFFERENCE, a, b, sortInputs, outResult);
+}
+
+QueryStatus QueryEngineResult_diff(const QueryEngineResult* prev, const QueryEngineResult* curr,
+                                   QueryEngineResult* outAdded, QueryEngineResult* outRemoved) {
+    if (outAdded) QueryEngineResult_init(outAdded);
+    if (outRemoved) QueryEngineResult_init(outRemoved);
+    if (!prev || !curr || !outAdded || !outRemoved) {
+        return QUERY_ERROR_INVALID_SYNTAX;
+    }
+    
+    // Sort each side once and run both differences over the copies
+    SortedInput before;
+    SortedInput after;
+    if (!prepare_input(prev, true, &before)) {
+        return QUERY_ERROR_EXECUTION;
+    }
+    if (!prepare_input(curr, true, &after)) {
+        release_input(&before);
+        return QUERY_ERROR_EXECUTION;
+    }
+    
+    bool ok = run_operation(SET_DIFFERENCE, &after, &before, outAdded) &&
+              run_operation(SET_DIFFERENCE, &before, &after, outRemoved);
+    release_input(&before);
+    release_input(&after);
+    if (!ok) {
+        QueryEngineResult_free(outAdded);
+        QueryEngineResult_free(outRemoved);
+        QueryEngineResult_init(outAdded);
+        QueryEngineResult_init(outRemoved);
+        return QUERY_ERROR_EXECUTION;
+    }
+    return QUERY_SUCCESS;
+}
@@ -0,0 +1,811 @@
+#include "gramarye_query/roaring.h"
+#include "gramarye_query/entity_set.h"
+#include "gramarye_ecs/entity.h"
+#include "gramarye_query/allocator.h"
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define CHUNK_SIZE 65536
+#define BITSET_WORDS 1024
+#define ARRAY_MAX 4096          // Past this an array is larger than a bitset
+
+typedef enum {
+    CONTAINER_ARRAY,
+    CONTAINER_BITSET,
+    CONTAINER_RUN
+} ContainerType;
+
+// Values start..start + length, inclusive
+typedef struct {
+    uint16_t start;
+    uint16_t length;
+} Run;
+
+typedef struct {
+    void* data;                 // uint16_t values, uint64_t words or Run runs
+    uint32_t cardinality;
+    uint32_t size;              // Array values or runs in use
+    uint32_t capacity;          // Array values or runs allocated
+    uint16_t key;               // High 16 bits of every member
+    uint8_t type;
+} Container;
+
+struct RoaringBitmap {
+    Container* containers;      // Sorted by key, never empty
+    size_t count;
+    size_t capacity;
+};
+
+static size_t popcount64(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return (size_t)__builtin_popcountll(value);
+#else
+    value = value - ((value >> 1) & 0x5555555555555555ULL);
+    value = (value & 0x3333333333333333ULL) + ((value >> 2) & 0x3333333333333333ULL);
+    value = (value + (value >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (size_t)((value * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+static unsigned lowest_bit(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return (unsigned)__builtin_ctzll(value);
+#else
+    unsigned bit = 0;
+    while (!(value & 1)) {
+        value >>= 1;
+        bit++;
+    }
+    return bit;
+#endif
+}
+
+static void container_free(Container* c) {
+    if (c->data) QUERY_FREE(c->data);
+    c->data = NULL;
+}
+
+static bool container_init(Container* c, uint16_t key, ContainerType type, uint32_t capacity) {
+    memset(c, 0, sizeof(Container));
+    c->key = key;
+    c->type = (uint8_t)type;
+    
+    size_t bytes;
+    if (type == CONTAINER_BITSET) {
+        bytes = sizeof(uint64_t) * BITSET_WORDS;
+    } else {
+        if (capacity == 0) capacity = 4;
+        bytes = type == CONTAINER_ARRAY ? sizeof(uint16_t) * capacity : sizeof(Run) * capacity;
+        c->capacity = capacity;
+    }
+    c->data = QUERY_ALLOC(bytes);
+    if (!c->data) return false;
+    if (type == CONTAINER_BITSET) {
+        memset(c->data, 0, bytes);
+    }
+    return true;
+}
+
+static bool container_copy(Container* dst, const Container* src) {
+    *dst = *src;
+    size_t bytes = src->type == CONTAINER_BITSET ? sizeof(uint64_t) * BITSET_WORDS :
+                   src->type == CONTAINER_ARRAY ? sizeof(uint16_t) * src->capacity : sizeof(Run) * src->capacity;
+    dst->data = QUERY_ALLOC(bytes);
+    if (!dst->data) return false;
+    memcpy(dst->data, src->data, bytes);
+    return true;
+}
+
+// Set bits start..end inclusive
+static void set_range(uint64_t* words, uint32_t start, uint32_t end) {
+    uint32_t first = start >> 6;
+    uint32_t last = end >> 6;
+    uint64_t firstMask = ~0ULL << (start & 63);
+    uint64_t lastMask = ~0ULL >> (63 - (end & 63));
+    if (first == last) {
+        words[first] |= firstMask & lastMask;
+        return;
+    }
+    words[first] |= firstMask;
+    for (uint32_t w = first + 1; w < last; w++) {
+        words[w] = ~0ULL;
+    }
+    words[last] |= lastMask;
+}
+
+// Expand any container into a full 1024-word bitset
+static void load_words(const Container* c, uint64_t* words) {
+    if (c->type == CONTAINER_BITSET) {
+        memcpy(words, c->data, sizeof(uint64_t) * BITSET_WORDS);
+        return;
+    }
+    
+    memset(words, 0, sizeof(uint64_t) * BITSET_WORDS);
+    if (c->type == CONTAINER_ARRAY) {
+        const uint16_t* values = (const uint16_t*)c->data;
+        for (uint32_t i = 0; i < c->size; i++) {
+            words[values[i] >> 6] |= 1ULL << (values[i] & 63);
+        }
+    } else {
+        const Run* runs = (const Run*)c->data;
+        for (uint32_t i = 0; i < c->size; i++) {
+            set_range(words, runs[i].start, (uint32_t)runs[i].start + runs[i].length);
+        }
+    }
+}
+
+// Replace c with the members of words as an array or bitset; false on OOM.
+// An empty result leaves c empty (cardinality 0, no data).
+static bool store_words(Container* c, const uint64_t* words) {
+    size_t cardinality = 0;
+    for (size_t w = 0; w < BITSET_WORDS; w++) {
+        cardinality += popcount64(words[w]);
+    }
+    
+    uint16_t key = c->key;
+    Container result;
+    if (cardinality == 0) {
+        container_free(c);
+        memset(c, 0, sizeof(Container));
+        c->key = key;
+        return true;
+    }
+    
+    if (cardinality <= ARRAY_MAX) {
+        if (!container_init(&result, key, CONTAINER_ARRAY, (uint32_t)cardinality)) return false;
+        uint16_t* values = (uint16_t*)result.data;
+        for (size_t w = 0; w < BITSET_WORDS; w++) {
+            uint64_t word = words[w];
+            while (word) {
+                values[result.size++] = (uint16_t)(w * 64 + (size_t)lowest_bit(word));
+                word &= word - 1;
+            }
+        }
+    } else {
+        if (!container_init(&result, key, CONTAINER_BITSET, 0)) return false;
+        memcpy(result.data, words, sizeof(uint64_t) * BITSET_WORDS);
+    }
+    result.cardinality = (uint32_t)cardinality;
+    
+    container_free(c);
+    *c = result;
+    return true;
+}
+
+static bool container_contains(const Container* c, uint16_t low) {
+    if (c->type == CONTAINER_BITSET) {
+        return (((const uint64_t*)c->data)[low >> 6] >> (low & 63)) & 1;
+    }
+    
+    // Binary search for the last value (or run start) not above low
+    size_t lo = 0;
+    size_t hi = c->size;
+    if (c->type == CONTAINER_ARRAY) {
+        const uint16_t* values = (const uint16_t*)c->data;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (values[mid] < low) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo < c->size && values[lo] == low;
+    }
+    
+    const Run* runs = (const Run*)c->data;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (runs[mid].start <= low) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo > 0 && low <= (uint32_t)runs[lo - 1].start + runs[lo - 1].length;
+}
+
+static bool grow_container(Container* c, size_t itemSize) {
+    uint32_t newCapacity = c->capacity * 2;
+    void* data = QUERY_ALLOC(itemSize * newCapacity);
+    if (!data) return false;
+    memcpy(data, c->data, itemSize * c->size);
+    QUERY_FREE(c->data);
+    c->data = data;
+    c->capacity = newCapacity;
+    return true;
+}
+
+static bool convert_to_bitset(Container* c) {
+    uint64_t words[BITSET_WORDS];
+    load_words(c, words);
+    
+    Container result;
+    if (!container_init(&result, c->key, CONTAINER_BITSET, 0)) return false;
+    memcpy(result.data, words, sizeof(words));
+    result.cardinality = c->cardinality;
+    container_free(c);
+    *c = result;
+    return true;
+}
+
+static bool container_add(Container* c, uint16_t low) {
+    if (c->type == CONTAINER_RUN) {
+        Run* runs = (Run*)c->data;
+        Run* last = &runs[c->size - 1];
+        if ((uint32_t)last->start + last->length + 1 == low) {
+            last->length++;
+            c->cardinality++;
+            return true;
+        }
+        if (container_contains(c, low)) return true;
+        if (!convert_to_bitset(c)) return false;
+    }
+    
+    if (c->type == CONTAINER_BITSET) {
+        uint64_t* words = (uint64_t*)c->data;
+        uint64_t bit = 1ULL << (low & 63);
+        if (!(words[low >> 6] & bit)) {
+            words[low >> 6] |= bit;
+            c->cardinality++;
+        }
+        return true;
+    }
+    
+    uint16_t* values = (uint16_t*)c->data;
+    size_t position = c->size;
+    if (c->size > 0 && values[c->size - 1] >= low) {
+        // Out of order: find the slot
+        size_t lo = 0;
+        size_t hi = c->size;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (values[mid] < low) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        if (values[lo] == low) return true;
+        position = lo;
+    }
+    
+    if (c->size >= ARRAY_MAX) {
+        if (!convert_to_bitset(c)) return false;
+        return container_add(c, low);
+    }
+    if (c->size >= c->capacity) {
+        if (!grow_container(c, sizeof(uint16_t))) return false;
+        values = (uint16_t*)c->data;
+    }
+    memmove(&values[position + 1], &values[position], sizeof(uint16_t) * (c->size - position));
+    values[position] = low;
+    c->size++;
+    c->cardinality++;
+    return true;
+}
+
+// Runs needed to encode the container
+static size_t count_runs(const Container* c) {
+    if (c->type == CONTAINER_RUN) return c->size;
+    
+    size_t runs = 0;
+    if (c->type == CONTAINER_ARRAY) {
+        const uint16_t* values = (const uint16_t*)c->data;
+        for (uint32_t i = 0; i < c->size; i++) {
+            if (i == 0 || values[i] != values[i - 1] + 1) runs++;
+        }
+        return runs;
+    }
+    
+    // A run starts at every set bit whose lower neighbour is clear
+    const uint64_t* words = (const uint64_t*)c->data;
+    uint64_t carry = 0;
+    for (size_t w = 0; w < BITSET_WORDS; w++) {
+        runs += popcount64(words[w] & ~((words[w] << 1) | carry));
+        carry = words[w] >> 63;
+    }
+    return runs;
+}
+
+static bool convert_to_runs(Container* c, size_t runCount) {
+    Container result;
+    if (!container_init(&result, c->key, CONTAINER_RUN, (uint32_t)runCount)) return false;
+    Run* runs = (Run*)result.data;
+    
+    if (c->type == CONTAINER_ARRAY) {
+        const uint16_t* values = (const uint16_t*)c->data;
+        for (uint32_t i = 0; i < c->size; i++) {
+            if (result.size > 0 && (uint32_t)runs[result.size - 1].start + runs[result.size - 1].length + 1 == values[i]) {
+                runs[result.size - 1].length++;
+            } else {
+                runs[result.size].start = values[i];
+                runs[result.size].length = 0;
+                result.size++;
+            }
+        }
+    } else {
+        const uint64_t* words = (const uint64_t*)c->data;
+        uint32_t bit = 0;
+        while (bit < CHUNK_SIZE) {
+            // Skip clear bits, then measure the run of set ones
+            uint64_t word = words[bit >> 6] >> (bit & 63);
+            if (word == 0) {
+                bit = (bit | 63) + 1;
+                continue;
+            }
+            bit += (uint32_t)lowest_bit(word);
+            uint32_t start = bit;
+            while (bit < CHUNK_SIZE) {
+                uint64_t ones = ~(words[bit >> 6] >> (bit & 63));
+                if (ones == 0) {
+                    bit = (bit | 63) + 1;
+                    continue;
+                }
+                uint32_t step = (uint32_t)lowest_bit(ones);
+                if (step >= 64 - (bit & 63)) {
+                    bit = (bit | 63) + 1; // Rest of the word is set
+                    continue;
+                }
+                bit += step;
+                break;
+            }
+            runs[result.size].start = (uint16_t)start;
+            runs[result.size].length = (uint16_t)(bit - 1 - start);
+            result.size++;
+        }
+    }
+    
+    result.cardinality = c->cardinality;
+    container_free(c);
+    *c = result;
+    return true;
+}
+
+static void container_optimize(Container* c) {
+    if (c->type == CONTAINER_RUN) return;
+    
+    size_t runs = count_runs(c);
+    size_t current = c->type == CONTAINER_ARRAY ? sizeof(uint16_t) * c->size : sizeof(uint64_t) * BITSET_WORDS;
+    if (sizeof(Run) * runs < current) {
+        convert_to_runs(c, runs); // Keeps the old form on OOM
+    }
+}
+
+static size_t container_extract(const Container* c, uint32_t* out, size_t maxCount) {
+    uint32_t base = (uint32_t)c->key << 16;
+    size_t written = 0;
+    if (c->type == CONTAINER_ARRAY) {
+        const uint16_t* values = (const uint16_t*)c->data;
+        for (uint32_t i = 0; i < c->size && written < maxCount; i++) {
+            out[written++] = base | values[i];
+        }
+    } else if (c->type == CONTAINER_BITSET) {
+        const uint64_t* words = (const uint64_t*)c->data;
+        for (size_t w = 0; w < BITSET_WORDS && written < maxCount; w++) {
+            uint64_t word = words[w];
+            while (word && written < maxCount) {
+                out[written++] = base | (uint32_t)(w * 64 + (size_t)lowest_bit(word));
+                word &= word - 1;
+            }
+        }
+    } else {
+        const Run* runs = (const Run*)c->data;
+        for (uint32_t i = 0; i < c->size && written < maxCount; i++) {
+            uint32_t end = (uint32_t)runs[i].start + runs[i].length;
+            for (uint32_t v = runs[i].start; v <= end && written < maxCount; v++) {
+                out[written++] = base | v;
+            }
+        }
+    }
+    return written;
+}
+
+// dst &= src for one chunk; may leave dst empty
+static bool container_and(Container* dst, const Container* src) {
+    if (dst->type == CONTAINER_ARRAY || src->type == CONTAINER_ARRAY) {
+        // Keep the array side's values that the other side holds
+        Container filtered;
+        if (dst->type == CONTAINER_ARRAY) {
+            filtered = *dst;
+        } else if (!container_copy(&filtered, src)) {
+            return false;
+        }
+        const Container* other = dst->type == CONTAINER_ARRAY ? src : dst;
+        uint16_t* values = (uint16_t*)filtered.data;
+        uint32_t kept = 0;
+        for (uint32_t i = 0; i < filtered.size; i++) {
+            if (container_contains(other, values[i])) {
+                values[kept++] = values[i];
+            }
+        }
+        filtered.size = kept;
+        filtered.cardinality = kept;
+        if (dst->type != CONTAINER_ARRAY) {
+            container_free(dst);
+        }
+        *dst = filtered;
+        return true;
+    }
+    
+    uint64_t words[BITSET_WORDS];
+    uint64_t other[BITSET_WORDS];
+    load_words(dst, words);
+    load_words(src, other);
+    for (size_t w = 0; w < BITSET_WORDS; w++) {
+        words[w] &= other[w];
+    }
+    return store_words(dst, words);
+}
+
+// dst |= src for one chunk
+static bool container_or(Container* dst, const Container* src) {
+    // A full chunk absorbs everything
+    if (src->cardinality == CHUNK_SIZE && dst->cardinality != CHUNK_SIZE) {
+        Container full;
+        if (!container_copy(&full, src)) return false;
+        container_free(dst);
+        *dst = full;
+        return true;
+    }
+    if (dst->cardinality == CHUNK_SIZE) return true;
+    
+    if (dst->type == CONTAINER_ARRAY && src->type == CONTAINER_ARRAY && dst->size + src->size <= ARRAY_MAX) {
+        Container merged;
+        if (!container_init(&merged, dst->key, CONTAINER_ARRAY, dst->size + src->size)) return false;
+        const uint16_t* a = (const uint16_t*)dst->data;
+        const uint16_t* b = (const uint16_t*)src->data;
+        uint16_t* out = (uint16_t*)merged.data;
+        uint32_t i = 0;
+        uint32_t j = 0;
+        while (i < dst->size || j < src->size) {
+            if (j >= src->size || (i < dst->size && a[i] < b[j])) {
+                out[merged.size++] = a[i++];
+            } else if (i >= dst->size || b[j] < a[i]) {
+                out[merged.size++] = b[j++];
+            } else {
+                out[merged.size++] = a[i++];
+                j++;
+            }
+        }
+        merged.cardinality = merged.size;
+        container_free(dst);
+        *dst = merged;
+        return true;
+    }
+    
+    uint64_t words[BITSET_WORDS];
+    load_words(dst, words);
+    if (src->type == CONTAINER_ARRAY) {
+        const uint16_t* values = (const uint16_t*)src->data;
+        for (uint32_t i = 0; i < src->size; i++) {
+            words[values[i] >> 6] |= 1ULL << (values[i] & 63);
+        }
+    } else if (src->type == CONTAINER_RUN) {
+        const Run* runs = (const Run*)src->data;
+        for (uint32_t i = 0; i < src->size; i++) {
+            set_range(words, runs[i].start, (uint32_t)runs[i].start + runs[i].length);
+        }
+    } else {
+        const uint64_t* other = (const uint64_t*)src->data;
+        for (size_t w = 0; w < BITSET_WORDS; w++) {
+            words[w] |= other[w];
+        }
+    }
+    return store_words(dst, words);
+}
+
+// dst &= ~src for one chunk; may leave dst empty
+static bool container_andnot(Container* dst, const Container* src) {
+    if (src->cardinality == CHUNK_SIZE) {
+        container_free(dst);
+        dst->cardinality = 0;
+        return true;
+    }
+    
+    if (dst->type == CONTAINER_ARRAY) {
+        uint16_t* values = (uint16_t*)dst->data;
+        uint32_t kept = 0;
+        for (uint32_t i = 0; i < dst->size; i++) {
+            if (!container_contains(src, values[i])) {
+                values[kept++] = values[i];
+            }
+        }
+        dst->size = kept;
+        dst->cardinality = kept;
+        return true;
+    }
+    
+    uint64_t words[BITSET_WORDS];
+    load_words(dst, words);
+    if (src->type == CONTAINER_ARRAY) {
+        const uint16_t* values = (const uint16_t*)src->data;
+        for (uint32_t i = 0; i < src->size; i++) {
+            words[values[i] >> 6] &= ~(1ULL << (values[i] & 63));
+        }
+    } else {
+        uint64_t other[BITSET_WORDS];
+        load_words(src, other);
+        for (size_t w = 0; w < BITSET_WORDS; w++) {
+            words[w] &= ~other[w];
+        }
+    }
+    return store_words(dst, words);
+}
+
+RoaringBitmap* RoaringBitmap_new(void) {
+    RoaringBitmap* bitmap = (RoaringBitmap*)QUERY_ALLOC(sizeof(RoaringBitmap));
+    if (!bitmap) return NULL;
+    
+    memset(bitmap, 0, sizeof(RoaringBitmap));
+    return bitmap;
+}
+
+void RoaringBitmap_destroy(RoaringBitmap* bitmap) {
+    if (!bitmap) return;
+    
+    for (size_t i = 0; i < bitmap->count; i++) {
+        container_free(&bitmap->containers[i]);
+    }
+    if (bitmap->containers) QUERY_FREE(bitmap->containers);
+    QUERY_FREE(bitmap);
+}
+
+static bool reserve_containers(RoaringBitmap* bitmap, size_t needed) {
+    if (needed <= bitmap->capacity) return true;
+    
+    size_t newCapacity = bitmap->capacity ? bitmap->capacity * 2 : 8;
+    while (newCapacity < needed) {
+        newCapacity *= 2;
+    }
+    Container* containers = (Container*)QUERY_ALLOC(sizeof(Container) * newCapacity);
+    if (!containers) return false;
+    if (bitmap->containers) {
+        memcpy(containers, bitmap->containers, sizeof(Container) * bitmap->count);
+        QUERY_FREE(bitmap->containers);
+    }
+    bitmap->containers = containers;
+    bitmap->capacity = newCapacity;
+    return true;
+}
+
+RoaringBitmap* RoaringBitmap_copy(const RoaringBitmap* bitmap) {
+    if (!bitmap) return NULL;
+    
+    RoaringBitmap* copy = RoaringBitmap_new();
+    if (!copy || !reserve_containers(copy, bitmap->count)) {
+        RoaringBitmap_destroy(copy);
+        return NULL;
+    }
+    for (size_t i = 0; i < bitmap->count; i++) {
+        if (!container_copy(&copy->containers[i], &bitmap->containers[i])) {
+            RoaringBitmap_destroy(copy);
+            return NULL;
+        }
+        copy->count++;
+    }
+    return copy;
+}
+
+// Position of key, or where it would be inserted (found reports which)
+static size_t find_container(const RoaringBitmap* bitmap, uint16_t key, bool* found) {
+    size_t lo = 0;
+    size_t hi = bitmap->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (bitmap->containers[mid].key < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    *found = lo < bitmap->count && bitmap->containers[lo].key == key;
+    return lo;
+}
+
+bool RoaringBitmap_add(RoaringBitmap* bitmap, uint32_t value) {
+    if (!bitmap) return false;
+    
+    uint16_t key = (uint16_t)(value >> 16);
+    uint16_t low = (uint16_t)value;
+    
+    // Appends land in the last container
+    size_t position;
+    bool found;
+    if (bitmap->count > 0 && bitmap->containers[bitmap->count - 1].key == key) {
+        position = bitmap->count - 1;
+        found = true;
+    } else if (bitmap->count == 0 || bitmap->containers[bitmap->count - 1].key < key) {
+        position = bitmap->count;
+        found = false;
+    } else {
+        position = find_container(bitmap, key, &found);
+    }
+    
+    if (!found) {
+        if (!reserve_containers(bitmap, bitmap->count + 1)) return false;
+        Container c;
+        if (!container_init(&c, key, CONTAINER_ARRAY, 0)) return false;
+        memmove(&bitmap->containers[position + 1], &bitmap->containers[position],
+                sizeof(Container) * (bitmap->count - position));
+        bitmap->containers[position] = c;
+        bitmap->count++;
+    }
+    return container_add(&bitmap->containers[position], low);
+}
+
+bool RoaringBitmap_contains(const RoaringBitmap* bitmap, uint32_t value) {
+    if (!bitmap) return false;
+    
+    bool found;
+    size_t position = find_container(bitmap, (uint16_t)(value >> 16), &found);
+    return found && container_contains(&bitmap->containers[position], (uint16_t)value);
+}
+
+size_t RoaringBitmap_cardinality(const RoaringBitmap* bitmap) {
+    if (!bitmap) return 0;
+    
+    size_t total = 0;
+    for (size_t i = 0; i < bitmap->count; i++) {
+        total += bitmap->containers[i].cardinality;
+    }
+    return total;
+}
+
+// Drop containers an operation emptied
+static void compact(RoaringBitmap* bitmap) {
+    size_t kept = 0;
+    for (size_t i = 0; i < bitmap->count; i++) {
+        if (bitmap->containers[i].cardinality > 0) {
+            bitmap->containers[kept++] = bitmap->containers[i];
+        } else {
+            container_free(&bitmap->containers[i]);
+        }
+    }
+    bitmap->count = kept;
+}
+
+bool RoaringBitmap_and(RoaringBitmap* dst, const RoaringBitmap* src) {
+    if (!dst || !src) return false;
+    
+    bool ok = true;
+    size_t j = 0;
+    for (size_t i = 0; i < dst->count; i++) {
+        Container* c = &dst->containers[i];
+        while (j < src->count && src->containers[j].key < c->key) {
+            j++;
+        }
+        if (j < src->count && src->containers[j].key == c->key) {
+            ok = container_and(c, &src->containers[j]) && ok;
+        } else {
+            container_free(c);
+            c->cardinality = 0;
+        }
+    }
+    compact(dst);
+    return ok;
+}
+
+bool RoaringBitmap_or(RoaringBitmap* dst, const RoaringBitmap* src) {
+    if (!dst || !src) return false;
+    if (!reserve_containers(dst, dst->count + src->count)) return false;
+    
+    // Merge from the back so dst's containers can move in place
+    size_t i = dst->count;
+    size_t j = src->count;
+    size_t w = dst->count + src->count;
+    size_t total = w;
+    bool ok = true;
+    while (j > 0) {
+        if (i > 0 && dst->containers[i - 1].key > src->containers[j - 1].key) {
+            dst->containers[--w] = dst->containers[--i];
+        } else if (i > 0 && dst->containers[i - 1].key == src->containers[j - 1].key) {
+            Container c = dst->containers[--i];
+            ok = container_or(&c, &src->containers[--j]) && ok;
+            dst->containers[--w] = c;
+        } else {
+            Container c;
+            if (!container_copy(&c, &src->containers[--j])) {
+                c.data = NULL;
+                c.cardinality = 0;
+                ok = false;
+            }
+            dst->containers[--w] = c;
+        }
+    }
+    
+    // The untouched dst prefix stays where it is; close the gap after it
+    size_t shift = w - i;
+    if (shift > 0) {
+        memmove(&dst->containers[i], &dst->containers[w], sizeof(Container) * (total - w));
+    }
+    dst->count = total - shift;
+    compact(dst);
+    return ok;
+}
+
+bool RoaringBitmap_andnot(RoaringBitmap* dst, const RoaringBitmap* src) {
+    if (!dst || !src) return false;
+    
+    bool ok = true;
+    size_t j = 0;
+    for (size_t i = 0; i < dst->count; i++) {
+        Container* c = &dst->containers[i];
+        while (j < src->count && src->containers[j].key < c->key) {
+            j++;
+        }
+        if (j < src->count && src->containers[j].key == c->key) {
+            ok = container_andnot(c, &src->containers[j]) && ok;
+        }
+    }
+    compact(dst);
+    return ok;
+}
+
+void RoaringBitmap_optimize(RoaringBitmap* bitmap) {
+    if (!bitmap) return;
+    
+    for (size_t i = 0; i < bitmap->count; i++) {
+        container_optimize(&bitmap->containers[i]);
+    }
+}
+
+size_t RoaringBitmap_to_array(const RoaringBitmap* bitmap, uint32_t* outValues, size_t maxCount) {
+    if (!bitmap || !outValues) return 0;
+    
+    size_t written = 0;
+    for (size_t i = 0; i < bitmap->count && written < maxCount; i++) {
+        written += container_extract(&bitmap->containers[i], outValues + written, maxCount - written);
+    }
+    return written;
+}
+
+size_t RoaringBitmap_materialize(const RoaringBitmap* bitmap, const EntityIndexMap* map,
+                                 EntityId* outEntities, size_t maxCount) {
+    if (!bitmap || !map || !outEntities) return 0;
+    
+    // Decode one container at a time into a chunk-sized scratch buffer
+    size_t scratchCount = maxCount < CHUNK_SIZE ? maxCount : CHUNK_SIZE;
+    uint32_t* indices = (uint32_t*)QUERY_ALLOC(sizeof(uint32_t) * (scratchCount ? scratchCount : 1));
+    if (!indices) return 0;
+    
+    size_t written = 0;
+    for (size_t i = 0; i < bitmap->count && written < maxCount; i++) {
+        size_t remaining = maxCount - written;
+        size_t got = container_extract(&bitmap->containers[i], indices,
+                                       remaining < scratchCount ? remaining : scratchCount);
+        for (size_t k = 0; k < got; k++) {
+            outEntities[written++] = EntityIndexMap_entity_at(map, indices[k]);
+        }
+    }
+    QUERY_FREE(indices);
+    return written;
+}
+
+RoaringStats RoaringBitmap_get_stats(const RoaringBitmap* bitmap) {
+    RoaringStats stats;
+    memset(&stats, 0, sizeof(stats));
+    if (!bitmap) return stats;
+    
+    for (size_t i = 0; i < bitmap->count; i++) {
+        switch (bitmap->containers[i].type) {
+            case CONTAINER_ARRAY: stats.arrayContainers++; break;
+            case CONTAINER_BITSET: stats.bitsetContainers++; break;
+            default: stats.runContainers++; break;
+        }
+    }
+    return stats;
+}
+
+size_t RoaringBitmap_memory_bytes(const RoaringBitmap* bitmap) {
+    if (!bitmap) return 0;
+    
+    size_t bytes = sizeof(RoaringBitmap) + sizeof(Container) * bitmap->capacity;
+    for (size_t i = 0; i < bitmap->count; i++) {
+        const Container* c = &bitmap->containers[i];
+        bytes += c->type == CONTAINER_BITSET ? sizeof(uint64_t) * BITSET_WORDS :
+                 c->type == CONTAINER_ARRAY ? sizeof(uint16_t) * c->capacity : sizeof(Run) * c->capacity;
+    }
+    return bytes;
+}
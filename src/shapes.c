@@ -0,0 +1,244 @@
+#include "gramarye_query/shapes.h"
+#include "gramarye_query/query.h"
+#include "gramarye_query/allocator.h"
+#include "internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Bucket layout: values below SUB_BUCKETS get a bucket each; above, value v
+// with highest set bit b lands in one of HALF_BUCKETS buckets for shift
+// b - 5, indexed by its top six bits
+#define SUB_BUCKETS 64
+#define HALF_BUCKETS 32
+#define MAX_SHIFT ((QUERY_HISTOGRAM_BUCKETS - SUB_BUCKETS) / HALF_BUCKETS)
+
+struct QueryShapeTable {
+    QueryShapeStats** shapes;   // First-seen order
+    size_t count;
+    size_t capacity;
+    uint32_t* index;            // Open addressing on fingerprint: shape index + 1, 0 when empty
+    size_t indexSize;           // Power of two, at least twice capacity
+    uint64_t untracked;
+};
+
+static unsigned highest_bit(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return 63u - (unsigned)__builtin_clzll(value);
+#else
+    unsigned bit = 0;
+    while (value >>= 1) bit++;
+    return bit;
+#endif
+}
+
+static size_t bucket_of(uint64_t ns) {
+    if (ns < SUB_BUCKETS) return (size_t)ns;
+    
+    unsigned shift = highest_bit(ns) - 5;
+    if (shift > (unsigned)MAX_SHIFT) return QUERY_HISTOGRAM_BUCKETS - 1;
+    return SUB_BUCKETS + (size_t)(shift - 1) * HALF_BUCKETS + (size_t)((ns >> shift) - HALF_BUCKETS);
+}
+
+// Largest value a bucket holds
+static uint64_t bucket_upper(size_t bucket) {
+    if (bucket < SUB_BUCKETS) return bucket;
+    
+    size_t offset = bucket - SUB_BUCKETS;
+    unsigned shift = (unsigned)(offset / HALF_BUCKETS) + 1;
+    uint64_t sub = (uint64_t)(offset % HALF_BUCKETS) + HALF_BUCKETS;
+    return ((sub + 1) << shift) - 1;
+}
+
+void QueryLatencyHistogram_record(QueryLatencyHistogram* histogram, uint64_t ns) {
+    if (!histogram) return;
+    
+    histogram->counts[bucket_of(ns)]++;
+    if (histogram->count == 0 || ns < histogram->min) {
+        histogram->min = ns;
+    }
+    if (ns > histogram->max) {
+        histogram->max = ns;
+    }
+    histogram->count++;
+    histogram->sum += ns;
+}
+
+uint64_t QueryLatencyHistogram_percentile(const QueryLatencyHistogram* histogram, double q) {
+    if (!histogram || histogram->count == 0) return 0;
+    if (q <= 0.0) return histogram->min;
+    
+    uint64_t rank = (uint64_t)(q * (double)histogram->count + 0.999999);
+    if (rank == 0) rank = 1;
+    if (rank > histogram->count) rank = histogram->count;
+    
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < QUERY_HISTOGRAM_BUCKETS; bucket++) {
+        seen += histogram->counts[bucket];
+        if (seen >= rank) {
+            uint64_t upper = bucket_upper(bucket);
+            return upper < histogram->max ? upper : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+QueryShapeTable* QueryShapeTable_new(size_t capacity) {
+    if (capacity == 0 || capacity > UINT32_MAX / 2) return NULL;
+    
+    QueryShapeTable* table = (QueryShapeTable*)QUERY_ALLOC(sizeof(QueryShapeTable));
+    if (!table) return NULL;
+    
+    memset(table, 0, sizeof(QueryShapeTable));
+    table->capacity = capacity;
+    table->indexSize = 16;
+    while (table->indexSize < capacity * 2) {
+        table->indexSize *= 2;
+    }
+    table->shapes = (QueryShapeStats**)QUERY_ALLOC(sizeof(QueryShapeStats*) * capacity);
+    table->index = (uint32_t*)QUERY_ALLOC(sizeof(uint32_t) * table->indexSize);
+    if (!table->shapes || !table->index) {
+        if (table->shapes) QUERY_FREE(table->shapes);
+        if (table->index) QUERY_FREE(table->index);
+        QUERY_FREE(table);
+        return NULL;
+    }
+    memset(table->index, 0, sizeof(uint32_t) * table->indexSize);
+    return table;
+}
+
+void QueryShapeTable_clear(QueryShapeTable* table) {
+    if (!table) return;
+    
+    for (size_t i = 0; i < table->count; i++) {
+        QUERY_FREE(table->shapes[i]);
+    }
+    table->count = 0;
+    table->untracked = 0;
+    memset(table->index, 0, sizeof(uint32_t) * table->indexSize);
+}
+
+void QueryShapeTable_destroy(QueryShapeTable* table) {
+    if (!table) return;
+    
+    QueryShapeTable_clear(table);
+    QUERY_FREE(table->shapes);
+    QUERY_FREE(table->index);
+    QUERY_FREE(table);
+}
+
+// Index slot holding fingerprint, or the empty slot where it would go
+static size_t probe(const QueryShapeTable* table, uint64_t fingerprint) {
+    size_t mask = table->indexSize - 1;
+    size_t slot = (size_t)(fingerprint ^ (fingerprint >> 32)) & mask;
+    while (table->index[slot] != 0 && table->shapes[table->index[slot] - 1]->fingerprint != fingerprint) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+bool QueryShapeTable_record(QueryShapeTable* table, uint64_t fingerprint, const char* queryString, uint64_t ns,
+                            bool succeeded, uint64_t rows) {
+    if (!table) return false;
+    
+    size_t slot = probe(table, fingerprint);
+    QueryShapeStats* shape;
+    if (table->index[slot] != 0) {
+        shape = table->shapes[table->index[slot] - 1];
+    } else {
+        if (table->count == table->capacity) {
+            table->untracked++;
+            return false;
+        }
+        shape = (QueryShapeStats*)QUERY_ALLOC(sizeof(QueryShapeStats));
+        if (!shape) {
+            table->untracked++;
+            return false;
+        }
+        memset(shape, 0, sizeof(QueryShapeStats));
+        shape->fingerprint = fingerprint;
+        Query_normalize(queryString, shape->text, sizeof(shape->text));
+        table->shapes[table->count++] = shape;
+        table->index[slot] = (uint32_t)table->count;
+    }
+    
+    shape->calls++;
+    if (succeeded) {
+        shape->rows += rows;
+    } else {
+        shape->failures++;
+    }
+    QueryLatencyHistogram_record(&shape->latency, ns);
+    return true;
+}
+
+size_t QueryShapeTable_count(const QueryShapeTable* table) {
+    return table ? table->count : 0;
+}
+
+const QueryShapeStats* QueryShapeTable_get(const QueryShapeTable* table, size_t index) {
+    if (!table || index >= table->count) return NULL;
+    return table->shapes[index];
+}
+
+const QueryShapeStats* QueryShapeTable_find(const QueryShapeTable* table, uint64_t fingerprint) {
+    if (!table) return NULL;
+    
+    size_t slot = probe(table, fingerprint);
+    return table->index[slot] != 0 ? table->shapes[table->index[slot] - 1] : NULL;
+}
+
+uint64_t QueryShapeTable_untracked(const QueryShapeTable* table) {
+    return table ? table->untracked : 0;
+}
+
+static int compare_total_time(const void* a, const void* b) {
+    const QueryShapeStats* x = *(const QueryShapeStats* const*)a;
+    const QueryShapeStats* y = *(const QueryShapeStats* const*)b;
+    if (x->latency.sum != y->latency.sum) return x->latency.sum > y->latency.sum ? -1 : 1;
+    return x->calls > y->calls ? -1 : x->calls < y->calls ? 1 : 0;
+}
+
+size_t QueryShapeTable_format(const QueryShapeTable* table, char* buffer, size_t size) {
+    if (buffer && size > 0) buffer[0] = '\0';
+    if (!table) return 0;
+    if (!buffer) size = 0;
+    
+    size_t length = 0;
+    if (table->count == 0) {
+        query_append(buffer, size, &length, "No queries recorded\n");
+    }
+    
+    // Sort a copy of the shape pointers; fall back to first-seen order without memory
+    const QueryShapeStats** order = table->count > 0 ?
+                                    (const QueryShapeStats**)QUERY_ALLOC(sizeof(QueryShapeStats*) * table->count) : NULL;
+    if (order) {
+        memcpy(order, table->shapes, sizeof(QueryShapeStats*) * table->count);
+        qsort(order, table->count, sizeof(QueryShapeStats*), compare_total_time);
+    }
+    
+    for (size_t i = 0; i < table->count; i++) {
+        const QueryShapeStats* shape = order ? order[i] : table->shapes[i];
+        const QueryLatencyHistogram* latency = &shape->latency;
+        query_append(buffer, size, &length, "%016llx  %s\n", (unsigned long long)shape->fingerprint, shape->text);
+        query_append(buffer, size, &length,
+                     "  calls %llu, failures %llu, rows %llu, total %.3f ms, mean %.3f ms, p50 %.3f ms, p90 %.3f ms, "
+                     "p99 %.3f ms, max %.3f ms\n",
+                     (unsigned long long)shape->calls, (unsigned long long)shape->failures,
+                     (unsigned long long)shape->rows, (double)latency->sum / 1e6,
+                     latency->count ? (double)latency->sum / (double)latency->count / 1e6 : 0.0,
+                     (double)QueryLatencyHistogram_percentile(latency, 0.50) / 1e6,
+                     (double)QueryLatencyHistogram_percentile(latency, 0.90) / 1e6,
+                     (double)QueryLatencyHistogram_percentile(latency, 0.99) / 1e6, (double)latency->max / 1e6);
+    }
+    if (order) {
+        QUERY_FREE(order);
+    }
+    if (table->untracked > 0) {
+        query_append(buffer, size, &length, "%llu calls of further shapes not tracked (table full)\n",
+                     (unsigned long long)table->untracked);
+    }
+    return length;
+}
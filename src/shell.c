@@ -1,30 +1,44 @@
 #include "gramarye_query/shell.h"
 #include "gramarye_query/query.h"
+#include "gramarye_query/engine.h"
 #include "gramarye_ecs/entity.h"  // Get EntityId type
-#include "mem.h"
+#include "gramarye_query/allocator.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <strings.h>  // For strcasecmp, strncasecmp
 
 // Query shell structure
 struct QueryShell {
     ECS* ecs;
+    QueryEngine* engine;        // Session engine: catalog, plan cache, statistics
     char* prompt;
     bool historyEnabled;
+    
+    // Last DIFF query and its result, compared against by the next DIFF
+    char* diffQuery;
+    QueryEngineResult diffBaseline;
 };
 
 QueryShell* QueryShell_new(ECS* ecs) {
     if (!ecs) return NULL;
     
-    QueryShell* shell = (QueryShell*)ALLOC(sizeof(QueryShell));
+    QueryShell* shell = (QueryShell*)QUERY_ALLOC(sizeof(QueryShell));
     if (!shell) return NULL;
     
     shell->ecs = ecs;
-    shell->prompt = (char*)ALLOC(32);
+    shell->engine = QueryEngine_new(ecs, NULL);
+    if (!shell->engine) {
+        QUERY_FREE(shell);
+        return NULL;
+    }
+    shell->prompt = (char*)QUERY_ALLOC(32);
     if (shell->prompt) {
         strcpy(shell->prompt, "query> ");
     }
     shell->historyEnabled = false;
+    shell->diffQuery = NULL;
+    memset(&shell->diffBaseline, 0, sizeof(QueryEngineResult));
     
     return shell;
 }
@@ -33,20 +47,26 @@ void QueryShell_destroy(QueryShell* shell) {
     if (!shell) return;
     
     if (shell->prompt) {
-        FREE(shell->prompt);
+        QUERY_FREE(shell->prompt);
     }
     
-    FREE(shell);
+    if (shell->diffQuery) {
+        QUERY_FREE(shell->diffQuery);
+    }
+    QueryEngineResult_free(&shell->diffBaseline);
+    QueryEngine_destroy(shell->engine);
+    
+    QUERY_FREE(shell);
 }
 
 void QueryShell_set_prompt(QueryShell* shell, const char* prompt) {
     if (!shell || !prompt) return;
     
     if (shell->prompt) {
-        FREE(shell->prompt);
+        QUERY_FREE(shell->prompt);
     }
     
-    shell->prompt = (char*)ALLOC(strlen(prompt) + 1);
+    shell->prompt = (char*)QUERY_ALLOC(strlen(prompt) + 1);
     if (shell->prompt) {
         strcpy(shell->prompt, prompt);
     }
@@ -58,6 +78,146 @@ void QueryShell_set_history_enabled(QueryShell* shell, bool enabled) {
     }
 }
 
+QueryEngine* QueryShell_get_engine(QueryShell* shell) {
+    return shell ? shell->engine : NULL;
+}
+
+static void print_entities(const char* label, QueryEngineResult* result) {
+    size_t entityCount = 0;
+    EntityId* entities = (EntityId*)QueryEngineResult_get_entities(result, &entityCount);
+    printf("%s: %zu\n", label, entityCount);
+    for (size_t i = 0; entities && i < entityCount && i < 10; i++) {
+        printf("  Entity: %llu:%llu\n",
+               (unsigned long long)entities[i].high,
+               (unsigned long long)entities[i].low);
+    }
+    if (entityCount > 10) {
+        printf("  ... and %zu more\n", entityCount - 10);
+    }
+}
+
+// DIFF <query>: the first run of a query records a baseline, later runs report
+// the change since the previous run and become the new baseline
+static void process_diff(QueryShell* shell, const char* query) {
+    while (*query == ' ') query++;
+    if (*query == '\0') {
+        printf("Usage: DIFF <query>\n");
+        return;
+    }
+    
+    QueryEngineResult current;
+    QueryStatus status = QueryEngine_execute(shell->engine, query, &current);
+    if (status != QUERY_SUCCESS) {
+        printf("Query error (%d)\n", status);
+        return;
+    }
+    if (current.data || (current.count > 0 && !current.entities)) {
+        printf("DIFF needs a SELECT entities query\n");
+        QueryEngineResult_free(&current);
+        return;
+    }
+    
+    if (shell->diffQuery && strcmp(shell->diffQuery, query) == 0) {
+        QueryEngineResult added;
+        QueryEngineResult removed;
+        status = QueryEngineResult_diff(&shell->diffBaseline, &current, &added, &removed);
+        if (status == QUERY_SUCCESS) {
+            print_entities("Entered", &added);
+            print_entities("Left", &removed);
+        } else {
+            printf("Diff error (%d)\n", status);
+        }
+        QueryEngineResult_free(&added);
+        QueryEngineResult_free(&removed);
+    } else {
+        char* copy = (char*)QUERY_ALLOC(strlen(query) + 1);
+        if (!copy) {
+            QueryEngineResult_free(&current);
+            return;
+        }
+        strcpy(copy, query);
+        if (shell->diffQuery) {
+            QUERY_FREE(shell->diffQuery);
+        }
+        shell->diffQuery = copy;
+        printf("Baseline recorded: %zu entities\n", current.count);
+    }
+    
+    QueryEngineResult_free(&shell->diffBaseline);
+    shell->diffBaseline = current;
+}
+
+// EXPLAIN ANALYZE <query>: run the query and print the operators that ran,
+// with rows and time per operator, then the time per phase
+static void process_explain_analyze(QueryShell* shell, const char* query) {
+    while (*query == ' ') query++;
+    if (*query == '\0') {
+        printf("Usage: EXPLAIN ANALYZE <query>\n");
+        return;
+    }
+    
+    QueryEngineResult result;
+    QueryStatus status = QueryEngine_analyze(shell->engine, query, &result);
+    if (status != QUERY_SUCCESS) {
+        printf("Query error (%d)\n", status);
+        return;
+    }
+    
+    size_t length = QueryStats_format(&result.stats, NULL, 0);
+    char* text = (char*)QUERY_ALLOC(length + 1);
+    if (text) {
+        QueryStats_format(&result.stats, text, length + 1);
+        printf("%s", text);
+        QUERY_FREE(text);
+    }
+    QueryEngineResult_free(&result);
+}
+
+// EXPLAIN <query>: the operators the query would run, with estimated rows
+// and cost, without running it
+static void process_explain(QueryShell* shell, const char* query) {
+    while (*query == ' ') query++;
+    if (*query == '\0') {
+        printf("Usage: EXPLAIN <query>\n");
+        return;
+    }
+    
+    QueryExplain explain;
+    QueryStatus status = QueryEngine_explain(shell->engine, query, &explain);
+    if (status != QUERY_SUCCESS) {
+        printf("Query error (%d)\n", status);
+        QueryExplain_free(&explain);
+        return;
+    }
+    
+    size_t length = QueryExplain_format(&explain, NULL, 0);
+    char* text = (char*)QUERY_ALLOC(length + 1);
+    if (text) {
+        QueryExplain_format(&explain, text, length + 1);
+        printf("%s", text);
+        QUERY_FREE(text);
+    }
+    QueryExplain_free(&explain);
+}
+
+// STATS: calls, rows and latency percentiles per query shape, most total
+// time first
+static void process_stats(QueryShell* shell) {
+    const QueryShapeTable* shapes = QueryEngine_get_shapes(shell->engine);
+    if (!shapes) {
+        printf("Query shape statistics are disabled\n");
+        return;
+    }
+    
+    size_t length = QueryShapeTable_format(shapes, NULL, 0);
+    char* text = (char*)QUERY_ALLOC(length + 1);
+    if (text) {
+        QueryShapeTable_format(shapes, text, length + 1);
+        printf("%s", text);
+        QUERY_FREE(text);
+    }
+}
+
 void QueryShell_process_command(QueryShell* shell, const char* command) {
     if (!shell || !command) return;
     
@@ -71,8 +231,17 @@ void QueryShell_process_command(QueryShell* shell, const char* command) {
         printf("  SELECT entities WHERE has_any(ComponentName1, ComponentName2)\n");
         printf("  SELECT entities WHERE not_has(ComponentName)\n");
         printf("  COUNT entities WHERE has(ComponentName)\n");
+        printf("  COUNT entities WHERE <condition> APPROX [n] - Estimate from n sampled candidates\n");
+        printf("  SELECT entities WHERE <condition> SAMPLE n - n random matching entities\n");
+        printf("  SELECT entities WHERE Component.field < value - Filter on a registered field\n");
+        printf("  CREATE [HASH] INDEX ON Component.field\n");
         printf("  SHOW ComponentName OF entity <high>:<low>\n");
         printf("  SHOW ALL OF entity <high>:<low>\n");
+        printf("  DIFF <query> - Run a SELECT and list entities that entered/left since the last DIFF of it\n");
+        printf("  EXPLAIN <query> - Show the operators a query would run, with estimated rows and cost\n");
+        printf("  EXPLAIN ANALYZE <query> - Run a query and show its operators, rows and timings\n");
+        printf("  STATS - Show calls, rows and latency per query shape\n");
+        printf("  STATS RESET - Forget the recorded query statistics\n");
         printf("  HELP - Show this help\n");
         printf("  EXIT - Exit shell\n");
         printf("\n");
@@ -85,13 +254,42 @@ void QueryShell_process_command(QueryShell* shell, const char* command) {
         return;  // Caller should handle exit
     }
     
+    if (strncmp(command, "DIFF ", 5) == 0 || strncmp(command, "diff ", 5) == 0) {
+        process_diff(shell, command + 5);
+        return;
+    }
+    
+    if (strcasecmp(command, "STATS") == 0) {
+        process_stats(shell);
+        return;
+    }
+    if (strcasecmp(command, "STATS RESET") == 0) {
+        QueryEngine_reset_stats(shell->engine);
+        printf("Query statistics reset\n");
+        return;
+    }
+    
+    if (strncasecmp(command, "EXPLAIN ANALYZE ", 16) == 0) {
+        process_explain_analyze(shell, command + 16);
+        return;
+    }
+    if (strncasecmp(command, "EXPLAIN ", 8) == 0) {
+        process_explain(shell, command + 8);
+        return;
+    }
+    
     // Execute query
     QueryEngineResult result;
-    QueryStatus status = Query_execute(shell->ecs, command, &result);
+    QueryStatus status = QueryEngine_execute(shell->engine, command, &result);
     
     if (status == QUERY_SUCCESS) {
         // Check if this is a SHOW query (has data but no entities)
-        if (result.data != NULL) {
+        if (result.data != NULL && strncasecmp(command, "COUNT", 5) == 0) {
+            // COUNT ... APPROX carries its error bounds
+            const QueryCountEstimate* estimate = (const QueryCountEstimate*)result.data;
+            printf("Found ~%zu entities (95%% CI %.0f-%.0f, sampled %zu of %zu)\n",
+                   result.count, estimate->low, estimate->high, estimate->sampled, estimate->population);
+        } else if (result.data != NULL) {
             // SHOW query result - component data is in result->data
             printf("Component data retrieved (size: %zu bytes)\n", result.count);
             // Note: Component data structure is type-specific, so we can't generically print it
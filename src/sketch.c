@@ -0,0 +1,378 @@
+#include "gramarye_query/sketch.h"
+#include "gramarye_query/allocator.h"
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <math.h>
+
+struct HyperLogLog {
+    uint8_t* registers;         // Longest run of leading zeros + 1 per bucket
+    size_t count;               // 2^precision
+    unsigned precision;
+};
+
+// Values of weight 2^level
+typedef struct {
+    double* items;
+    size_t size;
+    size_t capacity;            // Allocated, not the compaction threshold
+} Compactor;
+
+struct QuantileSketch {
+    Compactor* levels;
+    size_t levelCount;
+    size_t k;
+    uint64_t count;
+    double min;
+    double max;
+    uint64_t random;            // Picks which half of a compacted level moves up
+};
+
+// Murmur3 finalizer: spreads keys that differ in a few bits over all 64
+static uint64_t mix64(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xFF51AFD7ED558CCDULL;
+    key ^= key >> 33;
+    key *= 0xC4CEB9FE1A85EC53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+static unsigned leading_zeros(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return value ? (unsigned)__builtin_clzll(value) : 64;
+#else
+    unsigned zeros = 0;
+    for (uint64_t bit = 1ULL << 63; bit && !(value & bit); bit >>= 1) {
+        zeros++;
+    }
+    return zeros;
+#endif
+}
+
+HyperLogLog* HyperLogLog_new(unsigned precision) {
+    if (precision < HLL_MIN_PRECISION || precision > HLL_MAX_PRECISION) {
+        return NULL;
+    }
+    
+    HyperLogLog* hll = (HyperLogLog*)QUERY_ALLOC(sizeof(HyperLogLog));
+    if (!hll) return NULL;
+    
+    hll->precision = precision;
+    hll->count = (size_t)1 << precision;
+    hll->registers = (uint8_t*)QUERY_ALLOC(hll->count);
+    if (!hll->registers) {
+        QUERY_FREE(hll);
+        return NULL;
+    }
+    memset(hll->registers, 0, hll->count);
+    return hll;
+}
+
+void HyperLogLog_destroy(HyperLogLog* hll) {
+    if (!hll) return;
+    QUERY_FREE(hll->registers);
+    QUERY_FREE(hll);
+}
+
+void HyperLogLog_add_key(HyperLogLog* hll, uint64_t key) {
+    if (!hll) return;
+    
+    // Top bits pick the register, the rest give the run of zeros
+    uint64_t hash = mix64(key);
+    size_t index = (size_t)(hash >> (64 - hll->precision));
+    uint64_t rest = hash << hll->precision;
+    unsigned rank = rest ? leading_zeros(rest) + 1 : 64 - hll->precision + 1;
+    if (rank > hll->registers[index]) {
+        hll->registers[index] = (uint8_t)rank;
+    }
+}
+
+void HyperLogLog_add_double(HyperLogLog* hll, double value) {
+    if (value == 0.0) value = 0.0; // Fold -0.0
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    HyperLogLog_add_key(hll, bits);
+}
+
+bool HyperLogLog_merge(HyperLogLog* into, const HyperLogLog* from) {
+    if (!into || !from || into->precision != from->precision) {
+        return false;
+    }
+    for (size_t i = 0; i < into->count; i++) {
+        if (from->registers[i] > into->registers[i]) {
+            into->registers[i] = from->registers[i];
+        }
+    }
+    return true;
+}
+
+double HyperLogLog_estimate(const HyperLogLog* hll) {
+    if (!hll) return 0.0;
+    
+    double m = (double)hll->count;
+    double sum = 0.0;
+    size_t zeros = 0;
+    for (size_t i = 0; i < hll->count; i++) {
+        sum += ldexp(1.0, -(int)hll->registers[i]);
+        if (hll->registers[i] == 0) zeros++;
+    }
+    
+    double alpha;
+    switch (hll->count) {
+        case 16: alpha = 0.673; break;
+        case 32: alpha = 0.697; break;
+        case 64: alpha = 0.709; break;
+        default: alpha = 0.7213 / (1.0 + 1.079 / m); break;
+    }
+    double estimate = alpha * m * m / sum;
+    
+    // Small cardinalities: linear counting over the empty registers is more accurate
+    if (estimate <= 2.5 * m && zeros > 0) {
+        estimate = m * log(m / (double)zeros);
+    }
+    return estimate;
+}
+
+double HyperLogLog_relative_error(const HyperLogLog* hll) {
+    return hll ? 1.04 / sqrt((double)hll->count) : 0.0;
+}
+
+QuantileSketch* QuantileSketch_new(size_t k) {
+    if (k < KLL_MIN_K) return NULL;
+    
+    QuantileSketch* sketch = (QuantileSketch*)QUERY_ALLOC(sizeof(QuantileSketch));
+    if (!sketch) return NULL;
+    
+    memset(sketch, 0, sizeof(QuantileSketch));
+    sketch->k = k;
+    sketch->min = NAN;
+    sketch->max = NAN;
+    sketch->random = 0x9E3779B97F4A7C15ULL;
+    return sketch;
+}
+
+void QuantileSketch_destroy(QuantileSketch* sketch) {
+    if (!sketch) return;
+    for (size_t h = 0; h < sketch->levelCount; h++) {
+        if (sketch->levels[h].items) QUERY_FREE(sketch->levels[h].items);
+    }
+    if (sketch->levels) QUERY_FREE(sketch->levels);
+    QUERY_FREE(sketch);
+}
+
+// Compaction threshold of level h: k at the top, shrinking by 2/3 per level below
+static size_t level_capacity(const QuantileSketch* sketch, size_t h) {
+    double capacity = (double)sketch->k;
+    for (size_t depth = sketch->levelCount - 1 - h; depth > 0 && capacity > 2.0; depth--) {
+        capacity *= 2.0 / 3.0;
+    }
+    size_t rounded = (size_t)ceil(capacity);
+    return rounded < 2 ? 2 : rounded;
+}
+
+static bool ensure_levels(QuantileSketch* sketch, size_t levelCount) {
+    if (levelCount <= sketch->levelCount) return true;
+    
+    Compactor* levels = (Compactor*)QUERY_ALLOC(sizeof(Compactor) * levelCount);
+    if (!levels) return false;
+    
+    if (sketch->levels) {
+        memcpy(levels, sketch->levels, sizeof(Compactor) * sketch->levelCount);
+        QUERY_FREE(sketch->levels);
+    }
+    memset(levels + sketch->levelCount, 0, sizeof(Compactor) * (levelCount - sketch->levelCount));
+    sketch->levels = levels;
+    sketch->levelCount = levelCount;
+    return true;
+}
+
+static bool compactor_reserve(Compactor* level, size_t size) {
+    if (size <= level->capacity) return true;
+    
+    size_t capacity = level->capacity ? level->capacity : 16;
+    while (capacity < size) capacity *= 2;
+    double* items = (double*)QUERY_ALLOC(sizeof(double) * capacity);
+    if (!items) return false;
+    
+    if (level->items) {
+        memcpy(items, level->items, sizeof(double) * level->size);
+        QUERY_FREE(level->items);
+    }
+    level->items = items;
+    level->capacity = capacity;
+    return true;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Move every other value of level h up one level at twice the weight. An odd
+// value out (the largest) stays behind so the total weight is unchanged.
+static bool compact_level(QuantileSketch* sketch, size_t h) {
+    if (!ensure_levels(sketch, h + 2)) return false;
+    
+    Compactor* level = &sketch->levels[h];
+    qsort(level->items, level->size, sizeof(double), compare_doubles);
+    
+    size_t paired = level->size & ~(size_t)1;
+    Compactor* above = &sketch->levels[h + 1];
+    if (!compactor_reserve(above, above->size + paired / 2)) return false;
+    
+    sketch->random ^= sketch->random << 13;
+    sketch->random ^= sketch->random >> 7;
+    sketch->random ^= sketch->random << 17;
+    size_t offset = (size_t)(sketch->random & 1);
+    for (size_t i = offset; i < paired; i += 2) {
+        above->items[above->size++] = level->items[i];
+    }
+    
+    if (paired < level->size) {
+        level->items[0] = level->items[paired];
+    }
+    level->size -= paired;
+    return true;
+}
+
+// Compact full levels bottom-up; each compaction only feeds the level above
+static bool compress(QuantileSketch* sketch) {
+    for (size_t h = 0; h < sketch->levelCount; h++) {
+        if (sketch->levels[h].size >= level_capacity(sketch, h) && !compact_level(sketch, h)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool QuantileSketch_add(QuantileSketch* sketch, double value) {
+    if (!sketch) return false;
+    if (isnan(value)) return true;
+    
+    if (!ensure_levels(sketch, 1) || !compactor_reserve(&sketch->levels[0], sketch->levels[0].size + 1)) {
+        return false;
+    }
+    sketch->levels[0].items[sketch->levels[0].size++] = value;
+    
+    if (sketch->count == 0 || value < sketch->min) sketch->min = value;
+    if (sketch->count == 0 || value > sketch->max) sketch->max = value;
+    sketch->count++;
+    
+    if (sketch->levels[0].size >= level_capacity(sketch, 0)) {
+        return compress(sketch);
+    }
+    return true;
+}
+
+bool QuantileSketch_merge(QuantileSketch* into, const QuantileSketch* from) {
+    if (!into || !from || into->k != from->k) return false;
+    if (from->count == 0) return true;
+    
+    if (!ensure_levels(into, from->levelCount)) return false;
+    for (size_t h = 0; h < from->levelCount; h++) {
+        const Compactor* source = &from->levels[h];
+        Compactor* target = &into->levels[h];
+        if (source->size == 0) continue;
+        if (!compactor_reserve(target, target->size + source->size)) return false;
+        memcpy(target->items + target->size, source->items, sizeof(double) * source->size);
+        target->size += source->size;
+    }
+    
+    if (into->count == 0 || from->min < into->min) into->min = from->min;
+    if (into->count == 0 || from->max > into->max) into->max = from->max;
+    into->count += from->count;
+    return compress(into);
+}
+
+uint64_t QuantileSketch_count(const QuantileSketch* sketch) {
+    return sketch ? sketch->count : 0;
+}
+
+typedef struct {
+    double value;
+    uint64_t weight;
+} WeightedValue;
+
+static int compare_weighted(const void* a, const void* b) {
+    double x = ((const WeightedValue*)a)->value;
+    double y = ((const WeightedValue*)b)->value;
+    return (x > y) - (x < y);
+}
+
+bool QuantileSketch_quantiles(const QuantileSketch* sketch, const double* ps, size_t count, double* outValues) {
+    if (!sketch || (count > 0 && (!ps || !outValues))) return false;
+    
+    if (sketch->count == 0) {
+        for (size_t i = 0; i < count; i++) {
+            outValues[i] = NAN;
+        }
+        return true;
+    }
+    
+    size_t retained = QuantileSketch_retained(sketch);
+    WeightedValue* values = (WeightedValue*)QUERY_ALLOC(sizeof(WeightedValue) * retained);
+    if (!values) return false;
+    
+    size_t n = 0;
+    for (size_t h = 0; h < sketch->levelCount; h++) {
+        for (size_t i = 0; i < sketch->levels[h].size; i++) {
+            values[n].value = sketch->levels[h].items[i];
+            values[n].weight = (uint64_t)1 << h;
+            n++;
+        }
+    }
+    qsort(values, n, sizeof(WeightedValue), compare_weighted);
+    
+    for (size_t i = 0; i < count; i++) {
+        double p = ps[i];
+        if (isnan(p) || p <= 0.0) {
+            outValues[i] = sketch->min;
+            continue;
+        }
+        if (p >= 1.0) {
+            outValues[i] = sketch->max;
+            continue;
+        }
+        
+        // First value whose cumulative weight reaches the rank
+        double rank = p * (double)sketch->count;
+        uint64_t cumulative = 0;
+        outValues[i] = sketch->max;
+        for (size_t v = 0; v < n; v++) {
+            cumulative += values[v].weight;
+            if ((double)cumulative >= rank) {
+                outValues[i] = values[v].value;
+                break;
+            }
+        }
+    }
+    
+    QUERY_FREE(values);
+    return true;
+}
+
+double QuantileSketch_quantile(const QuantileSketch* sketch, double p) {
+    double value = NAN;
+    if (!QuantileSketch_quantiles(sketch, &p, 1, &value)) {
+        return NAN;
+    }
+    return value;
+}
+
+double QuantileSketch_rank_error(const QuantileSketch* sketch) {
+    // Empirical fit for KLL with the 2/3 capacity decay
+    return sketch ? 2.446 / pow((double)sketch->k, 0.9433) : 0.0;
+}
+
+size_t QuantileSketch_retained(const QuantileSketch* sketch) {
+    if (!sketch) return 0;
+    
+    size_t retained = 0;
+    for (size_t h = 0; h < sketch->levelCount; h++) {
+        retained += sketch->levels[h].size;
+    }
+    return retained;
+}
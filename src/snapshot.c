@@ -0,0 +1,424 @@
+#include "gramarye_query/snapshot.h"
+#include "gramarye_query/executor.h"
+#include "gramarye_query/catalog.h"
+#include "gramarye_query/entity_set.h"
+#include "gramarye_query/parser.h"
+#include "gramarye_query/query.h"
+#include "gramarye_ecs/ecs.h"
+#include "gramarye_ecs/query.h"
+#include "gramarye_ecs/entity.h"
+#include "gramarye_ecs/component.h"
+#include "arena.h"
+#include "gramarye_query/allocator.h"
+#include "internal.h"
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#if !defined(__GNUC__) && !defined(__clang__)
+#error "snapshot.c needs the __atomic builtins"
+#endif
+
+// Sequentially consistent loads and stores: the reclamation argument below
+// relies on a single order of slot announcements and pointer swaps
+#define LOAD(ptr) __atomic_load_n((ptr), __ATOMIC_SEQ_CST)
+#define STORE(ptr, value) __atomic_store_n((ptr), (value), __ATOMIC_SEQ_CST)
+
+// Reader slot states
+#define SLOT_FREE 0u
+#define SLOT_ATTACHED 1u
+
+// Epoch value of a reader slot that has nothing pinned
+#define EPOCH_IDLE 0
+
+typedef struct {
+    char* name;
+    ComponentTypeId liveType;
+    size_t size;
+} TrackedType;
+
+struct QuerySnapshot {
+    Arena_T arena;
+    ECS* ecs;                       // Private copy of the tracked components
+    QueryCatalog* catalog;          // Field schema over ecs
+    EntityIndexMap* liveIds;        // Live id -> dense index
+    EntityIndexMap* snapshotIds;    // Snapshot id -> the same dense index
+    ComponentTypeId* types;         // Snapshot type of each tracked type, in tracking order
+    size_t* owners;                 // Entities holding each of them
+    size_t typeCount;
+    size_t typeCapacity;
+    uint64_t epoch;
+    uint64_t retiredAt;             // Global epoch when it was replaced
+    QuerySnapshot* next;            // Retired list
+};
+
+struct QuerySnapshotStore {
+    ECS* ecs;
+    QueryCatalog* catalog;
+    TrackedType* types;
+    ComponentTypeId* liveTypes;     // types[i].liveType, for ECS queries
+    size_t typeCount;
+    size_t typeCapacity;
+    
+    // Shared with readers, accessed atomically
+    QuerySnapshot* current;
+    uint64_t epoch;                                     // Global epoch, starts at 1
+    uint32_t slots[QUERY_SNAPSHOT_MAX_READERS];
+    uint64_t pinned[QUERY_SNAPSHOT_MAX_READERS];        // Epoch seen at pin, or EPOCH_IDLE
+    
+    // Simulation thread only
+    QuerySnapshot* retired;
+    QuerySnapshot* spare;           // Released by every reader, refreshed by the next publish
+    QuerySnapshotStats stats;
+};
+
+static void snapshot_destroy(QuerySnapshot* snapshot) {
+    if (!snapshot) return;
+    if (snapshot->catalog) QueryCatalog_destroy(snapshot->catalog);
+    if (snapshot->liveIds) EntityIndexMap_destroy(snapshot->liveIds);
+    if (snapshot->snapshotIds) EntityIndexMap_destroy(snapshot->snapshotIds);
+    if (snapshot->ecs) ECS_destroy(snapshot->ecs);
+    if (snapshot->arena) Arena_free(snapshot->arena);
+    if (snapshot->types) QUERY_FREE(snapshot->types);
+    if (snapshot->owners) QUERY_FREE(snapshot->owners);
+    QUERY_FREE(snapshot);
+}
+
+QuerySnapshotStore* QuerySnapshotStore_new(ECS* ecs, QueryCatalog* catalog) {
+    if (!ecs) return NULL;
+    
+    QuerySnapshotStore* store = (QuerySnapshotStore*)QUERY_ALLOC(sizeof(QuerySnapshotStore));
+    if (!store) return NULL;
+    
+    memset(store, 0, sizeof(QuerySnapshotStore));
+    store->ecs = ecs;
+    store->catalog = catalog;
+    store->epoch = 1;
+    return store;
+}
+
+void QuerySnapshotStore_destroy(QuerySnapshotStore* store) {
+    if (!store) return;
+    
+    snapshot_destroy(store->current);
+    snapshot_destroy(store->spare);
+    while (store->retired) {
+        QuerySnapshot* next = store->retired->next;
+        snapshot_destroy(store->retired);
+        store->retired = next;
+    }
+    for (size_t i = 0; i < store->typeCount; i++) {
+        QUERY_FREE(store->types[i].name);
+    }
+    if (store->types) QUERY_FREE(store->types);
+    if (store->liveTypes) QUERY_FREE(store->liveTypes);
+    QUERY_FREE(store);
+}
+
+QueryStatus QuerySnapshotStore_track(QuerySnapshotStore* store, const char* componentName) {
+    if (!store || !componentName) {
+        return QUERY_ERROR_INVALID_SYNTAX;
+    }
+    
+    ComponentTypeId typeId = query_type_by_name(store->ecs, componentName);
+    ComponentType* type = typeId != COMPONENT_TYPE_INVALID ? ECS_get_component_type(store->ecs, typeId) : NULL;
+    if (!type) {
+        return QUERY_ERROR_EXECUTION;
+    }
+    for (size_t i = 0; i < store->typeCount; i++) {
+        if (store->types[i].liveType == typeId) return QUERY_SUCCESS;
+    }
+    
+    if (store->typeCount >= store->typeCapacity) {
+        size_t newCapacity = store->typeCapacity ? store->typeCapacity * 2 : 8;
+        TrackedType* types = (TrackedType*)QUERY_ALLOC(sizeof(TrackedType) * newCapacity);
+        ComponentTypeId* liveTypes = (ComponentTypeId*)QUERY_ALLOC(sizeof(ComponentTypeId) * newCapacity);
+        if (!types || !liveTypes) {
+            if (types) QUERY_FREE(types);
+            if (liveTypes) QUERY_FREE(liveTypes);
+            return QUERY_ERROR_EXECUTION;
+        }
+        if (store->types) {
+            memcpy(types, store->types, sizeof(TrackedType) * store->typeCount);
+            memcpy(liveTypes, store->liveTypes, sizeof(ComponentTypeId) * store->typeCount);
+            QUERY_FREE(store->types);
+            QUERY_FREE(store->liveTypes);
+        }
+        store->types = types;
+        store->liveTypes = liveTypes;
+        store->typeCapacity = newCapacity;
+    }
+    
+    size_t length = strlen(componentName);
+    TrackedType* tracked = &store->types[store->typeCount];
+    tracked->name = (char*)QUERY_ALLOC(length + 1);
+    if (!tracked->name) return QUERY_ERROR_EXECUTION;
+    memcpy(tracked->name, componentName, length + 1);
+    tracked->liveType = typeId;
+    tracked->size = type->size;
+    store->liveTypes[store->typeCount] = typeId;
+    store->typeCount++;
+    return QUERY_SUCCESS;
+}
+
+// Empty snapshot with room for the tracked types, sized like the latest one
+static QuerySnapshot* snapshot_new(QuerySnapshotStore* store) {
+    QuerySnapshot* snapshot = (QuerySnapshot*)QUERY_ALLOC(sizeof(QuerySnapshot));
+    if (!snapshot) return NULL;
+    memset(snapshot, 0, sizeof(QuerySnapshot));
+    
+    size_t capacity = store->typeCapacity ? store->typeCapacity : 1;
+    snapshot->arena = Arena_new();
+    snapshot->ecs = snapshot->arena ? ECS_new(snapshot->arena) : NULL;
+    snapshot->catalog = snapshot->ecs ? QueryCatalog_new(snapshot->ecs) : NULL;
+    snapshot->liveIds = EntityIndexMap_new(store->stats.entityCount);
+    snapshot->snapshotIds = EntityIndexMap_new(store->stats.entityCount);
+    snapshot->types = (ComponentTypeId*)QUERY_ALLOC(sizeof(ComponentTypeId) * capacity);
+    snapshot->owners = (size_t*)QUERY_ALLOC(sizeof(size_t) * capacity);
+    snapshot->typeCapacity = capacity;
+    if (!snapshot->catalog || !snapshot->liveIds || !snapshot->snapshotIds || !snapshot->types ||
+        !snapshot->owners) {
+        snapshot_destroy(snapshot);
+        return NULL;
+    }
+    return snapshot;
+}
+
+// Bring snapshot up to date with every tracked component of every entity
+// holding one. New holders get fresh snapshot ids; both maps hand out the
+// same dense index for an entity so results can be translated back. Data is
+// copied over the previous copy in place, so refreshing a snapshot of the
+// same entities allocates nothing of its own. The ECS cannot take components
+// away, so this fails if an entity lost one (or every one) since snapshot
+// was last refreshed.
+static bool refresh(QuerySnapshotStore* store, QuerySnapshot* snapshot) {
+    if (store->typeCount > snapshot->typeCapacity) return false;
+    for (; snapshot->typeCount < store->typeCount; snapshot->typeCount++) {
+        const TrackedType* tracked = &store->types[snapshot->typeCount];
+        ComponentTypeId typeId = ECS_register_component_type(snapshot->ecs, tracked->name, tracked->size);
+        if (typeId == COMPONENT_TYPE_INVALID) return false;
+        snapshot->types[snapshot->typeCount] = typeId;
+        snapshot->owners[snapshot->typeCount] = 0;
+    }
+    
+    struct QueryResult holders = {NULL, 0, 0};
+    if (store->typeCount > 0) {
+        holders = ECS_query_entities_any(store->ecs, store->liveTypes, store->typeCount);
+    }
+    EntityRegistry* registry = ECS_get_entity_registry(snapshot->ecs);
+    bool ok = true;
+    for (size_t i = 0; ok && i < holders.count; i++) {
+        size_t known = EntityIndexMap_count(snapshot->liveIds);
+        uint32_t index = EntityIndexMap_get_or_add(snapshot->liveIds, holders.entities[i]);
+        ok = index != ENTITY_INDEX_INVALID;
+        if (ok && index == known) {
+            ok = EntityIndexMap_get_or_add(snapshot->snapshotIds, Entity_create(registry)) == index;
+        }
+    }
+    ok = ok && EntityIndexMap_count(snapshot->liveIds) == holders.count; // Every known entity still holds one
+    if (holders.entities) QueryResult_free(&holders);
+    
+    // One storage walk per type
+    for (size_t t = 0; ok && t < store->typeCount; t++) {
+        struct QueryResult owners = ECS_query_entities(store->ecs, &store->liveTypes[t], 1);
+        size_t copied = 0;
+        for (size_t i = 0; i < owners.count; i++) {
+            const void* data = ECS_get_component(store->ecs, owners.entities[i], store->liveTypes[t]);
+            uint32_t index = EntityIndexMap_find(snapshot->liveIds, owners.entities[i]);
+            if (!data || index == ENTITY_INDEX_INVALID) continue;
+            EntityId copy = EntityIndexMap_entity_at(snapshot->snapshotIds, index);
+            void* previous = ECS_get_component(snapshot->ecs, copy, snapshot->types[t]);
+            if (previous) {
+                memcpy(previous, data, store->types[t].size);
+            } else {
+                ECS_add_component(snapshot->ecs, copy, snapshot->types[t], data);
+                snapshot->owners[t]++;
+            }
+            copied++;
+        }
+        // Owners are only ever added, so equal counts mean the same owners
+        ok = snapshot->owners[t] == copied;
+        if (owners.entities) QueryResult_free(&owners);
+    }
+    
+    return ok && QueryCatalog_copy_schema(snapshot->catalog, store->catalog) == QUERY_SUCCESS;
+}
+
+// Refresh the spare snapshot when there is one and its entities still fit,
+// otherwise copy into a new one
+static QuerySnapshot* capture(QuerySnapshotStore* store) {
+    QuerySnapshot* snapshot = store->spare;
+    store->spare = NULL;
+    if (snapshot && refresh(store, snapshot)) {
+        store->stats.reused++;
+        return snapshot;
+    }
+    snapshot_destroy(snapshot);
+    
+    snapshot = snapshot_new(store);
+    if (snapshot && !refresh(store, snapshot)) {
+        snapshot_destroy(snapshot);
+        snapshot = NULL;
+    }
+    return snapshot;
+}
+
+// Release retired snapshots older than every pinned reader: the first one
+// becomes the spare for the next publish, the rest are freed. A reader
+// announces its epoch before loading current, so one pinned at or before a
+// snapshot's retirement may hold it, and one pinned later cannot.
+static void reclaim(QuerySnapshotStore* store) {
+    uint64_t oldest = UINT64_MAX;
+    for (size_t i = 0; i < QUERY_SNAPSHOT_MAX_READERS; i++) {
+        uint64_t pinned = LOAD(&store->pinned[i]);
+        if (pinned != EPOCH_IDLE && pinned < oldest) oldest = pinned;
+    }
+    
+    QuerySnapshot** link = &store->retired;
+    while (*link) {
+        QuerySnapshot* snapshot = *link;
+        if (snapshot->retiredAt < oldest) {
+            *link = snapshot->next;
+            if (!store->spare) {
+                snapshot->next = NULL;
+                store->spare = snapshot;
+            } else {
+                snapshot_destroy(snapshot);
+            }
+            store->stats.reclaimed++;
+            store->stats.retired--;
+        } else {
+            link = &snapshot->next;
+        }
+    }
+}
+
+QueryStatus QuerySnapshotStore_publish(QuerySnapshotStore* store) {
+    if (!store) {
+        return QUERY_ERROR_INVALID_SYNTAX;
+    }
+    
+    uint64_t start = query_now_ns();
+    QuerySnapshot* snapshot = capture(store);
+    if (!snapshot) {
+        return QUERY_ERROR_EXECUTION;
+    }
+    snapshot->epoch = LOAD(&store->epoch);
+    
+    // Swap, then advance the epoch: readers announcing the new epoch load the new snapshot
+    QuerySnapshot* previous = __atomic_exchange_n(&store->current, snapshot, __ATOMIC_SEQ_CST);
+    uint64_t retiredAt = __atomic_fetch_add(&store->epoch, 1, __ATOMIC_SEQ_CST);
+    if (previous) {
+        previous->retiredAt = retiredAt;
+        previous->next = store->retired;
+        store->retired = previous;
+        store->stats.retired++;
+    }
+    reclaim(store);
+    
+    store->stats.epoch = snapshot->epoch;
+    store->stats.published++;
+    store->stats.entityCount = EntityIndexMap_count(snapshot->liveIds);
+    store->stats.lastPublishMs = (double)(query_now_ns() - start) / 1e6;
+    return QUERY_SUCCESS;
+}
+
+int QuerySnapshotStore_attach_reader(QuerySnapshotStore* store) {
+    if (!store) return -1;
+    
+    for (int i = 0; i < QUERY_SNAPSHOT_MAX_READERS; i++) {
+        uint32_t expected = SLOT_FREE;
+        if (__atomic_compare_exchange_n(&store->slots[i], &expected, SLOT_ATTACHED, false,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void QuerySnapshotStore_detach_reader(QuerySnapshotStore* store, int reader) {
+    if (!store || reader < 0 || reader >= QUERY_SNAPSHOT_MAX_READERS) return;
+    STORE(&store->pinned[reader], (uint64_t)EPOCH_IDLE);
+    STORE(&store->slots[reader], SLOT_FREE);
+}
+
+QuerySnapshot* QuerySnapshotStore_pin(QuerySnapshotStore* store, int reader) {
+    if (!store || reader < 0 || reader >= QUERY_SNAPSHOT_MAX_READERS) return NULL;
+    
+    STORE(&store->pinned[reader], LOAD(&store->epoch));
+    return LOAD(&store->current);
+}
+
+void QuerySnapshotStore_unpin(QuerySnapshotStore* store, int reader) {
+    if (!store || reader < 0 || reader >= QUERY_SNAPSHOT_MAX_READERS) return;
+    STORE(&store->pinned[reader], (uint64_t)EPOCH_IDLE);
+}
+
+QuerySnapshotStats QuerySnapshotStore_get_stats(const QuerySnapshotStore* store) {
+    QuerySnapshotStats stats;
+    memset(&stats, 0, sizeof(stats));
+    if (store) {
+        stats = store->stats;
+    }
+    return stats;
+}
+
+uint64_t QuerySnapshot_epoch(const QuerySnapshot* snapshot) {
+    return snapshot ? snapshot->epoch : 0;
+}
+
+// Snapshot ids in a result back to the live ones
+static void translate_result(const QuerySnapshot* snapshot, QueryEngineResult* result) {
+    EntityId* entities = (EntityId*)result->entities;
+    for (size_t i = 0; entities && i < result->count; i++) {
+        uint32_t index = EntityIndexMap_find(snapshot->snapshotIds, entities[i]);
+        if (index != ENTITY_INDEX_INVALID) {
+            entities[i] = EntityIndexMap_entity_at(snapshot->liveIds, index);
+        }
+    }
+}
+
+QueryStatus QuerySnapshot_execute(QuerySnapshot* snapshot, const char* queryString, QueryEngineResult* outResult) {
+    if (!snapshot || !queryString || !outResult) {
+        return QUERY_ERROR_INVALID_SYNTAX;
+    }
+    
+    QueryParser* parser = QueryParser_new(queryString);
+    if (!parser) {
+        return QUERY_ERROR_PARSE;
+    }
+    
+    QueryAST* ast = QueryParser_parse(parser);
+    if (!ast) {
+        QueryParser_destroy(parser);
+        return QUERY_ERROR_PARSE;
+    }
+    
+    // SHOW names a live entity; look at its copy
+    if (QueryAST_get_type(ast) == AST_SHOW) {
+        ShowQueryData* showData = (ShowQueryData*)QueryAST_get_data(ast);
+        if (showData && showData->entityId) {
+            EntityId entity = {showData->entityId->high, showData->entityId->low};
+            uint32_t index = EntityIndexMap_find(snapshot->liveIds, entity);
+            if (index != ENTITY_INDEX_INVALID) {
+                entity = EntityIndexMap_entity_at(snapshot->snapshotIds, index);
+                showData->entityId->high = entity.high;
+                showData->entityId->low = entity.low;
+            }
+        }
+    }
+    
+    QueryStatus status;
+    if (QueryAST_get_type(ast) == AST_CREATE_INDEX) {
+        status = QUERY_ERROR_EXECUTION; // Snapshots are read-only
+    } else {
+        status = QueryExecutor_execute_catalog(snapshot->ecs, snapshot->catalog, ast, NULL, 0, outResult);
+        if (status == QUERY_SUCCESS) {
+            translate_result(snapshot, outResult);
+        }
+    }
+    
+    QueryAST_destroy(ast);
+    QueryParser_destroy(parser);
+    return status;
+}
@@ -0,0 +1,366 @@
+#include "gramarye_query/spatial_index.h"
+#include "gramarye_query/entity_set.h"
+#include "gramarye_ecs/entity.h"
+#include "gramarye_query/allocator.h"
+#include "internal.h"
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+
+#define CELL_NONE QUERY_GROUP_NONE
+
+typedef struct {
+    EntityId entity;
+    uint32_t slot;              // Dense index from the entity map
+    double x;
+    double y;
+} SpatialEntry;
+
+typedef struct {
+    int32_t cx;
+    int32_t cy;
+    SpatialEntry* entries;
+    size_t count;
+    size_t capacity;
+} SpatialCell;
+
+struct SpatialIndex {
+    double cellSize;
+    
+    SpatialCell* cells;         // Every cell ever occupied; emptied cells are kept for reuse
+    size_t cellCount;
+    size_t cellCapacity;
+    size_t occupiedCount;
+    
+    uint32_t* table;            // Open addressing: cell index + 1, 0 for empty
+    size_t tableCapacity;       // Power of two
+    
+    QuerySlots slots;           // Per entity: cell and position in it
+    size_t liveCount;
+};
+
+static uint32_t hash_cell(int32_t cx, int32_t cy) {
+    return query_mix64(((uint64_t)(uint32_t)cx << 32) | (uint32_t)cy);
+}
+
+// Cell coordinate containing value, clamped to the int32 range
+static int32_t cell_coord(const SpatialIndex* index, double value) {
+    double cell = floor(value / index->cellSize);
+    if (cell < (double)INT32_MIN) return INT32_MIN;
+    if (cell > (double)INT32_MAX) return INT32_MAX;
+    return (int32_t)cell;
+}
+
+SpatialIndex* SpatialIndex_new(double cellSize) {
+    if (!(cellSize > 0.0) || isinf(cellSize)) return NULL;
+    
+    SpatialIndex* index = (SpatialIndex*)QUERY_ALLOC(sizeof(SpatialIndex));
+    if (!index) return NULL;
+    
+    memset(index, 0, sizeof(SpatialIndex));
+    index->cellSize = cellSize;
+    if (!query_slots_init(&index->slots)) {
+        QUERY_FREE(index);
+        return NULL;
+    }
+    return index;
+}
+
+void SpatialIndex_destroy(SpatialIndex* index) {
+    if (!index) return;
+    
+    for (size_t i = 0; i < index->cellCount; i++) {
+        if (index->cells[i].entries) {
+            QUERY_FREE(index->cells[i].entries);
+        }
+    }
+    if (index->cells) QUERY_FREE(index->cells);
+    if (index->table) QUERY_FREE(index->table);
+    query_slots_free(&index->slots);
+    QUERY_FREE(index);
+}
+
+static uint32_t find_cell(const SpatialIndex* index, int32_t cx, int32_t cy) {
+    if (index->tableCapacity == 0) return CELL_NONE;
+    
+    size_t mask = index->tableCapacity - 1;
+    size_t position = hash_cell(cx, cy) & mask;
+    while (index->table[position] != 0) {
+        uint32_t cell = index->table[position] - 1;
+        if (index->cells[cell].cx == cx && index->cells[cell].cy == cy) {
+            return cell;
+        }
+        position = (position + 1) & mask;
+    }
+    return CELL_NONE;
+}
+
+static void table_insert(uint32_t* table, size_t capacity, const SpatialCell* cell, uint32_t cellIndex) {
+    size_t mask = capacity - 1;
+    size_t position = hash_cell(cell->cx, cell->cy) & mask;
+    while (table[position] != 0) {
+        position = (position + 1) & mask;
+    }
+    table[position] = cellIndex + 1;
+}
+
+static uint32_t add_cell(SpatialIndex* index, int32_t cx, int32_t cy) {
+    if (index->cellCount >= CELL_NONE - 1) return CELL_NONE;
+    
+    // Keep the table at most half full
+    if ((index->cellCount + 1) * 2 > index->tableCapacity) {
+        size_t newCapacity = index->tableCapacity ? index->tableCapacity * 2 : 64;
+        uint32_t* table = (uint32_t*)QUERY_ALLOC(sizeof(uint32_t) * newCapacity);
+        if (!table) return CELL_NONE;
+        memset(table, 0, sizeof(uint32_t) * newCapacity);
+        for (size_t i = 0; i < index->cellCount; i++) {
+            table_insert(table, newCapacity, &index->cells[i], (uint32_t)i);
+        }
+        if (index->table) QUERY_FREE(index->table);
+        index->table = table;
+        index->tableCapacity = newCapacity;
+    }
+    
+    if (index->cellCount >= index->cellCapacity) {
+        size_t newCapacity = index->cellCapacity ? index->cellCapacity * 2 : 32;
+        SpatialCell* cells = (SpatialCell*)QUERY_ALLOC(sizeof(SpatialCell) * newCapacity);
+        if (!cells) return CELL_NONE;
+        if (index->cells) {
+            memcpy(cells, index->cells, sizeof(SpatialCell) * index->cellCount);
+            QUERY_FREE(index->cells);
+        }
+        index->cells = cells;
+        index->cellCapacity = newCapacity;
+    }
+    
+    uint32_t cellIndex = (uint32_t)index->cellCount++;
+    SpatialCell* cell = &index->cells[cellIndex];
+    memset(cell, 0, sizeof(SpatialCell));
+    cell->cx = cx;
+    cell->cy = cy;
+    table_insert(index->table, index->tableCapacity, cell, cellIndex);
+    return cellIndex;
+}
+
+// Drop the entry for dense slot from its cell
+static void unlink_slot(SpatialIndex* index, uint32_t slot) {
+    uint32_t cellIndex = index->slots.groupOf[slot];
+    if (cellIndex == CELL_NONE) return;
+    
+    SpatialCell* cell = &index->cells[cellIndex];
+    query_slots_remove(&index->slots, slot, cell->entries, &cell->count, sizeof(SpatialEntry),
+                       offsetof(SpatialEntry, slot));
+    if (cell->count == 0) {
+        index->occupiedCount--;
+    }
+    index->liveCount--;
+}
+
+bool SpatialIndex_set(SpatialIndex* index, EntityId entity, double x, double y) {
+    if (!index) return false;
+    
+    if (!isfinite(x) || !isfinite(y)) {
+        SpatialIndex_remove(index, entity);
+        return true;
+    }
+    
+    uint32_t slot = query_slots_claim(&index->slots, entity);
+    if (slot == ENTITY_INDEX_INVALID) {
+        return false;
+    }
+    
+    int32_t cx = cell_coord(index, x);
+    int32_t cy = cell_coord(index, y);
+    
+    // Moving inside the current cell only rewrites the point
+    uint32_t current = index->slots.groupOf[slot];
+    if (current != CELL_NONE && index->cells[current].cx == cx && index->cells[current].cy == cy) {
+        SpatialEntry* entry = &index->cells[current].entries[index->slots.entryOf[slot]];
+        entry->x = x;
+        entry->y = y;
+        return true;
+    }
+    
+    uint32_t cellIndex = find_cell(index, cx, cy);
+    if (cellIndex == CELL_NONE) {
+        cellIndex = add_cell(index, cx, cy);
+        if (cellIndex == CELL_NONE) return false;
+    }
+    
+    SpatialCell* cell = &index->cells[cellIndex];
+    if (cell->count >= cell->capacity) {
+        size_t newCapacity = cell->capacity ? cell->capacity * 2 : 8;
+        SpatialEntry* entries = (SpatialEntry*)QUERY_ALLOC(sizeof(SpatialEntry) * newCapacity);
+        if (!entries) return false;
+        if (cell->entries) {
+            memcpy(entries, cell->entries, sizeof(SpatialEntry) * cell->count);
+            QUERY_FREE(cell->entries);
+        }
+        cell->entries = entries;
+        cell->capacity = newCapacity;
+    }
+    
+    unlink_slot(index, slot);
+    
+    if (cell->count == 0) {
+        index->occupiedCount++;
+    }
+    SpatialEntry* entry = &cell->entries[cell->count];
+    entry->entity = entity;
+    entry->slot = slot;
+    entry->x = x;
+    entry->y = y;
+    query_slots_place(&index->slots, slot, cellIndex, (uint32_t)cell->count);
+    cell->count++;
+    index->liveCount++;
+    return true;
+}
+
+void SpatialIndex_remove(SpatialIndex* index, EntityId entity) {
+    if (!index) return;
+    
+    uint32_t slot = query_slots_find(&index->slots, entity);
+    if (slot == ENTITY_INDEX_INVALID) return;
+    
+    unlink_slot(index, slot);
+}
+
+size_t SpatialIndex_count(const SpatialIndex* index) {
+    return index ? index->liveCount : 0;
+}
+
+size_t SpatialIndex_cell_count(const SpatialIndex* index) {
+    return index ? index->occupiedCount : 0;
+}
+
+// Shape tested against each stored point of a visited cell
+typedef struct {
+    SpatialRect bounds;
+    bool circle;
+    double centerX;
+    double centerY;
+    double radiusSquared;
+} SpatialShape;
+
+typedef struct {
+    EntityId* out;              // NULL to only count cell entries
+    size_t count;
+    size_t maxCount;
+} SpatialVisit;
+
+static bool shape_contains(const SpatialShape* shape, const SpatialEntry* entry) {
+    if (entry->x < shape->bounds.minX || entry->x > shape->bounds.maxX ||
+        entry->y < shape->bounds.minY || entry->y > shape->bounds.maxY) {
+        return false;
+    }
+    if (!shape->circle) return true;
+    
+    double dx = entry->x - shape->centerX;
+    double dy = entry->y - shape->centerY;
+    return dx * dx + dy * dy <= shape->radiusSquared;
+}
+
+static void visit_cell(const SpatialCell* cell, const SpatialShape* shape, SpatialVisit* visit) {
+    if (!visit->out) {
+        visit->count += cell->count;
+        return;
+    }
+    for (size_t i = 0; i < cell->count && visit->count < visit->maxCount; i++) {
+        if (shape_contains(shape, &cell->entries[i])) {
+            visit->out[visit->count++] = cell->entries[i].entity;
+        }
+    }
+}
+
+// Visit every cell overlapping the shape's bounds
+static void visit(const SpatialIndex* index, const SpatialShape* shape, SpatialVisit* visit) {
+    const SpatialRect* bounds = &shape->bounds;
+    if (index->occupiedCount == 0 || !(bounds->minX <= bounds->maxX) || !(bounds->minY <= bounds->maxY)) {
+        return;
+    }
+    
+    int32_t cx0 = cell_coord(index, bounds->minX);
+    int32_t cy0 = cell_coord(index, bounds->minY);
+    int32_t cx1 = cell_coord(index, bounds->maxX);
+    int32_t cy1 = cell_coord(index, bounds->maxY);
+    double span = ((double)cx1 - (double)cx0 + 1.0) * ((double)cy1 - (double)cy0 + 1.0);
+    
+    if (span > (double)index->cellCount) {
+        // Huge query: walking the occupied cells is cheaper than probing the box
+        for (size_t i = 0; i < index->cellCount && visit->count < visit->maxCount; i++) {
+            const SpatialCell* cell = &index->cells[i];
+            if (cell->cx >= cx0 && cell->cx <= cx1 && cell->cy >= cy0 && cell->cy <= cy1) {
+                visit_cell(cell, shape, visit);
+            }
+        }
+        return;
+    }
+    
+    for (int64_t cy = cy0; cy <= cy1; cy++) {
+        for (int64_t cx = cx0; cx <= cx1 && visit->count < visit->maxCount; cx++) {
+            uint32_t cellIndex = find_cell(index, (int32_t)cx, (int32_t)cy);
+            if (cellIndex != CELL_NONE) {
+                visit_cell(&index->cells[cellIndex], shape, visit);
+            }
+        }
+    }
+}
+
+static SpatialShape rect_shape(SpatialRect rect) {
+    SpatialShape shape;
+    memset(&shape, 0, sizeof(shape));
+    shape.bounds = rect;
+    return shape;
+}
+
+size_t SpatialIndex_estimate_rect(const SpatialIndex* index, SpatialRect rect) {
+    if (!index) return 0;
+    
+    SpatialShape shape = rect_shape(rect);
+    SpatialVisit counter = {NULL, 0, SIZE_MAX};
+    visit(index, &shape, &counter);
+    return counter.count;
+}
+
+size_t SpatialIndex_collect_rect(const SpatialIndex* index, SpatialRect rect, EntityId* outEntities, size_t maxCount) {
+    if (!index || !outEntities) return 0;
+    
+    SpatialShape shape = rect_shape(rect);
+    SpatialVisit collector = {outEntities, 0, maxCount};
+    visit(index, &shape, &collector);
+    return collector.count;
+}
+
+size_t SpatialIndex_collect_circle(const SpatialIndex* index, double x, double y, double radius,
+                                   EntityId* outEntities, size_t maxCount) {
+    if (!index || !outEntities || !(radius >= 0.0)) return 0;
+    
+    SpatialShape shape;
+    shape.bounds.minX = x - radius;
+    shape.bounds.minY = y - radius;
+    shape.bounds.maxX = x + radius;
+    shape.bounds.maxY = y + radius;
+    shape.circle = true;
+    shape.centerX = x;
+    shape.centerY = y;
+    shape.radiusSquared = radius * radius;
+    
+    SpatialVisit collector = {outEntities, 0, maxCount};
+    visit(index, &shape, &collector);
+    return collector.count;
+}
+
+size_t SpatialIndex_memory_bytes(const SpatialIndex* index) {
+    if (!index) return 0;
+    
+    size_t bytes = sizeof(SpatialIndex) +
+                   sizeof(SpatialCell) * index->cellCapacity +
+                   sizeof(uint32_t) * index->tableCapacity +
+                   query_slots_memory_bytes(&index->slots);
+    for (size_t i = 0; i < index->cellCount; i++) {
+        bytes += sizeof(SpatialEntry) * index->cells[i].capacity;
+    }
+    return bytes;
+}
@@ -0,0 +1,146 @@
+#include "gramarye_query/symbols.h"
+#include "gramarye_ecs/ecs.h"
+#include "gramarye_ecs/component.h"
+#include "gramarye_query/allocator.h"
+#include "internal.h"
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SYMBOL_INITIAL_SLOTS 64
+
+typedef struct {
+    uint64_t hash;
+    char* name;                 // Interned copy, NULL for an empty slot
+    size_t length;
+    ComponentTypeId typeId;
+} Symbol;
+
+// Open addressing with linear probing, kept at most half full
+struct QuerySymbolTable {
+    ECS* ecs;
+    Symbol* slots;
+    size_t slotCount;           // Power of two
+    size_t count;
+    ComponentTypeId nextTypeId; // First type id not yet interned
+};
+
+static uint64_t hash_name(const char* name, size_t length) {
+    return query_fnv1a(QUERY_FNV_OFFSET, name, length);
+}
+
+static Symbol* find_slot(Symbol* slots, size_t slotCount, uint64_t hash, const char* name, size_t length) {
+    size_t mask = slotCount - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        Symbol* slot = &slots[i];
+        if (!slot->name ||
+            (slot->hash == hash && slot->length == length && memcmp(slot->name, name, length) == 0)) {
+            return slot;
+        }
+    }
+}
+
+static bool grow(QuerySymbolTable* table) {
+    size_t slotCount = table->slotCount * 2;
+    Symbol* slots = (Symbol*)QUERY_ALLOC(sizeof(Symbol) * slotCount);
+    if (!slots) return false;
+    memset(slots, 0, sizeof(Symbol) * slotCount);
+    
+    for (size_t i = 0; i < table->slotCount; i++) {
+        Symbol* old = &table->slots[i];
+        if (old->name) {
+            *find_slot(slots, slotCount, old->hash, old->name, old->length) = *old;
+        }
+    }
+    QUERY_FREE(table->slots);
+    table->slots = slots;
+    table->slotCount = slotCount;
+    return true;
+}
+
+static bool intern(QuerySymbolTable* table, const char* name, ComponentTypeId typeId) {
+    if ((table->count + 1) * 2 > table->slotCount && !grow(table)) {
+        return false;
+    }
+    
+    size_t length = strlen(name);
+    uint64_t hash = hash_name(name, length);
+    Symbol* slot = find_slot(table->slots, table->slotCount, hash, name, length);
+    if (slot->name) {
+        return true; // Duplicate name: the first registration wins
+    }
+    
+    slot->name = (char*)QUERY_ALLOC(length + 1);
+    if (!slot->name) return false;
+    memcpy(slot->name, name, length + 1);
+    slot->hash = hash;
+    slot->length = length;
+    slot->typeId = typeId;
+    table->count++;
+    return true;
+}
+
+QuerySymbolTable* QuerySymbolTable_new(ECS* ecs) {
+    if (!ecs) return NULL;
+    
+    QuerySymbolTable* table = (QuerySymbolTable*)QUERY_ALLOC(sizeof(QuerySymbolTable));
+    if (!table) return NULL;
+    
+    memset(table, 0, sizeof(QuerySymbolTable));
+    table->ecs = ecs;
+    table->slotCount = SYMBOL_INITIAL_SLOTS;
+    table->slots = (Symbol*)QUERY_ALLOC(sizeof(Symbol) * table->slotCount);
+    if (!table->slots) {
+        QUERY_FREE(table);
+        return NULL;
+    }
+    memset(table->slots, 0, sizeof(Symbol) * table->slotCount);
+    
+    QuerySymbolTable_refresh(table);
+    return table;
+}
+
+void QuerySymbolTable_destroy(QuerySymbolTable* table) {
+    if (!table) return;
+    
+    for (size_t i = 0; i < table->slotCount; i++) {
+        if (table->slots[i].name) {
+            QUERY_FREE(table->slots[i].name);
+        }
+    }
+    QUERY_FREE(table->slots);
+    QUERY_FREE(table);
+}
+
+size_t QuerySymbolTable_refresh(QuerySymbolTable* table) {
+    if (!table) return 0;
+    
+    size_t added = 0;
+    while (table->nextTypeId != COMPONENT_TYPE_INVALID) {
+        ComponentType* type = ECS_get_component_type(table->ecs, table->nextTypeId);
+        if (!type) break;
+        if (type->name) {
+            if (!intern(table, type->name, table->nextTypeId)) break;
+            added++;
+        }
+        table->nextTypeId++;
+    }
+    return added;
+}
+
+ComponentTypeId QuerySymbolTable_lookup(QuerySymbolTable* table, const char* name, size_t length) {
+    if (!table || !name) return COMPONENT_TYPE_INVALID;
+    
+    uint64_t hash = hash_name(name, length);
+    Symbol* slot = find_slot(table->slots, table->slotCount, hash, name, length);
+    
+    // A miss may name a type registered since the last refresh; refresh can move the slots
+    if (!slot->name && QuerySymbolTable_refresh(table) > 0) {
+        slot = find_slot(table->slots, table->slotCount, hash, name, length);
+    }
+    return slot->name ? slot->typeId : COMPONENT_TYPE_INVALID;
+}
+
+size_t QuerySymbolTable_count(const QuerySymbolTable* table) {
+    return table ? table->count : 0;
+}
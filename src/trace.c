@@ -0,0 +1,351 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE  // syscall
+#endif
+
+#include "gramarye_query/trace.h"
+#include "gramarye_query/allocator.h"
+#include "internal.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+#if !defined(__GNUC__) && !defined(__clang__)
+#error "trace.c needs the __atomic builtins"
+#endif
+
+typedef enum {
+    SPAN_QUERY,
+    SPAN_PHASE,
+    SPAN_OPERATOR
+} SpanKind;
+
+typedef struct {
+    char name[QUERY_OPERATOR_LABEL];
+    uint64_t start;             // Nanoseconds
+    uint64_t duration;
+    uint64_t fingerprint;
+    uint64_t rowsIn;            // Query: rows returned
+    uint64_t rowsOut;           // Query: QueryStatus
+    uint8_t kind;
+} TraceEvent;
+
+// One thread's ring. Only the owning thread writes events and head; the
+// flushing thread owns tail and dropped.
+typedef struct TraceBuffer {
+    struct TraceBuffer* next;   // Immutable once published
+    uint64_t threadId;
+    uint64_t head;              // Events ever written, published with release
+    uint64_t tail;              // Events flushed or dropped
+    uint64_t dropped;
+    TraceEvent events[];
+} TraceBuffer;
+
+struct QueryTracer {
+    uint64_t id;                // Never reused, so stale thread caches cannot match
+    size_t capacity;            // Events per ring
+    TraceBuffer* buffers;       // Lock-free push-only list
+    TraceEvent* scratch;        // Flush copy of one ring
+};
+
+// Stages shown as spans; the scan phase is covered by the operator spans
+typedef enum {
+    STAGE_NONE,
+    STAGE_PARSE,
+    STAGE_PLAN,
+    STAGE_MATERIALIZE
+} TraceStage;
+
+// The query being traced on this thread
+typedef struct {
+    TraceBuffer* buffer;        // NULL when none is
+    size_t capacity;
+    uint64_t fingerprint;
+    uint64_t start;
+    TraceStage stage;
+    uint64_t stageStart;
+    uint32_t depth;             // Open operators, including untraced deeper ones
+    struct {
+        uint64_t start;
+        char label[QUERY_OPERATOR_LABEL];
+    } operators[QUERY_TRACE_MAX_DEPTH];
+} TraceContext;
+
+static THREAD_LOCAL TraceContext context;
+
+// Ring of the tracer this thread used last
+static THREAD_LOCAL TraceBuffer* cachedBuffer = NULL;
+static THREAD_LOCAL uint64_t cachedTracerId = 0;
+
+static uint64_t nextTracerId = 1;
+
+#if !defined(__linux__)
+static uint64_t nextThreadId = 1;
+#endif
+
+// The kernel's thread id where there is one, as game traces on Linux use
+static uint64_t current_thread_id(void) {
+    static THREAD_LOCAL uint64_t threadId = 0;
+    if (threadId == 0) {
+#if defined(__linux__)
+        threadId = (uint64_t)syscall(SYS_gettid);
+#else
+        threadId = __atomic_fetch_add(&nextThreadId, 1, __ATOMIC_RELAXED);
+#endif
+    }
+    return threadId;
+}
+
+static uint64_t current_process_id(void) {
+#if defined(__unix__) || defined(__APPLE__)
+    return (uint64_t)getpid();
+#else
+    return 1;
+#endif
+}
+
+// Allocate outside any engine's memory scope: rings outlive queries and engines
+static void* trace_alloc(size_t size) {
+    QueryMemoryScope scope;
+    QueryMemory_enter(&scope, NULL);
+    void* block = QUERY_ALLOC(size);
+    QueryMemory_leave(&scope);
+    return block;
+}
+
+QueryTracer* QueryTracer_new(size_t eventsPerThread) {
+    QueryTracer* tracer = (QueryTracer*)trace_alloc(sizeof(QueryTracer));
+    if (!tracer) return NULL;
+    
+    memset(tracer, 0, sizeof(QueryTracer));
+    tracer->id = __atomic_fetch_add(&nextTracerId, 1, __ATOMIC_RELAXED);
+    tracer->capacity = eventsPerThread > 0 ? eventsPerThread : QUERY_TRACE_DEFAULT_EVENTS;
+    tracer->scratch = (TraceEvent*)trace_alloc(sizeof(TraceEvent) * tracer->capacity);
+    if (!tracer->scratch) {
+        QUERY_FREE(tracer);
+        return NULL;
+    }
+    return tracer;
+}
+
+void QueryTracer_destroy(QueryTracer* tracer) {
+    if (!tracer) return;
+    
+    TraceBuffer* buffer = tracer->buffers;
+    while (buffer) {
+        TraceBuffer* next = buffer->next;
+        QUERY_FREE(buffer);
+        buffer = next;
+    }
+    QUERY_FREE(tracer->scratch);
+    QUERY_FREE(tracer);
+}
+
+// The calling thread's ring, created on its first traced query
+static TraceBuffer* thread_buffer(QueryTracer* tracer) {
+    if (cachedTracerId == tracer->id) return cachedBuffer;
+    
+    uint64_t threadId = current_thread_id();
+    TraceBuffer* buffer = __atomic_load_n(&tracer->buffers, __ATOMIC_ACQUIRE);
+    while (buffer && buffer->threadId != threadId) {
+        buffer = buffer->next;
+    }
+    if (!buffer) {
+        buffer = (TraceBuffer*)trace_alloc(sizeof(TraceBuffer) + sizeof(TraceEvent) * tracer->capacity);
+        if (!buffer) return NULL;
+        memset(buffer, 0, sizeof(TraceBuffer));
+        buffer->threadId = threadId;
+        buffer->next = __atomic_load_n(&tracer->buffers, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&tracer->buffers, &buffer->next, buffer, true, __ATOMIC_RELEASE,
+                                            __ATOMIC_RELAXED)) {
+        }
+    }
+    cachedBuffer = buffer;
+    cachedTracerId = tracer->id;
+    return buffer;
+}
+
+static void record(TraceContext* ctx, SpanKind kind, const char* name, uint64_t start, uint64_t end,
+                   uint64_t rowsIn, uint64_t rowsOut) {
+    TraceBuffer* buffer = ctx->buffer;
+    uint64_t head = buffer->head;
+    TraceEvent* event = &buffer->events[head % ctx->capacity];
+    snprintf(event->name, sizeof(event->name), "%s", name);
+    event->start = start;
+    event->duration = end - start;
+    event->fingerprint = ctx->fingerprint;
+    event->rowsIn = rowsIn;
+    event->rowsOut = rowsOut;
+    event->kind = (uint8_t)kind;
+    __atomic_store_n(&buffer->head, head + 1, __ATOMIC_RELEASE);
+}
+
+bool QueryTrace_begin(QueryTracer* tracer, uint64_t fingerprint) {
+    if (!tracer || context.buffer) return false;
+    
+    TraceBuffer* buffer = thread_buffer(tracer);
+    if (!buffer) return false;
+    context.buffer = buffer;
+    context.capacity = tracer->capacity;
+    context.fingerprint = fingerprint;
+    context.stage = STAGE_NONE;
+    context.depth = 0;
+    context.start = query_now_ns();
+    return true;
+}
+
+void QueryTrace_end(QueryStatus status, uint64_t rows) {
+    if (!context.buffer) return;
+    
+    uint64_t now = query_now_ns();
+    if (context.stage != STAGE_NONE) {
+        QueryTrace_phase(QUERY_PHASE_NONE);
+    }
+    record(&context, SPAN_QUERY, "query", context.start, now, rows, (uint64_t)status);
+    context.buffer = NULL;
+}
+
+bool QueryTrace_active(void) {
+    return context.buffer != NULL;
+}
+
+static TraceStage stage_of(QueryPhase phase) {
+    switch (phase) {
+        case QUERY_PHASE_LEX:
+        case QUERY_PHASE_PARSE:
+            return STAGE_PARSE;
+        case QUERY_PHASE_RESOLVE:
+            return STAGE_PLAN;
+        case QUERY_PHASE_MATERIALIZE:
+            return STAGE_MATERIALIZE;
+        default:
+            return STAGE_NONE;
+    }
+}
+
+void QueryTrace_phase(QueryPhase phase) {
+    static const char* const stageNames[] = {"", "parse", "plan", "materialize"};
+    if (!context.buffer) return;
+    
+    // Lexing interleaves with parsing token by token; both are one parse span
+    TraceStage stage = stage_of(phase);
+    if (stage == context.stage) return;
+    
+    uint64_t now = query_now_ns();
+    if (context.stage != STAGE_NONE) {
+        record(&context, SPAN_PHASE, stageNames[context.stage], context.stageStart, now, 0, 0);
+    }
+    context.stage = stage;
+    context.stageStart = now;
+}
+
+void QueryTrace_begin_operator(const char* label) {
+    if (!context.buffer) return;
+    
+    if (context.depth < QUERY_TRACE_MAX_DEPTH) {
+        snprintf(context.operators[context.depth].label, QUERY_OPERATOR_LABEL, "%s", label ? label : "");
+        context.operators[context.depth].start = query_now_ns();
+    }
+    context.depth++;
+}
+
+void QueryTrace_end_operator(uint64_t rowsIn, uint64_t rowsOut) {
+    if (!context.buffer || context.depth == 0) return;
+    
+    context.depth--;
+    if (context.depth < QUERY_TRACE_MAX_DEPTH) {
+        record(&context, SPAN_OPERATOR, context.operators[context.depth].label,
+               context.operators[context.depth].start, query_now_ns(), rowsIn, rowsOut);
+    }
+}
+
+// Write text as a JSON string
+static void write_json_string(FILE* out, const char* text) {
+    fputc('"', out);
+    for (const unsigned char* c = (const unsigned char*)text; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', out);
+            fputc(*c, out);
+        } else if (*c < 0x20) {
+            fprintf(out, "\\u%04x", *c);
+        } else {
+            fputc(*c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static void write_event(FILE* out, const TraceEvent* event, uint64_t processId, uint64_t threadId, bool first) {
+    static const char* const categories[] = {"query", "query.phase", "query.operator"};
+    fprintf(out, "%s\n{\"name\": ", first ? "" : ",");
+    write_json_string(out, event->name);
+    fprintf(out, ", \"cat\": \"%s\", \"ph\": \"X\", \"ts\": %llu.%03llu, \"dur\": %llu.%03llu, "
+            "\"pid\": %llu, \"tid\": %llu, \"args\": {\"fingerprint\": \"%016llx\"",
+            categories[event->kind], (unsigned long long)(event->start / 1000),
+            (unsigned long long)(event->start % 1000), (unsigned long long)(event->duration / 1000),
+            (unsigned long long)(event->duration % 1000), (unsigned long long)processId,
+            (unsigned long long)threadId, (unsigned long long)event->fingerprint);
+    if (event->kind == SPAN_QUERY) {
+        fprintf(out, ", \"rows\": %llu, \"status\": %llu", (unsigned long long)event->rowsIn,
+                (unsigned long long)event->rowsOut);
+    } else if (event->kind == SPAN_OPERATOR) {
+        fprintf(out, ", \"rows_in\": %llu, \"rows_out\": %llu", (unsigned long long)event->rowsIn,
+                (unsigned long long)event->rowsOut);
+    }
+    fputs("}}", out);
+}
+
+size_t QueryTracer_flush(QueryTracer* tracer, FILE* out) {
+    if (!tracer || !out) return 0;
+    
+    uint64_t processId = current_process_id();
+    size_t written = 0;
+    fputs("{\"traceEvents\": [", out);
+    for (TraceBuffer* buffer = __atomic_load_n(&tracer->buffers, __ATOMIC_ACQUIRE); buffer; buffer = buffer->next) {
+        uint64_t head = __atomic_load_n(&buffer->head, __ATOMIC_ACQUIRE);
+        uint64_t start = buffer->tail;
+        if (head - start > tracer->capacity) {
+            start = head - tracer->capacity;
+        }
+        for (uint64_t i = start; i < head; i++) {
+            tracer->scratch[i - start] = buffer->events[i % tracer->capacity];
+        }
+        
+        // The owner may have lapped the copy meanwhile; an event is intact
+        // only if its slot was not being rewritten, i.e. it is newer than
+        // the one capacity behind the current head
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        uint64_t after = __atomic_load_n(&buffer->head, __ATOMIC_ACQUIRE);
+        uint64_t intact = after >= tracer->capacity ? after - tracer->capacity + 1 : 0;
+        uint64_t first = start > intact ? start : intact;
+        buffer->dropped += (first < head ? first : head) - buffer->tail;
+        for (uint64_t i = first; i < head; i++) {
+            write_event(out, &tracer->scratch[i - start], processId, buffer->threadId, written == 0);
+            written++;
+        }
+        buffer->tail = head;
+    }
+    fputs("\n], \"displayTimeUnit\": \"ns\"}\n", out);
+    fflush(out);
+    return written;
+}
+
+QueryTracerStats QueryTracer_get_stats(const QueryTracer* tracer) {
+    QueryTracerStats stats;
+    memset(&stats, 0, sizeof(stats));
+    if (!tracer) return stats;
+    
+    for (TraceBuffer* buffer = __atomic_load_n(&tracer->buffers, __ATOMIC_ACQUIRE); buffer; buffer = buffer->next) {
+        stats.threads++;
+        stats.recorded += __atomic_load_n(&buffer->head, __ATOMIC_ACQUIRE);
+        stats.dropped += buffer->dropped;
+    }
+    return stats;
+}
@@ -1,7 +1,10 @@
 #include "gramarye_query/shell.h"
+#include "gramarye_query/engine.h"
+#include "gramarye_query/catalog.h"
 #include "gramarye_ecs/ecs.h"
 #include "arena.h"
 #include <stdio.h>
+#include <stddef.h>
 
 // Mock component structures
 typedef struct {
@@ -144,6 +147,7 @@ int main(void) {
     printf("  SELECT entities WHERE has_any(Position, Sprite)\n");
     printf("  SELECT entities WHERE not_has(Health)\n");
     printf("  COUNT entities WHERE has(Sprite)\n");
+    printf("  SELECT entities WHERE Health.hp < 80 AND Position.x > 200\n");
     printf("  SHOW Position OF entity %llu:%llu\n", 
            (unsigned long long)player.high, (unsigned long long)player.low);
     printf("  SHOW Health OF entity %llu:%llu\n", 
@@ -164,6 +168,13 @@ int main(void) {
         return 1;
     }
     
+    // Field schema for filters
+    QueryCatalog* catalog = QueryEngine_get_catalog(QueryShell_get_engine(shell));
+    QueryCatalog_register_field(catalog, "Position", "x", offsetof(Position, x), QUERY_FIELD_F32);
+    QueryCatalog_register_field(catalog, "Position", "y", offsetof(Position, y), QUERY_FIELD_F32);
+    QueryCatalog_register_field(catalog, "Health", "hp", offsetof(Health, hp), QUERY_FIELD_I32);
+    QueryCatalog_register_field(catalog, "Health", "maxHp", offsetof(Health, maxHp), QUERY_FIELD_I32);
+    
     // Customize prompt
     QueryShell_set_prompt(shell, "query> ");
     
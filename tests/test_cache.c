@@ -0,0 +1,213 @@
+#include "test_common.h"
+#include "gramarye_query/query.h"
+#include "gramarye_query/cache.h"
+#include "gramarye_ecs/ecs.h"
+#include "arena.h"
+#include "except.h"
+#include <string.h>
+
+// Test component structures
+typedef struct {
+    int x;
+    int y;
+} Position;
+
+typedef struct {
+    int hp;
+    int maxHp;
+} Health;
+
+static void test_cache_hit_and_plan_key(void) {
+    printf("  Testing cache hits keyed by plan...\n");
+    
+    Arena_T arena = Arena_new();
+    ECS* ecs = ECS_new(arena);
+    
+    ComponentTypeId positionType = ECS_register_component_type(ecs, "Position", sizeof(Position));
+    ComponentTypeId healthType = ECS_register_component_type(ecs, "Health", sizeof(Health));
+    
+    for (int i = 0; i < 10; i++) {
+        EntityId entity = Entity_create(ECS_get_entity_registry(ecs));
+        Position pos = {i, i};
+        ECS_add_component(ecs, entity, positionType, &pos);
+        if (i % 2 == 0) {
+            Health health = {100, 100};
+            ECS_add_component(ecs, entity, healthType, &health);
+        }
+    }
+    
+    QueryCache* cache = QueryCache_new(0);
+    TEST_ASSERT_NOT_NULL(cache, "Cache should be created");
+    
+    QueryEngineResult result;
+    QueryStatus status = QueryCache_execute(cache, ecs, "SELECT entities WHERE has(Position, Health)", &result);
+    TEST_ASSERT_EQ(status, QUERY_SUCCESS, "Query should succeed");
+    TEST_ASSERT_EQ(result.count, 5, "Should find 5 entities");
+    QueryEngineResult_free(&result);
+    
+    // Same plan, different component order
+    status = QueryCache_execute(cache, ecs, "SELECT entities WHERE has(Health, Position)", &result);
+    TEST_ASSERT_EQ(status, QUERY_SUCCESS, "Query should succeed");
+    TEST_ASSERT_EQ(result.count, 5, "Cached result should have 5 entities");
+    TEST_ASSERT_NOT_NULL(result.entities, "Cached SELECT should return entities");
+    QueryEngineResult_free(&result);
+    
+    // COUNT served from the SELECT entry
+    status = QueryCache_execute(cache, ecs, "COUNT entities WHERE has(Position, Health)", &result);
+    TEST_ASSERT_EQ(status, QUERY_SUCCESS, "Query should succeed");
+    TEST_ASSERT_EQ(result.count, 5, "Cached count should be 5");
+    TEST_ASSERT_NULL(result.entities, "COUNT should not return entities");
+    QueryEngineResult_free(&result);
+    
+    QueryCacheStats stats = QueryCache_get_stats(cache);
+    TEST_ASSERT_EQ(stats.misses, 1, "Should have one miss");
+    TEST_ASSERT_EQ(stats.hits, 2, "Should have two hits");
+    TEST_ASSERT_EQ(stats.entryCount, 1, "Should hold one entry");
+    TEST_ASSERT_TRUE(QueryCache_hit_rate(cache) > 0.6, "Hit rate should be 2/3");
+    
+    QueryCache_destroy(cache);
+}
+
+static void test_cache_invalidation(void) {
+    printf("  Testing per-component-type invalidation...\n");
+    
+    Arena_T arena = Arena_new();
+    ECS* ecs = ECS_new(arena);
+    
+    ComponentTypeId positionType = ECS_register_component_type(ecs, "Position", sizeof(Position));
+    ComponentTypeId healthType = ECS_register_component_type(ecs, "Health", sizeof(Health));
+    
+    EntityId entity1 = Entity_create(ECS_get_entity_registry(ecs));
+    Position pos = {1, 2};
+    ECS_add_component(ecs, entity1, positionType, &pos);
+    
+    QueryCache* cache = QueryCache_new(0);
+    QueryEngineResult result;
+    
+    QueryCache_execute(cache, ecs, "SELECT entities WHERE has(Position)", &result);
+    TEST_ASSERT_EQ(result.count, 1, "Should find 1 entity");
+    QueryEngineResult_free(&result);
+    
+    // Unrelated type changes do not invalidate
+    EntityId entity2 = Entity_create(ECS_get_entity_registry(ecs));
+    Health health = {10, 10};
+    ECS_add_component(ecs, entity2, healthType, &health);
+    QueryCache_bump_entities(cache);
+    QueryCache_bump_component(cache, healthType);
+    
+    QueryCache_execute(cache, ecs, "SELECT entities WHERE has(Position)", &result);
+    TEST_ASSERT_EQ(result.count, 1, "Should still find 1 entity");
+    QueryEngineResult_free(&result);
+    TEST_ASSERT_EQ(QueryCache_get_stats(cache).hits, 1, "Unrelated change should not invalidate");
+    
+    // Dependency change does
+    ECS_add_component(ecs, entity2, positionType, &pos);
+    QueryCache_bump_component(cache, positionType);
+    
+    QueryCache_execute(cache, ecs, "SELECT entities WHERE has(Position)", &result);
+    TEST_ASSERT_EQ(result.count, 2, "Should see the new entity");
+    QueryEngineResult_free(&result);
+    
+    QueryCacheStats stats = QueryCache_get_stats(cache);
+    TEST_ASSERT_EQ(stats.invalidations, 1, "Should record one invalidation");
+    TEST_ASSERT_EQ(stats.misses, 2, "Should miss after invalidation");
+    
+    // not_has depends on entity creation
+    QueryCache_execute(cache, ecs, "COUNT entities WHERE not_has(Health)", &result);
+    TEST_ASSERT_EQ(result.count, 1, "One entity lacks Health");
+    QueryEngineResult_free(&result);
+    
+    Entity_create(ECS_get_entity_registry(ecs));
+    QueryCache_bump_entities(cache);
+    
+    QueryCache_execute(cache, ecs, "COUNT entities WHERE not_has(Health)", &result);
+    TEST_ASSERT_EQ(result.count, 2, "New entity lacks Health");
+    QueryEngineResult_free(&result);
+    
+    QueryCache_destroy(cache);
+}
+
+static void test_cache_memory_bound(void) {
+    printf("  Testing cache memory bound...\n");
+    
+    Arena_T arena = Arena_new();
+    ECS* ecs = ECS_new(arena);
+    
+    ComponentTypeId positionType = ECS_register_component_type(ecs, "Position", sizeof(Position));
+    ComponentTypeId healthType = ECS_register_component_type(ecs, "Health", sizeof(Health));
+    
+    for (int i = 0; i < 100; i++) {
+        EntityId entity = Entity_create(ECS_get_entity_registry(ecs));
+        Position pos = {i, i};
+        Health health = {i, i};
+        ECS_add_component(ecs, entity, positionType, &pos);
+        ECS_add_component(ecs, entity, healthType, &health);
+    }
+    
+    // Room for roughly one 100-entity result
+    QueryCache* cache = QueryCache_new(sizeof(EntityId) * 100 + 512);
+    QueryEngineResult result;
+    
+    QueryCache_execute(cache, ecs, "SELECT entities WHERE has(Position)", &result);
+    QueryEngineResult_free(&result);
+    QueryCache_execute(cache, ecs, "SELECT entities WHERE has(Health)", &result);
+    QueryEngineResult_free(&result);
+    
+    QueryCacheStats stats = QueryCache_get_stats(cache);
+    TEST_ASSERT_EQ(stats.entryCount, 1, "Older entry should be evicted");
+    TEST_ASSERT_EQ(stats.evictions, 1, "Should record one eviction");
+    TEST_ASSERT_TRUE(stats.bytesUsed <= stats.maxBytes, "Should stay under the bound");
+    
+    // Shrinking the bound evicts
+    QueryCache_set_max_bytes(cache, 64);
+    stats = QueryCache_get_stats(cache);
+    TEST_ASSERT_EQ(stats.entryCount, 0, "Shrinking should evict all entries");
+    TEST_ASSERT_EQ(stats.bytesUsed, 0, "No bytes should be in use");
+    
+    QueryCache_destroy(cache);
+}
+
+static void test_cache_show_not_cached(void) {
+    printf("  Testing SHOW bypasses the cache...\n");
+    
+    Arena_T arena = Arena_new();
+    ECS* ecs = ECS_new(arena);
+    
+    ComponentTypeId positionType = ECS_register_component_type(ecs, "Position", sizeof(Position));
+    EntityId entity = Entity_create(ECS_get_entity_registry(ecs));
+    Position pos = {42, 84};
+    ECS_add_component(ecs, entity, positionType, &pos);
+    
+    char query[256];
+    snprintf(query, sizeof(query), "SHOW Position OF entity %llu:%llu",
+             (unsigned long long)entity.high, (unsigned long long)entity.low);
+    
+    QueryCache* cache = QueryCache_new(0);
+    QueryEngineResult result;
+    QueryStatus status = QueryCache_execute(cache, ecs, query, &result);
+    TEST_ASSERT_EQ(status, QUERY_SUCCESS, "Query should succeed");
+    TEST_ASSERT_EQ(((Position*)result.data)->x, 42, "X coordinate should match");
+    QueryEngineResult_free(&result);
+    
+    QueryCacheStats stats = QueryCache_get_stats(cache);
+    TEST_ASSERT_EQ(stats.hits + stats.misses, 0, "SHOW should not touch the cache");
+    
+    QueryCache_destroy(cache);
+}
+
+bool test_cache(void) {
+    printf("Running cache tests...\n");
+    
+    TRY
+        test_cache_hit_and_plan_key();
+        test_cache_invalidation();
+        test_cache_memory_bound();
+        test_cache_show_not_cached();
+        
+        printf("  ✓ All cache tests passed\n");
+        return true;
+    EXCEPT(Test_Failed)
+        printf("  ✗ Cache test failed\n");
+        return false;
+    END_TRY;
+}
@@ -0,0 +1,684 @@
+#include "test_common.h"
+#include "gramarye_query/query.h"
+#include "gramarye_query/catalog.h"
+#include "gramarye_query/field_index.h"
+#include "gramarye_query/spatial_index.h"
+#include "gramarye_query/hash_index.h"
+#include "gramarye_query/plan.h"
+#include "gramarye_query/profile.h"
+#include "gramarye_ecs/ecs.h"
+#include "arena.h"
+#include "except.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <math.h>
+
+// Test component structures
+typedef struct {
+    float x;
+    float y;
+} Position;
+
+typedef struct {
+    int hp;
+    int maxHp;
+} Health;
+
+#define CATALOG_ENTITY_COUNT 400
+
+typedef struct {
+    ECS* ecs;
+    QueryCatalog* catalog;
+    ComponentTypeId positionType;
+    ComponentTypeId healthType;
+    EntityId entities[CATALOG_ENTITY_COUNT];
+} CatalogWorld;
+
+// Position.x = i, Position.y = -i on everything; Health.hp = i % 100 on even entities
+static void create_catalog_world(CatalogWorld* world) {
+    Arena_T arena = Arena_new();
+    world->ecs = ECS_new(arena);
+    world->positionType = ECS_register_component_type(world->ecs, "Position", sizeof(Position));
+    world->healthType = ECS_register_component_type(world->ecs, "Health", sizeof(Health));
+    
+    for (int i = 0; i < CATALOG_ENTITY_COUNT; i++) {
+        EntityId entity = Entity_create(ECS_get_entity_registry(world->ecs));
+        Position pos = {(float)i, (float)-i};
+        ECS_add_component(world->ecs, entity, world->positionType, &pos);
+        if (i % 2 == 0) {
+            Health health = {i % 100, 100};
+            ECS_add_component(world->ecs, entity, world->healthType, &health);
+        }
+        world->entities[i] = entity;
+    }
+    
+    world->catalog = QueryCatalog_new(world->ecs);
+    QueryCatalog_register_field(world->catalog, "Position", "x", offsetof(Position, x), QUERY_FIELD_F32);
+    QueryCatalog_register_field(world->catalog, "Position", "y", offsetof(Position, y), QUERY_FIELD_F32);
+    QueryCatalog_register_field(world->catalog, "Health", "hp", offsetof(Health, hp), QUERY_FIELD_I32);
+}
+
+static size_t count_query(QueryCatalog* catalog, const char* query) {
+    QueryEngineResult result;
+    QueryStatus status = QueryCatalog_execute(catalog, query, &result);
+    TEST_ASSERT_EQ(status, QUERY_SUCCESS, "Query should succeed");
+    size_t count = result.count;
+    QueryEngineResult_free(&result);
+    return count;
+}
+
+static void test_catalog_filters(void) {
+    printf("  Testing field filters with AND / OR...\n");
+    
+    CatalogWorld world;
+    create_catalog_world(&world);
+    
+    TEST_ASSERT_EQ(count_query(world.catalog, "SELECT entities WHERE Position.x < 10"), 10, "x < 10");
+    TEST_ASSERT_EQ(count_query(world.catalog, "COUNT entities WHERE Position.x >= 390"), 10, "x >= 390");
+    TEST_ASSERT_EQ(count_query(world.catalog, "SELECT entities WHERE Position.x BETWEEN 100 AND 199"), 100, "BETWEEN");
+    TEST_ASSERT_EQ(count_query(world.catalog, "SELECT entities WHERE Position.y = -5"), 1, "Negative equality");
+    TEST_ASSERT_EQ(count_query(world.catalog, "COUNT entities WHERE Position.x != 0"), CATALOG_ENTITY_COUNT - 1, "!=");
+    TEST_ASSERT_EQ(count_query(world.catalog, "COUNT entities WHERE Position.x < 100 AND has(Health)"), 50, "Filter AND has");
+    TEST_ASSERT_EQ(count_query(world.catalog, "COUNT entities WHERE Position.x < 10 OR Position.x >= 390"), 20, "OR");
+    TEST_ASSERT_EQ(count_query(world.catalog, "COUNT entities WHERE (Position.x < 10 OR Position.x >= 390) AND Health.hp > 4"),
+                   7, "Parenthesized OR inside AND");
+    TEST_ASSERT_EQ(count_query(world.catalog, "COUNT entities WHERE Position.x < 4 OR Position.x < 2"), 4, "OR deduplicates");
+    TEST_ASSERT_EQ(count_query(world.catalog, "SELECT entities WHERE Position.x >= 0 LIMIT 7"), 7, "LIMIT on a filter");
+    
+    // Unknown fields, and filters without a catalog, are execution errors
+    QueryEngineResult result;
+    TEST_ASSERT_EQ(QueryCatalog_execute(world.catalog, "SELECT entities WHERE Position.z > 0", &result),
+                   QUERY_ERROR_EXECUTION, "Unknown field should fail");
+    TEST_ASSERT_EQ(Query_execute(world.ecs, "SELECT entities WHERE Position.x > 0", &result),
+                   QUERY_ERROR_EXECUTION, "Filters need a catalog");
+    
+    // A field outside the component is rejected
+    TEST_ASSERT_EQ(QueryCatalog_register_field(world.catalog, "Position", "z", sizeof(Position), QUERY_FIELD_F32),
+                   QUERY_ERROR_EXECUTION, "Out-of-bounds field should be rejected");
+    
+    QueryCatalog_destroy(world.catalog);
+}
+
+static void test_catalog_index_matches_scan(void) {
+    printf("  Testing indexed results match scans...\n");
+    
+    CatalogWorld world;
+    create_catalog_world(&world);
+    
+    const char* queries[] = {
+        "COUNT entities WHERE Position.x < 20",
+        "COUNT entities WHERE Position.x BETWEEN 50.5 AND 60",
+        "COUNT entities WHERE Position.x = 77",
+        "COUNT entities WHERE Position.x > 380 AND has(Health)",
+        "COUNT entities WHERE Position.x <= 3 OR Position.x > 396",
+        "COUNT entities WHERE Position.x > 10"
+    };
+    size_t count = sizeof(queries) / sizeof(queries[0]);
+    size_t scanned[6];
+    for (size_t i = 0; i < count; i++) {
+        scanned[i] = count_query(world.catalog, queries[i]);
+    }
+    
+    QueryEngineResult result;
+    TEST_ASSERT_EQ(QueryCatalog_execute(world.catalog, "CREATE INDEX ON Position.x", &result), QUERY_SUCCESS,
+                   "CREATE INDEX should succeed");
+    
+    for (size_t i = 0; i < count; i++) {
+        TEST_ASSERT_EQ(count_query(world.catalog, queries[i]), scanned[i], "Indexed count should match scan");
+    }
+    
+    QueryIndexStats stats;
+    TEST_ASSERT_EQ(QueryCatalog_get_index_stats(world.catalog, "Position", "x", &stats), QUERY_SUCCESS, "Stats");
+    TEST_ASSERT_EQ(stats.entryCount, CATALOG_ENTITY_COUNT, "Index should hold every Position");
+    TEST_ASSERT_TRUE(stats.scans >= 5, "Selective ranges should use the index");
+    TEST_ASSERT_TRUE(stats.memoryBytes > 0, "Index should report its memory");
+    
+    // Writes, adds: notify and the index follows
+    Position* pos = (Position*)ECS_get_component(world.ecs, world.entities[0], world.positionType);
+    pos->x = 1000.0f;
+    QueryCatalog_notify_write(world.catalog, world.entities[0], world.positionType);
+    
+    EntityId extra = Entity_create(ECS_get_entity_registry(world.ecs));
+    Position extraPos = {1001.0f, 0.0f};
+    ECS_add_component(world.ecs, extra, world.positionType, &extraPos);
+    QueryCatalog_notify_write(world.catalog, extra, world.positionType);
+    
+    TEST_ASSERT_EQ(count_query(world.catalog, "COUNT entities WHERE Position.x > 999"), 2, "Index should see updates");
+    TEST_ASSERT_EQ(count_query(world.catalog, "COUNT entities WHERE Position.x < 20"), scanned[0] - 1,
+                   "Moved entity should leave its old range");
+    
+    QueryCatalog_notify_destroy(world.catalog, extra);
+    QueryCatalog_get_index_stats(world.catalog, "Position", "x", &stats);
+    TEST_ASSERT_EQ(stats.entryCount, CATALOG_ENTITY_COUNT, "Destroyed entity should leave the index");
+    
+    QueryCatalog_destroy(world.catalog);
+}
+
+static void test_catalog_field_index_churn(void) {
+    printf("  Testing sorted index under churn...\n");
+    
+    // Mirror every operation in a plain array and compare range results
+    enum { SLOTS = 2000 };
+    EntityId ids[SLOTS];
+    double values[SLOTS];
+    bool present[SLOTS];
+    for (int i = 0; i < SLOTS; i++) {
+        ids[i].high = 7;
+        ids[i].low = (uint64_t)i;
+        values[i] = (double)(i % 50);
+        present[i] = true;
+    }
+    
+    FieldIndex* index = FieldIndex_new();
+    TEST_ASSERT_NOT_NULL(index, "Index should be created");
+    TEST_ASSERT_TRUE(FieldIndex_build(index, ids, values, SLOTS), "Build should succeed");
+    
+    uint32_t seed = 12345;
+    EntityId* found = (EntityId*)malloc(sizeof(EntityId) * SLOTS);
+    for (int step = 0; step < 20000; step++) {
+        seed = seed * 1103515245u + 12345u;
+        int slot = (int)((seed >> 8) % SLOTS);
+        if ((seed >> 4) % 5 == 0) {
+            FieldIndex_remove(index, ids[slot]);
+            present[slot] = false;
+        } else {
+            values[slot] = (double)((seed >> 12) % 100);
+            FieldIndex_set(index, ids[slot], values[slot]);
+            present[slot] = true;
+        }
+        
+        if (step % 997 == 0) {
+            FieldRange range = {20.0, 40.0, true, false};
+            size_t expected = 0;
+            size_t live = 0;
+            for (int i = 0; i < SLOTS; i++) {
+                if (!present[i]) continue;
+                live++;
+                if (values[i] >= 20.0 && values[i] < 40.0) expected++;
+            }
+            size_t got = FieldIndex_collect_range(index, range, found, SLOTS);
+            TEST_ASSERT_EQ(got, expected, "Range result should match the mirror");
+            TEST_ASSERT_EQ(FieldIndex_count(index), live, "Live count should match the mirror");
+            TEST_ASSERT_TRUE(FieldIndex_estimate_range(index, range) >= expected, "Estimate is an upper bound");
+        }
+    }
+    
+    free(found);
+    FieldIndex_destroy(index);
+}
+
+static void test_catalog_prepared_filter(void) {
+    printf("  Testing prepared filters with bound values...\n");
+    
+    CatalogWorld world;
+    create_catalog_world(&world);
+    QueryCatalog_create_index(world.catalog, "Position", "x");
+    
+    QueryPlan* plan = QueryPlan_prepare_with_catalog(world.ecs, world.catalog,
+                                                     "COUNT entities WHERE Position.x BETWEEN ? AND ? AND Health.hp < $3");
+    TEST_ASSERT_NOT_NULL(plan, "Plan should be prepared");
+    TEST_ASSERT_EQ(QueryPlan_param_count(plan), 3, "Plan should have three parameters");
+    
+    QueryEngineResult result;
+    QueryPlan_bind_f64(plan, 1, 0.0);
+    QueryPlan_bind_f64(plan, 2, 99.5);
+    QueryPlan_bind_u64(plan, 3, 50);
+    TEST_ASSERT_EQ(QueryPlan_execute(plan, &result), QUERY_SUCCESS, "Execute should succeed");
+    TEST_ASSERT_EQ(result.count, 25, "Even x in [0, 99.5] with hp < 50");
+    
+    QueryPlan_bind_f64(plan, 1, 200.0);
+    QueryPlan_bind_f64(plan, 2, 299.0);
+    TEST_ASSERT_EQ(QueryPlan_execute(plan, &result), QUERY_SUCCESS, "Rebound execute should succeed");
+    TEST_ASSERT_EQ(result.count, 25, "Even x in [200, 299] with hp < 50");
+    
+    TEST_ASSERT_EQ(QueryPlan_bind_entity(plan, 1, world.entities[0]), QUERY_ERROR_INVALID_SYNTAX,
+                   "Filter slot should reject an entity");
+    QueryPlan_destroy(plan);
+    
+    // Placeholders cannot be executed without binding
+    TEST_ASSERT_EQ(QueryCatalog_execute(world.catalog, "SELECT entities WHERE Position.x > ?", &result),
+                   QUERY_ERROR_INVALID_SYNTAX, "Unbound filter value should fail");
+    
+    QueryCatalog_destroy(world.catalog);
+}
+
+static void test_catalog_spatial(void) {
+    printf("  Testing WITHIN / INSIDE over a spatial grid...\n");
+    
+    CatalogWorld world;
+    create_catalog_world(&world);
+    
+    // Without a designated position the predicates cannot run
+    QueryEngineResult result;
+    TEST_ASSERT_EQ(QueryCatalog_execute(world.catalog, "SELECT entities WHERE WITHIN(Position, 0, 0, 5)", &result),
+                   QUERY_ERROR_EXECUTION, "WITHIN without a spatial index should fail");
+    TEST_ASSERT_EQ(QueryCatalog_create_spatial_index(world.catalog, "Position", "x", "z", 8.0),
+                   QUERY_ERROR_EXECUTION, "Unregistered field should be rejected");
+    TEST_ASSERT_EQ(QueryCatalog_create_spatial_index(world.catalog, "Position", "x", "y", 0.0),
+                   QUERY_ERROR_EXECUTION, "Cell size must be positive");
+    TEST_ASSERT_EQ(QueryCatalog_create_spatial_index(world.catalog, "Position", "x", "y", 8.0),
+                   QUERY_SUCCESS, "Spatial index should build");
+    
+    // Entities lie on the diagonal (i, -i)
+    TEST_ASSERT_EQ(count_query(world.catalog, "COUNT entities WHERE WITHIN(Position, 100, -100, 5)"), 7,
+                   "|i - 100| * sqrt(2) <= 5");
+    TEST_ASSERT_EQ(count_query(world.catalog, "COUNT entities WHERE INSIDE(Position, 0, -9, 9, 0)"), 10, "Box");
+    TEST_ASSERT_EQ(count_query(world.catalog, "COUNT entities WHERE INSIDE(Position, 9, 0, 0, -9)"), 10,
+                   "Corners in either order");
+    TEST_ASSERT_EQ(count_query(world.catalog, "COUNT entities WHERE WITHIN(Position, 100, -100, 5) AND has(Health)"), 3,
+                   "WITHIN AND has");
+    TEST_ASSERT_EQ(count_query(world.catalog, "COUNT entities WHERE INSIDE(Position, -1000000000, -1000000000, 1000000000, 1000000000)"),
+                   CATALOG_ENTITY_COUNT, "Huge box walks the occupied cells");
+    TEST_ASSERT_EQ(count_query(world.catalog, "SELECT entities WHERE WITHIN(Position, 0, 0, -1)"), 0, "Negative radius");
+    
+    // Moves are picked up through notify_write
+    Position* pos = (Position*)ECS_get_component(world.ecs, world.entities[0], world.positionType);
+    pos->x = 1000.0f;
+    pos->y = 1000.0f;
+    QueryCatalog_notify_write(world.catalog, world.entities[0], world.positionType);
+    TEST_ASSERT_EQ(count_query(world.catalog, "COUNT entities WHERE INSIDE(Position, 0, -9, 9, 0)"), 9, "Moved out");
+    TEST_ASSERT_EQ(count_query(world.catalog, "COUNT entities WHERE WITHIN(Position, 1001, 1001, 2)"), 1, "Moved in");
+    
+    QueryCatalog_notify_destroy(world.catalog, world.entities[0]);
+    QueryIndexStats stats;
+    TEST_ASSERT_EQ(QueryCatalog_get_spatial_stats(world.catalog, "Position", &stats), QUERY_SUCCESS, "Stats");
+    TEST_ASSERT_EQ(stats.entryCount, CATALOG_ENTITY_COUNT - 1, "Destroyed entity leaves the grid");
+    TEST_ASSERT_TRUE(stats.scans >= 2, "Scans should be counted");
+    
+    // Arguments may be placeholders
+    QueryPlan* plan = QueryPlan_prepare_with_catalog(world.ecs, world.catalog,
+                                                     "COUNT entities WHERE WITHIN(Position, ?, ?, $3)");
+    TEST_ASSERT_NOT_NULL(plan, "Spatial plan should prepare");
+    TEST_ASSERT_EQ(QueryPlan_param_count(plan), 3, "Three parameters");
+    QueryPlan_bind_f64(plan, 1, 200.0);
+    QueryPlan_bind_f64(plan, 2, -200.0);
+    QueryPlan_bind_f64(plan, 3, 0.5);
+    TEST_ASSERT_EQ(QueryPlan_execute(plan, &result), QUERY_SUCCESS, "Spatial plan should execute");
+    TEST_ASSERT_EQ(result.count, 1, "Only (200, -200)");
+    QueryPlan_destroy(plan);
+    
+    TEST_ASSERT_EQ(QueryCatalog_drop_spatial_index(world.catalog, "Position"), QUERY_SUCCESS, "Drop");
+    TEST_ASSERT_EQ(QueryCatalog_drop_spatial_index(world.catalog, "Position"), QUERY_ERROR_EXECUTION, "Drop twice");
+    
+    QueryCatalog_destroy(world.catalog);
+}
+
+static void test_catalog_spatial_churn(void) {
+    printf("  Testing spatial grid under churn...\n");
+    
+    // Mirror every operation in a plain array and compare region results
+    enum { SLOTS = 2000 };
+    EntityId ids[SLOTS];
+    double xs[SLOTS];
+    double ys[SLOTS];
+    bool present[SLOTS];
+    
+    SpatialIndex* index = SpatialIndex_new(10.0);
+    TEST_ASSERT_NOT_NULL(index, "Grid should be created");
+    for (int i = 0; i < SLOTS; i++) {
+        ids[i].high = 9;
+        ids[i].low = (uint64_t)i;
+        xs[i] = (double)(i % 100) - 50.0;
+        ys[i] = (double)(i / 20) - 50.0;
+        present[i] = SpatialIndex_set(index, ids[i], xs[i], ys[i]);
+    }
+    
+    uint32_t seed = 54321;
+    EntityId* found = (EntityId*)malloc(sizeof(EntityId) * SLOTS);
+    for (int step = 0; step < 20000; step++) {
+        seed = seed * 1103515245u + 12345u;
+        int slot = (int)((seed >> 8) % SLOTS);
+        if ((seed >> 4) % 7 == 0) {
+            SpatialIndex_remove(index, ids[slot]);
+            present[slot] = false;
+        } else {
+            // Mostly small moves, some jumps across the world
+            double stepSize = (seed >> 20) % 4 == 0 ? 60.0 : 3.0;
+            xs[slot] += ((double)((seed >> 12) % 201) / 100.0 - 1.0) * stepSize;
+            ys[slot] += ((double)((seed >> 14) % 201) / 100.0 - 1.0) * stepSize;
+            SpatialIndex_set(index, ids[slot], xs[slot], ys[slot]);
+            present[slot] = true;
+        }
+        
+        if (step % 997 == 0) {
+            SpatialRect rect = {-25.0, -15.0, 12.5, 30.0};
+            size_t expectedRect = 0;
+            size_t expectedCircle = 0;
+            size_t live = 0;
+            for (int i = 0; i < SLOTS; i++) {
+                if (!present[i]) continue;
+                live++;
+                if (xs[i] >= rect.minX && xs[i] <= rect.maxX && ys[i] >= rect.minY && ys[i] <= rect.maxY) {
+                    expectedRect++;
+                }
+                if ((xs[i] - 5.0) * (xs[i] - 5.0) + ys[i] * ys[i] <= 400.0) {
+                    expectedCircle++;
+                }
+            }
+            TEST_ASSERT_EQ(SpatialIndex_collect_rect(index, rect, found, SLOTS), expectedRect,
+                           "Rect result should match the mirror");
+            TEST_ASSERT_EQ(SpatialIndex_collect_circle(index, 5.0, 0.0, 20.0, found, SLOTS), expectedCircle,
+                           "Circle result should match the mirror");
+            TEST_ASSERT_EQ(SpatialIndex_count(index), live, "Live count should match the mirror");
+            TEST_ASSERT_TRUE(SpatialIndex_estimate_rect(index, rect) >= expectedRect, "Estimate is an upper bound");
+        }
+    }
+    
+    free(found);
+    SpatialIndex_destroy(index);
+}
+
+static void test_catalog_hash_index(void) {
+    printf("  Testing hash index for = and IN...\n");
+    
+    CatalogWorld world;
+    create_catalog_world(&world);
+    
+    // Health.hp = i % 100 on even entities, so only even hp values exist
+    const char* queries[] = {
+        "COUNT entities WHERE Health.hp = 42",
+        "COUNT entities WHERE Health.hp IN (1, 2, 3, 2)",
+        "COUNT entities WHERE Health.hp IN (0, 98) AND Position.x < 200",
+        "COUNT entities WHERE Health.hp = 2.5",
+        "COUNT entities WHERE Health.hp IN (-4, 4)"
+    };
+    const size_t expected[] = {4, 4, 4, 0, 4};
+    enum { QUERY_COUNT = sizeof(queries) / sizeof(queries[0]) };
+    
+    for (size_t i = 0; i < QUERY_COUNT; i++) {
+        TEST_ASSERT_EQ(count_query(world.catalog, queries[i]), expected[i], "Scan result");
+    }
+    
+    QueryEngineResult result;
+    TEST_ASSERT_EQ(QueryCatalog_execute(world.catalog, "CREATE HASH INDEX ON Position.x", &result),
+                   QUERY_ERROR_EXECUTION, "Floating-point fields cannot be hashed");
+    TEST_ASSERT_EQ(QueryCatalog_execute(world.catalog, "CREATE HASH INDEX ON Health.hp", &result),
+                   QUERY_SUCCESS, "CREATE HASH INDEX should succeed");
+    
+    for (size_t i = 0; i < QUERY_COUNT; i++) {
+        TEST_ASSERT_EQ(count_query(world.catalog, queries[i]), expected[i], "Hash result should match scan");
+    }
+    
+    QueryIndexStats stats;
+    TEST_ASSERT_EQ(QueryCatalog_get_hash_index_stats(world.catalog, "Health", "hp", &stats), QUERY_SUCCESS, "Stats");
+    TEST_ASSERT_EQ(stats.entryCount, CATALOG_ENTITY_COUNT / 2, "One entry per Health");
+    TEST_ASSERT_EQ(stats.scans, QUERY_COUNT, "Every query should probe the hash index");
+    TEST_ASSERT_TRUE(stats.memoryBytes > 0, "Memory should be reported");
+    
+    // Writes move entities between keys
+    Health* health = (Health*)ECS_get_component(world.ecs, world.entities[42], world.healthType);
+    health->hp = 7;
+    QueryCatalog_notify_write(world.catalog, world.entities[42], world.healthType);
+    TEST_ASSERT_EQ(count_query(world.catalog, "COUNT entities WHERE Health.hp = 42"), 3, "Moved off 42");
+    TEST_ASSERT_EQ(count_query(world.catalog, "COUNT entities WHERE Health.hp = 7"), 1, "Moved onto 7");
+    
+    QueryCatalog_notify_remove(world.catalog, world.entities[142], world.healthType);
+    TEST_ASSERT_EQ(QueryCatalog_get_hash_index_stats(world.catalog, "Health", "hp", &stats), QUERY_SUCCESS, "Stats");
+    TEST_ASSERT_EQ(stats.entryCount, CATALOG_ENTITY_COUNT / 2 - 1, "Removed entity leaves the index");
+    
+    // IN values may be placeholders
+    QueryPlan* plan = QueryPlan_prepare_with_catalog(world.ecs, world.catalog, "SELECT entities WHERE Health.hp IN (?, ?)");
+    TEST_ASSERT_NOT_NULL(plan, "IN plan should prepare");
+    QueryPlan_bind_u64(plan, 1, 10);
+    QueryPlan_bind_u64(plan, 2, 20);
+    TEST_ASSERT_EQ(QueryPlan_execute(plan, &result), QUERY_SUCCESS, "IN plan should execute");
+    TEST_ASSERT_EQ(result.count, 8, "hp 10 or 20");
+    QueryEngineResult_free(&result);
+    QueryPlan_destroy(plan);
+    
+    TEST_ASSERT_EQ(QueryCatalog_drop_hash_index(world.catalog, "Health", "hp"), QUERY_SUCCESS, "Drop");
+    TEST_ASSERT_EQ(QueryCatalog_drop_hash_index(world.catalog, "Health", "hp"), QUERY_ERROR_EXECUTION, "Drop twice");
+    
+    QueryCatalog_destroy(world.catalog);
+}
+
+static void test_catalog_hash_index_churn(void) {
+    printf("  Testing hash index under churn...\n");
+    
+    // Mirror every operation in a plain array and compare lookups
+    enum { SLOTS = 2000, KEYS = 40 };
+    EntityId ids[SLOTS];
+    uint64_t keys[SLOTS];
+    bool present[SLOTS];
+    
+    HashIndex* index = HashIndex_new();
+    TEST_ASSERT_NOT_NULL(index, "Index should be created");
+    for (int i = 0; i < SLOTS; i++) {
+        ids[i].high = 11;
+        ids[i].low = (uint64_t)i;
+        keys[i] = (uint64_t)(i % KEYS);
+        present[i] = HashIndex_set(index, ids[i], keys[i]);
+    }
+    
+    uint32_t seed = 2024;
+    EntityId* found = (EntityId*)malloc(sizeof(EntityId) * SLOTS);
+    for (int step = 0; step < 20000; step++) {
+        seed = seed * 1103515245u + 12345u;
+        int slot = (int)((seed >> 8) % SLOTS);
+        if ((seed >> 4) % 5 == 0) {
+            HashIndex_remove(index, ids[slot]);
+            present[slot] = false;
+        } else {
+            keys[slot] = (uint64_t)((seed >> 12) % KEYS);
+            HashIndex_set(index, ids[slot], keys[slot]);
+            present[slot] = true;
+        }
+        
+        if (step % 997 == 0) {
+            uint64_t key = (uint64_t)(step % KEYS);
+            size_t expected = 0;
+            size_t live = 0;
+            for (int i = 0; i < SLOTS; i++) {
+                if (!present[i]) continue;
+                live++;
+                if (keys[i] == key) expected++;
+            }
+            TEST_ASSERT_EQ(HashIndex_count_key(index, key), expected, "Key count should match the mirror");
+            TEST_ASSERT_EQ(HashIndex_collect(index, key, found, SLOTS), expected, "Lookup should match the mirror");
+            TEST_ASSERT_EQ(HashIndex_count(index), live, "Live count should match the mirror");
+        }
+    }
+    
+    free(found);
+    HashIndex_destroy(index);
+}
+
+static void test_catalog_changes(void) {
+    printf("  Testing CHANGED() change tracking...\n");
+    
+    CatalogWorld world;
+    create_catalog_world(&world);
+    
+    QueryEngineResult result;
+    TEST_ASSERT_EQ(QueryCatalog_execute(world.catalog, "SELECT entities WHERE CHANGED(Position)", &result),
+                   QUERY_ERROR_EXECUTION, "Untracked type should fail");
+    TEST_ASSERT_EQ(QueryCatalog_track_changes(world.catalog, "Position"), QUERY_SUCCESS, "Track Position");
+    TEST_ASSERT_EQ(QueryCatalog_track_changes(world.catalog, "Missing"), QUERY_ERROR_EXECUTION, "Unknown type");
+    TEST_ASSERT_EQ(count_query(world.catalog, "COUNT entities WHERE CHANGED(Position)"), 0, "Nothing written yet");
+    
+    // Entities 3, 5 and 300 move; 5 is written twice
+    int moved[] = {3, 5, 300, 5};
+    for (size_t i = 0; i < sizeof(moved) / sizeof(moved[0]); i++) {
+        Position* pos = (Position*)ECS_get_component(world.ecs, world.entities[moved[i]], world.positionType);
+        pos->y += 1.0f;
+        QueryCatalog_notify_write(world.catalog, world.entities[moved[i]], world.positionType);
+    }
+    QueryCatalog_notify_write(world.catalog, world.entities[7], world.healthType); // Untracked type
+    
+    TEST_ASSERT_EQ(QueryCatalog_execute(world.catalog, "SELECT entities WHERE CHANGED(Position)", &result),
+                   QUERY_SUCCESS, "CHANGED should succeed");
+    TEST_ASSERT_EQ(result.count, 3, "Each changed entity once");
+    EntityId* changedEntities = (EntityId*)result.entities;
+    TEST_ASSERT(changedEntities[0].high == world.entities[3].high && changedEntities[0].low == world.entities[3].low,
+                "Changes come back in write order");
+    QueryEngineResult_free(&result);
+    
+    TEST_ASSERT_EQ(count_query(world.catalog, "COUNT entities WHERE CHANGED(Position) AND Position.x < 100"), 2,
+                   "CHANGED AND filter");
+    TEST_ASSERT_EQ(count_query(world.catalog, "COUNT entities WHERE has(Health) AND CHANGED(Position)"), 1,
+                   "has AND CHANGED");
+    TEST_ASSERT_EQ(count_query(world.catalog, "COUNT entities WHERE CHANGED(Position) OR Position.x < 2"), 5,
+                   "CHANGED OR filter");
+    
+    QueryCatalog_track_changes(world.catalog, "Health");
+    Health* health = (Health*)ECS_get_component(world.ecs, world.entities[300], world.healthType);
+    health->hp = 1;
+    QueryCatalog_notify_write(world.catalog, world.entities[300], world.healthType);
+    QueryCatalog_notify_write(world.catalog, world.entities[10], world.healthType);
+    TEST_ASSERT_EQ(count_query(world.catalog, "COUNT entities WHERE CHANGED(Position, Health)"), 4,
+                   "Either type, deduplicated");
+    
+    // A new window starts empty
+    QueryCatalog_clear_changes(world.catalog);
+    TEST_ASSERT_EQ(count_query(world.catalog, "COUNT entities WHERE CHANGED(Position, Health)"), 0, "Cleared");
+    QueryCatalog_notify_write(world.catalog, world.entities[3], world.positionType);
+    TEST_ASSERT_EQ(count_query(world.catalog, "COUNT entities WHERE CHANGED(Position)"), 1, "Tracked again after clear");
+    
+    QueryCatalog_destroy(world.catalog);
+}
+
+static void test_catalog_changes_destroy_and_loss(void) {
+    printf("  Testing CHANGED() after destroys and lost writes...\n");
+    
+    CatalogWorld world;
+    create_catalog_world(&world);
+    QueryCatalog_track_changes(world.catalog, "Position");
+    
+    // Destroying the first of five changes moves the last into its place
+    for (int i = 1; i <= 5; i++) {
+        QueryCatalog_notify_write(world.catalog, world.entities[i], world.positionType);
+    }
+    QueryCatalog_notify_destroy(world.catalog, world.entities[1]);
+    QueryCatalog_notify_destroy(world.catalog, world.entities[9]); // Never written
+    TEST_ASSERT_TRUE(!QueryCatalog_is_changed(world.catalog, world.entities[1], world.positionType),
+                     "Destroyed entity is no longer changed");
+    TEST_ASSERT_EQ(count_query(world.catalog, "COUNT entities WHERE CHANGED(Position)"), 4, "Destroyed change dropped");
+    
+    QueryCatalog_notify_destroy(world.catalog, world.entities[5]);
+    QueryCatalog_notify_write(world.catalog, world.entities[3], world.positionType); // Already changed
+    QueryCatalog_notify_write(world.catalog, world.entities[6], world.positionType);
+    const EntityId* changes = NULL;
+    size_t changeCount = 0;
+    TEST_ASSERT_TRUE(QueryCatalog_get_changes(world.catalog, world.positionType, &changes, &changeCount),
+                     "Changes should be tracked");
+    TEST_ASSERT_EQ(changeCount, 4, "Each remaining change once");
+    int expected[] = {2, 3, 4, 6};
+    for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+        TEST_ASSERT_TRUE(QueryCatalog_is_changed(world.catalog, world.entities[expected[i]], world.positionType),
+                         "Remaining entity is still changed");
+        bool listed = false;
+        for (size_t j = 0; j < changeCount; j++) {
+            listed = listed || (changes[j].high == world.entities[expected[i]].high &&
+                                changes[j].low == world.entities[expected[i]].low);
+        }
+        TEST_ASSERT_TRUE(listed, "Remaining entity is listed");
+    }
+    QueryCatalog_notify_write(world.catalog, world.entities[1], world.positionType);
+    TEST_ASSERT_EQ(count_query(world.catalog, "COUNT entities WHERE CHANGED(Position)"), 5, "Slot reused after destroy");
+    
+    // A write the tracker cannot record fails CHANGED until the window ends
+    QueryCatalog_track_changes(world.catalog, "Health");
+    QueryMemoryScope scope;
+    QueryMemory_enter(&scope, NULL);
+    scope.budget = 1;
+    bool recorded = QueryCatalog_notify_write(world.catalog, world.entities[8], world.healthType);
+    QueryMemory_leave(&scope);
+    TEST_ASSERT_TRUE(!recorded, "Unrecorded write should be reported");
+    TEST_ASSERT_TRUE(!QueryCatalog_notify_write(world.catalog, world.entities[10], world.healthType),
+                     "Window stays incomplete");
+    QueryEngineResult result;
+    TEST_ASSERT_EQ(QueryCatalog_execute(world.catalog, "COUNT entities WHERE CHANGED(Health)", &result),
+                   QUERY_ERROR_EXECUTION, "CHANGED should fail rather than miss a write");
+    TEST_ASSERT_EQ(count_query(world.catalog, "COUNT entities WHERE CHANGED(Position)"), 5, "Other types unaffected");
+    
+    QueryCatalog_clear_changes(world.catalog);
+    TEST_ASSERT_TRUE(QueryCatalog_notify_write(world.catalog, world.entities[8], world.healthType),
+                     "Write recorded in a new window");
+    TEST_ASSERT_EQ(count_query(world.catalog, "COUNT entities WHERE CHANGED(Health)"), 1, "Tracked again after clear");
+    
+    QueryCatalog_destroy(world.catalog);
+}
+
+#if GRAMARYE_QUERY_PROFILE
+// Names a prepared filtered plan looks up, per execution: none once compiled
+static void test_catalog_prepared_lookups(void) {
+    printf("  Testing prepared conditions resolve names once...\n");
+    
+    CatalogWorld world;
+    create_catalog_world(&world);
+    QueryCatalog_create_spatial_index(world.catalog, "Position", "x", "y", 8.0);
+    
+    QueryPlan* plan = QueryPlan_prepare_with_catalog(world.ecs, world.catalog,
+        "COUNT entities WHERE Health.hp < ? AND has(Position) OR Position.x IN (1, $2) OR INSIDE(Position, 0, -9, 9, 0)");
+    TEST_ASSERT_NOT_NULL(plan, "Plan should be prepared");
+    QueryPlan* aggregate = QueryPlan_prepare_with_catalog(world.ecs, world.catalog,
+                                                          "SELECT APPROX_COUNT_DISTINCT(Health.hp) WHERE Position.x < ?");
+    TEST_ASSERT_NOT_NULL(aggregate, "Aggregate plan should be prepared");
+    
+    QueryEngineResult result;
+    QueryEngineResult direct;
+    for (int round = 0; round < 6; round++) {
+        // An index created halfway is picked up by compiling once more
+        if (round == 3) {
+            TEST_ASSERT_EQ(QueryCatalog_create_index(world.catalog, "Health", "hp"), QUERY_SUCCESS, "Index should build");
+        }
+        
+        int hp = 10 + round;
+        QueryPlan_bind_f64(plan, 1, (double)hp);
+        QueryPlan_bind_f64(plan, 2, (double)(3 + 2 * round));
+        TEST_ASSERT_EQ(QueryPlan_execute(plan, &result), QUERY_SUCCESS, "Plan should execute");
+        // Health.hp, has(Position), Position.x and INSIDE's Position
+        TEST_ASSERT_EQ(result.stats.lookups, round == 3 ? 4 : 0, "Only a schema change compiles again");
+        
+        char query[160];
+        snprintf(query, sizeof(query), "COUNT entities WHERE Health.hp < %d AND has(Position) OR "
+                 "Position.x IN (1, %d) OR INSIDE(Position, 0, -9, 9, 0)", hp, 3 + 2 * round);
+        TEST_ASSERT_EQ(QueryCatalog_execute(world.catalog, query, &direct), QUERY_SUCCESS, "Query should execute");
+        TEST_ASSERT_EQ(result.count, direct.count, "Plan should match the query");
+        TEST_ASSERT_TRUE(direct.stats.lookups >= 4, "An unprepared query resolves every name");
+        QueryEngineResult_free(&result);
+        QueryEngineResult_free(&direct);
+        
+        QueryPlan_bind_f64(aggregate, 1, (double)(100 * round));
+        TEST_ASSERT_EQ(QueryPlan_execute(aggregate, &result), QUERY_SUCCESS, "Aggregate should execute");
+        TEST_ASSERT_EQ(result.stats.lookups, round == 3 ? 2 : 0, "Aggregate field is resolved once");
+        QueryEngineResult_free(&result);
+    }
+    
+    QueryIndexStats stats;
+    QueryCatalog_get_index_stats(world.catalog, "Health", "hp", &stats);
+    TEST_ASSERT_TRUE(stats.scans >= 3, "Recompiled plan should use the new index");
+    
+    QueryPlan_destroy(plan);
+    QueryPlan_destroy(aggregate);
+    QueryCatalog_destroy(world.catalog);
+}
+#endif
+
+bool test_catalog(void) {
+    printf("Running catalog tests...\n");
+    
+    TRY
+        test_catalog_filters();
+        test_catalog_index_matches_scan();
+        test_catalog_field_index_churn();
+        test_catalog_prepared_filter();
+        test_catalog_spatial();
+        test_catalog_spatial_churn();
+        test_catalog_hash_index();
+        test_catalog_hash_index_churn();
+        test_catalog_changes();
+        test_catalog_changes_destroy_and_loss();
+#if GRAMARYE_QUERY_PROFILE
+        test_catalog_prepared_lookups();
+#endif
+        
+        printf("  ✓ All catalog tests passed\n");
+        return true;
+    EXCEPT(Test_Failed)
+        printf("  ✗ Catalog test failed\n");
+        return false;
+    END_TRY;
+}
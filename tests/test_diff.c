@@ -0,0 +1,295 @@
+#include "test_common.h"
+#include "gramarye_query/query.h"
+#include "gramarye_query/entity_set.h"
+#include "gramarye_ecs/ecs.h"
+#include "arena.h"
+#include "except.h"
+#include "mem.h"
+#include <string.h>
+
+// Test component structures
+typedef struct {
+    int x;
+    int y;
+} Position;
+
+typedef struct {
+    int hp;
+    int maxHp;
+} Health;
+
+static bool entity_before(EntityId a, EntityId b) {
+    return a.high < b.high || (a.high == b.high && a.low < b.low);
+}
+
+static bool entity_same(EntityId a, EntityId b) {
+    return a.high == b.high && a.low == b.low;
+}
+
+static void make_result(QueryEngineResult* result, const EntityId* entities, size_t count) {
+    memset(result, 0, sizeof(QueryEngineResult));
+    if (count == 0) return;
+    
+    result->entities = ALLOC(sizeof(EntityId) * count);
+    memcpy(result->entities, entities, sizeof(EntityId) * count);
+    result->count = count;
+    result->capacity = count;
+}
+
+static void test_diff_entity_sort(void) {
+    printf("  Testing EntityId radix sort...\n");
+    
+    // Below and above the insertion sort cutoff, with shared high words
+    size_t sizes[] = { 0, 1, 7, 63, 64, 1000, 20000 };
+    uint32_t seed = 2024;
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t count = sizes[s];
+        EntityId* entities = (EntityId*)ALLOC(sizeof(EntityId) * (count + 1));
+        uint64_t checksum = 0;
+        for (size_t i = 0; i < count; i++) {
+            seed = seed * 1103515245u + 12345u;
+            entities[i].high = (seed >> 16) % 4;
+            seed = seed * 1103515245u + 12345u;
+            entities[i].low = ((uint64_t)seed << 32) | (seed >> 3);
+            if (i % 5 == 0 && i > 0) entities[i] = entities[i - 1];
+            checksum += entities[i].high * 31 + entities[i].low;
+        }
+        
+        TEST_ASSERT_TRUE(EntityId_sort(entities, count), "Sort should succeed");
+        
+        uint64_t sortedChecksum = 0;
+        for (size_t i = 0; i < count; i++) {
+            sortedChecksum += entities[i].high * 31 + entities[i].low;
+            if (i > 0) {
+                TEST_ASSERT_TRUE(!entity_before(entities[i], entities[i - 1]), "Ids should be ascending");
+            }
+        }
+        TEST_ASSERT_TRUE(sortedChecksum == checksum, "Sort should keep every id");
+        FREE(entities);
+    }
+}
+
+static void test_diff_sets(void) {
+    printf("  Testing result diff as sets...\n");
+    
+    EntityId prevIds[] = { {0, 5}, {1, 2}, {0, 9}, {0, 5}, {2, 0}, {0, 1} };
+    EntityId currIds[] = { {2, 0}, {0, 7}, {0, 1}, {3, 3}, {0, 7}, {0, 5} };
+    QueryEngineResult prev;
+    QueryEngineResult curr;
+    make_result(&prev, prevIds, 6);
+    make_result(&curr, currIds, 6);
+    
+    QueryEngineResult added;
+    QueryEngineResult removed;
+    QueryStatus status = QueryEngineResult_diff(&prev, &curr, &added, &removed);
+    TEST_ASSERT_EQ(status, QUERY_SUCCESS, "Diff should succeed");
+    
+    // Added {0,7} {3,3}; removed {0,9} {1,2}, sorted and without duplicates
+    EntityId* addedIds = (EntityId*)added.entities;
+    EntityId* removedIds = (EntityId*)removed.entities;
+    TEST_ASSERT_EQ(added.count, 2, "Two entities should be added");
+    TEST_ASSERT_EQ(removed.count, 2, "Two entities should be removed");
+    TEST_ASSERT_TRUE(entity_same(addedIds[0], (EntityId){0, 7}), "First added should be 0:7");
+    TEST_ASSERT_TRUE(entity_same(addedIds[1], (EntityId){3, 3}), "Second added should be 3:3");
+    TEST_ASSERT_TRUE(entity_same(removedIds[0], (EntityId){0, 9}), "First removed should be 0:9");
+    TEST_ASSERT_TRUE(entity_same(removedIds[1], (EntityId){1, 2}), "Second removed should be 1:2");
+    TEST_ASSERT_TRUE(entity_same(((EntityId*)prev.entities)[0], (EntityId){0, 5}), "Inputs should be untouched");
+    QueryEngineResult_free(&added);
+    QueryEngineResult_free(&removed);
+    
+    // Empty against non-empty
+    QueryEngineResult empty;
+    make_result(&empty, NULL, 0);
+    status = QueryEngineResult_diff(&empty, &curr, &added, &removed);
+    TEST_ASSERT_EQ(status, QUERY_SUCCESS, "Diff from empty should succeed");
+    TEST_ASSERT_EQ(added.count, 5, "Every distinct current entity should be added");
+    TEST_ASSERT_EQ(removed.count, 0, "Nothing should be removed");
+    QueryEngineResult_free(&added);
+    QueryEngineResult_free(&removed);
+    
+    // Results without an entity list are rejected
+    QueryEngineResult countOnly;
+    make_result(&countOnly, NULL, 0);
+    countOnly.count = 3;
+    status = QueryEngineResult_diff(&countOnly, &curr, &added, &removed);
+    TEST_ASSERT_EQ(status, QUERY_ERROR_EXECUTION, "COUNT results cannot be diffed");
+    TEST_ASSERT_EQ(added.count, 0, "Failed diff should leave outputs empty");
+    TEST_ASSERT_NULL(added.entities, "Failed diff should not allocate");
+    
+    QueryEngineResult_free(&prev);
+    QueryEngineResult_free(&curr);
+}
+
+// Random ids {k % 3, k} for k drawn from [0, universe), flagged in member
+static void make_random_result(QueryEngineResult* result, size_t count, size_t universe,
+                               bool* member, uint32_t* seed) {
+    EntityId* entities = (EntityId*)ALLOC(sizeof(EntityId) * (count + 1));
+    memset(member, 0, sizeof(bool) * universe);
+    for (size_t i = 0; i < count; i++) {
+        *seed = *seed * 1103515245u + 12345u;
+        uint64_t k = (*seed >> 8) % universe;
+        entities[i].high = k % 3;
+        entities[i].low = k;
+        member[k] = true;
+    }
+    make_result(result, entities, count);
+    FREE(entities);
+}
+
+// Result must be strictly ascending and hold exactly the ids flagged in expected
+static void check_set_result(const QueryEngineResult* result, const bool* expected, size_t universe,
+                             const char* message) {
+    size_t expectedCount = 0;
+    for (size_t k = 0; k < universe; k++) {
+        if (expected[k]) expectedCount++;
+    }
+    TEST_ASSERT_EQ(result->count, expectedCount, message);
+    
+    EntityId* entities = (EntityId*)result->entities;
+    for (size_t i = 0; i < result->count; i++) {
+        TEST_ASSERT_TRUE(entities[i].low < universe && expected[entities[i].low], message);
+        if (i > 0) {
+            TEST_ASSERT_TRUE(entity_before(entities[i - 1], entities[i]), "Set results should be strictly ascending");
+        }
+    }
+}
+
+static void test_diff_set_operations(void) {
+    printf("  Testing intersect/union/difference...\n");
+    
+    // Similar sizes take the block merge, skewed sizes gallop, in both directions
+    const size_t UNIVERSE = 4000;
+    size_t pairs[][2] = { {0, 50}, {50, 0}, {300, 280}, {1000, 1200}, {20, 3000}, {3000, 20}, {1, 2000} };
+    bool* inA = (bool*)ALLOC(sizeof(bool) * UNIVERSE);
+    bool* inB = (bool*)ALLOC(sizeof(bool) * UNIVERSE);
+    bool* expected = (bool*)ALLOC(sizeof(bool) * UNIVERSE);
+    uint32_t seed = 77;
+    
+    for (size_t p = 0; p < sizeof(pairs) / sizeof(pairs[0]); p++) {
+        QueryEngineResult a;
+        QueryEngineResult b;
+        make_random_result(&a, pairs[p][0], UNIVERSE, inA, &seed);
+        make_random_result(&b, pairs[p][1], UNIVERSE, inB, &seed);
+        
+        QueryEngineResult out;
+        TEST_ASSERT_EQ(QueryEngineResult_intersect(&a, &b, true, &out), QUERY_SUCCESS, "Intersect should succeed");
+        for (size_t k = 0; k < UNIVERSE; k++) expected[k] = inA[k] && inB[k];
+        check_set_result(&out, expected, UNIVERSE, "Intersect should match reference");
+        QueryEngineResult_free(&out);
+        
+        TEST_ASSERT_EQ(QueryEngineResult_union(&a, &b, true, &out), QUERY_SUCCESS, "Union should succeed");
+        for (size_t k = 0; k < UNIVERSE; k++) expected[k] = inA[k] || inB[k];
+        check_set_result(&out, expected, UNIVERSE, "Union should match reference");
+        QueryEngineResult_free(&out);
+        
+        TEST_ASSERT_EQ(QueryEngineResult_difference(&a, &b, true, &out), QUERY_SUCCESS, "Difference should succeed");
+        for (size_t k = 0; k < UNIVERSE; k++) expected[k] = inA[k] && !inB[k];
+        check_set_result(&out, expected, UNIVERSE, "Difference should match reference");
+        
+        // Sorted outputs feed straight back in without sorting
+        QueryEngineResult sortedB;
+        QueryEngineResult again;
+        TEST_ASSERT_EQ(QueryEngineResult_union(&b, &b, true, &sortedB), QUERY_SUCCESS, "Sorting b should succeed");
+        TEST_ASSERT_EQ(QueryEngineResult_intersect(&out, &sortedB, false, &again), QUERY_SUCCESS, "Sorted inputs should be accepted");
+        TEST_ASSERT_EQ(again.count, 0, "Difference should share nothing with b");
+        QueryEngineResult_free(&again);
+        QueryEngineResult_free(&sortedB);
+        QueryEngineResult_free(&out);
+        
+        QueryEngineResult_free(&a);
+        QueryEngineResult_free(&b);
+    }
+    
+    // Sorting on demand works on copies
+    EntityId unsortedIds[] = { {0, 9}, {0, 3} };
+    QueryEngineResult unsorted;
+    QueryEngineResult out;
+    make_result(&unsorted, unsortedIds, 2);
+    TEST_ASSERT_EQ(QueryEngineResult_union(&unsorted, &unsorted, true, &out), QUERY_SUCCESS, "Sort on demand should succeed");
+    TEST_ASSERT_EQ(out.count, 2, "Union with itself should keep both ids");
+    TEST_ASSERT_TRUE(((EntityId*)unsorted.entities)[0].low == 9, "Sort on demand should not touch the input");
+    QueryEngineResult_free(&out);
+    QueryEngineResult_free(&unsorted);
+    
+    FREE(inA);
+    FREE(inB);
+    FREE(expected);
+}
+
+static void test_diff_query_results(void) {
+    printf("  Testing diff between query runs...\n");
+    
+    Arena_T arena = Arena_new();
+    ECS* ecs = ECS_new(arena);
+    ComponentTypeId positionType = ECS_register_component_type(ecs, "Position", sizeof(Position));
+    ComponentTypeId healthType = ECS_register_component_type(ecs, "Health", sizeof(Health));
+    
+    EntityId entities[200];
+    for (int i = 0; i < 200; i++) {
+        entities[i] = Entity_create(ECS_get_entity_registry(ecs));
+        Position pos = {i, i};
+        ECS_add_component(ecs, entities[i], positionType, &pos);
+        if (i % 4 == 0) {
+            Health health = {100, 100};
+            ECS_add_component(ecs, entities[i], healthType, &health);
+        }
+    }
+    
+    const char* query = "SELECT entities WHERE has(Position, Health)";
+    QueryEngineResult before;
+    TEST_ASSERT_EQ(Query_execute(ecs, query, &before), QUERY_SUCCESS, "Baseline query should succeed");
+    TEST_ASSERT_EQ(before.count, 50, "Baseline should hold 50 entities");
+    
+    // Give Health to i % 4 == 1
+    for (int i = 1; i < 200; i += 4) {
+        Health health = {50, 100};
+        ECS_add_component(ecs, entities[i], healthType, &health);
+    }
+    
+    QueryEngineResult after;
+    TEST_ASSERT_EQ(Query_execute(ecs, query, &after), QUERY_SUCCESS, "Second query should succeed");
+    
+    QueryEngineResult added;
+    QueryEngineResult removed;
+    TEST_ASSERT_EQ(QueryEngineResult_diff(&before, &after, &added, &removed), QUERY_SUCCESS, "Diff should succeed");
+    TEST_ASSERT_EQ(added.count, 50, "50 entities should enter");
+    TEST_ASSERT_EQ(removed.count, 0, "No entity should leave");
+    
+    EntityId* addedIds = (EntityId*)added.entities;
+    for (size_t i = 0; i < added.count; i++) {
+        bool found = false;
+        for (int e = 1; e < 200 && !found; e += 4) {
+            found = entity_same(addedIds[i], entities[e]);
+        }
+        TEST_ASSERT_TRUE(found, "Added entity should be one that gained Health");
+    }
+    QueryEngineResult_free(&added);
+    QueryEngineResult_free(&removed);
+    
+    // Reversed, the same entities leave
+    TEST_ASSERT_EQ(QueryEngineResult_diff(&after, &before, &added, &removed), QUERY_SUCCESS, "Reverse diff should succeed");
+    TEST_ASSERT_EQ(added.count, 0, "Reverse diff should add nothing");
+    TEST_ASSERT_EQ(removed.count, 50, "Reverse diff should remove 50");
+    QueryEngineResult_free(&added);
+    QueryEngineResult_free(&removed);
+    
+    QueryEngineResult_free(&before);
+    QueryEngineResult_free(&after);
+}
+
+bool test_diff(void) {
+    printf("Running diff tests...\n");
+    
+    TRY
+        test_diff_entity_sort();
+        test_diff_sets();
+        test_diff_set_operations();
+        test_diff_query_results();
+        
+        printf("  ✓ All diff tests passed\n");
+        return true;
+    EXCEPT(Test_Failed)
+        printf("  ✗ Diff test failed\n");
+        return false;
+    END_TRY;
+}
@@ -0,0 +1,533 @@
+#include "test_common.h"
+#include "gramarye_query/query.h"
+#include "gramarye_query/engine.h"
+#include "gramarye_query/catalog.h"
+#include "gramarye_query/shell.h"
+#include "gramarye_ecs/ecs.h"
+#include "arena.h"
+#include "except.h"
+#include <string.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+// Test component structures
+typedef struct {
+    int x;
+    int y;
+} Position;
+
+typedef struct {
+    int hp;
+    int maxHp;
+} Health;
+
+static ECS* create_engine_world(void) {
+    Arena_T arena = Arena_new();
+    ECS* ecs = ECS_new(arena);
+    
+    ComponentTypeId positionType = ECS_register_component_type(ecs, "Position", sizeof(Position));
+    ComponentTypeId healthType = ECS_register_component_type(ecs, "Health", sizeof(Health));
+    for (int i = 0; i < 100; i++) {
+        EntityId entity = Entity_create(ECS_get_entity_registry(ecs));
+        Position pos = {i, -i};
+        ECS_add_component(ecs, entity, positionType, &pos);
+        if (i % 2 == 0) {
+            Health health = {i, 100};
+            ECS_add_component(ecs, entity, healthType, &health);
+        }
+    }
+    return ecs;
+}
+
+static void register_engine_fields(QueryEngine* engine) {
+    QueryCatalog* catalog = QueryEngine_get_catalog(engine);
+    QueryCatalog_register_field(catalog, "Position", "x", offsetof(Position, x), QUERY_FIELD_I32);
+    QueryCatalog_register_field(catalog, "Health", "hp", offsetof(Health, hp), QUERY_FIELD_I32);
+}
+
+static size_t engine_count(QueryEngine* engine, const char* query) {
+    QueryEngineResult result;
+    TEST_ASSERT_EQ(QueryEngine_execute(engine, query, &result), QUERY_SUCCESS, "Engine query should succeed");
+    size_t count = result.count;
+    QueryEngineResult_free(&result);
+    return count;
+}
+
+static void test_engine_plan_cache(void) {
+    printf("  Testing plan reuse through an engine...\n");
+    
+    ECS* ecs = create_engine_world();
+    QueryEngine* engine = QueryEngine_new(ecs, NULL);
+    TEST_ASSERT_NOT_NULL(engine, "Engine should be created");
+    TEST_ASSERT_TRUE(QueryEngine_get_ecs(engine) == ecs, "Engine should keep its ECS");
+    register_engine_fields(engine);
+    
+    const char* queries[] = {
+        "SELECT entities WHERE has(Position, Health)",
+        "COUNT entities WHERE not_has(Health)",
+        "SELECT entities WHERE Health.hp < 20 AND Position.x >= 10",
+        "SELECT entities WHERE has(Position) LIMIT 7",
+        "SELECT APPROX_PERCENTILE(Health.hp, 0.5)"
+    };
+    size_t expected[] = {50, 50, 5, 7, 1};
+    
+    for (int round = 0; round < 3; round++) {
+        for (size_t i = 0; i < sizeof(queries) / sizeof(queries[0]); i++) {
+            TEST_ASSERT_EQ(engine_count(engine, queries[i]), expected[i], queries[i]);
+        }
+    }
+    
+    // Same answers as the stateless entry point
+    QueryEngineResult direct;
+    TEST_ASSERT_EQ(Query_execute(ecs, queries[0], &direct), QUERY_SUCCESS, "Query_execute should succeed");
+    TEST_ASSERT_EQ(direct.count, expected[0], "Query_execute should agree with the engine");
+    QueryEngineResult_free(&direct);
+    
+    QueryEngineStats stats = QueryEngine_get_stats(engine);
+    TEST_ASSERT_EQ(stats.queries, 15, "Every execution is counted");
+    TEST_ASSERT_EQ(stats.planMisses, 5, "Each query string is compiled once");
+    TEST_ASSERT_EQ(stats.planHits, 10, "Repeats are served from plans");
+    TEST_ASSERT_EQ(stats.planCount, 5, "Five plans should be cached");
+    TEST_ASSERT_EQ(stats.failures, 0, "Nothing should fail");
+    TEST_ASSERT_TRUE(stats.maxMs <= stats.totalMs, "Max time is part of the total");
+    
+    QueryEngine_reset_stats(engine);
+    stats = QueryEngine_get_stats(engine);
+    TEST_ASSERT_EQ(stats.queries, 0, "Reset should clear counters");
+    TEST_ASSERT_EQ(stats.planCount, 5, "Reset should keep plans");
+    
+    QueryEngine_destroy(engine);
+    ECS_destroy(ecs);
+}
+
+static void test_engine_catalog_and_errors(void) {
+    printf("  Testing indexes and errors through an engine...\n");
+    
+    ECS* ecs = create_engine_world();
+    QueryEngine* engine = QueryEngine_new(ecs, NULL);
+    register_engine_fields(engine);
+    
+    const char* filter = "COUNT entities WHERE Health.hp BETWEEN 10 AND 14";
+    TEST_ASSERT_EQ(engine_count(engine, filter), 3, "Scan should find 10, 12 and 14");
+    
+    // The cached plan picks up an index created afterwards
+    QueryEngineResult result;
+    TEST_ASSERT_EQ(QueryEngine_execute(engine, "CREATE INDEX ON Health.hp", &result), QUERY_SUCCESS,
+                   "CREATE INDEX should run through the engine");
+    QueryEngineResult_free(&result);
+    TEST_ASSERT_EQ(engine_count(engine, filter), 3, "Indexed filter should agree");
+    QueryIndexStats indexStats;
+    TEST_ASSERT_EQ(QueryCatalog_get_index_stats(QueryEngine_get_catalog(engine), "Health", "hp", &indexStats),
+                   QUERY_SUCCESS, "Index stats should exist");
+    TEST_ASSERT_EQ(indexStats.scans, 1, "Cached plan should use the new index");
+    
+    TEST_ASSERT_EQ(QueryEngine_execute(engine, "SELECT entities WHERE", &result), QUERY_ERROR_PARSE,
+                   "Parse errors are reported");
+    TEST_ASSERT_NE(QueryEngine_execute(engine, "SELECT entities WHERE Health.hp < ?", &result), QUERY_SUCCESS,
+                   "Unbound placeholders fail");
+    
+    QueryEngineStats stats = QueryEngine_get_stats(engine);
+    TEST_ASSERT_EQ(stats.failures, 2, "Both failures are counted");
+    TEST_ASSERT_EQ(stats.planCount, 1, "Only the filter is kept as a plan");
+    
+    QueryEngine_destroy(engine);
+    ECS_destroy(ecs);
+}
+
+static void test_engine_bounds_and_schema(void) {
+    printf("  Testing plan cache bounds and schema changes...\n");
+    
+    ECS* ecs = create_engine_world();
+    QueryEngineConfig config = QueryEngineConfig_default();
+    TEST_ASSERT_EQ(config.planCacheEntries, QUERY_ENGINE_DEFAULT_PLAN_ENTRIES, "Default plan bound");
+    config.planCacheEntries = 2;
+    QueryEngine* engine = QueryEngine_new(ecs, &config);
+    
+    engine_count(engine, "COUNT entities WHERE has(Position)");
+    engine_count(engine, "COUNT entities WHERE has(Health)");
+    engine_count(engine, "COUNT entities WHERE has(Position)");
+    engine_count(engine, "COUNT entities WHERE not_has(Health)");
+    
+    // has(Health) was least recently used
+    QueryEngineStats stats = QueryEngine_get_stats(engine);
+    TEST_ASSERT_EQ(stats.planCount, 2, "Plan cache should stay bounded");
+    TEST_ASSERT_EQ(stats.planEvictions, 1, "One plan should be evicted");
+    engine_count(engine, "COUNT entities WHERE has(Position)");
+    TEST_ASSERT_EQ(QueryEngine_get_stats(engine).planHits, 2, "Recently used plan should survive");
+    
+    // Registering a type drops the plans compiled against the old schema
+    TEST_ASSERT_EQ(engine_count(engine, "COUNT entities WHERE has(Position)"), 100, "All entities have Position");
+    ComponentTypeId tagType = ECS_register_component_type(ecs, "Tag", sizeof(int));
+    int tag = 1;
+    EntityId tagged = Entity_create(ECS_get_entity_registry(ecs));
+    ECS_add_component(ecs, tagged, tagType, &tag);
+    QueryEngine_schema_changed(engine);
+    TEST_ASSERT_EQ(QueryEngine_get_stats(engine).planCount, 0, "Schema change drops plans");
+    TEST_ASSERT_EQ(engine_count(engine, "COUNT entities WHERE has(Tag)"), 1, "New type should resolve");
+    QueryEngine_destroy(engine);
+    
+    // Without a plan cache every query goes through the catalog
+    config.planCacheEntries = 0;
+    engine = QueryEngine_new(ecs, &config);
+    TEST_ASSERT_EQ(engine_count(engine, "COUNT entities WHERE has(Health)"), 50, "Uncached engine should work");
+    stats = QueryEngine_get_stats(engine);
+    TEST_ASSERT_EQ(stats.planMisses + stats.planHits + stats.planCount, 0, "No plans without a plan cache");
+    QueryEngine_destroy(engine);
+    
+    // The shell keeps one engine per session
+    QueryShell* shell = QueryShell_new(ecs);
+    TEST_ASSERT_NOT_NULL(QueryShell_get_engine(shell), "Shell should own an engine");
+    QueryShell_destroy(shell);
+    
+    ECS_destroy(ecs);
+}
+
+// One entity carries a component named after each keyword, a second only Position
+static ECS* create_keyword_world(const char* const* names, size_t count) {
+    Arena_T arena = Arena_new();
+    ECS* ecs = ECS_new(arena);
+    
+    ComponentTypeId positionType = ECS_register_component_type(ecs, "Position", sizeof(Position));
+    EntityId tagged = Entity_create(ECS_get_entity_registry(ecs));
+    EntityId plain = Entity_create(ECS_get_entity_registry(ecs));
+    Position pos = {7, 7};
+    ECS_add_component(ecs, tagged, positionType, &pos);
+    ECS_add_component(ecs, plain, positionType, &pos);
+    for (size_t i = 0; i < count; i++) {
+        ComponentTypeId typeId = ECS_register_component_type(ecs, names[i], sizeof(Position));
+        ECS_add_component(ecs, tagged, typeId, &pos);
+    }
+    return ecs;
+}
+
+// Keyword components must resolve with and without a symbol table (engine vs Query_execute)
+static void assert_keyword_component(ECS* ecs, QueryEngine* engine, const char* name) {
+    char query[128];
+    snprintf(query, sizeof(query), "COUNT entities WHERE has(%s)", name);
+    QueryEngineResult result;
+    TEST_ASSERT_EQ(Query_execute(ecs, query, &result), QUERY_SUCCESS, query);
+    TEST_ASSERT_EQ(result.count, 1, query);
+    QueryEngineResult_free(&result);
+    TEST_ASSERT_EQ(engine_count(engine, query), 1, query);
+    
+    snprintf(query, sizeof(query), "COUNT entities WHERE not_has(%s) OR has_any(%s, Position)", name, name);
+    TEST_ASSERT_EQ(engine_count(engine, query), 2, query);
+    
+    QueryCatalog_register_field(QueryEngine_get_catalog(engine), name, "x", offsetof(Position, x), QUERY_FIELD_I32);
+    snprintf(query, sizeof(query), "COUNT entities WHERE %s.x = 7 AND has(Position)", name);
+    TEST_ASSERT_EQ(engine_count(engine, query), 1, query);
+}
+
+static void test_engine_keyword_limit(void) {
+    printf("  Testing LIMIT as a component name...\n");
+    
+    const char* names[] = {"Limit", "limit"};
+    ECS* ecs = create_keyword_world(names, 2);
+    QueryEngine* engine = QueryEngine_new(ecs, NULL);
+    for (size_t i = 0; i < 2; i++) {
+        assert_keyword_component(ecs, engine, names[i]);
+    }
+    
+    TEST_ASSERT_EQ(engine_count(engine, "SELECT entities WHERE has(Limit) LIMIT 1"), 1, "LIMIT after has(Limit)");
+    TEST_ASSERT_EQ(engine_count(engine, "SELECT entities WHERE Limit.x > 0 OR has(Position) LIMIT 1"), 1,
+                   "LIMIT after a Limit filter");
+    
+    QueryEngine_destroy(engine);
+    ECS_destroy(ecs);
+}
+
+static void test_engine_keyword_index(void) {
+    printf("  Testing CREATE, INDEX, ON and BETWEEN as component names...\n");
+    
+    const char* names[] = {"Index", "Create", "On", "Between"};
+    ECS* ecs = create_keyword_world(names, 4);
+    QueryEngine* engine = QueryEngine_new(ecs, NULL);
+    for (size_t i = 0; i < 4; i++) {
+        assert_keyword_component(ecs, engine, names[i]);
+    }
+    
+    QueryEngineResult result;
+    TEST_ASSERT_EQ(QueryEngine_execute(engine, "CREATE INDEX ON Index.x", &result), QUERY_SUCCESS,
+                   "Index.x should be indexable");
+    QueryEngineResult_free(&result);
+    TEST_ASSERT_EQ(engine_count(engine, "COUNT entities WHERE Index.x BETWEEN 1 AND 9"), 1, "Indexed range on Index");
+    TEST_ASSERT_EQ(engine_count(engine, "COUNT entities WHERE Between.x BETWEEN 7 AND 7 AND has(On, Create)"), 1,
+                   "BETWEEN on Between");
+    
+    QueryEngine_destroy(engine);
+    ECS_destroy(ecs);
+}
+
+static void test_engine_keyword_spatial(void) {
+    printf("  Testing WITHIN and INSIDE as component names...\n");
+    
+    const char* names[] = {"Within", "Inside"};
+    ECS* ecs = create_keyword_world(names, 2);
+    QueryEngine* engine = QueryEngine_new(ecs, NULL);
+    for (size_t i = 0; i < 2; i++) {
+        assert_keyword_component(ecs, engine, names[i]);
+    }
+    
+    QueryCatalog* catalog = QueryEngine_get_catalog(engine);
+    QueryCatalog_register_field(catalog, "Inside", "y", offsetof(Position, y), QUERY_FIELD_I32);
+    TEST_ASSERT_EQ(QueryCatalog_create_spatial_index(catalog, "Inside", "x", "y", 4.0), QUERY_SUCCESS,
+                   "Inside should take a spatial index");
+    TEST_ASSERT_EQ(engine_count(engine, "COUNT entities WHERE WITHIN(Inside, 7, 7, 1)"), 1, "WITHIN over Inside");
+    TEST_ASSERT_EQ(engine_count(engine, "COUNT entities WHERE INSIDE(Inside, 0, 0, 9, 9) AND Within.x > 0"), 1,
+                   "INSIDE over Inside and a Within filter");
+    
+    QueryEngine_destroy(engine);
+    ECS_destroy(ecs);
+}
+
+static void test_engine_keyword_hash(void) {
+    printf("  Testing HASH and IN as component names...\n");
+    
+    const char* names[] = {"Hash", "In"};
+    ECS* ecs = create_keyword_world(names, 2);
+    QueryEngine* engine = QueryEngine_new(ecs, NULL);
+    for (size_t i = 0; i < 2; i++) {
+        assert_keyword_component(ecs, engine, names[i]);
+    }
+    
+    QueryEngineResult result;
+    TEST_ASSERT_EQ(QueryEngine_execute(engine, "CREATE HASH INDEX ON Hash.x", &result), QUERY_SUCCESS,
+                   "Hash.x should take a hash index");
+    QueryEngineResult_free(&result);
+    TEST_ASSERT_EQ(engine_count(engine, "COUNT entities WHERE Hash.x IN (1, 7)"), 1, "Hashed IN on Hash");
+    TEST_ASSERT_EQ(engine_count(engine, "COUNT entities WHERE In.x IN (7) AND Hash.x = 7"), 1, "IN on In");
+    
+    QueryEngine_destroy(engine);
+    ECS_destroy(ecs);
+}
+
+static void test_engine_keyword_changed(void) {
+    printf("  Testing CHANGED as a component name...\n");
+    
+    const char* names[] = {"Changed"};
+    ECS* ecs = create_keyword_world(names, 1);
+    QueryEngine* engine = QueryEngine_new(ecs, NULL);
+    assert_keyword_component(ecs, engine, names[0]);
+    
+    QueryCatalog* catalog = QueryEngine_get_catalog(engine);
+    TEST_ASSERT_EQ(QueryCatalog_track_changes(catalog, "Changed"), QUERY_SUCCESS, "Changed should be trackable");
+    TEST_ASSERT_EQ(engine_count(engine, "COUNT entities WHERE CHANGED(Changed)"), 0, "Nothing written yet");
+    
+    QueryEngineResult result;
+    TEST_ASSERT_EQ(QueryEngine_execute(engine, "SELECT entities WHERE has(Changed)", &result), QUERY_SUCCESS,
+                   "has(Changed) should run");
+    EntityId tagged = ((EntityId*)result.entities)[0];
+    QueryEngineResult_free(&result);
+    QueryCatalog_notify_write(catalog, tagged, ECS_get_component_type_by_name(ecs, "Changed"));
+    TEST_ASSERT_EQ(engine_count(engine, "COUNT entities WHERE CHANGED(Changed) AND Changed.x = 7"), 1,
+                   "CHANGED over Changed");
+    
+    QueryEngine_destroy(engine);
+    ECS_destroy(ecs);
+}
+
+static void test_engine_keyword_sample(void) {
+    printf("  Testing SAMPLE and APPROX as component names...\n");
+    
+    const char* names[] = {"Sample", "Approx"};
+    ECS* ecs = create_keyword_world(names, 2);
+    QueryEngine* engine = QueryEngine_new(ecs, NULL);
+    for (size_t i = 0; i < 2; i++) {
+        assert_keyword_component(ecs, engine, names[i]);
+    }
+    
+    TEST_ASSERT_EQ(engine_count(engine, "SELECT entities WHERE has(Sample) SAMPLE 5"), 1, "SAMPLE after has(Sample)");
+    TEST_ASSERT_EQ(engine_count(engine, "COUNT entities WHERE has(Approx) APPROX"), 1, "APPROX after has(Approx)");
+    TEST_ASSERT_EQ(engine_count(engine, "COUNT entities WHERE Sample.x = 7 OR Approx.x = 7 APPROX 10"), 1,
+                   "APPROX after keyword filters");
+    
+    QueryEngine_destroy(engine);
+    ECS_destroy(ecs);
+}
+
+static void test_engine_late_types(void) {
+    printf("  Testing component types registered after the engine...\n");
+    
+    ECS* ecs = create_engine_world();
+    QueryEngine* engine = QueryEngine_new(ecs, NULL);
+    
+    // Cached while Tag is still unknown
+    TEST_ASSERT_EQ(engine_count(engine, "COUNT entities WHERE has(Tag)"), 0, "Tag is not registered yet");
+    
+    ComponentTypeId tagType = ECS_register_component_type(ecs, "Tag", sizeof(int));
+    ComponentTypeId markType = ECS_register_component_type(ecs, "Mark", sizeof(int));
+    int tag = 1;
+    EntityId tagged = Entity_create(ECS_get_entity_registry(ecs));
+    ECS_add_component(ecs, tagged, tagType, &tag);
+    ECS_add_component(ecs, tagged, markType, &tag);
+    
+    TEST_ASSERT_EQ(engine_count(engine, "COUNT entities WHERE has(Mark)"), 1, "New type resolves without schema_changed");
+    TEST_ASSERT_EQ(engine_count(engine, "COUNT entities WHERE has(Tag)"), 1, "Stale plan should be dropped");
+    TEST_ASSERT_EQ(QueryEngine_get_stats(engine).planHits, 0, "Both queries were recompiled");
+    
+    QueryEngine_destroy(engine);
+    ECS_destroy(ecs);
+}
+
+// Heap allocator that keeps count of what passes through it
+typedef struct {
+    size_t live;
+    size_t allocs;
+    size_t reallocs;
+    size_t frees;
+} CountingHeap;
+
+static void* counting_alloc(void* user, size_t size) {
+    CountingHeap* heap = (CountingHeap*)user;
+    heap->allocs++;
+    heap->live += size;
+    return malloc(size);
+}
+
+static void* counting_realloc(void* user, void* ptr, size_t oldSize, size_t newSize) {
+    CountingHeap* heap = (CountingHeap*)user;
+    heap->reallocs++;
+    heap->live += newSize - oldSize;
+    return realloc(ptr, newSize);
+}
+
+static void counting_free(void* user, void* ptr, size_t size) {
+    CountingHeap* heap = (CountingHeap*)user;
+    heap->frees++;
+    heap->live -= size;
+    free(ptr);
+}
+
+static void test_engine_allocator(void) {
+    printf("  Testing a custom allocator and per-query memory...\n");
+    
+    ECS* ecs = create_engine_world();
+    CountingHeap heap;
+    memset(&heap, 0, sizeof(heap));
+    QueryAllocator allocator = {counting_alloc, counting_realloc, counting_free, &heap};
+    QueryEngineConfig config = QueryEngineConfig_default();
+    TEST_ASSERT_TRUE(config.allocator == NULL, "Default engines use libcore");
+    config.allocator = &allocator;
+    QueryEngine* engine = QueryEngine_new(ecs, &config);
+    TEST_ASSERT_NOT_NULL(engine, "Engine should be created");
+    TEST_ASSERT_TRUE(heap.allocs > 0, "Engine state comes from the allocator");
+    register_engine_fields(engine);
+    
+    // The first run compiles the plan, the second reuses it
+    const char* filter = "SELECT entities WHERE Health.hp < 20 AND Position.x >= 10";
+    QueryEngineResult first;
+    QueryEngineResult second;
+    TEST_ASSERT_EQ(QueryEngine_execute(engine, filter, &first), QUERY_SUCCESS, "First run should succeed");
+    TEST_ASSERT_EQ(QueryEngine_execute(engine, filter, &second), QUERY_SUCCESS, "Second run should succeed");
+    TEST_ASSERT_EQ(second.count, 5, "Filter should find 10 to 18");
+    TEST_ASSERT_TRUE(first.allocator == &allocator, "Result buffers come from the allocator");
+    TEST_ASSERT_TRUE(first.memory.allocations > second.memory.allocations, "Compiling the plan costs blocks");
+    TEST_ASSERT_TRUE(second.memory.allocations > 0, "Execution allocates");
+    TEST_ASSERT_TRUE(second.memory.peakBytes > 0, "Result buffer is live at the end");
+    TEST_ASSERT_TRUE(second.memory.peakBytes <= second.memory.bytesAllocated, "Peak is bounded by the total");
+    
+    QueryEngineStats stats = QueryEngine_get_stats(engine);
+    TEST_ASSERT_EQ(stats.bytesAllocated, first.memory.bytesAllocated + second.memory.bytesAllocated,
+                   "Engine totals the bytes of its queries");
+    TEST_ASSERT_EQ(stats.peakBytes, first.memory.peakBytes, "Engine keeps the highest peak");
+    
+    // Five names outgrow the parser's first component list
+    TEST_ASSERT_EQ(engine_count(engine, "COUNT entities WHERE has(Position, Health, Position, Health, Position)"),
+                   50, "Repeated names should still match");
+    TEST_ASSERT_TRUE(heap.reallocs > 0, "Growing buffers go through realloc");
+    
+    QueryEngineResult_free(&first);
+    QueryEngineResult_free(&second);
+    QueryEngine_destroy(engine);
+    TEST_ASSERT_EQ(heap.live, 0, "Every byte is returned");
+    TEST_ASSERT_EQ(heap.frees, heap.allocs, "Every block is returned");
+    
+    // Stateless calls use libcore and report no accounting
+    QueryEngineResult direct;
+    TEST_ASSERT_EQ(Query_execute(ecs, "SELECT entities WHERE has(Health)", &direct), QUERY_SUCCESS,
+                   "Query_execute should succeed");
+    TEST_ASSERT_TRUE(direct.allocator == QueryAllocator_default(), "Stateless results use libcore");
+    TEST_ASSERT_EQ(direct.memory.allocations, 0, "Only engines account memory");
+    QueryEngineResult_free(&direct);
+    
+    ECS_destroy(ecs);
+}
+
+static void test_engine_memory_budget(void) {
+    printf("  Testing the per-query memory budget...\n");
+    
+    ECS* ecs = create_engine_world();
+    CountingHeap heap;
+    memset(&heap, 0, sizeof(heap));
+    QueryAllocator allocator = {counting_alloc, counting_realloc, counting_free, &heap};
+    QueryEngineConfig config = QueryEngineConfig_default();
+    TEST_ASSERT_EQ(config.queryMemoryBudget, 0, "Default engines have no budget");
+    config.allocator = &allocator;
+    config.queryMemoryBudget = 64 * 1024;
+    QueryEngine* engine = QueryEngine_new(ecs, &config);
+    register_engine_fields(engine);
+    
+    // Within the budget nothing changes
+    const char* filter = "SELECT entities WHERE Health.hp < 20 AND Position.x >= 10";
+    QueryEngineResult result;
+    TEST_ASSERT_EQ(QueryEngine_execute(engine, filter, &result), QUERY_SUCCESS, "Query within budget should succeed");
+    TEST_ASSERT_EQ(result.count, 5, "Filter should find 10 to 18");
+    TEST_ASSERT_EQ(result.memory.refused, 0, "Nothing refused");
+    TEST_ASSERT_TRUE(result.memory.peakBytes <= config.queryMemoryBudget, "Peak stays under the budget");
+    QueryEngineResult_free(&result);
+    QueryEngine_destroy(engine);
+    
+    // A budget that holds the plan but not the result fails the query and keeps nothing
+    config.queryMemoryBudget = 1024;
+    engine = QueryEngine_new(ecs, &config);
+    TEST_ASSERT_EQ(engine_count(engine, "COUNT entities WHERE has(Position)"), 100, "Count fits the budget");
+    TEST_ASSERT_EQ(QueryEngine_execute(engine, "SELECT entities WHERE has(Position)", &result), QUERY_ERROR_EXECUTION,
+                   "Query over budget should fail");
+    TEST_ASSERT_EQ(result.count, 0, "A refused query returns no rows");
+    TEST_ASSERT_NULL(result.entities, "A refused query returns no entities");
+    TEST_ASSERT_TRUE(result.memory.refused > 0, "Refusals should be counted");
+    TEST_ASSERT_TRUE(result.memory.peakBytes <= config.queryMemoryBudget, "Peak stays under the budget");
+    QueryEngineStats stats = QueryEngine_get_stats(engine);
+    TEST_ASSERT_EQ(stats.failures, 1, "Refused query counts as a failure");
+    QueryEngine_destroy(engine);
+    
+    // Running out while parsing reports the budget too
+    config.queryMemoryBudget = 64;
+    engine = QueryEngine_new(ecs, &config);
+    TEST_ASSERT_EQ(QueryEngine_execute(engine, "COUNT entities WHERE has(Position)", &result), QUERY_ERROR_EXECUTION,
+                   "Parse over budget should fail");
+    QueryExplain explain;
+    TEST_ASSERT_EQ(QueryEngine_explain(engine, "COUNT entities WHERE has(Position)", &explain), QUERY_ERROR_EXECUTION,
+                   "Explain over budget should fail");
+    QueryExplain_free(&explain);
+    QueryEngine_destroy(engine);
+    TEST_ASSERT_EQ(heap.live, 0, "Refused queries return every byte");
+    TEST_ASSERT_EQ(heap.frees, heap.allocs, "Refused queries return every block");
+    
+    ECS_destroy(ecs);
+}
+
+bool test_engine(void) {
+    printf("Running engine tests...\n");
+    
+    TRY
+        test_engine_plan_cache();
+        test_engine_catalog_and_errors();
+        test_engine_bounds_and_schema();
+        test_engine_late_types();
+        test_engine_allocator();
+        test_engine_memory_budget();
+        test_engine_keyword_limit();
+        test_engine_keyword_index();
+        test_engine_keyword_spatial();
+        test_engine_keyword_hash();
+        test_engine_keyword_changed();
+        test_engine_keyword_sample();
+        
+        printf("  ✓ All engine tests passed\n");
+        return true;
+    EXCEPT(Test_Failed)
+        printf("  ✗ Engine test failed\n");
+        return false;
+    END_TRY;
+}
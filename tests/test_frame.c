@@ -0,0 +1,146 @@
+#include "test_common.h"
+#include "gramarye_query/query.h"
+#include "gramarye_query/frame.h"
+#include "gramarye_ecs/ecs.h"
+#include "arena.h"
+#include "except.h"
+#include <string.h>
+
+// Test component structures
+typedef struct {
+    int x;
+    int y;
+} Position;
+
+typedef struct {
+    int dx;
+    int dy;
+} Velocity;
+
+typedef struct {
+    int hp;
+    int maxHp;
+} Health;
+
+static ECS* create_frame_world(void) {
+    Arena_T arena = Arena_new();
+    ECS* ecs = ECS_new(arena);
+    
+    ComponentTypeId positionType = ECS_register_component_type(ecs, "Position", sizeof(Position));
+    ComponentTypeId velocityType = ECS_register_component_type(ecs, "Velocity", sizeof(Velocity));
+    ComponentTypeId healthType = ECS_register_component_type(ecs, "Health", sizeof(Health));
+    
+    // 60 entities: all have Position, i%2 Velocity, i%3 Health
+    for (int i = 0; i < 60; i++) {
+        EntityId entity = Entity_create(ECS_get_entity_registry(ecs));
+        Position pos = {i, i};
+        ECS_add_component(ecs, entity, positionType, &pos);
+        if (i % 2 == 0) {
+            Velocity vel = {1, 1};
+            ECS_add_component(ecs, entity, velocityType, &vel);
+        }
+        if (i % 3 == 0) {
+            Health health = {100, 100};
+            ECS_add_component(ecs, entity, healthType, &health);
+        }
+    }
+    
+    return ecs;
+}
+
+static void test_frame_matches_direct_execution(void) {
+    printf("  Testing frame results match direct execution...\n");
+    
+    ECS* ecs = create_frame_world();
+    const char* queries[] = {
+        "SELECT entities WHERE has(Position, Velocity)",
+        "SELECT entities WHERE has(Velocity, Position, Health)",
+        "COUNT entities WHERE has_any(Velocity, Health)",
+        "SELECT entities WHERE not_has(Velocity, Health)",
+        "COUNT entities WHERE has(Nonexistent)"
+    };
+    
+    QueryFrame* frame = QueryFrame_begin(ecs);
+    TEST_ASSERT_NOT_NULL(frame, "Frame should be created");
+    
+    for (size_t i = 0; i < sizeof(queries) / sizeof(queries[0]); i++) {
+        QueryEngineResult direct;
+        QueryEngineResult framed;
+        QueryStatus directStatus = Query_execute(ecs, queries[i], &direct);
+        QueryStatus framedStatus = QueryFrame_execute(frame, queries[i], &framed);
+        
+        TEST_ASSERT_EQ(framedStatus, directStatus, "Frame status should match");
+        TEST_ASSERT_EQ(framed.count, direct.count, "Frame count should match");
+        
+        // Same membership, order may differ
+        EntityId* directEntities = (EntityId*)direct.entities;
+        EntityId* framedEntities = (EntityId*)framed.entities;
+        for (size_t a = 0; a < framed.count && framedEntities; a++) {
+            bool found = false;
+            for (size_t b = 0; b < direct.count; b++) {
+                if (framedEntities[a].high == directEntities[b].high &&
+                    framedEntities[a].low == directEntities[b].low) {
+                    found = true;
+                    break;
+                }
+            }
+            TEST_ASSERT_TRUE(found, "Frame entity should be in direct result");
+        }
+        
+        QueryEngineResult_free(&direct);
+        QueryEngineResult_free(&framed);
+    }
+    
+    QueryFrame_end(frame);
+}
+
+static void test_frame_shares_sub_predicates(void) {
+    printf("  Testing sub-predicate reuse within a frame...\n");
+    
+    ECS* ecs = create_frame_world();
+    QueryFrame* frame = QueryFrame_begin(ecs);
+    QueryEngineResult result;
+    
+    QueryFrame_execute(frame, "SELECT entities WHERE has(Position, Velocity)", &result);
+    TEST_ASSERT_EQ(result.count, 30, "Should find 30 moving entities");
+    QueryEngineResult_free(&result);
+    
+    QueryFrameStats stats = QueryFrame_get_stats(frame);
+    uint64_t missesAfterFirst = stats.memoMisses;
+    
+    // Same canonical list: one hit, no new work
+    QueryFrame_execute(frame, "COUNT entities WHERE has(Velocity, Position)", &result);
+    TEST_ASSERT_EQ(result.count, 30, "Count should be 30");
+    QueryEngineResult_free(&result);
+    
+    stats = QueryFrame_get_stats(frame);
+    TEST_ASSERT_EQ(stats.memoMisses, missesAfterFirst, "Identical predicate should not recompute");
+    TEST_ASSERT_TRUE(stats.memoHits >= 1, "Identical predicate should hit");
+    
+    // Extra term: only Health is new
+    QueryFrame_execute(frame, "SELECT entities WHERE has(Position, Velocity, Health)", &result);
+    TEST_ASSERT_EQ(result.count, 10, "Should find entities where i % 6 == 0");
+    QueryEngineResult_free(&result);
+    
+    stats = QueryFrame_get_stats(frame);
+    TEST_ASSERT_EQ(stats.memoMisses, missesAfterFirst + 2, "Only Health and the new list should be computed");
+    TEST_ASSERT_EQ(stats.queries, 3, "Should count three queries");
+    TEST_ASSERT_EQ(stats.entityCount, 60, "Frame should have seen every entity");
+    
+    QueryFrame_end(frame);
+}
+
+bool test_frame(void) {
+    printf("Running frame tests...\n");
+    
+    TRY
+        test_frame_matches_direct_execution();
+        test_frame_shares_sub_predicates();
+        
+        printf("  ✓ All frame tests passed\n");
+        return true;
+    EXCEPT(Test_Failed)
+        printf("  ✗ Frame test failed\n");
+        return false;
+    END_TRY;
+}
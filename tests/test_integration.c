@@ -191,6 +191,54 @@ static void test_integration_show_all_components(void) {
     QueryEngineResult_free(&result);
 }
 
+static void test_integration_batch_mixed(void) {
+    printf("  Testing batch execution with mixed queries...\n");
+    
+    Arena_T arena = Arena_new();
+    ECS* ecs = ECS_new(arena);
+    
+    ComponentTypeId positionType = ECS_register_component_type(ecs, "Position", sizeof(Position));
+    ComponentTypeId healthType = ECS_register_component_type(ecs, "Health", sizeof(Health));
+    
+    EntityId entity = Entity_create(ECS_get_entity_registry(ecs));
+    Position pos = {1, 2};
+    Health health = {50, 100};
+    ECS_add_component(ecs, entity, positionType, &pos);
+    ECS_add_component(ecs, entity, healthType, &health);
+    EntityId other = Entity_create(ECS_get_entity_registry(ecs));
+    ECS_add_component(ecs, other, positionType, &pos);
+    
+    char showQuery[256];
+    snprintf(showQuery, sizeof(showQuery), "SHOW Health OF entity %llu:%llu",
+             (unsigned long long)entity.high, (unsigned long long)entity.low);
+    
+    const char* queries[] = {
+        "SELECT entities WHERE has(Position, Health)",
+        "COUNT entities WHERE has(Position)",
+        "INVALID QUERY",
+        showQuery,
+        "SELECT entities WHERE not_has(Health)",
+        "SELECT entities WHERE has(Nonexistent)"
+    };
+    QueryEngineResult results[6];
+    
+    QueryStatus status = Query_execute_batch(ecs, queries, 6, results);
+    TEST_ASSERT_EQ(status, QUERY_ERROR_PARSE, "Batch should report the parse error");
+    TEST_ASSERT_EQ(results[0].count, 1, "has(Position, Health) should find 1 entity");
+    TEST_ASSERT_NOT_NULL(results[0].entities, "SELECT should return entities");
+    TEST_ASSERT_EQ(results[1].count, 2, "COUNT has(Position) should be 2");
+    TEST_ASSERT_NULL(results[1].entities, "COUNT should not return entities");
+    TEST_ASSERT_EQ(results[2].count, 0, "Failed query should be empty");
+    TEST_ASSERT_NOT_NULL(results[3].data, "SHOW should return component data");
+    TEST_ASSERT_EQ(((Health*)results[3].data)->hp, 50, "SHOW data should match");
+    TEST_ASSERT_EQ(results[4].count, 1, "not_has(Health) should find 1 entity");
+    TEST_ASSERT_EQ(results[5].count, 0, "Unknown component should be empty");
+    
+    for (size_t i = 0; i < 6; i++) {
+        QueryEngineResult_free(&results[i]);
+    }
+}
+
 bool test_integration(void) {
     printf("Running integration tests...\n");
     
@@ -199,6 +247,7 @@ bool test_integration(void) {
         test_integration_large_ecs();
         test_integration_empty_results();
         test_integration_show_all_components();
+        test_integration_batch_mixed();
         
         printf("  ✓ All integration tests passed\n");
         return true;
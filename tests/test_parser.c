@@ -1,7 +1,11 @@
 #include "test_common.h"
 #include "gramarye_query/parser.h"
+#include "gramarye_query/symbols.h"
+#include "gramarye_ecs/ecs.h"
+#include "arena.h"
 #include "except.h"
 #include <string.h>
+#include <stdio.h>
 
 static void test_parser_basic_select(void) {
     printf("  Testing basic SELECT query parsing...\n");
@@ -181,6 +185,213 @@ static void test_parser_whitespace_handling(void) {
     QueryParser_destroy(parser);
 }
 
+static void test_parser_limit_and_placeholders(void) {
+    printf("  Testing LIMIT and placeholder parsing...\n");
+    
+    QueryParser* parser = QueryParser_new("SELECT entities WHERE has(Position) LIMIT 10");
+    QueryAST* ast = QueryParser_parse(parser);
+    TEST_ASSERT_NOT_NULL(ast, "AST should be created");
+    SelectQueryData* selectData = (SelectQueryData*)QueryAST_get_data(ast);
+    TEST_ASSERT_NOT_NULL(selectData, "LIMIT data should exist");
+    TEST_ASSERT_EQ(selectData->limit, 10ULL, "Limit should be 10");
+    TEST_ASSERT_EQ(selectData->limitParam, 0, "Literal limit has no parameter");
+    QueryAST_destroy(ast);
+    QueryParser_destroy(parser);
+    
+    parser = QueryParser_new("SELECT entities WHERE has(Position) LIMIT ?");
+    ast = QueryParser_parse(parser);
+    TEST_ASSERT_NOT_NULL(ast, "AST should be created");
+    selectData = (SelectQueryData*)QueryAST_get_data(ast);
+    TEST_ASSERT_EQ(selectData->limitParam, 1, "? should be parameter 1");
+    TEST_ASSERT_EQ(QueryParser_get_param_count(parser), 1, "Should have one parameter");
+    QueryAST_destroy(ast);
+    QueryParser_destroy(parser);
+    
+    parser = QueryParser_new("SHOW Health OF entity $3");
+    ast = QueryParser_parse(parser);
+    TEST_ASSERT_NOT_NULL(ast, "AST should be created");
+    ShowQueryData* showData = (ShowQueryData*)QueryAST_get_data(ast);
+    TEST_ASSERT_NULL(showData->entityId, "Placeholder has no literal id");
+    TEST_ASSERT_EQ(showData->entityParam, 3, "$3 should be parameter 3");
+    TEST_ASSERT_EQ(QueryParser_get_param_count(parser), 3, "Parameter count is the highest index");
+    QueryAST_destroy(ast);
+    QueryParser_destroy(parser);
+    
+    // $0 and a LIMIT without a value are rejected
+    parser = QueryParser_new("SHOW ALL OF entity $0");
+    ast = QueryParser_parse(parser);
+    TEST_ASSERT_NULL(ast, "$0 should be rejected");
+    QueryParser_destroy(parser);
+    
+    parser = QueryParser_new("SELECT entities WHERE has(Position) LIMIT");
+    ast = QueryParser_parse(parser);
+    TEST_ASSERT_NULL(ast, "LIMIT needs a value");
+    QueryParser_destroy(parser);
+}
+
+static void test_parser_filters(void) {
+    printf("  Testing filter, spatial and CREATE INDEX parsing...\n");
+    
+    // AND binds tighter than OR; BETWEEN owns its own AND
+    QueryParser* parser = QueryParser_new(
+        "SELECT entities WHERE Position.x BETWEEN -1.5 AND 2 AND has(Health) OR Health.hp >= 10");
+    QueryAST* ast = QueryParser_parse(parser);
+    TEST_ASSERT_NOT_NULL(ast, "AST should be created");
+    
+    QueryAST* condition = QueryAST_get_left(ast);
+    TEST_ASSERT_EQ(QueryAST_get_type(condition), AST_OR, "Top level should be OR");
+    QueryAST* conjunction = QueryAST_get_left(condition);
+    TEST_ASSERT_EQ(QueryAST_get_type(conjunction), AST_AND, "Left of OR should be AND");
+    
+    FilterData* between = (FilterData*)QueryAST_get_data(QueryAST_get_left(conjunction));
+    TEST_ASSERT_EQ(between->op, FILTER_OP_BETWEEN, "Should be BETWEEN");
+    TEST_ASSERT(strcmp(between->componentName, "Position") == 0 && strcmp(between->fieldName, "x") == 0,
+                "Field should be Position.x");
+    TEST_ASSERT(between->value == -1.5 && between->upper == 2.0, "Bounds should be -1.5 and 2");
+    
+    FilterData* compare = (FilterData*)QueryAST_get_data(QueryAST_get_right(condition));
+    TEST_ASSERT_EQ(compare->op, FILTER_OP_GE, "Should be >=");
+    QueryAST_destroy(ast);
+    QueryParser_destroy(parser);
+    
+    parser = QueryParser_new("CREATE INDEX ON Sprite.index");
+    ast = QueryParser_parse(parser);
+    TEST_ASSERT_NOT_NULL(ast, "CREATE INDEX should parse, keywords allowed as field names");
+    TEST_ASSERT_EQ(QueryAST_get_type(ast), AST_CREATE_INDEX, "Should be CREATE INDEX");
+    IndexQueryData* indexData = (IndexQueryData*)QueryAST_get_data(ast);
+    TEST_ASSERT(strcmp(indexData->fieldName, "index") == 0, "Field should be index");
+    QueryAST_destroy(ast);
+    QueryParser_destroy(parser);
+    
+    parser = QueryParser_new("COUNT entities WHERE WITHIN(Position, 1.5, -2, ?) AND INSIDE(Position, 0, 0, 10, 10)");
+    ast = QueryParser_parse(parser);
+    TEST_ASSERT_NOT_NULL(ast, "Spatial predicates should parse");
+    condition = QueryAST_get_left(ast);
+    TEST_ASSERT_EQ(QueryAST_get_type(QueryAST_get_left(condition)), AST_WITHIN, "Should be WITHIN");
+    TEST_ASSERT_EQ(QueryAST_get_type(QueryAST_get_right(condition)), AST_INSIDE, "Should be INSIDE");
+    SpatialQueryData* within = (SpatialQueryData*)QueryAST_get_data(QueryAST_get_left(condition));
+    TEST_ASSERT(strcmp(within->componentName, "Position") == 0, "Component should be Position");
+    TEST_ASSERT(within->argCount == 3 && within->args[0] == 1.5 && within->args[1] == -2.0,
+                "Center should be (1.5, -2)");
+    TEST_ASSERT_EQ(within->argParams[2], 1, "Radius should be a placeholder");
+    QueryAST_destroy(ast);
+    QueryParser_destroy(parser);
+    
+    parser = QueryParser_new("SELECT entities WHERE Team.id IN (3, $2, -1)");
+    ast = QueryParser_parse(parser);
+    TEST_ASSERT_NOT_NULL(ast, "IN should parse");
+    FilterData* in = (FilterData*)QueryAST_get_data(QueryAST_get_left(ast));
+    TEST_ASSERT_EQ(in->op, FILTER_OP_IN, "Should be IN");
+    TEST_ASSERT_EQ(in->valueCount, 3, "Three values");
+    TEST_ASSERT(in->values[0] == 3.0 && in->valueParams[1] == 2 && in->values[2] == -1.0, "Values should be 3, $2, -1");
+    QueryAST_destroy(ast);
+    QueryParser_destroy(parser);
+    
+    parser = QueryParser_new("SELECT entities WHERE CHANGED(Position) AND has(Velocity)");
+    ast = QueryParser_parse(parser);
+    TEST_ASSERT_NOT_NULL(ast, "CHANGED should parse");
+    QueryAST* changed = QueryAST_get_left(QueryAST_get_left(ast));
+    TEST_ASSERT_EQ(QueryAST_get_type(changed), AST_CHANGED, "Should be CHANGED");
+    TEST_ASSERT_EQ(((ComponentList*)QueryAST_get_data(changed))->count, 1, "One component");
+    QueryAST_destroy(ast);
+    QueryParser_destroy(parser);
+    
+    parser = QueryParser_new("CREATE HASH INDEX ON Team.id");
+    ast = QueryParser_parse(parser);
+    TEST_ASSERT_NOT_NULL(ast, "CREATE HASH INDEX should parse");
+    indexData = (IndexQueryData*)QueryAST_get_data(ast);
+    TEST_ASSERT(indexData->hash, "Should be a hash index");
+    QueryAST_destroy(ast);
+    QueryParser_destroy(parser);
+    
+    const char* invalid[] = {
+        "SELECT entities WHERE Position.x >",
+        "SELECT entities WHERE Position.x ! 3",
+        "SELECT entities WHERE (has(Health)",
+        "SELECT entities WHERE Position > 3",
+        "CREATE INDEX Position.x",
+        "SELECT entities WHERE WITHIN(Position, 1, 2)",
+        "SELECT entities WHERE INSIDE(Position, 0, 0, 1, 1, 2)",
+        "SELECT entities WHERE WITHIN Position, 1, 2, 3",
+        "SELECT entities WHERE Team.id IN ()",
+        "SELECT entities WHERE Team.id IN (1, 2",
+        "SELECT entities WHERE Team.id IN 1, 2",
+        "CREATE HASH Team.id",
+        "SELECT entities WHERE CHANGED Position"
+    };
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+        parser = QueryParser_new(invalid[i]);
+        ast = QueryParser_parse(parser);
+        TEST_ASSERT_NULL(ast, "Malformed filter should fail to parse");
+        QueryParser_destroy(parser);
+    }
+}
+
+static void test_parser_symbols(void) {
+    printf("  Testing component names resolved while lexing...\n");
+    
+    Arena_T arena = Arena_new();
+    ECS* ecs = ECS_new(arena);
+    ComponentTypeId positionType = ECS_register_component_type(ecs, "Position", 8);
+    ComponentTypeId healthType = ECS_register_component_type(ecs, "Health", 8);
+    
+    // Enough names to grow the table past its first allocation
+    char name[32];
+    for (int i = 0; i < 100; i++) {
+        snprintf(name, sizeof(name), "Filler%d", i);
+        ECS_register_component_type(ecs, name, 4);
+    }
+    
+    QuerySymbolTable* symbols = QuerySymbolTable_new(ecs);
+    TEST_ASSERT_NOT_NULL(symbols, "Symbol table should be created");
+    TEST_ASSERT_EQ(QuerySymbolTable_count(symbols), 102, "Every registered type should be interned");
+    TEST_ASSERT_EQ(QuerySymbolTable_lookup(symbols, "Health", 6), healthType, "Lookup by name");
+    TEST_ASSERT_EQ(QuerySymbolTable_lookup(symbols, "Positional", 8), positionType, "Lookup by prefix length");
+    TEST_ASSERT_EQ(QuerySymbolTable_lookup(symbols, "Pos", 3), COMPONENT_TYPE_INVALID, "Partial names are unknown");
+    TEST_ASSERT_EQ(QuerySymbolTable_lookup(symbols, "Filler99", 8),
+                   ECS_get_component_type_by_name(ecs, "Filler99"), "Lookup after growth");
+    
+    // Later registrations appear after a refresh, or on the first lookup that misses
+    ComponentTypeId tagType = ECS_register_component_type(ecs, "Tag", 4);
+    TEST_ASSERT_EQ(QuerySymbolTable_count(symbols), 102, "Not interned yet");
+    TEST_ASSERT_EQ(QuerySymbolTable_refresh(symbols), 1, "Refresh should add one name");
+    TEST_ASSERT_EQ(QuerySymbolTable_lookup(symbols, "Tag", 3), tagType, "Interned after refresh");
+    ComponentTypeId markType = ECS_register_component_type(ecs, "Mark", 4);
+    TEST_ASSERT_EQ(QuerySymbolTable_lookup(symbols, "Mark", 4), markType, "A miss should pick up new types");
+    TEST_ASSERT_EQ(QuerySymbolTable_count(symbols), 104, "Mark should be interned");
+    TEST_ASSERT_EQ(QuerySymbolTable_refresh(symbols), 0, "Nothing left to refresh");
+    
+    QueryParser* parser = QueryParser_new_with_symbols("SELECT entities WHERE has(Health, Missing, Tag)", symbols);
+    QueryAST* ast = QueryParser_parse(parser);
+    TEST_ASSERT_NOT_NULL(ast, "AST should be created");
+    ComponentList* list = (ComponentList*)QueryAST_get_data(QueryAST_get_left(ast));
+    TEST_ASSERT_NOT_NULL(list->typeIds, "Ids should be resolved");
+    TEST_ASSERT_EQ(list->typeIds[0], healthType, "Health should resolve");
+    TEST_ASSERT_EQ(list->typeIds[1], COMPONENT_TYPE_INVALID, "Unknown names resolve to invalid");
+    TEST_ASSERT_EQ(list->typeIds[2], tagType, "Tag should resolve");
+    TEST_ASSERT_EQ(strcmp(list->componentNames[2], "Tag"), 0, "Names are kept");
+    QueryAST_destroy(ast);
+    QueryParser_destroy(parser);
+    
+    parser = QueryParser_new_with_symbols("SHOW Position OF entity 1:2", symbols);
+    ast = QueryParser_parse(parser);
+    ShowQueryData* showData = (ShowQueryData*)QueryAST_get_data(ast);
+    TEST_ASSERT_TRUE(showData->typeResolved && showData->typeId == positionType, "SHOW type should resolve");
+    QueryAST_destroy(ast);
+    QueryParser_destroy(parser);
+    
+    // Without a table nothing is resolved
+    parser = QueryParser_new("SELECT entities WHERE has(Health)");
+    ast = QueryParser_parse(parser);
+    list = (ComponentList*)QueryAST_get_data(QueryAST_get_left(ast));
+    TEST_ASSERT_NULL(list->typeIds, "Plain parser should not resolve ids");
+    QueryAST_destroy(ast);
+    QueryParser_destroy(parser);
+    
+    QuerySymbolTable_destroy(symbols);
+    ECS_destroy(ecs);
+}
+
 bool test_parser(void) {
     printf("Running parser tests...\n");
     
@@ -194,6 +405,9 @@ bool test_parser(void) {
         test_parser_show_all();
         test_parser_invalid_syntax();
         test_parser_whitespace_handling();
+        test_parser_limit_and_placeholders();
+        test_parser_filters();
+        test_parser_symbols();
         
         printf("  ✓ All parser tests passed\n");
         return true;
@@ -0,0 +1,157 @@
+#include "test_common.h"
+#include "gramarye_query/query.h"
+#include "gramarye_query/plan.h"
+#include "gramarye_ecs/ecs.h"
+#include "arena.h"
+#include "except.h"
+#include <string.h>
+
+// Test component structures
+typedef struct {
+    int x;
+    int y;
+} Position;
+
+typedef struct {
+    int hp;
+    int maxHp;
+} Health;
+
+#define PLAN_ENTITY_COUNT 20
+
+static ECS* create_plan_world(EntityId* outEntities) {
+    Arena_T arena = Arena_new();
+    ECS* ecs = ECS_new(arena);
+    
+    ComponentTypeId positionType = ECS_register_component_type(ecs, "Position", sizeof(Position));
+    ComponentTypeId healthType = ECS_register_component_type(ecs, "Health", sizeof(Health));
+    
+    for (int i = 0; i < PLAN_ENTITY_COUNT; i++) {
+        EntityId entity = Entity_create(ECS_get_entity_registry(ecs));
+        Position pos = {i, -i};
+        Health health = {i * 10, 100};
+        ECS_add_component(ecs, entity, positionType, &pos);
+        ECS_add_component(ecs, entity, healthType, &health);
+        outEntities[i] = entity;
+    }
+    
+    return ecs;
+}
+
+static void test_plan_rebind_entity(void) {
+    printf("  Testing SHOW plan rebinding the entity id...\n");
+    
+    EntityId entities[PLAN_ENTITY_COUNT];
+    ECS* ecs = create_plan_world(entities);
+    
+    QueryPlan* plan = QueryPlan_prepare(ecs, "SHOW Health OF entity ?");
+    TEST_ASSERT_NOT_NULL(plan, "Plan should be prepared");
+    TEST_ASSERT_EQ(QueryPlan_param_count(plan), 1, "Plan should have one parameter");
+    
+    QueryEngineResult result;
+    TEST_ASSERT_EQ(QueryPlan_execute(plan, &result), QUERY_ERROR_INVALID_SYNTAX, "Unbound parameter should fail");
+    
+    // One compiled plan serves every entity
+    for (int i = 0; i < PLAN_ENTITY_COUNT; i++) {
+        TEST_ASSERT_EQ(QueryPlan_bind_entity(plan, 1, entities[i]), QUERY_SUCCESS, "Bind should succeed");
+        TEST_ASSERT_EQ(QueryPlan_execute(plan, &result), QUERY_SUCCESS, "Execute should succeed");
+        TEST_ASSERT_NOT_NULL(result.data, "Component data should be returned");
+        TEST_ASSERT_EQ(((Health*)result.data)->hp, i * 10, "Should read the bound entity");
+        QueryEngineResult_free(&result);
+    }
+    
+    // Wrong kind of value for an entity slot
+    TEST_ASSERT_EQ(QueryPlan_bind_u64(plan, 1, 5), QUERY_ERROR_INVALID_SYNTAX, "Entity slot should reject u64");
+    TEST_ASSERT_EQ(QueryPlan_bind_entity(plan, 2, entities[0]), QUERY_ERROR_INVALID_SYNTAX, "Index out of range");
+    
+    QueryPlan_clear_bindings(plan);
+    TEST_ASSERT_EQ(QueryPlan_execute(plan, &result), QUERY_ERROR_INVALID_SYNTAX, "Cleared binding should fail");
+    
+    QueryPlan_destroy(plan);
+}
+
+static void test_plan_limit_parameter(void) {
+    printf("  Testing LIMIT parameter...\n");
+    
+    EntityId entities[PLAN_ENTITY_COUNT];
+    ECS* ecs = create_plan_world(entities);
+    
+    QueryPlan* plan = QueryPlan_prepare(ecs, "SELECT entities WHERE has(Position, Health) LIMIT $1");
+    TEST_ASSERT_NOT_NULL(plan, "Plan should be prepared");
+    
+    QueryEngineResult result;
+    TEST_ASSERT_EQ(QueryPlan_bind_u64(plan, 1, 5), QUERY_SUCCESS, "Bind should succeed");
+    TEST_ASSERT_EQ(QueryPlan_execute(plan, &result), QUERY_SUCCESS, "Execute should succeed");
+    TEST_ASSERT_EQ(result.count, 5, "Should stop at the limit");
+    QueryEngineResult_free(&result);
+    
+    TEST_ASSERT_EQ(QueryPlan_bind_f64(plan, 1, 100.0), QUERY_SUCCESS, "Integral double should bind");
+    TEST_ASSERT_EQ(QueryPlan_execute(plan, &result), QUERY_SUCCESS, "Execute should succeed");
+    TEST_ASSERT_EQ(result.count, PLAN_ENTITY_COUNT, "Limit above the match count returns all");
+    QueryEngineResult_free(&result);
+    
+    TEST_ASSERT_EQ(QueryPlan_bind_f64(plan, 1, 2.5), QUERY_ERROR_INVALID_SYNTAX, "Fractional limit should fail");
+    TEST_ASSERT_EQ(QueryPlan_bind_f64(plan, 1, -1.0), QUERY_ERROR_INVALID_SYNTAX, "Negative limit should fail");
+    QueryPlan_destroy(plan);
+    
+    // Unprepared placeholders are rejected by the one-shot API
+    TEST_ASSERT_EQ(Query_execute(ecs, "SELECT entities WHERE has(Position) LIMIT ?", &result),
+                   QUERY_ERROR_INVALID_SYNTAX, "Query_execute cannot bind parameters");
+    
+    // Literal limit through the one-shot API
+    TEST_ASSERT_EQ(Query_execute(ecs, "SELECT entities WHERE has(Position) LIMIT 3", &result),
+                   QUERY_SUCCESS, "Literal limit should execute");
+    TEST_ASSERT_EQ(result.count, 3, "Literal limit should apply");
+    QueryEngineResult_free(&result);
+}
+
+static void test_plan_matches_query_execute(void) {
+    printf("  Testing plans without parameters match Query_execute...\n");
+    
+    EntityId entities[PLAN_ENTITY_COUNT];
+    ECS* ecs = create_plan_world(entities);
+    
+    const char* queries[] = {
+        "SELECT entities WHERE has(Position)",
+        "COUNT entities WHERE has_any(Health, Nonexistent)",
+        "SELECT entities WHERE not_has(Health)"
+    };
+    
+    for (size_t i = 0; i < sizeof(queries) / sizeof(queries[0]); i++) {
+        QueryPlan* plan = QueryPlan_prepare(ecs, queries[i]);
+        TEST_ASSERT_NOT_NULL(plan, "Plan should be prepared");
+        TEST_ASSERT_EQ(QueryPlan_param_count(plan), 0, "Plan should have no parameters");
+        
+        QueryEngineResult planned;
+        QueryEngineResult direct;
+        TEST_ASSERT_EQ(QueryPlan_execute(plan, &planned), QUERY_SUCCESS, "Plan should execute");
+        TEST_ASSERT_EQ(Query_execute(ecs, queries[i], &direct), QUERY_SUCCESS, "Query should execute");
+        TEST_ASSERT_EQ(planned.count, direct.count, "Counts should match");
+        if (planned.count > 0 && planned.entities) {
+            TEST_ASSERT(memcmp(planned.entities, direct.entities, sizeof(EntityId) * planned.count) == 0,
+                        "Entities should match");
+        }
+        
+        QueryEngineResult_free(&planned);
+        QueryEngineResult_free(&direct);
+        QueryPlan_destroy(plan);
+    }
+    
+    TEST_ASSERT_NULL(QueryPlan_prepare(ecs, "SELECT entities WHERE"), "Parse errors should not prepare");
+}
+
+bool test_plan(void) {
+    printf("Running plan tests...\n");
+    
+    TRY
+        test_plan_rebind_entity();
+        test_plan_limit_parameter();
+        test_plan_matches_query_execute();
+        
+        printf("  ✓ All plan tests passed\n");
+        return true;
+    EXCEPT(Test_Failed)
+        printf("  ✗ Plan test failed\n");
+        return false;
+    END_TRY;
+}
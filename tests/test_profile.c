@@ -0,0 +1,295 @@
+#include "test_common.h"
+#include "gramarye_query/query.h"
+#include "gramarye_query/engine.h"
+#include "gramarye_query/catalog.h"
+#include "gramarye_query/profile.h"
+#include "gramarye_query/explain.h"
+#include "gramarye_query/shell.h"
+#include "gramarye_query/allocator.h"
+#include "gramarye_ecs/ecs.h"
+#include "arena.h"
+#include "except.h"
+#include <string.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+typedef struct {
+    int x;
+    int y;
+} Position;
+
+typedef struct {
+    int hp;
+    int maxHp;
+} Health;
+
+// 100 entities with Position.x = i; the even ones have Health.hp = i
+static QueryEngine* create_profile_engine(ECS** outEcs) {
+    Arena_T arena = Arena_new();
+    ECS* ecs = ECS_new(arena);
+    ComponentTypeId positionType = ECS_register_component_type(ecs, "Position", sizeof(Position));
+    ComponentTypeId healthType = ECS_register_component_type(ecs, "Health", sizeof(Health));
+    for (int i = 0; i < 100; i++) {
+        EntityId entity = Entity_create(ECS_get_entity_registry(ecs));
+        Position pos = {i, -i};
+        ECS_add_component(ecs, entity, positionType, &pos);
+        if (i % 2 == 0) {
+            Health health = {i, 100};
+            ECS_add_component(ecs, entity, healthType, &health);
+        }
+    }
+    
+    QueryEngine* engine = QueryEngine_new(ecs, NULL);
+    QueryCatalog* catalog = QueryEngine_get_catalog(engine);
+    QueryCatalog_register_field(catalog, "Position", "x", offsetof(Position, x), QUERY_FIELD_I32);
+    QueryCatalog_register_field(catalog, "Health", "hp", offsetof(Health, hp), QUERY_FIELD_I32);
+    *outEcs = ecs;
+    return engine;
+}
+
+static uint64_t phase_sum(const QueryStats* stats) {
+    uint64_t sum = 0;
+    for (int phase = 0; phase < QUERY_PHASE_COUNT; phase++) {
+        sum += stats->phaseTicks[phase];
+    }
+    return sum;
+}
+
+static void test_phase_timing(void) {
+    printf("  Testing per-phase timing...\n");
+    
+    ECS* ecs;
+    QueryEngine* engine = create_profile_engine(&ecs);
+    const char* query = "SELECT entities WHERE Health.hp < 20 AND Position.x >= 10";
+    
+    // The first run lexes and parses; the cached plan skips both
+    QueryEngineResult first;
+    QueryEngineResult second;
+    TEST_ASSERT_EQ(QueryEngine_execute(engine, query, &first), QUERY_SUCCESS, "First run should succeed");
+    TEST_ASSERT_EQ(QueryEngine_execute(engine, query, &second), QUERY_SUCCESS, "Second run should succeed");
+    TEST_ASSERT_EQ(second.count, 5, "Filter should find 10 to 18");
+    
+    TEST_ASSERT_TRUE(first.stats.totalTicks > 0, "Query should be timed");
+    TEST_ASSERT_TRUE(first.stats.phaseTicks[QUERY_PHASE_LEX] > 0, "Compiling should lex");
+    TEST_ASSERT_TRUE(first.stats.phaseTicks[QUERY_PHASE_PARSE] > 0, "Compiling should parse");
+    TEST_ASSERT_TRUE(first.stats.phaseTicks[QUERY_PHASE_SCAN] > 0, "Execution should scan");
+    TEST_ASSERT_TRUE(phase_sum(&first.stats) <= first.stats.totalTicks, "Phases should not overlap");
+    TEST_ASSERT_EQ(second.stats.phaseTicks[QUERY_PHASE_LEX], 0, "Cached plan should not lex");
+    TEST_ASSERT_EQ(second.stats.phaseTicks[QUERY_PHASE_PARSE], 0, "Cached plan should not parse");
+    TEST_ASSERT_TRUE(second.stats.phaseTicks[QUERY_PHASE_RESOLVE] > 0, "Conditions compile per execution");
+    TEST_ASSERT_TRUE(second.stats.phaseTicks[QUERY_PHASE_MATERIALIZE] > 0, "SELECT should materialize");
+    TEST_ASSERT_NULL(second.stats.operators, "Plain execution records no operators");
+    QueryEngineResult_free(&first);
+    QueryEngineResult_free(&second);
+    
+    // Stateless entry points are timed too
+    QueryEngineResult direct;
+    TEST_ASSERT_EQ(Query_execute(ecs, "COUNT entities WHERE has(Health)", &direct), QUERY_SUCCESS,
+                   "Query_execute should succeed");
+    TEST_ASSERT_TRUE(direct.stats.totalTicks > 0, "Query_execute should be timed");
+    TEST_ASSERT_TRUE(phase_sum(&direct.stats) <= direct.stats.totalTicks, "Phases should not overlap");
+    QueryEngineResult_free(&direct);
+    
+    QueryEngine_destroy(engine);
+    ECS_destroy(ecs);
+}
+
+static void test_explain_analyze(void) {
+    printf("  Testing EXPLAIN ANALYZE operator trees...\n");
+    
+    ECS* ecs;
+    QueryEngine* engine = create_profile_engine(&ecs);
+    
+    // Neither field is indexed, so the AND is driven by its first conjunct
+    QueryEngineResult result;
+    TEST_ASSERT_EQ(QueryEngine_analyze(engine, "SELECT entities WHERE Health.hp < 20 AND Position.x >= 10", &result),
+                   QUERY_SUCCESS, "Analyze should succeed");
+    TEST_ASSERT_EQ(result.count, 5, "Analyze should still return the rows");
+    TEST_ASSERT_EQ(result.stats.operatorCount, 4, "Select, And, its driver and one check");
+    
+    const QueryOperatorStats* ops = result.stats.operators;
+    TEST_ASSERT_TRUE(strcmp(ops[0].label, "Select") == 0, "Root should be the SELECT");
+    TEST_ASSERT_EQ(ops[0].depth, 0, "Root is at depth 0");
+    TEST_ASSERT_EQ(ops[0].rowsOut, 5, "Root returns the result");
+    TEST_ASSERT_TRUE(strcmp(ops[1].label, "And") == 0, "Condition should be an And");
+    TEST_ASSERT_EQ(ops[1].depth, 1, "And is below the root");
+    TEST_ASSERT_EQ(ops[1].rowsIn, 10, "And tests the driver's rows");
+    TEST_ASSERT_EQ(ops[1].rowsOut, 5, "And passes the matches");
+    TEST_ASSERT_TRUE(strcmp(ops[2].label, "Filter Health.hp < 20 [scan]") == 0, "Driver should scan Health");
+    TEST_ASSERT_EQ(ops[2].depth, 2, "Driver is below the And");
+    TEST_ASSERT_EQ(ops[2].rowsIn, 50, "Scan reads every Health");
+    TEST_ASSERT_EQ(ops[2].rowsOut, 10, "hp 0 to 18 pass");
+    TEST_ASSERT_TRUE(strcmp(ops[3].label, "Check Position.x >= 10") == 0, "Other conjunct is a check");
+    TEST_ASSERT_EQ(ops[3].depth, 2, "Check is below the And");
+    TEST_ASSERT_EQ(ops[3].rowsIn, 10, "Check sees each candidate");
+    TEST_ASSERT_EQ(ops[3].rowsOut, 5, "Check passes x >= 10");
+    TEST_ASSERT_TRUE(ops[0].ticks >= ops[1].ticks, "Parents include their children's time");
+    
+    // snprintf-style formatting: the length first, then the text
+    size_t length = QueryStats_format(&result.stats, NULL, 0);
+    char* text = (char*)malloc(length + 1);
+    TEST_ASSERT_EQ(QueryStats_format(&result.stats, text, length + 1), length, "Length should be stable");
+    TEST_ASSERT_EQ(strlen(text), length, "Whole text should fit");
+    TEST_ASSERT_NOT_NULL(strstr(text, "    Filter Health.hp < 20 [scan]  (rows in 50, out 10"),
+                         "Operators are indented by depth");
+    TEST_ASSERT_NOT_NULL(strstr(text, "Total "), "Phases should follow");
+    char small[16];
+    TEST_ASSERT_EQ(QueryStats_format(&result.stats, small, sizeof(small)), length, "Truncation keeps the length");
+    TEST_ASSERT_EQ(strlen(small), sizeof(small) - 1, "Truncated text is terminated");
+    free(text);
+    QueryEngineResult_free(&result);
+    
+    // Component predicates are one scan
+    TEST_ASSERT_EQ(QueryEngine_analyze(engine, "COUNT entities WHERE has(Health)", &result), QUERY_SUCCESS,
+                   "Analyze COUNT should succeed");
+    TEST_ASSERT_EQ(result.stats.operatorCount, 2, "Count over one scan");
+    TEST_ASSERT_TRUE(strcmp(result.stats.operators[1].label, "Scan has(Health)") == 0, "Scan names its components");
+    TEST_ASSERT_EQ(result.stats.operators[1].rowsIn, 50, "Scan reads every Health");
+    QueryEngineResult_free(&result);
+    
+    // A failed query keeps no operators
+    TEST_ASSERT_TRUE(QueryEngine_analyze(engine, "SELECT entities WHERE Health.mana < 3", &result) != QUERY_SUCCESS,
+                     "Unknown field should fail");
+    TEST_ASSERT_NULL(result.stats.operators, "Failed analyze frees its operators");
+    TEST_ASSERT_EQ(result.stats.operatorCount, 0, "Failed analyze reports no operators");
+    QueryEngineResult_free(&result);
+    
+    // Stats freed on a failure path may be freed again with their result
+    QueryStats stats;
+    memset(&stats, 0, sizeof(stats));
+    stats.operators = (QueryOperatorStats*)QUERY_ALLOC(sizeof(QueryOperatorStats));
+    stats.operatorCount = 1;
+    QueryStats_free(&stats);
+    TEST_ASSERT_NULL(stats.operators, "Freed stats drop their operators");
+    QueryStats_free(&stats);
+    
+    // Ordinary execution afterwards records none
+    TEST_ASSERT_EQ(QueryEngine_execute(engine, "COUNT entities WHERE has(Health)", &result), QUERY_SUCCESS,
+                   "Execute should succeed");
+    TEST_ASSERT_EQ(result.stats.operatorCount, 0, "Analyze should not leak into later queries");
+    QueryEngineResult_free(&result);
+    
+    // The shell prints the same tree
+    QueryShell* shell = QueryShell_new(ecs);
+    QueryCatalog_register_field(QueryEngine_get_catalog(QueryShell_get_engine(shell)), "Health", "hp",
+                                offsetof(Health, hp), QUERY_FIELD_I32);
+    QueryShell_process_command(shell, "explain analyze COUNT entities WHERE has(Position)");
+    QueryShell_process_command(shell, "EXPLAIN ANALYZE SELECT entities WHERE Health.hp < 3");
+    QueryShell_process_command(shell, "EXPLAIN ANALYZE ");
+    QueryShell_destroy(shell);
+    
+    QueryEngine_destroy(engine);
+    ECS_destroy(ecs);
+}
+
+static void test_explain(void) {
+    printf("  Testing EXPLAIN estimates...\n");
+    
+    ECS* ecs;
+    QueryEngine* engine = create_profile_engine(&ecs);
+    QueryCatalog* catalog = QueryEngine_get_catalog(engine);
+    
+    // Populations: 100 Position, 50 Health
+    QueryExplain explain;
+    TEST_ASSERT_EQ(QueryEngine_explain(engine, "SELECT entities WHERE has(Position, Health)", &explain),
+                   QUERY_SUCCESS, "Explain should succeed");
+    TEST_ASSERT_EQ(explain.nodeCount, 2, "Select over one scan");
+    TEST_ASSERT_TRUE(strcmp(explain.nodes[1].label, "Scan has(Position, Health)") == 0, "Scan names its components");
+    TEST_ASSERT_EQ(explain.rows, 50, "Matches are bounded by the smaller component");
+    TEST_ASSERT_EQ(explain.cost, 100, "Each Health is looked up in Position");
+    TEST_ASSERT_EQ(explain.drivingType, ECS_get_component_type_by_name(ecs, "Health"), "Health drives");
+    TEST_ASSERT_EQ(explain.access, QUERY_ACCESS_SCAN, "Component storage is scanned");
+    QueryExplain_free(&explain);
+    
+    // Same tree as EXPLAIN ANALYZE: the AND is driven by its first unindexed conjunct
+    const char* filter = "COUNT entities WHERE Health.hp < 20 AND Position.x >= 10";
+    TEST_ASSERT_EQ(QueryEngine_explain(engine, filter, &explain), QUERY_SUCCESS, "Explain filter should succeed");
+    TEST_ASSERT_EQ(explain.nodeCount, 4, "Count, And, its driver and one check");
+    TEST_ASSERT_TRUE(strcmp(explain.nodes[2].label, "Filter Health.hp < 20 [scan]") == 0, "Driver scans Health");
+    TEST_ASSERT_EQ(explain.nodes[2].cost, 50, "Scan reads every Health");
+    TEST_ASSERT_EQ(explain.nodes[2].rows, 17, "A third of a range passes without an index");
+    TEST_ASSERT_TRUE(strcmp(explain.nodes[3].label, "Check Position.x >= 10") == 0, "Other conjunct is a check");
+    TEST_ASSERT_EQ(explain.nodes[3].depth, 2, "Check is below the And");
+    TEST_ASSERT_EQ(explain.cost, 67, "Scan plus one test per candidate");
+#if GRAMARYE_QUERY_PROFILE
+    QueryEngineResult analyzed;
+    TEST_ASSERT_EQ(QueryEngine_analyze(engine, filter, &analyzed), QUERY_SUCCESS, "Analyze should succeed");
+    TEST_ASSERT_EQ(analyzed.stats.operatorCount, explain.nodeCount, "Analyze runs the explained tree");
+    for (size_t i = 0; i < explain.nodeCount; i++) {
+        TEST_ASSERT_TRUE(strcmp(analyzed.stats.operators[i].label, explain.nodes[i].label) == 0,
+                         "Labels should match");
+        TEST_ASSERT_EQ(analyzed.stats.operators[i].depth, explain.nodes[i].depth, "Depths should match");
+    }
+    QueryEngineResult_free(&analyzed);
+#endif
+    QueryExplain_free(&explain);
+    
+    // An index serves a narrow range, and explaining does not use it
+    TEST_ASSERT_EQ(QueryCatalog_create_index(catalog, "Health", "hp"), QUERY_SUCCESS, "Index should build");
+    TEST_ASSERT_EQ(QueryEngine_explain(engine, "SELECT entities WHERE Health.hp < 6 LIMIT 2", &explain),
+                   QUERY_SUCCESS, "Explain indexed filter should succeed");
+    TEST_ASSERT_TRUE(strcmp(explain.nodes[0].label, "Select LIMIT 2") == 0, "Root carries the limit");
+    TEST_ASSERT_TRUE(strcmp(explain.nodes[1].label, "Filter Health.hp < 6 [index]") == 0, "Filter uses the index");
+    TEST_ASSERT_EQ(explain.access, QUERY_ACCESS_INDEX, "Index drives");
+    TEST_ASSERT_TRUE(explain.nodes[1].rows <= 10, "Index estimates the range");
+    TEST_ASSERT_TRUE(explain.rows <= 2, "LIMIT caps the rows");
+    QueryIndexStats indexStats;
+    QueryCatalog_get_index_stats(catalog, "Health", "hp", &indexStats);
+    TEST_ASSERT_EQ(indexStats.scans, 0, "Explain should not scan the index");
+    
+    size_t length = QueryExplain_format(&explain, NULL, 0);
+    char* text = (char*)malloc(length + 1);
+    TEST_ASSERT_EQ(QueryExplain_format(&explain, text, length + 1), length, "Length should be stable");
+    TEST_ASSERT_NOT_NULL(strstr(text, "Driving Health via index"), "Format names the driving access");
+    free(text);
+    QueryExplain_free(&explain);
+    
+    // not_has() reads every entity, and the ECS does not count them
+    TEST_ASSERT_EQ(QueryEngine_explain(engine, "COUNT entities WHERE not_has(Health)", &explain), QUERY_SUCCESS,
+                   "Explain not_has should succeed");
+    TEST_ASSERT_EQ(explain.rows, QUERY_ESTIMATE_UNKNOWN, "Rows are unknown");
+    char line[128];
+    QueryExplain_format(&explain, line, sizeof(line));
+    TEST_ASSERT_NOT_NULL(strstr(line, "rows ~?"), "Unknown estimates print as ?");
+    QueryExplain_free(&explain);
+    
+    // Errors as in execution; DDL has no plan
+    TEST_ASSERT_TRUE(QueryEngine_explain(engine, "SELECT entities WHERE Health.mana < 3", &explain) != QUERY_SUCCESS,
+                     "Unknown field should fail");
+    QueryExplain_free(&explain);
+    TEST_ASSERT_TRUE(QueryEngine_explain(engine, "CREATE INDEX ON Position.x", &explain) != QUERY_SUCCESS,
+                     "CREATE INDEX is not explained");
+    QueryExplain_free(&explain);
+    TEST_ASSERT_TRUE(Query_explain(ecs, NULL, "SELECT entities WHERE Health.hp < 3", &explain) != QUERY_SUCCESS,
+                     "Filters need a catalog");
+    QueryExplain_free(&explain);
+    
+    QueryShell* shell = QueryShell_new(ecs);
+    QueryShell_process_command(shell, "EXPLAIN SELECT entities WHERE has_any(Position, Health)");
+    QueryShell_process_command(shell, "explain COUNT entities WHERE has(Health) APPROX 10");
+    QueryShell_process_command(shell, "EXPLAIN ");
+    QueryShell_destroy(shell);
+    
+    QueryEngine_destroy(engine);
+    ECS_destroy(ecs);
+}
+
+bool test_profile(void) {
+    printf("Running profiling tests...\n");
+    
+    TRY
+        test_explain();
+#if GRAMARYE_QUERY_PROFILE
+        test_phase_timing();
+        test_explain_analyze();
+#else
+        printf("  (profiling compiled out, timing tests skipped)\n");
+#endif
+        
+        printf("  ✓ All profiling tests passed\n");
+        return true;
+    EXCEPT(Test_Failed)
+        printf("  ✗ Profiling test failed\n");
+        return false;
+    END_TRY;
+}
@@ -0,0 +1,281 @@
+#include "test_common.h"
+#include "gramarye_query/roaring.h"
+#include "gramarye_query/frame.h"
+#include "gramarye_query/query.h"
+#include "gramarye_ecs/ecs.h"
+#include "arena.h"
+#include "except.h"
+#include "mem.h"
+#include <string.h>
+#include <stdint.h>
+
+typedef struct {
+    int x;
+    int y;
+} Position;
+
+typedef struct {
+    int dx;
+    int dy;
+} Velocity;
+
+// Five chunks, so every operation also crosses container boundaries
+#define UNIVERSE 300000
+
+typedef enum {
+    PROFILE_SPARSE,     // Array containers
+    PROFILE_DENSE,      // Bitset containers
+    PROFILE_RUNS,       // Run containers after optimize
+    PROFILE_MIXED       // A different kind per chunk
+} Profile;
+
+static uint32_t next_random(uint32_t* seed) {
+    *seed = *seed * 1103515245u + 12345u;
+    return *seed >> 8;
+}
+
+static void add_value(RoaringBitmap* bitmap, bool* member, uint32_t value) {
+    TEST_ASSERT_TRUE(RoaringBitmap_add(bitmap, value), "Add should succeed");
+    member[value] = true;
+}
+
+static RoaringBitmap* make_bitmap(Profile profile, bool* member, uint32_t* seed) {
+    RoaringBitmap* bitmap = RoaringBitmap_new();
+    TEST_ASSERT_NOT_NULL(bitmap, "Bitmap should be created");
+    memset(member, 0, sizeof(bool) * UNIVERSE);
+    
+    for (uint32_t chunk = 0; chunk * 65536 < UNIVERSE; chunk++) {
+        Profile kind = profile == PROFILE_MIXED ? (Profile)(chunk % 3) : profile;
+        uint32_t base = chunk * 65536;
+        uint32_t span = UNIVERSE - base < 65536 ? UNIVERSE - base : 65536;
+        if (kind == PROFILE_SPARSE) {
+            for (int i = 0; i < 1500; i++) {
+                add_value(bitmap, member, base + next_random(seed) % span);
+            }
+        } else if (kind == PROFILE_DENSE) {
+            for (int i = 0; i < 30000; i++) {
+                add_value(bitmap, member, base + next_random(seed) % span);
+            }
+        } else {
+            // A few long runs with gaps between them
+            uint32_t start = next_random(seed) % 500;
+            while (start < span) {
+                uint32_t length = 1000 + next_random(seed) % 8000;
+                for (uint32_t v = start; v < start + length && v < span; v++) {
+                    add_value(bitmap, member, base + v);
+                }
+                start += length + 1 + next_random(seed) % 3000;
+            }
+        }
+    }
+    
+    RoaringBitmap_optimize(bitmap);
+    return bitmap;
+}
+
+// Bitmap must hold exactly the values flagged in expected, in increasing order
+static void check_bitmap(const RoaringBitmap* bitmap, const bool* expected, uint32_t* scratch, const char* message) {
+    size_t expectedCount = 0;
+    for (size_t k = 0; k < UNIVERSE; k++) {
+        if (expected[k]) expectedCount++;
+    }
+    TEST_ASSERT_EQ(RoaringBitmap_cardinality(bitmap), expectedCount, message);
+    
+    size_t count = RoaringBitmap_to_array(bitmap, scratch, UNIVERSE);
+    TEST_ASSERT_EQ(count, expectedCount, message);
+    for (size_t i = 0; i < count; i++) {
+        TEST_ASSERT_TRUE(scratch[i] < UNIVERSE && expected[scratch[i]], message);
+        if (i > 0) {
+            TEST_ASSERT_TRUE(scratch[i - 1] < scratch[i], "Bitmap values should be strictly ascending");
+        }
+    }
+    for (uint32_t k = 0; k < UNIVERSE; k += 97) {
+        TEST_ASSERT_EQ(RoaringBitmap_contains(bitmap, k), expected[k], "Contains should match reference");
+    }
+}
+
+static void test_roaring_operations(void) {
+    printf("  Testing and/or/andnot across container kinds...\n");
+    
+    bool* inA = (bool*)ALLOC(sizeof(bool) * UNIVERSE);
+    bool* inB = (bool*)ALLOC(sizeof(bool) * UNIVERSE);
+    bool* expected = (bool*)ALLOC(sizeof(bool) * UNIVERSE);
+    uint32_t* scratch = (uint32_t*)ALLOC(sizeof(uint32_t) * UNIVERSE);
+    uint32_t seed = 2024;
+    
+    for (int pa = PROFILE_SPARSE; pa <= PROFILE_MIXED; pa++) {
+        for (int pb = PROFILE_SPARSE; pb <= PROFILE_MIXED; pb++) {
+            RoaringBitmap* a = make_bitmap((Profile)pa, inA, &seed);
+            RoaringBitmap* b = make_bitmap((Profile)pb, inB, &seed);
+            check_bitmap(a, inA, scratch, "Built bitmap should match reference");
+            
+            RoaringBitmap* out = RoaringBitmap_copy(a);
+            TEST_ASSERT_TRUE(RoaringBitmap_and(out, b), "And should succeed");
+            for (size_t k = 0; k < UNIVERSE; k++) expected[k] = inA[k] && inB[k];
+            check_bitmap(out, expected, scratch, "And should match reference");
+            RoaringBitmap_destroy(out);
+            
+            out = RoaringBitmap_copy(a);
+            TEST_ASSERT_TRUE(RoaringBitmap_or(out, b), "Or should succeed");
+            for (size_t k = 0; k < UNIVERSE; k++) expected[k] = inA[k] || inB[k];
+            check_bitmap(out, expected, scratch, "Or should match reference");
+            RoaringBitmap_destroy(out);
+            
+            out = RoaringBitmap_copy(a);
+            TEST_ASSERT_TRUE(RoaringBitmap_andnot(out, b), "Andnot should succeed");
+            for (size_t k = 0; k < UNIVERSE; k++) expected[k] = inA[k] && !inB[k];
+            check_bitmap(out, expected, scratch, "Andnot should match reference");
+            
+            // Optimizing changes the encoding, never the members
+            RoaringBitmap_optimize(out);
+            check_bitmap(out, expected, scratch, "Optimize should keep members");
+            RoaringBitmap_destroy(out);
+            
+            RoaringBitmap_destroy(a);
+            RoaringBitmap_destroy(b);
+        }
+    }
+    
+    // Adds into run containers, in and out of order
+    RoaringBitmap* runs = make_bitmap(PROFILE_RUNS, inA, &seed);
+    for (int i = 0; i < 2000; i++) {
+        add_value(runs, inA, next_random(&seed) % UNIVERSE);
+    }
+    check_bitmap(runs, inA, scratch, "Adds after optimize should match reference");
+    RoaringBitmap_destroy(runs);
+    
+    FREE(inA);
+    FREE(inB);
+    FREE(expected);
+    FREE(scratch);
+}
+
+static void test_roaring_compression(void) {
+    printf("  Testing container selection and memory...\n");
+    
+    // Everything but every 1000th index: a handful of long runs
+    RoaringBitmap* alive = RoaringBitmap_new();
+    for (uint32_t i = 0; i < 1000000; i++) {
+        if (i % 1000 != 0) RoaringBitmap_add(alive, i);
+    }
+    TEST_ASSERT_EQ(RoaringBitmap_cardinality(alive), 999000, "Alive set should hold 999000 indices");
+    
+    size_t bitsetBytes = RoaringBitmap_memory_bytes(alive);
+    RoaringBitmap_optimize(alive);
+    RoaringStats stats = RoaringBitmap_get_stats(alive);
+    TEST_ASSERT_EQ(stats.runContainers, 16, "Every chunk should become runs");
+    TEST_ASSERT_TRUE(RoaringBitmap_memory_bytes(alive) < bitsetBytes / 10, "Runs should be far smaller than bitsets");
+    TEST_ASSERT_TRUE(RoaringBitmap_memory_bytes(alive) < 8192, "1000 runs should fit in a few KB");
+    
+    // Sparse stays in arrays at two bytes a member
+    RoaringBitmap* sparse = RoaringBitmap_new();
+    for (uint32_t i = 0; i < 1000000; i += 250) {
+        RoaringBitmap_add(sparse, i);
+    }
+    RoaringBitmap_optimize(sparse);
+    stats = RoaringBitmap_get_stats(sparse);
+    TEST_ASSERT_EQ(stats.arrayContainers, 16, "Sparse chunks should stay arrays");
+    TEST_ASSERT_EQ(stats.bitsetContainers + stats.runContainers, 0, "Sparse set should use only arrays");
+    
+    // Dead entities of the alive set, and back again
+    RoaringBitmap* dead = RoaringBitmap_new();
+    for (uint32_t i = 0; i < 1000000; i += 1000) {
+        RoaringBitmap_add(dead, i);
+    }
+    RoaringBitmap* all = RoaringBitmap_copy(alive);
+    TEST_ASSERT_TRUE(RoaringBitmap_or(all, dead), "Or should succeed");
+    TEST_ASSERT_EQ(RoaringBitmap_cardinality(all), 1000000, "Alive plus dead should cover everything");
+    RoaringBitmap_optimize(all);
+    stats = RoaringBitmap_get_stats(all);
+    TEST_ASSERT_EQ(stats.runContainers, 16, "Full chunks should be single runs");
+    TEST_ASSERT_TRUE(RoaringBitmap_andnot(all, alive), "Andnot should succeed");
+    TEST_ASSERT_EQ(RoaringBitmap_cardinality(all), 1000, "Removing alive should leave the dead");
+    TEST_ASSERT_TRUE(RoaringBitmap_and(all, sparse), "And should succeed");
+    TEST_ASSERT_EQ(RoaringBitmap_cardinality(all), 1000, "Every 1000th index is also every 250th");
+    
+    RoaringBitmap_destroy(all);
+    RoaringBitmap_destroy(dead);
+    RoaringBitmap_destroy(sparse);
+    RoaringBitmap_destroy(alive);
+}
+
+static void test_roaring_frame_bitmap(void) {
+    printf("  Testing bitmap results from a frame...\n");
+    
+    Arena_T arena = Arena_new();
+    ECS* ecs = ECS_new(arena);
+    ComponentTypeId positionType = ECS_register_component_type(ecs, "Position", sizeof(Position));
+    ComponentTypeId velocityType = ECS_register_component_type(ecs, "Velocity", sizeof(Velocity));
+    for (int i = 0; i < 100; i++) {
+        EntityId entity = Entity_create(ECS_get_entity_registry(ecs));
+        Position pos = {i, i};
+        ECS_add_component(ecs, entity, positionType, &pos);
+        if (i % 2 == 0) {
+            Velocity vel = {1, 1};
+            ECS_add_component(ecs, entity, velocityType, &vel);
+        }
+    }
+    
+    QueryFrame* frame = QueryFrame_begin(ecs);
+    const char* query = "SELECT entities WHERE has(Position, Velocity)";
+    RoaringBitmap* set;
+    TEST_ASSERT_EQ(QueryFrame_execute_bitmap(frame, query, &set), QUERY_SUCCESS, "Bitmap query should succeed");
+    TEST_ASSERT_EQ(RoaringBitmap_cardinality(set), 50, "Bitmap should hold 50 entities");
+    
+    // Same members as the EntityId form
+    QueryEngineResult result;
+    TEST_ASSERT_EQ(QueryFrame_execute(frame, query, &result), QUERY_SUCCESS, "Frame query should succeed");
+    uint32_t indices[64];
+    size_t count = RoaringBitmap_to_array(set, indices, 64);
+    TEST_ASSERT_EQ(count, result.count, "Bitmap and array forms should agree");
+    EntityId* entities = (EntityId*)result.entities;
+    for (size_t i = 0; i < count; i++) {
+        EntityId entity;
+        TEST_ASSERT_TRUE(QueryFrame_entity_at(frame, indices[i], &entity), "Index should map to an entity");
+        bool found = false;
+        for (size_t k = 0; k < result.count && !found; k++) {
+            found = entities[k].high == entity.high && entities[k].low == entity.low;
+        }
+        TEST_ASSERT_TRUE(found, "Bitmap entity should be in the array result");
+    }
+    QueryEngineResult_free(&result);
+    
+    // Compound predicates run through the executor and map into the frame
+    RoaringBitmap* still;
+    TEST_ASSERT_EQ(QueryFrame_execute_bitmap(frame, "SELECT entities WHERE has(Position) AND not_has(Velocity)", &still),
+                   QUERY_SUCCESS, "Compound bitmap should succeed");
+    TEST_ASSERT_EQ(RoaringBitmap_cardinality(still), 50, "Compound bitmap should hold 50 entities");
+    TEST_ASSERT_TRUE(RoaringBitmap_or(still, set), "Or should succeed");
+    TEST_ASSERT_EQ(RoaringBitmap_cardinality(still), 100, "Moving and still should cover every entity");
+    TEST_ASSERT_TRUE(RoaringBitmap_andnot(still, set), "Andnot should succeed");
+    TEST_ASSERT_EQ(RoaringBitmap_cardinality(still), 50, "Removing movers should leave the still ones");
+    RoaringBitmap_destroy(still);
+    
+    RoaringBitmap* none;
+    TEST_ASSERT_NE(QueryFrame_execute_bitmap(frame, "SHOW Position", &none), QUERY_SUCCESS,
+                   "SHOW has no entity list");
+    TEST_ASSERT_NULL(none, "Failed query should not return a bitmap");
+    
+    EntityId unused;
+    TEST_ASSERT_TRUE(!QueryFrame_entity_at(frame, 1000, &unused), "Unknown index should be rejected");
+    TEST_ASSERT_TRUE(QueryFrame_get_stats(frame).setBytes > 0, "Frame should report set memory");
+    
+    RoaringBitmap_destroy(set);
+    QueryFrame_end(frame);
+}
+
+bool test_roaring(void) {
+    printf("Running roaring bitmap tests...\n");
+    
+    TRY
+        test_roaring_operations();
+        test_roaring_compression();
+        test_roaring_frame_bitmap();
+        
+        printf("  ✓ All roaring bitmap tests passed\n");
+        return true;
+    EXCEPT(Test_Failed)
+        printf("  ✗ Roaring bitmap test failed\n");
+        return false;
+    END_TRY;
+}
@@ -19,6 +19,19 @@ extern bool test_executor(void);
 extern bool test_integration(void);
 extern bool test_negative(void);
 extern bool test_stress(void);
+extern bool test_cache(void);
+extern bool test_frame(void);
+extern bool test_plan(void);
+extern bool test_catalog(void);
+extern bool test_diff(void);
+extern bool test_roaring(void);
+extern bool test_sample(void);
+extern bool test_sketch(void);
+extern bool test_snapshot(void);
+extern bool test_engine(void);
+extern bool test_profile(void);
+extern bool test_trace(void);
+extern bool test_shapes(void);
 
 // Test registry
 static TestCase test_registry[] = {
@@ -27,6 +40,19 @@ static TestCase test_registry[] = {
     { "integration", test_integration },
     { "negative", test_negative },
     { "stress", test_stress },
+    { "cache", test_cache },
+    { "frame", test_frame },
+    { "plan", test_plan },
+    { "catalog", test_catalog },
+    { "diff", test_diff },
+    { "roaring", test_roaring },
+    { "sample", test_sample },
+    { "sketch", test_sketch },
+    { "snapshot", test_snapshot },
+    { "engine", test_engine },
+    { "profile", test_profile },
+    { "trace", test_trace },
+    { "shapes", test_shapes },
     { NULL, NULL } // Sentinel
 };
 
@@ -99,6 +125,19 @@ static void print_usage(const char *program_name) {
     printf("  --integration     Run integration tests only\n");
     printf("  --negative        Run negative tests (expected failures)\n");
     printf("  --stress          Run stress tests (performance)\n");
+    printf("  --cache           Run result cache tests\n");
+    printf("  --frame           Run frame memoization tests\n");
+    printf("  --plan            Run prepared plan tests\n");
+    printf("  --catalog         Run catalog and index tests\n");
+    printf("  --diff            Run result diff and set operation tests\n");
+    printf("  --roaring         Run roaring bitmap tests\n");
+    printf("  --sample          Run sampling and approximate count tests\n");
+    printf("  --sketch          Run distinct count and quantile sketch tests\n");
+    printf("  --snapshot        Run epoch snapshot tests\n");
+    printf("  --engine          Run query engine context tests\n");
+    printf("  --profile         Run phase timing and EXPLAIN ANALYZE tests\n");
+    printf("  --trace           Run trace tests\n");
+    printf("  --shapes          Run query shape statistics tests\n");
     printf("\nExamples:\n");
     printf("  %s                    # Run all tests\n", program_name);
     printf("  %s --all              # Run all tests\n", program_name);
@@ -108,6 +147,19 @@ static void print_usage(const char *program_name) {
     printf("  %s --integration      # Run integration tests\n", program_name);
     printf("  %s --negative         # Run negative tests\n", program_name);
     printf("  %s --stress           # Run stress tests\n", program_name);
+    printf("  %s --cache            # Run result cache tests\n", program_name);
+    printf("  %s --frame            # Run frame memoization tests\n", program_name);
+    printf("  %s --plan             # Run prepared plan tests\n", program_name);
+    printf("  %s --catalog          # Run catalog and index tests\n", program_name);
+    printf("  %s --diff             # Run result diff and set operation tests\n", program_name);
+    printf("  %s --roaring          # Run roaring bitmap tests\n", program_name);
+    printf("  %s --sample           # Run sampling and approximate count tests\n", program_name);
+    printf("  %s --sketch           # Run distinct count and quantile sketch tests\n", program_name);
+    printf("  %s --snapshot         # Run epoch snapshot tests\n", program_name);
+    printf("  %s --engine           # Run query engine context tests\n", program_name);
+    printf("  %s --profile          # Run phase timing and EXPLAIN ANALYZE tests\n", program_name);
+    printf("  %s --trace            # Run trace tests\n", program_name);
+    printf("  %s --shapes           # Run query shape statistics tests\n", program_name);
     printf("  %s --list             # List all tests\n", program_name);
 }
 
@@ -139,6 +191,32 @@ int main(int argc, char *argv[]) {
             run_test_by_name("negative");
         } else if (strcmp(argv[1], "--stress") == 0) {
             run_test_by_name("stress");
+        } else if (strcmp(argv[1], "--cache") == 0) {
+            run_test_by_name("cache");
+        } else if (strcmp(argv[1], "--frame") == 0) {
+            run_test_by_name("frame");
+        } else if (strcmp(argv[1], "--plan") == 0) {
+            run_test_by_name("plan");
+        } else if (strcmp(argv[1], "--catalog") == 0) {
+            run_test_by_name("catalog");
+        } else if (strcmp(argv[1], "--diff") == 0) {
+            run_test_by_name("diff");
+        } else if (strcmp(argv[1], "--roaring") == 0) {
+            run_test_by_name("roaring");
+        } else if (strcmp(argv[1], "--sample") == 0) {
+            run_test_by_name("sample");
+        } else if (strcmp(argv[1], "--sketch") == 0) {
+            run_test_by_name("sketch");
+        } else if (strcmp(argv[1], "--snapshot") == 0) {
+            run_test_by_name("snapshot");
+        } else if (strcmp(argv[1], "--engine") == 0) {
+            run_test_by_name("engine");
+        } else if (strcmp(argv[1], "--profile") == 0) {
+            run_test_by_name("profile");
+        } else if (strcmp(argv[1], "--trace") == 0) {
+            run_test_by_name("trace");
+        } else if (strcmp(argv[1], "--shapes") == 0) {
+            run_test_by_name("shapes");
         } else {
             // Assume it's a test name
             run_test_by_name(argv[1]);
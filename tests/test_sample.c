@@ -0,0 +1,266 @@
+#include "test_common.h"
+#include "gramarye_query/query.h"
+#include "gramarye_query/parser.h"
+#include "gramarye_query/executor.h"
+#include "gramarye_query/catalog.h"
+#include "gramarye_query/plan.h"
+#include "gramarye_ecs/ecs.h"
+#include "arena.h"
+#include "except.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stddef.h>
+
+typedef struct {
+    float x;
+    float y;
+} Position;
+
+typedef struct {
+    int hp;
+    int maxHp;
+} Health;
+
+#define SAMPLE_ENTITY_COUNT 200000
+
+typedef struct {
+    ECS* ecs;
+    QueryCatalog* catalog;
+    ComponentTypeId positionType;
+    ComponentTypeId healthType;
+} SampleWorld;
+
+// Position.x is a permutation of 0..N-1 so matches are scattered through
+// storage; Health.hp = i % 100 on every third entity
+static void create_sample_world(SampleWorld* world) {
+    Arena_T arena = Arena_new();
+    world->ecs = ECS_new(arena);
+    world->positionType = ECS_register_component_type(world->ecs, "Position", sizeof(Position));
+    world->healthType = ECS_register_component_type(world->ecs, "Health", sizeof(Health));
+    
+    for (int i = 0; i < SAMPLE_ENTITY_COUNT; i++) {
+        EntityId entity = Entity_create(ECS_get_entity_registry(world->ecs));
+        Position pos = {(float)(((long long)i * 7919) % SAMPLE_ENTITY_COUNT), 0.0f};
+        ECS_add_component(world->ecs, entity, world->positionType, &pos);
+        if (i % 3 == 0) {
+            Health health = {i % 100, 100};
+            ECS_add_component(world->ecs, entity, world->healthType, &health);
+        }
+    }
+    
+    world->catalog = QueryCatalog_new(world->ecs);
+    QueryCatalog_register_field(world->catalog, "Position", "x", offsetof(Position, x), QUERY_FIELD_F32);
+    QueryCatalog_register_field(world->catalog, "Health", "hp", offsetof(Health, hp), QUERY_FIELD_I32);
+}
+
+static size_t exact_count(QueryCatalog* catalog, const char* query) {
+    QueryEngineResult result;
+    TEST_ASSERT_EQ(QueryCatalog_execute(catalog, query, &result), QUERY_SUCCESS, "Exact query should succeed");
+    size_t count = result.count;
+    QueryEngineResult_free(&result);
+    return count;
+}
+
+static void check_estimate(QueryCatalog* catalog, const char* approxQuery, size_t truth, size_t budget) {
+    QueryEngineResult result;
+    TEST_ASSERT_EQ(QueryCatalog_execute(catalog, approxQuery, &result), QUERY_SUCCESS, "APPROX should succeed");
+    TEST_ASSERT_NOT_NULL(result.data, "APPROX should report its error bounds");
+    TEST_ASSERT_NULL(result.entities, "APPROX should not return entities");
+    
+    const QueryCountEstimate* estimate = (const QueryCountEstimate*)result.data;
+    TEST_ASSERT_TRUE(estimate->low <= (double)truth && (double)truth <= estimate->high,
+                     "Interval should contain the true count");
+    TEST_ASSERT_TRUE(estimate->stdError > 0.0, "Sampled estimate should have an error");
+    TEST_ASSERT_TRUE(estimate->high - estimate->low < (double)truth * 0.2, "Interval should be tight");
+    TEST_ASSERT_TRUE(estimate->sampled <= budget * 2, "Work should follow the budget, not the world");
+    TEST_ASSERT_TRUE(estimate->population >= truth, "Population should cover every match");
+    TEST_ASSERT_EQ(result.count, (size_t)(estimate->estimate + 0.5), "Count should be the rounded estimate");
+    QueryEngineResult_free(&result);
+}
+
+static void test_sample_parse(void) {
+    printf("  Testing SAMPLE / APPROX parsing...\n");
+    
+    const char* valid[] = {
+        "SELECT entities WHERE has(Position) SAMPLE 10",
+        "select entities where Position.x < 5 sample 3",
+        "COUNT entities WHERE has(Position) APPROX",
+        "COUNT entities WHERE has(Position) APPROX 500",
+    };
+    for (size_t i = 0; i < sizeof(valid) / sizeof(valid[0]); i++) {
+        QueryParser* parser = QueryParser_new(valid[i]);
+        QueryAST* ast = QueryParser_parse(parser);
+        TEST_ASSERT_NOT_NULL(ast, "Sampling clause should parse");
+        QueryAST_destroy(ast);
+        QueryParser_destroy(parser);
+    }
+    
+    const char* invalid[] = {
+        "SELECT entities WHERE has(Position) SAMPLE",
+        "SELECT entities WHERE has(Position) SAMPLE -1",
+        "SELECT entities WHERE has(Position) SAMPLE ?",
+        "SELECT entities WHERE has(Position) SAMPLE 5 LIMIT 3",
+        "SELECT entities WHERE has(Position) APPROX",
+        "COUNT entities WHERE has(Position) SAMPLE 5",
+        "COUNT entities WHERE has(Position) APPROX 1.5",
+    };
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+        QueryParser* parser = QueryParser_new(invalid[i]);
+        QueryAST* ast = QueryParser_parse(parser);
+        TEST_ASSERT_NULL(ast, "Malformed sampling clause should be rejected");
+        QueryParser_destroy(parser);
+    }
+}
+
+static void test_sample_approx_count(void) {
+    printf("  Testing COUNT ... APPROX error bounds...\n");
+    
+    SampleWorld world;
+    create_sample_world(&world);
+    
+    size_t truth = exact_count(world.catalog, "COUNT entities WHERE Position.x < 60000");
+    TEST_ASSERT_EQ(truth, 60000, "x is a permutation, so 60000 match");
+    check_estimate(world.catalog, "COUNT entities WHERE Position.x < 60000 APPROX", truth,
+                   QUERY_APPROX_DEFAULT_SAMPLES);
+    check_estimate(world.catalog, "COUNT entities WHERE Position.x < 60000 APPROX 20000", truth, 20000);
+    
+    // AND drives from its cheapest side and tests the rest
+    truth = exact_count(world.catalog, "COUNT entities WHERE has(Health) AND Health.hp < 40");
+    check_estimate(world.catalog, "COUNT entities WHERE has(Health) AND Health.hp < 40 APPROX 8000", truth, 8000);
+    
+    // OR branches are sampled separately and never counted twice
+    truth = exact_count(world.catalog, "COUNT entities WHERE Position.x < 50000 OR Health.hp >= 50");
+    check_estimate(world.catalog, "COUNT entities WHERE Position.x < 50000 OR Health.hp >= 50 APPROX 8000",
+                   truth, 8000);
+    
+    // Same world, same answer
+    QueryEngineResult first, second;
+    const char* query = "COUNT entities WHERE Position.x < 60000 APPROX";
+    TEST_ASSERT_EQ(QueryCatalog_execute(world.catalog, query, &first), QUERY_SUCCESS, "APPROX should succeed");
+    TEST_ASSERT_EQ(QueryCatalog_execute(world.catalog, query, &second), QUERY_SUCCESS, "APPROX should succeed");
+    TEST_ASSERT_EQ(first.count, second.count, "Sampling should be deterministic");
+    QueryEngineResult_free(&first);
+    QueryEngineResult_free(&second);
+    
+    // Component predicates are answered from storage exactly
+    QueryEngineResult result;
+    TEST_ASSERT_EQ(QueryCatalog_execute(world.catalog, "COUNT entities WHERE has(Health) APPROX", &result),
+                   QUERY_SUCCESS, "APPROX over has() should succeed");
+    const QueryCountEstimate* estimate = (const QueryCountEstimate*)result.data;
+    TEST_ASSERT_EQ(result.count, (SAMPLE_ENTITY_COUNT + 2) / 3, "has() estimate should be exact");
+    TEST_ASSERT_TRUE(estimate->stdError == 0.0, "Exact estimate should have no error");
+    TEST_ASSERT_EQ(estimate->sampled, 0, "Exact estimate should test nothing");
+    QueryEngineResult_free(&result);
+    
+    // has() over several components samples its smallest list and tests the rest
+    TEST_ASSERT_EQ(QueryCatalog_execute(world.catalog, "COUNT entities WHERE has(Position, Health) APPROX 8000",
+                                        &result), QUERY_SUCCESS, "APPROX over has() of two should succeed");
+    estimate = (const QueryCountEstimate*)result.data;
+    TEST_ASSERT_EQ(estimate->population, (SAMPLE_ENTITY_COUNT + 2) / 3, "Candidates should be the Health list");
+    TEST_ASSERT_TRUE(estimate->sampled <= 16000, "Only sampled candidates should be tested");
+    TEST_ASSERT_TRUE(estimate->low <= (double)estimate->population && estimate->high >= (double)estimate->population,
+                     "Interval should contain the true count");
+    QueryEngineResult_free(&result);
+    
+    // A budget covering every candidate tests them all
+    size_t low = exact_count(world.catalog, "COUNT entities WHERE Health.hp < 10");
+    TEST_ASSERT_EQ(QueryCatalog_execute(world.catalog, "COUNT entities WHERE Health.hp < 10 APPROX 100000", &result),
+                   QUERY_SUCCESS, "APPROX should succeed");
+    estimate = (const QueryCountEstimate*)result.data;
+    TEST_ASSERT_EQ(result.count, low, "Full budget should count exactly");
+    TEST_ASSERT_TRUE(estimate->stdError == 0.0, "Full budget should have no error");
+    TEST_ASSERT_EQ(estimate->sampled, estimate->population, "Full budget should test every candidate");
+    QueryEngineResult_free(&result);
+    
+    QueryCatalog_destroy(world.catalog);
+}
+
+static void test_sample_rows(void) {
+    printf("  Testing SELECT ... SAMPLE...\n");
+    
+    SampleWorld world;
+    create_sample_world(&world);
+    
+    QueryEngineResult result;
+    TEST_ASSERT_EQ(QueryCatalog_execute(world.catalog, "SELECT entities WHERE Position.x < 20000 SAMPLE 500", &result),
+                   QUERY_SUCCESS, "SAMPLE should succeed");
+    TEST_ASSERT_EQ(result.count, 500, "SAMPLE should return n entities");
+    
+    EntityId* entities = (EntityId*)result.entities;
+    QueryEngineResult storage;
+    TEST_ASSERT_EQ(QueryCatalog_execute(world.catalog, "SELECT entities WHERE Position.x < 20000", &storage),
+                   QUERY_SUCCESS, "Full query should succeed");
+    EntityId* ordered = (EntityId*)storage.entities;
+    
+    size_t lastPosition = 0;
+    for (size_t i = 0; i < result.count; i++) {
+        Position* pos = (Position*)ECS_get_component(world.ecs, entities[i], world.positionType);
+        TEST_ASSERT_TRUE(pos && pos->x < 20000, "Sampled entity should match");
+        for (size_t k = 0; k < i; k++) {
+            TEST_ASSERT_TRUE(entities[k].high != entities[i].high || entities[k].low != entities[i].low,
+                             "Sampled entities should be distinct");
+        }
+        for (size_t k = 0; k < storage.count; k++) {
+            if (ordered[k].high == entities[i].high && ordered[k].low == entities[i].low) {
+                if (k > lastPosition) lastPosition = k;
+                break;
+            }
+        }
+    }
+    // A LIMIT would take the first 500 in storage order
+    TEST_ASSERT_TRUE(lastPosition > storage.count / 2, "Sample should spread across storage");
+    QueryEngineResult_free(&storage);
+    QueryEngineResult_free(&result);
+    
+    // Fewer matches than asked for returns them all
+    TEST_ASSERT_EQ(QueryCatalog_execute(world.catalog, "SELECT entities WHERE Position.x < 7 SAMPLE 100", &result),
+                   QUERY_SUCCESS, "SAMPLE should succeed");
+    TEST_ASSERT_EQ(result.count, 7, "SAMPLE should return every match");
+    QueryEngineResult_free(&result);
+    
+    TEST_ASSERT_EQ(QueryCatalog_execute(world.catalog, "SELECT entities WHERE Position.x < 0 SAMPLE 10", &result),
+                   QUERY_SUCCESS, "SAMPLE of nothing should succeed");
+    TEST_ASSERT_EQ(result.count, 0, "SAMPLE of nothing should be empty");
+    QueryEngineResult_free(&result);
+    
+    // Without a catalog, and through a prepared plan
+    TEST_ASSERT_EQ(Query_execute(world.ecs, "SELECT entities WHERE has(Health) SAMPLE 25", &result), QUERY_SUCCESS,
+                   "SAMPLE over has() should succeed");
+    TEST_ASSERT_EQ(result.count, 25, "has() SAMPLE should return n entities");
+    QueryEngineResult_free(&result);
+    TEST_ASSERT_EQ(Query_execute(world.ecs, "SELECT entities WHERE has(Position, Health) SAMPLE 25", &result),
+                   QUERY_SUCCESS, "SAMPLE over has() of two should succeed");
+    TEST_ASSERT_EQ(result.count, 25, "has() of two SAMPLE should return n entities");
+    entities = (EntityId*)result.entities;
+    for (size_t i = 0; i < result.count; i++) {
+        TEST_ASSERT_NOT_NULL(ECS_get_component(world.ecs, entities[i], world.healthType), "Sample should have Health");
+    }
+    QueryEngineResult_free(&result);
+    
+    QueryPlan* plan = QueryPlan_prepare_with_catalog(world.ecs, world.catalog,
+                                                     "SELECT entities WHERE Position.x < ? SAMPLE 40");
+    TEST_ASSERT_NOT_NULL(plan, "SAMPLE plan should prepare");
+    TEST_ASSERT_EQ(QueryPlan_bind_f64(plan, 1, 1000.0), QUERY_SUCCESS, "Bind should succeed");
+    TEST_ASSERT_EQ(QueryPlan_execute(plan, &result), QUERY_SUCCESS, "SAMPLE plan should execute");
+    TEST_ASSERT_EQ(result.count, 40, "SAMPLE plan should return n entities");
+    QueryEngineResult_free(&result);
+    QueryPlan_destroy(plan);
+    
+    QueryCatalog_destroy(world.catalog);
+}
+
+bool test_sample(void) {
+    printf("Running sampling tests...\n");
+    
+    TRY
+        test_sample_parse();
+        test_sample_approx_count();
+        test_sample_rows();
+        
+        printf("  ✓ All sampling tests passed\n");
+        return true;
+    EXCEPT(Test_Failed)
+        printf("  ✗ Sampling test failed\n");
+        return false;
+    END_TRY;
+}
@@ -0,0 +1,216 @@
+#include "test_common.h"
+#include "gramarye_query/query.h"
+#include "gramarye_query/engine.h"
+#include "gramarye_query/catalog.h"
+#include "gramarye_query/shapes.h"
+#include "gramarye_query/shell.h"
+#include "gramarye_ecs/ecs.h"
+#include "arena.h"
+#include "except.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+
+typedef struct {
+    int x;
+    int y;
+} Position;
+
+typedef struct {
+    int hp;
+    int maxHp;
+} Health;
+
+// 30 entities with Position; every third has Health too
+static ECS* create_shapes_world(void) {
+    Arena_T arena = Arena_new();
+    ECS* ecs = ECS_new(arena);
+    ComponentTypeId positionType = ECS_register_component_type(ecs, "Position", sizeof(Position));
+    ComponentTypeId healthType = ECS_register_component_type(ecs, "Health", sizeof(Health));
+    for (int i = 0; i < 30; i++) {
+        EntityId entity = Entity_create(ECS_get_entity_registry(ecs));
+        Position pos = {i, i};
+        ECS_add_component(ecs, entity, positionType, &pos);
+        if (i % 3 == 0) {
+            Health health = {i, 100};
+            ECS_add_component(ecs, entity, healthType, &health);
+        }
+    }
+    return ecs;
+}
+
+static void test_normalize(void) {
+    printf("  Testing query normalization...\n");
+    
+    char text[128];
+    const char* query = "select entities where Health.hp in (1, 2, 3)";
+    uint64_t fingerprint = Query_normalize(query, text, sizeof(text));
+    TEST_ASSERT_TRUE(fingerprint == Query_fingerprint(query), "Normalize should return the fingerprint");
+    TEST_ASSERT_TRUE(strcmp(text, "SELECT ENTITIES WHERE Health.hp IN (?, ...)") == 0,
+                     "Keywords should be upper-cased and IN lists collapsed");
+    
+    Query_normalize("SELECT entities WHERE has(Position, Health)", text, sizeof(text));
+    TEST_ASSERT_TRUE(strcmp(text, "SELECT ENTITIES WHERE HAS(Position, Health)") == 0,
+                     "Component lists should be kept");
+    Query_normalize("SHOW Health OF entity 12:34", text, sizeof(text));
+    TEST_ASSERT_TRUE(strcmp(text, "SHOW Health OF ENTITY ?:?") == 0, "Entity ids should read as literals");
+    Query_normalize("COUNT entities WHERE Health.hp < ?", text, sizeof(text));
+    TEST_ASSERT_TRUE(strcmp(text, "COUNT ENTITIES WHERE Health.hp < ?") == 0, "Placeholders should read as literals");
+    
+    // Text is cut snprintf style
+    char small[8];
+    TEST_ASSERT_TRUE(Query_normalize("SELECT entities WHERE has(Position)", small, sizeof(small)) ==
+                     Query_fingerprint("SELECT entities WHERE has(Position)"),
+                     "Truncation should not change the fingerprint");
+    TEST_ASSERT_TRUE(strcmp(small, "SELECT ") == 0, "Truncated text should stay terminated");
+    size_t length = strlen("SELECT ENTITIES WHERE HAS(Position)");
+    Query_normalize("SELECT entities WHERE has(Position)", text, length + 1);
+    TEST_ASSERT_EQ(strlen(text), length, "Exactly fitting text should be whole");
+}
+
+static void test_histogram(void) {
+    printf("  Testing latency histogram percentiles...\n");
+    
+    QueryLatencyHistogram* histogram = (QueryLatencyHistogram*)calloc(1, sizeof(QueryLatencyHistogram));
+    TEST_ASSERT_NOT_NULL(histogram, "Histogram should be allocated");
+    TEST_ASSERT_EQ(QueryLatencyHistogram_percentile(histogram, 0.5), 0, "Empty histograms report 0");
+    
+    // 1 us .. 10 ms in 1 us steps
+    for (uint64_t ns = 1000; ns <= 10000000; ns += 1000) {
+        QueryLatencyHistogram_record(histogram, ns);
+    }
+    TEST_ASSERT_EQ(histogram->count, 10000, "Every sample should be counted");
+    TEST_ASSERT_EQ(histogram->min, 1000, "Minimum should be exact");
+    TEST_ASSERT_EQ(histogram->max, 10000000, "Maximum should be exact");
+    const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+    for (size_t i = 0; i < sizeof(quantiles) / sizeof(quantiles[0]); i++) {
+        double expected = quantiles[i] * 10000000.0;
+        double reported = (double)QueryLatencyHistogram_percentile(histogram, quantiles[i]);
+        TEST_ASSERT_TRUE(reported >= expected && reported <= expected * 1.035,
+                         "Percentiles should be within the bucket precision");
+    }
+    TEST_ASSERT_EQ(QueryLatencyHistogram_percentile(histogram, 1.0), 10000000, "p100 should be the maximum");
+    
+    // Small values are exact, huge ones land in the last bucket
+    memset(histogram, 0, sizeof(QueryLatencyHistogram));
+    QueryLatencyHistogram_record(histogram, 17);
+    TEST_ASSERT_EQ(QueryLatencyHistogram_percentile(histogram, 0.5), 17, "Small values should be exact");
+    QueryLatencyHistogram_record(histogram, UINT64_MAX / 2);
+    TEST_ASSERT_EQ(histogram->counts[QUERY_HISTOGRAM_BUCKETS - 1], 1, "Huge values should saturate");
+    free(histogram);
+}
+
+static void test_engine_shapes(void) {
+    printf("  Testing per-shape engine statistics...\n");
+    
+    ECS* ecs = create_shapes_world();
+    QueryEngineConfig config = QueryEngineConfig_default();
+    config.shapeEntries = 2;
+    QueryEngine* engine = QueryEngine_new(ecs, &config);
+    QueryCatalog_register_field(QueryEngine_get_catalog(engine), "Health", "hp", offsetof(Health, hp),
+                                QUERY_FIELD_I32);
+                                
+    // Three literals, one shape; the repeated string is served from the plan cache
+    const char* queries[] = {
+        "SELECT entities WHERE Health.hp < 10",
+        "SELECT entities WHERE Health.hp < 20",
+        "select entities where Health.hp < 10",
+        "SELECT entities WHERE Health.hp < 10",
+    };
+    size_t rows = 0;
+    for (size_t i = 0; i < sizeof(queries) / sizeof(queries[0]); i++) {
+        QueryEngineResult result;
+        TEST_ASSERT_EQ(QueryEngine_execute(engine, queries[i], &result), QUERY_SUCCESS, "Query should succeed");
+        rows += result.count;
+        QueryEngineResult_free(&result);
+    }
+    const QueryShapeTable* shapes = QueryEngine_get_shapes(engine);
+    TEST_ASSERT_NOT_NULL(shapes, "Shapes are on by default");
+    TEST_ASSERT_EQ(QueryShapeTable_count(shapes), 1, "Literals should not make new shapes");
+    const QueryShapeStats* shape = QueryShapeTable_find(shapes, Query_fingerprint(queries[0]));
+    TEST_ASSERT_NOT_NULL(shape, "Shape should be found by fingerprint");
+    TEST_ASSERT_EQ(shape->calls, 4, "Every call should be counted");
+    TEST_ASSERT_EQ(shape->rows, rows, "Rows should be summed");
+    TEST_ASSERT_EQ(shape->latency.count, 4, "Every call should be timed");
+    TEST_ASSERT_TRUE(strcmp(shape->text, "SELECT ENTITIES WHERE Health.hp < ?") == 0, "Shape text is normalized");
+    
+    // Failed calls count against their own shape
+    QueryEngineResult result;
+    TEST_ASSERT_TRUE(QueryEngine_execute(engine, "SELECT entities WHERE has(", &result) != QUERY_SUCCESS,
+                     "Malformed query should fail");
+    shape = QueryShapeTable_get(shapes, 1);
+    TEST_ASSERT_NOT_NULL(shape, "Failed query should get a shape");
+    TEST_ASSERT_EQ(shape->failures, 1, "Failure should be counted");
+    TEST_ASSERT_EQ(shape->rows, 0, "Failures return no rows");
+    
+    // A full table only counts further shapes
+    TEST_ASSERT_EQ(QueryEngine_execute(engine, "COUNT entities WHERE has(Position)", &result), QUERY_SUCCESS,
+                   "Count should succeed");
+    QueryEngineResult_free(&result);
+    TEST_ASSERT_EQ(QueryShapeTable_count(shapes), 2, "Table should stay at its capacity");
+    TEST_ASSERT_EQ(QueryShapeTable_untracked(shapes), 1, "Overflowing call should be counted");
+    
+    size_t length = QueryShapeTable_format(shapes, NULL, 0);
+    char* text = (char*)malloc(length + 1);
+    TEST_ASSERT_NOT_NULL(text, "Buffer should be allocated");
+    TEST_ASSERT_EQ(QueryShapeTable_format(shapes, text, length + 1), length, "Format length should be stable");
+    TEST_ASSERT_EQ(strlen(text), length, "Whole text should be written");
+    TEST_ASSERT_TRUE(strstr(text, "SELECT ENTITIES WHERE Health.hp < ?") != NULL, "Format should list shapes");
+    TEST_ASSERT_TRUE(strstr(text, "calls 4, failures 0") != NULL, "Format should show the counts");
+    TEST_ASSERT_TRUE(strstr(text, "1 calls of further shapes") != NULL, "Format should show untracked calls");
+    free(text);
+    
+    QueryEngine_reset_stats(engine);
+    TEST_ASSERT_EQ(QueryShapeTable_count(shapes), 0, "Reset should forget shapes");
+    TEST_ASSERT_EQ(QueryShapeTable_untracked(shapes), 0, "Reset should forget untracked calls");
+    char empty[64];
+    QueryShapeTable_format(shapes, empty, sizeof(empty));
+    TEST_ASSERT_TRUE(strcmp(empty, "No queries recorded\n") == 0, "Empty table should say so");
+    QueryEngine_destroy(engine);
+    
+    // Shapes can be turned off
+    config.shapeEntries = 0;
+    engine = QueryEngine_new(ecs, &config);
+    TEST_ASSERT_EQ(QueryEngine_execute(engine, "COUNT entities WHERE has(Position)", &result), QUERY_SUCCESS,
+                   "Query without shapes should succeed");
+    QueryEngineResult_free(&result);
+    TEST_ASSERT_TRUE(QueryEngine_get_shapes(engine) == NULL, "No table when shapes are off");
+    QueryEngine_destroy(engine);
+    
+    ECS_destroy(ecs);
+}
+
+static void test_shell_stats(void) {
+    printf("  Testing shell STATS...\n");
+    
+    ECS* ecs = create_shapes_world();
+    QueryShell* shell = QueryShell_new(ecs);
+    QueryShell_process_command(shell, "SELECT entities WHERE has(Position, Health)");
+    QueryShell_process_command(shell, "COUNT entities WHERE has(Health)");
+    QueryShell_process_command(shell, "stats");
+    const QueryShapeTable* shapes = QueryEngine_get_shapes(QueryShell_get_engine(shell));
+    TEST_ASSERT_EQ(QueryShapeTable_count(shapes), 2, "Shell queries should be recorded");
+    QueryShell_process_command(shell, "STATS RESET");
+    TEST_ASSERT_EQ(QueryShapeTable_count(shapes), 0, "STATS RESET should forget shapes");
+    QueryShell_process_command(shell, "STATS");
+    QueryShell_destroy(shell);
+    ECS_destroy(ecs);
+}
+
+bool test_shapes(void) {
+    printf("Running query shape tests...\n");
+    
+    TRY
+        test_normalize();
+        test_histogram();
+        test_engine_shapes();
+        test_shell_stats();
+        
+        printf("  ✓ All query shape tests passed\n");
+        return true;
+    EXCEPT(Test_Failed)
+        printf("  ✗ Query shape test failed\n");
+        return false;
+    END_TRY;
+}
@@ -0,0 +1,264 @@
+#include "test_common.h"
+#include "gramarye_query/sketch.h"
+#include "gramarye_query/query.h"
+#include "gramarye_query/parser.h"
+#include "gramarye_query/catalog.h"
+#include "gramarye_query/plan.h"
+#include "gramarye_ecs/ecs.h"
+#include "arena.h"
+#include "except.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <math.h>
+
+typedef struct {
+    int hp;
+    int maxHp;
+} Health;
+
+typedef struct {
+    uint32_t type;
+    float weight;
+} Item;
+
+#define SKETCH_WORKERS 4
+
+static uint64_t next_random(uint64_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static void test_sketch_hyperloglog(void) {
+    printf("  Testing HyperLogLog distinct counts...\n");
+    
+    TEST_ASSERT_NULL(HyperLogLog_new(HLL_MAX_PRECISION + 1), "Oversized precision should be rejected");
+    
+    // Each value three times, split over workers by a stride
+    const uint64_t distinct = 500000;
+    HyperLogLog* whole = HyperLogLog_new(HLL_DEFAULT_PRECISION);
+    HyperLogLog* parts[SKETCH_WORKERS];
+    for (int w = 0; w < SKETCH_WORKERS; w++) {
+        parts[w] = HyperLogLog_new(HLL_DEFAULT_PRECISION);
+        TEST_ASSERT_NOT_NULL(parts[w], "Worker sketch should be created");
+    }
+    for (int round = 0; round < 3; round++) {
+        for (uint64_t v = 0; v < distinct; v++) {
+            HyperLogLog_add_key(whole, v * 2654435761ULL);
+            HyperLogLog_add_key(parts[(v + round) % SKETCH_WORKERS], v * 2654435761ULL);
+        }
+    }
+    
+    double error = HyperLogLog_relative_error(whole);
+    double estimate = HyperLogLog_estimate(whole);
+    TEST_ASSERT_TRUE(fabs(estimate - (double)distinct) < 4.0 * error * (double)distinct,
+                     "Estimate should be within four standard errors");
+    
+    // Merged workers see exactly what the single sketch saw
+    for (int w = 1; w < SKETCH_WORKERS; w++) {
+        TEST_ASSERT_TRUE(HyperLogLog_merge(parts[0], parts[w]), "Merge should succeed");
+    }
+    TEST_ASSERT_TRUE(HyperLogLog_estimate(parts[0]) == estimate, "Merged sketch should equal the single pass");
+    
+    HyperLogLog* other = HyperLogLog_new(10);
+    TEST_ASSERT_TRUE(!HyperLogLog_merge(parts[0], other), "Different precisions should not merge");
+    HyperLogLog_destroy(other);
+    
+    // Small sets are counted almost exactly; -0.0 and 0.0 are one value
+    HyperLogLog* small = HyperLogLog_new(HLL_DEFAULT_PRECISION);
+    TEST_ASSERT_TRUE(HyperLogLog_estimate(small) == 0.0, "Empty sketch should estimate zero");
+    for (int i = 0; i < 40; i++) {
+        HyperLogLog_add_double(small, (double)(i % 20) * 0.5);
+    }
+    HyperLogLog_add_double(small, -0.0);
+    TEST_ASSERT_TRUE(fabs(HyperLogLog_estimate(small) - 20.0) < 0.5, "Twenty values should estimate twenty");
+    HyperLogLog_destroy(small);
+    
+    for (int w = 0; w < SKETCH_WORKERS; w++) {
+        HyperLogLog_destroy(parts[w]);
+    }
+    HyperLogLog_destroy(whole);
+}
+
+static void test_sketch_quantiles(void) {
+    printf("  Testing KLL quantiles...\n");
+    
+    TEST_ASSERT_NULL(QuantileSketch_new(KLL_MIN_K - 1), "Tiny k should be rejected");
+    
+    // A shuffled permutation of 0..n-1, so the value at rank r is r
+    const size_t n = 1000000;
+    double* values = (double*)malloc(sizeof(double) * n);
+    TEST_ASSERT_NOT_NULL(values, "Values should allocate");
+    for (size_t i = 0; i < n; i++) {
+        values[i] = (double)i;
+    }
+    uint64_t state = 0x2545F4914F6CDD1DULL;
+    for (size_t i = n - 1; i > 0; i--) {
+        size_t j = (size_t)(next_random(&state) % (i + 1));
+        double swap = values[i];
+        values[i] = values[j];
+        values[j] = swap;
+    }
+    
+    QuantileSketch* whole = QuantileSketch_new(KLL_DEFAULT_K);
+    QuantileSketch* parts[SKETCH_WORKERS];
+    for (int w = 0; w < SKETCH_WORKERS; w++) {
+        parts[w] = QuantileSketch_new(KLL_DEFAULT_K);
+    }
+    for (size_t i = 0; i < n; i++) {
+        TEST_ASSERT_TRUE(QuantileSketch_add(whole, values[i]), "Add should succeed");
+        TEST_ASSERT_TRUE(QuantileSketch_add(parts[i * SKETCH_WORKERS / n], values[i]), "Add should succeed");
+    }
+    TEST_ASSERT_TRUE(QuantileSketch_add(whole, NAN), "NaN should be ignored");
+    TEST_ASSERT_EQ(QuantileSketch_count(whole), n, "Sketch should count every value");
+    TEST_ASSERT_TRUE(QuantileSketch_retained(whole) < 3 * KLL_DEFAULT_K + 64, "Memory should not grow with n");
+    
+    for (int w = 1; w < SKETCH_WORKERS; w++) {
+        TEST_ASSERT_TRUE(QuantileSketch_merge(parts[0], parts[w]), "Merge should succeed");
+    }
+    TEST_ASSERT_EQ(QuantileSketch_count(parts[0]), n, "Merged sketch should count every value");
+    
+    const double ps[] = {0.01, 0.25, 0.5, 0.95, 0.99};
+    double single[5], merged[5];
+    TEST_ASSERT_TRUE(QuantileSketch_quantiles(whole, ps, 5, single), "Quantiles should succeed");
+    TEST_ASSERT_TRUE(QuantileSketch_quantiles(parts[0], ps, 5, merged), "Quantiles should succeed");
+    double tolerance = 3.0 * QuantileSketch_rank_error(whole) * (double)n;
+    for (int i = 0; i < 5; i++) {
+        double truth = ps[i] * (double)n;
+        TEST_ASSERT_TRUE(fabs(single[i] - truth) < tolerance, "Quantile should be within the rank error");
+        TEST_ASSERT_TRUE(fabs(merged[i] - truth) < tolerance, "Merged quantile should be within the rank error");
+    }
+    TEST_ASSERT_TRUE(QuantileSketch_quantile(whole, 0.0) == 0.0, "p 0 should be the minimum");
+    TEST_ASSERT_TRUE(QuantileSketch_quantile(whole, 1.0) == (double)(n - 1), "p 1 should be the maximum");
+    
+    QuantileSketch* empty = QuantileSketch_new(KLL_DEFAULT_K);
+    TEST_ASSERT_TRUE(isnan(QuantileSketch_quantile(empty, 0.5)), "Empty sketch has no quantiles");
+    QuantileSketch_destroy(empty);
+    
+    for (int w = 0; w < SKETCH_WORKERS; w++) {
+        QuantileSketch_destroy(parts[w]);
+    }
+    QuantileSketch_destroy(whole);
+    free(values);
+}
+
+#define AGGREGATE_ENTITY_COUNT 20000
+
+static QueryCatalog* create_aggregate_world(ECS** outEcs) {
+    Arena_T arena = Arena_new();
+    ECS* ecs = ECS_new(arena);
+    ComponentTypeId healthType = ECS_register_component_type(ecs, "Health", sizeof(Health));
+    ComponentTypeId itemType = ECS_register_component_type(ecs, "Item", sizeof(Item));
+    
+    // Health.hp = i % 100 everywhere; Item.type = i % 37 on every other entity
+    for (int i = 0; i < AGGREGATE_ENTITY_COUNT; i++) {
+        EntityId entity = Entity_create(ECS_get_entity_registry(ecs));
+        Health health = {i % 100, 100};
+        ECS_add_component(ecs, entity, healthType, &health);
+        if (i % 2 == 0) {
+            Item item = {(uint32_t)(i % 37), 1.0f};
+            ECS_add_component(ecs, entity, itemType, &item);
+        }
+    }
+    
+    QueryCatalog* catalog = QueryCatalog_new(ecs);
+    QueryCatalog_register_field(catalog, "Health", "hp", offsetof(Health, hp), QUERY_FIELD_I32);
+    QueryCatalog_register_field(catalog, "Item", "type", offsetof(Item, type), QUERY_FIELD_U32);
+    QueryCatalog_register_field(catalog, "Item", "weight", offsetof(Item, weight), QUERY_FIELD_F32);
+    *outEcs = ecs;
+    return catalog;
+}
+
+static void test_sketch_queries(void) {
+    printf("  Testing APPROX_COUNT_DISTINCT / APPROX_PERCENTILE queries...\n");
+    
+    const char* invalid[] = {
+        "SELECT APPROX_COUNT_DISTINCT(Item)",
+        "SELECT APPROX_COUNT_DISTINCT(Item.type, 0.5)",
+        "SELECT APPROX_PERCENTILE(Health.hp)",
+        "SELECT APPROX_PERCENTILE(Health.hp, 1.5)",
+        "SELECT APPROX_PERCENTILE(Health.hp, ?)",
+        "SELECT APPROX_PERCENTILE(Health.hp, 0.1, 0.2, 0.3, 0.4, 0.5, 0.6, 0.7, 0.8, 0.9)",
+        "SELECT APPROX_PERCENTILE(Health.hp, 0.5) LIMIT 3",
+    };
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+        QueryParser* parser = QueryParser_new(invalid[i]);
+        QueryAST* ast = QueryParser_parse(parser);
+        TEST_ASSERT_NULL(ast, "Malformed aggregate should be rejected");
+        QueryParser_destroy(parser);
+    }
+    
+    ECS* ecs;
+    QueryCatalog* catalog = create_aggregate_world(&ecs);
+    QueryEngineResult result;
+    
+    TEST_ASSERT_EQ(QueryCatalog_execute(catalog, "SELECT APPROX_COUNT_DISTINCT(Item.type)", &result), QUERY_SUCCESS,
+                   "Distinct count should succeed");
+    const QueryAggregateResult* aggregate = (const QueryAggregateResult*)result.data;
+    TEST_ASSERT_NOT_NULL(aggregate, "Distinct count should return an aggregate");
+    TEST_ASSERT_EQ(result.count, 37, "Item types should estimate 37");
+    TEST_ASSERT_EQ(aggregate->rows, AGGREGATE_ENTITY_COUNT / 2, "Every item should be read once");
+    QueryEngineResult_free(&result);
+    
+    TEST_ASSERT_EQ(QueryCatalog_execute(catalog, "SELECT APPROX_COUNT_DISTINCT(Health.hp) WHERE Health.hp < 30",
+                                        &result),
+                   QUERY_SUCCESS, "Filtered distinct count should succeed");
+    TEST_ASSERT_EQ(result.count, 30, "hp below 30 should estimate 30 values");
+    QueryEngineResult_free(&result);
+    
+    TEST_ASSERT_EQ(QueryCatalog_execute(catalog, "SELECT APPROX_PERCENTILE(Health.hp, 0.5, 0.95, 0.99) WHERE has(Item)",
+                                        &result),
+                   QUERY_SUCCESS, "Percentiles should succeed");
+    aggregate = (const QueryAggregateResult*)result.data;
+    TEST_ASSERT_EQ(result.count, 3, "One value per percentile");
+    TEST_ASSERT_EQ(aggregate->rows, AGGREGATE_ENTITY_COUNT / 2, "Only item holders should be read");
+    // Item holders have even hp 0..98
+    TEST_ASSERT_TRUE(fabs(aggregate->values[0] - 49.0) <= 3.0, "p50 should be near 49");
+    TEST_ASSERT_TRUE(fabs(aggregate->values[1] - 94.0) <= 3.0, "p95 should be near 94");
+    TEST_ASSERT_TRUE(aggregate->values[2] >= 94.0 && aggregate->values[2] <= 98.0, "p99 should be near the top");
+    QueryEngineResult_free(&result);
+    
+    TEST_ASSERT_EQ(QueryCatalog_execute(catalog, "SELECT APPROX_PERCENTILE(Item.weight, 0.5) WHERE Health.hp > 500",
+                                        &result),
+                   QUERY_SUCCESS, "Empty percentile should succeed");
+    aggregate = (const QueryAggregateResult*)result.data;
+    TEST_ASSERT_EQ(aggregate->rows, 0, "Nothing should be read");
+    TEST_ASSERT_TRUE(isnan(aggregate->values[0]), "Empty input has no percentile");
+    QueryEngineResult_free(&result);
+    
+    // Fields need a schema
+    TEST_ASSERT_NE(QueryCatalog_execute(catalog, "SELECT APPROX_COUNT_DISTINCT(Item.colour)", &result), QUERY_SUCCESS,
+                   "Unknown field should fail");
+    TEST_ASSERT_NE(Query_execute(ecs, "SELECT APPROX_COUNT_DISTINCT(Item.type)", &result), QUERY_SUCCESS,
+                   "Aggregates without a catalog should fail");
+    
+    // Prepared, with the filter bound per execution
+    QueryPlan* plan = QueryPlan_prepare_with_catalog(ecs, catalog,
+                                                     "SELECT APPROX_COUNT_DISTINCT(Health.hp) WHERE Health.hp < ?");
+    TEST_ASSERT_NOT_NULL(plan, "Aggregate plan should prepare");
+    TEST_ASSERT_EQ(QueryPlan_bind_f64(plan, 1, 10.0), QUERY_SUCCESS, "Bind should succeed");
+    TEST_ASSERT_EQ(QueryPlan_execute(plan, &result), QUERY_SUCCESS, "Aggregate plan should execute");
+    TEST_ASSERT_EQ(result.count, 10, "Bound filter should leave 10 values");
+    QueryEngineResult_free(&result);
+    QueryPlan_destroy(plan);
+    
+    QueryCatalog_destroy(catalog);
+}
+
+bool test_sketch(void) {
+    printf("Running sketch tests...\n");
+    
+    TRY
+        test_sketch_hyperloglog();
+        test_sketch_quantiles();
+        test_sketch_queries();
+        
+        printf("  ✓ All sketch tests passed\n");
+        return true;
+    EXCEPT(Test_Failed)
+        printf("  ✗ Sketch test failed\n");
+        return false;
+    END_TRY;
+}
@@ -0,0 +1,360 @@
+#include "test_common.h"
+#include "gramarye_query/snapshot.h"
+#include "gramarye_query/catalog.h"
+#include "gramarye_query/query.h"
+#include "gramarye_query/allocator.h"
+#include "gramarye_ecs/ecs.h"
+#include "arena.h"
+#include "except.h"
+#include <pthread.h>
+#include <string.h>
+#include <stdio.h>
+#include <stddef.h>
+
+typedef struct {
+    float x;
+    float y;
+} Position;
+
+typedef struct {
+    int hp;
+    int maxHp;
+} Health;
+
+typedef struct {
+    int frame;
+} Tag;
+
+typedef struct {
+    ECS* ecs;
+    QueryCatalog* catalog;
+    ComponentTypeId positionType;
+    ComponentTypeId healthType;
+    ComponentTypeId tagType;
+} SnapshotWorld;
+
+static void create_snapshot_world(SnapshotWorld* world) {
+    Arena_T arena = Arena_new();
+    world->ecs = ECS_new(arena);
+    world->positionType = ECS_register_component_type(world->ecs, "Position", sizeof(Position));
+    world->healthType = ECS_register_component_type(world->ecs, "Health", sizeof(Health));
+    world->tagType = ECS_register_component_type(world->ecs, "Tag", sizeof(Tag));
+    world->catalog = QueryCatalog_new(world->ecs);
+    QueryCatalog_register_field(world->catalog, "Position", "x", offsetof(Position, x), QUERY_FIELD_F32);
+    QueryCatalog_register_field(world->catalog, "Health", "hp", offsetof(Health, hp), QUERY_FIELD_I32);
+}
+
+// Every spawned entity has Position and Health (and an untracked Tag)
+static EntityId spawn(SnapshotWorld* world, int i) {
+    EntityId entity = Entity_create(ECS_get_entity_registry(world->ecs));
+    Position pos = {(float)i, 0.0f};
+    Health health = {i % 100, 100};
+    Tag tag = {i};
+    ECS_add_component(world->ecs, entity, world->positionType, &pos);
+    ECS_add_component(world->ecs, entity, world->healthType, &health);
+    ECS_add_component(world->ecs, entity, world->tagType, &tag);
+    return entity;
+}
+
+static size_t snapshot_count(QuerySnapshot* snapshot, const char* query) {
+    QueryEngineResult result;
+    TEST_ASSERT_EQ(QuerySnapshot_execute(snapshot, query, &result), QUERY_SUCCESS, "Snapshot query should succeed");
+    size_t count = result.count;
+    QueryEngineResult_free(&result);
+    return count;
+}
+
+static void test_snapshot_queries(void) {
+    printf("  Testing queries against a snapshot...\n");
+    
+    SnapshotWorld world;
+    create_snapshot_world(&world);
+    EntityId first = spawn(&world, 0);
+    for (int i = 1; i < 100; i++) {
+        spawn(&world, i);
+    }
+    
+    QuerySnapshotStore* store = QuerySnapshotStore_new(world.ecs, world.catalog);
+    TEST_ASSERT_NOT_NULL(store, "Store should be created");
+    TEST_ASSERT_EQ(QuerySnapshotStore_track(store, "Position"), QUERY_SUCCESS, "Track Position");
+    TEST_ASSERT_EQ(QuerySnapshotStore_track(store, "Health"), QUERY_SUCCESS, "Track Health");
+    TEST_ASSERT_NE(QuerySnapshotStore_track(store, "Missing"), QUERY_SUCCESS, "Unknown component should fail");
+    
+    int reader = QuerySnapshotStore_attach_reader(store);
+    TEST_ASSERT_TRUE(reader >= 0, "Reader should attach");
+    TEST_ASSERT_NULL(QuerySnapshotStore_pin(store, reader), "Nothing is published yet");
+    QuerySnapshotStore_unpin(store, reader);
+    
+    TEST_ASSERT_EQ(QuerySnapshotStore_publish(store), QUERY_SUCCESS, "Publish should succeed");
+    QuerySnapshot* snapshot = QuerySnapshotStore_pin(store, reader);
+    TEST_ASSERT_NOT_NULL(snapshot, "Published snapshot should be pinned");
+    TEST_ASSERT_EQ(QuerySnapshotStore_get_stats(store).entityCount, 100, "Snapshot should hold 100 entities");
+    
+    TEST_ASSERT_EQ(snapshot_count(snapshot, "COUNT entities WHERE has(Position, Health)"), 100, "Both components");
+    TEST_ASSERT_EQ(snapshot_count(snapshot, "SELECT entities WHERE has(Tag)"), 0, "Untracked types are absent");
+    TEST_ASSERT_EQ(snapshot_count(snapshot, "SELECT entities WHERE Position.x < 10 AND Health.hp >= 5"), 5,
+                   "Filters should use the live schema");
+    
+    // Results carry live ids
+    QueryEngineResult result;
+    TEST_ASSERT_EQ(QuerySnapshot_execute(snapshot, "SELECT entities WHERE Position.x < 1", &result), QUERY_SUCCESS,
+                   "Select should succeed");
+    TEST_ASSERT_EQ(result.count, 1, "One entity at x 0");
+    EntityId* entities = (EntityId*)result.entities;
+    TEST_ASSERT_TRUE(entities[0].high == first.high && entities[0].low == first.low, "Result should be the live id");
+    QueryEngineResult_free(&result);
+    
+    // Later writes stay out of the pinned snapshot
+    Position* live = (Position*)ECS_get_component(world.ecs, first, world.positionType);
+    live->x = 5000.0f;
+    for (int i = 100; i < 150; i++) {
+        spawn(&world, i);
+    }
+    TEST_ASSERT_EQ(snapshot_count(snapshot, "COUNT entities WHERE has(Position)"), 100, "Snapshot should not change");
+    
+    char query[128];
+    snprintf(query, sizeof(query), "SHOW Position OF entity %llu:%llu",
+             (unsigned long long)first.high, (unsigned long long)first.low);
+    TEST_ASSERT_EQ(QuerySnapshot_execute(snapshot, query, &result), QUERY_SUCCESS, "SHOW by live id should succeed");
+    TEST_ASSERT_TRUE(((Position*)result.data)->x == 0.0f, "SHOW should see the captured value");
+    QueryEngineResult_free(&result);
+    
+    TEST_ASSERT_NE(QuerySnapshot_execute(snapshot, "CREATE INDEX ON Position.x", &result), QUERY_SUCCESS,
+                   "Snapshots are read-only");
+    QuerySnapshotStore_unpin(store, reader);
+    
+    TEST_ASSERT_EQ(QuerySnapshotStore_publish(store), QUERY_SUCCESS, "Publish should succeed");
+    snapshot = QuerySnapshotStore_pin(store, reader);
+    TEST_ASSERT_EQ(QuerySnapshot_epoch(snapshot), 2, "Second publish is epoch 2");
+    TEST_ASSERT_EQ(snapshot_count(snapshot, "COUNT entities WHERE has(Position)"), 150, "New epoch sees new entities");
+    TEST_ASSERT_EQ(snapshot_count(snapshot, "COUNT entities WHERE Position.x >= 5000"), 1, "New epoch sees writes");
+    QuerySnapshotStore_unpin(store, reader);
+    
+    QuerySnapshotStore_detach_reader(store, reader);
+    QuerySnapshotStore_destroy(store);
+    QueryCatalog_destroy(world.catalog);
+}
+
+static void test_snapshot_reclaim(void) {
+    printf("  Testing epoch-based reclamation...\n");
+    
+    SnapshotWorld world;
+    create_snapshot_world(&world);
+    for (int i = 0; i < 10; i++) {
+        spawn(&world, i);
+    }
+    
+    QuerySnapshotStore* store = QuerySnapshotStore_new(world.ecs, world.catalog);
+    QuerySnapshotStore_track(store, "Position");
+    int slow = QuerySnapshotStore_attach_reader(store);
+    int fast = QuerySnapshotStore_attach_reader(store);
+    TEST_ASSERT_TRUE(slow >= 0 && fast >= 0 && slow != fast, "Readers should get distinct slots");
+    
+    QuerySnapshotStore_publish(store);
+    QuerySnapshot* held = QuerySnapshotStore_pin(store, slow);
+    
+    // Replaced twice while pinned: the held epoch must survive
+    spawn(&world, 10);
+    QuerySnapshotStore_publish(store);
+    QuerySnapshotStore_publish(store);
+    QuerySnapshotStats stats = QuerySnapshotStore_get_stats(store);
+    TEST_ASSERT_EQ(stats.retired, 2, "Both replaced snapshots wait for the slow reader");
+    TEST_ASSERT_EQ(stats.reclaimed, 0, "Nothing can be reclaimed yet");
+    TEST_ASSERT_EQ(snapshot_count(held, "COUNT entities WHERE has(Position)"), 10, "Held snapshot stays valid");
+    
+    // A reader pinning now holds only the latest
+    QuerySnapshot* latest = QuerySnapshotStore_pin(store, fast);
+    TEST_ASSERT_EQ(snapshot_count(latest, "COUNT entities WHERE has(Position)"), 11, "Latest has the new entity");
+    
+    QuerySnapshotStore_unpin(store, slow);
+    QuerySnapshotStore_publish(store);
+    stats = QuerySnapshotStore_get_stats(store);
+    TEST_ASSERT_EQ(stats.reclaimed, 2, "Snapshots older than the fast reader should be reclaimed");
+    TEST_ASSERT_EQ(stats.retired, 1, "The fast reader's snapshot is still held");
+    QuerySnapshotStore_unpin(store, fast);
+    QuerySnapshotStore_publish(store);
+    TEST_ASSERT_EQ(QuerySnapshotStore_get_stats(store).retired, 0, "Idle readers hold nothing");
+    
+    QuerySnapshotStore_detach_reader(store, slow);
+    QuerySnapshotStore_detach_reader(store, fast);
+    QuerySnapshotStore_destroy(store);
+    QueryCatalog_destroy(world.catalog);
+}
+
+static void test_snapshot_double_buffer(void) {
+    printf("  Testing publishes into released snapshots...\n");
+    
+    SnapshotWorld world;
+    create_snapshot_world(&world);
+    EntityId first = spawn(&world, 0);
+    for (int i = 1; i < 50; i++) {
+        spawn(&world, i);
+    }
+    
+    QuerySnapshotStore* store = QuerySnapshotStore_new(world.ecs, world.catalog);
+    QuerySnapshotStore_track(store, "Position");
+    QuerySnapshotStore_track(store, "Health");
+    int reader = QuerySnapshotStore_attach_reader(store);
+    
+    // The first replaced snapshot is released by the second publish and filled by the third
+    QuerySnapshotStore_publish(store);
+    QuerySnapshot* older = QuerySnapshotStore_pin(store, reader);
+    QuerySnapshotStore_unpin(store, reader);
+    QuerySnapshotStore_publish(store);
+    TEST_ASSERT_EQ(QuerySnapshotStore_get_stats(store).reused, 0, "Nothing is released before the second publish");
+    
+    Position* live = (Position*)ECS_get_component(world.ecs, first, world.positionType);
+    live->x = 5000.0f;
+    spawn(&world, 50);
+    TEST_ASSERT_EQ(QuerySnapshotStore_publish(store), QUERY_SUCCESS, "Publish should succeed");
+    QuerySnapshot* snapshot = QuerySnapshotStore_pin(store, reader);
+    TEST_ASSERT_TRUE(snapshot == older, "Released snapshot should be refreshed in place");
+    TEST_ASSERT_EQ(QuerySnapshotStore_get_stats(store).reused, 1, "Refresh should be counted");
+    TEST_ASSERT_EQ(QuerySnapshot_epoch(snapshot), 3, "Refreshed snapshot carries the new epoch");
+    TEST_ASSERT_EQ(snapshot_count(snapshot, "COUNT entities WHERE has(Position, Health)"), 51,
+                   "Refresh should add new entities");
+    TEST_ASSERT_EQ(snapshot_count(snapshot, "COUNT entities WHERE Position.x >= 5000"), 1, "Refresh should copy writes");
+    
+    QueryEngineResult result;
+    TEST_ASSERT_EQ(QuerySnapshot_execute(snapshot, "SELECT entities WHERE Position.x >= 5000", &result), QUERY_SUCCESS,
+                   "Select should succeed");
+    EntityId* entities = (EntityId*)result.entities;
+    TEST_ASSERT_TRUE(entities[0].high == first.high && entities[0].low == first.low, "Ids should still translate");
+    QueryEngineResult_free(&result);
+    QuerySnapshotStore_unpin(store, reader);
+    
+    // Steady state: writes only, the two buffers alternate and nothing is allocated
+    QuerySnapshotStore_publish(store);
+    for (int frame = 0; frame < 4; frame++) {
+        live = (Position*)ECS_get_component(world.ecs, first, world.positionType);
+        live->x = (float)(6000 + frame);
+        QueryMemoryScope scope;
+        QueryMemory_enter(&scope, NULL);
+        QueryStatus status = QuerySnapshotStore_publish(store);
+        QueryMemory_leave(&scope);
+        TEST_ASSERT_EQ(status, QUERY_SUCCESS, "Publish should succeed");
+        TEST_ASSERT_EQ(scope.stats.allocations, 0, "Steady-state publish should not allocate");
+    }
+    snapshot = QuerySnapshotStore_pin(store, reader);
+    TEST_ASSERT_EQ(snapshot_count(snapshot, "COUNT entities WHERE Position.x = 6003"), 1, "Latest write is visible");
+    TEST_ASSERT_EQ(snapshot_count(snapshot, "COUNT entities WHERE Position.x >= 5000"), 1, "Older copies are replaced");
+    QuerySnapshotStore_unpin(store, reader);
+    
+    QuerySnapshotStats stats = QuerySnapshotStore_get_stats(store);
+    TEST_ASSERT_EQ(stats.reused, stats.published - 2, "Every publish after the second should reuse a buffer");
+    
+    QuerySnapshotStore_detach_reader(store, reader);
+    QuerySnapshotStore_destroy(store);
+    QueryCatalog_destroy(world.catalog);
+}
+
+#define SNAPSHOT_FRAMES 200
+#define SNAPSHOT_SPAWN_PER_FRAME 25
+
+typedef struct {
+    QuerySnapshotStore* store;
+    volatile int done;          // Set by the simulation thread; only a stop hint
+    int queries;
+    int failures;
+} ReaderState;
+
+// Debug thread: never touches the live ECS
+static void* reader_main(void* arg) {
+    ReaderState* state = (ReaderState*)arg;
+    int reader = QuerySnapshotStore_attach_reader(state->store);
+    if (reader < 0) {
+        state->failures++;
+        return NULL;
+    }
+    
+    uint64_t lastEpoch = 0;
+    while (!__atomic_load_n(&state->done, __ATOMIC_SEQ_CST)) {
+        QuerySnapshot* snapshot = QuerySnapshotStore_pin(state->store, reader);
+        if (snapshot) {
+            QueryEngineResult positions, healthy;
+            bool ok = QuerySnapshot_execute(snapshot, "COUNT entities WHERE has(Position)", &positions) == QUERY_SUCCESS &&
+                      QuerySnapshot_execute(snapshot, "SELECT entities WHERE Health.hp >= 0", &healthy) == QUERY_SUCCESS;
+            uint64_t epoch = QuerySnapshot_epoch(snapshot);
+            
+            // Entities spawn with both components, so a consistent epoch counts them equally
+            if (!ok || positions.count != healthy.count ||
+                positions.count != (size_t)epoch * SNAPSHOT_SPAWN_PER_FRAME || epoch < lastEpoch) {
+                state->failures++;
+            }
+            lastEpoch = epoch;
+            state->queries++;
+            if (ok) {
+                QueryEngineResult_free(&positions);
+                QueryEngineResult_free(&healthy);
+            }
+        }
+        QuerySnapshotStore_unpin(state->store, reader);
+    }
+    
+    QuerySnapshotStore_detach_reader(state->store, reader);
+    return NULL;
+}
+
+static void test_snapshot_concurrent_reader(void) {
+    printf("  Testing a reader thread against a running simulation...\n");
+    
+    SnapshotWorld world;
+    create_snapshot_world(&world);
+    QuerySnapshotStore* store = QuerySnapshotStore_new(world.ecs, world.catalog);
+    QuerySnapshotStore_track(store, "Position");
+    QuerySnapshotStore_track(store, "Health");
+    
+    ReaderState state = {store, 0, 0, 0};
+    pthread_t thread;
+    TEST_ASSERT_EQ(pthread_create(&thread, NULL, reader_main, &state), 0, "Reader thread should start");
+    
+    // Simulation: mutate live storage, publish at the end of each frame
+    int spawned = 0;
+    for (int frame = 0; frame < SNAPSHOT_FRAMES; frame++) {
+        for (int i = 0; i < SNAPSHOT_SPAWN_PER_FRAME; i++) {
+            spawn(&world, spawned++);
+        }
+        struct QueryResult all = ECS_query_entities(world.ecs, &world.positionType, 1);
+        for (size_t i = 0; i < all.count; i++) {
+            Position* pos = (Position*)ECS_get_component(world.ecs, all.entities[i], world.positionType);
+            pos->y += 1.0f;
+        }
+        QueryResult_free(&all);
+        TEST_ASSERT_EQ(QuerySnapshotStore_publish(store), QUERY_SUCCESS, "Publish should succeed");
+    }
+    
+    __atomic_store_n(&state.done, 1, __ATOMIC_SEQ_CST);
+    pthread_join(thread, NULL);
+    
+    TEST_ASSERT_EQ(state.failures, 0, "Every snapshot should be internally consistent");
+    TEST_ASSERT_TRUE(state.queries > 0, "Reader should have queried");
+    QuerySnapshotStats stats = QuerySnapshotStore_get_stats(store);
+    TEST_ASSERT_EQ(stats.published, SNAPSHOT_FRAMES, "One epoch per frame");
+    TEST_ASSERT_EQ(stats.reclaimed + stats.retired + 1, SNAPSHOT_FRAMES, "Every epoch is accounted for");
+    
+    // With the reader gone the next publish frees everything but the latest
+    TEST_ASSERT_EQ(QuerySnapshotStore_publish(store), QUERY_SUCCESS, "Publish should succeed");
+    stats = QuerySnapshotStore_get_stats(store);
+    TEST_ASSERT_EQ(stats.retired, 0, "Old epochs should be reclaimed");
+    TEST_ASSERT_EQ(stats.reclaimed, SNAPSHOT_FRAMES, "Every replaced epoch should be freed");
+    
+    QuerySnapshotStore_destroy(store);
+    QueryCatalog_destroy(world.catalog);
+}
+
+bool test_snapshot(void) {
+    printf("Running snapshot tests...\n");
+    
+    TRY
+        test_snapshot_queries();
+        test_snapshot_reclaim();
+        test_snapshot_double_buffer();
+        test_snapshot_concurrent_reader();
+        
+        printf("  ✓ All snapshot tests passed\n");
+        return true;
+    EXCEPT(Test_Failed)
+        printf("  ✗ Snapshot test failed\n");
+        return false;
+    END_TRY;
+}
@@ -1,10 +1,15 @@
 #include "test_common.h"
 #include "gramarye_query/query.h"
+#include "gramarye_query/catalog.h"
+#include "gramarye_query/frame.h"
+#include "gramarye_query/plan.h"
 #include "gramarye_ecs/ecs.h"
 #include "arena.h"
 #include "mem.h"
 #include "except.h"
 #include <string.h>
+#include <stddef.h>
+#include <pthread.h>
 
 // Test component structure
 typedef struct {
@@ -12,6 +17,11 @@ typedef struct {
     int y;
 } Position;
 
+typedef struct {
+    int hp;
+    int maxHp;
+} Health;
+
 static void test_stress_large_ecs(void) {
     printf("  Testing with 1000+ entities...\n");
     
@@ -162,6 +172,569 @@ static void test_stress_memory_cleanup(void) {
     }
 }
 
+static void test_stress_batch_fused_vs_sequential(void) {
+    printf("  Testing fused batch against sequential on 32 queries...\n");
+    
+    Arena_T arena = Arena_new();
+    ECS* ecs = ECS_new(arena);
+    
+    const int TYPE_COUNT = 8;
+    const int ENTITY_COUNT = 2000;
+    const char* typeNames[] = {"Position", "Velocity", "Health", "Sprite", "Damage", "Team", "AI", "Dead"};
+    ComponentTypeId types[8];
+    for (int t = 0; t < TYPE_COUNT; t++) {
+        types[t] = ECS_register_component_type(ecs, typeNames[t], sizeof(int) * 2);
+    }
+    
+    // Position on everything, other components on a deterministic subset
+    for (int i = 0; i < ENTITY_COUNT; i++) {
+        EntityId entity = Entity_create(ECS_get_entity_registry(ecs));
+        int data[2] = {i, i};
+        ECS_add_component(ecs, entity, types[0], data);
+        for (int t = 1; t < TYPE_COUNT; t++) {
+            if ((i % (t + 1)) == 0) {
+                ECS_add_component(ecs, entity, types[t], data);
+            }
+        }
+    }
+    
+    // 32 queries, mostly sharing Position as driving component
+    const size_t QUERY_COUNT = 32;
+    char queryText[32][128];
+    const char* queries[32];
+    for (size_t q = 0; q < QUERY_COUNT; q++) {
+        int a = 1 + (int)(q % 7);
+        int b = 1 + (int)((q / 7) % 7);
+        if (q % 4 == 3) {
+            snprintf(queryText[q], sizeof(queryText[q]), "COUNT entities WHERE has(Position, %s)", typeNames[a]);
+        } else if (q % 8 == 5) {
+            snprintf(queryText[q], sizeof(queryText[q]), "SELECT entities WHERE not_has(%s)", typeNames[a]);
+        } else {
+            snprintf(queryText[q], sizeof(queryText[q]), "SELECT entities WHERE has(Position, %s, %s)",
+                     typeNames[a], typeNames[b]);
+        }
+        queries[q] = queryText[q];
+    }
+    
+    QueryEngineResult sequential[32];
+    QueryEngineResult fused[32];
+    
+    for (size_t q = 0; q < QUERY_COUNT; q++) {
+        QueryStatus status = Query_execute(ecs, queries[q], &sequential[q]);
+        TEST_ASSERT_EQ(status, QUERY_SUCCESS, "Sequential query should succeed");
+    }
+    QueryStatus status = Query_execute_batch(ecs, queries, QUERY_COUNT, fused);
+    TEST_ASSERT_EQ(status, QUERY_SUCCESS, "Batch should succeed");
+    
+    for (size_t q = 0; q < QUERY_COUNT; q++) {
+        TEST_ASSERT_EQ(fused[q].count, sequential[q].count, "Fused count should match sequential");
+        QueryEngineResult_free(&sequential[q]);
+        QueryEngineResult_free(&fused[q]);
+    }
+}
+
+static void test_stress_batch_residual_overflow(void) {
+    printf("  Testing fused batch with more residual types than one pass holds...\n");
+    
+    Arena_T arena = Arena_new();
+    ECS* ecs = ECS_new(arena);
+    
+    // 70 queries share Base as driving component, each with its own residual type
+    const size_t QUERY_COUNT = 70;
+    ComponentTypeId baseType = ECS_register_component_type(ecs, "Base", sizeof(int));
+    ComponentTypeId tagTypes[70];
+    char tagNames[70][16];
+    for (size_t t = 0; t < QUERY_COUNT; t++) {
+        snprintf(tagNames[t], sizeof(tagNames[t]), "Tag%zu", t);
+        tagTypes[t] = ECS_register_component_type(ecs, tagNames[t], sizeof(int));
+    }
+    
+    for (int i = 0; i < 300; i++) {
+        EntityId entity = Entity_create(ECS_get_entity_registry(ecs));
+        ECS_add_component(ecs, entity, baseType, &i);
+        for (size_t t = 0; t < QUERY_COUNT; t++) {
+            if ((size_t)i % (t % 5 + 2) == 0) {
+                ECS_add_component(ecs, entity, tagTypes[t], &i);
+            }
+        }
+    }
+    
+    char queryText[70][64];
+    const char* queries[70];
+    for (size_t q = 0; q < QUERY_COUNT; q++) {
+        snprintf(queryText[q], sizeof(queryText[q]), "%s entities WHERE has(Base, %s)",
+                 q % 2 ? "COUNT" : "SELECT", tagNames[q]);
+        queries[q] = queryText[q];
+    }
+    
+    QueryEngineResult fused[70];
+    QueryStatus status = Query_execute_batch(ecs, queries, QUERY_COUNT, fused);
+    TEST_ASSERT_EQ(status, QUERY_SUCCESS, "Batch should succeed");
+    
+    for (size_t q = 0; q < QUERY_COUNT; q++) {
+        QueryEngineResult sequential;
+        status = Query_execute(ecs, queries[q], &sequential);
+        TEST_ASSERT_EQ(status, QUERY_SUCCESS, "Sequential query should succeed");
+        TEST_ASSERT_EQ(fused[q].count, sequential.count, "Every pass should evaluate only its own queries");
+        EntityId* rows = (EntityId*)fused[q].entities;
+        for (size_t e = 0; q % 2 == 0 && e < fused[q].count; e++) {
+            TEST_ASSERT_NOT_NULL(ECS_get_component(ecs, rows[e], tagTypes[q]), "Fused rows should carry the residual type");
+        }
+        QueryEngineResult_free(&sequential);
+        QueryEngineResult_free(&fused[q]);
+    }
+}
+
+static void test_stress_field_index(void) {
+    printf("  Testing sorted field index...\n");
+    
+    Arena_T arena = Arena_new();
+    ECS* ecs = ECS_new(arena);
+    
+    const int ENTITY_COUNT = 10000;
+    ComponentTypeId positionType = ECS_register_component_type(ecs, "Position", sizeof(float) * 2);
+    for (int i = 0; i < ENTITY_COUNT; i++) {
+        EntityId entity = Entity_create(ECS_get_entity_registry(ecs));
+        float pos[2] = {(float)((i * 7919) % ENTITY_COUNT), (float)i};
+        ECS_add_component(ecs, entity, positionType, pos);
+    }
+    
+    QueryCatalog* catalog = QueryCatalog_new(ecs);
+    QueryCatalog_register_field(catalog, "Position", "x", 0, QUERY_FIELD_F32);
+    
+    const char* query = "COUNT entities WHERE Position.x BETWEEN 100 AND 199";
+    QueryEngineResult scanned;
+    QueryEngineResult indexed;
+    
+    TEST_ASSERT_EQ(QueryCatalog_execute(catalog, query, &scanned), QUERY_SUCCESS, "Scan should succeed");
+    TEST_ASSERT_EQ(QueryCatalog_create_index(catalog, "Position", "x"), QUERY_SUCCESS, "Index should build");
+    TEST_ASSERT_EQ(QueryCatalog_execute(catalog, query, &indexed), QUERY_SUCCESS, "Indexed query should succeed");
+    TEST_ASSERT_EQ(scanned.count, 100, "Range should hold 100 entities");
+    TEST_ASSERT_EQ(indexed.count, scanned.count, "Indexed count should match scan");
+    
+    QueryIndexStats stats;
+    QueryCatalog_get_index_stats(catalog, "Position", "x", &stats);
+    TEST_ASSERT_EQ(stats.scans, 1, "Range should be served by the index");
+    TEST_ASSERT_EQ(stats.entryCount, ENTITY_COUNT, "Index should hold every entity");
+    
+    QueryEngineResult_free(&scanned);
+    QueryEngineResult_free(&indexed);
+    QueryCatalog_destroy(catalog);
+}
+
+static void test_stress_hash_index(void) {
+    printf("  Testing hash index...\n");
+    
+    Arena_T arena = Arena_new();
+    ECS* ecs = ECS_new(arena);
+    
+    // 1000 teams of 10 entities each
+    const int ENTITY_COUNT = 10000;
+    ComponentTypeId teamType = ECS_register_component_type(ecs, "Team", sizeof(int32_t));
+    for (int i = 0; i < ENTITY_COUNT; i++) {
+        EntityId entity = Entity_create(ECS_get_entity_registry(ecs));
+        int32_t team = i % 1000;
+        ECS_add_component(ecs, entity, teamType, &team);
+    }
+    
+    QueryCatalog* catalog = QueryCatalog_new(ecs);
+    QueryCatalog_register_field(catalog, "Team", "id", 0, QUERY_FIELD_I32);
+    
+    const char* query = "COUNT entities WHERE Team.id IN (7, 500)";
+    QueryEngineResult scanned;
+    QueryEngineResult hashed;
+    
+    TEST_ASSERT_EQ(QueryCatalog_execute(catalog, query, &scanned), QUERY_SUCCESS, "Scan should succeed");
+    TEST_ASSERT_EQ(QueryCatalog_create_hash_index(catalog, "Team", "id"), QUERY_SUCCESS, "Hash index should build");
+    TEST_ASSERT_EQ(QueryCatalog_execute(catalog, query, &hashed), QUERY_SUCCESS, "Hashed query should succeed");
+    TEST_ASSERT_EQ(scanned.count, 20, "Two teams should hold 20 entities");
+    TEST_ASSERT_EQ(hashed.count, scanned.count, "Hashed count should match scan");
+    
+    QueryIndexStats stats;
+    QueryCatalog_get_hash_index_stats(catalog, "Team", "id", &stats);
+    TEST_ASSERT_EQ(stats.scans, 1, "IN should be served by the hash index");
+    
+    QueryEngineResult_free(&scanned);
+    QueryEngineResult_free(&hashed);
+    QueryCatalog_destroy(catalog);
+}
+
+static void test_stress_spatial_index(void) {
+    printf("  Testing spatial grid...\n");
+    
+    Arena_T arena = Arena_new();
+    ECS* ecs = ECS_new(arena);
+    
+    // One entity per unit square of a 200 x 200 world
+    const int SIDE = 200;
+    ComponentTypeId positionType = ECS_register_component_type(ecs, "Position", sizeof(float) * 2);
+    for (int i = 0; i < SIDE * SIDE; i++) {
+        EntityId entity = Entity_create(ECS_get_entity_registry(ecs));
+        float pos[2] = {(float)(i % SIDE) + 0.5f, (float)(i / SIDE) + 0.5f};
+        ECS_add_component(ecs, entity, positionType, pos);
+    }
+    
+    QueryCatalog* catalog = QueryCatalog_new(ecs);
+    QueryCatalog_register_field(catalog, "Position", "x", 0, QUERY_FIELD_F32);
+    QueryCatalog_register_field(catalog, "Position", "y", sizeof(float), QUERY_FIELD_F32);
+    TEST_ASSERT_EQ(QueryCatalog_create_spatial_index(catalog, "Position", "x", "y", 16.0), QUERY_SUCCESS,
+                   "Spatial index should build");
+    
+    // Points at (i + 0.5, j + 0.5) within 10 of (100, 100)
+    size_t expected = 0;
+    for (int j = 80; j < 120; j++) {
+        for (int i = 80; i < 120; i++) {
+            double dx = i + 0.5 - 100.0;
+            double dy = j + 0.5 - 100.0;
+            if (dx * dx + dy * dy <= 100.0) expected++;
+        }
+    }
+    
+    QueryEngineResult result;
+    TEST_ASSERT_EQ(QueryCatalog_execute(catalog, "COUNT entities WHERE WITHIN(Position, 100, 100, 10)", &result),
+                   QUERY_SUCCESS, "WITHIN should succeed");
+    TEST_ASSERT_EQ(result.count, expected, "WITHIN should match the exact count");
+    QueryEngineResult_free(&result);
+    
+    TEST_ASSERT_EQ(QueryCatalog_execute(catalog, "COUNT entities WHERE INSIDE(Position, 100, 100, 199, 149)", &result),
+                   QUERY_SUCCESS, "INSIDE should succeed");
+    TEST_ASSERT_EQ(result.count, 99 * 49, "INSIDE should match the exact count");
+    QueryEngineResult_free(&result);
+    
+    QueryIndexStats stats;
+    QueryCatalog_get_spatial_stats(catalog, "Position", &stats);
+    TEST_ASSERT_EQ(stats.entryCount, SIDE * SIDE, "Grid should hold every entity");
+    
+    QueryCatalog_destroy(catalog);
+}
+
+static void test_stress_condition_scan(void) {
+    printf("  Testing condition scans...\n");
+    
+    Arena_T arena = Arena_new();
+    ECS* ecs = ECS_new(arena);
+    
+    // Every entity has Position, every other one Health
+    const int ENTITY_COUNT = 10000;
+    ComponentTypeId positionType = ECS_register_component_type(ecs, "Position", sizeof(float) * 2);
+    ComponentTypeId healthType = ECS_register_component_type(ecs, "Health", sizeof(int32_t));
+    for (int i = 0; i < ENTITY_COUNT; i++) {
+        EntityId entity = Entity_create(ECS_get_entity_registry(ecs));
+        float pos[2] = {(float)(((int64_t)i * 7919) % ENTITY_COUNT), (float)i};
+        ECS_add_component(ecs, entity, positionType, pos);
+        if (i % 2 == 0) {
+            int32_t hp = 100;
+            ECS_add_component(ecs, entity, healthType, &hp);
+        }
+    }
+    
+    QueryCatalog* catalog = QueryCatalog_new(ecs);
+    QueryCatalog_register_field(catalog, "Position", "x", 0, QUERY_FIELD_F32);
+    
+    struct {
+        const char* query;
+        size_t expected;
+    } cases[] = {
+        { "COUNT entities WHERE has(Position) AND Position.x >= 0", 10000 },
+        { "SELECT entities WHERE has(Position) AND Position.x < 1000", 1000 },
+        { "SELECT entities WHERE has(Health) AND Position.x >= 0", 5000 },
+        { "COUNT entities WHERE has(Health) OR Position.x < 5000", 7500 }
+    };
+    
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        QueryEngineResult result;
+        TEST_ASSERT_EQ(QueryCatalog_execute(catalog, cases[i].query, &result), QUERY_SUCCESS, "Scan should succeed");
+        TEST_ASSERT_EQ(result.count, cases[i].expected, "Scan count should match");
+        QueryEngineResult_free(&result);
+    }
+    
+    QueryCatalog_destroy(catalog);
+}
+
+static void test_stress_frame_sets(void) {
+    printf("  Testing frame sets...\n");
+    
+    Arena_T arena = Arena_new();
+    ECS* ecs = ECS_new(arena);
+    
+    // Every entity has Position, one in a thousand is Dead
+    const int ENTITY_COUNT = 20000;
+    ComponentTypeId positionType = ECS_register_component_type(ecs, "Position", sizeof(Position));
+    ComponentTypeId deadType = ECS_register_component_type(ecs, "Dead", sizeof(int32_t));
+    for (int i = 0; i < ENTITY_COUNT; i++) {
+        EntityId entity = Entity_create(ECS_get_entity_registry(ecs));
+        Position pos = {i, i};
+        ECS_add_component(ecs, entity, positionType, &pos);
+        if (i % 1000 == 0) {
+            int32_t tick = i;
+            ECS_add_component(ecs, entity, deadType, &tick);
+        }
+    }
+    
+    QueryFrame* frame = QueryFrame_begin(ecs);
+    struct {
+        const char* query;
+        size_t expected;
+    } cases[] = {
+        { "COUNT entities WHERE not_has(Dead)", 19980 },
+        { "COUNT entities WHERE has(Position)", 20000 },
+        { "COUNT entities WHERE has(Position, Dead)", 20 }
+    };
+    
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        QueryEngineResult result;
+        TEST_ASSERT_EQ(QueryFrame_execute(frame, cases[i].query, &result), QUERY_SUCCESS, "Frame query should succeed");
+        TEST_ASSERT_EQ(result.count, cases[i].expected, "Frame count should match");
+    }
+    
+    RoaringBitmap* alive;
+    TEST_ASSERT_EQ(QueryFrame_execute_bitmap(frame, "SELECT entities WHERE not_has(Dead)", &alive), QUERY_SUCCESS,
+                   "Bitmap form should succeed");
+    TEST_ASSERT_EQ(RoaringBitmap_cardinality(alive), 19980, "19980 entities should be alive");
+    
+    // A flat bitset would take ENTITY_COUNT / 8 bytes per set
+    TEST_ASSERT_TRUE(RoaringBitmap_memory_bytes(alive) < ENTITY_COUNT / 8, "not_has(Dead) should compress to runs");
+    
+    RoaringBitmap_destroy(alive);
+    QueryFrame_end(frame);
+}
+
+static void test_stress_result_set_operations(void) {
+    printf("  Testing set operations on shuffled results...\n");
+    
+    // Two 10000-id sets overlapping by half, shuffled by a multiplicative step
+    const size_t COUNT = 10000;
+    const uint64_t STEP = 2654435761u;
+    QueryEngineResult a;
+    QueryEngineResult b;
+    QueryEngineResult small;
+    memset(&a, 0, sizeof(a));
+    memset(&b, 0, sizeof(b));
+    memset(&small, 0, sizeof(small));
+    a.entities = ALLOC(sizeof(EntityId) * COUNT);
+    b.entities = ALLOC(sizeof(EntityId) * COUNT);
+    small.entities = ALLOC(sizeof(EntityId) * 100);
+    a.count = a.capacity = COUNT;
+    b.count = b.capacity = COUNT;
+    small.count = small.capacity = 100;
+    
+    EntityId* aIds = (EntityId*)a.entities;
+    EntityId* bIds = (EntityId*)b.entities;
+    EntityId* smallIds = (EntityId*)small.entities;
+    for (size_t i = 0; i < COUNT; i++) {
+        uint64_t k = (i * STEP) % COUNT;
+        aIds[i] = (EntityId){k * 7919, k};
+        bIds[i] = (EntityId){(k + COUNT / 2) * 7919, k + COUNT / 2};
+    }
+    for (size_t i = 0; i < 100; i++) {
+        smallIds[i] = aIds[i * 97];
+    }
+    
+    QueryEngineResult sortedA;
+    QueryEngineResult sortedB;
+    TEST_ASSERT_EQ(QueryEngineResult_union(&a, &a, true, &sortedA), QUERY_SUCCESS, "Sorting a should succeed");
+    TEST_ASSERT_EQ(QueryEngineResult_union(&b, &b, true, &sortedB), QUERY_SUCCESS, "Sorting b should succeed");
+    
+    QueryEngineResult both;
+    QueryEngineResult either;
+    QueryEngineResult onlyA;
+    QueryEngineResult hits;
+    TEST_ASSERT_EQ(QueryEngineResult_intersect(&sortedA, &sortedB, false, &both), QUERY_SUCCESS, "Intersect should succeed");
+    TEST_ASSERT_EQ(QueryEngineResult_union(&sortedA, &sortedB, false, &either), QUERY_SUCCESS, "Union should succeed");
+    TEST_ASSERT_EQ(QueryEngineResult_difference(&sortedA, &sortedB, false, &onlyA), QUERY_SUCCESS, "Difference should succeed");
+    
+    QueryEngineResult sortedSmall;
+    TEST_ASSERT_EQ(QueryEngineResult_union(&small, &small, true, &sortedSmall), QUERY_SUCCESS, "Sorting small should succeed");
+    TEST_ASSERT_EQ(QueryEngineResult_intersect(&sortedSmall, &sortedA, false, &hits), QUERY_SUCCESS, "Skewed intersect should succeed");
+    
+    TEST_ASSERT_EQ(both.count, COUNT / 2, "Halves should overlap by half");
+    TEST_ASSERT_EQ(either.count, COUNT + COUNT / 2, "Union should hold one and a half sets");
+    TEST_ASSERT_EQ(onlyA.count, COUNT / 2, "Difference should hold half of a");
+    TEST_ASSERT_EQ(hits.count, 100, "Every sampled id should be found");
+    
+    QueryEngineResult_free(&a);
+    QueryEngineResult_free(&b);
+    QueryEngineResult_free(&small);
+    QueryEngineResult_free(&sortedSmall);
+    QueryEngineResult_free(&sortedA);
+    QueryEngineResult_free(&sortedB);
+    QueryEngineResult_free(&both);
+    QueryEngineResult_free(&either);
+    QueryEngineResult_free(&onlyA);
+    QueryEngineResult_free(&hits);
+}
+
+// Queries every worker runs each round; counts are checked against a
+// single-threaded run
+static const char* const CONCURRENT_QUERIES[] = {
+    "COUNT entities WHERE has(Position, Velocity)",
+    "SELECT entities WHERE has(Health) AND not_has(Velocity)",
+    "SELECT entities WHERE Health.hp < 50",
+    "COUNT entities WHERE Health.hp BETWEEN 10 AND 12",
+    "SELECT entities WHERE Team.id IN (3, 7) AND Position.x >= 50",
+    "COUNT entities WHERE WITHIN(Position, 100, 100, 20)",
+    "SELECT entities WHERE Health.hp = 0 OR Team.id = 5 LIMIT 300",
+    "SELECT APPROX_PERCENTILE(Health.hp, 0.5) WHERE has(Velocity)"
+};
+#define CONCURRENT_QUERY_COUNT (sizeof(CONCURRENT_QUERIES) / sizeof(CONCURRENT_QUERIES[0]))
+#define CONCURRENT_THREADS 8
+#define CONCURRENT_ROUNDS 20
+
+typedef struct {
+    ECS* ecs;
+    QueryCatalog* catalog;
+    EntityId* entities;
+    size_t entityCount;
+    size_t expected[CONCURRENT_QUERY_COUNT];
+    size_t expectedLow;         // Prepared "Health.hp < ?" with 25 bound
+    int worker;
+    size_t mismatches;          // Written by the worker only
+    const char* firstMismatch;
+} ConcurrentWorker;
+
+static size_t concurrent_count(ConcurrentWorker* worker, const char* query, bool* ok) {
+    QueryEngineResult result;
+    *ok = QueryCatalog_execute(worker->catalog, query, &result) == QUERY_SUCCESS;
+    size_t count = result.count;
+    QueryEngineResult_free(&result);
+    return count;
+}
+
+static void concurrent_mismatch(ConcurrentWorker* worker, const char* what) {
+    if (worker->mismatches++ == 0) {
+        worker->firstMismatch = what;
+    }
+}
+
+// Runs on its own thread; TEST_ASSERT would unwind the wrong stack, so
+// failures are only recorded here and checked after join
+static void* concurrent_worker(void* arg) {
+    ConcurrentWorker* worker = (ConcurrentWorker*)arg;
+    QueryPlan* show = QueryPlan_prepare_with_catalog(worker->ecs, worker->catalog, "SHOW Health OF entity ?");
+    QueryPlan* low = QueryPlan_prepare_with_catalog(worker->ecs, worker->catalog,
+                                                    "SELECT entities WHERE Health.hp < ?");
+    if (!show || !low) {
+        concurrent_mismatch(worker, "prepare");
+    }
+    
+    for (int round = 0; round < CONCURRENT_ROUNDS && show && low; round++) {
+        // Each worker starts at a different query so all of them overlap
+        for (size_t i = 0; i < CONCURRENT_QUERY_COUNT; i++) {
+            size_t q = (i + (size_t)worker->worker) % CONCURRENT_QUERY_COUNT;
+            bool ok;
+            size_t count = concurrent_count(worker, CONCURRENT_QUERIES[q], &ok);
+            if (!ok || count != worker->expected[q]) {
+                concurrent_mismatch(worker, CONCURRENT_QUERIES[q]);
+            }
+        }
+        
+        QueryEngineResult result;
+        size_t pick = ((size_t)round * 7919 + (size_t)worker->worker * 104729) % worker->entityCount;
+        QueryPlan_bind_entity(show, 1, worker->entities[pick]);
+        if (QueryPlan_execute(show, &result) != QUERY_SUCCESS ||
+            ((Health*)result.data)->hp != (int)(pick % 100)) {
+            concurrent_mismatch(worker, "SHOW Health OF entity ?");
+        }
+        QueryEngineResult_free(&result);
+        
+        QueryPlan_bind_f64(low, 1, 25.0);
+        if (QueryPlan_execute(low, &result) != QUERY_SUCCESS || result.count != worker->expectedLow) {
+            concurrent_mismatch(worker, "SELECT entities WHERE Health.hp < ?");
+        }
+        QueryEngineResult_free(&result);
+    }
+    
+    if (show) QueryPlan_destroy(show);
+    if (low) QueryPlan_destroy(low);
+    return NULL;
+}
+
+static void test_stress_concurrent_queries(void) {
+    printf("  Testing %d threads querying one read-only ECS...\n", CONCURRENT_THREADS);
+    
+    Arena_T arena = Arena_new();
+    ECS* ecs = ECS_new(arena);
+    ComponentTypeId positionType = ECS_register_component_type(ecs, "Position", sizeof(float) * 2);
+    ComponentTypeId velocityType = ECS_register_component_type(ecs, "Velocity", sizeof(float) * 2);
+    ComponentTypeId healthType = ECS_register_component_type(ecs, "Health", sizeof(Health));
+    ComponentTypeId teamType = ECS_register_component_type(ecs, "Team", sizeof(int32_t));
+    
+    const size_t ENTITY_COUNT = 20000;
+    EntityId* entities = (EntityId*)ALLOC(sizeof(EntityId) * ENTITY_COUNT);
+    for (size_t i = 0; i < ENTITY_COUNT; i++) {
+        entities[i] = Entity_create(ECS_get_entity_registry(ecs));
+        float pos[2] = {(float)(i % 200), (float)(i / 100)};
+        Health health = {(int)(i % 100), 100};
+        int32_t team = (int32_t)(i % 10);
+        ECS_add_component(ecs, entities[i], positionType, pos);
+        ECS_add_component(ecs, entities[i], healthType, &health);
+        ECS_add_component(ecs, entities[i], teamType, &team);
+        if (i % 3 == 0) {
+            ECS_add_component(ecs, entities[i], velocityType, pos);
+        }
+    }
+    
+    QueryCatalog* catalog = QueryCatalog_new(ecs);
+    QueryCatalog_register_field(catalog, "Position", "x", 0, QUERY_FIELD_F32);
+    QueryCatalog_register_field(catalog, "Position", "y", sizeof(float), QUERY_FIELD_F32);
+    QueryCatalog_register_field(catalog, "Health", "hp", offsetof(Health, hp), QUERY_FIELD_I32);
+    QueryCatalog_register_field(catalog, "Team", "id", 0, QUERY_FIELD_I32);
+    TEST_ASSERT_EQ(QueryCatalog_create_index(catalog, "Health", "hp"), QUERY_SUCCESS, "Index should build");
+    TEST_ASSERT_EQ(QueryCatalog_create_hash_index(catalog, "Team", "id"), QUERY_SUCCESS, "Hash index should build");
+    TEST_ASSERT_EQ(QueryCatalog_create_spatial_index(catalog, "Position", "x", "y", 8.0), QUERY_SUCCESS,
+                   "Spatial index should build");
+    
+    // Reference run on this thread, which also gives the per-round index usage
+    ConcurrentWorker workers[CONCURRENT_THREADS];
+    ConcurrentWorker reference;
+    memset(&reference, 0, sizeof(reference));
+    reference.ecs = ecs;
+    reference.catalog = catalog;
+    reference.entities = entities;
+    reference.entityCount = ENTITY_COUNT;
+    
+    QueryIndexStats before;
+    QueryIndexStats after;
+    QueryCatalog_get_index_stats(catalog, "Health", "hp", &before);
+    bool ok;
+    for (size_t q = 0; q < CONCURRENT_QUERY_COUNT; q++) {
+        reference.expected[q] = concurrent_count(&reference, CONCURRENT_QUERIES[q], &ok);
+        TEST_ASSERT_TRUE(ok, CONCURRENT_QUERIES[q]);
+    }
+    reference.expectedLow = concurrent_count(&reference, "SELECT entities WHERE Health.hp < 25", &ok);
+    TEST_ASSERT_TRUE(ok, "Reference low-health query should succeed");
+    QueryCatalog_get_index_stats(catalog, "Health", "hp", &after);
+    uint64_t scansPerRound = after.scans - before.scans;
+    TEST_ASSERT_EQ(reference.expected[0], ENTITY_COUNT / 3 + 1, "Every third entity moves");
+    TEST_ASSERT_EQ(reference.expectedLow, ENTITY_COUNT / 4, "A quarter of the entities are below 25");
+    
+    pthread_t threads[CONCURRENT_THREADS];
+    for (int t = 0; t < CONCURRENT_THREADS; t++) {
+        workers[t] = reference;
+        workers[t].worker = t;
+        TEST_ASSERT_EQ(pthread_create(&threads[t], NULL, concurrent_worker, &workers[t]), 0, "Worker should start");
+    }
+    for (int t = 0; t < CONCURRENT_THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    
+    for (int t = 0; t < CONCURRENT_THREADS; t++) {
+        if (workers[t].mismatches) {
+            printf("    worker %d: %zu mismatches, first: %s\n", t, workers[t].mismatches, workers[t].firstMismatch);
+        }
+        TEST_ASSERT_EQ(workers[t].mismatches, 0, "Every concurrent result should match the reference");
+    }
+    
+    // Usage counters are bumped from every thread and must not lose updates
+    QueryCatalog_get_index_stats(catalog, "Health", "hp", &before);
+    TEST_ASSERT_TRUE(scansPerRound > 0, "Reference run should use the index");
+    TEST_ASSERT_EQ(before.scans - after.scans, scansPerRound * CONCURRENT_THREADS * CONCURRENT_ROUNDS,
+                   "Index scans from all threads should be counted");
+    
+    FREE(entities);
+    QueryCatalog_destroy(catalog);
+}
+
 bool test_stress(void) {
     printf("Running stress tests...\n");
     
@@ -170,6 +743,15 @@ bool test_stress(void) {
         test_stress_many_component_types();
         test_stress_complex_queries();
         test_stress_memory_cleanup();
+        test_stress_batch_fused_vs_sequential();
+        test_stress_batch_residual_overflow();
+        test_stress_field_index();
+        test_stress_spatial_index();
+        test_stress_hash_index();
+        test_stress_condition_scan();
+        test_stress_result_set_operations();
+        test_stress_frame_sets();
+        test_stress_concurrent_queries();
         
         printf("  ✓ All stress tests passed\n");
         return true;
@@ -0,0 +1,251 @@
+#include "test_common.h"
+#include "gramarye_query/query.h"
+#include "gramarye_query/engine.h"
+#include "gramarye_query/trace.h"
+#include "gramarye_ecs/ecs.h"
+#include "arena.h"
+#include "except.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+typedef struct {
+    int x;
+    int y;
+} Position;
+
+typedef struct {
+    int hp;
+    int maxHp;
+} Health;
+
+// 50 entities with Position; every third has Health too
+static ECS* create_trace_world(void) {
+    Arena_T arena = Arena_new();
+    ECS* ecs = ECS_new(arena);
+    ComponentTypeId positionType = ECS_register_component_type(ecs, "Position", sizeof(Position));
+    ComponentTypeId healthType = ECS_register_component_type(ecs, "Health", sizeof(Health));
+    for (int i = 0; i < 50; i++) {
+        EntityId entity = Entity_create(ECS_get_entity_registry(ecs));
+        Position pos = {i, i};
+        ECS_add_component(ecs, entity, positionType, &pos);
+        if (i % 3 == 0) {
+            Health health = {i, 100};
+            ECS_add_component(ecs, entity, healthType, &health);
+        }
+    }
+    return ecs;
+}
+
+// Flush into a string the caller frees
+static char* flush_to_string(QueryTracer* tracer, size_t* outEvents) {
+    FILE* file = tmpfile();
+    if (!file) return NULL;
+    *outEvents = QueryTracer_flush(tracer, file);
+    long length = ftell(file);
+    char* text = (char*)malloc((size_t)length + 1);
+    if (text) {
+        rewind(file);
+        size_t read = fread(text, 1, (size_t)length, file);
+        text[read] = '\0';
+    }
+    fclose(file);
+    return text;
+}
+
+static size_t count_occurrences(const char* text, const char* needle) {
+    size_t count = 0;
+    for (const char* at = strstr(text, needle); at; at = strstr(at + 1, needle)) {
+        count++;
+    }
+    return count;
+}
+
+static void test_fingerprint(void) {
+    printf("  Testing query fingerprints...\n");
+    
+    uint64_t base = Query_fingerprint("SELECT entities WHERE Health.hp < 20");
+    TEST_ASSERT_TRUE(base != 0, "Fingerprint should be computed");
+    TEST_ASSERT_TRUE(base == Query_fingerprint("select  entities where Health.hp < 75"),
+                     "Literals, whitespace and keyword case should not change the shape");
+    TEST_ASSERT_TRUE(base == Query_fingerprint("SELECT entities WHERE Health.hp < ?"),
+                     "Placeholders should count as literals");
+    TEST_ASSERT_TRUE(base != Query_fingerprint("SELECT entities WHERE Health.hp > 20"),
+                     "Operators are part of the shape");
+    TEST_ASSERT_TRUE(base != Query_fingerprint("SELECT entities WHERE Health.maxHp < 20"),
+                     "Field names are part of the shape");
+    TEST_ASSERT_TRUE(Query_fingerprint("SHOW Health OF entity 1:2") ==
+                     Query_fingerprint("SHOW Health OF entity 9876543210:42"),
+                     "Entity ids should be stripped");
+    TEST_ASSERT_TRUE(Query_fingerprint("SELECT entities WHERE Health.hp IN (1, 2, 3)") ==
+                     Query_fingerprint("SELECT entities WHERE Health.hp IN (7)"),
+                     "IN lists of any length should share a shape");
+    TEST_ASSERT_TRUE(Query_fingerprint("SELECT entities WHERE has(Position, Health)") !=
+                     Query_fingerprint("SELECT entities WHERE has(Position)"),
+                     "Component lists are not collapsed");
+    TEST_ASSERT_TRUE(Query_fingerprint(NULL) == 0, "NULL has no fingerprint");
+}
+
+static void test_trace_spans(void) {
+    printf("  Testing trace spans and flush...\n");
+    
+    ECS* ecs = create_trace_world();
+    QueryTracer* tracer = QueryTracer_new(0);
+    TEST_ASSERT_NOT_NULL(tracer, "Tracer should be created");
+    QueryEngineConfig config = QueryEngineConfig_default();
+    config.tracer = tracer;
+    QueryEngine* engine = QueryEngine_new(ecs, &config);
+    
+    const char* query = "SELECT entities WHERE has(Position, Health)";
+    QueryEngineResult result;
+    TEST_ASSERT_EQ(QueryEngine_execute(engine, query, &result), QUERY_SUCCESS, "Traced query should succeed");
+    TEST_ASSERT_EQ(result.count, 17, "Tracing should not change the result");
+    TEST_ASSERT_EQ(result.stats.operatorCount, 0, "Tracing alone records no EXPLAIN ANALYZE operators");
+    QueryEngineResult_free(&result);
+    TEST_ASSERT_EQ(QueryEngine_execute(engine, "COUNT entities WHERE has(Health)", &result), QUERY_SUCCESS,
+                   "Second traced query should succeed");
+    QueryEngineResult_free(&result);
+    
+    size_t events = 0;
+    char* json = flush_to_string(tracer, &events);
+    TEST_ASSERT_NOT_NULL(json, "Flush should write");
+    TEST_ASSERT_TRUE(strncmp(json, "{\"traceEvents\": [", 17) == 0, "Output should be a trace-event document");
+    TEST_ASSERT_EQ(count_occurrences(json, "\"ph\": \"X\""), events, "Every span should be a complete event");
+    TEST_ASSERT_EQ(count_occurrences(json, "\"name\": \"query\""), 2, "One query span per query");
+#if GRAMARYE_QUERY_PROFILE
+    TEST_ASSERT_TRUE(count_occurrences(json, "\"name\": \"parse\"") >= 1, "The plan compile should be a parse span");
+    TEST_ASSERT_TRUE(strstr(json, "\"name\": \"materialize\"") != NULL, "Copying ids should be a span");
+    TEST_ASSERT_TRUE(strstr(json, "\"name\": \"Select\"") != NULL, "The root operator should be a span");
+    TEST_ASSERT_TRUE(strstr(json, "\"name\": \"Scan has(Position, Health)\"") != NULL,
+                     "Scan operators should be labelled as in EXPLAIN ANALYZE");
+    TEST_ASSERT_TRUE(strstr(json, "\"rows_in\": 17, \"rows_out\": 17") != NULL, "Operator rows should be recorded");
+#endif
+    char fingerprint[32];
+    snprintf(fingerprint, sizeof(fingerprint), "\"%016llx\"", (unsigned long long)Query_fingerprint(query));
+    TEST_ASSERT_TRUE(strstr(json, fingerprint) != NULL, "Spans should carry the query fingerprint");
+    free(json);
+    
+    // A flush takes what it wrote out of the rings
+    json = flush_to_string(tracer, &events);
+    TEST_ASSERT_EQ(events, 0, "Nothing should be left after a flush");
+    TEST_ASSERT_TRUE(strstr(json, "\"traceEvents\": [") != NULL, "An empty flush is still a document");
+    free(json);
+    
+    // Stopped tracing records nothing
+    QueryTracerStats before = QueryTracer_get_stats(tracer);
+    QueryEngine_set_tracer(engine, NULL);
+    TEST_ASSERT_EQ(QueryEngine_execute(engine, query, &result), QUERY_SUCCESS, "Untraced query should succeed");
+    QueryEngineResult_free(&result);
+    QueryTracerStats after = QueryTracer_get_stats(tracer);
+    TEST_ASSERT_TRUE(after.recorded == before.recorded, "No spans without a tracer");
+    TEST_ASSERT_EQ(after.threads, 1, "One thread has traced");
+    
+    QueryEngine_destroy(engine);
+    QueryTracer_destroy(tracer);
+    ECS_destroy(ecs);
+}
+
+static void test_trace_ring_overflow(void) {
+    printf("  Testing trace ring overflow...\n");
+    
+    ECS* ecs = create_trace_world();
+    QueryTracer* tracer = QueryTracer_new(8);
+    QueryEngine* engine = QueryEngine_new(ecs, NULL);
+    QueryEngine_set_tracer(engine, tracer);
+    
+    for (int i = 0; i < 20; i++) {
+        QueryEngineResult result;
+        TEST_ASSERT_EQ(QueryEngine_execute(engine, "SELECT entities WHERE has(Health)", &result), QUERY_SUCCESS,
+                       "Query should succeed");
+        QueryEngineResult_free(&result);
+    }
+    
+    size_t events = 0;
+    char* json = flush_to_string(tracer, &events);
+    TEST_ASSERT_NOT_NULL(json, "Flush should write");
+    TEST_ASSERT_TRUE(events <= 8, "A ring keeps at most its capacity");
+    TEST_ASSERT_TRUE(events > 0, "The newest spans should survive");
+    QueryTracerStats stats = QueryTracer_get_stats(tracer);
+    TEST_ASSERT_TRUE(stats.recorded >= 20, "Every query should have been recorded");
+    TEST_ASSERT_TRUE(stats.dropped == stats.recorded - events, "Overwritten spans should count as dropped");
+    free(json);
+    
+    QueryEngine_destroy(engine);
+    QueryTracer_destroy(tracer);
+    ECS_destroy(ecs);
+}
+
+typedef struct {
+    ECS* ecs;
+    QueryTracer* tracer;
+    int failures;
+} TraceWorker;
+
+static void* trace_worker_main(void* arg) {
+    TraceWorker* worker = (TraceWorker*)arg;
+    QueryEngine* engine = QueryEngine_new(worker->ecs, NULL);
+    QueryEngine_set_tracer(engine, worker->tracer);
+    for (int i = 0; i < 50; i++) {
+        QueryEngineResult result;
+        if (QueryEngine_execute(engine, "SELECT entities WHERE has(Position, Health)", &result) != QUERY_SUCCESS ||
+            result.count != 17) {
+            worker->failures++;
+        }
+        QueryEngineResult_free(&result);
+    }
+    QueryEngine_destroy(engine);
+    return NULL;
+}
+
+static void test_trace_threads(void) {
+    printf("  Testing per-thread trace rings...\n");
+    
+    ECS* ecs = create_trace_world();
+    QueryTracer* tracer = QueryTracer_new(1024);
+    TraceWorker workers[3];
+    pthread_t threads[3];
+    for (int i = 0; i < 3; i++) {
+        workers[i].ecs = ecs;
+        workers[i].tracer = tracer;
+        workers[i].failures = 0;
+        TEST_ASSERT_EQ(pthread_create(&threads[i], NULL, trace_worker_main, &workers[i]), 0, "Worker should start");
+    }
+    
+    // Flushing while the workers trace only loses spans the rings overwrite
+    size_t events = 0;
+    char* json = flush_to_string(tracer, &events);
+    free(json);
+    for (int i = 0; i < 3; i++) {
+        pthread_join(threads[i], NULL);
+        TEST_ASSERT_EQ(workers[i].failures, 0, "Traced queries on workers should succeed");
+    }
+    size_t rest = 0;
+    json = flush_to_string(tracer, &rest);
+    
+    QueryTracerStats stats = QueryTracer_get_stats(tracer);
+    TEST_ASSERT_EQ(stats.threads, 3, "Each worker should get its own ring");
+    TEST_ASSERT_TRUE(events + rest + stats.dropped == stats.recorded, "Every span is flushed or dropped once");
+    TEST_ASSERT_EQ(count_occurrences(json, "\"tid\""), rest, "Every span names its thread");
+    free(json);
+    
+    QueryTracer_destroy(tracer);
+    ECS_destroy(ecs);
+}
+
+bool test_trace(void) {
+    printf("Running trace tests...\n");
+    
+    TRY
+        test_fingerprint();
+        test_trace_spans();
+        test_trace_ring_overflow();
+        test_trace_threads();
+        
+        printf("  ✓ All trace tests passed\n");
+        return true;
+    EXCEPT(Test_Failed)
+        printf("  ✗ Trace test failed\n");
+        return false;
+    END_TRY;
+}